@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"io"
+	"sort"
+	"sync/atomic"
+	"time"
+)
+
+const (
+	// abrInterval is the interval of playback time to choose a rendition.
+	abrInterval = 2 * time.Second
+
+	// abrHoldTime is the playback time to keep a rendition after a switch.
+	abrHoldTime = 8 * time.Second
+)
+
+// rendition is one of the video renditions of an adaptive Player.
+type rendition struct {
+	stream *stream
+	reader *measuredReader
+
+	// bitrate is the average bitrate of the input in bits per second.
+	bitrate float64
+
+	// bytes and nanos are the reader's statistics at the last check.
+	bytes int64
+	nanos int64
+}
+
+// throughput returns the reading speed in bits per second since the last call, or 0 if the reader has not read.
+func (r *rendition) throughput() float64 {
+	bytes, nanos := r.reader.bytes.Load(), r.reader.nanos.Load()
+	db, dn := bytes-r.bytes, nanos-r.nanos
+	r.bytes, r.nanos = bytes, nanos
+	if db == 0 || dn == 0 {
+		return 0
+	}
+	return float64(db) * 8 / (float64(dn) / float64(time.Second))
+}
+
+// measuredReader measures the time spent in reading.
+type measuredReader struct {
+	r     io.ReadSeeker
+	bytes atomic.Int64
+	nanos atomic.Int64
+}
+
+func (m *measuredReader) Read(buf []byte) (int, error) {
+	start := time.Now()
+	n, err := m.r.Read(buf)
+	m.nanos.Add(int64(time.Since(start)))
+	m.bytes.Add(int64(n))
+	return n, err
+}
+
+func (m *measuredReader) Seek(offset int64, whence int) (int64, error) {
+	return m.r.Seek(offset, whence)
+}
+
+// NewPlayerWithRenditions creates a Player that plays the audio and one of the video renditions.
+//
+// The renditions must be the same content with keyframe-aligned clusters, as in DASH WebM.
+// The Player switches renditions at cluster boundaries, dropping to a lighter rendition when decoding or reading
+// can't keep up with the playback, and going back up when there is enough headroom.
+//
+// VideoSize reports the size of the rendition with the highest bitrate, and Draw scales the other renditions to it.
+func NewPlayerWithRenditions(options *PlayerOptions, audio io.ReadSeeker, renditions ...io.ReadSeeker) (*Player, error) {
+	if options == nil {
+		options = &PlayerOptions{}
+	}
+	if audio == nil {
+		return nil, fmt.Errorf("webmplayer: no audio input")
+	}
+	if len(renditions) == 0 {
+		return nil, fmt.Errorf("webmplayer: no video renditions")
+	}
+	start := time.Now()
+
+	inputs := []io.ReadSeeker{audio}
+	rs := make([]*rendition, len(renditions))
+	sizes := make([]int64, len(renditions))
+	for i, r := range renditions {
+		size, err := r.Seek(0, io.SeekEnd)
+		if err != nil {
+			return nil, err
+		}
+		if _, err := r.Seek(0, io.SeekStart); err != nil {
+			return nil, err
+		}
+		sizes[i] = size
+		rs[i] = &rendition{
+			reader: &measuredReader{r: r},
+		}
+		inputs = append(inputs, rs[i].reader)
+	}
+
+	parsed, errs := newStreams(options, inputs)
+	for _, err := range errs {
+		if err != nil {
+			return nil, err
+		}
+	}
+	audioSource := parsed[0]
+	if audioSource.AudioStream() == nil {
+		return nil, fmt.Errorf("webmplayer: no audio track in the audio input")
+	}
+	for i, r := range rs {
+		r.stream = parsed[i+1]
+		if r.stream.VideoStream() == nil {
+			return nil, fmt.Errorf("webmplayer: no video track in the rendition %d", i)
+		}
+		r.bitrate = float64(sizes[i]) * 8
+		if d := r.stream.Meta().GetDuration(); d > 0 {
+			r.bitrate /= d.Seconds()
+		}
+	}
+	// The highest bitrate first.
+	sort.SliceStable(rs, func(i, j int) bool {
+		return rs[i].bitrate > rs[j].bitrate
+	})
+
+	// Start with the lightest rendition, and go up after the first measurement.
+	current := len(rs) - 1
+	videoSource := rs[current].stream
+	top := rs[0].stream.VideoTrack()
+	audioTrack := audioSource.AudioTrack()
+
+	v := &Player{
+		width:         int(top.DisplayWidth),
+		height:        int(top.DisplayHeight),
+		videoSource:   videoSource,
+		audioSource:   audioSource,
+		videoStream:   videoSource.VideoStream(),
+		audioStream:   audioSource.AudioStream(),
+		videoDuration: videoSource.Meta().GetDuration(),
+		videoCodecID:  videoSource.VideoTrack().CodecID,
+		audioDuration: audioSource.Meta().GetDuration(),
+		audioCodecID:  audioTrack.CodecID,
+		renditions:    rs,
+		rendition:     current,
+		pending:       -1,
+		abrCheck:      abrInterval,
+		created:       start,
+	}
+
+	outputStart := time.Now()
+	p, stretcher, err := newAudioPlayer(v.audioStream, 1)
+	if err != nil {
+		return nil, err
+	}
+	v.audioOutputTime = time.Since(outputStart)
+	v.audioPlayer = p
+	v.stretcher = stretcher
+	v.initLoudness(options, "")
+	p.Play()
+	v.initClock(options)
+	v.newPlayerTime = time.Since(start)
+	return v, nil
+}
+
+// updateRendition chooses a rendition at pos, and switches to the chosen rendition when its first frame is ready.
+func (p *Player) updateRendition(pos time.Duration) error {
+	if p.pending >= 0 {
+		next := p.renditions[p.pending]
+		if err := next.stream.VideoStream().Update(pos); err != nil {
+			return err
+		}
+		if !next.stream.VideoStream().ready() {
+			return nil
+		}
+		p.rendition = p.pending
+		p.pending = -1
+		p.videoSource = next.stream
+		p.videoStream = next.stream.VideoStream()
+		p.videoCodecID = next.stream.VideoTrack().CodecID
+		// The frames skipped to reach the position are not due to the load.
+		p.abrSkipped = p.videoStream.SkippedFrames()
+		p.abrCheck = pos + abrInterval
+		return nil
+	}
+
+	if pos < p.abrCheck {
+		return nil
+	}
+	p.abrCheck = pos + abrInterval
+
+	cur := p.renditions[p.rendition]
+	load := p.videoStream.decodeLoad()
+	skipped := p.videoStream.SkippedFrames()
+	late := skipped > p.abrSkipped
+	p.abrSkipped = skipped
+	throughput := cur.throughput()
+
+	next := p.rendition
+	switch {
+	case p.rendition+1 < len(p.renditions) && (late || load > 0.85 || (throughput > 0 && throughput < 1.1*cur.bitrate)):
+		next++
+	case p.rendition > 0 && pos >= p.abrHold && !late:
+		up := p.renditions[p.rendition-1]
+		// Assume that the decoding time is proportional to the bitrate.
+		if load*up.bitrate/cur.bitrate < 0.6 && (throughput == 0 || throughput > 1.5*up.bitrate) {
+			next--
+		}
+	}
+	if next == p.rendition {
+		return nil
+	}
+
+	// The clusters are keyframe-aligned, so the rendition restarts at the cluster of pos.
+	p.pending = next
+	p.abrHold = pos + abrHoldTime
+	p.renditions[next].stream.Seek(pos)
+	// Drop the reading statistics before the switch.
+	p.renditions[next].throughput()
+	return nil
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build linux
+
+package webmplayer
+
+import (
+	"fmt"
+	"syscall"
+	"unsafe"
+)
+
+// cpuMask is a cpu_set_t of CPU_SETSIZE CPUs.
+type cpuMask [1024 / 64]uint64
+
+func newCPUMask(cpus []int) (*cpuMask, error) {
+	var m cpuMask
+	for _, c := range cpus {
+		if c < 0 || c >= 64*len(m) {
+			return nil, fmt.Errorf("webmplayer: invalid CPU: %d", c)
+		}
+		m[c/64] |= 1 << (c % 64)
+	}
+	return &m, nil
+}
+
+// threadAffinity returns the CPUs that the current OS thread runs on.
+func threadAffinity() (*cpuMask, error) {
+	var m cpuMask
+	if _, _, errno := syscall.RawSyscall(syscall.SYS_SCHED_GETAFFINITY, 0, unsafe.Sizeof(m), uintptr(unsafe.Pointer(&m))); errno != 0 {
+		return nil, fmt.Errorf("webmplayer: sched_getaffinity failed: %w", errno)
+	}
+	return &m, nil
+}
+
+// setThreadAffinity makes the current OS thread run on the CPUs of m. The threads created by the thread after that
+// inherit the affinity.
+func setThreadAffinity(m *cpuMask) error {
+	if _, _, errno := syscall.RawSyscall(syscall.SYS_SCHED_SETAFFINITY, 0, unsafe.Sizeof(*m), uintptr(unsafe.Pointer(m))); errno != 0 {
+		return fmt.Errorf("webmplayer: sched_setaffinity failed: %w", errno)
+	}
+	return nil
+}
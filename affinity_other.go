@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !linux
+
+package webmplayer
+
+// cpuMask is empty, as the thread affinity is not supported.
+type cpuMask struct{}
+
+func newCPUMask(cpus []int) (*cpuMask, error) {
+	return nil, nil
+}
+
+func threadAffinity() (*cpuMask, error) {
+	return nil, nil
+}
+
+func setThreadAffinity(m *cpuMask) error {
+	return nil
+}
@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"image"
+	"time"
+
+	"github.com/hajimehoshi/ebiten/v2"
+)
+
+// VideoAtlas is a texture shared by the video frames of Players, e.g. the tiles of a video wall, so that DrawPlayers
+// draws them by one draw call. Each Player with PlayerOptions.VideoAtlas draws its frames into its own region of the
+// atlas, which is allocated at the first frame and freed at Close.
+//
+// A VideoAtlas is used on the game's goroutine, as the Players are.
+type VideoAtlas struct {
+	image *ebiten.Image
+
+	// shelves is the rows of the regions allocated from the top, and free is the regions freed for reuse.
+	shelves []atlasShelf
+	free    []image.Rectangle
+}
+
+// atlasShelf is a row of the atlas, which is filled from the left.
+type atlasShelf struct {
+	y, height, x int
+}
+
+// NewVideoAtlas returns a new VideoAtlas of width x height pixels.
+func NewVideoAtlas(width, height int) *VideoAtlas {
+	return &VideoAtlas{
+		image: newVideoImage(width, height),
+	}
+}
+
+// Deallocate frees the texture of the atlas. The Players using the atlas must be closed before Deallocate.
+func (a *VideoAtlas) Deallocate() {
+	a.image.Deallocate()
+	a.shelves = nil
+	a.free = nil
+}
+
+// atlasGutter is the transparent gap between the regions, so that the linear filter doesn't sample the neighboring
+// regions.
+const atlasGutter = 1
+
+// alloc returns a region of w x h pixels, or false if the atlas is full.
+func (a *VideoAtlas) alloc(w, h int) (image.Rectangle, bool) {
+	for i, r := range a.free {
+		if r.Dx() == w && r.Dy() == h {
+			a.free = append(a.free[:i], a.free[i+1:]...)
+			return r, true
+		}
+	}
+	b := a.image.Bounds()
+	pw, ph := w+atlasGutter, h+atlasGutter
+	// A region is put on the first shelf that is high enough, as the tiles of a wall tend to have the same height.
+	for i := range a.shelves {
+		s := &a.shelves[i]
+		if ph <= s.height && s.x+pw <= b.Dx() {
+			r := image.Rect(s.x, s.y, s.x+w, s.y+h)
+			s.x += pw
+			return r, true
+		}
+	}
+	y := 0
+	if n := len(a.shelves); n > 0 {
+		y = a.shelves[n-1].y + a.shelves[n-1].height
+	}
+	if pw > b.Dx() || y+ph > b.Dy() {
+		return image.Rectangle{}, false
+	}
+	a.shelves = append(a.shelves, atlasShelf{y: y, height: ph, x: pw})
+	return image.Rect(0, y, w, y+h), true
+}
+
+// release makes the region r reusable.
+func (a *VideoAtlas) release(r image.Rectangle) {
+	a.free = append(a.free, r)
+}
+
+// DrawPlayers draws the Players as Player.Draw does with the options of the same index. options can be nil, or have
+// nil elements, for the default options.
+//
+// The consecutive Players whose frames are in the same VideoAtlas, and whose options have the same Blend, are drawn by
+// one DrawTriangles call. The other Players, and the Players with PlayerDrawOptions.Shader, are drawn one by one.
+func DrawPlayers(screen *ebiten.Image, players []*Player, options []*PlayerDrawOptions) {
+	var b atlasBatch
+	for i, p := range players {
+		var op *PlayerDrawOptions
+		if i < len(options) {
+			op = options[i]
+		}
+		if p.videoStream == nil || p.closed {
+			continue
+		}
+		if p.hiddenAfter > 0 {
+			p.drawn = time.Now()
+		}
+		p.presentOnDraw()
+		v := p.videoStream
+		if v.atlas == nil || v.frame == nil || (op != nil && len(op.Shader) > 0) {
+			b.flush(screen)
+			p.draw(screen, op)
+			continue
+		}
+		var blend ebiten.Blend
+		if op != nil {
+			blend = op.Blend
+		}
+		if b.atlas != v.atlas || b.blend != blend {
+			b.flush(screen)
+			b.atlas = v.atlas
+			b.blend = blend
+		}
+		v.convert()
+		b.add(screen, p, v.frame.Bounds(), op)
+	}
+	b.flush(screen)
+}
+
+// atlasBatch is the tiles of a VideoAtlas drawn by one DrawTriangles call.
+type atlasBatch struct {
+	atlas    *VideoAtlas
+	blend    ebiten.Blend
+	vertices []ebiten.Vertex
+	indices  []uint16
+}
+
+// add adds the tile of the region r of the Player p.
+func (b *atlasBatch) add(screen *ebiten.Image, p *Player, r image.Rectangle, options *PlayerDrawOptions) {
+	// The indices are 16-bit.
+	if len(b.vertices)+4 > 1<<16 {
+		atlas, blend := b.atlas, b.blend
+		b.flush(screen)
+		b.atlas, b.blend = atlas, blend
+	}
+	w, h := r.Dx(), r.Dy()
+	// The frame is scaled to the video size as Draw does.
+	var geoM ebiten.GeoM
+	if w > 0 && h > 0 && (w != p.width || h != p.height) {
+		geoM.Scale(float64(p.width)/float64(w), float64(p.height)/float64(h))
+	}
+	cr, cg, cb, ca := float32(1), float32(1), float32(1), float32(1)
+	if options != nil {
+		geoM.Concat(options.GeoM)
+		cr, cg, cb, ca = options.ColorScale.R(), options.ColorScale.G(), options.ColorScale.B(), options.ColorScale.A()
+	}
+	sx0, sy0 := float32(r.Min.X), float32(r.Min.Y)
+	sx1, sy1 := float32(r.Max.X), float32(r.Max.Y)
+	base := uint16(len(b.vertices))
+	for _, c := range [4][4]float32{
+		{0, 0, sx0, sy0},
+		{float32(w), 0, sx1, sy0},
+		{0, float32(h), sx0, sy1},
+		{float32(w), float32(h), sx1, sy1},
+	} {
+		x, y := geoM.Apply(float64(c[0]), float64(c[1]))
+		b.vertices = append(b.vertices, ebiten.Vertex{
+			DstX:   float32(x),
+			DstY:   float32(y),
+			SrcX:   c[2],
+			SrcY:   c[3],
+			ColorR: cr,
+			ColorG: cg,
+			ColorB: cb,
+			ColorA: ca,
+		})
+	}
+	b.indices = append(b.indices, base, base+1, base+2, base+1, base+2, base+3)
+}
+
+// flush draws the tiles added to screen, and resets b.
+func (b *atlasBatch) flush(screen *ebiten.Image) {
+	if len(b.indices) > 0 {
+		op := &ebiten.DrawTrianglesOptions{}
+		op.Filter = ebiten.FilterLinear
+		op.Blend = b.blend
+		// The scales of the options are premultiplied, as DrawImage takes them.
+		op.ColorScaleMode = ebiten.ColorScaleModePremultipliedAlpha
+		screen.DrawTriangles(b.vertices, b.indices, b.atlas.image, op)
+	}
+	b.atlas = nil
+	b.vertices = b.vertices[:0]
+	b.indices = b.indices[:0]
+}
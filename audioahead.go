@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"context"
+	"errors"
+	"io"
+	"sync/atomic"
+	"time"
+)
+
+// pcmChunkFrames is the number of the frames of a chunk of pcmQueue.
+const pcmChunkFrames = 1024
+
+// pcmChunk is the output of audioStream decoded by one call of read.
+type pcmChunk struct {
+	// gen is the seek generation that the output belongs to.
+	gen uint64
+
+	data []byte
+
+	// n is the size of the output in data, and off is the size already read.
+	n   int
+	off int
+}
+
+// pcmQueue is a bounded ring of the audio output decoded ahead of the audio player.
+//
+// pcmQueue is lock-free for one producer (the decode-ahead goroutine) and one consumer (audioStream.Read), as
+// frameQueue. The consumer never waits. The producer waits when the ring is full, or when there is nothing to decode.
+type pcmQueue struct {
+	chunks []pcmChunk
+
+	// head is the index of the oldest chunk that the consumer has not read.
+	head atomic.Uint64
+
+	// tail is the index of the next chunk to be published by the producer.
+	tail atomic.Uint64
+
+	// eos is the seek generation plus 1 whose end has been decoded, or 0.
+	eos atomic.Uint64
+
+	// err is the error that stopped the producer.
+	err atomic.Pointer[error]
+
+	// space is notified when the consumer reads chunks.
+	space chan struct{}
+
+	// done is closed when the queue is closed, and exited is closed when the producer returns.
+	done   chan struct{}
+	exited chan struct{}
+
+	started bool
+}
+
+// newPCMQueue creates a pcmQueue that keeps d of the output at samplingFrequency.
+func newPCMQueue(d time.Duration, samplingFrequency int) *pcmQueue {
+	frames := int(d * time.Duration(samplingFrequency) / time.Second)
+	n := max((frames+pcmChunkFrames-1)/pcmChunkFrames, 2)
+	chunks := make([]pcmChunk, n)
+	for i := range chunks {
+		chunks[i].data = make([]byte, pcmChunkFrames*bytesPerFrame)
+	}
+	// The chunks are accounted in the memory budget until closeAhead.
+	trackMemory(memoryAudioBuffers, int64(n)*pcmChunkFrames*bytesPerFrame)
+	return &pcmQueue{
+		chunks: chunks,
+		space:  make(chan struct{}, 1),
+		done:   make(chan struct{}),
+		exited: make(chan struct{}),
+	}
+}
+
+// back returns the chunk to be filled by the producer. back blocks while the ring is full.
+// back returns nil when the queue is closed.
+func (q *pcmQueue) back() *pcmChunk {
+	t := q.tail.Load()
+	for t-q.head.Load() == uint64(len(q.chunks)) {
+		select {
+		case <-q.space:
+		case <-q.done:
+			return nil
+		}
+	}
+	return &q.chunks[t%uint64(len(q.chunks))]
+}
+
+// publish makes the chunk returned by back visible to the consumer.
+func (q *pcmQueue) publish() {
+	q.tail.Add(1)
+}
+
+// buffered returns about how long the output in q plays at samplingFrequency. Partly read chunks count as full.
+func (q *pcmQueue) buffered(samplingFrequency int) time.Duration {
+	n := q.tail.Load() - q.head.Load()
+	return time.Duration(n) * pcmChunkFrames * time.Second / time.Duration(samplingFrequency)
+}
+
+// wait waits until the consumer reads chunks or timeout passes. wait returns false when the queue is closed.
+func (q *pcmQueue) wait(timeout time.Duration) bool {
+	select {
+	case <-q.space:
+	case <-time.After(timeout):
+	case <-q.done:
+		return false
+	}
+	return true
+}
+
+// read copies the output of the seek generation gen to buf. The chunks of older generations are discarded.
+// read returns errAudioNotReady if nothing has been decoded yet.
+func (q *pcmQueue) read(buf []byte, gen uint64) (int, error) {
+	// Load eos before tail, as the producer publishes the last chunks before storing eos.
+	eos := q.eos.Load()
+	size := uint64(len(q.chunks))
+	h0, t := q.head.Load(), q.tail.Load()
+	h := h0
+	var n int
+	for h < t && n < len(buf) {
+		c := &q.chunks[h%size]
+		if c.gen == gen {
+			m := copy(buf[n:], c.data[c.off:c.n])
+			n += m
+			c.off += m
+			if c.off < c.n {
+				break
+			}
+		}
+		h++
+	}
+	if h != h0 {
+		q.head.Store(h)
+		q.notify()
+	}
+	if n > 0 {
+		return n, nil
+	}
+	if err := q.err.Load(); err != nil {
+		return 0, *err
+	}
+	if eos == gen+1 && h == t {
+		return 0, io.EOF
+	}
+	return 0, errAudioNotReady
+}
+
+func (q *pcmQueue) notify() {
+	select {
+	case q.space <- struct{}{}:
+	default:
+	}
+}
+
+// readAhead implements Read with the output decoded by the decode-ahead goroutine, which starts at the first call.
+// The goroutine starts only then, as startAt sets the position after a is created.
+func (a *audioStream) readAhead(buf []byte) (int, error) {
+	a.startAhead()
+	return a.ahead.read(buf[:len(buf)/bytesPerFrame*bytesPerFrame], a.stream.seek.Gen())
+}
+
+// startAhead starts the decode-ahead goroutine if it is not started yet.
+func (a *audioStream) startAhead() {
+	q := a.ahead
+	if q.started {
+		return
+	}
+	q.started = true
+	go a.stream.run("audio", func(ctx context.Context) {
+		a.decodeAhead(q)
+	})
+}
+
+// full reports whether the ring is full, or the end of the stream has been decoded.
+func (q *pcmQueue) full() bool {
+	return q.tail.Load()-q.head.Load() == uint64(len(q.chunks)) || q.eos.Load() != 0
+}
+
+// decodeAhead decodes the audio into q until q is closed.
+func (a *audioStream) decodeAhead(q *pcmQueue) {
+	defer close(q.exited)
+	for {
+		c := q.back()
+		if c == nil {
+			return
+		}
+		n, err := a.read(c.data)
+		a.meterLoudness(c.data[:n], err)
+		if n > 0 {
+			c.gen = a.gen
+			c.n = n
+			c.off = 0
+			q.publish()
+		}
+		switch {
+		case err == nil:
+		case err == io.EOF:
+			// A seek can restart the stream.
+			q.eos.Store(a.gen + 1)
+			if !q.wait(audioReadTimeout) {
+				return
+			}
+		case errors.Is(err, errAudioNotReady):
+			if !q.wait(audioReadTimeout) {
+				return
+			}
+		default:
+			q.err.Store(&err)
+			return
+		}
+	}
+}
+
+// closeAhead stops the decode-ahead goroutine and waits for it.
+func (a *audioStream) closeAhead() {
+	q := a.ahead
+	if q == nil {
+		return
+	}
+	select {
+	case <-q.done:
+		return
+	default:
+	}
+	close(q.done)
+	if q.started {
+		<-q.exited
+	}
+	trackMemory(memoryAudioBuffers, -int64(len(q.chunks))*pcmChunkFrames*bytesPerFrame)
+}
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"runtime/trace"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer/internal/libopus"
+)
+
+// audioDecoder is the decoder of an audio codec for an audioStream.
+type audioDecoder interface {
+	// read moves the decoded PCM to dst as interleaved stereo, decoding the pending packets of a while dst has room,
+	// and returns the number of the moved samples. The frames of a.skip are discarded first.
+	// read returns 0 with the pending packets only if the decoder can't decode them.
+	read(a *audioStream, dst []float32) (int, error)
+
+	// reset discards the decoder state for a seek.
+	reset() error
+
+	// close frees the decoder or returns it to pool.
+	close(pool *PlayerPool)
+}
+
+// opusDecoder is implemented by libopus.Decoder, libopus.MSDecoder, libopus.ParallelMSDecoder and
+// libopus.ProjectionDecoder.
+type opusDecoder interface {
+	DecodeFloat(data []byte, pcm []float32, decodeFec int) int
+	DecodeFloatBatch(packets [][]byte, pcm []float32) []int
+	ResetState() error
+	SetGain(gain int) error
+	Destroy()
+}
+
+// opusAudioDecoder is an audioDecoder of Opus. The PCM is decoded into the ring of the audioStream.
+type opusAudioDecoder struct {
+	decoder opusDecoder
+	pcm     []float32
+
+	// next is the timecode where the next packet is expected, the end of the last decoded packet.
+	// next is negative when it is unknown, at the start or after a seek.
+	next time.Duration
+
+	// poolKey is the key by opusDecoderKey.
+	poolKey string
+}
+
+// opusSamplingFrequency is the internal rate of Opus. The durations of the Opus packets are in the frames at this rate.
+const opusSamplingFrequency = 48000
+
+// opusDecodeRate returns the rate that Opus is decoded at for the audio context's rate contextRate: the lowest rate
+// of opusReducedRates, or 48 kHz, without going below contextRate. libopus does less work at a lower rate, e.g. for
+// an audio device at 16 kHz, than decoding at 48 kHz and resampling down.
+// If contextRate is 0, i.e. there is no audio context yet, 48 kHz is used, and the output is resampled if the audio
+// context is created with another rate later.
+func opusDecodeRate(contextRate int) int {
+	if contextRate <= 0 {
+		return opusSamplingFrequency
+	}
+	for _, r := range opusReducedRates {
+		if contextRate <= r {
+			return r
+		}
+	}
+	return opusSamplingFrequency
+}
+
+func newOpusAudioDecoder(a *audioStream, codecPrivate []byte, options *PlayerOptions) (*opusAudioDecoder, error) {
+	channels := a.channels
+	head := &opusHead{
+		channels:       channels,
+		streamCount:    1,
+		coupledCount:   channels - 1,
+		channelMapping: []byte{0, 1}[:min(channels, 2)],
+	}
+	if len(codecPrivate) > 0 {
+		h, err := parseOpusHead(codecPrivate)
+		if err != nil {
+			return nil, err
+		}
+		head = h
+	}
+	a.channels = head.channels
+
+	// The pre-skip is in the frames at 48 kHz, the internal rate of Opus, whatever the decoded rate is.
+	// https://datatracker.ietf.org/doc/html/rfc7845#section-5.1
+	samplingFrequency := opusDecodeRate(contextSampleRate())
+	a.samplingFrequency = samplingFrequency
+	a.preSkip = head.preSkip * samplingFrequency / opusSamplingFrequency
+	a.skip = a.preSkip
+
+	// A pooled decoder is reset when it is returned.
+	parallel := options.AudioParallelStreams && head.streamCount > 1
+	o := &opusAudioDecoder{
+		poolKey: opusDecoderKey(head, samplingFrequency, parallel),
+		next:    -1,
+	}
+	reused := false
+	if d := a.pool.takeOpus(o.poolKey); d != nil {
+		o.decoder = d
+		reused = true
+	}
+	if !reused {
+		d, err := newOpusDecoder(head, samplingFrequency, parallel)
+		if err != nil {
+			return nil, err
+		}
+		o.decoder = d
+	}
+	// The gain of a pooled decoder might be set for another stream.
+	if head.outputGain != 0 || reused {
+		if err := o.decoder.SetGain(head.outputGain); err != nil {
+			return nil, fmt.Errorf("webmplayer: setting the Opus output gain failed: %w", err)
+		}
+	}
+	if a.channels > 2 || head.mappingFamily == 3 {
+		m := options.AudioDownmix
+		if len(m[0]) == 0 && len(m[1]) == 0 && (head.mappingFamily == 2 || head.mappingFamily == 3) {
+			m = ambisonicsDownmix(a.channels)
+		}
+		var err error
+		a.downmix, err = downmixMatrix(m, a.channels)
+		if err != nil {
+			return nil, err
+		}
+		// Mapping family 1 is in the Vorbis order.
+		if head.mappingFamily == 1 {
+			a.loudnessWeights = surroundLoudnessWeights(a.channels)
+		}
+	}
+
+	// A packet has at most 120 milliseconds. A batch of packets is decoded into the ring, or into pcm to be
+	// downmixed, which have room for two of the longest packets, or 12 packets of the usual 20 milliseconds.
+	maxFrames := samplingFrequency * 120 / 1000
+	o.pcm = make([]float32, 2*maxFrames*a.channels)
+	a.frames = newPCMRing(2 * 2 * maxFrames)
+	return o, nil
+}
+
+func (o *opusAudioDecoder) read(a *audioStream, dst []float32) (int, error) {
+	for {
+		if a.skip > 0 {
+			a.skip -= a.frames.Discard(2*a.skip) / 2
+		}
+		if a.frames.Len() > 0 {
+			return a.frames.Read(dst), nil
+		}
+		o.dropPreRoll(a)
+		if len(a.packets) == 0 {
+			return 0, nil
+		}
+		// Without a skip, a gap or a downmix, the PCM is decoded straight into dst if the first packet fits, so that
+		// each sample is written once. The batch stops before the packets that don't fit.
+		if a.skip == 0 && a.downmix == nil && o.lostFrames(a, o.next, &a.packets[0]) == 0 && 2*o.packetFrames(a, &a.packets[0]) <= len(dst) {
+			frames, ok := o.decodeBatch(a, dst)
+			if !ok {
+				return 0, nil
+			}
+			if frames > 0 {
+				return 2 * frames, nil
+			}
+			continue
+		}
+		if !o.decode(a) {
+			return 0, nil
+		}
+	}
+}
+
+// opusPreRoll is how much of the skipped audio before a seek target is decoded, so that the Opus decoder converges.
+// https://datatracker.ietf.org/doc/html/rfc7845#section-4.6
+const opusPreRoll = 80 * time.Millisecond
+
+// dropPreRoll drops the pending packets whose PCM would be skipped without decoding them, except the ones in the last
+// opusPreRoll before the end of the skip. The ring must be empty.
+func (o *opusAudioDecoder) dropPreRoll(a *audioStream) {
+	preRoll := int(opusPreRoll * time.Duration(a.samplingFrequency) / time.Second)
+	for len(a.packets) > 0 {
+		pkt := &a.packets[0]
+		n := o.packetFrames(a, pkt)
+		if n == 0 || a.skip-n < preRoll {
+			return
+		}
+		a.skip -= n
+		// The dropped packet is not a gap to conceal.
+		o.next = o.packetEnd(a, pkt)
+		a.packets[0] = packet{}
+		a.packets = a.packets[1:]
+	}
+}
+
+// decode decodes the pending packets of a into the ring, which must be empty. decode reports false if no packet is
+// decoded nor concealed.
+func (o *opusAudioDecoder) decode(a *audioStream) bool {
+	if lost := o.lostFrames(a, o.next, &a.packets[0]); lost > 0 {
+		// Packets are lost before the next packet, e.g. on a lossy live stream. libopus conceals the gap by PLC,
+		// and recovers the last lost frame from the FEC data of the next packet if it has any. The next packet
+		// itself is decoded as usual after this.
+		r := trace.StartRegion(a.stream.ctx, "audio.decode")
+		cgoStart := a.stream.stats.cgo.start()
+		n := o.decoder.DecodeFloat(a.packets[0].Data, o.pcm[:lost*a.channels], 1)
+		a.stream.stats.cgo.end(cgoOpusDecode, cgoStart, 1, len(a.packets[0].Data), 4*max(n, 0)*a.channels)
+		r.End()
+		o.next = a.packets[0].Timecode
+		if n > 0 {
+			o.writePCM(a, o.pcm[:n*a.channels])
+			a.stream.stats.audioConcealed.Add(int64(time.Duration(n) * time.Second / time.Duration(a.samplingFrequency)))
+		}
+		return true
+	}
+
+	// The PCM is decoded straight into the ring, which is empty here. The ring has room for as many stereo frames as
+	// pcm has, so the batch stops at the same packet either way.
+	frames, ok := o.decodeBatch(a, a.frames.Space())
+	a.frames.Commit(2 * frames)
+	return ok
+}
+
+// decodeBatch decodes a batch of the pending packets into dst as stereo, and returns the number of the frames.
+// The batch stops before the packets that don't fit in dst. The first packet must not follow a gap.
+// decodeBatch reports false if no packet is decoded.
+func (o *opusAudioDecoder) decodeBatch(a *audioStream, dst []float32) (int, bool) {
+	start := time.Now()
+	r := trace.StartRegion(a.stream.ctx, "audio.decode")
+
+	// A batch ends before a gap, so that the gap is concealed before the packet after it.
+	batch := a.batchData()
+	for i := 1; i < len(a.packets); i++ {
+		if o.lostFrames(a, o.packetEnd(a, &a.packets[i-1]), &a.packets[i]) > 0 {
+			batch = batch[:i]
+			break
+		}
+	}
+
+	// The PCM is decoded straight into dst, or into pcm to be downmixed.
+	pcm := o.pcm
+	if a.downmix == nil {
+		pcm = dst[:len(dst)*a.channels/2]
+	}
+	cgoStart := a.stream.stats.cgo.start()
+	counts := o.decoder.DecodeFloatBatch(batch, pcm)
+	r.End()
+	if len(counts) > 0 {
+		o.next = o.packetEnd(a, &a.packets[len(counts)-1])
+	}
+	a.consumePackets(len(counts), time.Since(start))
+
+	// A broken packet is skipped, and the PCM of the other packets is contiguous.
+	var frames int
+	for _, sampleCount := range counts {
+		frames += max(sampleCount, 0)
+	}
+	a.stream.stats.cgo.end(cgoOpusDecode, cgoStart, len(counts), packetBytes(batch[:len(counts)]), 4*frames*a.channels)
+	if a.downmix != nil {
+		o.meterSource(a, pcm[:frames*a.channels])
+	}
+	if a.downmix != nil || a.channels == 1 {
+		// Mono is duplicated in place.
+		frames = libopus.MapStereo(dst, pcm[:frames*a.channels], a.channels, a.downmix)
+	}
+	return frames, len(counts) > 0
+}
+
+// writePCM writes the decoded PCM to the ring as stereo. The ring must be empty, so that it has room for the PCM of
+// pcm.
+func (o *opusAudioDecoder) writePCM(a *audioStream, pcm []float32) {
+	if a.downmix != nil {
+		o.meterSource(a, pcm)
+	}
+	n := libopus.MapStereo(a.frames.Space(), pcm, a.channels, a.downmix)
+	a.frames.Commit(2 * n)
+}
+
+// meterSource measures the decoded channels pcm before the downmix, except the frames that the skip discards. The
+// PCM decoded into the ring is discarded from the start of it, and the PCM decoded into dst is not skipped.
+func (o *opusAudioDecoder) meterSource(a *audioStream, pcm []float32) {
+	skip := min(a.skip*a.channels, len(pcm))
+	a.meterSource(pcm[skip:])
+}
+
+// packetFrames returns the number of the frames of a packet at the decoded rate, or 0 if the packet is broken.
+func (o *opusAudioDecoder) packetFrames(a *audioStream, pkt *packet) int {
+	return opusPacketFrames(pkt.Data) * a.samplingFrequency / opusSamplingFrequency
+}
+
+// packetEnd returns the timecode of the end of a packet.
+func (o *opusAudioDecoder) packetEnd(a *audioStream, pkt *packet) time.Duration {
+	return pkt.Timecode + time.Duration(opusPacketFrames(pkt.Data))*time.Second/opusSamplingFrequency
+}
+
+// lostFrames returns the number of the frames lost between the timecode expected and pkt, rounded to the 2.5 ms
+// granularity of the Opus frames. WebM timecodes are usually in milliseconds, so a smaller difference is not a gap.
+// lostFrames returns 0 if there is no gap, or if the gap is too long to conceal, e.g. when a live stream restarts.
+func (o *opusAudioDecoder) lostFrames(a *audioStream, expected time.Duration, pkt *packet) int {
+	if expected < 0 {
+		return 0
+	}
+	step := a.samplingFrequency / 400
+	frames := int((pkt.Timecode - expected) * time.Duration(a.samplingFrequency) / time.Second)
+	frames = (frames + step/2) / step * step
+	if frames <= 0 || frames*a.channels > len(o.pcm) {
+		return 0
+	}
+	return frames
+}
+
+func (o *opusAudioDecoder) reset() error {
+	o.next = -1
+	if err := o.decoder.ResetState(); err != nil {
+		return fmt.Errorf("webmplayer: resetting the Opus decoder failed: %w", err)
+	}
+	return nil
+}
+
+func (o *opusAudioDecoder) close(pool *PlayerPool) {
+	if o.decoder != nil {
+		pool.putOpus(o.poolKey, o.decoder)
+	}
+	o.decoder = nil
+}
@@ -0,0 +1,307 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"io"
+	"runtime"
+	"slices"
+	"sync"
+	"time"
+	"unsafe"
+)
+
+// defaultAudioEngineSampleRate is the rate of the output of an AudioEngine by default.
+const defaultAudioEngineSampleRate = 48000
+
+// AudioEngineOptions is the options of NewAudioEngine.
+type AudioEngineOptions struct {
+	// SampleRate is the rate of the mixed output. The inputs are resampled to it.
+	//
+	// If SampleRate is 0, 48000 is used.
+	SampleRate int
+
+	// Workers is the number of the goroutines decoding the inputs.
+	//
+	// If Workers is 0, runtime.GOMAXPROCS(0) is used.
+	Workers int
+}
+
+// AudioEngine decodes and mixes the audio of many inputs without an audio device, e.g. on a server mixing the voices
+// of a room. The inputs are decoded by the decoders of Player, and an AudioEngine doesn't use the Ebitengine audio.
+//
+// Mix is called at each tick of the caller, e.g. every 20 milliseconds. A block of every input is decoded on the worker
+// goroutines in parallel, and the blocks are mixed when all of them are ready. An input without audio ready in time,
+// e.g. a live input received late, is silent in the block, and its audio is mixed later.
+//
+// An AudioEngine is safe for concurrent use.
+type AudioEngine struct {
+	sampleRate int
+
+	jobs chan *AudioEngineInput
+	wg   sync.WaitGroup
+
+	m      sync.Mutex
+	inputs []*AudioEngineInput
+	closed bool
+}
+
+// NewAudioEngine creates an AudioEngine and starts its workers.
+func NewAudioEngine(options *AudioEngineOptions) *AudioEngine {
+	if options == nil {
+		options = &AudioEngineOptions{}
+	}
+	e := &AudioEngine{
+		sampleRate: options.SampleRate,
+		jobs:       make(chan *AudioEngineInput),
+	}
+	if e.sampleRate <= 0 {
+		e.sampleRate = defaultAudioEngineSampleRate
+	}
+	workers := options.Workers
+	if workers <= 0 {
+		workers = runtime.GOMAXPROCS(0)
+	}
+	for range workers {
+		go func() {
+			for i := range e.jobs {
+				i.decodeBlock()
+				e.wg.Done()
+			}
+		}()
+	}
+	return e
+}
+
+// SampleRate returns the rate of the mixed output.
+func (e *AudioEngine) SampleRate() int {
+	return e.sampleRate
+}
+
+// Add adds the audio track of the WebM or Ogg input r. The video tracks of r are not decoded. The options are as for
+// NewPlayer, where the options of the video and the output device don't apply.
+//
+// The input starts at the next Mix.
+func (e *AudioEngine) Add(r io.ReadSeeker, options *PlayerOptions) (*AudioEngineInput, error) {
+	if options == nil {
+		options = &PlayerOptions{}
+	}
+	s, err := newStream(r, options, false)
+	if err != nil {
+		return nil, err
+	}
+	if s.AudioStream() == nil {
+		s.close()
+		return nil, errors.New("webmplayer: no audio tracks")
+	}
+	src, _ := newAudioSource(s.AudioStream(), e.sampleRate, 1)
+	i := &AudioEngineInput{
+		engine: e,
+		stream: s,
+		src:    src,
+		gain:   1,
+	}
+
+	e.m.Lock()
+	defer e.m.Unlock()
+	if e.closed {
+		s.close()
+		return nil, errors.New("webmplayer: the audio engine is closed")
+	}
+	e.inputs = append(e.inputs, i)
+	return i, nil
+}
+
+// Mix decodes a block of every input, and writes their mix to dst as interleaved stereo float32 samples.
+// dst is the whole block, e.g. 960 frames of 20 milliseconds at 48 kHz.
+func (e *AudioEngine) Mix(dst []float32) {
+	dst = dst[:len(dst)&^1]
+	clear(dst)
+
+	e.m.Lock()
+	defer e.m.Unlock()
+	if e.closed {
+		return
+	}
+
+	start := time.Now()
+	var n int
+	for _, i := range e.inputs {
+		if i.ended {
+			continue
+		}
+		i.buf = slices.Grow(i.buf[:0], len(dst))[:len(dst)]
+		i.start = start
+		n++
+	}
+	e.wg.Add(n)
+	for _, i := range e.inputs {
+		if !i.ended {
+			e.jobs <- i
+		}
+	}
+	e.wg.Wait()
+
+	for _, i := range e.inputs {
+		src := i.buf[:i.n]
+		switch i.gain {
+		case 0:
+		case 1:
+			mixAdd(dst, src)
+		default:
+			mixAddGain(dst, src, i.gain)
+		}
+		i.n = 0
+	}
+}
+
+// Close removes and closes all the inputs, and stops the workers.
+func (e *AudioEngine) Close() {
+	e.m.Lock()
+	defer e.m.Unlock()
+	if e.closed {
+		return
+	}
+	e.closed = true
+	for _, i := range e.inputs {
+		i.stream.close()
+	}
+	e.inputs = nil
+	close(e.jobs)
+}
+
+// AudioEngineInputStats is the statistics of an input of an AudioEngine.
+type AudioEngineInputStats struct {
+	// Latency is the time from the start of the last Mix until the block of the input was decoded, and MaxLatency is
+	// the longest Latency.
+	Latency    time.Duration
+	MaxLatency time.Duration
+
+	// Underruns is the number of the blocks that the input had no audio ready for in time.
+	Underruns int
+}
+
+// AudioEngineInput is an input of an AudioEngine.
+type AudioEngineInput struct {
+	engine *AudioEngine
+	stream *stream
+	src    io.ReadSeeker
+
+	// The fields below are protected by the engine's lock.
+
+	// buf is the block being decoded, and n is the number of the samples decoded to it.
+	buf []float32
+	n   int
+
+	// start is the start of the Mix decoding the block.
+	start time.Time
+
+	gain float32
+
+	// pos is the position in bytes of the output.
+	pos int64
+
+	ended bool
+	err   error
+	stats AudioEngineInputStats
+}
+
+// decodeBlock decodes the block of the input. decodeBlock is called by a worker.
+func (i *AudioEngineInput) decodeBlock() {
+	buf := unsafe.Slice((*byte)(unsafe.Pointer(unsafe.SliceData(i.buf))), 4*len(i.buf))
+	var n int
+	for n < len(buf) {
+		m, err := i.src.Read(buf[n:])
+		n += m
+		if errors.Is(err, errAudioNotReady) {
+			i.stats.Underruns++
+			break
+		}
+		if err != nil {
+			// An input failing is treated as its end, so that the other inputs keep being mixed.
+			i.ended = true
+			if err != io.EOF {
+				i.err = err
+			}
+			break
+		}
+		if m == 0 {
+			break
+		}
+	}
+	n = n / bytesPerFrame * bytesPerFrame
+	i.n = n / 4
+	i.pos += int64(n)
+	i.stats.Latency = time.Since(i.start)
+	i.stats.MaxLatency = max(i.stats.MaxLatency, i.stats.Latency)
+}
+
+// SetVolume sets the volume of the input, where 1 is the original volume.
+func (i *AudioEngineInput) SetVolume(volume float64) {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	i.gain = float32(max(volume, 0))
+}
+
+// Position returns the position of the input mixed so far.
+func (i *AudioEngineInput) Position() time.Duration {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	return time.Duration(i.pos/bytesPerFrame) * time.Second / time.Duration(e.sampleRate)
+}
+
+// SetPosition seeks the input to t. SetPosition restarts an input that has ended.
+func (i *AudioEngineInput) SetPosition(t time.Duration) error {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	offset := int64(t) * int64(e.sampleRate) / int64(time.Second) * bytesPerFrame
+	if _, err := i.src.Seek(offset, io.SeekStart); err != nil {
+		return err
+	}
+	i.pos = offset
+	i.ended = false
+	i.err = nil
+	return nil
+}
+
+// Ended reports whether the input has reached its end or failed. Err returns the error if it failed.
+func (i *AudioEngineInput) Ended() bool {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	return i.ended
+}
+
+func (i *AudioEngineInput) Err() error {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	return i.err
+}
+
+// Stats returns the statistics of the input.
+func (i *AudioEngineInput) Stats() AudioEngineInputStats {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	return i.stats
+}
+
+// Close removes the input from the engine, and frees its decoders.
+func (i *AudioEngineInput) Close() error {
+	e := i.engine
+	e.m.Lock()
+	defer e.m.Unlock()
+	idx := slices.Index(e.inputs, i)
+	if idx < 0 {
+		return nil
+	}
+	e.inputs = slices.Delete(e.inputs, idx, idx+1)
+	i.stream.close()
+	return nil
+}
@@ -4,250 +4,426 @@
 package webmplayer
 
 import (
+	"context"
 	"errors"
 	"fmt"
+	"io"
+	"math"
+	"runtime/trace"
+	"time"
 	"unsafe"
+)
 
-	"github.com/ebml-go/webm"
+// bytesPerFrame is the size of a stereo float32 frame that audioStream outputs.
+const bytesPerFrame = 8
 
-	"github.com/hajimehoshi/webmplayer/internal/libopus"
-	"github.com/hajimehoshi/webmplayer/internal/libvorbis"
-)
+// audioReadTimeout is how long audioStream.Read waits for a packet. Read is called by the mixer, which mixes all the
+// Players, so a late input must not stall the others beyond the mixer's buffer.
+const audioReadTimeout = 5 * time.Millisecond
 
-const samplesPerBuffer = 1024
+// errAudioNotReady is returned by audioStream.Read when no audio is decoded in time, e.g. when the demuxer is late or
+// while pre-buffering. The readers of the audio stream return what they have, and the mixer plays silence for the rest
+// without advancing the position.
+var errAudioNotReady = errors.New("webmplayer: audio is not ready")
 
 type audioStream struct {
 	codec             audioCodec
 	channels          int
 	samplingFrequency int
 
-	src     <-chan webm.Packet
-	packets []webm.Packet
+	src     *packetQueue
+	packets []packet
+
+	stream *stream
+
+	// gen is the seek generation of the decoder state.
+	gen uint64
+
+	// eos is true when the end of the stream has been reached in the current seek generation.
+	eos bool
+
+	// prebuffer is PlayerOptions.AudioPrebuffer. prebuffering is true until the packets of prebuffer are queued after
+	// the start or a seek.
+	prebuffer    time.Duration
+	prebuffering bool
+
+	// seeking is true until the first packet after a seek is decoded, and target is the position to start from.
+	seeking bool
+	target  time.Duration
+
+	// switching is true when the decoder has started at a position for a track switch, until the player sets the
+	// position by Seek.
+	switching bool
+
+	// skip is the number of frames to be discarded to reach the seek target.
+	skip int
+
+	// preSkip is the number of frames to be discarded at the beginning of the stream.
+	preSkip int
+
+	// pos is the current position in bytes. pos is used by Seek.
+	pos int64
+
+	// decoder is the decoder of the codec.
+	decoder audioDecoder
+
+	// cpus is the CPUs of PlayerOptions.DecodeCPUs that the decoder runs on, or nil.
+	cpus *cpuMask
+
+	// batch is the data of the packets decoded in one cgo call.
+	batch [][]byte
 
-	// voInfo must be kept as voDPS has a reference to it.
-	voInfo  *libvorbis.Info
-	voDSP   *libvorbis.DspState
-	voBlock *libvorbis.Block
+	// downmix is the matrix to mix more than two channels down to stereo. downmix is nil for mono and stereo.
+	downmix []float32
 
-	opDecoder *libopus.Decoder
-	opPCM     []float32
+	// loudnessWeights is the weights of BS.1770 for the channels mixed by downmix, or nil if their layout is unknown,
+	// e.g. for ambisonics.
+	loudnessWeights []float64
 
-	frames []float32
+	// frames is the decoded interleaved stereo samples of the decoders that don't keep the PCM by themselves, e.g.
+	// Opus. frames is nil for Vorbis.
+	frames *pcmRing
+
+	// resampleQuality is the quality of the resampler when the player's rate differs from samplingFrequency.
+	resampleQuality ResampleQuality
+
+	// pool is the pool that the decoder is returned to at closing. pool can be nil.
+	pool *PlayerPool
+
+	// ahead is the output decoded ahead of the audio player with PlayerOptions.AudioDecodeAhead, or nil.
+	ahead *pcmQueue
+
+	// clip is the whole output decoded by PlayerOptions.AudioPredecode, or nil. With clip, there is no decoder, and
+	// the output is copied from clip at pos.
+	clip *pcmClip
+
+	// loudness measures the audio for PlayerOptions.LoudnessTarget from the start until the end, or is nil. The
+	// measurement stops at a seek. loudness belongs to the goroutine decoding a, which is the decode-ahead goroutine
+	// with ahead.
+	loudness *loudnessMeter
 }
 
+// audioBatchSize is the maximum number of the packets decoded in one cgo call.
+const audioBatchSize = 16
+
 type audioCodec string
 
 const (
-	audioCodecVorbis audioCodec = "A_VORBIS"
-	audioCodecOpus   audioCodec = "A_OPUS"
+	audioCodecVorbis          audioCodec = "A_VORBIS"
+	audioCodecOpus            audioCodec = "A_OPUS"
+	audioCodecFLAC            audioCodec = "A_FLAC"
+	audioCodecPCMLittleEndian audioCodec = "A_PCM/INT/LIT"
+	audioCodecPCMBigEndian    audioCodec = "A_PCM/INT/BIG"
+	audioCodecPCMFloat        audioCodec = "A_PCM/FLOAT/IEEE"
 )
 
-func newAudioDecoder(codec audioCodec, codecPrivate []byte, channels, samplingFrequency int, src <-chan webm.Packet) (*audioStream, error) {
+func newAudioDecoder(codec audioCodec, codecPrivate []byte, channels, samplingFrequency, bitDepth int, src *packetQueue, stream *stream, options *PlayerOptions) (*audioStream, error) {
 	a := &audioStream{
 		channels:          channels,
 		samplingFrequency: samplingFrequency,
 		codec:             codec,
 		src:               src,
+		stream:            stream,
+		pool:              options.Pool,
+		resampleQuality:   options.AudioResampleQuality,
+		prebuffer:         options.AudioPrebuffer,
+		prebuffering:      options.AudioPrebuffer > 0,
+	}
+	cpus, err := decodeCPUs(options)
+	if err != nil {
+		return nil, err
 	}
-	// TODO: Clear vo* and op* objects explicitly when a is finalized.
+	a.cpus = cpus
+
+	// The codec objects are freed by close, or by their finalizers if a is dropped without being closed.
 	switch codec {
 	case audioCodecVorbis:
-		info, _, err := readVorbisCodecPrivate(codecPrivate)
-		if err != nil {
-			return nil, err
-		}
-		a.voInfo = info
+		a.decoder, err = newVorbisDecoder(a, codecPrivate, options)
+	case audioCodecOpus:
+		a.decoder, err = newOpusAudioDecoder(a, codecPrivate, options)
+	case audioCodecFLAC:
+		a.decoder, err = newFLACDecoder(a, codecPrivate, options)
+	case audioCodecPCMLittleEndian, audioCodecPCMBigEndian, audioCodecPCMFloat:
+		a.decoder, err = newPCMDecoder(a, codec, bitDepth, options)
+	default:
+		err = fmt.Errorf("webmplayer: unsupported audio codec: %s", codec)
+	}
+	if err != nil {
+		return nil, err
+	}
+	ahead := options.AudioDecodeAhead
+	if ahead <= 0 && options.LowLatency {
+		ahead = lowLatencyAudioDecodeAhead
+	}
+	if ahead > 0 {
+		a.ahead = newPCMQueue(ahead, a.samplingFrequency)
+	}
+	return a, nil
+}
 
-		if info.Channels() != channels {
-			a.channels = int(channels)
-			return nil, fmt.Errorf("webmplayer: channel count doesn't match: %d vs %d", info.Channels(), channels)
-		}
-		if info.Rate() != samplingFrequency {
-			a.samplingFrequency = info.Rate()
-			return nil, fmt.Errorf("webmplayer: sample rate doesn't match: %d vs %d", info.Rate(), samplingFrequency)
+func (a *audioStream) Read(buf []byte) (int, error) {
+	var n int
+	var err error
+	if a.clip != nil {
+		n, err = a.readClip(buf)
+		a.meterLoudness(buf[:n], err)
+	} else if a.ahead != nil {
+		n, err = a.readAhead(buf)
+	} else {
+		// Read is called by the audio player's goroutine, which is shared by the Players. Label only the decoding.
+		a.stream.run("audio", func(ctx context.Context) {
+			n, err = a.read(buf)
+		})
+		a.meterLoudness(buf[:n], err)
+	}
+	if flight := a.stream.stats.flight; flight != nil {
+		flight.record(FlightAudioRead, 0, 0, int64(n))
+		// The silence before the first audio and while pre-buffering is not a stall.
+		if errors.Is(err, errAudioNotReady) && a.stream.stats.firstAudio.Load() != 0 && !a.prebuffering {
+			flight.underrun(len(buf) - n)
 		}
+	}
+	if n > 0 {
+		a.stream.stats.mark(&a.stream.stats.firstAudio)
+	}
+	a.setPos(a.pos + int64(n))
+	if err == io.EOF {
+		a.stream.audioPulled.Store(math.MaxInt64)
+	}
+	return n, err
+}
 
-		dsp, err := libvorbis.SynthesisInit(info)
-		if err != nil {
-			return nil, fmt.Errorf("webmplayer: libvorbis.SynthesisInit failed: %w", err)
+// setPos sets the position in bytes of the output.
+func (a *audioStream) setPos(pos int64) {
+	a.pos = pos
+	a.stream.audioPulled.Store(int64(time.Duration(pos/bytesPerFrame) * time.Second / time.Duration(a.samplingFrequency)))
+}
+
+func (a *audioStream) read(buf []byte) (int, error) {
+	if gen := a.stream.seek.Gen(); gen != a.gen {
+		if err := a.reset(gen); err != nil {
+			return 0, err
 		}
-		a.voDSP = dsp
+	}
 
-		block, err := libvorbis.BlockInit(a.voDSP)
-		if err != nil {
-			return nil, fmt.Errorf("webmplayer: libvorbis.BlockInit failed: %w", err)
+	if a.prebuffering {
+		if !a.src.buffered(a.prebuffer) {
+			return 0, errAudioNotReady
 		}
-		a.voBlock = block
+		a.prebuffering = false
+	}
 
-		return a, nil
+	dst := unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4)
+	if len(dst) < 2 {
+		return 0, nil
+	}
 
-	case audioCodecOpus:
+	for {
+		// The audio is due now, as it is being pulled, or when the audio decoded ahead has been played.
+		deadline := time.Now()
+		if a.ahead != nil {
+			deadline = deadline.Add(a.ahead.buffered(a.samplingFrequency))
+		}
+		scheduler := a.stream.options.DecodeScheduler
+		if d := scheduler.acquire(true, deadline); d > 0 {
+			a.stream.stats.decodeWait.observe(d)
+		}
+		var n int
 		var err error
-		a.opDecoder, err = libopus.DecoderCreate(samplingFrequency, channels)
-		if err != nil {
-			return nil, err
+		var track uint
+		var timecode time.Duration
+		if len(a.packets) > 0 {
+			track, timecode = a.packets[0].TrackNumber, a.packets[0].Timecode
+		}
+		flight := a.stream.stats.flight
+		start := time.Now()
+		flight.record(FlightAudioDecodeStart, track, timecode, 0)
+		// Read is called on the audio player's goroutine shared by the Players, so the affinity is set only for the
+		// decoding.
+		withCPUs(a.cpus, func() {
+			n, err = a.decoder.read(a, dst)
+		})
+		flight.record(FlightAudioDecodeEnd, track, timecode, int64(time.Since(start)))
+		scheduler.release()
+		if n > 0 || err != nil || len(a.packets) > 0 {
+			return 4 * n, err
+		}
+		if err := a.fill(); err != nil {
+			return 0, err
 		}
-		a.opPCM = make([]float32, samplesPerBuffer*channels)
-		return a, nil
-	default:
-		return a, fmt.Errorf("webmplayer: unsupported audio codec: %s", codec)
 	}
 }
 
-func (a *audioStream) Read(buf []byte) (int, error) {
-readFrames:
-	if len(a.frames) > 0 {
-		n := copy(unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4), a.frames)
-		a.frames = a.frames[n:]
-		return 4 * n, nil
-	}
-
+// fill waits for the next packet and takes it with the next packets already demuxed, so that the decoder decodes
+// them in one cgo call.
+func (a *audioStream) fill() error {
 	for len(a.packets) == 0 {
-		pkt, ok := <-a.src
+		if a.eos {
+			return io.EOF
+		}
+		r := trace.StartRegion(a.stream.ctx, "audio.wait")
+		pkt, ok, timedOut := a.src.popTimeout(audioReadTimeout)
+		r.End()
+		if timedOut {
+			a.stream.stats.audioUnderruns.Add(1)
+			return errAudioNotReady
+		}
 		if !ok {
-			n := min(len(buf)/4*4, 256)
-			for i := range n {
-				buf[i] = 0
+			// The queue is closed when the reader stops, so no more packets come.
+			return io.EOF
+		}
+		if pkt.gen != a.gen {
+			if pkt.gen != a.stream.seek.Gen() {
+				// A packet read before the latest seek.
+				continue
+			}
+			if err := a.reset(pkt.gen); err != nil {
+				return err
 			}
-			return n, nil
 		}
-		if len(pkt.Data) == 0 {
+		if pkt.eos {
+			a.eos = true
 			continue
 		}
-		a.packets = append(a.packets, pkt)
-	}
-
-	pkt := a.packets[0]
-	a.packets = a.packets[1:]
-
-	switch a.codec {
-	case audioCodecVorbis:
-		packet := &libvorbis.OggPacket{
-			Packet: pkt.Data,
-		}
-		if err := libvorbis.Synthesis(a.voBlock, packet); err != nil {
-			return 0, fmt.Errorf("webmplayer: libvorbis.Synthesis failed: %w", err)
-		}
-
-		if err := libvorbis.SynthesisBlockin(a.voDSP, a.voBlock); err != nil {
-			return 0, fmt.Errorf("webmplayer: libvorbis.SynthesisBlockin failed: %w", err)
-		}
-
-		for pcm := libvorbis.SynthesisPcmout(a.voDSP); len(pcm) > 0 && len(pcm[0]) > 0; pcm = libvorbis.SynthesisPcmout(a.voDSP) {
-			switch a.channels {
-			case 1:
-				for i := range pcm[0] {
-					v := pcm[0][i]
-					a.frames = append(a.frames, v, v)
-				}
-			case 2:
-				for i := range pcm[0] {
-					for ch := range pcm {
-						v := pcm[ch][i]
-						a.frames = append(a.frames, v)
-					}
-				}
-			default:
-				return 0, fmt.Errorf("webmplayer: unsupported channel count: %d", a.channels)
-			}
-			if err := libvorbis.SynthesisRead(a.voDSP, len(pcm[0])); err != nil {
-				return 0, fmt.Errorf("webmplayer: libvorbis.SynthesisRead failed: %w", err)
+		if pkt.loop {
+			// The next pass of Loop is decoded as the stream is from the start. fill is called after all the
+			// output of the previous pass is read, so the passes are joined sample by sample.
+			a.skip = a.preSkip
+			if err := a.decoder.reset(); err != nil {
+				return err
 			}
+			continue
 		}
-
-		goto readFrames
-
-	case audioCodecOpus:
-		sampleCount := a.opDecoder.DecodeFloat(pkt.Data, a.opPCM, 0)
-		if sampleCount <= 0 {
-			return 0, nil
-		}
-
-		origLen := len(a.frames)
-		a.frames = append(a.frames, a.opPCM[:int(sampleCount)*a.channels]...)
-		if a.channels == 1 {
-			a.frames = append(a.frames, make([]float32, sampleCount)...)
-			frames := a.frames[origLen:]
-			for i := int(sampleCount) - 1; i > 0; i-- {
-				frames[2*i] = frames[i]
-				frames[2*i+1] = frames[i]
+		if len(pkt.Data) == 0 {
+			continue
+		}
+		if a.seeking {
+			a.seeking = false
+			// The first preSkip frames of the stream are before the timestamp 0.
+			if skip := int((a.target-pkt.Timecode)*time.Duration(a.samplingFrequency)/time.Second) + a.preSkip; skip > 0 {
+				a.skip = skip
 			}
 		}
-
-		goto readFrames
-
-	default:
-		return 0, fmt.Errorf("webmplayer: unsupported audio codec: %s", a.codec)
+		a.packets = append(a.packets, pkt)
+		a.packets = a.src.popBatch(a.packets, audioBatchSize-1, a.gen)
 	}
+	return nil
 }
 
-func (a *audioStream) Channels() int {
-	return a.channels
+// batchData returns the data of the pending packets.
+func (a *audioStream) batchData() [][]byte {
+	a.batch = a.batch[:0]
+	for _, pkt := range a.packets {
+		a.batch = append(a.batch, pkt.Data)
+	}
+	return a.batch
 }
 
-func (a *audioStream) SamplingFrequency() int {
-	return a.samplingFrequency
+// consumePackets removes the first n pending packets decoded in d.
+func (a *audioStream) consumePackets(n int, d time.Duration) {
+	if n == 0 {
+		return
+	}
+	for range n {
+		a.stream.stats.audioDecode.observe(d / time.Duration(n))
+	}
+	clear(a.packets[:n])
+	a.packets = a.packets[n:]
 }
 
-func readVorbisCodecPrivate(codecPrivate []byte) (*libvorbis.Info, *libvorbis.Comment, error) {
-	if len(codecPrivate) < 1 {
-		return nil, nil, errors.New("webmplayer: codec private data is too short")
+// reset discards the decoded data and resets the decoder state for the seek generation gen.
+func (a *audioStream) reset(gen uint64) error {
+	a.gen = gen
+	a.eos = false
+	a.loudness = nil
+	a.prebuffering = a.prebuffer > 0
+	a.seeking = true
+	a.target = a.stream.seek.Target()
+	a.skip = 0
+	if a.frames != nil {
+		a.frames.Reset()
 	}
+	a.packets = a.packets[:0]
+	return a.decoder.reset()
+}
 
-	p := codecPrivate
-
-	// https://www.matroska.org/technical/codec_specs.html
-	// > Byte 1: number of distinct packets #p minus one inside the CodecPrivate block. This MUST be “2” for current (as of 2016-07-08) Vorbis headers.
-	if p[0] != 0x02 {
-		return nil, nil, fmt.Errorf("webmplayer: wrong codec private data for Vorbis: %d", p[0])
+// Seek implements io.Seeker. offset is in bytes of the output.
+// Seek is called by audio.Player.SetPosition.
+func (a *audioStream) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += a.pos
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	offset = offset / bytesPerFrame * bytesPerFrame
+	if a.switching {
+		// The decoder already starts at the position.
+		a.switching = false
+		a.setPos(offset)
+		return offset, nil
 	}
-	offset := 1
-	p = p[1:]
+	if offset == a.pos {
+		return offset, nil
+	}
+	if a.clip != nil {
+		// Without a clip, the measurement stops at the reset by the seek on the goroutine decoding a.
+		a.loudness = nil
+	}
+	a.stream.Seek(time.Duration(offset/bytesPerFrame) * time.Second / time.Duration(a.samplingFrequency))
+	a.setPos(offset)
+	return offset, nil
+}
 
-	headers := make([][]byte, 3)
-	var size0, size1 int
+// prepare starts decoding ahead before the audio player starts, for PlayerOptions.Prepare.
+func (a *audioStream) prepare() {
+	if a.ahead != nil {
+		a.startAhead()
+	}
+}
 
-	// https://xiph.org/vorbis/doc/framing.html
-	// > The raw packet is logically divided into [n] 255 byte segments and a last fractional segment of < 255 bytes.
-	// > A packet size may well consist only of the trailing fractional segment, and a fractional segment may be zero length.
-	// > These values, called "lacing values" are then saved and placed into the header segment table.
-	for i := 0; i < 2; i++ {
-		for (p[0] == 0xff) && offset < len(codecPrivate) {
-			if i == 0 {
-				size0 += 0xff
-			} else {
-				size1 += 0xff
-			}
-			offset++
-			p = p[1:]
-		}
-		if offset >= len(codecPrivate)-1 {
-			return nil, nil, errors.New("webmplayer: header sizes damaged")
-		}
-		if i == 0 {
-			size0 += int(p[0])
-		} else {
-			size1 += int(p[0])
-		}
-		offset++
-		p = p[1:]
+// prepared reports whether the audio is buffered enough to start, for PlayerOptions.Prepare: the ring of
+// AudioDecodeAhead is full, or the packets of AudioPrebuffer are queued.
+func (a *audioStream) prepared() bool {
+	if a.clip != nil {
+		return true
 	}
-	headers[0] = codecPrivate[offset : offset+size0]
-	headers[1] = codecPrivate[offset+size0 : offset+size0+size1]
-	headers[2] = codecPrivate[offset+size0+size1:]
+	if a.ahead != nil {
+		return a.ahead.full()
+	}
+	return a.src.buffered(a.prebuffer)
+}
 
-	info := libvorbis.InfoInit()
-	comment := libvorbis.CommentInit()
+// startAt makes the decoder start at t of the current seek generation, without seeking the stream.
+// startAt is used when switching the audio track. The caller must set the player's position to t by Seek.
+func (a *audioStream) startAt(t time.Duration) {
+	a.gen = a.stream.seek.Gen()
+	a.seeking = true
+	a.target = t
+	a.switching = true
+}
 
-	for i := 0; i < 3; i++ {
-		packet := &libvorbis.OggPacket{
-			Packet: headers[i],
-			BOS:    i == 0,
-		}
-		if err := libvorbis.SynthesisHeaderin(info, comment, packet); err != nil {
-			return nil, nil, fmt.Errorf("webmplayer: libvorbis.SynthesisHeaderin failed: %w", err)
-		}
+// close frees the decoder state or returns it to the pool. The audio player reading a must be closed before close.
+func (a *audioStream) close() {
+	a.closeAhead()
+	if a.decoder != nil {
+		a.decoder.close(a.pool)
+	}
+	a.decoder = nil
+	if a.frames != nil {
+		a.frames.free()
+		a.frames = nil
 	}
+}
 
-	return info, comment, nil
+func (a *audioStream) Channels() int {
+	return a.channels
+}
+
+func (a *audioStream) SamplingFrequency() int {
+	return a.samplingFrequency
 }
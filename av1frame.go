@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+// AV1 OBU types.
+const (
+	av1OBUSequenceHeader = 1
+	av1OBUFrameHeader    = 3
+	av1OBUFrame          = 6
+)
+
+func parseAV1Frame(data []byte) vpxFrameInfo {
+	// https://aomediacodec.github.io/av1-spec/av1-spec.pdf
+	// A block is a temporal unit in the low overhead bitstream format. 5.3 OBU syntax
+	var reducedStillPictureHeader bool
+	for len(data) > 0 {
+		header := data[0]
+		obuType := header >> 3 & 0xf
+		n := 1
+		if header&0x4 != 0 {
+			// obu_extension_header
+			n++
+		}
+		if len(data) < n {
+			break
+		}
+		size := len(data) - n
+		if header&0x2 != 0 {
+			v, m, ok := readLEB128(data[n:])
+			if !ok || v > uint64(len(data)-n-m) {
+				break
+			}
+			n += m
+			size = int(v)
+		}
+		payload := data[n : n+size]
+		data = data[n+size:]
+
+		switch obuType {
+		case av1OBUSequenceHeader:
+			// seq_profile, still_picture and reduced_still_picture_header.
+			r := bitReader{data: payload}
+			r.read(4)
+			reducedStillPictureHeader = r.read(1) == 1
+		case av1OBUFrameHeader, av1OBUFrame:
+			// 5.9.2 Uncompressed header syntax. A reduced still picture header is not in the frame header, and the
+			// frame is a shown keyframe. The sequence header is usually not in the block, so the header is assumed not
+			// to be reduced otherwise, as for videos.
+			if reducedStillPictureHeader {
+				return vpxFrameInfo{keyframe: true, reference: true}
+			}
+			r := bitReader{data: payload}
+			if r.read(1) == 1 {
+				// show_existing_frame of a keyframe refreshes the references.
+				return vpxFrameInfo{reference: true}
+			}
+			frameType := r.read(2)
+			showFrame := r.read(1)
+			if r.overrun {
+				break
+			}
+			// A hidden keyframe is not a random access point until it is shown.
+			// The refresh_frame_flags are after the fields depending on the sequence header, so all the frames
+			// are treated as references.
+			return vpxFrameInfo{
+				keyframe:  frameType == 0 && showFrame == 1,
+				reference: true,
+			}
+		}
+	}
+	return vpxFrameInfo{reference: true}
+}
+
+// readLEB128 reads an unsigned LEB128 integer, and returns it with its size.
+func readLEB128(data []byte) (uint64, int, bool) {
+	var v uint64
+	for i := 0; i < min(len(data), 8); i++ {
+		v |= uint64(data[i]&0x7f) << (7 * i)
+		if data[i]&0x80 == 0 {
+			return v, i + 1, true
+		}
+	}
+	return 0, 0, false
+}
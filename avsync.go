@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"time"
+)
+
+const (
+	// avSyncSmoothing is the weight of the moving averages of the offsets, in samples.
+	avSyncSmoothing = 16
+
+	// avSyncSettle is the wall time not to measure the audio drift after a seek, a resume or a track switch, while the
+	// audio buffer refills and the clock follows.
+	avSyncSettle = 500 * time.Millisecond
+
+	// audioDriftWindow is the playback time to cancel the audio drift in.
+	audioDriftWindow = 10 * time.Second
+
+	// maxAudioTrim is the maximum adjustment of the audio speed to cancel the drift. 0.5% is about 9 cents, which
+	// is not heard.
+	maxAudioTrim = 0.005
+
+	// audioTrimStep is the step of the adjustment, so that the time-stretcher's rate changes only occasionally.
+	audioTrimStep = 0.0005
+
+	// maxAudioDrift is the audio drift to seek the audio to the clock instead of adjusting the speed.
+	maxAudioDrift = time.Second
+)
+
+// avSync measures the offset between the audio and the video, and corrects the drift of the audio from an external
+// clock.
+//
+// The video follows the master clock: the frameQueue drops the late frames and repeats the frame on screen until
+// the next frame is due. The audio follows the master clock only when the clock is the audio itself. With
+// PlayerOptions.Clock, the audio device's clock drifts from the master clock, e.g. by 50 ppm, which is about 0.4
+// seconds in 2 hours. avSync cancels the drift by changing the audio speed slightly by the time-stretcher.
+type avSync struct {
+	// offset is the moving average of the timecode of the frame on screen minus the audio position.
+	offset   time.Duration
+	measured bool
+
+	// drift is the moving average of the audio position minus the clock position.
+	drift   time.Duration
+	drifted bool
+
+	// trim is the adjustment of the audio speed.
+	trim float64
+
+	// settle is the time until which the drift is not measured.
+	settle time.Time
+}
+
+// addOffset adds a sample of the A/V offset.
+func (a *avSync) addOffset(d time.Duration) {
+	if !a.measured {
+		a.offset = d
+		a.measured = true
+		return
+	}
+	a.offset += (d - a.offset) / avSyncSmoothing
+}
+
+// addDrift adds a sample of the audio drift, and returns the new adjustment of the audio speed.
+func (a *avSync) addDrift(d time.Duration) float64 {
+	if !a.drifted {
+		a.drift = d
+		a.drifted = true
+	} else {
+		a.drift += (d - a.drift) / avSyncSmoothing
+	}
+	// The audio ahead of the clock slows down.
+	trim := -float64(a.drift) / float64(audioDriftWindow)
+	trim = min(max(trim, -maxAudioTrim), maxAudioTrim)
+	a.trim = float64(int(trim/audioTrimStep)) * audioTrimStep
+	return a.trim
+}
+
+// reset drops the drift measured so far, and waits for the audio to settle.
+// The offset is kept, as the video follows the clock anyway.
+func (a *avSync) reset() {
+	a.drift = 0
+	a.drifted = false
+	a.trim = 0
+	a.settle = time.Now().Add(avSyncSettle)
+}
+
+// AVOffset returns the moving average of the offset between the video on screen and the audio being played.
+// AVOffset is the timecode of the frame on screen minus the audio position at the time the frame is presented.
+// A frame is presented when its time comes, so AVOffset is between minus one frame interval and 0 when the audio
+// and the video are in sync. A positive AVOffset means the video is ahead of the audio.
+//
+// Without audio, the offset is from the master clock. AVOffset returns 0 until a frame is presented.
+func (p *Player) AVOffset() time.Duration {
+	return p.avSync.offset
+}
+
+// AudioDrift returns the moving average of the audio position minus the position of PlayerOptions.Clock.
+// The Player changes the audio speed slightly to keep AudioDrift around 0, up to 0.5%, and seeks the audio when
+// AudioDrift exceeds 1 second.
+//
+// AudioDrift returns 0 without PlayerOptions.Clock, as the audio is the master clock.
+func (p *Player) AudioDrift() time.Duration {
+	return p.avSync.drift
+}
+
+// updateAVSync measures the A/V offset of the frame presented at pos, and corrects the audio drift from pos.
+func (p *Player) updateAVSync(pos time.Duration) error {
+	audio := p.audioPlayer != nil && !p.paused
+	if p.videoStream != nil {
+		if tc, ok := p.videoStream.presented(); ok {
+			ref := pos
+			if audio {
+				ref = p.audioPosition()
+			}
+			p.avSync.addOffset(tc - ref)
+		}
+	}
+
+	// The clocks made by the Player follow the audio already. The audio speed differs from the clock deliberately
+	// with a playback rate other than 1.
+	if _, ok := p.clock.(clockSetter); ok || !audio || p.rate != 1 {
+		return nil
+	}
+	if time.Now().Before(p.avSync.settle) {
+		return nil
+	}
+	// The audio stops at the end.
+	if p.audioDuration > 0 && pos >= p.audioDuration {
+		return nil
+	}
+
+	trim := p.avSync.trim
+	if trim != p.avSync.addDrift(p.audioPosition()-pos) {
+		p.stretcher.setRate(p.rate * (1 + p.avSync.trim))
+	}
+	if d := p.avSync.drift; d > maxAudioDrift || d < -maxAudioDrift {
+		if err := p.audioPlayer.SetPosition(pos); err != nil {
+			return err
+		}
+		p.audioPlayer.Play()
+		p.avSync.reset()
+		p.stretcher.setRate(p.rate)
+	}
+	return nil
+}
@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"io"
+	"math"
+	"runtime/metrics"
+	"sync"
+	"time"
+)
+
+// BenchmarkResult is the result of Benchmark.
+type BenchmarkResult struct {
+	// Duration is the wall time to decode the whole input.
+	Duration time.Duration
+
+	// VideoFrames is the number of the decoded video frames.
+	VideoFrames int
+
+	// AudioDuration is the playback time of the decoded audio.
+	AudioDuration time.Duration
+
+	// ReadTime is the time spent in reading the inputs.
+	// VideoDecodeTime is the time spent in libvpx.
+	// AudioDecodeTime is the time spent in pulling the audio, including the demuxing the audio waits for.
+	ReadTime        time.Duration
+	VideoDecodeTime time.Duration
+	AudioDecodeTime time.Duration
+
+	// Allocs and AllocBytes are the number and the size of the heap allocations while decoding, and GCCycles is the
+	// number of the garbage collections. The allocations to open the inputs and the decoders are not counted.
+	// The counts are of the whole process.
+	Allocs     uint64
+	AllocBytes uint64
+	GCCycles   uint64
+
+	// VideoCRC and AudioCRC are the CRC-32 (IEEE) checksums of the decoded video frames and the decoded PCM, when
+	// BenchmarkOptions.Checksum is set. VideoCRC covers the visible pixels of the Y, Cb and Cr planes of each frame,
+	// or the RGBA pixels of a frame in another format. AudioCRC covers the interleaved stereo float32 samples,
+	// quantized by BenchmarkOptions.AudioTolerance.
+	VideoCRC uint32
+	AudioCRC uint32
+
+	// VideoFrameCRCs and AudioBlockCRCs are the checksums of each decoded video frame and each block of
+	// AudioChecksumBlock frames of the PCM, when BenchmarkOptions.ChecksumEach is set. They locate the first
+	// difference from golden checksums.
+	VideoFrameCRCs []uint32
+	AudioBlockCRCs []uint32
+
+	// Stats is the statistics of the pipeline at the end, as Player.Stats reports.
+	Stats *PlayerStats
+
+	// media is the playback time of the longer of the video and the audio.
+	media time.Duration
+}
+
+// VideoFPS returns the decoded video frames per second of the wall time.
+func (r *BenchmarkResult) VideoFPS() float64 {
+	if r.Duration == 0 {
+		return 0
+	}
+	return float64(r.VideoFrames) / r.Duration.Seconds()
+}
+
+// AudioRealTimeFactor returns the playback time of the decoded audio divided by the wall time.
+func (r *BenchmarkResult) AudioRealTimeFactor() float64 {
+	if r.Duration == 0 {
+		return 0
+	}
+	return float64(r.AudioDuration) / float64(r.Duration)
+}
+
+// AllocsPerSecond returns the heap allocations per second of the playback time.
+// Steady-state playback should allocate almost nothing, so this should be close to 0.
+func (r *BenchmarkResult) AllocsPerSecond() float64 {
+	if r.media == 0 {
+		return 0
+	}
+	return float64(r.Allocs) / r.media.Seconds()
+}
+
+// benchmarkMetrics is the runtime metrics Benchmark reports.
+var benchmarkMetrics = [...]string{
+	"/gc/heap/allocs:objects",
+	"/gc/heap/allocs:bytes",
+	"/gc/cycles/total:gc-cycles",
+}
+
+func readBenchmarkMetrics() [len(benchmarkMetrics)]uint64 {
+	var samples [len(benchmarkMetrics)]metrics.Sample
+	for i, name := range benchmarkMetrics {
+		samples[i].Name = name
+	}
+	metrics.Read(samples[:])
+	var values [len(benchmarkMetrics)]uint64
+	for i, s := range samples {
+		if s.Value.Kind() == metrics.KindUint64 {
+			values[i] = s.Value.Uint64()
+		}
+	}
+	return values
+}
+
+// BenchmarkOptions represents options for Benchmark.
+type BenchmarkOptions struct {
+	// PlayerOptions is the options of the pipeline. If PlayerOptions is nil, the default options are used.
+	// PlayerOptions.Loop is ignored, as each input is decoded once.
+	PlayerOptions *PlayerOptions
+
+	// Checksum makes Benchmark compute BenchmarkResult.VideoCRC and BenchmarkResult.AudioCRC, to detect decoder
+	// regressions. Checksum slows down the decoding slightly.
+	Checksum bool
+
+	// ChecksumEach makes Benchmark also compute BenchmarkResult.VideoFrameCRCs and BenchmarkResult.AudioBlockCRCs.
+	// ChecksumEach implies Checksum.
+	ChecksumEach bool
+
+	// AudioTolerance is the error per sample to tolerate in the audio checksums. The samples are rounded to
+	// multiples of AudioTolerance before hashing, so that float paths differing in the last bits, e.g. SIMD and
+	// scalar, can have the same checksums. A sample near a rounding boundary can still differ.
+	//
+	// If AudioTolerance is 0, the exact bits of the samples are hashed.
+	AudioTolerance float64
+}
+
+// Benchmark decodes the inputs as fast as possible without a window or an audio device, and reports the speed.
+// Benchmark runs the same pipeline as a Player, the demuxer and the video and audio decoders, but the video frames
+// are not uploaded to textures, and the audio is not resampled.
+// The inputs are taken as NewPlayerWithOptions takes.
+//
+// Benchmark can run concurrently for different inputs.
+func Benchmark(options *BenchmarkOptions, streams ...io.ReadSeeker) (*BenchmarkResult, error) {
+	if options == nil {
+		options = &BenchmarkOptions{}
+	}
+	readers := make([]*measuredReader, len(streams))
+	inputs := make([]io.ReadSeeker, len(streams))
+	for i, s := range streams {
+		readers[i] = &measuredReader{r: s}
+		inputs[i] = readers[i]
+	}
+
+	playerOptions := options.PlayerOptions
+	if playerOptions != nil && playerOptions.Loop {
+		o := *playerOptions
+		o.Loop = false
+		playerOptions = &o
+	}
+
+	start := time.Now()
+	var audioSrc io.Reader
+	var sampleRate int
+	p, err := newPlayer(playerOptions, func(audioStream *audioStream, rate float64) (audioOutput, *timeStretcher, error) {
+		sampleRate = audioStream.SamplingFrequency()
+		src, stretcher := newAudioSource(audioStream, sampleRate, rate)
+		audioSrc = src
+		return benchmarkOutput{}, stretcher, nil
+	}, nil, inputs...)
+	if err != nil {
+		return nil, err
+	}
+	defer p.Close()
+
+	r := &BenchmarkResult{}
+	checksum := options.Checksum || options.ChecksumEach
+	metricsStart := readBenchmarkMetrics()
+	var wg sync.WaitGroup
+	var audioErr error
+	if audioSrc != nil {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			buf := make([]byte, 16384)
+			var bytes int64
+			var pcm *pcmChecksum
+			if checksum {
+				pcm = newPCMChecksum(options.AudioTolerance, options.ChecksumEach)
+			}
+			start := time.Now()
+			for {
+				n, err := audioSrc.Read(buf)
+				bytes += int64(n)
+				if pcm != nil {
+					pcm.write(buf[:n])
+				}
+				if errors.Is(err, io.EOF) {
+					break
+				}
+				// The demuxer is behind the audio decoder. Retry.
+				if errors.Is(err, errAudioNotReady) {
+					continue
+				}
+				if err != nil {
+					audioErr = err
+					break
+				}
+			}
+			r.AudioDecodeTime = time.Since(start)
+			if pcm != nil {
+				r.AudioCRC = pcm.crc
+				r.AudioBlockCRCs = pcm.blockCRCs()
+			}
+			r.AudioDuration = time.Duration(bytes/bytesPerFrame) * time.Second / time.Duration(sampleRate)
+		}()
+	}
+
+	if v := p.videoStream; v != nil {
+		// The position stays 0, so the decoder never skips frames as late.
+		gen := v.seek.Gen()
+		for !v.finished() {
+			if err := v.err.Load(); err != nil {
+				// The demuxer would wait for the video decoder forever. Stop the audio decoder waiting for packets.
+				for _, s := range p.streams() {
+					s.queue.close()
+				}
+				wg.Wait()
+				return nil, *err
+			}
+			f := v.frames.front(math.MaxInt64, gen)
+			if f == nil {
+				time.Sleep(time.Millisecond)
+				continue
+			}
+			r.VideoFrames++
+			v.frames.release()
+		}
+		r.VideoDecodeTime = time.Duration(v.decodeTotal.Load())
+	}
+
+	wg.Wait()
+	if audioErr != nil {
+		return nil, audioErr
+	}
+	r.Duration = time.Since(start)
+	metricsEnd := readBenchmarkMetrics()
+	r.Allocs = metricsEnd[0] - metricsStart[0]
+	r.AllocBytes = metricsEnd[1] - metricsStart[1]
+	r.GCCycles = metricsEnd[2] - metricsStart[2]
+	r.media = max(p.VideoDuration(), r.AudioDuration)
+	r.Stats = p.Stats()
+	for _, m := range readers {
+		r.ReadTime += time.Duration(m.nanos.Load())
+	}
+	return r, nil
+}
+
+// benchmarkOutput is the audio output of Benchmark, which doesn't play. Benchmark reads the audio by itself.
+type benchmarkOutput struct{}
+
+func (benchmarkOutput) Play() {}
+
+func (benchmarkOutput) Pause() {}
+
+func (benchmarkOutput) Position() time.Duration {
+	return 0
+}
+
+func (benchmarkOutput) SetPosition(t time.Duration) error {
+	return nil
+}
+
+func (benchmarkOutput) Close() error {
+	return nil
+}
+
+func (benchmarkOutput) fade(volume float64, d time.Duration) {}
+
+func (benchmarkOutput) volume() float64 {
+	return 1
+}
+
+func (benchmarkOutput) finished() bool {
+	return true
+}
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"io"
+	"runtime"
+	"runtime/pprof"
+	"sync"
+	"time"
+)
+
+// ScalingOptions represents options for BenchmarkScaling.
+type ScalingOptions struct {
+	// BenchmarkOptions is the options of each Benchmark. PlayerOptions.CgoStats is always set, to measure the calls
+	// into C.
+	BenchmarkOptions *BenchmarkOptions
+
+	// Players is the numbers of the Players to run concurrently, a run for each.
+	//
+	// If Players is nil, 1, 2, 4, 8, 16, 32 and 64 are used.
+	Players []int
+}
+
+// ScalingResult is the result of a run of BenchmarkScaling.
+type ScalingResult struct {
+	// Players is the number of the Players run concurrently.
+	Players int
+
+	// Duration is the wall time until all the Players end.
+	Duration time.Duration
+
+	// VideoFPS is the video frames decoded by all the Players per second of Duration, and AudioRealTimeFactor is the
+	// playback time of the audio decoded by all the Players divided by Duration. They stop growing with Players
+	// where the design stops scaling.
+	VideoFPS            float64
+	AudioRealTimeFactor float64
+
+	// VideoDecodeTimeP99 and AudioDecodeTimeP99 are the 99th percentiles of the time to decode a video frame and an
+	// audio packet, as the upper bounds of the buckets of PlayerStats. They grow as the decoders contend for the CPUs.
+	// DecodeWaitTimeP99 is of the wait for PlayerOptions.DecodeScheduler.
+	VideoDecodeTimeP99 time.Duration
+	AudioDecodeTimeP99 time.Duration
+	DecodeWaitTimeP99  time.Duration
+
+	// Goroutines is the largest number of the goroutines of the process during the run, sampled every 10
+	// milliseconds. Threads is the number of the OS threads the process has created by the end of the run, as the
+	// threadcreate profile reports. The Go runtime doesn't end threads, so Threads is the peak so far.
+	Goroutines int
+	Threads    int
+
+	// CgoCalls is the number of the cgo calls of the process during the run, as runtime.NumCgoCall reports.
+	// CgoThreads is the average number of the threads in the C decoders, the time of the calls of PlayerStats.Cgo
+	// divided by Duration. A blocking cgo call holds its thread, so the runtime creates threads for the other
+	// goroutines while CgoThreads is near GOMAXPROCS.
+	CgoCalls   int64
+	CgoThreads float64
+
+	// Results is the result of each Player.
+	Results []*BenchmarkResult
+}
+
+// BenchmarkScaling runs Benchmark with Players concurrently with the inputs opened by open, for each number of
+// ScalingOptions.Players, and reports how the throughput and the scheduler work scale. open is called for each Player.
+//
+// BenchmarkScaling should not run with other decoding in the process, as the counts of the goroutines, the threads
+// and the cgo calls are of the whole process.
+func BenchmarkScaling(open func() ([]io.ReadSeeker, error), options *ScalingOptions) ([]*ScalingResult, error) {
+	if options == nil {
+		options = &ScalingOptions{}
+	}
+	counts := options.Players
+	if counts == nil {
+		counts = []int{1, 2, 4, 8, 16, 32, 64}
+	}
+
+	var benchmarkOptions BenchmarkOptions
+	if options.BenchmarkOptions != nil {
+		benchmarkOptions = *options.BenchmarkOptions
+	}
+	var playerOptions PlayerOptions
+	if benchmarkOptions.PlayerOptions != nil {
+		playerOptions = *benchmarkOptions.PlayerOptions
+	}
+	playerOptions.CgoStats = true
+	benchmarkOptions.PlayerOptions = &playerOptions
+
+	var results []*ScalingResult
+	for _, n := range counts {
+		if n <= 0 {
+			continue
+		}
+		r, err := benchmarkScaling(open, n, &benchmarkOptions)
+		if err != nil {
+			return nil, err
+		}
+		results = append(results, r)
+	}
+	return results, nil
+}
+
+func benchmarkScaling(open func() ([]io.ReadSeeker, error), n int, options *BenchmarkOptions) (*ScalingResult, error) {
+	inputs := make([][]io.ReadSeeker, n)
+	for i := range inputs {
+		streams, err := open()
+		if err != nil {
+			return nil, err
+		}
+		inputs[i] = streams
+	}
+
+	r := &ScalingResult{
+		Players: n,
+		Results: make([]*BenchmarkResult, n),
+	}
+	done := make(chan struct{})
+	sampled := make(chan struct{})
+	go func() {
+		defer close(sampled)
+		t := time.NewTicker(10 * time.Millisecond)
+		defer t.Stop()
+		for {
+			r.Goroutines = max(r.Goroutines, runtime.NumGoroutine())
+			select {
+			case <-done:
+				return
+			case <-t.C:
+			}
+		}
+	}()
+
+	cgoStart := runtime.NumCgoCall()
+	start := time.Now()
+	errs := make([]error, n)
+	var wg sync.WaitGroup
+	for i := range inputs {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			r.Results[i], errs[i] = Benchmark(options, inputs[i]...)
+		}()
+	}
+	wg.Wait()
+	r.Duration = time.Since(start)
+	r.CgoCalls = runtime.NumCgoCall() - cgoStart
+	r.Threads = pprof.Lookup("threadcreate").Count()
+	close(done)
+	<-sampled
+	if err := errors.Join(errs...); err != nil {
+		return nil, err
+	}
+
+	var frames int
+	var audio, cgo time.Duration
+	var videoDecode, audioDecode, decodeWait Histogram
+	for _, b := range r.Results {
+		frames += b.VideoFrames
+		audio += b.AudioDuration
+		videoDecode.add(&b.Stats.VideoDecodeTime)
+		audioDecode.add(&b.Stats.AudioDecodeTime)
+		decodeWait.add(&b.Stats.DecodeWaitTime)
+		c := &b.Stats.Cgo
+		cgo += c.OpusDecode.Time + c.VorbisSynthesis.Time + c.VPXDecode.Time + c.VPXGetFrame.Time
+	}
+	if r.Duration > 0 {
+		r.VideoFPS = float64(frames) / r.Duration.Seconds()
+		r.AudioRealTimeFactor = float64(audio) / float64(r.Duration)
+		r.CgoThreads = float64(cgo) / float64(r.Duration)
+	}
+	r.VideoDecodeTimeP99 = videoDecode.Quantile(0.99)
+	r.AudioDecodeTimeP99 = audioDecode.Quantile(0.99)
+	r.DecodeWaitTimeP99 = decodeWait.Quantile(0.99)
+	return r, nil
+}
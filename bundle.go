@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"runtime"
+	"sync"
+
+	"github.com/ebml-go/webm"
+
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// bundleMagic is the first bytes of a bundle file.
+const bundleMagic = "WEBMBNDL"
+
+// bundleVersion is the version of the bundle format.
+const bundleVersion = 2
+
+// A bundle file is the clips and their headers prepared for NewPlayer, in little endian:
+//
+//	magic   [8]byte  "WEBMBNDL"
+//	version uint32
+//	count   uint32
+//	entries [count]struct {
+//		nameSize    uint32
+//		name        [nameSize]byte
+//		offset      uint64 // the offset of the WebM data of the clip in the file
+//		size        uint64
+//		indexOffset uint64 // the offset of the encoded webmIndex of the clip in the file
+//		indexSize   uint64
+//	}
+//
+// and then the indexes and the data. An index is encoded by bundleEncoder with the fields in the order of
+// encodeBundleIndex.
+
+// BundleClip is a clip to write into a bundle by WriteBundle.
+type BundleClip struct {
+	// Name is the name to open the clip with Bundle.NewPlayer.
+	Name string
+
+	// Data is the WebM file.
+	Data []byte
+}
+
+// WriteBundle writes a bundle file of the WebM clips to w. The headers of the clips are parsed here, so that opening a
+// clip of the bundle doesn't parse them.
+func WriteBundle(w io.Writer, clips ...BundleClip) error {
+	names := map[string]struct{}{}
+	indexes := make([][]byte, len(clips))
+	for i, c := range clips {
+		if _, ok := names[c.Name]; ok {
+			return fmt.Errorf("webmplayer: duplicated clip name: %s", c.Name)
+		}
+		names[c.Name] = struct{}{}
+		idx, err := readWebMIndex(c.Data)
+		if err != nil {
+			return fmt.Errorf("webmplayer: parsing %s failed: %w", c.Name, err)
+		}
+		indexes[i] = encodeBundleIndex(idx)
+	}
+
+	header := binary.LittleEndian.AppendUint32([]byte(bundleMagic), bundleVersion)
+	header = binary.LittleEndian.AppendUint32(header, uint32(len(clips)))
+	offset := uint64(len(header))
+	for _, c := range clips {
+		offset += 4 + uint64(len(c.Name)) + 8*4
+	}
+	for i, c := range clips {
+		header = binary.LittleEndian.AppendUint32(header, uint32(len(c.Name)))
+		header = append(header, c.Name...)
+		header = binary.LittleEndian.AppendUint64(header, offset+uint64(len(indexes[i])))
+		header = binary.LittleEndian.AppendUint64(header, uint64(len(c.Data)))
+		header = binary.LittleEndian.AppendUint64(header, offset)
+		header = binary.LittleEndian.AppendUint64(header, uint64(len(indexes[i])))
+		offset += uint64(len(indexes[i])) + uint64(len(c.Data))
+	}
+	if _, err := w.Write(header); err != nil {
+		return err
+	}
+	for i, c := range clips {
+		if _, err := w.Write(indexes[i]); err != nil {
+			return err
+		}
+		if _, err := w.Write(c.Data); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Bundle is a bundle file of clips written by WriteBundle.
+//
+// On Linux and macOS, the file is memory-mapped, and the packets of the clips refer to the mapping. The mapping is
+// released when the Bundle and its Players are no longer referenced.
+type Bundle struct {
+	data  []byte
+	clips []bundleClip
+	names map[string]int
+}
+
+// bundleClip is a clip of a Bundle. Its index is decoded at the first Player of the clip.
+type bundleClip struct {
+	name  string
+	data  []byte
+	index []byte
+
+	once    sync.Once
+	decoded *webmIndex
+	err     error
+}
+
+// OpenBundle opens a bundle file written by WriteBundle. Only the table of the clips is read here.
+func OpenBundle(path string) (*Bundle, error) {
+	data, err := mapFile(path)
+	if err != nil {
+		return nil, err
+	}
+	b, err := newBundle(data)
+	if err != nil {
+		_ = unmapFile(data)
+		return nil, fmt.Errorf("webmplayer: %s: %w", path, err)
+	}
+	runtime.SetFinalizer(b, func(b *Bundle) {
+		_ = unmapFile(b.data)
+	})
+	return b, nil
+}
+
+func newBundle(data []byte) (*Bundle, error) {
+	if len(data) < len(bundleMagic)+8 || string(data[:len(bundleMagic)]) != bundleMagic {
+		return nil, errors.New("webmplayer: not a bundle")
+	}
+	p := data[len(bundleMagic):]
+	if v := binary.LittleEndian.Uint32(p); v != bundleVersion {
+		return nil, fmt.Errorf("webmplayer: unsupported bundle version: %d", v)
+	}
+	count := int(binary.LittleEndian.Uint32(p[4:]))
+	p = p[8:]
+
+	b := &Bundle{
+		data:  data,
+		names: make(map[string]int, count),
+	}
+	section := func(offset, size uint64) ([]byte, error) {
+		if offset > uint64(len(data)) || size > uint64(len(data))-offset {
+			return nil, errors.New("webmplayer: broken bundle")
+		}
+		return data[offset : offset+size : offset+size], nil
+	}
+	for range count {
+		if len(p) < 4 {
+			return nil, errors.New("webmplayer: broken bundle")
+		}
+		n := int(binary.LittleEndian.Uint32(p))
+		p = p[4:]
+		if len(p) < n+8*4 {
+			return nil, errors.New("webmplayer: broken bundle")
+		}
+		name := string(p[:n])
+		p = p[n:]
+		clip, err := section(binary.LittleEndian.Uint64(p), binary.LittleEndian.Uint64(p[8:]))
+		if err != nil {
+			return nil, err
+		}
+		index, err := section(binary.LittleEndian.Uint64(p[16:]), binary.LittleEndian.Uint64(p[24:]))
+		if err != nil {
+			return nil, err
+		}
+		p = p[8*4:]
+		b.names[name] = len(b.clips)
+		b.clips = append(b.clips, bundleClip{
+			name:  name,
+			data:  clip,
+			index: index,
+		})
+	}
+	return b, nil
+}
+
+// Names returns the names of the clips in the order they were written.
+func (b *Bundle) Names() []string {
+	names := make([]string, len(b.clips))
+	for i := range b.clips {
+		names[i] = b.clips[i].name
+	}
+	return names
+}
+
+// NewPlayer creates a Player of the clips of the names. A video clip and an audio clip can be specified separately,
+// like NewPlayerWithOptions.
+//
+// The headers of the clips are not parsed, and the packets refer to the bundle without copying. To reuse the
+// decoders too, set PlayerOptions.Pool.
+func (b *Bundle) NewPlayer(options *PlayerOptions, names ...string) (*Player, error) {
+	streams := make([]io.ReadSeeker, 0, len(names))
+	for _, name := range names {
+		i, ok := b.names[name]
+		if !ok {
+			return nil, fmt.Errorf("webmplayer: no clip in the bundle: %s", name)
+		}
+		c := &b.clips[i]
+		c.once.Do(func() {
+			c.decoded, c.err = decodeBundleIndex(c.index)
+		})
+		if c.err != nil {
+			return nil, fmt.Errorf("webmplayer: the index of %s is broken: %w", name, c.err)
+		}
+		m := newMemoryReader(c.data)
+		m.index = c.decoded
+		m.owner = b
+		streams = append(streams, m)
+	}
+	return NewPlayerWithOptions(options, streams...)
+}
+
+// bundleEncoder encodes the values of an index: integers as unsigned varints, and floats as 8 bytes.
+type bundleEncoder struct {
+	buf []byte
+}
+
+func (e *bundleEncoder) uint(v uint64) {
+	e.buf = binary.AppendUvarint(e.buf, v)
+}
+
+func (e *bundleEncoder) bool(v bool) {
+	if v {
+		e.uint(1)
+		return
+	}
+	e.uint(0)
+}
+
+func (e *bundleEncoder) bytes(v []byte) {
+	e.uint(uint64(len(v)))
+	e.buf = append(e.buf, v...)
+}
+
+func (e *bundleEncoder) string(v string) {
+	e.uint(uint64(len(v)))
+	e.buf = append(e.buf, v...)
+}
+
+func (e *bundleEncoder) float(v float64) {
+	e.buf = binary.LittleEndian.AppendUint64(e.buf, math.Float64bits(v))
+}
+
+// bundleDecoder decodes what bundleEncoder encodes. The first error is kept, and the values after it are zero.
+type bundleDecoder struct {
+	buf []byte
+	err error
+}
+
+func (d *bundleDecoder) uint() uint64 {
+	if d.err != nil {
+		return 0
+	}
+	v, n := binary.Uvarint(d.buf)
+	if n <= 0 {
+		d.err = errors.New("webmplayer: broken integer")
+		return 0
+	}
+	d.buf = d.buf[n:]
+	return v
+}
+
+func (d *bundleDecoder) bool() bool {
+	return d.uint() != 0
+}
+
+func (d *bundleDecoder) bytes() []byte {
+	n := d.uint()
+	if d.err != nil {
+		return nil
+	}
+	if n > uint64(len(d.buf)) {
+		d.err = io.ErrUnexpectedEOF
+		return nil
+	}
+	// A copy is returned, as the buffer is read-only memory.
+	v := make([]byte, n)
+	copy(v, d.buf)
+	d.buf = d.buf[n:]
+	return v
+}
+
+func (d *bundleDecoder) string() string {
+	n := d.uint()
+	if d.err != nil {
+		return ""
+	}
+	if n > uint64(len(d.buf)) {
+		d.err = io.ErrUnexpectedEOF
+		return ""
+	}
+	v := string(d.buf[:n])
+	d.buf = d.buf[n:]
+	return v
+}
+
+func (d *bundleDecoder) float() float64 {
+	if d.err != nil {
+		return 0
+	}
+	if len(d.buf) < 8 {
+		d.err = io.ErrUnexpectedEOF
+		return 0
+	}
+	v := math.Float64frombits(binary.LittleEndian.Uint64(d.buf))
+	d.buf = d.buf[8:]
+	return v
+}
+
+func encodeBundleIndex(idx *webmIndex) []byte {
+	var e bundleEncoder
+	m := &idx.meta
+	e.string(m.DocType)
+	e.uint(uint64(m.TimecodeScale))
+	e.float(float64(m.Duration))
+	e.uint(uint64(idx.segment))
+	e.uint(uint64(idx.segmentEnd))
+	e.uint(uint64(idx.firstCluster))
+
+	e.uint(uint64(len(m.TrackEntry)))
+	for i := range m.TrackEntry {
+		t := &m.TrackEntry[i]
+		e.uint(uint64(t.TrackNumber))
+		e.uint(t.TrackUID)
+		e.uint(uint64(t.TrackType))
+		e.string(t.Name)
+		e.string(t.Language)
+		e.string(t.CodecID)
+		e.bytes(t.CodecPrivate)
+		e.string(t.CodecName)
+		e.uint(uint64(t.CodecDelay))
+		e.uint(uint64(t.SeekPreRoll))
+		e.uint(uint64(t.PixelWidth))
+		e.uint(uint64(t.PixelHeight))
+		e.uint(uint64(t.DisplayWidth))
+		e.uint(uint64(t.DisplayHeight))
+		e.float(t.SamplingFrequency)
+		e.float(t.OutputSamplingFrequency)
+		e.uint(uint64(t.Channels))
+		e.uint(uint64(t.BitDepth))
+		c, ok := idx.colors[t.TrackNumber]
+		e.bool(ok)
+		if ok {
+			e.uint(uint64(c.colorSpace))
+			e.bool(c.fullRange)
+			e.bool(c.hasRange)
+			e.bool(c.alpha)
+		}
+	}
+
+	e.uint(uint64(len(m.CuePoint)))
+	for _, c := range m.CuePoint {
+		e.uint(c.CueTime)
+		e.uint(uint64(len(c.CueTrackPositions)))
+		for _, p := range c.CueTrackPositions {
+			e.uint(uint64(p.CueTrack))
+			e.uint(p.CueClusterPosition)
+			e.uint(uint64(p.CueBlockNumber))
+		}
+	}
+	return e.buf
+}
+
+func decodeBundleIndex(buf []byte) (*webmIndex, error) {
+	d := bundleDecoder{buf: buf}
+	idx := &webmIndex{
+		colors: map[uint]trackColor{},
+	}
+	m := &idx.meta
+	m.DocType = d.string()
+	m.TimecodeScale = uint(d.uint())
+	m.Duration = float32(d.float())
+	idx.segment = int64(d.uint())
+	idx.segmentEnd = int64(d.uint())
+	idx.firstCluster = int64(d.uint())
+
+	// The counts are bounded by the size of the buffer, as every entry takes at least a byte.
+	n := d.uint()
+	if n > uint64(len(d.buf)) {
+		return nil, io.ErrUnexpectedEOF
+	}
+	m.TrackEntry = make([]webm.TrackEntry, n)
+	for i := range m.TrackEntry {
+		t := &m.TrackEntry[i]
+		t.TrackNumber = uint(d.uint())
+		t.TrackUID = d.uint()
+		t.TrackType = uint(d.uint())
+		t.Name = d.string()
+		t.Language = d.string()
+		t.CodecID = d.string()
+		t.CodecPrivate = d.bytes()
+		t.CodecName = d.string()
+		t.CodecDelay = uint(d.uint())
+		t.SeekPreRoll = uint(d.uint())
+		t.PixelWidth = uint(d.uint())
+		t.PixelHeight = uint(d.uint())
+		t.DisplayWidth = uint(d.uint())
+		t.DisplayHeight = uint(d.uint())
+		t.SamplingFrequency = d.float()
+		t.OutputSamplingFrequency = d.float()
+		t.Channels = uint(d.uint())
+		t.BitDepth = uint(d.uint())
+		if d.bool() {
+			var c trackColor
+			c.colorSpace = vpxfb.ColorSpace(d.uint())
+			c.fullRange = d.bool()
+			c.hasRange = d.bool()
+			c.alpha = d.bool()
+			idx.colors[t.TrackNumber] = c
+		}
+	}
+
+	n = d.uint()
+	if n > uint64(len(d.buf)) {
+		return nil, io.ErrUnexpectedEOF
+	}
+	m.CuePoint = make([]webm.CuePoint, n)
+	for i := range m.CuePoint {
+		c := &m.CuePoint[i]
+		c.CueTime = d.uint()
+		n := d.uint()
+		if n > uint64(len(d.buf)) {
+			return nil, io.ErrUnexpectedEOF
+		}
+		c.CueTrackPositions = make([]webm.CueTrackPositions, n)
+		for j := range c.CueTrackPositions {
+			p := &c.CueTrackPositions[j]
+			p.CueTrack = uint(d.uint())
+			p.CueClusterPosition = d.uint()
+			p.CueBlockNumber = uint(d.uint())
+		}
+	}
+	if d.err != nil {
+		return nil, d.err
+	}
+	return idx, nil
+}
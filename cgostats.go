@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"expvar"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// CgoCallStats is the statistics of the calls of a C function by the decoders, with PlayerOptions.CgoStats.
+type CgoCallStats struct {
+	// Calls is the number of the cgo calls, and Packets is the number of the packets decoded by them. A call decodes
+	// more than one packet when the packets are batched.
+	Calls   uint64
+	Packets uint64
+
+	// BytesIn is the size of the packets given to the calls, and BytesOut is the size of the decoded PCM or pictures
+	// returned by them.
+	BytesIn  uint64
+	BytesOut uint64
+
+	// Time is the total time of the calls, including the transitions between Go and C. The cost of the transitions is
+	// about Calls times the overhead of a cgo call, tens of nanoseconds, and the rest is the time in C.
+	Time time.Duration
+}
+
+func (c *CgoCallStats) add(other *CgoCallStats) {
+	c.Calls += other.Calls
+	c.Packets += other.Packets
+	c.BytesIn += other.BytesIn
+	c.BytesOut += other.BytesOut
+	c.Time += other.Time
+}
+
+// CgoStats is the statistics of the calls into the C decoders, with PlayerOptions.CgoStats. On js, the calls into
+// WebCodecs are counted instead.
+type CgoStats struct {
+	// OpusDecode is the calls of opus_decode_float and its batches.
+	OpusDecode CgoCallStats
+
+	// VorbisSynthesis is the calls of the batches of vorbis_synthesis, vorbis_synthesis_blockin,
+	// vorbis_synthesis_pcmout and vorbis_synthesis_read, which are decoded in one cgo call.
+	VorbisSynthesis CgoCallStats
+
+	// VPXDecode and VPXGetFrame are the calls of vpx_codec_decode and vpx_codec_get_frame. VPXGetFrame counts the
+	// calls returning no frame too, and its BytesOut is the size of the planes of the frames returned.
+	VPXDecode   CgoCallStats
+	VPXGetFrame CgoCallStats
+}
+
+func (c *CgoStats) add(other *CgoStats) {
+	c.OpusDecode.add(&other.OpusDecode)
+	c.VorbisSynthesis.add(&other.VorbisSynthesis)
+	c.VPXDecode.add(&other.VPXDecode)
+	c.VPXGetFrame.add(&other.VPXGetFrame)
+}
+
+// cgoFunc is a C function counted by cgoCounters.
+type cgoFunc int
+
+const (
+	cgoOpusDecode cgoFunc = iota
+	cgoVorbisSynthesis
+	cgoVPXDecode
+	cgoVPXGetFrame
+
+	cgoFuncCount
+)
+
+// cgoCounter is a CgoCallStats updated concurrently.
+type cgoCounter struct {
+	calls    atomic.Uint64
+	packets  atomic.Uint64
+	bytesIn  atomic.Uint64
+	bytesOut atomic.Uint64
+	time     atomic.Int64
+}
+
+func (c *cgoCounter) add(packets, bytesIn, bytesOut int, d time.Duration) {
+	c.calls.Add(1)
+	c.packets.Add(uint64(packets))
+	c.bytesIn.Add(uint64(bytesIn))
+	c.bytesOut.Add(uint64(bytesOut))
+	c.time.Add(int64(d))
+}
+
+func (c *cgoCounter) snapshot() CgoCallStats {
+	return CgoCallStats{
+		Calls:    c.calls.Load(),
+		Packets:  c.packets.Load(),
+		BytesIn:  c.bytesIn.Load(),
+		BytesOut: c.bytesOut.Load(),
+		Time:     time.Duration(c.time.Load()),
+	}
+}
+
+// cgoCounters is the counters of the C functions of a stream. A nil *cgoCounters counts nothing, so that the calls
+// are not timed without PlayerOptions.CgoStats.
+type cgoCounters [cgoFuncCount]cgoCounter
+
+// cgoTotals is the counters of all the streams, which is published as the expvar webmplayer.cgo when the first stream
+// with PlayerOptions.CgoStats is created.
+var (
+	cgoTotals        cgoCounters
+	publishCgoTotals sync.Once
+)
+
+func newCgoCounters() *cgoCounters {
+	publishCgoTotals.Do(func() {
+		expvar.Publish("webmplayer.cgo", expvar.Func(func() any {
+			return cgoTotals.snapshot()
+		}))
+	})
+	return &cgoCounters{}
+}
+
+// start returns the start time of a call, or the zero time if c is nil.
+func (c *cgoCounters) start() time.Time {
+	if c == nil {
+		return time.Time{}
+	}
+	return time.Now()
+}
+
+// end counts a call of f started at start, which decoded packets of bytesIn to bytesOut.
+func (c *cgoCounters) end(f cgoFunc, start time.Time, packets, bytesIn, bytesOut int) {
+	if c == nil {
+		return
+	}
+	d := time.Since(start)
+	c[f].add(packets, bytesIn, bytesOut, d)
+	cgoTotals[f].add(packets, bytesIn, bytesOut, d)
+}
+
+func (c *cgoCounters) snapshot() CgoStats {
+	if c == nil {
+		return CgoStats{}
+	}
+	return CgoStats{
+		OpusDecode:      c[cgoOpusDecode].snapshot(),
+		VorbisSynthesis: c[cgoVorbisSynthesis].snapshot(),
+		VPXDecode:       c[cgoVPXDecode].snapshot(),
+		VPXGetFrame:     c[cgoVPXGetFrame].snapshot(),
+	}
+}
+
+// cgoCounted is implemented by the video decoders counting their C calls.
+type cgoCounted interface {
+	setCgoCounters(c *cgoCounters)
+}
+
+// packetBytes returns the total size of packets.
+func packetBytes(packets [][]byte) int {
+	var n int
+	for _, p := range packets {
+		n += len(p)
+	}
+	return n
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"hash/crc32"
+	"math"
+	"unsafe"
+)
+
+// AudioChecksumBlock is the number of the stereo frames of each checksum in BenchmarkResult.AudioBlockCRCs.
+// The blocks are of a fixed size, so that the checksums don't depend on how the decoders split the PCM.
+const AudioChecksumBlock = 4096
+
+// pcmChecksum computes the checksums of stereo float32 PCM.
+type pcmChecksum struct {
+	// tolerance is the step to quantize the samples to before hashing, or 0 to hash the exact bits.
+	tolerance float64
+
+	// blocks is true to compute the checksum of each block.
+	blocks bool
+
+	crc       uint32
+	blockCRC  uint32
+	blockLeft int
+	crcs      []uint32
+
+	quantized []byte
+}
+
+func newPCMChecksum(tolerance float64, blocks bool) *pcmChecksum {
+	return &pcmChecksum{
+		tolerance: tolerance,
+		blocks:    blocks,
+		blockLeft: AudioChecksumBlock,
+	}
+}
+
+// write hashes buf, which has whole stereo frames.
+func (c *pcmChecksum) write(buf []byte) {
+	if c.tolerance > 0 {
+		samples := unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4)
+		c.quantized = c.quantized[:0]
+		for _, s := range samples {
+			// The quantized value is hashed as an integer, so that -0 and 0 are the same.
+			q := int32(math.Round(float64(s) / c.tolerance))
+			c.quantized = binary.LittleEndian.AppendUint32(c.quantized, uint32(q))
+		}
+		buf = c.quantized
+	}
+	c.crc = crc32.Update(c.crc, crc32.IEEETable, buf)
+	if !c.blocks {
+		return
+	}
+	for len(buf) > 0 {
+		n := min(len(buf)/bytesPerFrame, c.blockLeft)
+		c.blockCRC = crc32.Update(c.blockCRC, crc32.IEEETable, buf[:n*bytesPerFrame])
+		buf = buf[n*bytesPerFrame:]
+		c.blockLeft -= n
+		if c.blockLeft == 0 {
+			c.crcs = append(c.crcs, c.blockCRC)
+			c.blockCRC = 0
+			c.blockLeft = AudioChecksumBlock
+		}
+	}
+}
+
+// blockCRCs returns the checksums of the blocks, including the last partial block.
+func (c *pcmChecksum) blockCRCs() []uint32 {
+	if c.blockLeft < AudioChecksumBlock {
+		return append(c.crcs, c.blockCRC)
+	}
+	return c.crcs
+}
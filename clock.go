@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"time"
+)
+
+// Clock is a master clock that the video of a Player follows.
+type Clock interface {
+	// Position returns the current playback position.
+	Position() time.Duration
+}
+
+// clockSetter is implemented by the clocks made by the Player, which the Player moves at seeking and speeds up by the
+// playback rate.
+type clockSetter interface {
+	set(t time.Duration)
+	setRate(rate float64)
+}
+
+// maxClockDrift is the drift between the audio position and the smoothed clock to jump to the audio position.
+const maxClockDrift = 100 * time.Millisecond
+
+// wallClock is a monotonic clock. wallClock is used when there is no audio.
+type wallClock struct {
+	start  time.Time
+	offset time.Duration
+	rate   float64
+}
+
+func newWallClock() *wallClock {
+	return &wallClock{
+		start: time.Now(),
+		rate:  1,
+	}
+}
+
+func (w *wallClock) Position() time.Duration {
+	d := time.Since(w.start)
+	if w.rate != 1 {
+		d = time.Duration(float64(d) * w.rate)
+	}
+	return w.offset + d
+}
+
+// set moves the clock to t.
+func (w *wallClock) set(t time.Duration) {
+	w.start = time.Now()
+	w.offset = t
+}
+
+// setRate changes the speed of the clock from the current position.
+func (w *wallClock) setRate(rate float64) {
+	w.set(w.Position())
+	w.rate = rate
+}
+
+// audioClock follows the audio position.
+//
+// The audio position advances in steps of the audio buffer, which would make the video judder.
+// audioClock interpolates the position by the wall clock, and corrects the drift from the audio position gradually.
+// If the drift is large, e.g. at seeking or an underrun, audioClock jumps to the audio position.
+type audioClock struct {
+	audio func() time.Duration
+	wall  *wallClock
+}
+
+func newAudioClock(audio func() time.Duration) *audioClock {
+	return &audioClock{
+		audio: audio,
+		wall:  newWallClock(),
+	}
+}
+
+func (a *audioClock) Position() time.Duration {
+	audio := a.audio()
+	wall := a.wall.Position()
+	d := audio - wall
+	if d > maxClockDrift || d < -maxClockDrift {
+		a.wall.set(audio)
+		return audio
+	}
+	t := wall + d/8
+	a.wall.set(t)
+	return t
+}
+
+// set moves the clock to t.
+func (a *audioClock) set(t time.Duration) {
+	a.wall.set(t)
+}
+
+func (a *audioClock) setRate(rate float64) {
+	a.wall.setRate(rate)
+}
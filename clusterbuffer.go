@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"io"
+	"slices"
+	"sync"
+)
+
+// maxClusterBufferSize is the maximum size of a Cluster read at once by ebmlReader. A larger Cluster is read as it is
+// parsed.
+const maxClusterBufferSize = 8 << 20
+
+// clusterBuffers is the pool of the buffers of the Clusters, so that reading the Clusters one after another doesn't
+// allocate a buffer for each.
+var clusterBuffers = sync.Pool{
+	New: func() any {
+		return new([]byte)
+	},
+}
+
+// clusterRead is a read of the element after the current Cluster, which is usually the next Cluster, in the
+// background while the current Cluster is parsed from the buffer.
+type clusterRead struct {
+	// off is the offset of buf[0] in the input, and n is the number of the bytes read.
+	off int64
+	buf *[]byte
+	n   int
+
+	// done is closed when the read finishes.
+	done chan struct{}
+}
+
+// bufferCluster makes the Cluster of size bytes whose data starts at the current offset be in the buffer, with one
+// read if it is not yet, and then starts reading the next element in the background. While the Cluster is parsed
+// from the buffer, the input is used only by the background read, so the I/O of the next Cluster overlaps the
+// parsing and the dispatching of the current one.
+//
+// bufferCluster does nothing for an input in memory, a live input, or a Cluster of unknown size or larger than
+// maxClusterBufferSize.
+func (e *ebmlReader) bufferCluster(size uint64) error {
+	if e.memory || !e.clusters || size == unknownSize || size > maxClusterBufferSize {
+		return nil
+	}
+	rest := len(e.buf) - e.head
+	if uint64(rest) < size {
+		if err := e.own(); err != nil {
+			return err
+		}
+		b := clusterBuffers.Get().(*[]byte)
+		*b = slices.Grow((*b)[:0], int(size))[:size]
+		copy(*b, e.buf[e.head:])
+		// A short read is not an error here, and the next read of the input reports it at the end of the data.
+		n, _ := io.ReadFull(e.r, (*b)[rest:])
+		e.setCluster(b, e.offset(), rest+n)
+		if uint64(rest+n) < size {
+			return nil
+		}
+	} else if uint64(rest) > size {
+		// The buffer has more than the Cluster, and the input is not at the end of the Cluster.
+		return nil
+	}
+	return e.readNext()
+}
+
+// setCluster makes the first n bytes of b, which is at off in the input, the buffer. The previous buffer of a
+// Cluster is returned to the pool.
+func (e *ebmlReader) setCluster(b *[]byte, off int64, n int) {
+	if e.cluster != nil {
+		clusterBuffers.Put(e.cluster)
+	}
+	e.cluster = b
+	e.buf = (*b)[:n]
+	e.head = 0
+	e.off = off
+}
+
+// readNext starts reading the element at the end of the buffer in the background. The element is read whole if it
+// is a Cluster of a known size up to maxClusterBufferSize, and only its header otherwise.
+func (e *ebmlReader) readNext() error {
+	if e.next != nil {
+		return nil
+	}
+	if err := e.own(); err != nil {
+		return err
+	}
+	c := &clusterRead{
+		off:  e.off + int64(len(e.buf)),
+		buf:  clusterBuffers.Get().(*[]byte),
+		done: make(chan struct{}),
+	}
+	e.next = c
+	r := e.r
+	go func() {
+		defer close(c.done)
+		// The header of a Cluster is the ID of 4 bytes and the size of at most 8 bytes.
+		b := slices.Grow((*c.buf)[:0], 12)[:12]
+		n, _ := io.ReadFull(r, b)
+		c.n = n
+		*c.buf = b
+		if n < len(b) || binary.BigEndian.Uint32(b) != 0x1f43b675 {
+			return
+		}
+		size, sn, err := parseVint(b[4:])
+		if err != nil || size == 1<<(7*sn)-1 || size > maxClusterBufferSize {
+			return
+		}
+		total := 4 + sn + int(size)
+		if total <= n {
+			return
+		}
+		b = slices.Grow(b, total-len(b))[:total]
+		m, _ := io.ReadFull(r, b[n:])
+		c.n += m
+		*c.buf = b
+	}()
+	return nil
+}
+
+// takeNext makes the background read the buffer if it is of the current offset, and reports whether it did. The
+// buffer must be read entirely.
+func (e *ebmlReader) takeNext() bool {
+	c := e.next
+	if c == nil {
+		return false
+	}
+	<-c.done
+	if c.n == 0 || c.off != e.offset() {
+		return false
+	}
+	e.next = nil
+	e.setCluster(c.buf, c.off, c.n)
+	// The input is at the end of the read, which is the end of the buffer.
+	e.moved = false
+	return true
+}
+
+// join waits for the background read and discards it if it is not taken. The input is not at the end of the buffer
+// after that, until own moves it back.
+func (e *ebmlReader) join() {
+	c := e.next
+	if c == nil {
+		return
+	}
+	<-c.done
+	e.next = nil
+	clusterBuffers.Put(c.buf)
+	e.moved = true
+}
+
+// own waits for the background read, and moves the input to the end of the buffer, so that the caller can read the
+// input.
+func (e *ebmlReader) own() error {
+	e.join()
+	if !e.moved {
+		return nil
+	}
+	if _, err := e.r.Seek(e.off+int64(len(e.buf)), io.SeekStart); err != nil {
+		return err
+	}
+	e.moved = false
+	return nil
+}
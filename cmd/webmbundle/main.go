@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// webmbundle packs WebM clips into a bundle file for webmplayer.OpenBundle.
+//
+// Usage:
+//
+//	webmbundle -o out.bundle path...
+//
+// The paths are WebM files or directories, which are searched for .webm files recursively. A clip is named by its
+// path relative to the directory with slashes, or by the base name of a file given directly. With -l, the names of
+// the clips in the bundle file of -o are listed instead.
+package main
+
+import (
+	"bytes"
+	"flag"
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+
+	"github.com/hajimehoshi/webmplayer"
+)
+
+var (
+	flagOutput = flag.String("o", "", "the bundle file to write")
+	flagList   = flag.Bool("l", false, "list the clips of the bundle file of -o")
+)
+
+func main() {
+	flag.Parse()
+	if err := xmain(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
+
+func xmain() error {
+	if *flagOutput == "" {
+		return fmt.Errorf("webmbundle: -o is required")
+	}
+	if *flagList {
+		b, err := webmplayer.OpenBundle(*flagOutput)
+		if err != nil {
+			return err
+		}
+		for _, name := range b.Names() {
+			fmt.Println(name)
+		}
+		return nil
+	}
+
+	if flag.NArg() == 0 {
+		return fmt.Errorf("webmbundle: no files")
+	}
+	clips, err := findClips(flag.Args())
+	if err != nil {
+		return err
+	}
+	var buf bytes.Buffer
+	if err := webmplayer.WriteBundle(&buf, clips...); err != nil {
+		return err
+	}
+	return os.WriteFile(*flagOutput, buf.Bytes(), 0o644)
+}
+
+// findClips reads the WebM files of the paths in order.
+func findClips(paths []string) ([]webmplayer.BundleClip, error) {
+	var clips []webmplayer.BundleClip
+	add := func(path, name string) error {
+		data, err := os.ReadFile(path)
+		if err != nil {
+			return err
+		}
+		clips = append(clips, webmplayer.BundleClip{Name: name, Data: data})
+		return nil
+	}
+	for _, path := range paths {
+		fi, err := os.Stat(path)
+		if err != nil {
+			return nil, err
+		}
+		if !fi.IsDir() {
+			if err := add(path, filepath.Base(path)); err != nil {
+				return nil, err
+			}
+			continue
+		}
+		var found []string
+		if err := filepath.WalkDir(path, func(path string, d fs.DirEntry, err error) error {
+			if err != nil {
+				return err
+			}
+			if !d.IsDir() && strings.EqualFold(filepath.Ext(path), ".webm") {
+				found = append(found, path)
+			}
+			return nil
+		}); err != nil {
+			return nil, err
+		}
+		sort.Strings(found)
+		for _, f := range found {
+			rel, err := filepath.Rel(path, f)
+			if err != nil {
+				return nil, err
+			}
+			if err := add(f, filepath.ToSlash(rel)); err != nil {
+				return nil, err
+			}
+		}
+	}
+	return clips, nil
+}
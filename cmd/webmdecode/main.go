@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// webmdecode decodes WebM files without rendering, and reports the throughput and the errors of each file.
+//
+// Usage:
+//
+//	webmdecode [flags] path...
+//
+// The paths are WebM files or directories, which are searched for .webm files recursively. The files are decoded in
+// parallel, and a JSON object is written to the standard output for each file. The exit status is 1 if any file
+// fails to decode.
+//
+// With -golden, the checksums of each video frame and each audio block are compared with the golden file, and a
+// file that differs fails. With -golden and -update, the golden file is written instead.
+//
+// With -cpuprofile, the CPU profile of the decoding is written to the file, which can be the default.pgo of the
+// application for the profile-guided optimization of the Go code. pgo.go generates the default.pgo of the main packages
+// of this module in this way, and checks that it is still representative.
+package main
+
+import (
+	"encoding/json"
+	"flag"
+	"fmt"
+	"io/fs"
+	"log/slog"
+	"os"
+	"path/filepath"
+	"runtime"
+	"runtime/pprof"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer"
+)
+
+var (
+	flagJobs      = flag.Int("j", runtime.NumCPU(), "the number of the files decoded in parallel")
+	flagThreads   = flag.Int("threads", 1, "the number of the libvpx threads for each file")
+	flagCRC       = flag.Bool("crc", false, "report the CRC-32 checksums of the decoded frames and PCM")
+	flagGolden    = flag.String("golden", "", "the JSON file of the checksums to compare with")
+	flagUpdate    = flag.Bool("update", false, "write the checksums to the -golden file instead of comparing")
+	flagTolerance = flag.Float64("tolerance", 0, "the error per audio sample to tolerate in the checksums")
+	flagProfile   = flag.String("cpuprofile", "", "the file to write the CPU profile of the decoding to")
+)
+
+// golden is the checksums of a file.
+type golden struct {
+	VideoFrameCRCs []uint32 `json:"videoFrameCRCs"`
+	AudioBlockCRCs []uint32 `json:"audioBlockCRCs"`
+}
+
+// report is the result of a file.
+type report struct {
+	Path  string `json:"path"`
+	Error string `json:"error,omitempty"`
+
+	VideoFrames   int     `json:"videoFrames"`
+	VideoFPS      float64 `json:"videoFPS"`
+	AudioSeconds  float64 `json:"audioSeconds"`
+	AudioRealTime float64 `json:"audioRealTimeFactor"`
+	Seconds       float64 `json:"seconds"`
+
+	VideoCRC *uint32 `json:"videoCRC,omitempty"`
+	AudioCRC *uint32 `json:"audioCRC,omitempty"`
+
+	// Mismatch describes the first difference from the golden checksums.
+	Mismatch string `json:"mismatch,omitempty"`
+
+	golden golden
+}
+
+func main() {
+	flag.Parse()
+	if err := xmain(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
+
+func xmain() error {
+	paths, err := findFiles(flag.Args())
+	if err != nil {
+		return err
+	}
+	if len(paths) == 0 {
+		return fmt.Errorf("webmdecode: no WebM files")
+	}
+
+	var goldens map[string]golden
+	if *flagGolden != "" && !*flagUpdate {
+		data, err := os.ReadFile(*flagGolden)
+		if err != nil {
+			return err
+		}
+		if err := json.Unmarshal(data, &goldens); err != nil {
+			return fmt.Errorf("webmdecode: invalid golden file %s: %w", *flagGolden, err)
+		}
+	}
+
+	if *flagProfile != "" {
+		f, err := os.Create(*flagProfile)
+		if err != nil {
+			return err
+		}
+		defer f.Close()
+		if err := pprof.StartCPUProfile(f); err != nil {
+			return err
+		}
+	}
+
+	start := time.Now()
+	reports := make([]report, len(paths))
+	jobs := make(chan int)
+	var wg sync.WaitGroup
+	for range max(*flagJobs, 1) {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := range jobs {
+				reports[i] = decode(paths[i])
+			}
+		}()
+	}
+	for i := range paths {
+		jobs <- i
+	}
+	close(jobs)
+	wg.Wait()
+	pprof.StopCPUProfile()
+
+	if *flagGolden != "" && *flagUpdate {
+		goldens = map[string]golden{}
+		for i := range reports {
+			if reports[i].Error == "" {
+				goldens[reports[i].Path] = reports[i].golden
+			}
+		}
+		data, err := json.MarshalIndent(goldens, "", "\t")
+		if err != nil {
+			return err
+		}
+		if err := os.WriteFile(*flagGolden, data, 0o644); err != nil {
+			return err
+		}
+	} else if goldens != nil {
+		for i := range reports {
+			if reports[i].Error != "" {
+				continue
+			}
+			g, ok := goldens[reports[i].Path]
+			if !ok {
+				reports[i].Mismatch = "not in the golden file"
+				continue
+			}
+			reports[i].Mismatch = compare(&reports[i].golden, &g)
+		}
+	}
+
+	enc := json.NewEncoder(os.Stdout)
+	var failed int
+	for i := range reports {
+		if reports[i].Error != "" || reports[i].Mismatch != "" {
+			failed++
+		}
+		if err := enc.Encode(&reports[i]); err != nil {
+			return err
+		}
+	}
+	slog.Info("Done", "files", len(paths), "failed", failed, "duration", time.Since(start))
+	if failed > 0 {
+		return fmt.Errorf("webmdecode: %d of %d files failed", failed, len(paths))
+	}
+	return nil
+}
+
+// findFiles returns the WebM files of the paths in order.
+func findFiles(paths []string) ([]string, error) {
+	var files []string
+	for _, path := range paths {
+		fi, err := os.Stat(path)
+		if err != nil {
+			return nil, err
+		}
+		if !fi.IsDir() {
+			files = append(files, path)
+			continue
+		}
+		var found []string
+		if err := filepath.WalkDir(path, func(path string, d fs.DirEntry, err error) error {
+			if err != nil {
+				return err
+			}
+			if !d.IsDir() && strings.EqualFold(filepath.Ext(path), ".webm") {
+				found = append(found, path)
+			}
+			return nil
+		}); err != nil {
+			return nil, err
+		}
+		sort.Strings(found)
+		files = append(files, found...)
+	}
+	return files, nil
+}
+
+func decode(path string) report {
+	rep := report{Path: path}
+	r, err := webmplayer.BenchmarkFromFile(&webmplayer.BenchmarkOptions{
+		PlayerOptions: &webmplayer.PlayerOptions{
+			VideoDecoderThreads: *flagThreads,
+		},
+		Checksum:       *flagCRC,
+		ChecksumEach:   *flagGolden != "",
+		AudioTolerance: *flagTolerance,
+	}, path)
+	if err != nil {
+		rep.Error = err.Error()
+		return rep
+	}
+	rep.VideoFrames = r.VideoFrames
+	rep.VideoFPS = r.VideoFPS()
+	rep.AudioSeconds = r.AudioDuration.Seconds()
+	rep.AudioRealTime = r.AudioRealTimeFactor()
+	rep.Seconds = r.Duration.Seconds()
+	if *flagCRC {
+		rep.VideoCRC = &r.VideoCRC
+		rep.AudioCRC = &r.AudioCRC
+	}
+	rep.golden = golden{
+		VideoFrameCRCs: r.VideoFrameCRCs,
+		AudioBlockCRCs: r.AudioBlockCRCs,
+	}
+	return rep
+}
+
+// compare returns the first difference between the checksums, or an empty string if there is none.
+func compare(got, want *golden) string {
+	for _, c := range []struct {
+		name      string
+		got, want []uint32
+	}{
+		{"video frame", got.VideoFrameCRCs, want.VideoFrameCRCs},
+		{"audio block", got.AudioBlockCRCs, want.AudioBlockCRCs},
+	} {
+		for i := range min(len(c.got), len(c.want)) {
+			if c.got[i] != c.want[i] {
+				return fmt.Sprintf("%s %d differs", c.name, i)
+			}
+		}
+		if len(c.got) != len(c.want) {
+			return fmt.Sprintf("%d %ss, want %d", len(c.got), c.name, len(c.want))
+		}
+	}
+	return ""
+}
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build ignore
+
+// pgo.go generates the default.pgo profiles of the main packages of this module by decoding WebM files with
+// webmdecode, and checks that a profile still speeds them up.
+//
+// Usage:
+//
+//	go run pgo.go [flags] path...
+//
+// The paths are passed to webmdecode, and should cover the codecs, the resolutions and the channel layouts the
+// applications play. The CPU profiles of -runs runs are merged, and the merged profile is written as default.pgo to the
+// directory of each main package, so that go build uses it by default.
+//
+// With -check, no profile is written. Instead, webmdecode is built with -pgo=off and with its default.pgo, both are run
+// -runs times by turns, and the check fails if the fastest run with the profile is slower than the fastest run without
+// it by more than -tolerance. A profile failing the check is no longer representative, and should be regenerated.
+package main
+
+import (
+	"bytes"
+	"flag"
+	"fmt"
+	"log/slog"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strings"
+	"time"
+)
+
+var (
+	flagRuns      = flag.Int("runs", 3, "the number of the runs of webmdecode to profile or to time")
+	flagCheck     = flag.Bool("check", false, "check the current default.pgo instead of generating it")
+	flagTolerance = flag.Float64("tolerance", 0.02, "the slowdown by the profile to tolerate with -check, as a fraction")
+)
+
+func main() {
+	flag.Parse()
+	if err := xmain(); err != nil {
+		slog.Error(err.Error())
+		os.Exit(1)
+	}
+}
+
+func xmain() error {
+	if flag.NArg() == 0 {
+		return fmt.Errorf("pgo: no WebM files or directories are specified")
+	}
+	if *flagRuns < 1 {
+		return fmt.Errorf("pgo: -runs must be positive: %d", *flagRuns)
+	}
+
+	tmp, err := os.MkdirTemp("", "webmplayer-pgo-")
+	if err != nil {
+		return err
+	}
+	defer os.RemoveAll(tmp)
+
+	if *flagCheck {
+		return check(tmp)
+	}
+	return generate(tmp)
+}
+
+// generate profiles webmdecode built without a profile, so that the profile doesn't depend on the previous one.
+func generate(tmp string) error {
+	bin := filepath.Join(tmp, "webmdecode")
+	if err := build(bin, "off"); err != nil {
+		return err
+	}
+
+	var profiles []string
+	for i := range *flagRuns {
+		p := filepath.Join(tmp, fmt.Sprintf("cpu%d.pprof", i))
+		if _, err := run(bin, "-cpuprofile", p); err != nil {
+			return err
+		}
+		profiles = append(profiles, p)
+	}
+
+	// go tool pprof -proto merges the profiles into one.
+	var merged bytes.Buffer
+	cmd := exec.Command("go", append([]string{"tool", "pprof", "-proto"}, profiles...)...)
+	cmd.Stdout = &merged
+	cmd.Stderr = os.Stderr
+	if err := cmd.Run(); err != nil {
+		return fmt.Errorf("pgo: merging the profiles failed: %w", err)
+	}
+
+	dirs, err := mainPackageDirs()
+	if err != nil {
+		return err
+	}
+	for _, dir := range dirs {
+		path := filepath.Join(dir, "default.pgo")
+		if err := os.WriteFile(path, merged.Bytes(), 0o644); err != nil {
+			return err
+		}
+		slog.Info("wrote the profile", "path", path)
+	}
+	return nil
+}
+
+func check(tmp string) error {
+	if _, err := os.Stat("default.pgo"); err != nil {
+		return fmt.Errorf("pgo: default.pgo is not found; generate it first: %w", err)
+	}
+	off := filepath.Join(tmp, "webmdecode-nopgo")
+	if err := build(off, "off"); err != nil {
+		return err
+	}
+	on := filepath.Join(tmp, "webmdecode-pgo")
+	if err := build(on, "default.pgo"); err != nil {
+		return err
+	}
+
+	// The binaries are run by turns, so that a change of the machine's load affects both alike.
+	var bestOff, bestOn time.Duration
+	for range *flagRuns {
+		d, err := run(off)
+		if err != nil {
+			return err
+		}
+		if bestOff == 0 || d < bestOff {
+			bestOff = d
+		}
+		d, err = run(on)
+		if err != nil {
+			return err
+		}
+		if bestOn == 0 || d < bestOn {
+			bestOn = d
+		}
+	}
+
+	speedup := bestOff.Seconds() / bestOn.Seconds()
+	slog.Info("timed webmdecode", "nopgo", bestOff, "pgo", bestOn, "speedup", speedup)
+	if bestOn.Seconds() > bestOff.Seconds()*(1+*flagTolerance) {
+		return fmt.Errorf("pgo: default.pgo slows webmdecode down by %.1f%%; regenerate it", (1/speedup-1)*100)
+	}
+	return nil
+}
+
+// build builds webmdecode in the current directory to bin with the -pgo flag pgo.
+func build(bin string, pgo string) error {
+	cmd := exec.Command("go", "build", "-pgo="+pgo, "-o", bin, ".")
+	cmd.Stdout = os.Stdout
+	cmd.Stderr = os.Stderr
+	if err := cmd.Run(); err != nil {
+		return fmt.Errorf("pgo: building webmdecode with -pgo=%s failed: %w", pgo, err)
+	}
+	return nil
+}
+
+// run runs the webmdecode binary bin with args and the paths, and returns the wall time. The reports of the files are
+// discarded, but a file failing to decode fails the run, as the profile would not be representative.
+func run(bin string, args ...string) (time.Duration, error) {
+	cmd := exec.Command(bin, append(args, flag.Args()...)...)
+	cmd.Stderr = os.Stderr
+	start := time.Now()
+	if err := cmd.Run(); err != nil {
+		return 0, fmt.Errorf("pgo: webmdecode failed: %w", err)
+	}
+	return time.Since(start), nil
+}
+
+// mainPackageDirs returns the directories of the main packages of this module.
+func mainPackageDirs() ([]string, error) {
+	out, err := exec.Command("go", "list", "-f", `{{if eq .Name "main"}}{{.Dir}}{{end}}`, "github.com/hajimehoshi/webmplayer/...").Output()
+	if err != nil {
+		return nil, fmt.Errorf("pgo: listing the main packages failed: %w", err)
+	}
+	return strings.Fields(string(out)), nil
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder
+
+package main
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"log/slog"
+	"os"
+	"path/filepath"
+	"strings"
+	"time"
+
+	"github.com/ebml-go/webm"
+
+	"github.com/hajimehoshi/webmplayer"
+	"github.com/hajimehoshi/webmplayer/internal/libvorbis"
+)
+
+// encodeFrames is the number of the frames read from an input at once.
+const encodeFrames = 4096
+
+// encodeFile encodes the WAV or raw PCM file input to the WebM file output.
+func encodeFile(output, input string) error {
+	if filepath.Clean(output) == filepath.Clean(input) {
+		return fmt.Errorf("webmencode: the output is the input: %s", input)
+	}
+	start := time.Now()
+
+	f, err := os.Open(input)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	r := bufio.NewReaderSize(f, 1<<16)
+	var src *pcmSource
+	if strings.EqualFold(filepath.Ext(input), ".wav") {
+		src, err = newWAVSource(r)
+	} else {
+		src, err = newPCMSource(r, *flagFormat, *flagRate, *flagChannels)
+	}
+	if err != nil {
+		return err
+	}
+
+	enc, err := libvorbis.EncoderCreate(src.channels, src.rate, float32(*flagQuality))
+	if err != nil {
+		return fmt.Errorf("webmencode: libvorbis.EncoderCreate failed: %w", err)
+	}
+	defer enc.Destroy()
+	headers, err := enc.Headers()
+	if err != nil {
+		return fmt.Errorf("webmencode: libvorbis.Encoder.Headers failed: %w", err)
+	}
+
+	if err := os.MkdirAll(filepath.Dir(output), 0o755); err != nil {
+		return err
+	}
+	out, err := os.Create(output)
+	if err != nil {
+		return err
+	}
+	defer out.Close()
+
+	track := webm.TrackEntry{
+		TrackNumber:  1,
+		TrackUID:     1,
+		TrackType:    2,
+		CodecID:      "A_VORBIS",
+		CodecPrivate: appendXiphLacing(nil, headers[:]),
+	}
+	track.SamplingFrequency = float64(src.rate)
+	track.Channels = uint(src.channels)
+	// The file is written directly, so that Muxer can seek it to write the Duration and the SeekHead.
+	m, err := webmplayer.NewMuxer(out, []webm.TrackEntry{track})
+	if err != nil {
+		return err
+	}
+
+	// A packet starts at the end of the previous packet, which is the granule position of it.
+	var pos int64
+	write := func(p *libvorbis.OggPacket) error {
+		if err := m.WritePacket(&webm.Packet{
+			Data:        p.Packet,
+			Timecode:    time.Duration(pos) * time.Second / time.Duration(src.rate),
+			TrackNumber: 1,
+			Keyframe:    true,
+		}); err != nil {
+			return err
+		}
+		pos = max(pos, p.GranulePos)
+		return nil
+	}
+
+	pcm := make([]float32, encodeFrames*src.channels)
+	for {
+		n, err := src.read(pcm)
+		if err != nil && err != io.EOF {
+			return err
+		}
+		if n == 0 {
+			break
+		}
+		if err := enc.Encode(pcm[:n], write); err != nil {
+			return fmt.Errorf("webmencode: libvorbis.Encoder.Encode failed: %w", err)
+		}
+	}
+	if err := enc.Encode(nil, write); err != nil {
+		return fmt.Errorf("webmencode: libvorbis.Encoder.Encode failed: %w", err)
+	}
+	if err := m.Close(); err != nil {
+		return err
+	}
+	if err := out.Close(); err != nil {
+		return err
+	}
+
+	d := time.Duration(pos) * time.Second / time.Duration(src.rate)
+	slog.Info("Encoded", "path", output, "duration", d, "realTimeFactor", d.Seconds()/time.Since(start).Seconds())
+	return nil
+}
+
+// appendXiphLacing appends the packets in the Xiph lacing, e.g. the headers in CodecPrivate of Vorbis, to b.
+// https://www.matroska.org/technical/notes.html#xiph-lacing
+func appendXiphLacing(b []byte, packets [][]byte) []byte {
+	b = append(b, byte(len(packets)-1))
+	for _, p := range packets[:len(packets)-1] {
+		n := len(p)
+		for ; n >= 0xff; n -= 0xff {
+			b = append(b, 0xff)
+		}
+		b = append(b, byte(n))
+	}
+	for _, p := range packets {
+		b = append(b, p...)
+	}
+	return b
+}
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder
+
+// webmencode encodes WAV and raw PCM files to WebM files of Vorbis audio, e.g. to prepare the assets of a game.
+//
+// Usage:
+//
+//	go run -tags webmplayer_encoder ./cmd/webmencode [flags] path...
+//
+// The paths are WAV files, raw PCM files, or directories, which are searched for .wav files recursively. A file whose
+// extension is not .wav is raw PCM of -format, -rate, and -channels. Each file is encoded to the file of the same name
+// with the extension .webm, in the directory of -o if it is specified, or next to the input otherwise. A file found in
+// a directory keeps its path relative to the directory under -o.
+//
+// The files are encoded in parallel, each on one core. The exit status is 1 if any file fails to encode.
+package main
+
+import (
+	"flag"
+	"fmt"
+	"io/fs"
+	"log/slog"
+	"os"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+)
+
+var (
+	flagOutput   = flag.String("o", "", "the directory to write the WebM files to, or empty to write them next to the inputs")
+	flagJobs     = flag.Int("j", runtime.NumCPU(), "the number of the files encoded in parallel")
+	flagQuality  = flag.Float64("q", 0.3, "the Vorbis quality from -0.1 to 1")
+	flagFormat   = flag.String("format", "s16le", "the sample format of raw PCM: u8, s16le, s24le, s32le, f32le, or f64le")
+	flagRate     = flag.Int("rate", 0, "the sample rate of raw PCM")
+	flagChannels = flag.Int("channels", 2, "the number of the channels of raw PCM")
+)
+
+func main() {
+	flag.Parse()
+	if err := xmain(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
+
+// job is a file to encode.
+type job struct {
+	input  string
+	output string
+}
+
+func xmain() error {
+	if *flagQuality < -0.1 || *flagQuality > 1 {
+		return fmt.Errorf("webmencode: -q must be from -0.1 to 1: %v", *flagQuality)
+	}
+	if flag.NArg() == 0 {
+		return fmt.Errorf("webmencode: no files")
+	}
+	jobs, err := findJobs(flag.Args())
+	if err != nil {
+		return err
+	}
+	if len(jobs) == 0 {
+		return fmt.Errorf("webmencode: no WAV or PCM files")
+	}
+
+	start := time.Now()
+	errs := make([]error, len(jobs))
+	ch := make(chan int)
+	var wg sync.WaitGroup
+	for range max(*flagJobs, 1) {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := range ch {
+				errs[i] = encodeFile(jobs[i].output, jobs[i].input)
+			}
+		}()
+	}
+	for i := range jobs {
+		ch <- i
+	}
+	close(ch)
+	wg.Wait()
+
+	var failed int
+	for i, err := range errs {
+		if err != nil {
+			slog.Error("Failed", "path", jobs[i].input, "error", err)
+			failed++
+		}
+	}
+	slog.Info("Done", "files", len(jobs), "failed", failed, "duration", time.Since(start))
+	if failed > 0 {
+		return fmt.Errorf("webmencode: %d of %d files failed", failed, len(jobs))
+	}
+	return nil
+}
+
+// findJobs returns the files of the paths in order, with their outputs.
+func findJobs(paths []string) ([]job, error) {
+	output := func(dir, rel string) string {
+		rel = strings.TrimSuffix(rel, filepath.Ext(rel)) + ".webm"
+		if *flagOutput == "" {
+			return filepath.Join(dir, rel)
+		}
+		return filepath.Join(*flagOutput, rel)
+	}
+
+	var jobs []job
+	for _, path := range paths {
+		fi, err := os.Stat(path)
+		if err != nil {
+			return nil, err
+		}
+		if !fi.IsDir() {
+			jobs = append(jobs, job{input: path, output: output(filepath.Dir(path), filepath.Base(path))})
+			continue
+		}
+		var found []string
+		if err := filepath.WalkDir(path, func(path string, d fs.DirEntry, err error) error {
+			if err != nil {
+				return err
+			}
+			if !d.IsDir() && strings.EqualFold(filepath.Ext(path), ".wav") {
+				found = append(found, path)
+			}
+			return nil
+		}); err != nil {
+			return nil, err
+		}
+		sort.Strings(found)
+		for _, f := range found {
+			rel, err := filepath.Rel(path, f)
+			if err != nil {
+				return nil, err
+			}
+			jobs = append(jobs, job{input: f, output: output(path, rel)})
+		}
+	}
+	return jobs, nil
+}
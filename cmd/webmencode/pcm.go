@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder
+
+package main
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"slices"
+)
+
+// pcmSource reads the samples of an input as interleaved float32 samples.
+type pcmSource struct {
+	r        io.Reader
+	rate     int
+	channels int
+
+	// sampleSize is the size of a sample in bytes, and decode converts the samples of src to dst.
+	sampleSize int
+	decode     func(dst []float32, src []byte)
+
+	buf []byte
+}
+
+// read reads whole frames into the interleaved samples dst, and returns the number of the samples. read returns
+// io.EOF at the end of the input.
+func (s *pcmSource) read(dst []float32) (int, error) {
+	frames := len(dst) / s.channels
+	s.buf = slices.Grow(s.buf[:0], frames*s.channels*s.sampleSize)[:frames*s.channels*s.sampleSize]
+	n, err := io.ReadFull(s.r, s.buf)
+	if errors.Is(err, io.ErrUnexpectedEOF) {
+		// A partial frame at the end is dropped.
+		err = nil
+	}
+	n = n / (s.channels * s.sampleSize) * s.channels
+	s.decode(dst[:n], s.buf[:n*s.sampleSize])
+	if n == 0 && err == nil {
+		err = io.EOF
+	}
+	return n, err
+}
+
+// newPCMSource returns the source of the samples in the format of format, e.g. "s16le", in r.
+func newPCMSource(r io.Reader, format string, rate, channels int) (*pcmSource, error) {
+	if rate <= 0 {
+		return nil, fmt.Errorf("webmencode: invalid sample rate: %d", rate)
+	}
+	if channels <= 0 || channels > 255 {
+		return nil, fmt.Errorf("webmencode: invalid channel count: %d", channels)
+	}
+	s := &pcmSource{
+		r:        r,
+		rate:     rate,
+		channels: channels,
+	}
+	switch format {
+	case "u8":
+		s.sampleSize = 1
+		s.decode = func(dst []float32, src []byte) {
+			for i := range dst {
+				dst[i] = (float32(src[i]) - 128) / (1 << 7)
+			}
+		}
+	case "s16le":
+		s.sampleSize = 2
+		s.decode = func(dst []float32, src []byte) {
+			for i := range dst {
+				dst[i] = float32(int16(binary.LittleEndian.Uint16(src[2*i:]))) / (1 << 15)
+			}
+		}
+	case "s24le":
+		s.sampleSize = 3
+		s.decode = func(dst []float32, src []byte) {
+			for i := range dst {
+				b := src[3*i : 3*i+3]
+				dst[i] = float32(int32(uint32(b[0])<<8|uint32(b[1])<<16|uint32(b[2])<<24)>>8) / (1 << 23)
+			}
+		}
+	case "s32le":
+		s.sampleSize = 4
+		s.decode = func(dst []float32, src []byte) {
+			for i := range dst {
+				dst[i] = float32(float64(int32(binary.LittleEndian.Uint32(src[4*i:]))) / (1 << 31))
+			}
+		}
+	case "f32le":
+		s.sampleSize = 4
+		s.decode = func(dst []float32, src []byte) {
+			for i := range dst {
+				dst[i] = math.Float32frombits(binary.LittleEndian.Uint32(src[4*i:]))
+			}
+		}
+	case "f64le":
+		s.sampleSize = 8
+		s.decode = func(dst []float32, src []byte) {
+			for i := range dst {
+				dst[i] = float32(math.Float64frombits(binary.LittleEndian.Uint64(src[8*i:])))
+			}
+		}
+	default:
+		return nil, fmt.Errorf("webmencode: unsupported sample format: %s", format)
+	}
+	return s, nil
+}
+
+// newWAVSource returns the source of the samples of the WAV file r. The chunks before the data chunk are read, and the
+// chunks after it are ignored.
+// https://www.mmsp.ece.mcgill.ca/Documents/AudioFormats/WAVE/WAVE.html
+func newWAVSource(r io.Reader) (*pcmSource, error) {
+	var h [12]byte
+	if _, err := io.ReadFull(r, h[:]); err != nil {
+		return nil, fmt.Errorf("webmencode: invalid WAV header: %w", err)
+	}
+	if string(h[:4]) != "RIFF" || string(h[8:]) != "WAVE" {
+		return nil, errors.New("webmencode: not a WAV file")
+	}
+
+	var format string
+	var rate, channels int
+	for {
+		var ch [8]byte
+		if _, err := io.ReadFull(r, ch[:]); err != nil {
+			return nil, fmt.Errorf("webmencode: no data chunk: %w", err)
+		}
+		size := int64(binary.LittleEndian.Uint32(ch[4:]))
+		switch string(ch[:4]) {
+		case "fmt ":
+			if size < 16 || size > 1<<10 {
+				return nil, fmt.Errorf("webmencode: invalid fmt chunk size: %d", size)
+			}
+			b := make([]byte, size+size%2)
+			if _, err := io.ReadFull(r, b); err != nil {
+				return nil, fmt.Errorf("webmencode: invalid fmt chunk: %w", err)
+			}
+			tag := binary.LittleEndian.Uint16(b[0:])
+			channels = int(binary.LittleEndian.Uint16(b[2:]))
+			rate = int(binary.LittleEndian.Uint32(b[4:]))
+			bits := binary.LittleEndian.Uint16(b[14:])
+			// WAVE_FORMAT_EXTENSIBLE has the format tag at the start of the sub-format GUID.
+			if tag == 0xfffe && size >= 40 {
+				tag = binary.LittleEndian.Uint16(b[24:])
+			}
+			switch {
+			case tag == 1 && bits == 8:
+				format = "u8"
+			case tag == 1 && bits == 16:
+				format = "s16le"
+			case tag == 1 && bits == 24:
+				format = "s24le"
+			case tag == 1 && bits == 32:
+				format = "s32le"
+			case tag == 3 && bits == 32:
+				format = "f32le"
+			case tag == 3 && bits == 64:
+				format = "f64le"
+			default:
+				return nil, fmt.Errorf("webmencode: unsupported WAV format: tag 0x%x, %d bits", tag, bits)
+			}
+		case "data":
+			if format == "" {
+				return nil, errors.New("webmencode: no fmt chunk before the data chunk")
+			}
+			// A streamed WAV file can have the maximum size as the size of the data chunk.
+			if size != math.MaxUint32 {
+				r = io.LimitReader(r, size)
+			}
+			return newPCMSource(r, format, rate, channels)
+		default:
+			if _, err := io.CopyN(io.Discard, r, size+size%2); err != nil {
+				return nil, fmt.Errorf("webmencode: invalid %q chunk: %w", ch[:4], err)
+			}
+		}
+	}
+}
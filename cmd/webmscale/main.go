@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// webmscale decodes a WebM file with more and more Players concurrently, as webmplayer.BenchmarkScaling does, and
+// reports where the throughput stops scaling with the CPUs.
+//
+// Usage:
+//
+//	webmscale [flags] path...
+//
+// The paths are the inputs of each Player, e.g. a video file and an audio file. A JSON object is written to the
+// standard output for each number of the Players of -n.
+package main
+
+import (
+	"encoding/json"
+	"flag"
+	"fmt"
+	"os"
+	"runtime"
+	"strconv"
+	"strings"
+
+	"github.com/hajimehoshi/webmplayer"
+)
+
+var (
+	flagPlayers = flag.String("n", "1,2,4,8,16,32,64", "the comma-separated numbers of the Players to run concurrently")
+	flagThreads = flag.Int("threads", 1, "the number of the libvpx threads for each Player")
+)
+
+// report is the result of a number of the Players.
+type report struct {
+	Players    int `json:"players"`
+	GOMAXPROCS int `json:"gomaxprocs"`
+
+	Seconds       float64 `json:"seconds"`
+	VideoFPS      float64 `json:"videoFPS"`
+	AudioRealTime float64 `json:"audioRealTimeFactor"`
+
+	VideoDecodeP99 float64 `json:"videoDecodeP99Seconds"`
+	AudioDecodeP99 float64 `json:"audioDecodeP99Seconds"`
+	DecodeWaitP99  float64 `json:"decodeWaitP99Seconds"`
+
+	Goroutines int     `json:"goroutines"`
+	Threads    int     `json:"threads"`
+	CgoCalls   int64   `json:"cgoCalls"`
+	CgoThreads float64 `json:"cgoThreads"`
+}
+
+func main() {
+	flag.Parse()
+	if err := xmain(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
+
+func xmain() error {
+	if flag.NArg() == 0 {
+		return fmt.Errorf("webmscale: an input file is required")
+	}
+	var players []int
+	for _, s := range strings.Split(*flagPlayers, ",") {
+		n, err := strconv.Atoi(strings.TrimSpace(s))
+		if err != nil || n <= 0 {
+			return fmt.Errorf("webmscale: invalid -n: %q", *flagPlayers)
+		}
+		players = append(players, n)
+	}
+
+	results, err := webmplayer.BenchmarkScalingFromFile(&webmplayer.ScalingOptions{
+		BenchmarkOptions: &webmplayer.BenchmarkOptions{
+			PlayerOptions: &webmplayer.PlayerOptions{
+				VideoDecoderThreads: *flagThreads,
+			},
+		},
+		Players: players,
+	}, flag.Args()...)
+	if err != nil {
+		return err
+	}
+
+	enc := json.NewEncoder(os.Stdout)
+	for _, r := range results {
+		if err := enc.Encode(&report{
+			Players:        r.Players,
+			GOMAXPROCS:     runtime.GOMAXPROCS(0),
+			Seconds:        r.Duration.Seconds(),
+			VideoFPS:       r.VideoFPS,
+			AudioRealTime:  r.AudioRealTimeFactor,
+			VideoDecodeP99: r.VideoDecodeTimeP99.Seconds(),
+			AudioDecodeP99: r.AudioDecodeTimeP99.Seconds(),
+			DecodeWaitP99:  r.DecodeWaitTimeP99.Seconds(),
+			Goroutines:     r.Goroutines,
+			Threads:        r.Threads,
+			CgoCalls:       r.CgoCalls,
+			CgoThreads:     r.CgoThreads,
+		}); err != nil {
+			return err
+		}
+	}
+	return nil
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// webmtrim copies an excerpt of a WebM file to a new WebM file without decoding, as webmplayer.Trim does.
+//
+// Usage:
+//
+//	webmtrim -start 1m30s -end 2m -o out.webm in.webm
+//
+// The excerpt starts at the last video keyframe at or before -start, and ends before -end. Without -end, the excerpt
+// ends at the end of the input.
+package main
+
+import (
+	"bufio"
+	"flag"
+	"fmt"
+	"os"
+
+	"github.com/hajimehoshi/webmplayer"
+)
+
+var (
+	flagOutput = flag.String("o", "", "the WebM file to write")
+	flagStart  = flag.Duration("start", 0, "the start time")
+	flagEnd    = flag.Duration("end", 0, "the end time, or 0 for the end of the input")
+)
+
+func main() {
+	flag.Parse()
+	if err := xmain(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		os.Exit(1)
+	}
+}
+
+func xmain() error {
+	if *flagOutput == "" {
+		return fmt.Errorf("webmtrim: -o is required")
+	}
+	if flag.NArg() != 1 {
+		return fmt.Errorf("webmtrim: one input file is required")
+	}
+
+	f, err := os.Create(*flagOutput)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+
+	w := bufio.NewWriterSize(f, 1<<20)
+	if err := webmplayer.TrimFromFile(w, flag.Arg(0), &webmplayer.TrimOptions{
+		Start: *flagStart,
+		End:   *flagEnd,
+	}); err != nil {
+		return err
+	}
+	if err := w.Flush(); err != nil {
+		return err
+	}
+	return f.Close()
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// trackColor is the Colour element of a video track. The zero value is unspecified, and the color space of the
+// bitstream is used then. alpha is the AlphaMode of the track, which makes the BlockAdditionals of BlockAddID 1 the
+// alpha channel of the frames.
+type trackColor struct {
+	colorSpace vpxfb.ColorSpace
+	fullRange  bool
+	hasRange   bool
+	alpha      bool
+}
+
+// hasColour reports whether c has the values of a Colour element.
+func (c trackColor) hasColour() bool {
+	return c.colorSpace != vpxfb.ColorSpaceUnknown || c.hasRange
+}
+
+// apply returns the color space and the range of a frame, preferring c to the ones of the bitstream.
+func (c trackColor) apply(cs vpxfb.ColorSpace, fullRange bool) (vpxfb.ColorSpace, bool) {
+	if c.colorSpace != vpxfb.ColorSpaceUnknown {
+		cs = c.colorSpace
+	}
+	if c.hasRange {
+		fullRange = c.fullRange
+	}
+	return cs, fullRange
+}
+
+// matrixColorSpace returns the color space of the MatrixCoefficients v, as ISO/IEC 23091-4, or ColorSpaceUnknown if
+// the matrix is not supported.
+func matrixColorSpace(v uint64) vpxfb.ColorSpace {
+	switch v {
+	case 1:
+		return vpxfb.ColorSpaceBT709
+	case 5, 6:
+		return vpxfb.ColorSpaceBT601
+	case 7:
+		return vpxfb.ColorSpaceSMPTE240
+	case 9, 10:
+		return vpxfb.ColorSpaceBT2020
+	}
+	return vpxfb.ColorSpaceUnknown
+}
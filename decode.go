@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"image"
+	"io"
+	"runtime"
+	"sort"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+const defaultDecodeBufferedFrames = 64
+
+// DecodeOptions represents options for DecodeVideo.
+type DecodeOptions struct {
+	// Workers is the number of the segments decoded in parallel. Each worker has its own reader and video decoder.
+	//
+	// If Workers is 0, the number of the CPUs is used.
+	Workers int
+
+	// VideoDecoderThreads is the number of threads the video decoder uses in each worker. If VideoDecoderThreads is 0, 1 is used.
+	VideoDecoderThreads int
+
+	// VideoTrack is the track number of the video. If VideoTrack is 0, the first video track is used.
+	VideoTrack uint
+
+	// VideoTargetWidth and VideoTargetHeight downscale the frames as PlayerOptions.VideoTargetWidth and
+	// PlayerOptions.VideoTargetHeight do.
+	VideoTargetWidth  int
+	VideoTargetHeight int
+
+	// BufferedFrames is the number of the decoded frames that the workers can keep ahead of the callback.
+	// The workers ahead wait when the buffer is full, so a larger buffer keeps more workers busy at the cost of memory.
+	//
+	// If BufferedFrames is 0, 64 is used.
+	BufferedFrames int
+}
+
+// VideoFrame is a frame delivered by DecodeVideo.
+type VideoFrame struct {
+	Timecode time.Duration
+
+	// Image is an *image.YCbCr or an *image.RGBA. Image is valid only during the callback.
+	Image image.Image
+}
+
+// DecodeVideo decodes all the video frames of an input as fast as possible, and calls f with each frame in the
+// presentation order. f is called on the caller's goroutine.
+//
+// The input is split into segments at the Cues of the video track, and the segments are decoded in parallel, each
+// from its first keyframe to the first keyframe of the next segment. open is called for each worker to open its own
+// reader of the same input. Without Cues, the input is decoded by one worker.
+//
+// If f returns an error, DecodeVideo stops and returns the error. The audio is not decoded.
+func DecodeVideo(open func() (io.ReadSeeker, error), options *DecodeOptions, f func(frame *VideoFrame) error) error {
+	if options == nil {
+		options = &DecodeOptions{}
+	}
+	workers := options.Workers
+	if workers <= 0 {
+		workers = runtime.NumCPU()
+	}
+	buffered := options.BufferedFrames
+	if buffered <= 0 {
+		buffered = defaultDecodeBufferedFrames
+	}
+
+	// The first reader finds the segments, and is used by the first worker.
+	r, err := open()
+	if err != nil {
+		return err
+	}
+	var meta webm.WebM
+	reader, _, err := parseWebM(r, &meta)
+	if err != nil {
+		return err
+	}
+	track, err := findTrack(&meta, options.VideoTrack, (*webm.TrackEntry).IsVideo)
+	if err != nil {
+		closeReader(reader)
+		return err
+	}
+	if track == nil {
+		closeReader(reader)
+		return fmt.Errorf("webmplayer: no video track")
+	}
+
+	starts := segmentStarts(&meta, track.TrackNumber)
+	workers = min(workers, len(starts))
+	d := &segmentDecoder{
+		starts:       starts,
+		track:        track.TrackNumber,
+		codec:        videoCodec(track.CodecID),
+		codecPrivate: track.CodecPrivate,
+		threads:      max(options.VideoDecoderThreads, 1),
+		width:        options.VideoTargetWidth,
+		height:       options.VideoTargetHeight,
+		buffer:       newReorderBuffer(len(starts), buffered),
+	}
+
+	var wg sync.WaitGroup
+	for i := range workers {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			reader := reader
+			if i > 0 {
+				r, err := open()
+				if err != nil {
+					d.buffer.fail(err)
+					return
+				}
+				var meta webm.WebM
+				reader, _, err = parseWebM(r, &meta)
+				if err != nil {
+					d.buffer.fail(err)
+					return
+				}
+			}
+			defer closeReader(reader)
+			if err := d.work(reader); err != nil {
+				d.buffer.fail(err)
+			}
+		}()
+	}
+	defer wg.Wait()
+
+	var frame VideoFrame
+	for {
+		vf, err := d.buffer.pop()
+		if err != nil {
+			return err
+		}
+		if vf == nil {
+			return nil
+		}
+		frame.Timecode = vf.timecode
+		frame.Image = vf.image()
+		err = f(&frame)
+		d.frames.Put(vf)
+		if err != nil {
+			d.buffer.fail(err)
+			return err
+		}
+	}
+}
+
+// DecodeVideoFromFile runs DecodeVideo with a local WebM file, which is opened as NewPlayerFromFile opens for each
+// worker.
+func DecodeVideoFromFile(path string, options *DecodeOptions, f func(frame *VideoFrame) error) error {
+	return DecodeVideo(func() (io.ReadSeeker, error) {
+		return openFile(path)
+	}, options, f)
+}
+
+// segmentStarts returns the start times of the segments by the Cues of the video track. The first segment starts at
+// the start of the input.
+func segmentStarts(meta *webm.WebM, track uint) []time.Duration {
+	scale := time.Duration(meta.TimecodeScale)
+	if scale == 0 {
+		scale = time.Millisecond
+	}
+	starts := []time.Duration{0}
+	for _, c := range meta.CuePoint {
+		for _, p := range c.CueTrackPositions {
+			if p.CueTrack == track {
+				if t := time.Duration(c.CueTime) * scale; t > 0 {
+					starts = append(starts, t)
+				}
+				break
+			}
+		}
+	}
+	sort.Slice(starts, func(i, j int) bool {
+		return starts[i] < starts[j]
+	})
+	return compactDurations(starts)
+}
+
+func compactDurations(ts []time.Duration) []time.Duration {
+	var n int
+	for i, t := range ts {
+		if i == 0 || t != ts[n-1] {
+			ts[n] = t
+			n++
+		}
+	}
+	return ts[:n]
+}
+
+// segmentDecoder is the state shared by the workers of DecodeVideo.
+type segmentDecoder struct {
+	starts []time.Duration
+	track  uint
+	codec  videoCodec
+	// codecPrivate is the CodecPrivate of the track.
+	codecPrivate []byte
+	threads      int
+	width        int
+	height       int
+
+	// next is the index of the next segment to decode.
+	next atomic.Int64
+
+	buffer *reorderBuffer
+
+	// frames is the pool of the frames returned by the callback.
+	frames sync.Pool
+}
+
+// work decodes the segments taken one by one with reader and its own video decoder.
+func (d *segmentDecoder) work(reader *webmReader) error {
+	decoder, err := newVideoDecoder(d.codec, d.threads)
+	if err != nil {
+		return err
+	}
+	defer decoder.destroy()
+	if err := decoder.start(d.codecPrivate); err != nil {
+		return err
+	}
+
+	for {
+		i := int(d.next.Add(1) - 1)
+		if i >= len(d.starts) {
+			return nil
+		}
+		if err := d.decodeSegment(reader, decoder, i); err != nil {
+			return err
+		}
+		d.buffer.finish(i)
+	}
+}
+
+// decodeSegment decodes the frames from the first keyframe at or after the start of the segment i to the first
+// keyframe at or after the start of the next segment. The first segment starts at the first packet, which the reader
+// is at after parsing. The first segment is always taken first, so its worker's reader hasn't moved yet.
+func (d *segmentDecoder) decodeSegment(reader *webmReader, decoder videoDecoder, i int) error {
+	start := d.starts[i]
+	end := time.Duration(-1)
+	if i+1 < len(d.starts) {
+		end = d.starts[i+1]
+	}
+
+	var pkt demuxPacket
+	var ok bool
+	if i == 0 {
+		pkt, ok = <-reader.Chan
+	} else {
+		pkt, ok = seekReader(reader, start)
+	}
+	started := i == 0
+	for ; ok && pkt.Timecode != webm.BadTC; pkt, ok = <-reader.Chan {
+		if pkt.TrackNumber != d.track || len(pkt.Data) == 0 {
+			continue
+		}
+		keyframe := pkt.Keyframe || parseVPXFrame(d.codec, pkt.Data).keyframe
+		if !started {
+			if !keyframe || pkt.Timecode < start {
+				continue
+			}
+			started = true
+		} else if keyframe && end >= 0 && pkt.Timecode >= end {
+			return nil
+		}
+
+		if err := decoder.decode(pkt.Data); err != nil {
+			return err
+		}
+		for {
+			p, ok, err := decoder.next()
+			if err != nil {
+				return err
+			}
+			if !ok {
+				break
+			}
+			f, _ := d.frames.Get().(*videoFrame)
+			if f == nil {
+				f = &videoFrame{}
+			}
+			f.timecode = pkt.Timecode
+			f.setImage(&p, d.width, d.height)
+			if !d.buffer.push(i, f) {
+				// The decoding has stopped.
+				return nil
+			}
+		}
+	}
+	return nil
+}
+
+// reorderFrontFrames is the number of the frames the front segment can queue even when the buffer is full, so that
+// the callback never waits for a worker that waits for the buffer.
+const reorderFrontFrames = 4
+
+// reorderBuffer passes the frames of the segments decoded in parallel to the consumer in the segment order.
+type reorderBuffer struct {
+	m    sync.Mutex
+	cond sync.Cond
+
+	segments []segmentFrames
+
+	// front is the segment the consumer takes the frames from.
+	front int
+
+	// buffered is the number of the frames in all the segments, and limit is the maximum of buffered.
+	buffered int
+	limit    int
+
+	err error
+}
+
+type segmentFrames struct {
+	frames []*videoFrame
+	done   bool
+}
+
+func newReorderBuffer(segments, limit int) *reorderBuffer {
+	r := &reorderBuffer{
+		segments: make([]segmentFrames, segments),
+		limit:    limit,
+	}
+	r.cond.L = &r.m
+	return r
+}
+
+// push adds a frame of the segment i. push waits while the buffer is full. push reports false if the decoding has
+// stopped by an error.
+func (r *reorderBuffer) push(i int, f *videoFrame) bool {
+	r.m.Lock()
+	defer r.m.Unlock()
+	for r.err == nil && r.buffered >= r.limit && !(i == r.front && len(r.segments[i].frames) < reorderFrontFrames) {
+		r.cond.Wait()
+	}
+	if r.err != nil {
+		return false
+	}
+	r.segments[i].frames = append(r.segments[i].frames, f)
+	r.buffered++
+	r.cond.Broadcast()
+	return true
+}
+
+// finish marks the end of the frames of the segment i.
+func (r *reorderBuffer) finish(i int) {
+	r.m.Lock()
+	defer r.m.Unlock()
+	r.segments[i].done = true
+	r.cond.Broadcast()
+}
+
+// fail stops the decoding with err. The first error is kept.
+func (r *reorderBuffer) fail(err error) {
+	r.m.Lock()
+	defer r.m.Unlock()
+	if r.err == nil {
+		r.err = err
+	}
+	r.cond.Broadcast()
+}
+
+// pop returns the next frame in the order, or nil at the end.
+func (r *reorderBuffer) pop() (*videoFrame, error) {
+	r.m.Lock()
+	defer r.m.Unlock()
+	for {
+		if r.err != nil {
+			return nil, r.err
+		}
+		if r.front == len(r.segments) {
+			return nil, nil
+		}
+		s := &r.segments[r.front]
+		if len(s.frames) > 0 {
+			f := s.frames[0]
+			s.frames[0] = nil
+			s.frames = s.frames[1:]
+			r.buffered--
+			r.cond.Broadcast()
+			return f, nil
+		}
+		if s.done {
+			r.front++
+			// The new front segment might wait for the buffer.
+			r.cond.Broadcast()
+			continue
+		}
+		r.cond.Wait()
+	}
+}
+
+// seekReader seeks reader to t, and returns the first packet after the seek, which has Rebase.
+// The packets before it are from the previous position. seekReader reports false if the reader has closed.
+func seekReader(reader *webmReader, t time.Duration) (demuxPacket, bool) {
+	// webmReader.Seek can block until the reader sends its current packet.
+	go reader.Seek(t)
+	for pkt := range reader.Chan {
+		if pkt.Rebase {
+			return pkt, true
+		}
+	}
+	return demuxPacket{}, false
+}
+
+// closeReader shuts reader down. The reader waits for its packets to be received until it closes the channel.
+func closeReader(reader *webmReader) {
+	go func() {
+		for range reader.Chan {
+		}
+	}()
+	reader.Shutdown()
+}
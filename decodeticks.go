@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"sync"
+	"time"
+)
+
+// decodeTicks runs the decode steps of a video decoder only within the ticks of Player.Update, with
+// PlayerOptions.DecodeBudget. A step is a decode call of a packet or a call getting its frame, which can't be
+// interrupted, so the steps resume at the next tick where the previous tick stopped.
+//
+// The decoder goroutine waits at step between the ticks. A tick lets it run until the budget is spent, or until it
+// goes idle waiting for packets or for a free frame slot, whichever comes first. A step started before the end of
+// the budget is finished after the tick, so the decoding outside the ticks is at most one step each.
+type decodeTicks struct {
+	budget time.Duration
+
+	m sync.Mutex
+
+	// deadline is the end of the current tick, or zero between the ticks.
+	deadline time.Time
+
+	// wake is notified when a tick starts, and yield is notified when the decoder stops for the tick.
+	wake  chan struct{}
+	yield chan struct{}
+
+	// done is closed when the decoder is closed.
+	done <-chan struct{}
+}
+
+func newDecodeTicks(budget time.Duration, done <-chan struct{}) *decodeTicks {
+	return &decodeTicks{
+		budget: budget,
+		wake:   make(chan struct{}, 1),
+		yield:  make(chan struct{}, 1),
+		done:   done,
+	}
+}
+
+// tick lets the decoder run for the budget, and returns when the decoder stops for the tick or the budget is spent.
+// t can be nil, and then tick does nothing.
+func (t *decodeTicks) tick() {
+	if t == nil {
+		return
+	}
+	// A yield of the previous tick after it ended is stale.
+	select {
+	case <-t.yield:
+	default:
+	}
+	t.m.Lock()
+	t.deadline = time.Now().Add(t.budget)
+	t.m.Unlock()
+	notify(t.wake)
+
+	timer := time.NewTimer(t.budget)
+	select {
+	case <-t.yield:
+	case <-timer.C:
+	case <-t.done:
+	}
+	timer.Stop()
+
+	t.m.Lock()
+	t.deadline = time.Time{}
+	t.m.Unlock()
+}
+
+// step waits for a tick with the budget left before a decode step. step returns immediately if the decoder is closed,
+// and the decoder stops at its next wait. t can be nil, and then step returns immediately.
+func (t *decodeTicks) step() {
+	if t == nil {
+		return
+	}
+	for {
+		t.m.Lock()
+		deadline := t.deadline
+		t.m.Unlock()
+		if !deadline.IsZero() {
+			if time.Now().Before(deadline) {
+				return
+			}
+			notify(t.yield)
+		}
+		select {
+		case <-t.wake:
+		case <-t.done:
+			return
+		}
+	}
+}
+
+// idle ends the current tick before the decoder waits for something other than a tick. t can be nil.
+func (t *decodeTicks) idle() {
+	if t == nil {
+		return
+	}
+	t.m.Lock()
+	inTick := !t.deadline.IsZero()
+	t.m.Unlock()
+	if inTick {
+		notify(t.yield)
+	}
+}
+
+// notify sends to the channel c of the capacity 1 without blocking.
+func notify(c chan struct{}) {
+	select {
+	case c <- struct{}{}:
+	default:
+	}
+}
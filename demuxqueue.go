@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"sync"
+	"time"
+)
+
+// demuxQueue holds the packets routed from the reader to the decoders.
+//
+// Each track has its own queue bounded by the duration and the bytes of its packets, instead of the number of packets.
+// When a track has filled its read-ahead window, the reader waits for the track's decoder,
+// unless another track has no packets. Then the reader keeps reading up to the byte limit so that the other decoder
+// is not stalled behind the slower one, e.g. when audio and video are interleaved with a large skew.
+//
+// The reader and each consumer wait on their own conditions, and are woken only when they can proceed. A reader
+// waiting for a full queue is woken when a queue drains to three quarters, so that the reader pushes the packets in
+// batches instead of waking up for every packet taken.
+//
+// The packets are accounted in the memory budget, and the limits are a quarter while the memory is over the budget.
+type demuxQueue struct {
+	mu sync.Mutex
+
+	// space is the condition the reader waits on. waiting is the queue the reader waits for, or nil.
+	space   sync.Cond
+	waiting *packetQueue
+
+	tracks []*packetQueue
+
+	readAhead time.Duration
+	maxBytes  int
+
+	// paused is true while the player is paused. The reader and the parking decoders wait while paused.
+	paused bool
+	closed bool
+}
+
+// packetQueue is the queue of a track in a demuxQueue.
+type packetQueue struct {
+	d       *demuxQueue
+	packets []packet
+	bytes   int
+
+	// ready is the condition the consumer waits on, and waiting is true while the consumer waits.
+	ready   sync.Cond
+	waiting bool
+
+	// lookahead is true when no decoder consumes the track, e.g. an alternate audio track.
+	// A lookahead queue never blocks the reader, and keeps only the latest packets so that the track can be switched to
+	// without seeking.
+	lookahead bool
+
+	// parks is true if the consumer waits while the queue is paused, e.g. the video decoder.
+	// The audio decoder doesn't park, as the audio player doesn't pull packets while paused.
+	parks bool
+}
+
+func newDemuxQueue(readAhead time.Duration, maxBytes int) *demuxQueue {
+	d := &demuxQueue{
+		readAhead: readAhead,
+		maxBytes:  maxBytes,
+	}
+	d.space.L = &d.mu
+	return d
+}
+
+// newTrack adds a track queue. newTrack must be called before the queue is used.
+func (d *demuxQueue) newTrack() *packetQueue {
+	q := &packetQueue{d: d}
+	q.ready.L = &d.mu
+	d.tracks = append(d.tracks, q)
+	return q
+}
+
+// broadcast wakes the reader and all the consumers up. d.mu must be locked.
+func (d *demuxQueue) broadcast() {
+	d.space.Broadcast()
+	for _, q := range d.tracks {
+		q.ready.Broadcast()
+	}
+}
+
+// setLookahead sets whether q is a lookahead queue.
+func (q *packetQueue) setLookahead(lookahead bool) {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	q.lookahead = lookahead
+	d.broadcast()
+}
+
+// pause pauses or resumes the reader and the parking consumers.
+func (d *demuxQueue) pause(paused bool) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.paused = paused
+	d.broadcast()
+}
+
+// flush discards all the packets in the queue.
+func (d *demuxQueue) flush() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for _, q := range d.tracks {
+		trackMemory(memoryDemuxQueues, -int64(q.bytes))
+		clear(q.packets)
+		q.packets = q.packets[:0]
+		q.bytes = 0
+	}
+	d.broadcast()
+}
+
+// close notifies the consumers that no more packets come.
+func (d *demuxQueue) close() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.closed = true
+	d.broadcast()
+}
+
+// push appends pkt to q. push blocks while q is full or the queue is paused.
+// push discards pkt if the queue is closed.
+func (q *packetQueue) push(pkt packet) {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for !d.closed && (d.paused || (!q.lookahead && q.full())) {
+		d.waiting = q
+		d.space.Wait()
+	}
+	d.waiting = nil
+	if d.closed {
+		return
+	}
+	q.packets = append(q.packets, pkt)
+	q.bytes += len(pkt.Data)
+	dropped := 0
+	if q.lookahead {
+		// Keep twice the read-ahead window, as the playback position can be behind the reader by the window.
+		readAhead, maxBytes := d.limits()
+		for len(q.packets) > 1 && (q.bytes > maxBytes || q.packets[len(q.packets)-1].Timecode-q.packets[0].Timecode > 2*readAhead) {
+			dropped += len(q.packets[0].Data)
+			q.bytes -= len(q.packets[0].Data)
+			q.packets[0] = packet{}
+			q.packets = q.packets[1:]
+		}
+	}
+	trackMemory(memoryDemuxQueues, int64(len(pkt.Data)-dropped))
+	if q.waiting {
+		q.ready.Signal()
+	}
+}
+
+// pop removes the oldest packet from q. pop blocks while q is empty, or while the queue is paused if q parks.
+// pop returns false when q is empty and the queue is closed.
+func (q *packetQueue) pop() (packet, bool) {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for (len(q.packets) == 0 || (q.parks && d.paused)) && !d.closed {
+		q.wait()
+	}
+	return q.take()
+}
+
+// empty reports whether pop would block.
+func (q *packetQueue) empty() bool {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	return (len(q.packets) == 0 || (q.parks && d.paused)) && !d.closed
+}
+
+// popTimeout is pop that waits up to timeout. popTimeout returns true for timedOut if no packet comes in time.
+func (q *packetQueue) popTimeout(timeout time.Duration) (pkt packet, ok bool, timedOut bool) {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	var expired bool
+	var timer *time.Timer
+	for (len(q.packets) == 0 || (q.parks && d.paused)) && !d.closed {
+		if expired {
+			return packet{}, false, true
+		}
+		if timer == nil {
+			timer = time.AfterFunc(timeout, func() {
+				d.mu.Lock()
+				defer d.mu.Unlock()
+				expired = true
+				q.ready.Broadcast()
+			})
+			defer timer.Stop()
+		}
+		q.wait()
+	}
+	pkt, ok = q.take()
+	return pkt, ok, false
+}
+
+// popBatch removes the packets of the seek generation gen that are already in q, up to n packets, without waiting,
+// and appends them to dst. popBatch stops at the end of the stream and at an empty packet, which are left in q.
+func (q *packetQueue) popBatch(dst []packet, n int, gen uint64) []packet {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if q.parks && d.paused {
+		return dst
+	}
+	for i := 0; i < n && len(q.packets) > 0; i++ {
+		if pkt := q.packets[0]; pkt.gen != gen || pkt.eos || len(pkt.Data) == 0 {
+			break
+		}
+		pkt, _ := q.take()
+		dst = append(dst, pkt)
+	}
+	return dst
+}
+
+// buffered reports whether q has packets spanning t, or up to the read-ahead window if t is longer.
+// buffered also reports true if no more packets are needed to start, i.e. at the end of the stream or closing.
+func (q *packetQueue) buffered(t time.Duration) bool {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.closed {
+		return true
+	}
+	if len(q.packets) == 0 {
+		return false
+	}
+	last := q.packets[len(q.packets)-1]
+	readAhead, maxBytes := d.limits()
+	return last.eos || q.bytes >= maxBytes || last.Timecode-q.packets[0].Timecode >= min(t, readAhead)
+}
+
+// take removes the oldest packet from q. take returns false if q is empty. d.mu must be locked.
+func (q *packetQueue) take() (packet, bool) {
+	d := q.d
+	if len(q.packets) == 0 {
+		return packet{}, false
+	}
+	pkt := q.packets[0]
+	q.packets[0] = packet{}
+	q.packets = q.packets[1:]
+	q.bytes -= len(pkt.Data)
+	trackMemory(memoryDemuxQueues, -int64(len(pkt.Data)))
+	if w := d.waiting; w != nil && !w.full() && d.drained() {
+		d.space.Signal()
+	}
+	return pkt, true
+}
+
+// wait waits for a packet or a change of the queue state. d.mu must be locked.
+func (q *packetQueue) wait() {
+	q.waiting = true
+	q.ready.Wait()
+	q.waiting = false
+}
+
+// drained reports whether any queue consumed by a decoder has drained to three quarters of the limits, so that the
+// reader should push more packets. d.mu must be locked.
+func (d *demuxQueue) drained() bool {
+	for _, q := range d.tracks {
+		if !q.lookahead && q.drained() {
+			return true
+		}
+	}
+	return false
+}
+
+func (q *packetQueue) drained() bool {
+	if len(q.packets) == 0 {
+		return true
+	}
+	readAhead, maxBytes := q.d.limits()
+	return q.bytes <= maxBytes-maxBytes/4 && q.packets[len(q.packets)-1].Timecode-q.packets[0].Timecode <= readAhead-readAhead/4
+}
+
+// limits returns the read-ahead window and the byte limit of each track, which are a quarter while the memory is over
+// the budget.
+func (d *demuxQueue) limits() (time.Duration, int) {
+	if memoryPressure() {
+		return d.readAhead / 4, d.maxBytes / 4
+	}
+	return d.readAhead, d.maxBytes
+}
+
+// depth returns the number, the size and the time span of the packets in q.
+func (q *packetQueue) depth() (int, int, time.Duration) {
+	d := q.d
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if len(q.packets) == 0 {
+		return 0, 0, 0
+	}
+	return len(q.packets), q.bytes, q.packets[len(q.packets)-1].Timecode - q.packets[0].Timecode
+}
+
+func (q *packetQueue) full() bool {
+	if len(q.packets) == 0 {
+		return false
+	}
+	readAhead, maxBytes := q.d.limits()
+	if q.bytes >= maxBytes {
+		return true
+	}
+	if q.packets[len(q.packets)-1].Timecode-q.packets[0].Timecode < readAhead {
+		return false
+	}
+	for _, t := range q.d.tracks {
+		if t != q && !t.lookahead && len(t.packets) == 0 {
+			return false
+		}
+	}
+	return true
+}
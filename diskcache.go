@@ -0,0 +1,409 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"crypto/sha256"
+	"encoding/binary"
+	"encoding/hex"
+	"errors"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"runtime"
+	"slices"
+	"strings"
+	"sync"
+	"time"
+)
+
+// diskCacheHeaderSize is the size of the header of an index file, which is the size of the stream.
+const diskCacheHeaderSize = 8
+
+// DiskCache is a cache of remote streams in a local directory, which persists across the processes. A stream is cached
+// in blocks of 256 KiB as they are read, so a stream played again is read from the disk, and a stream fully cached is
+// memory-mapped as NewPlayerFromFile maps a file.
+//
+// A stream is stored in two files named by the SHA-256 of its key: the data file of the stream's size with the blocks
+// at their offsets, and the index file of the size and the bitmap of the blocks written. When the cached blocks are
+// over the size limit, the streams used least recently are removed, except the streams being read.
+type DiskCache struct {
+	dir      string
+	maxBytes int64
+
+	mu      sync.Mutex
+	entries map[string]*diskCacheEntry
+
+	// bytes is the size of the cached blocks of all the streams.
+	bytes int64
+}
+
+type diskCacheEntry struct {
+	name string
+	size int64
+
+	// blocks is the bitmap of the cached blocks, and cached is the size of them.
+	blocks []byte
+	cached int64
+
+	// used is the time when the stream was last opened, which is the modification time of the index file.
+	used time.Time
+
+	// data and index are the files open while refs readers read the stream.
+	refs  int
+	data  *os.File
+	index *os.File
+}
+
+// NewDiskCache returns a DiskCache in dir, which keeps the cached blocks at most maxBytes. dir is created if it
+// doesn't exist, and the streams cached in dir before are used.
+func NewDiskCache(dir string, maxBytes int64) (*DiskCache, error) {
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		return nil, fmt.Errorf("webmplayer: creating the disk cache failed: %w", err)
+	}
+	c := &DiskCache{
+		dir:      dir,
+		maxBytes: maxBytes,
+		entries:  map[string]*diskCacheEntry{},
+	}
+	des, err := os.ReadDir(dir)
+	if err != nil {
+		return nil, fmt.Errorf("webmplayer: reading the disk cache failed: %w", err)
+	}
+	for _, de := range des {
+		name, ok := strings.CutSuffix(de.Name(), ".index")
+		if !ok {
+			continue
+		}
+		e, err := c.load(name)
+		if err != nil {
+			// A broken stream is cached again.
+			c.removeFiles(name)
+			continue
+		}
+		c.entries[name] = e
+		c.bytes += e.cached
+	}
+	c.mu.Lock()
+	c.evict()
+	c.mu.Unlock()
+	return c, nil
+}
+
+// load loads the index of the stream name.
+func (c *DiskCache) load(name string) (*diskCacheEntry, error) {
+	path := filepath.Join(c.dir, name+".index")
+	index, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	if len(index) < diskCacheHeaderSize {
+		return nil, errors.New("webmplayer: too short disk cache index")
+	}
+	e := &diskCacheEntry{
+		name: name,
+		size: int64(binary.LittleEndian.Uint64(index)),
+	}
+	if e.size < 0 || int64(len(index)-diskCacheHeaderSize) != (e.blockCount()+7)/8 {
+		return nil, errors.New("webmplayer: invalid disk cache index")
+	}
+	if fi, err := os.Stat(filepath.Join(c.dir, name+".data")); err != nil || fi.Size() != e.size {
+		return nil, errors.New("webmplayer: invalid disk cache data")
+	}
+	fi, err := os.Stat(path)
+	if err != nil {
+		return nil, err
+	}
+	e.used = fi.ModTime()
+	e.blocks = index[diskCacheHeaderSize:]
+	for i := range e.blockCount() {
+		if e.has(i) {
+			e.cached += e.blockSize(i)
+		}
+	}
+	return e, nil
+}
+
+// Open returns an io.ReadSeeker to be passed to NewPlayer, which reads the stream of key from the cache. If the
+// stream is cached fully, the data file is memory-mapped. Otherwise, the returned reader is NewPrefetchReader of
+// ReaderAt.
+//
+// r is the remote stream, and must be safe for concurrent ReadAt calls. size is the size of the whole stream. key
+// identifies the content of the stream, e.g. its URL and its ETag, and a stream of a different size with the same key
+// replaces the cached one.
+func (c *DiskCache) Open(r io.ReaderAt, size int64, key string) (io.ReadSeeker, error) {
+	if path, ok := c.complete(size, key); ok {
+		if f, err := openFile(path); err == nil {
+			return f, nil
+		}
+	}
+	ra, err := c.ReaderAt(r, size, key)
+	if err != nil {
+		return nil, err
+	}
+	return NewPrefetchReader(ra, size), nil
+}
+
+// complete returns the path of the data file of the stream of key if the stream is cached fully.
+func (c *DiskCache) complete(size int64, key string) (string, bool) {
+	name := diskCacheName(key)
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e, ok := c.entries[name]
+	if !ok || e.size != size || e.cached != size {
+		return "", false
+	}
+	c.touch(e)
+	return filepath.Join(c.dir, name+".data"), true
+}
+
+// ReaderAt returns an io.ReaderAt that reads the stream of key from the cache, and reads the blocks not cached from r
+// to cache them. The returned reader can be passed to NewPrefetchReader or NewSharedPrefetchReader. The arguments are
+// the same as Open's.
+//
+// A block failing to be cached is still read from r, so the cache never makes a read fail.
+func (c *DiskCache) ReaderAt(r io.ReaderAt, size int64, key string) (io.ReaderAt, error) {
+	name := diskCacheName(key)
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	e, ok := c.entries[name]
+	if ok && e.size != size {
+		if e.refs > 0 {
+			return nil, fmt.Errorf("webmplayer: the stream of %q is being read with another size", key)
+		}
+		c.remove(e)
+		ok = false
+	}
+	if !ok {
+		e = &diskCacheEntry{
+			name: name,
+			size: size,
+		}
+		e.blocks = make([]byte, (e.blockCount()+7)/8)
+	}
+	if e.refs == 0 {
+		if err := c.openFiles(e, !ok); err != nil {
+			return nil, err
+		}
+	}
+	if !ok {
+		c.entries[name] = e
+	}
+	e.refs++
+	c.touch(e)
+
+	d := &diskCacheReader{
+		cache:  c,
+		entry:  e,
+		remote: r,
+	}
+	// The files are closed when no reader reads the stream.
+	runtime.SetFinalizer(d, (*diskCacheReader).release)
+	return d, nil
+}
+
+// openFiles opens the files of e, and creates them if create is true.
+func (c *DiskCache) openFiles(e *diskCacheEntry, create bool) error {
+	flag := os.O_RDWR
+	if create {
+		flag |= os.O_CREATE | os.O_TRUNC
+	}
+	data, err := os.OpenFile(filepath.Join(c.dir, e.name+".data"), flag, 0o644)
+	if err != nil {
+		return fmt.Errorf("webmplayer: opening the disk cache failed: %w", err)
+	}
+	index, err := os.OpenFile(filepath.Join(c.dir, e.name+".index"), flag, 0o644)
+	if err != nil {
+		_ = data.Close()
+		return fmt.Errorf("webmplayer: opening the disk cache failed: %w", err)
+	}
+	if create {
+		// The data file is sparse until the blocks are written.
+		err := data.Truncate(e.size)
+		if err == nil {
+			buf := make([]byte, diskCacheHeaderSize+len(e.blocks))
+			binary.LittleEndian.PutUint64(buf, uint64(e.size))
+			_, err = index.WriteAt(buf, 0)
+		}
+		if err != nil {
+			_ = data.Close()
+			_ = index.Close()
+			c.removeFiles(e.name)
+			return fmt.Errorf("webmplayer: creating the disk cache failed: %w", err)
+		}
+	}
+	e.data = data
+	e.index = index
+	return nil
+}
+
+// touch marks e as used now. c.mu must be locked.
+func (c *DiskCache) touch(e *diskCacheEntry) {
+	e.used = time.Now()
+	_ = os.Chtimes(filepath.Join(c.dir, e.name+".index"), e.used, e.used)
+}
+
+// evict removes the streams used least recently until the cached blocks are within the limit. The streams being read
+// are not removed. c.mu must be locked.
+func (c *DiskCache) evict() {
+	if c.bytes <= c.maxBytes {
+		return
+	}
+	entries := make([]*diskCacheEntry, 0, len(c.entries))
+	for _, e := range c.entries {
+		if e.refs == 0 {
+			entries = append(entries, e)
+		}
+	}
+	slices.SortFunc(entries, func(a, b *diskCacheEntry) int {
+		return a.used.Compare(b.used)
+	})
+	for _, e := range entries {
+		if c.bytes <= c.maxBytes {
+			break
+		}
+		c.remove(e)
+	}
+}
+
+// remove removes the stream of e, which is not being read. c.mu must be locked.
+func (c *DiskCache) remove(e *diskCacheEntry) {
+	delete(c.entries, e.name)
+	c.bytes -= e.cached
+	c.removeFiles(e.name)
+}
+
+func (c *DiskCache) removeFiles(name string) {
+	_ = os.Remove(filepath.Join(c.dir, name+".index"))
+	_ = os.Remove(filepath.Join(c.dir, name+".data"))
+}
+
+// diskCacheName returns the name of the files of the stream of key.
+func diskCacheName(key string) string {
+	h := sha256.Sum256([]byte(key))
+	return hex.EncodeToString(h[:])
+}
+
+func (e *diskCacheEntry) blockCount() int64 {
+	return (e.size + prefetchBlockSize - 1) / prefetchBlockSize
+}
+
+func (e *diskCacheEntry) blockSize(i int64) int64 {
+	return min(prefetchBlockSize, e.size-i*prefetchBlockSize)
+}
+
+func (e *diskCacheEntry) has(i int64) bool {
+	return e.blocks[i/8]&(1<<(i%8)) != 0
+}
+
+// diskCacheReader is a reader of a stream in a DiskCache.
+type diskCacheReader struct {
+	cache  *DiskCache
+	entry  *diskCacheEntry
+	remote io.ReaderAt
+}
+
+func (d *diskCacheReader) ReadAt(buf []byte, off int64) (int, error) {
+	e := d.entry
+	if off < 0 {
+		return 0, errors.New("webmplayer: negative offset")
+	}
+	var n int
+	for n < len(buf) {
+		o := off + int64(n)
+		if o >= e.size {
+			return n, io.EOF
+		}
+		i := o / prefetchBlockSize
+		m, err := d.readBlock(buf[n:], o, i)
+		n += m
+		if err != nil {
+			return n, err
+		}
+	}
+	return n, nil
+}
+
+// readBlock reads from the block i at off, from the data file if the block is cached, or from the remote stream.
+func (d *diskCacheReader) readBlock(buf []byte, off int64, i int64) (int, error) {
+	c, e := d.cache, d.entry
+	start := i * prefetchBlockSize
+	size := e.blockSize(i)
+	end := min(off+int64(len(buf)), start+size)
+
+	c.mu.Lock()
+	cached := e.has(i)
+	c.mu.Unlock()
+	if cached {
+		if n, err := e.data.ReadAt(buf[:end-off], off); err == nil {
+			return n, nil
+		}
+	}
+
+	// The whole block is read to be cached.
+	block := buf[:end-off]
+	var pooled *[]byte
+	if off != start || end != start+size {
+		pooled = prefetchBuffers.Get().(*[]byte)
+		defer prefetchBuffers.Put(pooled)
+		block = (*pooled)[:size]
+	}
+	n, err := d.remote.ReadAt(block, start)
+	if err == io.EOF && int64(n) == size {
+		err = nil
+	}
+	if err != nil {
+		if pooled == nil {
+			return n, err
+		}
+		if int64(n) <= off-start {
+			return 0, err
+		}
+		return copy(buf[:end-off], block[off-start:n]), err
+	}
+	d.store(i, block)
+	if pooled != nil {
+		return copy(buf[:end-off], block[off-start:]), nil
+	}
+	return n, nil
+}
+
+// store writes the block i to the data file, and then marks it in the index.
+func (d *diskCacheReader) store(i int64, block []byte) {
+	c, e := d.cache, d.entry
+	if _, err := e.data.WriteAt(block, i*prefetchBlockSize); err != nil {
+		return
+	}
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if e.has(i) {
+		return
+	}
+	e.blocks[i/8] |= 1 << (i % 8)
+	if _, err := e.index.WriteAt(e.blocks[i/8:i/8+1], diskCacheHeaderSize+i/8); err != nil {
+		e.blocks[i/8] &^= 1 << (i % 8)
+		return
+	}
+	e.cached += int64(len(block))
+	c.bytes += int64(len(block))
+	c.evict()
+}
+
+// release closes the files of the stream when no reader reads it.
+func (d *diskCacheReader) release() {
+	c, e := d.cache, d.entry
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	e.refs--
+	if e.refs > 0 {
+		return
+	}
+	_ = e.data.Close()
+	_ = e.index.Close()
+	e.data = nil
+	e.index = nil
+	c.evict()
+}
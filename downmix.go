@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"math"
+)
+
+// downmixMatrix returns the gains of the left and the right output for each input channel, in the layout libvorbis
+// and libopus take.
+//
+// If m is empty, a standard downmix for the channel count is used.
+// The channels are in the Vorbis order, which Opus mapping family 1 also follows.
+// https://www.xiph.org/vorbis/doc/Vorbis_I_spec.html#x1-810004.3.9
+func downmixMatrix(m [2][]float32, channels int) ([]float32, error) {
+	if len(m[0]) == 0 && len(m[1]) == 0 {
+		m = defaultDownmix(channels)
+	}
+	if len(m[0]) != channels || len(m[1]) != channels {
+		return nil, fmt.Errorf("webmplayer: the downmix matrix size doesn't match with the channel count %d", channels)
+	}
+	matrix := make([]float32, 2*channels)
+	for c := range channels {
+		matrix[2*c] = m[0][c]
+		matrix[2*c+1] = m[1][c]
+	}
+	return matrix, nil
+}
+
+func defaultDownmix(channels int) [2][]float32 {
+	// Center and surround channels are mixed at -3 dB, and LFE is dropped.
+	const (
+		f = 1
+		k = math.Sqrt2 / 2
+		h = 0.5
+	)
+	var l, r []float32
+	switch channels {
+	case 3:
+		// L, C, R
+		l = []float32{f, k, 0}
+		r = []float32{0, k, f}
+	case 4:
+		// FL, FR, RL, RR
+		l = []float32{f, 0, k, 0}
+		r = []float32{0, f, 0, k}
+	case 5:
+		// FL, C, FR, RL, RR
+		l = []float32{f, k, 0, k, 0}
+		r = []float32{0, k, f, 0, k}
+	case 6:
+		// FL, C, FR, RL, RR, LFE
+		l = []float32{f, k, 0, k, 0, 0}
+		r = []float32{0, k, f, 0, k, 0}
+	case 7:
+		// FL, C, FR, SL, SR, RC, LFE
+		l = []float32{f, k, 0, k, 0, h, 0}
+		r = []float32{0, k, f, 0, k, h, 0}
+	case 8:
+		// FL, C, FR, SL, SR, RL, RR, LFE
+		l = []float32{f, k, 0, k, 0, k, 0, 0}
+		r = []float32{0, k, f, 0, k, 0, k, 0}
+	default:
+		// The layout is unknown. Mix all the channels evenly.
+		l = make([]float32, channels)
+		r = make([]float32, channels)
+		for c := range channels {
+			l[c] = 1
+			r[c] = 1
+		}
+	}
+
+	// Normalize the gains so that the output doesn't clip.
+	for _, row := range [][]float32{l, r} {
+		var sum float32
+		for _, v := range row {
+			sum += v
+		}
+		for i := range row {
+			row[i] /= sum
+		}
+	}
+	return [2][]float32{l, r}
+}
+
+// ambisonicsDownmix returns a stereo downmix for ambisonics in the ACN order with the SN3D normalization, which Opus
+// mapping families 2 and 3 use.
+// The output is a pair of virtual cardioid microphones facing left and right. Only the first order is used.
+// Two channels after the ambisonic channels are non-diegetic stereo, which is added as it is.
+// https://datatracker.ietf.org/doc/html/rfc8486#section-3.1
+func ambisonicsDownmix(channels int) [2][]float32 {
+	l := make([]float32, channels)
+	r := make([]float32, channels)
+	order := int(math.Sqrt(float64(channels)))
+	n := order * order
+	if channels-n == 2 {
+		l[n] = 1
+		r[n+1] = 1
+	}
+	// W
+	l[0] = 0.5
+	r[0] = 0.5
+	// Y, the left-right axis.
+	if n > 1 {
+		l[1] = 0.5
+		r[1] = -0.5
+	}
+	return [2][]float32{l, r}
+}
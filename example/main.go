@@ -6,7 +6,6 @@ package main
 import (
 	"flag"
 	"fmt"
-	"io"
 	"log/slog"
 	"os"
 
@@ -15,6 +14,12 @@ import (
 	"github.com/hajimehoshi/webmplayer"
 )
 
+var (
+	flagBench   = flag.Bool("bench", false, "decode the files as fast as possible without a window, and report the speed")
+	flagTiming  = flag.Bool("timing", false, "record the frame timing, and report the histograms on exit")
+	flagRefresh = flag.Float64("refresh", 60, "the refresh rate of the display in Hz to count the missed vsyncs for -timing")
+)
+
 func main() {
 	flag.Parse()
 	if err := xmain(); err != nil {
@@ -24,19 +29,16 @@ func main() {
 }
 
 func xmain() error {
-	streams := make([]io.ReadSeeker, 0, 2)
-	for _, opt := range flag.Args() {
-		f, err := os.Open(opt)
-		if err != nil {
-			return err
-		}
-		streams = append(streams, f)
-		if len(streams) >= 2 {
-			break
-		}
+	paths := flag.Args()
+	if len(paths) > 2 {
+		paths = paths[:2]
 	}
 
-	player, err := webmplayer.NewPlayer(streams...)
+	if *flagBench {
+		return bench(paths)
+	}
+
+	player, err := webmplayer.NewPlayerFromFile(nil, paths...)
 	if err != nil {
 		return err
 	}
@@ -60,15 +62,44 @@ func xmain() error {
 	ebiten.SetWindowResizingMode(ebiten.WindowResizingModeEnabled)
 	ebiten.SetWindowTitle("WebM Player")
 	game := NewGame(player)
+	if *flagTiming {
+		game.timing = newTiming(*flagRefresh)
+	}
 	if err := ebiten.RunGame(game); err != nil {
 		return err
 	}
+	if game.timing != nil {
+		game.timing.report(os.Stderr, player)
+	}
 
 	return nil
 }
 
+func bench(paths []string) error {
+	r, err := webmplayer.BenchmarkFromFile(nil, paths...)
+	if err != nil {
+		return err
+	}
+	slog.Info("Benchmark",
+		"duration", r.Duration,
+		"videoFrames", r.VideoFrames,
+		"videoFPS", r.VideoFPS(),
+		"audioDuration", r.AudioDuration,
+		"audioRealTimeFactor", r.AudioRealTimeFactor(),
+		"readTime", r.ReadTime,
+		"videoDecodeTime", r.VideoDecodeTime,
+		"audioDecodeTime", r.AudioDecodeTime,
+		"allocs", r.Allocs,
+		"allocBytes", r.AllocBytes,
+		"allocsPerSecond", r.AllocsPerSecond(),
+		"gcCycles", r.GCCycles,
+		"peakRSS", peakRSS())
+	return nil
+}
+
 type Game struct {
 	player *webmplayer.Player
+	timing *timing
 }
 
 func NewGame(p *webmplayer.Player) *Game {
@@ -78,10 +109,19 @@ func NewGame(p *webmplayer.Player) *Game {
 }
 
 func (g *Game) Update() error {
-	return g.player.Update()
+	if err := g.player.Update(); err != nil {
+		return err
+	}
+	if g.timing != nil {
+		g.timing.update(g.player)
+	}
+	return nil
 }
 
 func (g *Game) Draw(screen *ebiten.Image) {
+	if g.timing != nil {
+		g.timing.draw()
+	}
 	w, h := g.player.VideoSize()
 	if w == 0 || h == 0 {
 		return
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !darwin && !linux
+
+package main
+
+// peakRSS returns 0, as the peak resident set size is not available.
+func peakRSS() int64 {
+	return 0
+}
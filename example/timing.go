@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package main
+
+import (
+	"fmt"
+	"io"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer"
+)
+
+// timing records the frame timing of the game for -timing.
+type timing struct {
+	// refresh is the expected interval of the draws.
+	refresh time.Duration
+
+	lastDraw   time.Time
+	drawTime   webmplayer.Histogram
+	vsyncMiss  int
+	lastUpdate time.Time
+	lastPos    time.Duration
+	clockDelta webmplayer.Histogram
+}
+
+func newTiming(refreshRate float64) *timing {
+	return &timing{
+		refresh: time.Duration(float64(time.Second) / refreshRate),
+	}
+}
+
+func observe(h *webmplayer.Histogram, d time.Duration) {
+	i := 0
+	for i < len(webmplayer.HistogramBounds) && d > webmplayer.HistogramBounds[i] {
+		i++
+	}
+	h.Buckets[i]++
+	h.Sum += d
+	h.Count++
+}
+
+// draw records the interval of the draws. An interval longer than 1.5 refresh intervals is a missed vsync.
+func (t *timing) draw() {
+	now := time.Now()
+	if !t.lastDraw.IsZero() {
+		d := now.Sub(t.lastDraw)
+		observe(&t.drawTime, d)
+		if d > t.refresh*3/2 {
+			t.vsyncMiss++
+		}
+	}
+	t.lastDraw = now
+}
+
+// update records the jitter of the player's clock, the difference between the advance of the position and the wall
+// time since the last update.
+func (t *timing) update(p *webmplayer.Player) {
+	now := time.Now()
+	pos := p.Position()
+	if !t.lastUpdate.IsZero() && !p.IsPaused() && !p.IsFinished() {
+		wall := time.Duration(float64(now.Sub(t.lastUpdate)) * p.PlaybackRate())
+		d := pos - t.lastPos - wall
+		if d < 0 {
+			d = -d
+		}
+		observe(&t.clockDelta, d)
+	}
+	t.lastUpdate = now
+	t.lastPos = pos
+}
+
+// report writes the summary of the timing and the player's statistics to w.
+func (t *timing) report(w io.Writer, p *webmplayer.Player) {
+	stats := p.Stats()
+	fmt.Fprintf(w, "vsync misses: %d / %d draws (refresh %v)\n", t.vsyncMiss, t.drawTime.Count, t.refresh)
+	fmt.Fprintf(w, "late video frames: %d, dropped: %d, skipped: %d\n", stats.LateVideoFrames, stats.DroppedVideoFrames, stats.SkippedVideoFrames)
+	fmt.Fprintf(w, "audio underruns: %d, concealed: %v\n", stats.AudioUnderruns, stats.AudioConcealed)
+	for _, h := range []struct {
+		name string
+		h    *webmplayer.Histogram
+	}{
+		{"draw interval", &t.drawTime},
+		{"clock jitter", &t.clockDelta},
+		{"decode to present", &stats.VideoPresentLatency},
+		{"present lateness", &stats.VideoPresentLateness},
+		{"video decode", &stats.VideoDecodeTime},
+		{"video upload", &stats.VideoUploadTime},
+		{"audio decode", &stats.AudioDecodeTime},
+	} {
+		writeHistogram(w, h.name, h.h)
+	}
+}
+
+func writeHistogram(w io.Writer, name string, h *webmplayer.Histogram) {
+	fmt.Fprintf(w, "%s: count %d, mean %v\n", name, h.Count, h.Mean())
+	if h.Count == 0 {
+		return
+	}
+	for i, n := range h.Buckets {
+		if n == 0 {
+			continue
+		}
+		bound := "+Inf"
+		if i < len(webmplayer.HistogramBounds) {
+			bound = webmplayer.HistogramBounds[i].String()
+		}
+		fmt.Fprintf(w, "  <= %-8s %8d %5.1f%%\n", bound, n, float64(n)*100/float64(h.Count))
+	}
+}
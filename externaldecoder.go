@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+)
+
+// VideoDecoder is a video decoder provided by PlayerOptions.NewVideoDecoder, e.g. with the hardware decoder of the
+// platform.
+//
+// The methods are called from the decoding goroutine of the Player, one at a time.
+type VideoDecoder interface {
+	// Start prepares the decoder for a stream with the CodecPrivate data of the track.
+	Start(codecPrivate []byte) error
+
+	// Decode decodes a packet of the track. data is not valid after Decode returns.
+	Decode(data []byte) error
+
+	// Next returns the next picture decoded from the packet, or nil if there is none.
+	// Next is called until it returns nil after each Decode, and the pictures are presented at the timecode of the
+	// packet. The player copies the picture before the next call of Next or Decode, so the decoder can reuse the planes
+	// then.
+	Next() (*VideoPicture, error)
+
+	// Close frees the decoder.
+	Close()
+}
+
+// VideoPicture is a picture decoded by a VideoDecoder, in planar YCbCr in the memory of the CPU.
+//
+// The player draws the picture with its YUV shader. Ebitengine can't use textures of other APIs, so a hardware
+// decoder must map or download its surfaces, and deinterleave the chroma planes of NV12.
+type VideoPicture struct {
+	Width  int
+	Height int
+
+	// BitDepth is the bit depth of the samples. If BitDepth is more than 8, each sample is a little-endian uint16 with
+	// BitDepth bits. Otherwise, each sample is a byte. If BitDepth is 0, 8 is used.
+	BitDepth int
+
+	// XChromaShift and YChromaShift are the subsampling of the chroma planes, e.g. 1 and 1 for 4:2:0. They are 0 or
+	// 1.
+	XChromaShift int
+	YChromaShift int
+
+	// MatrixCoefficients is the matrix of the picture, as ISO/IEC 23091-4, and FullRange is its color range.
+	// If MatrixCoefficients is 0 or not supported, BT.601 is used unless the track specifies the matrix.
+	MatrixCoefficients int
+	FullRange          bool
+
+	// Planes are the Y, Cb and Cr planes, and Strides are their strides in bytes.
+	Planes  [3][]byte
+	Strides [3]int
+}
+
+// externalDecoder is a videoDecoder with a VideoDecoder.
+type externalDecoder struct {
+	d VideoDecoder
+}
+
+// newPlayerVideoDecoder creates a decoder of codec with PlayerOptions.NewVideoDecoder, or a built-in decoder.
+func newPlayerVideoDecoder(options *PlayerOptions, codec videoCodec, threads int) (videoDecoder, error) {
+	if options.NewVideoDecoder != nil {
+		d, err := options.NewVideoDecoder(string(codec), threads)
+		if err != nil {
+			return nil, err
+		}
+		if d != nil {
+			return &externalDecoder{d: d}, nil
+		}
+	}
+	if options.HardwareVideoDecoding && hasHardwareVideoDecoder(codec) {
+		return newHardwareDecoder(codec, threads), nil
+	}
+	return newVideoDecoder(codec, threads)
+}
+
+func (e *externalDecoder) start(codecPrivate []byte) error {
+	return e.d.Start(codecPrivate)
+}
+
+func (e *externalDecoder) decode(data []byte) error {
+	return e.d.Decode(data)
+}
+
+func (e *externalDecoder) next() (videoPicture, bool, error) {
+	pic, err := e.d.Next()
+	if err != nil || pic == nil {
+		return videoPicture{}, false, err
+	}
+	if err := pic.validate(); err != nil {
+		return videoPicture{}, false, err
+	}
+	depth := pic.BitDepth
+	if depth == 0 {
+		depth = 8
+	}
+	p := videoPicture{}
+	p.Width = pic.Width
+	p.Height = pic.Height
+	p.BitDepth = depth
+	p.HighBitDepth = depth > 8
+	p.XChromaShift = pic.XChromaShift
+	p.YChromaShift = pic.YChromaShift
+	p.ColorSpace = matrixColorSpace(uint64(pic.MatrixCoefficients))
+	p.FullRange = pic.FullRange
+	p.Planes = pic.Planes
+	p.Strides = pic.Strides
+	return p, true, nil
+}
+
+func (e *externalDecoder) setSkipLoopFilter(skip bool) {
+}
+
+func (e *externalDecoder) setSpatialLayer(layer int) {
+}
+
+func (e *externalDecoder) destroy() {
+	e.d.Close()
+}
+
+// validate reports an error if the planes of p are too small for the size, so that the player doesn't read out of
+// them.
+func (p *VideoPicture) validate() error {
+	if p.Width <= 0 || p.Height <= 0 || p.XChromaShift < 0 || p.XChromaShift > 1 || p.YChromaShift < 0 || p.YChromaShift > 1 {
+		return fmt.Errorf("webmplayer: invalid video picture: %dx%d, chroma shifts %d and %d", p.Width, p.Height, p.XChromaShift, p.YChromaShift)
+	}
+	bps := 1
+	if p.BitDepth > 8 {
+		bps = 2
+	}
+	for i := range p.Planes {
+		w, h := p.Width, p.Height
+		if i > 0 {
+			w = (w + p.XChromaShift) >> p.XChromaShift
+			h = (h + p.YChromaShift) >> p.YChromaShift
+		}
+		if p.Strides[i] < bps*w || len(p.Planes[i]) < p.Strides[i]*h {
+			return fmt.Errorf("webmplayer: the plane %d of a video picture is too small", i)
+		}
+	}
+	// image.YCbCr has one stride for the chroma planes.
+	if p.Strides[1] != p.Strides[2] {
+		return fmt.Errorf("webmplayer: the chroma planes of a video picture have different strides")
+	}
+	return nil
+}
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"io"
+
+	"github.com/ebml-go/webm"
+)
+
+// ExtractAudioOptions is the options of ExtractAudio.
+type ExtractAudioOptions struct {
+	// AudioTrack is the track number of the audio. If AudioTrack is 0, the first audio track is used.
+	AudioTrack uint
+}
+
+// ExtractAudio copies the Opus or Vorbis packets of an audio track of the WebM input r to an Ogg stream written to w,
+// e.g. an .opus or .ogg file, without decoding or encoding them.
+//
+// The headers are made from CodecPrivate of the track, with an OpusTags header without comments for Opus. The granule
+// positions are counted from the durations of the packets, by the TOC bytes for Opus and by the block sizes for
+// Vorbis. The padding of the Opus packets is removed. The data of the video blocks is not read, so ExtractAudio runs as
+// fast as r is read.
+//
+// The gaps between the blocks and the end trimming by DiscardPadding are not kept, as in Trim.
+func ExtractAudio(w io.Writer, r io.ReadSeeker, options *ExtractAudioOptions) error {
+	if options == nil {
+		options = &ExtractAudioOptions{}
+	}
+
+	var meta webm.WebM
+	reader, _, err := parseWebM(r, &meta)
+	if err != nil {
+		return err
+	}
+	defer closeReader(reader)
+
+	track, err := findTrack(&meta, options.AudioTrack, (*webm.TrackEntry).IsAudio)
+	if err != nil {
+		return err
+	}
+	if track == nil {
+		return fmt.Errorf("webmplayer: no audio tracks")
+	}
+	if v := meta.FindFirstVideoTrack(); v != nil {
+		reader.skipData(v.TrackNumber)
+	}
+
+	return writeOggAudio(w, track, func() ([]byte, error) {
+		for pkt := range reader.Chan {
+			// The reader sends BadTC at the end.
+			if pkt.Timecode == webm.BadTC {
+				break
+			}
+			if pkt.TrackNumber == track.TrackNumber && len(pkt.Data) > 0 {
+				return pkt.Data, nil
+			}
+		}
+		return nil, io.EOF
+	})
+}
+
+// ExtractAudioFromFile runs ExtractAudio with a local WebM file, which is opened as NewPlayerFromFile opens.
+func ExtractAudioFromFile(w io.Writer, path string, options *ExtractAudioOptions) error {
+	r, err := openFile(path)
+	if err != nil {
+		return err
+	}
+	return ExtractAudio(w, r, options)
+}
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"io"
+	"os"
+)
+
+// indexSidecarMagic is of the sidecar file of the headers of a WebM input, which are encoded as encodeBundleIndex
+// encodes them in a bundle.
+const indexSidecarMagic = "WEBMINDX"
+
+// NewPlayerFromFile creates a Player from local WebM files.
+// A video file and an audio file can be specified separately, like NewPlayerWithOptions.
+//
+// On Linux and macOS, the files are memory-mapped, so reading packets costs page faults instead of system calls.
+// The mappings are released when the Player is no longer referenced.
+func NewPlayerFromFile(options *PlayerOptions, paths ...string) (*Player, error) {
+	streams := make([]io.ReadSeeker, 0, len(paths))
+	for _, path := range paths {
+		var s io.ReadSeeker
+		var err error
+		if options != nil && options.IndexSidecar {
+			s, err = openIndexedFile(path)
+		} else {
+			s, err = openFile(path)
+		}
+		if err != nil {
+			return nil, err
+		}
+		streams = append(streams, s)
+	}
+	return newPlayer(options, newAudioPlayer, paths, streams...)
+}
+
+// indexedFile is a local file opened with PlayerOptions.IndexSidecar. index is the headers read from the sidecar file,
+// or nil if the sidecar file is missing or stale.
+type indexedFile struct {
+	io.ReadSeeker
+	path  string
+	key   []byte
+	index *webmIndex
+}
+
+func openIndexedFile(path string) (*indexedFile, error) {
+	fi, err := os.Stat(path)
+	if err != nil {
+		return nil, err
+	}
+	r, err := openFile(path)
+	if err != nil {
+		return nil, err
+	}
+	// The key has the version of the encoding, so that a sidecar file of another version is stale.
+	f := &indexedFile{
+		ReadSeeker: r,
+		path:       path,
+		key:        sidecarKey(indexSidecarMagic, fi, bundleVersion),
+	}
+	if data, ok := readSidecar(path+".index", f.key); ok {
+		if idx, err := decodeBundleIndex(data); err == nil {
+			f.index = idx
+		}
+	}
+	return f, nil
+}
+
+// storeIndex writes the headers idx parsed from f to the sidecar file unless they were read from it.
+func (f *indexedFile) storeIndex(idx *webmIndex) {
+	if f.index != nil {
+		return
+	}
+	writeSidecar(f.path+".index", f.key, encodeBundleIndex(idx))
+}
+
+// BenchmarkFromFile runs Benchmark with local WebM files, which are opened as NewPlayerFromFile opens.
+func BenchmarkFromFile(options *BenchmarkOptions, paths ...string) (*BenchmarkResult, error) {
+	streams := make([]io.ReadSeeker, 0, len(paths))
+	for _, path := range paths {
+		s, err := openFile(path)
+		if err != nil {
+			return nil, err
+		}
+		streams = append(streams, s)
+	}
+	return Benchmark(options, streams...)
+}
+
+// BenchmarkScalingFromFile runs BenchmarkScaling with local WebM files, which are opened for each Player as
+// NewPlayerFromFile opens.
+func BenchmarkScalingFromFile(options *ScalingOptions, paths ...string) ([]*ScalingResult, error) {
+	return BenchmarkScaling(func() ([]io.ReadSeeker, error) {
+		streams := make([]io.ReadSeeker, 0, len(paths))
+		for _, path := range paths {
+			s, err := openFile(path)
+			if err != nil {
+				return nil, err
+			}
+			streams = append(streams, s)
+		}
+		return streams, nil
+	}, options)
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build darwin || linux
+
+package webmplayer
+
+import (
+	"bytes"
+	"fmt"
+	"io"
+	"os"
+	"runtime"
+	"syscall"
+)
+
+// mappedFile is a read-only memory-mapped file.
+type mappedFile struct {
+	*bytes.Reader
+	data []byte
+}
+
+func openFile(path string) (io.ReadSeeker, error) {
+	data, err := mapFile(path)
+	if err != nil {
+		return nil, err
+	}
+	if len(data) == 0 {
+		return bytes.NewReader(nil), nil
+	}
+
+	m := &mappedFile{
+		Reader: bytes.NewReader(data),
+		data:   data,
+	}
+	// The mapped memory is never exposed outside of mappedFile, so it is safe to unmap it when m is unreachable.
+	runtime.SetFinalizer(m, func(m *mappedFile) {
+		_ = unmapFile(m.data)
+	})
+	return m, nil
+}
+
+// mapFile maps the file at path read-only. The mapping is released by unmapFile, except for an empty file, which is
+// not mapped.
+func mapFile(path string) ([]byte, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+
+	fi, err := f.Stat()
+	if err != nil {
+		return nil, err
+	}
+	size := fi.Size()
+	if size == 0 {
+		return nil, nil
+	}
+	if int64(int(size)) != size {
+		return nil, fmt.Errorf("webmplayer: %s is too large to map", path)
+	}
+
+	data, err := syscall.Mmap(int(f.Fd()), 0, int(size), syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, fmt.Errorf("webmplayer: mapping %s failed: %w", path, err)
+	}
+	return data, nil
+}
+
+func unmapFile(data []byte) error {
+	if len(data) == 0 {
+		return nil
+	}
+	return syscall.Munmap(data)
+}
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !darwin && !linux
+
+package webmplayer
+
+import (
+	"bufio"
+	"io"
+	"os"
+)
+
+// bufferedFile is a file with a read buffer. The buffer is discarded at seeking.
+type bufferedFile struct {
+	f *os.File
+	r *bufio.Reader
+}
+
+func openFile(path string) (io.ReadSeeker, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, err
+	}
+	return &bufferedFile{
+		f: f,
+		r: bufio.NewReaderSize(f, 64*1024),
+	}, nil
+}
+
+func (b *bufferedFile) Read(buf []byte) (int, error) {
+	return b.r.Read(buf)
+}
+
+func (b *bufferedFile) Seek(offset int64, whence int) (int64, error) {
+	if whence == io.SeekCurrent {
+		offset -= int64(b.r.Buffered())
+	}
+	n, err := b.f.Seek(offset, whence)
+	if err != nil {
+		return 0, err
+	}
+	b.r.Reset(b.f)
+	return n, nil
+}
+
+// mapFile reads the file at path, as memory mapping is not used on this platform.
+func mapFile(path string) ([]byte, error) {
+	return os.ReadFile(path)
+}
+
+func unmapFile(data []byte) error {
+	return nil
+}
@@ -0,0 +1,268 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"math/bits"
+	"slices"
+	"sync/atomic"
+	"time"
+)
+
+const (
+	// defaultStallThreshold is the default of PlayerOptions.StallThreshold.
+	defaultStallThreshold = 100 * time.Millisecond
+
+	// stallDumpInterval is the minimum interval of the dumps of the stalls, so that a long stall is dumped once.
+	stallDumpInterval = time.Second
+)
+
+// FlightEventKind is the kind of a FlightEvent.
+type FlightEventKind int
+
+const (
+	// FlightPacketDemuxed is a packet pushed to the queue of its decoder. Value is the size of the packet.
+	FlightPacketDemuxed FlightEventKind = iota + 1
+
+	// FlightVideoDecodeStart and FlightVideoDecodeEnd are the start and the end of decoding a video packet.
+	// Value of FlightVideoDecodeEnd is the decoding time.
+	FlightVideoDecodeStart
+	FlightVideoDecodeEnd
+
+	// FlightAudioDecodeStart and FlightAudioDecodeEnd are the start and the end of decoding audio packets. Timecode
+	// is of the first packet, if any, and Value of FlightAudioDecodeEnd is the decoding time.
+	FlightAudioDecodeStart
+	FlightAudioDecodeEnd
+
+	// FlightFramePresented is a video frame presented by Update, and FlightFrameLate is a decoded frame dropped as
+	// late. Value is how late the frame is.
+	FlightFramePresented
+	FlightFrameLate
+
+	// FlightAudioRead is a read of the audio output, and Value is the size read. FlightAudioUnderrun is a read
+	// played partly or wholly as silence, and Value is the size of the silence.
+	FlightAudioRead
+	FlightAudioUnderrun
+)
+
+func (k FlightEventKind) String() string {
+	switch k {
+	case FlightPacketDemuxed:
+		return "PacketDemuxed"
+	case FlightVideoDecodeStart:
+		return "VideoDecodeStart"
+	case FlightVideoDecodeEnd:
+		return "VideoDecodeEnd"
+	case FlightAudioDecodeStart:
+		return "AudioDecodeStart"
+	case FlightAudioDecodeEnd:
+		return "AudioDecodeEnd"
+	case FlightFramePresented:
+		return "FramePresented"
+	case FlightFrameLate:
+		return "FrameLate"
+	case FlightAudioRead:
+		return "AudioRead"
+	case FlightAudioUnderrun:
+		return "AudioUnderrun"
+	}
+	return fmt.Sprintf("FlightEventKind(%d)", int(k))
+}
+
+// FlightEvent is an event of the pipeline kept by PlayerOptions.FlightRecorder.
+type FlightEvent struct {
+	Time time.Time
+	Kind FlightEventKind
+
+	// Track is the track number of the packet, or 0 if the event is not of a track.
+	Track uint
+
+	// Timecode is the timecode of the packet or the frame, or 0 for the audio output.
+	Timecode time.Duration
+
+	// Value is a value of the event, depending on Kind.
+	Value int64
+}
+
+// StallReason is the reason of a Stall.
+type StallReason int
+
+const (
+	// StallLateFrame is a video frame presented or dropped more than PlayerOptions.StallThreshold late.
+	StallLateFrame StallReason = iota + 1
+
+	// StallAudioUnderrun is the audio output played as silence because no audio was decoded in time, after the first
+	// audio and outside the pre-buffering.
+	StallAudioUnderrun
+)
+
+func (r StallReason) String() string {
+	switch r {
+	case StallLateFrame:
+		return "LateFrame"
+	case StallAudioUnderrun:
+		return "AudioUnderrun"
+	}
+	return fmt.Sprintf("StallReason(%d)", int(r))
+}
+
+// Stall is a stall of the pipeline passed to PlayerOptions.OnStall.
+type Stall struct {
+	Reason StallReason
+
+	// Events is the recent events of the pipeline, the oldest first.
+	Events []FlightEvent
+}
+
+// flightRecorder is a fixed-size ring of the recent events of a stream. The events are recorded by the goroutines of
+// the pipeline without locks: a writer takes a slot by the counter, and the slot's sequence number tells a reader
+// whether the slot is written completely.
+type flightRecorder struct {
+	created time.Time
+	slots   []flightSlot
+	next    atomic.Uint64
+
+	lateThreshold time.Duration
+
+	// stall is the StallReason of a stall not dumped yet, or 0.
+	stall atomic.Int32
+}
+
+type flightSlot struct {
+	// seq is the index of the event plus 1, or 0 while the slot is being written.
+	seq atomic.Uint64
+
+	// time is the time from the creation of the recorder, and kind is the kind and the track number shifted by 8.
+	time     atomic.Int64
+	kind     atomic.Uint64
+	timecode atomic.Int64
+	value    atomic.Int64
+}
+
+// newFlightRecorder returns a recorder of at least size events, or nil if size is not positive.
+func newFlightRecorder(size int, lateThreshold time.Duration) *flightRecorder {
+	if size <= 0 {
+		return nil
+	}
+	if lateThreshold <= 0 {
+		lateThreshold = defaultStallThreshold
+	}
+	return &flightRecorder{
+		created:       time.Now(),
+		slots:         make([]flightSlot, 1<<bits.Len(uint(size-1))),
+		lateThreshold: lateThreshold,
+	}
+}
+
+// record records an event. f can be nil, and then record does nothing.
+func (f *flightRecorder) record(kind FlightEventKind, track uint, timecode time.Duration, value int64) {
+	if f == nil {
+		return
+	}
+	i := f.next.Add(1) - 1
+	s := &f.slots[i&uint64(len(f.slots)-1)]
+	s.seq.Store(0)
+	s.time.Store(int64(time.Since(f.created)))
+	s.kind.Store(uint64(kind) | uint64(track)<<8)
+	s.timecode.Store(int64(timecode))
+	s.value.Store(value)
+	s.seq.Store(i + 1)
+}
+
+// late records a frame presented or dropped late by lateness, and marks a stall if it is over the threshold.
+func (f *flightRecorder) late(kind FlightEventKind, track uint, timecode, lateness time.Duration) {
+	if f == nil {
+		return
+	}
+	f.record(kind, track, timecode, int64(lateness))
+	if lateness > f.lateThreshold {
+		f.stall.CompareAndSwap(0, int32(StallLateFrame))
+	}
+}
+
+// underrun records the audio output played as silence of size bytes, and marks a stall.
+func (f *flightRecorder) underrun(size int) {
+	if f == nil {
+		return
+	}
+	f.record(FlightAudioUnderrun, 0, 0, int64(size))
+	f.stall.CompareAndSwap(0, int32(StallAudioUnderrun))
+}
+
+// takeStall returns the stall marked since the last call, or 0.
+func (f *flightRecorder) takeStall() StallReason {
+	if f == nil {
+		return 0
+	}
+	return StallReason(f.stall.Swap(0))
+}
+
+// appendEvents appends the events in the ring to dst, the oldest first. The slots being written are skipped.
+func (f *flightRecorder) appendEvents(dst []FlightEvent) []FlightEvent {
+	if f == nil {
+		return dst
+	}
+	next := f.next.Load()
+	first := next - min(next, uint64(len(f.slots)))
+	for i := first; i < next; i++ {
+		s := &f.slots[i&uint64(len(f.slots)-1)]
+		if s.seq.Load() != i+1 {
+			continue
+		}
+		e := FlightEvent{
+			Time:     f.created.Add(time.Duration(s.time.Load())),
+			Timecode: time.Duration(s.timecode.Load()),
+			Value:    s.value.Load(),
+		}
+		kind := s.kind.Load()
+		e.Kind = FlightEventKind(kind & 0xff)
+		e.Track = uint(kind >> 8)
+		// The slot was overwritten while being read.
+		if s.seq.Load() != i+1 {
+			continue
+		}
+		dst = append(dst, e)
+	}
+	return dst
+}
+
+// FlightRecord appends the recent events of the pipeline to dst, the oldest first, with PlayerOptions.FlightRecorder.
+// The events of all the inputs and renditions are merged. FlightRecord can be called at any time, e.g. when the
+// application notices a stall that OnStall doesn't.
+func (p *Player) FlightRecord(dst []FlightEvent) []FlightEvent {
+	n := len(dst)
+	for _, s := range p.streams() {
+		dst = s.stats.flight.appendEvents(dst)
+	}
+	slices.SortStableFunc(dst[n:], func(a, b FlightEvent) int {
+		return a.Time.Compare(b.Time)
+	})
+	return dst
+}
+
+// dumpStall calls PlayerOptions.OnStall if a stall has been marked, at most once in stallDumpInterval.
+func (p *Player) dumpStall() {
+	if p.onStall == nil {
+		return
+	}
+	var reason StallReason
+	for _, s := range p.streams() {
+		if r := s.stats.flight.takeStall(); r != 0 && reason == 0 {
+			reason = r
+		}
+	}
+	if reason == 0 {
+		return
+	}
+	now := time.Now()
+	if !p.stallDumped.IsZero() && now.Sub(p.stallDumped) < stallDumpInterval {
+		return
+	}
+	p.stallDumped = now
+	p.onStall(&Stall{
+		Reason: reason,
+		Events: p.FlightRecord(nil),
+	})
+}
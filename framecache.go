@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"time"
+)
+
+// videoFrameCache keeps the decoded frames of a whole pass of a short clip, e.g. a background loop, so that the next
+// passes after seeking are replayed from it without decoding. The frames are kept as they are published, in their
+// YCbCr planes, or RGBA for the subsamplings that are not drawn as YCbCr.
+//
+// With PlayerOptions.Loop, the passes follow each other without seeking, and the frames are kept with their timecodes
+// in the pass.
+//
+// A pass is recorded only if it starts at the beginning and reaches the end without skipping a frame, at the full
+// quality, within the budget. Otherwise, the cache is given up, and frees the frames. The cache is also given up while
+// the memory is over the budget of SetMemoryBudget.
+//
+// videoFrameCache is used only by the decoder's goroutine.
+type videoFrameCache struct {
+	// budget is PlayerOptions.VideoFrameCacheBytes, and size is the bytes of the frames.
+	budget int64
+	size   int64
+
+	// period is the duration of a pass with PlayerOptions.Loop, or 0.
+	period time.Duration
+
+	frames []cachedVideoFrame
+
+	// recording is the seek generation plus 1 being recorded, or 0. complete is true when a whole pass is recorded.
+	// failed is true when a pass can't be recorded anymore.
+	recording uint64
+	complete  bool
+	failed    bool
+
+	// next is the index of the frame to be replayed for the next packet, and content is the content of the frame
+	// replayed last.
+	next    int
+	content uint64
+}
+
+// cachedVideoFrame is a frame of videoFrameCache, with its content in the recorded pass.
+type cachedVideoFrame struct {
+	frame   videoFrame
+	content uint64
+}
+
+func newVideoFrameCache(budget int64, period time.Duration) *videoFrameCache {
+	if budget <= 0 {
+		return nil
+	}
+	return &videoFrameCache{
+		budget: budget,
+		period: period,
+	}
+}
+
+// start starts a pass of the seek generation gen to target. start reports whether the pass is replayed from the cache.
+func (c *videoFrameCache) start(gen uint64, target time.Duration) bool {
+	if c == nil {
+		return false
+	}
+	if c.complete && memoryPressure() {
+		c.fail()
+	}
+	if c.complete {
+		c.next = 0
+		c.content = 0
+		return true
+	}
+	c.reset()
+	if !c.failed && passTime(target, c.period) <= 0 {
+		c.recording = gen + 1
+	}
+	return false
+}
+
+// record keeps a copy of the published frame f of the seek generation gen.
+func (c *videoFrameCache) record(f *videoFrame, gen uint64) {
+	if c == nil || c.recording != gen+1 {
+		return
+	}
+	size := f.size()
+	if c.size+size > c.budget || memoryPressure() {
+		c.fail()
+		return
+	}
+	c.size += size
+	trackMemory(memoryFrameCaches, size)
+	c.frames = append(c.frames, cachedVideoFrame{content: f.content})
+	c.frames[len(c.frames)-1].frame.copyFrom(f)
+	c.frames[len(c.frames)-1].frame.timecode = passTime(f.timecode, c.period)
+}
+
+// skip gives up the pass being recorded, as a frame of it is not published, e.g. a late frame.
+func (c *videoFrameCache) skip() {
+	if c == nil || c.recording == 0 {
+		return
+	}
+	c.reset()
+}
+
+// end marks the end of the seek generation gen. A pass recorded to the end completes the cache.
+func (c *videoFrameCache) end(gen uint64) {
+	if c == nil || c.recording != gen+1 {
+		return
+	}
+	c.recording = 0
+	c.complete = len(c.frames) > 0
+}
+
+// fail gives up the cache for the Player, e.g. as the clip is too large for the budget.
+func (c *videoFrameCache) fail() {
+	c.reset()
+	c.complete = false
+	c.failed = true
+}
+
+func (c *videoFrameCache) reset() {
+	trackMemory(memoryFrameCaches, -c.size)
+	c.recording = 0
+	c.frames = nil
+	c.size = 0
+}
+
+// replay returns the cached frames up to the timecode of a packet, which are presented as if the packet was decoded,
+// and the start of the pass to be added to their timecodes.
+func (c *videoFrameCache) replay(timecode time.Duration) ([]cachedVideoFrame, time.Duration) {
+	local := passTime(timecode, c.period)
+	i := c.next
+	for c.next < len(c.frames) && c.frames[c.next].frame.timecode <= local {
+		c.next++
+	}
+	return c.frames[i:c.next], timecode - local
+}
+
+// setCached sets f to refer to the planes of the cached frame src without copying them. The planes are dropped by
+// releaseBuffer, so that they are not written as the frame's own ones.
+func (f *videoFrame) setCached(src *videoFrame) {
+	f.releaseBuffer()
+	f.timecode = src.timecode
+	f.isYCbCr = src.isYCbCr
+	f.ycbcr = src.ycbcr
+	f.rgba = src.rgba
+	f.depth = src.depth
+	f.colorSpace = src.colorSpace
+	f.fullRange = src.fullRange
+	f.alpha = src.alpha
+	f.alphaStride = src.alphaStride
+	f.shared = true
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"time"
+)
+
+// videoQuality is a level of the decoding quality lowered by PlayerOptions.VideoAdaptQuality. Each level includes
+// the lower levels.
+type videoQuality int32
+
+const (
+	videoQualityFull videoQuality = iota
+
+	// videoQualitySkipLoopFilter skips the loop filter of VP9.
+	videoQualitySkipLoopFilter
+
+	// videoQualityDropNonReference skips the frames not referred by other frames, even when they are on time.
+	videoQualityDropNonReference
+
+	// videoQualityHalfSize converts and uploads the frames at the half size.
+	videoQualityHalfSize
+)
+
+const (
+	// governorInterval is the interval to check the decoding load.
+	governorInterval = time.Second
+
+	// governorHoldTime is the time to keep a quality level before raising it.
+	governorHoldTime = 5 * time.Second
+)
+
+// qualityGovernor lowers the decoding quality while the decoder can't keep up, and raises it again when there is
+// enough headroom. qualityGovernor is used by Update.
+type qualityGovernor struct {
+	// check is the time to check the load next, and hold is the time until which the quality is not raised.
+	check time.Time
+	hold  time.Time
+
+	// late is the number of the late frames at the last check.
+	late int64
+}
+
+// updateQuality checks the decoding load of v and changes the quality level.
+func (v *videoStream) updateQuality(now time.Time) {
+	g := &v.governor
+	if now.Before(g.check) {
+		return
+	}
+	g.check = now.Add(governorInterval)
+
+	// The frames skipped by the governor are not counted as late.
+	load := v.decodeLoad()
+	late := v.stats.lateFrames.Load()
+	behind := late > g.late
+	g.late = late
+
+	q := videoQuality(v.quality.Load())
+	switch {
+	case q < videoQualityHalfSize && (behind || load > 0.85):
+		q++
+		g.hold = now.Add(governorHoldTime)
+	case q > videoQualityFull && !behind && load < 0.5 && !now.Before(g.hold):
+		q--
+		g.hold = now.Add(governorHoldTime)
+	default:
+		return
+	}
+	v.quality.Store(int32(q))
+}
+
+// drawnSize returns the target size of the decoded picture p to be drawn at the quality level q.
+func (v *videoStream) drawnSize(p *videoPicture, q videoQuality) (int, int) {
+	w, h := v.targetWidth, v.targetHeight
+	if q < videoQualityHalfSize {
+		return w, h
+	}
+	if w <= 0 && h <= 0 {
+		w, h = p.Width, p.Height
+	}
+	return max(w/2, 1), max(h/2, 1)
+}
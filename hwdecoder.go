@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"runtime"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer/internal/mediacodec"
+	"github.com/hajimehoshi/webmplayer/internal/videotoolbox"
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+const (
+	// hardwareInputTimeout is how long a hardware decoder waits for an input buffer.
+	hardwareInputTimeout = 100 * time.Millisecond
+
+	// hardwareOutputTimeout is how long a hardware decoder waits for the picture of a shown frame.
+	hardwareOutputTimeout = 100 * time.Millisecond
+
+	// maxHardwareMisses is the number of the shown frames in a row without a picture, after which a hardware decoder
+	// is given up.
+	maxHardwareMisses = 4
+)
+
+// hasHardwareVideoDecoder reports whether the platform has a hardware decoder of codec:
+// MediaCodec on Android for VP8 and VP9, and VideoToolbox on macOS for VP9.
+func hasHardwareVideoDecoder(codec videoCodec) bool {
+	switch runtime.GOOS {
+	case "android":
+		return codec == videoCodecVP8 || codec == videoCodecVP9
+	case "darwin":
+		return codec == videoCodecVP9
+	}
+	return false
+}
+
+// hardwareBackend is the decoder of the platform behind a hardwareDecoder.
+type hardwareBackend interface {
+	decode(data []byte) error
+
+	// next returns the picture of the last decoded packet, or false if there is none.
+	next() (mediacodec.Picture, bool, error)
+
+	flush()
+	close()
+}
+
+// newHardwareBackend creates the decoder of the platform for the stream of the keyframe k.
+// The pictures are read back to the CPU, as Ebitengine can't draw the surfaces of the platform.
+func newHardwareBackend(codec videoCodec, k vpxKeyframe) (hardwareBackend, error) {
+	// The images of Ebitengine are sampled as 8-bit 4:2:0.
+	if k.bitDepth != 8 || k.xChromaShift != 1 || k.yChromaShift != 1 {
+		return nil, fmt.Errorf("webmplayer: the hardware decoder doesn't support %d-bit %d:%d chroma shifts", k.bitDepth, k.xChromaShift, k.yChromaShift)
+	}
+	switch runtime.GOOS {
+	case "android":
+		mime := "video/x-vnd.on2.vp8"
+		if codec == videoCodecVP9 {
+			mime = "video/x-vnd.on2.vp9"
+		}
+		d, err := mediacodec.NewDecoder(mime, k.width, k.height)
+		if err != nil {
+			return nil, err
+		}
+		return &mediaCodecBackend{d: d}, nil
+	case "darwin":
+		d, err := videotoolbox.NewDecoder(k.width, k.height, k.fullRange)
+		if err != nil {
+			return nil, err
+		}
+		return &videoToolboxBackend{d: d}, nil
+	}
+	return nil, fmt.Errorf("webmplayer: no hardware decoder of %s", codec)
+}
+
+// hardwareDecoder decodes a VP8 or VP9 stream with the decoder of the platform.
+//
+// The backend is created at the first keyframe, whose header has the size. If the backend fails, e.g. as the
+// platform has no decoder for the stream, hardwareDecoder falls back to libvpx, which starts decoding at the next
+// keyframe. Once fallen back, the decoder keeps using libvpx.
+type hardwareDecoder struct {
+	codec   videoCodec
+	threads int
+
+	backend hardwareBackend
+
+	// width and height are the size the backend is created for.
+	width  int
+	height int
+
+	colorSpace vpxfb.ColorSpace
+	fullRange  bool
+
+	// shown reports whether the last decoded packet shows a frame.
+	shown bool
+
+	// misses is the number of the shown frames in a row without a picture.
+	misses int
+
+	// fallback is the libvpx decoder after the backend fails, or nil.
+	fallback videoDecoder
+
+	// waitKeyframe reports whether fallback waits for a keyframe.
+	waitKeyframe bool
+
+	// skipLoopFilter and spatialLayer are the last values of setSkipLoopFilter and setSpatialLayer, which fallback
+	// inherits.
+	skipLoopFilter bool
+	spatialLayer   int
+}
+
+func newHardwareDecoder(codec videoCodec, threads int) *hardwareDecoder {
+	return &hardwareDecoder{
+		codec:        codec,
+		threads:      threads,
+		spatialLayer: -1,
+	}
+}
+
+func (h *hardwareDecoder) start(codecPrivate []byte) error {
+	h.shown = false
+	h.misses = 0
+	h.skipLoopFilter = false
+	h.spatialLayer = -1
+	if h.fallback != nil {
+		return h.fallback.start(codecPrivate)
+	}
+	if h.backend != nil {
+		h.backend.flush()
+	}
+	return nil
+}
+
+func (h *hardwareDecoder) decode(data []byte) error {
+	h.shown = false
+	if h.fallback == nil {
+		err := h.decodeHardware(data)
+		if err == nil {
+			return nil
+		}
+		if err := h.fallBack(); err != nil {
+			return err
+		}
+	}
+	if h.waitKeyframe {
+		if !parseVPXFrame(h.codec, data).keyframe {
+			return nil
+		}
+		h.waitKeyframe = false
+	}
+	return h.fallback.decode(data)
+}
+
+func (h *hardwareDecoder) decodeHardware(data []byte) error {
+	if k, ok := parseVPXKeyframe(h.codec, data); ok {
+		h.colorSpace = k.colorSpace
+		h.fullRange = k.fullRange
+		// The size of a backend is fixed, while a keyframe can change the size.
+		if h.backend != nil && (k.width != h.width || k.height != h.height) {
+			h.backend.close()
+			h.backend = nil
+		}
+		if h.backend == nil {
+			b, err := newHardwareBackend(h.codec, k)
+			if err != nil {
+				return err
+			}
+			h.backend = b
+			h.width = k.width
+			h.height = k.height
+		}
+	}
+	if h.backend == nil {
+		return errors.New("webmplayer: the stream doesn't start with a keyframe")
+	}
+	if err := h.backend.decode(data); err != nil {
+		return err
+	}
+	h.shown = vpxShowsFrame(h.codec, data)
+	return nil
+}
+
+// fallBack replaces the backend with libvpx.
+func (h *hardwareDecoder) fallBack() error {
+	if h.backend != nil {
+		h.backend.close()
+		h.backend = nil
+	}
+	d, err := newVPXDecoder(h.codec, h.threads)
+	if err != nil {
+		return err
+	}
+	if err := d.start(nil); err != nil {
+		d.destroy()
+		return err
+	}
+	d.setSkipLoopFilter(h.skipLoopFilter)
+	d.setSpatialLayer(h.spatialLayer)
+	h.fallback = d
+	h.waitKeyframe = true
+	h.shown = false
+	return nil
+}
+
+func (h *hardwareDecoder) next() (videoPicture, bool, error) {
+	if h.fallback != nil {
+		return h.fallback.next()
+	}
+	if !h.shown {
+		return videoPicture{}, false, nil
+	}
+	h.shown = false
+	pic, ok, err := h.backend.next()
+	if err == nil && !ok {
+		// The picture might come with a later packet. A backend that keeps missing the pictures is given up.
+		h.misses++
+		if h.misses < maxHardwareMisses {
+			return videoPicture{}, false, nil
+		}
+	}
+	if err != nil || !ok {
+		// The current packet is dropped, and libvpx starts at the next keyframe.
+		return videoPicture{}, false, h.fallBack()
+	}
+	h.misses = 0
+
+	p := videoPicture{}
+	p.Width = pic.Width
+	p.Height = pic.Height
+	p.BitDepth = 8
+	p.XChromaShift = 1
+	p.YChromaShift = 1
+	p.ColorSpace = h.colorSpace
+	p.FullRange = h.fullRange
+	p.Planes = pic.Planes
+	p.Strides = pic.Strides
+	return p, true, nil
+}
+
+// setSkipLoopFilter applies only to libvpx after falling back, as the platform decoders don't skip the loop filter.
+func (h *hardwareDecoder) setSkipLoopFilter(skip bool) {
+	h.skipLoopFilter = skip
+	if h.fallback != nil {
+		h.fallback.setSkipLoopFilter(skip)
+	}
+}
+
+// setSpatialLayer applies only to libvpx after falling back.
+func (h *hardwareDecoder) setSpatialLayer(layer int) {
+	h.spatialLayer = layer
+	if h.fallback != nil {
+		h.fallback.setSpatialLayer(layer)
+	}
+}
+
+func (h *hardwareDecoder) destroy() {
+	if h.backend != nil {
+		h.backend.close()
+		h.backend = nil
+	}
+	if h.fallback != nil {
+		h.fallback.destroy()
+		h.fallback = nil
+	}
+}
+
+// mediaCodecBackend is a hardwareBackend of MediaCodec on Android.
+type mediaCodecBackend struct {
+	d *mediacodec.Decoder
+}
+
+func (m *mediaCodecBackend) decode(data []byte) error {
+	return m.d.Decode(data, hardwareInputTimeout)
+}
+
+func (m *mediaCodecBackend) next() (mediacodec.Picture, bool, error) {
+	return m.d.Next(hardwareOutputTimeout)
+}
+
+func (m *mediaCodecBackend) flush() {
+	m.d.Flush()
+}
+
+func (m *mediaCodecBackend) close() {
+	m.d.Close()
+}
+
+// videoToolboxBackend is a hardwareBackend of VideoToolbox on macOS, which decodes synchronously.
+type videoToolboxBackend struct {
+	d *videotoolbox.Decoder
+}
+
+func (v *videoToolboxBackend) decode(data []byte) error {
+	return v.d.Decode(data)
+}
+
+func (v *videoToolboxBackend) next() (mediacodec.Picture, bool, error) {
+	p, ok, err := v.d.Next()
+	return mediacodec.Picture(p), ok, err
+}
+
+func (v *videoToolboxBackend) flush() {
+}
+
+func (v *videoToolboxBackend) close() {
+	v.d.Close()
+}
@@ -29,12 +29,99 @@ type GenerateOptions struct {
 	AllowedFiles []string
 	BlockedFiles []string
 	BlockedDirs  []string
+
+	// PreservedFiles are hand-written files in the output directory that are not removed on regeneration.
+	PreservedFiles []string
+
+	// BuildConstraint is the expression of the //go:build line added to the output C files, e.g. to link the objects
+	// built by BuildPrebuilt instead of them.
+	BuildConstraint string
+
+	// Amalgamations are unity translation units of the C files.
+	// cgo compiles each C file separately without link-time optimization, so a function is not inlined into the
+	// other files. The C files in an amalgamation are output with the .inc extension so that cgo doesn't compile them,
+	// and the amalgamation includes them in order.
+	Amalgamations []Amalgamation
+
+	// Tagged are the C files compiled only with a build tag, e.g. the encoders that the decoders don't use.
+	Tagged []Tagged
+
+	// Patches are applied to the files after the include paths are rewritten.
+	Patches []Patch
+}
+
+// Amalgamation is an output C file that includes the C files of an archive.
+type Amalgamation struct {
+	// Name is the name of the output C file.
+	Name string
+
+	// Files are the paths or the path.Match patterns of the C files in the archive.
+	// The C files are included in the order of the first matching entries, and then in the order of the names.
+	Files []string
+
+	// ExcludedFiles are the C files that are compiled separately even if they match Files, e.g. for the static
+	// definitions that conflict with the other files.
+	ExcludedFiles []string
+}
+
+// Tagged is a set of the C files of an archive compiled only with a build tag.
+type Tagged struct {
+	// Tag is the expression of the //go:build line of the C files. BuildConstraint is not added, so that the C
+	// files are also compiled with the objects built by BuildPrebuilt, which don't include them.
+	Tag string
+
+	// Files are the paths or the path.Match patterns of the C files in the archive.
+	// The C files are not included in the amalgamations.
+	Files []string
+}
+
+// Patch replaces all the occurrences of Old with New in File. File is a path in the archive.
+type Patch struct {
+	File string
+	Old  string
+	New  string
 }
 
 type context struct {
 	options *GenerateOptions
 }
 
+// tagged returns the set of the tagged C files including the C file name, or nil if there is none.
+func (c *context) tagged(name string) *Tagged {
+	if !strings.HasSuffix(name, ".c") {
+		return nil
+	}
+	for i := range c.options.Tagged {
+		t := &c.options.Tagged[i]
+		for _, pattern := range t.Files {
+			if ok, _ := path.Match(pattern, name); ok {
+				return t
+			}
+		}
+	}
+	return nil
+}
+
+// amalgamation returns the amalgamation including the C file name and the index of the matching entry of Files,
+// or nil if there is none.
+func (c *context) amalgamation(name string) (*Amalgamation, int) {
+	if !strings.HasSuffix(name, ".c") || c.tagged(name) != nil {
+		return nil, 0
+	}
+	for i := range c.options.Amalgamations {
+		a := &c.options.Amalgamations[i]
+		if slices.Contains(a.ExcludedFiles, name) {
+			continue
+		}
+		for j, pattern := range a.Files {
+			if ok, _ := path.Match(pattern, name); ok {
+				return a, j
+			}
+		}
+	}
+	return nil, 0
+}
+
 type entry struct {
 	name    string
 	content []byte
@@ -43,10 +130,12 @@ type entry struct {
 
 func Generate(options ...*GenerateOptions) error {
 	suffixes := make([]string, 0, len(options))
+	var preserved []string
 	for _, op := range options {
 		suffixes = append(suffixes, op.ProjectName)
+		preserved = append(preserved, op.PreservedFiles...)
 	}
-	if err := clean(suffixes); err != nil {
+	if err := clean(suffixes, preserved); err != nil {
 		return err
 	}
 
@@ -84,7 +173,7 @@ func Generate(options ...*GenerateOptions) error {
 	return nil
 }
 
-func clean(suffixes []string) error {
+func clean(suffixes []string, preserved []string) error {
 	if err := filepath.Walk(".", func(p string, info fs.FileInfo, err error) error {
 		if err != nil {
 			return err
@@ -92,8 +181,11 @@ func clean(suffixes []string) error {
 		if info.IsDir() && p != "." {
 			return filepath.SkipDir
 		}
+		if slices.Contains(preserved, p) {
+			return nil
+		}
 
-		remove := strings.HasSuffix(p, ".c") || strings.HasSuffix(p, ".h")
+		remove := strings.HasSuffix(p, ".c") || strings.HasSuffix(p, ".h") || strings.HasSuffix(p, ".inc")
 		if !remove {
 			for _, suffix := range suffixes {
 				if strings.HasSuffix(strings.TrimSuffix(p, path.Ext(p)), suffix) {
@@ -212,6 +304,13 @@ func (c *context) isAllowed(name string) bool {
 }
 
 func outputFiles(dst string, entries []entry) error {
+	type amalgamated struct {
+		name  string
+		index int
+	}
+	amalgamations := map[*Amalgamation][]amalgamated{}
+	amalgamationOptions := map[*Amalgamation]*GenerateOptions{}
+
 entries:
 	for _, entry := range entries {
 		if !entry.context.isAllowed(entry.name) {
@@ -252,24 +351,31 @@ entries:
 				}
 
 				var needReplace bool
-				for _, entry1 := range entries {
+				var included int
+				for i, entry1 := range entries {
 					key := entry1.name
 					for _, dir := range entry.context.options.TopDirs {
 						key = strings.TrimPrefix(key, dir+"/")
 					}
 					if key == p {
 						needReplace = true
+						included = i
 						break
 					}
 					// Relative path.
 					if strings.HasSuffix(key, "/"+p) {
 						p = key
 						needReplace = true
+						included = i
 						break
 					}
 				}
 				if needReplace {
 					p = strings.ReplaceAll(p, "/", "_")
+					// An included C file in an amalgamation is renamed.
+					if a, _ := entries[included].context.amalgamation(entries[included].name); a != nil {
+						p = strings.TrimSuffix(p, ".c") + ".inc"
+					}
 					newBS = append(newBS, []byte(m[1]+p+m[3])...)
 				} else {
 					newBS = append(newBS, line...)
@@ -283,6 +389,16 @@ entries:
 			bs = newBS
 		}
 
+		for _, patch := range entry.context.options.Patches {
+			if patch.File != entry.name {
+				continue
+			}
+			if !bytes.Contains(bs, []byte(patch.Old)) {
+				return fmt.Errorf("patch target not found in %s: %q", entry.name, patch.Old)
+			}
+			bs = bytes.ReplaceAll(bs, []byte(patch.Old), []byte(patch.New))
+		}
+
 		outName := entry.name
 		if tokens := strings.Split(entry.name, "/"); len(tokens) > 1 {
 			if slices.Contains(entry.context.options.TopDirs, tokens[0]) {
@@ -291,10 +407,22 @@ entries:
 			outName = strings.Join(tokens, "_")
 		}
 
+		if a, index := entry.context.amalgamation(entry.name); a != nil {
+			outName = strings.TrimSuffix(outName, ".c") + ".inc"
+			amalgamations[a] = append(amalgamations[a], amalgamated{name: outName, index: index})
+			amalgamationOptions[a] = entry.context.options
+		}
+
 		if slices.Contains(entry.context.options.AllowedFiles, outName) {
 			ext := path.Ext(outName)
 			outName = strings.TrimSuffix(outName, ext) + entry.context.fileNameSuffix() + ext
 		}
+		if t := entry.context.tagged(entry.name); t != nil {
+			bs = append([]byte("//go:build "+t.Tag+"\n\n"), bs...)
+		} else if expr := entry.context.options.BuildConstraint; expr != "" && strings.HasSuffix(outName, ".c") {
+			bs = append([]byte("//go:build "+expr+"\n\n"), bs...)
+		}
+
 		if _, err := os.Stat(filepath.Join(dst, outName)); err == nil {
 			return fmt.Errorf("file already exists: %s", outName)
 		} else if !errors.Is(err, os.ErrNotExist) {
@@ -304,5 +432,37 @@ entries:
 			return err
 		}
 	}
+
+	for _, entry := range entries {
+		for i := range entry.context.options.Amalgamations {
+			if a := &entry.context.options.Amalgamations[i]; len(amalgamations[a]) == 0 {
+				return fmt.Errorf("no C files in the amalgamation: %s", a.Name)
+			}
+		}
+	}
+	for a, files := range amalgamations {
+		slices.SortFunc(files, func(x, y amalgamated) int {
+			if x.index != y.index {
+				return x.index - y.index
+			}
+			return strings.Compare(x.name, y.name)
+		})
+		var buf bytes.Buffer
+		buf.WriteString("// Code generated by cgen. DO NOT EDIT.\n\n")
+		if expr := amalgamationOptions[a].BuildConstraint; expr != "" {
+			buf.WriteString("//go:build " + expr + "\n\n")
+		}
+		for _, f := range files {
+			fmt.Fprintf(&buf, "#include \"%s\"\n", f.name)
+		}
+		if _, err := os.Stat(filepath.Join(dst, a.Name)); err == nil {
+			return fmt.Errorf("file already exists: %s", a.Name)
+		} else if !errors.Is(err, os.ErrNotExist) {
+			return err
+		}
+		if err := os.WriteFile(filepath.Join(dst, a.Name), buf.Bytes(), 0644); err != nil {
+			return err
+		}
+	}
 	return nil
 }
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package cgen
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"strings"
+)
+
+// PrebuiltOptions is the options of BuildPrebuilt.
+type PrebuiltOptions struct {
+	// Package is the path of the cgo package whose C files are built, e.g. ".".
+	Package string
+
+	// OutputDir is the directory of the output files. The Go package in the directory is linked instead of the
+	// C files of Package, e.g. by importing it from a file with the build tag that GenerateOptions.BuildConstraint
+	// excludes.
+	OutputDir string
+
+	// Name is the prefix of the output file names. The files are named Name_GOOS_GOARCH.syso.
+	Name string
+
+	// Platforms are the GOOS/GOARCH pairs to build the C files for, e.g. "linux/amd64".
+	// The C compiler for a platform is CC_FOR_GOOS_GOARCH of the environment, or go env CC without it.
+	Platforms []string
+}
+
+// BuildPrebuilt compiles the C files of a cgo package with its cgo flags, and links them into one relocatable object
+// file for each platform.
+func BuildPrebuilt(options *PrebuiltOptions) error {
+	for _, platform := range options.Platforms {
+		goos, goarch, ok := strings.Cut(platform, "/")
+		if !ok {
+			return fmt.Errorf("invalid platform: %s", platform)
+		}
+		if err := buildPrebuilt(options, goos, goarch); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+func buildPrebuilt(options *PrebuiltOptions, goos, goarch string) error {
+	env := append(os.Environ(), "GOOS="+goos, "GOARCH="+goarch, "CGO_ENABLED=1")
+
+	cmd := exec.Command("go", "list", "-json", options.Package)
+	cmd.Env = env
+	cmd.Stderr = os.Stderr
+	out, err := cmd.Output()
+	if err != nil {
+		return err
+	}
+	var pkg struct {
+		Dir         string
+		CFiles      []string
+		CgoCPPFLAGS []string
+		CgoCFLAGS   []string
+	}
+	if err := json.Unmarshal(out, &pkg); err != nil {
+		return err
+	}
+	if len(pkg.CFiles) == 0 {
+		return fmt.Errorf("no C files in %s for %s/%s", options.Package, goos, goarch)
+	}
+
+	cc := os.Getenv("CC_FOR_" + goos + "_" + goarch)
+	if cc == "" {
+		cmd := exec.Command("go", "env", "CC")
+		cmd.Env = env
+		out, err := cmd.Output()
+		if err != nil {
+			return err
+		}
+		cc = string(bytes.TrimSpace(out))
+	}
+	ccArgs := strings.Fields(cc)
+	if len(ccArgs) == 0 {
+		return fmt.Errorf("no C compiler for %s/%s", goos, goarch)
+	}
+
+	// The flags follow the ones that cmd/go passes to the C compiler for cgo.
+	var flags []string
+	switch goarch {
+	case "amd64":
+		flags = append(flags, "-m64")
+	case "386":
+		flags = append(flags, "-m32")
+	case "arm":
+		flags = append(flags, "-marm")
+	}
+	if goos != "windows" {
+		flags = append(flags, "-fPIC")
+	}
+	flags = append(flags, strings.Fields(os.Getenv("CGO_CFLAGS"))...)
+	flags = append(flags, pkg.CgoCPPFLAGS...)
+	flags = append(flags, pkg.CgoCFLAGS...)
+	flags = append(flags, "-I", pkg.Dir)
+
+	tmp, err := os.MkdirTemp("", "cgen-prebuilt-")
+	if err != nil {
+		return err
+	}
+	defer os.RemoveAll(tmp)
+
+	var objs []string
+	for i, f := range pkg.CFiles {
+		obj := filepath.Join(tmp, fmt.Sprintf("%d.o", i))
+		args := append(append(append([]string{}, ccArgs[1:]...), flags...), "-c", filepath.Join(pkg.Dir, f), "-o", obj)
+		if err := run(ccArgs[0], args...); err != nil {
+			return fmt.Errorf("compiling %s for %s/%s failed: %w", f, goos, goarch, err)
+		}
+		objs = append(objs, obj)
+	}
+
+	if err := os.MkdirAll(options.OutputDir, 0755); err != nil {
+		return err
+	}
+	syso := filepath.Join(options.OutputDir, fmt.Sprintf("%s_%s_%s.syso", options.Name, goos, goarch))
+	args := append(append(append([]string{}, ccArgs[1:]...), "-r", "-nostdlib", "-o", syso), objs...)
+	if err := run(ccArgs[0], args...); err != nil {
+		return fmt.Errorf("linking %s failed: %w", syso, err)
+	}
+	return nil
+}
+
+func run(name string, args ...string) error {
+	cmd := exec.Command(name, args...)
+	cmd.Stdout = os.Stdout
+	cmd.Stderr = os.Stderr
+	return cmd.Run()
+}
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build dav1d
+
+package dav1d
+
+// #cgo pkg-config: dav1d
+//
+// #include <errno.h>
+// #include <string.h>
+// #include <dav1d/dav1d.h>
+//
+// static int dav1d_eagain(void) {
+//   return DAV1D_ERR(EAGAIN);
+// }
+//
+// // dav1d_copy_data copies buf to data, as libdav1d keeps the data until the frames are decoded.
+// static int dav1d_copy_data(Dav1dData* data, const uint8_t* buf, size_t size) {
+//   uint8_t* dst = dav1d_data_create(data, size);
+//   if (!dst) {
+//     return -1;
+//   }
+//   memcpy(dst, buf, size);
+//   return 0;
+// }
+import "C"
+
+import (
+	"fmt"
+	"unsafe"
+)
+
+// Decoder is an AV1 decoder.
+type Decoder struct {
+	c *C.Dav1dContext
+
+	// pending is the data that libdav1d hasn't consumed yet.
+	pending C.Dav1dData
+
+	// pic is the picture returned by Next last, and hasPic is true while pic has a reference.
+	pic    C.Dav1dPicture
+	hasPic bool
+}
+
+// NewDecoder creates a decoder with threads threads, which decode tiles and apply the loop filters in parallel.
+//
+// The frames are not decoded in parallel, so that each picture is returned right after its data is decoded.
+// Frame threading would delay pictures behind the data by the number of the frames in flight.
+func NewDecoder(threads int) (*Decoder, error) {
+	var s C.Dav1dSettings
+	C.dav1d_default_settings(&s)
+	s.n_threads = C.int(threads)
+	s.max_frame_delay = 1
+	d := &Decoder{}
+	if r := C.dav1d_open(&d.c, &s); r < 0 {
+		return nil, fmt.Errorf("dav1d: dav1d_open failed: %d", int(r))
+	}
+	return d, nil
+}
+
+// Decode passes the OBUs of a temporal unit to the decoder. data is copied.
+// The pictures are returned by Next, which must be called until it reports false before the next Decode.
+func (d *Decoder) Decode(data []byte) error {
+	d.unrefPicture()
+	if d.pending.sz > 0 {
+		C.dav1d_data_unref(&d.pending)
+	}
+	if len(data) == 0 {
+		return nil
+	}
+	if C.dav1d_copy_data(&d.pending, (*C.uint8_t)(unsafe.Pointer(unsafe.SliceData(data))), C.size_t(len(data))) != 0 {
+		return fmt.Errorf("dav1d: allocating data failed")
+	}
+	return d.send()
+}
+
+// send passes the pending data to the decoder. The data is kept if the decoder has a picture to output first.
+func (d *Decoder) send() error {
+	if r := C.dav1d_send_data(d.c, &d.pending); r < 0 && r != C.dav1d_eagain() {
+		C.dav1d_data_unref(&d.pending)
+		return fmt.Errorf("dav1d: dav1d_send_data failed: %d", int(r))
+	}
+	return nil
+}
+
+// Next returns the next decoded picture, or false if the decoder needs more data.
+// The picture is valid until the next call of Next, Decode, Flush or Close.
+func (d *Decoder) Next() (Picture, bool, error) {
+	d.unrefPicture()
+	for {
+		r := C.dav1d_get_picture(d.c, &d.pic)
+		if r == 0 {
+			d.hasPic = true
+			return d.picture(), true, nil
+		}
+		if r != C.dav1d_eagain() {
+			return Picture{}, false, fmt.Errorf("dav1d: dav1d_get_picture failed: %d", int(r))
+		}
+		if d.pending.sz == 0 {
+			return Picture{}, false, nil
+		}
+		sz := d.pending.sz
+		if err := d.send(); err != nil {
+			return Picture{}, false, err
+		}
+		if d.pending.sz == sz {
+			C.dav1d_data_unref(&d.pending)
+			return Picture{}, false, fmt.Errorf("dav1d: the decoder doesn't consume the data")
+		}
+	}
+}
+
+func (d *Decoder) picture() Picture {
+	p := &d.pic
+	r := Picture{
+		Width:    int(p.p.w),
+		Height:   int(p.p.h),
+		BitDepth: int(p.p.bpc),
+		Layout:   Layout(p.p.layout),
+	}
+	if p.seq_hdr != nil {
+		r.MatrixCoefficients = int(p.seq_hdr.mtrx)
+		r.FullRange = p.seq_hdr.color_range != 0
+	}
+	_, yShift := r.Layout.ChromaShifts()
+	for i := 0; i < 3; i++ {
+		if p.data[i] == nil {
+			continue
+		}
+		h := r.Height
+		if i > 0 {
+			h = (h + 1<<yShift - 1) >> yShift
+		}
+		r.Strides[i] = int(p.stride[min(i, 1)])
+		r.Planes[i] = unsafe.Slice((*byte)(p.data[i]), r.Strides[i]*h)
+	}
+	return r
+}
+
+func (d *Decoder) unrefPicture() {
+	if !d.hasPic {
+		return
+	}
+	C.dav1d_picture_unref(&d.pic)
+	d.hasPic = false
+}
+
+// Flush drops the pending data and the frames being decoded, e.g. before decoding another stream.
+func (d *Decoder) Flush() {
+	d.unrefPicture()
+	if d.pending.sz > 0 {
+		C.dav1d_data_unref(&d.pending)
+	}
+	C.dav1d_flush(d.c)
+}
+
+// Close frees the decoder.
+func (d *Decoder) Close() {
+	d.Flush()
+	C.dav1d_close(&d.c)
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// Package dav1d provides an AV1 decoder with libdav1d.
+//
+// libdav1d is not vendored, and is linked by pkg-config only with the dav1d build tag. Without the tag, NewDecoder
+// returns an error.
+package dav1d
+
+// Layout is the chroma subsampling of a picture, as Dav1dPixelLayout.
+type Layout int
+
+const (
+	LayoutI400 Layout = 0
+	LayoutI420 Layout = 1
+	LayoutI422 Layout = 2
+	LayoutI444 Layout = 3
+)
+
+// ChromaShifts returns the subsampling of the chroma planes, e.g. 1 and 1 for 4:2:0. For LayoutI400, which has no
+// chroma planes, ChromaShifts returns the ones of 4:2:0.
+func (l Layout) ChromaShifts() (x, y int) {
+	switch l {
+	case LayoutI422:
+		return 1, 0
+	case LayoutI444:
+		return 0, 0
+	}
+	return 1, 1
+}
+
+// Picture is a decoded picture.
+type Picture struct {
+	Width  int
+	Height int
+
+	// BitDepth is the bit depth of the samples. If BitDepth is more than 8, each sample is a little-endian uint16.
+	// Otherwise, each sample is a byte.
+	BitDepth int
+
+	Layout Layout
+
+	// MatrixCoefficients is the matrix of the sequence header, as ISO/IEC 23091-4, and FullRange is its color range.
+	MatrixCoefficients int
+	FullRange          bool
+
+	// Planes are the Y, U and V planes, and Strides are their strides in bytes. The chroma planes are nil for
+	// LayoutI400. The planes refer to the memory of libdav1d.
+	Planes  [3][]byte
+	Strides [3]int
+}
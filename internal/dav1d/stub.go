@@ -0,0 +1,34 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !dav1d
+
+package dav1d
+
+import (
+	"errors"
+)
+
+var errUnavailable = errors.New("dav1d: AV1 is not supported without the dav1d build tag")
+
+// Decoder is an AV1 decoder.
+type Decoder struct{}
+
+// NewDecoder returns an error, as libdav1d is not linked.
+func NewDecoder(threads int) (*Decoder, error) {
+	return nil, errUnavailable
+}
+
+func (d *Decoder) Decode(data []byte) error {
+	return errUnavailable
+}
+
+func (d *Decoder) Next() (Picture, bool, error) {
+	return Picture{}, false, errUnavailable
+}
+
+func (d *Decoder) Flush() {
+}
+
+func (d *Decoder) Close() {
+}
@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// Package flac decodes FLAC frames.
+//
+// https://datatracker.ietf.org/doc/html/rfc9639
+package flac
+
+import (
+	"errors"
+	"fmt"
+)
+
+// StreamInfo is the STREAMINFO metadata block.
+type StreamInfo struct {
+	MaxBlockSize  int
+	SampleRate    int
+	Channels      int
+	BitsPerSample int
+}
+
+// ParseStreamInfo parses the STREAMINFO block of the metadata, which starts with the "fLaC" marker as the CodecPrivate
+// of Matroska.
+func ParseStreamInfo(metadata []byte) (StreamInfo, error) {
+	if len(metadata) < 4 || string(metadata[:4]) != "fLaC" {
+		return StreamInfo{}, errors.New("flac: no fLaC marker")
+	}
+	b := metadata[4:]
+	// The block header: the last-metadata-block flag and the block type in a byte, and the 24-bit size.
+	if len(b) < 4+18 || b[0]&0x7f != 0 {
+		return StreamInfo{}, errors.New("flac: no STREAMINFO")
+	}
+	r := bitReader{data: b[4:]}
+	var info StreamInfo
+	r.read(16)
+	info.MaxBlockSize = int(r.read(16))
+	r.read(24)
+	r.read(24)
+	info.SampleRate = int(r.read(20))
+	info.Channels = int(r.read(3)) + 1
+	info.BitsPerSample = int(r.read(5)) + 1
+	if info.SampleRate == 0 || info.BitsPerSample < 4 {
+		return StreamInfo{}, fmt.Errorf("flac: invalid STREAMINFO: %d Hz, %d bits", info.SampleRate, info.BitsPerSample)
+	}
+	return info, nil
+}
+
+// Decoder decodes FLAC frames.
+type Decoder struct {
+	info StreamInfo
+
+	// samples is the decoded samples of each channel.
+	samples [8][]int32
+}
+
+// NewDecoder creates a Decoder of the stream of info.
+func NewDecoder(info StreamInfo) *Decoder {
+	return &Decoder{info: info}
+}
+
+// Frame is a decoded frame.
+type Frame struct {
+	// Samples is the samples of each channel. The samples are valid until the next call of DecodeFrame.
+	Samples [][]int32
+
+	// BitsPerSample is the bit depth of the samples.
+	BitsPerSample int
+}
+
+// DecodeFrame decodes the frame at the start of data, and returns it with the size of the frame.
+func (d *Decoder) DecodeFrame(data []byte) (Frame, int, error) {
+	r := bitReader{data: data}
+
+	// 9.1 Frame header
+	if r.read(14) != 0x3ffe {
+		return Frame{}, 0, errors.New("flac: no frame sync code")
+	}
+	r.read(1)
+	r.read(1)
+	blockSizeCode := r.read(4)
+	sampleRateCode := r.read(4)
+	channelAssignment := int(r.read(4))
+	sampleSizeCode := r.read(3)
+	r.read(1)
+	// The coded frame or sample number, in the UTF-8 like encoding.
+	first := r.read(8)
+	for m := uint64(0x80); m > 0 && first&m != 0; m >>= 1 {
+		if m == 0x80 {
+			continue
+		}
+		r.read(8)
+	}
+
+	var blockSize int
+	switch {
+	case blockSizeCode == 1:
+		blockSize = 192
+	case blockSizeCode >= 2 && blockSizeCode <= 5:
+		blockSize = 576 << (blockSizeCode - 2)
+	case blockSizeCode == 6:
+		blockSize = int(r.read(8)) + 1
+	case blockSizeCode == 7:
+		blockSize = int(r.read(16)) + 1
+	case blockSizeCode >= 8:
+		blockSize = 256 << (blockSizeCode - 8)
+	default:
+		return Frame{}, 0, errors.New("flac: reserved block size")
+	}
+	switch sampleRateCode {
+	case 12:
+		r.read(8)
+	case 13, 14:
+		r.read(16)
+	case 15:
+		return Frame{}, 0, errors.New("flac: invalid sample rate")
+	}
+
+	bps := d.info.BitsPerSample
+	switch sampleSizeCode {
+	case 0:
+	case 1:
+		bps = 8
+	case 2:
+		bps = 12
+	case 4:
+		bps = 16
+	case 5:
+		bps = 20
+	case 6:
+		bps = 24
+	case 7:
+		bps = 32
+	default:
+		return Frame{}, 0, errors.New("flac: reserved sample size")
+	}
+	// CRC-8 of the header.
+	r.read(8)
+
+	channels := channelAssignment + 1
+	if channelAssignment >= 8 {
+		if channelAssignment > 10 {
+			return Frame{}, 0, errors.New("flac: reserved channel assignment")
+		}
+		channels = 2
+	}
+
+	for c := range channels {
+		if cap(d.samples[c]) < blockSize {
+			d.samples[c] = make([]int32, blockSize)
+		}
+		d.samples[c] = d.samples[c][:blockSize]
+		// The side channel has an extra bit.
+		sbps := bps
+		if (channelAssignment == 8 || channelAssignment == 10) && c == 1 || channelAssignment == 9 && c == 0 {
+			sbps++
+		}
+		if err := d.decodeSubframe(&r, d.samples[c], sbps); err != nil {
+			return Frame{}, 0, err
+		}
+	}
+	if r.overrun {
+		return Frame{}, 0, errors.New("flac: unexpected end of frame")
+	}
+
+	// 4.2 Interchannel decorrelation
+	left, right := d.samples[0], d.samples[1]
+	switch channelAssignment {
+	case 8:
+		for i, side := range right {
+			right[i] = left[i] - side
+		}
+	case 9:
+		for i, side := range left {
+			left[i] = side + right[i]
+		}
+	case 10:
+		for i, side := range right {
+			mid := left[i]<<1 | side&1
+			left[i] = (mid + side) >> 1
+			right[i] = (mid - side) >> 1
+		}
+	}
+
+	// 9.3 Frame footer: the frame ends with the CRC-16 after the byte alignment.
+	size := (r.pos+7)/8 + 2
+	if size > len(data) {
+		return Frame{}, 0, errors.New("flac: unexpected end of frame")
+	}
+	return Frame{
+		Samples:       d.samples[:channels],
+		BitsPerSample: bps,
+	}, size, nil
+}
+
+// decodeSubframe decodes a subframe of bps bits into samples.
+func (d *Decoder) decodeSubframe(r *bitReader, samples []int32, bps int) error {
+	// 9.2 Subframes
+	r.read(1)
+	typ := r.read(6)
+	wasted := 0
+	if r.read(1) == 1 {
+		wasted = 1
+		for r.read(1) == 0 && !r.overrun {
+			wasted++
+		}
+		bps -= wasted
+	}
+	if bps <= 0 || bps > 32 {
+		return fmt.Errorf("flac: unsupported sample size: %d", bps)
+	}
+
+	switch {
+	case typ == 0:
+		v := r.readSigned(bps)
+		for i := range samples {
+			samples[i] = v
+		}
+	case typ == 1:
+		for i := range samples {
+			samples[i] = r.readSigned(bps)
+		}
+	case typ >= 8 && typ <= 12:
+		order := int(typ - 8)
+		if err := d.decodeWarmUp(r, samples, order, bps); err != nil {
+			return err
+		}
+		if err := decodeResidual(r, samples, order); err != nil {
+			return err
+		}
+		restoreFixed(samples, order)
+	case typ >= 32:
+		order := int(typ-32) + 1
+		if err := d.decodeWarmUp(r, samples, order, bps); err != nil {
+			return err
+		}
+		precision := int(r.read(4)) + 1
+		if precision == 16 {
+			return errors.New("flac: invalid LPC precision")
+		}
+		shift := int(r.readSigned(5))
+		if shift < 0 {
+			return errors.New("flac: negative LPC shift")
+		}
+		var coefs [32]int32
+		for j := range order {
+			coefs[j] = r.readSigned(precision)
+		}
+		if err := decodeResidual(r, samples, order); err != nil {
+			return err
+		}
+		restoreLPC(samples, coefs[:order], shift)
+	default:
+		return fmt.Errorf("flac: reserved subframe type: %d", typ)
+	}
+
+	if wasted > 0 {
+		for i := range samples {
+			samples[i] <<= wasted
+		}
+	}
+	return nil
+}
+
+func (d *Decoder) decodeWarmUp(r *bitReader, samples []int32, order, bps int) error {
+	if order > len(samples) {
+		return errors.New("flac: the predictor order is more than the block size")
+	}
+	for i := range order {
+		samples[i] = r.readSigned(bps)
+	}
+	return nil
+}
+
+// decodeResidual decodes the Rice coded residual after the warm-up samples of order.
+func decodeResidual(r *bitReader, samples []int32, order int) error {
+	// 9.2.7 Coded residual
+	paramBits, escape := 4, uint64(0xf)
+	switch r.read(2) {
+	case 0:
+	case 1:
+		paramBits, escape = 5, 0x1f
+	default:
+		return errors.New("flac: reserved residual coding method")
+	}
+	partitionOrder := int(r.read(4))
+	partitions := 1 << partitionOrder
+	if len(samples)%partitions != 0 || len(samples)/partitions < order {
+		return errors.New("flac: invalid partition order")
+	}
+	i := order
+	for p := range partitions {
+		end := (p + 1) * len(samples) / partitions
+		param := r.read(paramBits)
+		if param == escape {
+			bits := int(r.read(5))
+			for ; i < end; i++ {
+				if bits == 0 {
+					samples[i] = 0
+					continue
+				}
+				samples[i] = r.readSigned(bits)
+			}
+			continue
+		}
+		k := int(param)
+		for ; i < end; i++ {
+			q := r.readUnary()
+			v := q<<k | r.read(k)
+			samples[i] = int32(v>>1) ^ -int32(v&1)
+		}
+		if r.overrun {
+			return errors.New("flac: unexpected end of residual")
+		}
+	}
+	return nil
+}
+
+// restoreFixed adds the fixed prediction of order to the residual.
+func restoreFixed(s []int32, order int) {
+	switch order {
+	case 1:
+		for i := 1; i < len(s); i++ {
+			s[i] += s[i-1]
+		}
+	case 2:
+		for i := 2; i < len(s); i++ {
+			s[i] += 2*s[i-1] - s[i-2]
+		}
+	case 3:
+		for i := 3; i < len(s); i++ {
+			s[i] += 3*s[i-1] - 3*s[i-2] + s[i-3]
+		}
+	case 4:
+		for i := 4; i < len(s); i++ {
+			s[i] += 4*s[i-1] - 6*s[i-2] + 4*s[i-3] - s[i-4]
+		}
+	}
+}
+
+// restoreLPC adds the linear prediction of coefs to the residual.
+func restoreLPC(s []int32, coefs []int32, shift int) {
+	order := len(coefs)
+	for i := order; i < len(s); i++ {
+		var sum int64
+		for j, c := range coefs {
+			sum += int64(c) * int64(s[i-1-j])
+		}
+		s[i] += int32(sum >> shift)
+	}
+}
+
+// bitReader reads bits in MSB-first order.
+type bitReader struct {
+	data    []byte
+	pos     int
+	overrun bool
+}
+
+func (b *bitReader) read(n int) uint64 {
+	var v uint64
+	for n > 0 {
+		if b.pos/8 >= len(b.data) {
+			b.overrun = true
+			return 0
+		}
+		// Read the rest of the current byte at once.
+		avail := 8 - b.pos%8
+		k := min(avail, n)
+		bits := uint64(b.data[b.pos/8]>>(avail-k)) & (1<<k - 1)
+		v = v<<k | bits
+		b.pos += k
+		n -= k
+	}
+	return v
+}
+
+func (b *bitReader) readSigned(n int) int32 {
+	v := b.read(n)
+	return int32(int64(v<<(64-n)) >> (64 - n))
+}
+
+// readUnary reads the number of 0 bits before a 1 bit.
+func (b *bitReader) readUnary() uint64 {
+	var n uint64
+	for {
+		if b.pos/8 >= len(b.data) {
+			b.overrun = true
+			return 0
+		}
+		rest := b.data[b.pos/8] << (b.pos % 8)
+		if rest == 0 {
+			k := 8 - b.pos%8
+			n += uint64(k)
+			b.pos += k
+			continue
+		}
+		z := 0
+		for rest&0x80 == 0 {
+			rest <<= 1
+			z++
+		}
+		n += uint64(z)
+		b.pos += z + 1
+		return n
+	}
+}
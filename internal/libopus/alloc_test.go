@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libopus
+
+import (
+	"testing"
+)
+
+// testAllocs fails if decode allocates on the Go heap. decode decodes the i-th packet, as the player does for each
+// packet or batch of packets.
+func testAllocs(t *testing.T, n int, decode func(i int)) {
+	t.Helper()
+	var i int
+	if a := testing.AllocsPerRun(n, func() {
+		decode(i)
+		i++
+	}); a > 0 {
+		t.Errorf("allocations per packet: got %v, want 0", a)
+	}
+}
+
+func TestDecodeFloatAllocs(t *testing.T) {
+	for _, s := range []struct {
+		name     string
+		channels int
+	}{
+		{name: "music", channels: 2},
+		{name: "speech", channels: 1},
+	} {
+		t.Run(s.name, func(t *testing.T) {
+			packets := readPackets(t, s.name+".packets")
+			d, err := DecoderCreate(48000, s.channels)
+			if err != nil {
+				t.Fatal(err)
+			}
+			defer d.Destroy()
+
+			// 120 ms is the longest duration of an Opus packet.
+			pcm := make([]float32, 5760*s.channels)
+			testAllocs(t, len(packets), func(i int) {
+				if n := d.DecodeFloat(packets[i%len(packets)], pcm, 0); n < 0 {
+					t.Fatal(Error(n))
+				}
+			})
+			// The concealment of a lost packet.
+			testAllocs(t, 10, func(i int) {
+				if n := d.DecodeFloat(nil, pcm[:960*s.channels], 0); n < 0 {
+					t.Fatal(Error(n))
+				}
+			})
+		})
+	}
+}
+
+func TestDecodeFloatBatchAllocs(t *testing.T) {
+	const batch = 8
+	packets := readPackets(t, "music.packets")
+	pcm := make([]float32, batch*5760*2)
+
+	d, err := DecoderCreate(48000, 2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer d.Destroy()
+
+	// A stream of a single coupled stream is the same as the stereo stream.
+	ms, err := MSDecoderCreate(48000, 2, 1, 1, []byte{0, 1})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer ms.Destroy()
+
+	for _, dec := range []struct {
+		name   string
+		decode func(packets [][]byte, pcm []float32) []int
+	}{
+		{name: "single", decode: d.DecodeFloatBatch},
+		{name: "multistream", decode: ms.DecodeFloatBatch},
+	} {
+		t.Run(dec.name, func(t *testing.T) {
+			testAllocs(t, len(packets)/batch, func(i int) {
+				i %= len(packets) / batch
+				for _, n := range dec.decode(packets[i*batch:(i+1)*batch], pcm) {
+					if n < 0 {
+						t.Fatal(Error(n))
+					}
+				}
+			})
+		})
+	}
+}
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !opusscratch
+
+package libopus
+
+// #cgo CFLAGS: -DUSE_ALLOCA
+import "C"
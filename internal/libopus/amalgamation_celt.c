@@ -0,0 +1,20 @@
+// Code generated by cgen. DO NOT EDIT.
+
+//go:build !webmplayerprebuilt
+
+#include "celt_celt_decoder.inc"
+#include "celt_bands.inc"
+#include "celt_celt_lpc.inc"
+#include "celt_cwrs.inc"
+#include "celt_entcode.inc"
+#include "celt_entdec.inc"
+#include "celt_entenc.inc"
+#include "celt_kiss_fft.inc"
+#include "celt_laplace.inc"
+#include "celt_mathops.inc"
+#include "celt_mdct.inc"
+#include "celt_modes.inc"
+#include "celt_pitch.inc"
+#include "celt_quant_bands.inc"
+#include "celt_rate.inc"
+#include "celt_vq.inc"
@@ -0,0 +1,12 @@
+// Code generated by cgen. DO NOT EDIT.
+
+//go:build !webmplayerprebuilt
+
+#include "extensions.inc"
+#include "mapping_matrix.inc"
+#include "opus.inc"
+#include "opus_decoder.inc"
+#include "opus_multistream.inc"
+#include "opus_multistream_decoder.inc"
+#include "opus_projection_decoder.inc"
+#include "repacketizer.inc"
@@ -0,0 +1,47 @@
+// Code generated by cgen. DO NOT EDIT.
+
+//go:build !webmplayerprebuilt
+
+#include "silk_CNG.inc"
+#include "silk_LPC_analysis_filter.inc"
+#include "silk_LPC_fit.inc"
+#include "silk_LPC_inv_pred_gain.inc"
+#include "silk_NLSF_decode.inc"
+#include "silk_NLSF_stabilize.inc"
+#include "silk_NLSF_unpack.inc"
+#include "silk_PLC.inc"
+#include "silk_bwexpander.inc"
+#include "silk_bwexpander_32.inc"
+#include "silk_code_signs.inc"
+#include "silk_dec_API.inc"
+#include "silk_decode_core.inc"
+#include "silk_decode_frame.inc"
+#include "silk_decode_indices.inc"
+#include "silk_decode_parameters.inc"
+#include "silk_decode_pitch.inc"
+#include "silk_decode_pulses.inc"
+#include "silk_decoder_set_fs.inc"
+#include "silk_gain_quant.inc"
+#include "silk_init_decoder.inc"
+#include "silk_lin2log.inc"
+#include "silk_log2lin.inc"
+#include "silk_pitch_est_tables.inc"
+#include "silk_resampler.inc"
+#include "silk_resampler_private_AR2.inc"
+#include "silk_resampler_private_IIR_FIR.inc"
+#include "silk_resampler_private_down_FIR.inc"
+#include "silk_resampler_private_up2_HQ.inc"
+#include "silk_resampler_rom.inc"
+#include "silk_shell_coder.inc"
+#include "silk_sort.inc"
+#include "silk_stereo_MS_to_LR.inc"
+#include "silk_stereo_decode_pred.inc"
+#include "silk_sum_sqr_shift.inc"
+#include "silk_table_LSF_cos.inc"
+#include "silk_tables_LTP.inc"
+#include "silk_tables_NLSF_CB_NB_MB.inc"
+#include "silk_tables_NLSF_CB_WB.inc"
+#include "silk_tables_gain.inc"
+#include "silk_tables_other.inc"
+#include "silk_tables_pitch_lag.inc"
+#include "silk_tables_pulses_per_block.inc"
@@ -5,13 +5,112 @@
 
 package libopus
 
-// #cgo CFLAGS: -DOPUS_BUILD -DUSE_ALLOCA -DHAVE_LRINT -DHAVE_LRINTF
+// #cgo CFLAGS: -DOPUS_BUILD -DHAVE_LRINT -DHAVE_LRINTF
 //
+// #include <string.h>
 // #include "opus.h"
+// #include "opus_multistream.h"
+// #include "opus_projection.h"
+//
+// // opus_decoder_ctl is variadic and cannot be called from Go directly.
+// static int opus_decoder_reset_state(OpusDecoder* st) {
+//   return opus_decoder_ctl(st, OPUS_RESET_STATE);
+// }
+//
+// static int opus_multistream_decoder_reset_state(OpusMSDecoder* st) {
+//   return opus_multistream_decoder_ctl(st, OPUS_RESET_STATE);
+// }
+//
+// static int opus_projection_decoder_reset_state(OpusProjectionDecoder* st) {
+//   return opus_projection_decoder_ctl(st, OPUS_RESET_STATE);
+// }
+//
+// static int opus_decoder_set_gain(OpusDecoder* st, int gain) {
+//   return opus_decoder_ctl(st, OPUS_SET_GAIN(gain));
+// }
+//
+// static int opus_multistream_decoder_set_gain(OpusMSDecoder* st, int gain) {
+//   return opus_multistream_decoder_ctl(st, OPUS_SET_GAIN(gain));
+// }
+//
+// static int opus_projection_decoder_set_gain(OpusProjectionDecoder* st, int gain) {
+//   return opus_projection_decoder_ctl(st, OPUS_SET_GAIN(gain));
+// }
+//
+// // The functions called for each packet take the decoder as void*. cgo checks a pointer argument as an interface,
+// // and a pointer to an incomplete type, e.g. OpusDecoder*, is allocated on the heap to be an interface, while
+// // unsafe.Pointer is not.
+// #define DEFINE_DECODE_FLOAT(name, type, decode) \
+// static int name(void* st, const unsigned char* data, opus_int32 len, float* pcm, int frame_size, int decode_fec) { \
+//   return decode((type*)st, data, len, pcm, frame_size, decode_fec); \
+// }
+//
+// DEFINE_DECODE_FLOAT(opus_decode_float_p, OpusDecoder, opus_decode_float)
+// DEFINE_DECODE_FLOAT(opus_multistream_decode_float_p, OpusMSDecoder, opus_multistream_decode_float)
+// DEFINE_DECODE_FLOAT(opus_projection_decode_float_p, OpusProjectionDecoder, opus_projection_decode_float)
+//
+// // DEFINE_DECODE_FLOAT_BATCH defines a function to decode count packets in one call. The packets are concatenated
+// // in data, and lens has their sizes. The PCM of the packets is written to pcm one after another, and the number of
+// // the samples per channel or the error of each packet is written to out. The function stops at the first packet
+// // that doesn't fit in the rest of pcm, and returns the number of the processed packets.
+// #define DEFINE_DECODE_FLOAT_BATCH(name, type, decode) \
+// static int name(void* p, const unsigned char* data, const opus_int32* lens, int count, float* pcm, int frame_size, int channels, int* out) { \
+//   type* st = p; \
+//   int total = 0; \
+//   int i; \
+//   for (i = 0; i < count; i++) { \
+//     if (i > 0 && total >= frame_size) break; \
+//     int n = decode(st, data, lens[i], pcm + total*channels, frame_size - total, 0); \
+//     if (i > 0 && n == OPUS_BUFFER_TOO_SMALL) break; \
+//     out[i] = n; \
+//     data += lens[i]; \
+//     if (n > 0) total += n; \
+//   } \
+//   return i; \
+// }
+//
+// DEFINE_DECODE_FLOAT_BATCH(opus_decode_float_batch, OpusDecoder, opus_decode_float)
+// DEFINE_DECODE_FLOAT_BATCH(opus_multistream_decode_float_batch, OpusMSDecoder, opus_multistream_decode_float)
+// DEFINE_DECODE_FLOAT_BATCH(opus_projection_decode_float_batch, OpusProjectionDecoder, opus_projection_decode_float)
+//
+// // opus_map_stereo maps frames frames of interleaved channels channels to interleaved stereo in one pass.
+// // With matrix, all the channels are mixed, and matrix has the gains of the left and the right output for each
+// // input channel. Without matrix, mono is duplicated to both channels, and stereo is copied.
+// // dst can be the same as src: the frames are mixed forward, where a frame is written only after the frame is
+// // read, and mono is duplicated backward, where the output never overtakes the input.
+// static void opus_map_stereo(float* dst, const float* src, int channels, int frames, const float* matrix) {
+//   if (matrix) {
+//     for (int i = 0; i < frames; i++) {
+//       const float* s = src + i*channels;
+//       float l = 0;
+//       float r = 0;
+//       for (int c = 0; c < channels; c++) {
+//         l += s[c] * matrix[2*c];
+//         r += s[c] * matrix[2*c+1];
+//       }
+//       dst[2*i] = l;
+//       dst[2*i+1] = r;
+//     }
+//     return;
+//   }
+//   if (channels == 1) {
+//     for (int i = frames - 1; i >= 0; i--) {
+//       const float v = src[i];
+//       dst[2*i] = v;
+//       dst[2*i+1] = v;
+//     }
+//     return;
+//   }
+//   if (dst != src) {
+//     memmove(dst, src, 2 * frames * sizeof(float));
+//   }
+// }
 import "C"
 
 import (
 	"fmt"
+	"runtime"
+	"slices"
 	"unsafe"
 )
 
@@ -48,8 +147,41 @@ func (e Error) Error() string {
 	}
 }
 
+// packetBatch is the buffers to pass packets to the batch decoding functions.
+type packetBatch struct {
+	data   []byte
+	lens   []C.opus_int32
+	out    []C.int
+	counts []int
+}
+
+// prepare concatenates the packets.
+func (b *packetBatch) prepare(packets [][]byte) {
+	b.data = b.data[:0]
+	b.lens = b.lens[:0]
+	for _, p := range packets {
+		b.data = append(b.data, p...)
+		b.lens = append(b.lens, C.opus_int32(len(p)))
+	}
+	b.out = slices.Grow(b.out[:0], len(packets))[:len(packets)]
+}
+
+// result returns the counts of the first n packets.
+func (b *packetBatch) result(n int) []int {
+	b.counts = b.counts[:0]
+	for _, c := range b.out[:n] {
+		b.counts = append(b.counts, int(c))
+	}
+	return b.counts
+}
+
 type Decoder struct {
-	decoder *C.OpusDecoder
+	decoder  *C.OpusDecoder
+	channels int
+	batch    packetBatch
+
+	// pool is the DecoderPool the state is allocated from, or nil.
+	pool *DecoderPool
 }
 
 func DecoderCreate(Fs int, channels int) (*Decoder, error) {
@@ -58,18 +190,295 @@ func DecoderCreate(Fs int, channels int) (*Decoder, error) {
 	if err != C.OPUS_OK {
 		return nil, Error(err)
 	}
-	return &Decoder{
-		decoder: d,
-	}, nil
+	dec := &Decoder{
+		decoder:  d,
+		channels: channels,
+	}
+	runtime.SetFinalizer(dec, (*Decoder).Destroy)
+	return dec, nil
 }
 
+// DecodeFloat decodes data into the interleaved samples pcm, and returns the number of decoded samples per channel.
 func (d *Decoder) DecodeFloat(data []byte, pcm []float32, decodeFec int) int {
-	n := C.opus_decode_float(
-		d.decoder,
+	defer runtime.KeepAlive(d)
+	n := C.opus_decode_float_p(
+		unsafe.Pointer(d.decoder),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(data))),
+		C.opus_int32(len(data)),
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(len(pcm)/d.channels),
+		C.int(decodeFec))
+	return int(n)
+}
+
+// DecodeFloatBatch decodes the packets into the interleaved samples pcm one after another in one cgo call.
+// DecodeFloatBatch returns the number of decoded samples per channel, or the negative error, of each packet.
+// DecodeFloatBatch stops before a packet that doesn't fit in the rest of pcm, unless it is the first packet, so the
+// returned slice can be shorter than packets. The returned slice is valid until the next call.
+func (d *Decoder) DecodeFloatBatch(packets [][]byte, pcm []float32) []int {
+	defer runtime.KeepAlive(d)
+	if len(packets) == 0 {
+		return nil
+	}
+	d.batch.prepare(packets)
+	n := C.opus_decode_float_batch(
+		unsafe.Pointer(d.decoder),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(d.batch.data))),
+		(*C.opus_int32)(unsafe.Pointer(unsafe.SliceData(d.batch.lens))),
+		C.int(len(packets)),
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(len(pcm)/d.channels),
+		C.int(d.channels),
+		(*C.int)(unsafe.Pointer(unsafe.SliceData(d.batch.out))))
+	return d.batch.result(int(n))
+}
+
+// ResetState resets the decoder state as if the decoder were freshly created, without reallocating it.
+func (d *Decoder) ResetState() error {
+	defer runtime.KeepAlive(d)
+	if ret := C.opus_decoder_reset_state(d.decoder); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// SetGain sets the gain applied to the decoded output, in Q7.8 dB.
+func (d *Decoder) SetGain(gain int) error {
+	defer runtime.KeepAlive(d)
+	if ret := C.opus_decoder_set_gain(d.decoder, C.int(gain)); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// Destroy frees the decoder, or returns it to its DecoderPool. Destroy is called when d is finalized, and can be
+// called more than once.
+func (d *Decoder) Destroy() {
+	if d.decoder == nil {
+		return
+	}
+	if d.pool != nil {
+		d.pool.put(d.decoder)
+	} else {
+		C.opus_decoder_destroy(d.decoder)
+	}
+	d.decoder = nil
+	runtime.SetFinalizer(d, nil)
+}
+
+type MSDecoder struct {
+	decoder  *C.OpusMSDecoder
+	channels int
+	batch    packetBatch
+}
+
+// MSDecoderCreate creates a multistream decoder. mapping maps each output channel to a decoded channel.
+func MSDecoderCreate(Fs int, channels int, streams int, coupledStreams int, mapping []byte) (*MSDecoder, error) {
+	if len(mapping) != channels {
+		return nil, ErrBadArg
+	}
+	var err C.int
+	d := C.opus_multistream_decoder_create(C.opus_int32(Fs), C.int(channels), C.int(streams), C.int(coupledStreams), (*C.uchar)(unsafe.Pointer(unsafe.SliceData(mapping))), &err)
+	if err != C.OPUS_OK {
+		return nil, Error(err)
+	}
+	dec := &MSDecoder{
+		decoder:  d,
+		channels: channels,
+	}
+	runtime.SetFinalizer(dec, (*MSDecoder).Destroy)
+	return dec, nil
+}
+
+// DecodeFloat decodes data into the interleaved samples pcm, and returns the number of decoded samples per channel.
+func (d *MSDecoder) DecodeFloat(data []byte, pcm []float32, decodeFec int) int {
+	defer runtime.KeepAlive(d)
+	n := C.opus_multistream_decode_float_p(
+		unsafe.Pointer(d.decoder),
 		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(data))),
 		C.opus_int32(len(data)),
 		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
-		C.int(len(pcm)),
+		C.int(len(pcm)/d.channels),
 		C.int(decodeFec))
 	return int(n)
 }
+
+// DecodeFloatBatch decodes the packets into the interleaved samples pcm one after another in one cgo call.
+// DecodeFloatBatch returns the number of decoded samples per channel, or the negative error, of each packet.
+// DecodeFloatBatch stops before a packet that doesn't fit in the rest of pcm, unless it is the first packet, so the
+// returned slice can be shorter than packets. The returned slice is valid until the next call.
+func (d *MSDecoder) DecodeFloatBatch(packets [][]byte, pcm []float32) []int {
+	defer runtime.KeepAlive(d)
+	if len(packets) == 0 {
+		return nil
+	}
+	d.batch.prepare(packets)
+	n := C.opus_multistream_decode_float_batch(
+		unsafe.Pointer(d.decoder),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(d.batch.data))),
+		(*C.opus_int32)(unsafe.Pointer(unsafe.SliceData(d.batch.lens))),
+		C.int(len(packets)),
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(len(pcm)/d.channels),
+		C.int(d.channels),
+		(*C.int)(unsafe.Pointer(unsafe.SliceData(d.batch.out))))
+	return d.batch.result(int(n))
+}
+
+// ResetState resets the decoder state as if the decoder were freshly created, without reallocating it.
+func (d *MSDecoder) ResetState() error {
+	defer runtime.KeepAlive(d)
+	if ret := C.opus_multistream_decoder_reset_state(d.decoder); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// SetGain sets the gain applied to the decoded output, in Q7.8 dB.
+func (d *MSDecoder) SetGain(gain int) error {
+	defer runtime.KeepAlive(d)
+	if ret := C.opus_multistream_decoder_set_gain(d.decoder, C.int(gain)); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// Destroy frees the decoder. Destroy is called when d is finalized, and can be called more than once.
+func (d *MSDecoder) Destroy() {
+	if d.decoder == nil {
+		return
+	}
+	C.opus_multistream_decoder_destroy(d.decoder)
+	d.decoder = nil
+	runtime.SetFinalizer(d, nil)
+}
+
+type ProjectionDecoder struct {
+	decoder  *C.OpusProjectionDecoder
+	channels int
+	batch    packetBatch
+}
+
+// ProjectionDecoderCreate creates a projection decoder for ambisonics.
+// demixingMatrix is the matrix in the channel mapping table of the OpusHead with the mapping family 3.
+func ProjectionDecoderCreate(Fs int, channels int, streams int, coupledStreams int, demixingMatrix []byte) (*ProjectionDecoder, error) {
+	if len(demixingMatrix) == 0 {
+		return nil, ErrBadArg
+	}
+	var err C.int
+	d := C.opus_projection_decoder_create(C.opus_int32(Fs), C.int(channels), C.int(streams), C.int(coupledStreams), (*C.uchar)(unsafe.Pointer(unsafe.SliceData(demixingMatrix))), C.opus_int32(len(demixingMatrix)), &err)
+	if err != C.OPUS_OK {
+		return nil, Error(err)
+	}
+	dec := &ProjectionDecoder{
+		decoder:  d,
+		channels: channels,
+	}
+	runtime.SetFinalizer(dec, (*ProjectionDecoder).Destroy)
+	return dec, nil
+}
+
+// DecodeFloat decodes data into the interleaved samples pcm, and returns the number of decoded samples per channel.
+func (d *ProjectionDecoder) DecodeFloat(data []byte, pcm []float32, decodeFec int) int {
+	defer runtime.KeepAlive(d)
+	n := C.opus_projection_decode_float_p(
+		unsafe.Pointer(d.decoder),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(data))),
+		C.opus_int32(len(data)),
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(len(pcm)/d.channels),
+		C.int(decodeFec))
+	return int(n)
+}
+
+// DecodeFloatBatch decodes the packets into the interleaved samples pcm one after another in one cgo call.
+// DecodeFloatBatch returns the number of decoded samples per channel, or the negative error, of each packet.
+// DecodeFloatBatch stops before a packet that doesn't fit in the rest of pcm, unless it is the first packet, so the
+// returned slice can be shorter than packets. The returned slice is valid until the next call.
+func (d *ProjectionDecoder) DecodeFloatBatch(packets [][]byte, pcm []float32) []int {
+	defer runtime.KeepAlive(d)
+	if len(packets) == 0 {
+		return nil
+	}
+	d.batch.prepare(packets)
+	n := C.opus_projection_decode_float_batch(
+		unsafe.Pointer(d.decoder),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(d.batch.data))),
+		(*C.opus_int32)(unsafe.Pointer(unsafe.SliceData(d.batch.lens))),
+		C.int(len(packets)),
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(len(pcm)/d.channels),
+		C.int(d.channels),
+		(*C.int)(unsafe.Pointer(unsafe.SliceData(d.batch.out))))
+	return d.batch.result(int(n))
+}
+
+// ResetState resets the decoder state as if the decoder were freshly created, without reallocating it.
+func (d *ProjectionDecoder) ResetState() error {
+	defer runtime.KeepAlive(d)
+	if ret := C.opus_projection_decoder_reset_state(d.decoder); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// SetGain sets the gain applied to the decoded output, in Q7.8 dB.
+func (d *ProjectionDecoder) SetGain(gain int) error {
+	defer runtime.KeepAlive(d)
+	if ret := C.opus_projection_decoder_set_gain(d.decoder, C.int(gain)); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// Destroy frees the decoder. Destroy is called when d is finalized, and can be called more than once.
+func (d *ProjectionDecoder) Destroy() {
+	if d.decoder == nil {
+		return
+	}
+	C.opus_projection_decoder_destroy(d.decoder)
+	d.decoder = nil
+	runtime.SetFinalizer(d, nil)
+}
+
+// PacketUnpad removes the padding of the packet data in place with the repacketizer, and returns data without the
+// padding. streams is the number of the streams of a multistream packet, and 1 for a packet of a single stream.
+func PacketUnpad(data []byte, streams int) ([]byte, error) {
+	if len(data) == 0 {
+		return data, nil
+	}
+	p := (*C.uchar)(unsafe.Pointer(unsafe.SliceData(data)))
+	var n C.opus_int32
+	if streams > 1 {
+		n = C.opus_multistream_packet_unpad(p, C.opus_int32(len(data)), C.int(streams))
+	} else {
+		n = C.opus_packet_unpad(p, C.opus_int32(len(data)))
+	}
+	if n < 0 {
+		return nil, Error(n)
+	}
+	return data[:n], nil
+}
+
+// MapStereo maps the interleaved samples src of channels channels to the interleaved stereo samples dst.
+// If matrix is nil, mono is duplicated and stereo is copied. Otherwise, matrix has the gains of the left and the right
+// output for each input channel.
+// dst and src can start at the same position.
+// MapStereo returns the number of mapped frames.
+func MapStereo(dst []float32, src []float32, channels int, matrix []float32) int {
+	var cMatrix *C.float
+	if matrix != nil {
+		if len(matrix) != 2*channels {
+			panic("libopus: the matrix size doesn't match with the channel count")
+		}
+		cMatrix = (*C.float)(unsafe.Pointer(unsafe.SliceData(matrix)))
+	} else if channels != 1 && channels != 2 {
+		panic("libopus: a matrix is required for more than two channels")
+	}
+	n := min(len(dst)/2, len(src)/channels)
+	if n == 0 {
+		return 0
+	}
+	C.opus_map_stereo((*C.float)(unsafe.Pointer(unsafe.SliceData(dst))), (*C.float)(unsafe.Pointer(unsafe.SliceData(src))), C.int(channels), C.int(n), cMatrix)
+	return n
+}
@@ -1,3 +1,5 @@
+//go:build !webmplayerprebuilt
+
 /* Copyright (c) 2007-2008 CSIRO
    Copyright (c) 2007-2010 Xiph.Org Foundation
    Copyright (c) 2008 Gregory Maxwell
@@ -38,6 +40,7 @@
 #include <math.h>
 #include "celt_celt.h"
 #include "celt_pitch.h"
+#include "celt_simd.h"
 #include "celt_bands.h"
 #include "celt_modes.h"
 #include "celt_entcode.h"
@@ -252,7 +255,11 @@ void comb_filter(opus_val32 *y, opus_val32 *x, int T0, int T1, int N,
    }
 
    /* Compute the part with the constant filter. */
+#ifdef CELT_SIMD
+   comb_filter_const_simd(y+i, x+i, T1, N-i, g10, g11, g12);
+#else
    comb_filter_const(y+i, x+i, T1, N-i, g10, g11, g12, arch);
+#endif
 }
 #endif /* OVERRIDE_comb_filter */
 
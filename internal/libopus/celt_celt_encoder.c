@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /* Copyright (c) 2007-2008 CSIRO
    Copyright (c) 2007-2010 Xiph.Org Foundation
    Copyright (c) 2008 Gregory Maxwell
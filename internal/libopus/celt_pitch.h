@@ -199,5 +199,8 @@ void comb_filter_const_c(opus_val32 *y, opus_val32 *x, int T, int N,
     ((void)(arch),comb_filter_const_c(y, x, T, N, g10, g11, g12))
 #endif
 
+/* The float build uses the vectorized pitch correlation of celt_pitch_simd.h. */
+#include "celt_pitch_simd.h"
+
 
 #endif
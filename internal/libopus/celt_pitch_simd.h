@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libopus. This defines the vectorized pitch correlation kernels of CELT used from the
+// patched pitch.h, in place of the x86 and ARM sources of libopus and their OPUS_HAVE_RTCD tables, which are not
+// vendored. celt_pitch_xcorr is used by the concealment of the decoder, and by the prefilter and the pitch analysis
+// of the encoders. xcorr_kernel is also used by celt_fir and celt_iir.
+//
+// Each lane accumulates one lag in the same order as xcorr_kernel_c, so the output is the same as the C code.
+// The kernels use the vector extensions of celt_simd.h for 4 lags at once. On x86, celt_pitch_xcorr computes 8 lags
+// at once with AVX if the CPU supports it. The AVX kernel is compiled with the target attribute and selected at
+// runtime with __builtin_cpu_supports, unless the build targets AVX anyway, e.g. with GOAMD64=v3. The selection has
+// no state, so it is safe from any thread. On arm64, celt_pitch_xcorr computes 8 lags at once with two NEON
+// registers, which every arm64 CPU has, so the kernel is selected at compile time. Its multiply-adds are fused as the
+// compiler fuses the C code on arm64.
+
+#ifndef CELT_PITCH_SIMD_H
+#define CELT_PITCH_SIMD_H
+
+#include "celt_simd.h"
+
+#ifdef CELT_SIMD
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CELT_PITCH_AVX
+#elif defined(__aarch64__)
+#define CELT_PITCH_NEON
+#include <arm_neon.h>
+#endif
+
+/* The same as xcorr_kernel_c. */
+static OPUS_INLINE void xcorr_kernel_simd(const opus_val16 *x, const opus_val16 *y, opus_val32 sum[4], int len)
+{
+   int j;
+   celt_v4sf s = celt_load4(sum);
+   for (j=0;j<len;j++)
+      s += x[j]*celt_load4(y+j);
+   celt_store4(sum, s);
+}
+
+#ifdef CELT_PITCH_AVX
+
+typedef float celt_v8sf __attribute__((vector_size(32)));
+typedef float celt_v8sf_u __attribute__((vector_size(32), aligned(4)));
+
+#define CELT_PITCH_AVX_TARGET __attribute__((target("avx")))
+
+static OPUS_INLINE int celt_pitch_avx_available(void)
+{
+#ifdef __AVX__
+   return 1;
+#else
+   return __builtin_cpu_supports("avx");
+#endif
+}
+
+/* Computes the lags of celt_pitch_xcorr 8 at once, and returns the number of the lags computed. */
+CELT_PITCH_AVX_TARGET static OPUS_INLINE int celt_pitch_xcorr_avx(const opus_val16 *x, const opus_val16 *y,
+      opus_val32 *xcorr, int len, int max_pitch)
+{
+   int i, j;
+   for (i=0;i+8<=max_pitch;i+=8)
+   {
+      celt_v8sf s = {0};
+      for (j=0;j<len;j++)
+         s += x[j]*(*(const celt_v8sf_u *)(y+i+j));
+      *(celt_v8sf_u *)(xcorr+i) = s;
+   }
+   return i;
+}
+
+#endif /* CELT_PITCH_AVX */
+
+#ifdef CELT_PITCH_NEON
+
+/* Computes the lags of celt_pitch_xcorr 8 at once, and returns the number of the lags computed. */
+static OPUS_INLINE int celt_pitch_xcorr_neon(const opus_val16 *x, const opus_val16 *y, opus_val32 *xcorr, int len,
+      int max_pitch)
+{
+   int i, j;
+   for (i=0;i+8<=max_pitch;i+=8)
+   {
+      float32x4_t s0 = vdupq_n_f32(0);
+      float32x4_t s1 = vdupq_n_f32(0);
+      for (j=0;j<len;j++)
+      {
+         s0 = vfmaq_n_f32(s0, vld1q_f32(y+i+j), x[j]);
+         s1 = vfmaq_n_f32(s1, vld1q_f32(y+i+j+4), x[j]);
+      }
+      vst1q_f32(xcorr+i, s0);
+      vst1q_f32(xcorr+i+4, s1);
+   }
+   return i;
+}
+
+#endif /* CELT_PITCH_NEON */
+
+/* The same as celt_pitch_xcorr_c of the float build. */
+static OPUS_INLINE void celt_pitch_xcorr_simd(const opus_val16 *x, const opus_val16 *y, opus_val32 *xcorr, int len,
+      int max_pitch)
+{
+   int i = 0;
+   celt_assert(max_pitch>0);
+#if defined(CELT_PITCH_AVX)
+   if (celt_pitch_avx_available())
+      i = celt_pitch_xcorr_avx(x, y, xcorr, len, max_pitch);
+#elif defined(CELT_PITCH_NEON)
+   i = celt_pitch_xcorr_neon(x, y, xcorr, len, max_pitch);
+#endif
+   for (;i<max_pitch-3;i+=4)
+   {
+      opus_val32 sum[4]={0,0,0,0};
+      xcorr_kernel_simd(x, y+i, sum, len);
+      xcorr[i]=sum[0];
+      xcorr[i+1]=sum[1];
+      xcorr[i+2]=sum[2];
+      xcorr[i+3]=sum[3];
+   }
+   for (;i<max_pitch;i++)
+      xcorr[i] = celt_inner_prod_c(x, y+i, len);
+}
+
+#undef xcorr_kernel
+#define xcorr_kernel(x, y, sum, len, arch) \
+    ((void)(arch),xcorr_kernel_simd(x, y, sum, len))
+
+#undef celt_pitch_xcorr
+#define celt_pitch_xcorr(x, y, xcorr, len, max_pitch, arch) \
+    ((void)(arch),celt_pitch_xcorr_simd(x, y, xcorr, len, max_pitch))
+
+#endif /* CELT_SIMD */
+
+#endif /* CELT_PITCH_SIMD_H */
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libopus. This defines the vectorized kernels of the CELT decoder used from the patched
+// libopus sources.
+//
+// The kernels use the GCC/Clang vector extensions, which are lowered to SSE2 on amd64 and to NEON on arm64.
+// Both are available on every CPU of the architectures, so no runtime detection is needed. The kernels are only for
+// the float build. Otherwise, the patched sources use the original loops.
+//
+// Each lane computes the same expression in the same order as the original loop, so the output is the same.
+
+#ifndef CELT_SIMD_H
+#define CELT_SIMD_H
+
+#include "celt_arch.h"
+#include "celt_kiss_fft.h"
+
+#if !defined(FIXED_POINT) && (defined(__GNUC__) || defined(__clang__)) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define CELT_SIMD
+#endif
+
+#ifdef CELT_SIMD
+
+typedef float celt_v4sf __attribute__((vector_size(16)));
+typedef int celt_v4si __attribute__((vector_size(16)));
+typedef float celt_v4sf_u __attribute__((vector_size(16), aligned(4)));
+typedef int celt_v4si_u __attribute__((vector_size(16), aligned(4)));
+
+static OPUS_INLINE celt_v4sf celt_load4(const float *p)
+{
+   return *(const celt_v4sf_u *)p;
+}
+
+static OPUS_INLINE void celt_store4(float *p, celt_v4sf v)
+{
+   *(celt_v4sf_u *)p = v;
+}
+
+/* The same as comb_filter_const_c. y can be the same as x, as the filter reads x at least T >= COMBFILTER_MINPERIOD
+   samples back, which are written before. */
+static OPUS_INLINE void comb_filter_const_simd(opus_val32 *y, opus_val32 *x, int T, int N,
+      opus_val16 g10, opus_val16 g11, opus_val16 g12)
+{
+   int i = 0;
+   for (;i+4<=N;i+=4)
+   {
+      celt_v4sf x0 = celt_load4(x+i-T+2);
+      celt_v4sf x1 = celt_load4(x+i-T+1);
+      celt_v4sf x2 = celt_load4(x+i-T);
+      celt_v4sf x3 = celt_load4(x+i-T-1);
+      celt_v4sf x4 = celt_load4(x+i-T-2);
+      celt_store4(y+i, celt_load4(x+i) + g10*x2 + g11*(x1+x3) + g12*(x0+x4));
+   }
+   for (;i<N;i++)
+      y[i] = x[i] + g10*x[i-T] + g11*(x[i-T+1]+x[i-T-1]) + g12*(x[i-T+2]+x[i-T-2]);
+}
+
+/* f[i] = x[i]*g, for denormalise_bands. */
+static OPUS_INLINE void celt_scale_band(celt_sig * OPUS_RESTRICT f, const celt_norm * OPUS_RESTRICT x, opus_val16 g,
+      int n)
+{
+   int i = 0;
+   for (;i+4<=n;i+=4)
+      celt_store4(f+i, celt_load4(x+i) * g);
+   for (;i<n;i++)
+      f[i] = x[i]*g;
+}
+
+/* X[i] = g*iy[i], for normalise_residual. */
+static OPUS_INLINE void celt_scale_pulses(celt_norm * OPUS_RESTRICT X, const int * OPUS_RESTRICT iy, opus_val16 g,
+      int N)
+{
+   int i = 0;
+   for (;i+4<=N;i+=4)
+      celt_store4(X+i, g * __builtin_convertvector(*(const celt_v4si_u *)(iy+i), celt_v4sf));
+   for (;i<N;i++)
+      X[i] = g*iy[i];
+}
+
+#if defined(__clang__)
+#define celt_shuffle4(a, b, i0, i1, i2, i3) __builtin_shufflevector(a, b, i0, i1, i2, i3)
+#else
+#define celt_shuffle4(a, b, i0, i1, i2, i3) __builtin_shuffle(a, b, (celt_v4si){ i0, i1, i2, i3 })
+#endif
+
+/* 4 consecutive complex values with the real and the imaginary parts in separate vectors. */
+typedef struct {
+   celt_v4sf r;
+   celt_v4sf i;
+} celt_v4cpx;
+
+static OPUS_INLINE celt_v4cpx celt_load4cpx(const kiss_fft_cpx *p)
+{
+   celt_v4cpx c;
+   celt_v4sf a = celt_load4(&p[0].r);
+   celt_v4sf b = celt_load4(&p[2].r);
+   c.r = celt_shuffle4(a, b, 0, 2, 4, 6);
+   c.i = celt_shuffle4(a, b, 1, 3, 5, 7);
+   return c;
+}
+
+static OPUS_INLINE void celt_store4cpx(kiss_fft_cpx *p, celt_v4cpx c)
+{
+   celt_store4(&p[0].r, celt_shuffle4(c.r, c.i, 0, 4, 1, 5));
+   celt_store4(&p[2].r, celt_shuffle4(c.r, c.i, 2, 6, 3, 7));
+}
+
+/* C_MUL of each lane with the twiddles tw[0] and tw[1], the real and the imaginary parts. */
+static OPUS_INLINE celt_v4cpx celt_cmul4(celt_v4cpx a, const celt_v4sf *tw)
+{
+   celt_v4cpx m;
+   m.r = a.r*tw[0] - a.i*tw[1];
+   m.i = a.r*tw[1] + a.i*tw[0];
+   return m;
+}
+
+/* The twiddles of the butterflies of radix p and m for kf_bfly*_simd, laid out for the vector loads. For each 4
+   consecutive j, there are the real and the imaginary parts of st->twiddles[k*j*fstride] for k from 1 to p-1. dst
+   has (p-1)*m/2 vectors. */
+static OPUS_INLINE void kf_twiddles_simd(celt_v4sf *dst, const kiss_twiddle_cpx *tw, int fstride, int m, int p)
+{
+   int j, k, l;
+   for (j=0;j<m;j+=4)
+   {
+      for (k=1;k<p;k++)
+      {
+         for (l=0;l<4;l++)
+         {
+            dst[0][l] = tw[k*(j+l)*fstride].r;
+            dst[1][l] = tw[k*(j+l)*fstride].i;
+         }
+         dst += 2;
+      }
+   }
+}
+
+/* The same as kf_bfly4 with m > 1, for 4 j at once. m must be a multiple of 4, and tw is of kf_twiddles_simd. */
+static OPUS_INLINE void kf_bfly4_simd(kiss_fft_cpx *Fout, int m, int N, int mm, const celt_v4sf *tw)
+{
+   int i, j;
+   for (i=0;i<N;i++)
+   {
+      kiss_fft_cpx *F = Fout + i*mm;
+      const celt_v4sf *t = tw;
+      for (j=0;j<m;j+=4,t+=6)
+      {
+         celt_v4cpx f0, f1, f2, f3, s0, s1, s2, s3, s4, s5;
+         f0 = celt_load4cpx(F+j);
+         s0 = celt_cmul4(celt_load4cpx(F+j+m), t);
+         s1 = celt_cmul4(celt_load4cpx(F+j+2*m), t+2);
+         s2 = celt_cmul4(celt_load4cpx(F+j+3*m), t+4);
+         s5.r = f0.r - s1.r;
+         s5.i = f0.i - s1.i;
+         f0.r += s1.r;
+         f0.i += s1.i;
+         s3.r = s0.r + s2.r;
+         s3.i = s0.i + s2.i;
+         s4.r = s0.r - s2.r;
+         s4.i = s0.i - s2.i;
+         f2.r = f0.r - s3.r;
+         f2.i = f0.i - s3.i;
+         f0.r += s3.r;
+         f0.i += s3.i;
+         f1.r = s5.r + s4.i;
+         f1.i = s5.i - s4.r;
+         f3.r = s5.r - s4.i;
+         f3.i = s5.i + s4.r;
+         celt_store4cpx(F+j, f0);
+         celt_store4cpx(F+j+m, f1);
+         celt_store4cpx(F+j+2*m, f2);
+         celt_store4cpx(F+j+3*m, f3);
+      }
+   }
+}
+
+/* The same as kf_bfly3 for 4 j at once. m must be a multiple of 4, and tw is of kf_twiddles_simd. */
+static OPUS_INLINE void kf_bfly3_simd(kiss_fft_cpx *Fout, int m, int N, int mm, const celt_v4sf *tw,
+      kiss_twiddle_cpx epi3)
+{
+   int i, j;
+   for (i=0;i<N;i++)
+   {
+      kiss_fft_cpx *F = Fout + i*mm;
+      const celt_v4sf *t = tw;
+      for (j=0;j<m;j+=4,t+=4)
+      {
+         celt_v4cpx f0, f1, f2, s0, s1, s2, s3;
+         f0 = celt_load4cpx(F+j);
+         s1 = celt_cmul4(celt_load4cpx(F+j+m), t);
+         s2 = celt_cmul4(celt_load4cpx(F+j+2*m), t+2);
+         s3.r = s1.r + s2.r;
+         s3.i = s1.i + s2.i;
+         s0.r = s1.r - s2.r;
+         s0.i = s1.i - s2.i;
+         f1.r = f0.r - s3.r*.5f;
+         f1.i = f0.i - s3.i*.5f;
+         s0.r *= epi3.i;
+         s0.i *= epi3.i;
+         f0.r += s3.r;
+         f0.i += s3.i;
+         f2.r = f1.r + s0.i;
+         f2.i = f1.i - s0.r;
+         f1.r -= s0.i;
+         f1.i += s0.r;
+         celt_store4cpx(F+j, f0);
+         celt_store4cpx(F+j+m, f1);
+         celt_store4cpx(F+j+2*m, f2);
+      }
+   }
+}
+
+/* The same as kf_bfly5 for 4 u at once. m must be a multiple of 4, and tw is of kf_twiddles_simd. */
+static OPUS_INLINE void kf_bfly5_simd(kiss_fft_cpx *Fout, int m, int N, int mm, const celt_v4sf *tw,
+      kiss_twiddle_cpx ya, kiss_twiddle_cpx yb)
+{
+   int i, u;
+   for (i=0;i<N;i++)
+   {
+      kiss_fft_cpx *F = Fout + i*mm;
+      const celt_v4sf *t = tw;
+      for (u=0;u<m;u+=4,t+=8)
+      {
+         celt_v4cpx s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12, f;
+         s0 = celt_load4cpx(F+u);
+         s1 = celt_cmul4(celt_load4cpx(F+u+m), t);
+         s2 = celt_cmul4(celt_load4cpx(F+u+2*m), t+2);
+         s3 = celt_cmul4(celt_load4cpx(F+u+3*m), t+4);
+         s4 = celt_cmul4(celt_load4cpx(F+u+4*m), t+6);
+
+         s7.r = s1.r + s4.r;
+         s7.i = s1.i + s4.i;
+         s10.r = s1.r - s4.r;
+         s10.i = s1.i - s4.i;
+         s8.r = s2.r + s3.r;
+         s8.i = s2.i + s3.i;
+         s9.r = s2.r - s3.r;
+         s9.i = s2.i - s3.i;
+
+         f.r = s0.r + (s7.r + s8.r);
+         f.i = s0.i + (s7.i + s8.i);
+         celt_store4cpx(F+u, f);
+
+         s5.r = s0.r + (s7.r*ya.r + s8.r*yb.r);
+         s5.i = s0.i + (s7.i*ya.r + s8.i*yb.r);
+         s6.r = s10.i*ya.i + s9.i*yb.i;
+         s6.i = -(s10.r*ya.i + s9.r*yb.i);
+         f.r = s5.r - s6.r;
+         f.i = s5.i - s6.i;
+         celt_store4cpx(F+u+m, f);
+         f.r = s5.r + s6.r;
+         f.i = s5.i + s6.i;
+         celt_store4cpx(F+u+4*m, f);
+
+         s11.r = s0.r + (s7.r*yb.r + s8.r*ya.r);
+         s11.i = s0.i + (s7.i*yb.r + s8.i*ya.r);
+         s12.r = s9.i*ya.i - s10.i*yb.i;
+         s12.i = s10.r*yb.i - s9.r*ya.i;
+         f.r = s11.r + s12.r;
+         f.i = s11.i + s12.i;
+         celt_store4cpx(F+u+2*m, f);
+         f.r = s11.r - s12.r;
+         f.i = s11.i - s12.i;
+         celt_store4cpx(F+u+3*m, f);
+      }
+   }
+}
+
+#endif /* CELT_SIMD */
+
+#endif /* CELT_SIMD_H */
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libopus. This defines the macros of the specialized paths of the CELT decoder used from
+// the patched libopus sources.
+//
+// Almost all Opus streams are of the static mode of 48 kHz with 960-sample frames. The IMDCT and the FFT of the mode's
+// sizes are specialized with the sizes as constants, so that the compiler can unroll and vectorize the loops and the
+// butterflies. The other sizes, e.g. of custom modes, take the generic path. The specialized paths are the same code
+// as the generic path, so the output is the same.
+
+#ifndef CELT_SPECIALIZE_H
+#define CELT_SPECIALIZE_H
+
+#if !defined(CUSTOM_MODES_ONLY) && !defined(RADIX_TWO_ONLY) && (defined(__GNUC__) || defined(__clang__))
+#define CELT_SPECIALIZE
+#define CELT_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+#endif /* CELT_SPECIALIZE_H */
@@ -115,12 +115,13 @@
 
 #else
 
+/* The pseudostack is per thread, so that the decoders can run on multiple threads. */
 #ifdef CELT_C
-char *scratch_ptr=0;
-char *global_stack=0;
+__thread char *scratch_ptr=0;
+__thread char *global_stack=0;
 #else
-extern char *global_stack;
-extern char *scratch_ptr;
+extern __thread char *global_stack;
+extern __thread char *scratch_ptr;
 #endif /* CELT_C */
 
 #ifdef ENABLE_VALGRIND
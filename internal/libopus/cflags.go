@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libopus
+
+// The C sources are built with -O3 on every architecture. The flags here follow CGO_CFLAGS, so they override its -O2.
+// The target of the C compiler follows the microarchitecture level of the Go build, e.g. GOAMD64=v3 or GOARM64=v8.2,
+// with the files cflags_*_GOARCH.go.
+
+// #cgo CFLAGS: -O3
+import "C"
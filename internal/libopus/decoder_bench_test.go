@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libopus
+
+import (
+	"encoding/binary"
+	"os"
+	"path/filepath"
+	"runtime"
+	"testing"
+)
+
+// readPackets reads the packets of a file in testdata. The files are the packets of the streams encoded by libopus,
+// each preceded by its size as a 16-bit big-endian integer:
+//
+//   - music.packets: 2 seconds of stereo music in the CELT mode at 128 kbit/s.
+//   - speech.packets: 2 seconds of mono speech in the SILK mode at 20 kbit/s.
+func readPackets(tb testing.TB, name string) [][]byte {
+	tb.Helper()
+	b, err := os.ReadFile(filepath.Join("testdata", name))
+	if err != nil {
+		tb.Fatal(err)
+	}
+	var packets [][]byte
+	for len(b) > 0 {
+		if len(b) < 2 || len(b) < 2+int(binary.BigEndian.Uint16(b)) {
+			tb.Fatalf("%s is truncated", name)
+		}
+		n := int(binary.BigEndian.Uint16(b))
+		packets = append(packets, b[2:2+n:2+n])
+		b = b[2+n:]
+	}
+	return packets
+}
+
+// measurePackets calls decode for b.N packets, and reports the decoded samples per channel per second, the time and
+// the allocations per packet. decode decodes the i-th packet, and returns the number of decoded samples per channel.
+func measurePackets(b *testing.B, decode func(i int) int) {
+	var m0, m1 runtime.MemStats
+	runtime.ReadMemStats(&m0)
+	var samples int
+	b.ResetTimer()
+	for i := range b.N {
+		samples += decode(i)
+	}
+	b.StopTimer()
+	runtime.ReadMemStats(&m1)
+
+	b.ReportMetric(float64(samples)/b.Elapsed().Seconds(), "samples/s")
+	b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N), "ns/packet")
+	b.ReportMetric(float64(m1.Mallocs-m0.Mallocs)/float64(b.N), "allocs/packet")
+}
+
+func BenchmarkDecodeFloat(b *testing.B) {
+	for _, s := range []struct {
+		name     string
+		channels int
+	}{
+		{name: "music", channels: 2},
+		{name: "speech", channels: 1},
+	} {
+		b.Run(s.name, func(b *testing.B) {
+			packets := readPackets(b, s.name+".packets")
+			d, err := DecoderCreate(48000, s.channels)
+			if err != nil {
+				b.Fatal(err)
+			}
+			defer d.Destroy()
+
+			// 120 ms is the longest duration of an Opus packet.
+			pcm := make([]float32, 5760*s.channels)
+			measurePackets(b, func(i int) int {
+				n := d.DecodeFloat(packets[i%len(packets)], pcm, 0)
+				if n < 0 {
+					b.Fatal(Error(n))
+				}
+				return n
+			})
+		})
+	}
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libopus
+
+// #include <stdlib.h>
+// #include "opus.h"
+import "C"
+
+import (
+	"runtime"
+	"sync"
+	"unsafe"
+)
+
+const (
+	// decoderAlign is the alignment of the decoder states in a DecoderPool, which is the cache line size.
+	decoderAlign = 64
+
+	// minDecoderSlab and maxDecoderSlab are the numbers of the decoder states in a slab. A DecoderPool doubles its
+	// states with a new slab up to maxDecoderSlab at a time.
+	minDecoderSlab = 4
+	maxDecoderSlab = 64
+)
+
+// DecoderPool allocates the Decoders of a sampling rate and a channel count from slabs, each of which is one
+// allocation of the states of many decoders, instead of allocating each state separately. The states are aligned to
+// the cache lines.
+//
+// Destroy of a Decoder from a DecoderPool returns its state to the pool, and the next Get initializes the state again.
+// The slabs are freed when the pool and all its decoders are unreachable.
+//
+// A DecoderPool is safe for concurrent use.
+type DecoderPool struct {
+	fs       int
+	channels int
+
+	// size is the size of a decoder state, rounded up to decoderAlign.
+	size uintptr
+
+	m     sync.Mutex
+	slabs []unsafe.Pointer
+	idle  []*C.OpusDecoder
+	count int
+}
+
+// NewDecoderPool creates a DecoderPool of the decoders of Fs and channels, as DecoderCreate takes.
+func NewDecoderPool(Fs int, channels int) (*DecoderPool, error) {
+	switch Fs {
+	case 8000, 12000, 16000, 24000, 48000:
+	default:
+		return nil, ErrBadArg
+	}
+	// opus_decoder_get_size returns 0 for an invalid channel count.
+	size := C.opus_decoder_get_size(C.int(channels))
+	if size <= 0 {
+		return nil, ErrBadArg
+	}
+	p := &DecoderPool{
+		fs:       Fs,
+		channels: channels,
+		size:     (uintptr(size) + decoderAlign - 1) &^ (decoderAlign - 1),
+	}
+	runtime.SetFinalizer(p, (*DecoderPool).release)
+	return p, nil
+}
+
+// Get returns a decoder in the state of a freshly created one.
+func (p *DecoderPool) Get() (*Decoder, error) {
+	st, err := p.take()
+	if err != nil {
+		return nil, err
+	}
+	if ret := C.opus_decoder_init(st, C.opus_int32(p.fs), C.int(p.channels)); ret != C.OPUS_OK {
+		p.put(st)
+		return nil, Error(ret)
+	}
+	d := &Decoder{
+		decoder:  st,
+		channels: p.channels,
+		pool:     p,
+	}
+	runtime.SetFinalizer(d, (*Decoder).Destroy)
+	return d, nil
+}
+
+func (p *DecoderPool) take() (*C.OpusDecoder, error) {
+	p.m.Lock()
+	defer p.m.Unlock()
+	if len(p.idle) == 0 {
+		n := min(max(p.count, minDecoderSlab), maxDecoderSlab)
+		// malloc aligns only to the size of the largest scalar.
+		slab := C.malloc(C.size_t(uintptr(n)*p.size + decoderAlign - 1))
+		if slab == nil {
+			return nil, ErrAllocFail
+		}
+		p.slabs = append(p.slabs, slab)
+		base := unsafe.Add(slab, (decoderAlign-uintptr(slab)%decoderAlign)%decoderAlign)
+		// The states are taken from the start of the slab.
+		for i := n - 1; i >= 0; i-- {
+			p.idle = append(p.idle, (*C.OpusDecoder)(unsafe.Add(base, uintptr(i)*p.size)))
+		}
+		p.count += n
+	}
+	st := p.idle[len(p.idle)-1]
+	p.idle = p.idle[:len(p.idle)-1]
+	return st, nil
+}
+
+func (p *DecoderPool) put(st *C.OpusDecoder) {
+	p.m.Lock()
+	defer p.m.Unlock()
+	p.idle = append(p.idle, st)
+}
+
+// release frees the slabs. release is called when p is finalized, after all the decoders of p are finalized, as they
+// refer to p.
+func (p *DecoderPool) release() {
+	for _, s := range p.slabs {
+		C.free(s)
+	}
+	p.slabs = nil
+	p.idle = nil
+}
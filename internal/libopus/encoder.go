@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder
+
+package libopus
+
+// #include "opus.h"
+//
+// // opus_encoder_ctl is variadic and cannot be called from Go directly.
+// static int opus_encoder_set_bitrate(OpusEncoder* st, int bitrate) {
+//   return opus_encoder_ctl(st, OPUS_SET_BITRATE(bitrate));
+// }
+//
+// static int opus_encoder_set_complexity(OpusEncoder* st, int complexity) {
+//   return opus_encoder_ctl(st, OPUS_SET_COMPLEXITY(complexity));
+// }
+//
+// static int opus_encoder_get_lookahead(OpusEncoder* st, int* lookahead) {
+//   return opus_encoder_ctl(st, OPUS_GET_LOOKAHEAD(lookahead));
+// }
+//
+// // opus_encode_float_batch encodes count frames of frame_size samples per channel in one call. The frames are read
+// // from pcm one after another, and the packet of the i-th frame is written to data at i*max_packet. The size of each
+// // packet is written to lens. The function stops at the first error, which is written to lens, and returns the
+// // number of the processed frames.
+// static int opus_encode_float_batch(OpusEncoder* st, const float* pcm, int frame_size, int channels, int count, unsigned char* data, int max_packet, int* lens) {
+//   int i;
+//   for (i = 0; i < count; i++) {
+//     int n = opus_encode_float(st, pcm + i*frame_size*channels, frame_size, data + i*max_packet, max_packet);
+//     lens[i] = n;
+//     if (n < 0) return i + 1;
+//   }
+//   return i;
+// }
+import "C"
+
+import (
+	"runtime"
+	"slices"
+	"unsafe"
+)
+
+type Application C.int
+
+const (
+	ApplicationVoIP               Application = C.OPUS_APPLICATION_VOIP
+	ApplicationAudio              Application = C.OPUS_APPLICATION_AUDIO
+	ApplicationRestrictedLowdelay Application = C.OPUS_APPLICATION_RESTRICTED_LOWDELAY
+)
+
+type Encoder struct {
+	encoder  *C.OpusEncoder
+	channels int
+
+	lens   []C.int
+	counts []int
+}
+
+func EncoderCreate(Fs int, channels int, application Application) (*Encoder, error) {
+	var err C.int
+	e := C.opus_encoder_create(C.opus_int32(Fs), C.int(channels), C.int(application), &err)
+	if err != C.OPUS_OK {
+		return nil, Error(err)
+	}
+	enc := &Encoder{
+		encoder:  e,
+		channels: channels,
+	}
+	runtime.SetFinalizer(enc, (*Encoder).Destroy)
+	return enc, nil
+}
+
+// EncodeFloat encodes a frame of the interleaved samples pcm into data, and returns the size of the packet or the
+// negative error.
+func (e *Encoder) EncodeFloat(pcm []float32, data []byte) int {
+	defer runtime.KeepAlive(e)
+	n := C.opus_encode_float(
+		e.encoder,
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(len(pcm)/e.channels),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(data))),
+		C.opus_int32(len(data)))
+	return int(n)
+}
+
+// EncodeFloatBatch encodes the frames of frameSize samples per channel in the interleaved samples pcm one after another
+// in one cgo call. The packet of the i-th frame is written to data at i*maxPacket. EncodeFloatBatch returns the size of
+// each packet. At an error, the negative error is the last element of the returned slice. The returned slice is valid
+// until the next call.
+func (e *Encoder) EncodeFloatBatch(pcm []float32, frameSize int, data []byte, maxPacket int) []int {
+	defer runtime.KeepAlive(e)
+	count := min(len(pcm)/(frameSize*e.channels), len(data)/maxPacket)
+	if count == 0 {
+		return nil
+	}
+	e.lens = slices.Grow(e.lens[:0], count)[:count]
+	n := C.opus_encode_float_batch(
+		e.encoder,
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))),
+		C.int(frameSize),
+		C.int(e.channels),
+		C.int(count),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(data))),
+		C.int(maxPacket),
+		(*C.int)(unsafe.Pointer(unsafe.SliceData(e.lens))))
+	e.counts = e.counts[:0]
+	for _, l := range e.lens[:n] {
+		e.counts = append(e.counts, int(l))
+	}
+	return e.counts
+}
+
+// SetBitrate sets the bitrate in bits per second.
+func (e *Encoder) SetBitrate(bitrate int) error {
+	defer runtime.KeepAlive(e)
+	if ret := C.opus_encoder_set_bitrate(e.encoder, C.int(bitrate)); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// SetComplexity sets the computational complexity from 0 to 10. A lower complexity is cheaper and sounds worse.
+func (e *Encoder) SetComplexity(complexity int) error {
+	defer runtime.KeepAlive(e)
+	if ret := C.opus_encoder_set_complexity(e.encoder, C.int(complexity)); ret != C.OPUS_OK {
+		return Error(ret)
+	}
+	return nil
+}
+
+// Lookahead returns the delay of the encoder in samples per channel at its rate, which is the pre-skip of the stream.
+func (e *Encoder) Lookahead() (int, error) {
+	defer runtime.KeepAlive(e)
+	var n C.int
+	if ret := C.opus_encoder_get_lookahead(e.encoder, &n); ret != C.OPUS_OK {
+		return 0, Error(ret)
+	}
+	return int(n), nil
+}
+
+// Destroy frees the encoder. Destroy is called when e is finalized, and can be called more than once.
+func (e *Encoder) Destroy() {
+	if e.encoder == nil {
+		return
+	}
+	C.opus_encoder_destroy(e.encoder)
+	e.encoder = nil
+	runtime.SetFinalizer(e, nil)
+}
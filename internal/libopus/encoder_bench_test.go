@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder
+
+package libopus
+
+import (
+	"fmt"
+	"testing"
+	"time"
+)
+
+// decodePCM decodes all the packets of a file in testdata into the interleaved samples at 48 kHz.
+func decodePCM(tb testing.TB, name string, channels int) []float32 {
+	tb.Helper()
+	d, err := DecoderCreate(48000, channels)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	defer d.Destroy()
+
+	var pcm []float32
+	buf := make([]float32, 5760*channels)
+	for _, p := range readPackets(tb, name) {
+		n := d.DecodeFloat(p, buf, 0)
+		if n < 0 {
+			tb.Fatal(Error(n))
+		}
+		pcm = append(pcm, buf[:n*channels]...)
+	}
+	return pcm
+}
+
+// BenchmarkEncodeFloatBatch encodes the decoded music in batches of 10 frames of 20 ms, as Recorder does, and reports
+// the share of one core that encoding in real time takes.
+func BenchmarkEncodeFloatBatch(b *testing.B) {
+	const (
+		frameSize = 960
+		batch     = 10
+		maxPacket = 1500
+	)
+	pcm := decodePCM(b, "music.packets", 2)
+	pcm = pcm[:len(pcm)/(frameSize*2*batch)*(frameSize*2*batch)]
+	for _, complexity := range []int{0, 1, 2, 5, 10} {
+		b.Run(fmt.Sprintf("complexity%d", complexity), func(b *testing.B) {
+			e, err := EncoderCreate(48000, 2, ApplicationAudio)
+			if err != nil {
+				b.Fatal(err)
+			}
+			defer e.Destroy()
+			if err := e.SetBitrate(96000); err != nil {
+				b.Fatal(err)
+			}
+			if err := e.SetComplexity(complexity); err != nil {
+				b.Fatal(err)
+			}
+
+			data := make([]byte, batch*maxPacket)
+			batches := len(pcm) / (frameSize * 2 * batch)
+			b.ResetTimer()
+			for i := range b.N {
+				j := i % batches * frameSize * 2 * batch
+				lens := e.EncodeFloatBatch(pcm[j:j+frameSize*2*batch], frameSize, data, maxPacket)
+				if len(lens) != batch || lens[batch-1] < 0 {
+					b.Fatalf("EncodeFloatBatch failed: %v", lens)
+				}
+			}
+			b.StopTimer()
+
+			audio := time.Duration(b.N*batch) * 20 * time.Millisecond
+			b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N*batch), "ns/frame")
+			b.ReportMetric(100*b.Elapsed().Seconds()/audio.Seconds(), "%core")
+		})
+	}
+}
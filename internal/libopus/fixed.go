@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build opusfixed
+
+package libopus
+
+// With the build tag opusfixed, libopus is built in fixed point, which is much cheaper on CPUs with a weak FPU.
+// The decoders decode to int16, and DecodeFloat converts the result to float.
+
+// #cgo CFLAGS: -DFIXED_POINT
+import "C"
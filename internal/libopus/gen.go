@@ -6,13 +6,18 @@
 package main
 
 import (
+	"flag"
 	"log/slog"
 	"os"
+	"strings"
 
 	"github.com/hajimehoshi/webmplayer/internal/cgen"
 )
 
+var flagPrebuilt = flag.String("prebuilt", "", "the comma-separated GOOS/GOARCH pairs to build the prebuilt objects for, instead of generating the C files")
+
 func main() {
+	flag.Parse()
 	if err := xmain(); err != nil {
 		slog.Error(err.Error())
 		os.Exit(1)
@@ -20,6 +25,15 @@ func main() {
 }
 
 func xmain() error {
+	if *flagPrebuilt != "" {
+		return cgen.BuildPrebuilt(&cgen.PrebuiltOptions{
+			Package:   ".",
+			OutputDir: "prebuilt",
+			Name:      "libopus",
+			Platforms: strings.Split(*flagPrebuilt, ","),
+		})
+	}
+
 	op := &cgen.GenerateOptions{
 		ProjectName: "libopus",
 		TarGzURL:    "https://downloads.xiph.org/releases/opus/opus-1.5.2.tar.gz",
@@ -56,6 +70,225 @@ func xmain() error {
 			"silk/x86",
 			"tests",
 		},
+		BuildConstraint: "!webmplayerprebuilt",
+		PreservedFiles: []string{
+			"celt_pitch_simd.h",
+			"celt_simd.h",
+			"celt_specialize.h",
+			"silk_simd.h",
+		},
+		Amalgamations: []cgen.Amalgamation{
+			{
+				Name: "amalgamation_celt.c",
+				// celt_decoder.c must be first, as it defines CELT_DECODER_C to make the custom decoder functions
+				// static in opus_custom.h.
+				Files: []string{"celt/celt_decoder.c", "celt/*.c"},
+				ExcludedFiles: []string{
+					// This defines CELT_C to define the variables in stack_alloc.h, which is already included.
+					"celt/celt.c",
+				},
+			},
+			{
+				Name:  "amalgamation_silk.c",
+				Files: []string{"silk/*.c"},
+				ExcludedFiles: []string{
+					// This defines QA as LPC_inv_pred_gain.c does.
+					"silk/NLSF2A.c",
+				},
+			},
+			{
+				Name:  "amalgamation_opus.c",
+				Files: []string{"src/*.c"},
+			},
+		},
+		Tagged: []cgen.Tagged{
+			{
+				// The player only decodes. These are referred only by the encoders.
+				Tag: "webmplayer_encoder",
+				Files: []string{
+					"celt/celt_encoder.c",
+					"silk/A2NLSF.c",
+					"silk/HP_variable_cutoff.c",
+					"silk/LP_variable_cutoff.c",
+					"silk/NLSF_VQ.c",
+					"silk/NLSF_VQ_weights_laroia.c",
+					"silk/NLSF_del_dec_quant.c",
+					"silk/NLSF_encode.c",
+					"silk/NSQ.c",
+					"silk/NSQ_del_dec.c",
+					"silk/VAD.c",
+					"silk/VQ_WMat_EC.c",
+					"silk/ana_filt_bank_1.c",
+					"silk/biquad_alt.c",
+					"silk/check_control_input.c",
+					"silk/control_SNR.c",
+					"silk/control_audio_bandwidth.c",
+					"silk/control_codec.c",
+					"silk/debug.c",
+					"silk/enc_API.c",
+					"silk/encode_indices.c",
+					"silk/encode_pulses.c",
+					"silk/float/*.c",
+					"silk/init_encoder.c",
+					"silk/inner_prod_aligned.c",
+					"silk/interpolate.c",
+					"silk/process_NLSFs.c",
+					"silk/quant_LTP_gains.c",
+					"silk/resampler_down2.c",
+					"silk/resampler_down2_3.c",
+					"silk/sigm_Q15.c",
+					"silk/stereo_LR_to_MS.c",
+					"silk/stereo_encode_pred.c",
+					"silk/stereo_find_predictor.c",
+					"silk/stereo_quant_pred.c",
+					"src/analysis.c",
+					"src/mlp.c",
+					"src/mlp_data.c",
+					"src/opus_encoder.c",
+					"src/opus_multistream_encoder.c",
+					"src/opus_projection_encoder.c",
+				},
+			},
+		},
+		Patches: []cgen.Patch{
+			{
+				// With the build tag opusscratch, the temporaries are allocated from a pseudostack instead of alloca.
+				File: "celt/stack_alloc.h",
+				Old:  "#ifdef CELT_C\nchar *scratch_ptr=0;\nchar *global_stack=0;\n#else\nextern char *global_stack;\nextern char *scratch_ptr;\n#endif /* CELT_C */\n",
+				New:  "/* The pseudostack is per thread, so that the decoders can run on multiple threads. */\n#ifdef CELT_C\n__thread char *scratch_ptr=0;\n__thread char *global_stack=0;\n#else\nextern __thread char *global_stack;\nextern __thread char *scratch_ptr;\n#endif /* CELT_C */\n",
+			},
+			{
+				// The pitch correlation is vectorized by celt_pitch_simd.h, with AVX selected at runtime on x86, and with NEON
+				// on arm64.
+				File: "celt/pitch.h",
+				Old:  "#ifndef OVERRIDE_COMB_FILTER_CONST\n# define comb_filter_const(y, x, T, N, g10, g11, g12, arch) \\\n    ((void)(arch),comb_filter_const_c(y, x, T, N, g10, g11, g12))\n#endif\n",
+				New:  "#ifndef OVERRIDE_COMB_FILTER_CONST\n# define comb_filter_const(y, x, T, N, g10, g11, g12, arch) \\\n    ((void)(arch),comb_filter_const_c(y, x, T, N, g10, g11, g12))\n#endif\n\n/* The float build uses the vectorized pitch correlation of celt_pitch_simd.h. */\n#include \"celt_pitch_simd.h\"\n",
+			},
+			{
+				// The float CELT decoder uses the vectorized kernels of celt_simd.h.
+				File: "celt/celt.c",
+				Old:  "#include \"celt_pitch.h\"\n",
+				New:  "#include \"celt_pitch.h\"\n#include \"celt_simd.h\"\n",
+			},
+			{
+				File: "celt/celt.c",
+				Old:  "   comb_filter_const(y+i, x+i, T1, N-i, g10, g11, g12, arch);\n",
+				New:  "#ifdef CELT_SIMD\n   comb_filter_const_simd(y+i, x+i, T1, N-i, g10, g11, g12);\n#else\n   comb_filter_const(y+i, x+i, T1, N-i, g10, g11, g12, arch);\n#endif\n",
+			},
+			{
+				File: "celt/bands.c",
+				Old:  "#include \"celt_pitch.h\"\n",
+				New:  "#include \"celt_pitch.h\"\n#include \"celt_simd.h\"\n",
+			},
+			{
+				File: "celt/bands.c",
+				Old:  "         /* Be careful of the fixed-point \"else\" just above when changing this code */\n         do {\n            *f++ = SHR32(MULT16_16(*x++, g), shift);\n         } while (++j<band_end);\n",
+				New:  "         /* Be careful of the fixed-point \"else\" just above when changing this code */\n#ifdef CELT_SIMD\n         {\n            celt_scale_band(f, x, g, band_end-j);\n            f += band_end-j;\n            x += band_end-j;\n         }\n#else\n         do {\n            *f++ = SHR32(MULT16_16(*x++, g), shift);\n         } while (++j<band_end);\n#endif\n",
+			},
+			{
+				File: "celt/vq.c",
+				Old:  "#include \"celt_bands.h\"\n",
+				New:  "#include \"celt_bands.h\"\n#include \"celt_simd.h\"\n",
+			},
+			{
+				File: "celt/vq.c",
+				Old:  "   i=0;\n   do\n      X[i] = EXTRACT16(PSHR32(MULT16_16(g, iy[i]), k+1));\n   while (++i < N);\n",
+				New:  "#ifdef CELT_SIMD\n   (void)i;\n   celt_scale_pulses(X, iy, g, N);\n#else\n   i=0;\n   do\n      X[i] = EXTRACT16(PSHR32(MULT16_16(g, iy[i]), k+1));\n   while (++i < N);\n#endif\n",
+			},
+			{
+				// The SILK decoder and its resampler use the vectorized kernels of silk_simd.h.
+				File: "silk/decode_core.c",
+				Old:  "#include \"celt_stack_alloc.h\"\n",
+				New:  "#include \"celt_stack_alloc.h\"\n#include \"silk_simd.h\"\n",
+			},
+			{
+				File: "silk/decode_core.c",
+				Old:  "    VARDECL( opus_int32, sLPC_Q14 );\n    SAVE_STACK;\n",
+				New:  "    VARDECL( opus_int32, sLPC_Q14 );\n#ifdef SILK_SIMD\n    silk_SMULWB4_coefs A_rev[ MAX_LPC_ORDER / 4 ], B_simd[ LTP_ORDER ];\n    int n4;\n#endif\n    SAVE_STACK;\n",
+			},
+			{
+				File: "silk/decode_core.c",
+				Old:  "        silk_memcpy( A_Q12_tmp, A_Q12, psDec->LPC_order * sizeof( opus_int16 ) );\n",
+				New:  "        silk_memcpy( A_Q12_tmp, A_Q12, psDec->LPC_order * sizeof( opus_int16 ) );\n#ifdef SILK_SIMD\n        n4 = silk_LPC_coefs_simd( A_rev, A_Q12_tmp, psDec->LPC_order );\n#endif\n",
+			},
+			{
+				File: "silk/decode_core.c",
+				Old:  "            pred_lag_ptr = &sLTP_Q15[ sLTP_buf_idx - lag + LTP_ORDER / 2 ];\n            for( i = 0; i < psDec->subfr_length; i++ ) {\n",
+				New:  "            pred_lag_ptr = &sLTP_Q15[ sLTP_buf_idx - lag + LTP_ORDER / 2 ];\n            i = 0;\n#ifdef SILK_SIMD\n            if( lag >= LTP_ORDER / 2 + 4 ) {\n                silk_LTP_coefs_simd( B_simd, B_Q14 );\n                for( ; i + 4 <= psDec->subfr_length; i += 4 ) {\n                    silk_LTP_pred4_simd( &pres_Q14[ i ], &pexc_Q14[ i ], &sLTP_Q15[ sLTP_buf_idx ], pred_lag_ptr, B_simd );\n                    pred_lag_ptr += 4;\n                    sLTP_buf_idx += 4;\n                }\n            }\n#endif\n            for( ; i < psDec->subfr_length; i++ ) {\n",
+			},
+			{
+				File: "silk/decode_core.c",
+				Old:  "            /* Avoids introducing a bias because silk_SMLAWB() always rounds to -inf */\n            LPC_pred_Q10 = silk_RSHIFT( psDec->LPC_order, 1 );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  1 ], A_Q12_tmp[ 0 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  2 ], A_Q12_tmp[ 1 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  3 ], A_Q12_tmp[ 2 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  4 ], A_Q12_tmp[ 3 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  5 ], A_Q12_tmp[ 4 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  6 ], A_Q12_tmp[ 5 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  7 ], A_Q12_tmp[ 6 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  8 ], A_Q12_tmp[ 7 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  9 ], A_Q12_tmp[ 8 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 10 ], A_Q12_tmp[ 9 ] );\n            if( psDec->LPC_order == 16 ) {\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 11 ], A_Q12_tmp[ 10 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 12 ], A_Q12_tmp[ 11 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 13 ], A_Q12_tmp[ 12 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 14 ], A_Q12_tmp[ 13 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 15 ], A_Q12_tmp[ 14 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 16 ], A_Q12_tmp[ 15 ] );\n            }\n\n",
+				New:  "#ifdef SILK_SIMD\n            LPC_pred_Q10 = silk_LPC_pred_simd( &sLPC_Q14[ MAX_LPC_ORDER + i ], A_rev, n4, silk_RSHIFT( psDec->LPC_order, 1 ) );\n#else\n            /* Avoids introducing a bias because silk_SMLAWB() always rounds to -inf */\n            LPC_pred_Q10 = silk_RSHIFT( psDec->LPC_order, 1 );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  1 ], A_Q12_tmp[ 0 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  2 ], A_Q12_tmp[ 1 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  3 ], A_Q12_tmp[ 2 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  4 ], A_Q12_tmp[ 3 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  5 ], A_Q12_tmp[ 4 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  6 ], A_Q12_tmp[ 5 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  7 ], A_Q12_tmp[ 6 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  8 ], A_Q12_tmp[ 7 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i -  9 ], A_Q12_tmp[ 8 ] );\n            LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 10 ], A_Q12_tmp[ 9 ] );\n            if( psDec->LPC_order == 16 ) {\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 11 ], A_Q12_tmp[ 10 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 12 ], A_Q12_tmp[ 11 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 13 ], A_Q12_tmp[ 12 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 14 ], A_Q12_tmp[ 13 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 15 ], A_Q12_tmp[ 14 ] );\n                LPC_pred_Q10 = silk_SMLAWB( LPC_pred_Q10, sLPC_Q14[ MAX_LPC_ORDER + i - 16 ], A_Q12_tmp[ 15 ] );\n            }\n#endif\n\n",
+			},
+			{
+				File: "silk/resampler_private_IIR_FIR.c",
+				Old:  "#include \"celt_stack_alloc.h\"\n",
+				New:  "#include \"celt_stack_alloc.h\"\n#include \"silk_simd.h\"\n",
+			},
+			{
+				File: "silk/resampler_private_IIR_FIR.c",
+				Old:  "    opus_int32 table_index;\n\n    /* Interpolate upsampled signal and store in output array */\n",
+				New:  "    opus_int32 table_index;\n#ifdef SILK_SIMD\n    silk_v8hi rows[ 12 ];\n\n    (void)buf_ptr;\n    (void)res_Q15;\n    silk_resampler_FIR_12_rows_simd( rows );\n    for( index_Q16 = 0; index_Q16 < max_index_Q16; index_Q16 += index_increment_Q16 ) {\n        table_index = silk_SMULWB( index_Q16 & 0xFFFF, 12 );\n        *out++ = silk_resampler_FIR_12_simd( &buf[ index_Q16 >> 16 ], &rows[ table_index ] );\n    }\n    return out;\n#endif\n\n    /* Interpolate upsampled signal and store in output array */\n",
+			},
+			{
+				// The IMDCT and the FFT of the static 48 kHz mode are specialized by celt_specialize.h.
+				File: "celt/kiss_fft.c",
+				Old:  "#include \"celt_stack_alloc.h\"\n",
+				New:  "#include \"celt_stack_alloc.h\"\n#include \"celt_specialize.h\"\n",
+			},
+			{
+				File: "celt/kiss_fft.c",
+				Old:  "void opus_fft_impl(const kiss_fft_state *st,kiss_fft_cpx *fout)\n{\n    int m2, m;\n    int p;\n    int L;\n    int fstride[MAXFACTORS];\n    int i;\n    int shift;\n\n    /* st->shift can be -1 */\n    shift = st->shift>0 ? st->shift : 0;\n\n    fstride[0] = 1;\n    L=0;\n    do {\n       p = st->factors[2*L];\n       m = st->factors[2*L+1];\n       fstride[L+1] = fstride[L]*p;\n       L++;\n    } while(m!=1);\n    m = st->factors[2*L-1];\n    for (i=L-1;i>=0;i--)\n    {\n       if (i!=0)\n          m2 = st->factors[2*i-1];\n       else\n          m2 = 1;\n       switch (st->factors[2*i])\n       {\n       case 2:\n          kf_bfly2(fout, m, fstride[i]);\n          break;\n       case 4:\n          kf_bfly4(fout,fstride[i]<<shift,st,m, fstride[i], m2);\n          break;\n #ifndef RADIX_TWO_ONLY\n       case 3:\n          kf_bfly3(fout,fstride[i]<<shift,st,m, fstride[i], m2);\n          break;\n       case 5:\n          kf_bfly5(fout,fstride[i]<<shift,st,m, fstride[i], m2);\n          break;\n #endif\n       }\n       m = m2;\n    }\n}\n",
+				New:  "void opus_fft_impl(const kiss_fft_state *st,kiss_fft_cpx *fout)\n{\n    int m2, m;\n    int p;\n    int L;\n    int fstride[MAXFACTORS];\n    int i;\n    int shift;\n\n    /* st->shift can be -1 */\n    shift = st->shift>0 ? st->shift : 0;\n\n    fstride[0] = 1;\n    L=0;\n    do {\n       p = st->factors[2*L];\n       m = st->factors[2*L+1];\n       fstride[L+1] = fstride[L]*p;\n       L++;\n    } while(m!=1);\n    m = st->factors[2*L-1];\n    for (i=L-1;i>=0;i--)\n    {\n       if (i!=0)\n          m2 = st->factors[2*i-1];\n       else\n          m2 = 1;\n       switch (st->factors[2*i])\n       {\n       case 2:\n          kf_bfly2(fout, m, fstride[i]);\n          break;\n       case 4:\n          kf_bfly4(fout,fstride[i]<<shift,st,m, fstride[i], m2);\n          break;\n #ifndef RADIX_TWO_ONLY\n       case 3:\n          kf_bfly3(fout,fstride[i]<<shift,st,m, fstride[i], m2);\n          break;\n       case 5:\n          kf_bfly5(fout,fstride[i]<<shift,st,m, fstride[i], m2);\n          break;\n #endif\n       }\n       m = m2;\n    }\n}\n\n#ifdef CELT_SPECIALIZE\n/* webmplayer: opus_fft_impl for the sizes of the IMDCTs of the static 48 kHz mode, with the factors as constants so\n   that the butterflies are specialized for them. kf_factor gives the same factors for a size, so the sizes of custom\n   modes can take these too. */\n/* The factors of 480 are 5, 3, 4, 2, 4. */\nstatic void opus_fft_480(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n   kf_bfly4(fout, 120<<shift, st, 1, 120, 4);\n   kf_bfly2(fout, 4, 60);\n   kf_bfly4(fout, 15<<shift, st, 8, 15, 32);\n   kf_bfly3(fout, 5<<shift, st, 32, 5, 96);\n   kf_bfly5(fout, 1<<shift, st, 96, 1, 1);\n}\n\n/* The factors of 240 are 5, 3, 4, 4. */\nstatic void opus_fft_240(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n   kf_bfly4(fout, 60<<shift, st, 1, 60, 4);\n   kf_bfly4(fout, 15<<shift, st, 4, 15, 16);\n   kf_bfly3(fout, 5<<shift, st, 16, 5, 48);\n   kf_bfly5(fout, 1<<shift, st, 48, 1, 1);\n}\n\n/* The factors of 120 are 5, 3, 2, 4. */\nstatic void opus_fft_120(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n   kf_bfly4(fout, 30<<shift, st, 1, 30, 4);\n   kf_bfly2(fout, 4, 15);\n   kf_bfly3(fout, 5<<shift, st, 8, 5, 24);\n   kf_bfly5(fout, 1<<shift, st, 24, 1, 1);\n}\n\n/* The factors of 60 are 5, 3, 4. */\nstatic void opus_fft_60(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n   kf_bfly4(fout, 15<<shift, st, 1, 15, 4);\n   kf_bfly3(fout, 5<<shift, st, 4, 5, 12);\n   kf_bfly5(fout, 1<<shift, st, 12, 1, 1);\n}\n\n/* webmplayer: opus_fft_impl with the specialized sizes. */\nstatic CELT_ALWAYS_INLINE void opus_fft_specialized(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   switch (st->nfft)\n   {\n   case 480:\n      opus_fft_480(st, fout);\n      return;\n   case 240:\n      opus_fft_240(st, fout);\n      return;\n   case 120:\n      opus_fft_120(st, fout);\n      return;\n   case 60:\n      opus_fft_60(st, fout);\n      return;\n   }\n   opus_fft_impl(st, fout);\n}\n#endif\n",
+			},
+			{
+				File: "celt/mdct.c",
+				Old:  "#include \"celt_mathops.h\"\n",
+				New:  "#include \"celt_mathops.h\"\n#include \"celt_specialize.h\"\n",
+			},
+			{
+				File: "celt/mdct.c",
+				Old:  "void clt_mdct_backward_c(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * OPUS_RESTRICT out,\n      const opus_val16 * OPUS_RESTRICT window, int overlap, int shift, int stride, int arch)\n{\n   int i;\n   int N, N2, N4;\n   const kiss_twiddle_scalar *trig;\n   (void) arch;\n\n   N = l->n;\n",
+				New:  "#ifdef CELT_SPECIALIZE\n/* webmplayer: The body of clt_mdct_backward_c, inlined with the sizes as constants. n is l->n. */\nstatic CELT_ALWAYS_INLINE void clt_mdct_backward_impl(const mdct_lookup *l, kiss_fft_scalar *in,\n      kiss_fft_scalar * OPUS_RESTRICT out, const opus_val16 * OPUS_RESTRICT window, int overlap, int shift, int stride,\n      int n)\n#else\nvoid clt_mdct_backward_c(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * OPUS_RESTRICT out,\n      const opus_val16 * OPUS_RESTRICT window, int overlap, int shift, int stride, int arch)\n#endif\n{\n   int i;\n   int N, N2, N4;\n   const kiss_twiddle_scalar *trig;\n#ifdef CELT_SPECIALIZE\n   N = n;\n#else\n   (void) arch;\n\n   N = l->n;\n#endif\n",
+			},
+			{
+				File: "celt/mdct.c",
+				Old:  "   opus_fft_impl(l->kfft[shift], (kiss_fft_cpx*)(out+(overlap>>1)));\n",
+				New:  "#ifdef CELT_SPECIALIZE\n   opus_fft_specialized(l->kfft[shift], (kiss_fft_cpx*)(out+(overlap>>1)));\n#else\n   opus_fft_impl(l->kfft[shift], (kiss_fft_cpx*)(out+(overlap>>1)));\n#endif\n",
+			},
+			{
+				File: "celt/mdct.c",
+				Old:  "\n}\n#endif /* OVERRIDE_clt_mdct_backward */",
+				New:  "\n}\n\n#ifdef CELT_SPECIALIZE\nvoid clt_mdct_backward_c(const mdct_lookup *l, kiss_fft_scalar *in, kiss_fft_scalar * OPUS_RESTRICT out,\n      const opus_val16 * OPUS_RESTRICT window, int overlap, int shift, int stride, int arch)\n{\n   (void) arch;\n   /* webmplayer: The IMDCTs of the static 48 kHz mode, of the long blocks of each LM and of the short blocks. */\n   if (l->n == 1920 && overlap == 120)\n   {\n      switch (shift<<4|stride)\n      {\n      case 0<<4|1:\n         clt_mdct_backward_impl(l, in, out, window, 120, 0, 1, 1920);\n         return;\n      case 1<<4|1:\n         clt_mdct_backward_impl(l, in, out, window, 120, 1, 1, 1920);\n         return;\n      case 2<<4|1:\n         clt_mdct_backward_impl(l, in, out, window, 120, 2, 1, 1920);\n         return;\n      case 3<<4|1:\n         clt_mdct_backward_impl(l, in, out, window, 120, 3, 1, 1920);\n         return;\n      case 3<<4|2:\n         clt_mdct_backward_impl(l, in, out, window, 120, 3, 2, 1920);\n         return;\n      case 3<<4|4:\n         clt_mdct_backward_impl(l, in, out, window, 120, 3, 4, 1920);\n         return;\n      case 3<<4|8:\n         clt_mdct_backward_impl(l, in, out, window, 120, 3, 8, 1920);\n         return;\n      }\n   }\n   clt_mdct_backward_impl(l, in, out, window, overlap, shift, stride, l->n);\n}\n#endif\n#endif /* OVERRIDE_clt_mdct_backward */",
+			},
+			{
+				// The butterflies of the specialized FFTs are vectorized by celt_simd.h in the float build.
+				File: "celt/kiss_fft.c",
+				Old:  "#include \"celt_specialize.h\"\n",
+				New:  "#include \"celt_specialize.h\"\n#include \"celt_simd.h\"\n",
+			},
+			{
+				File: "celt/kiss_fft.c",
+				Old:  "/* The factors of 480 are 5, 3, 4, 2, 4. */\nstatic void opus_fft_480(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n",
+				New:  "#ifdef CELT_SIMD\n/* webmplayer: the twiddles of the butterflies of the specialized sizes for kf_bfly*_simd. They are of the twiddles of\n   the size 480 of kf_twiddles_src, which are set by the first call with such twiddles. */\nstatic const kiss_twiddle_cpx *kf_twiddles_src;\nstatic int kf_twiddles_state; /* 0, 1 while the twiddles are being set, or 2 */\nstatic celt_v4sf kf_tw480_4[3*8/2], kf_tw480_3[2*32/2], kf_tw480_5[4*96/2];\nstatic celt_v4sf kf_tw240_4[3*4/2], kf_tw240_3[2*16/2], kf_tw240_5[4*48/2];\nstatic celt_v4sf kf_tw120_3[2*8/2], kf_tw120_5[4*24/2];\nstatic celt_v4sf kf_tw60_3[2*4/2], kf_tw60_5[4*12/2];\n\n/* webmplayer: reports whether the butterflies of st can be kf_bfly*_simd with the twiddles above, setting them if\n   they are not set yet. While another thread is setting them, the original butterflies are used. With the twiddles of\n   the size 480, epi3 of kf_bfly3 is the twiddle 160, and ya and yb of kf_bfly5 are the twiddles 96 and 192. */\nstatic int kf_twiddles_simd_ready(const kiss_fft_state *st, int shift)\n{\n   int state;\n   if ((st->nfft<<shift) != 480)\n      return 0;\n   state = __atomic_load_n(&kf_twiddles_state, __ATOMIC_ACQUIRE);\n   if (state == 0 && __atomic_compare_exchange_n(&kf_twiddles_state, &state, 1, 0, __ATOMIC_ACQ_REL,\n         __ATOMIC_ACQUIRE))\n   {\n      const kiss_twiddle_cpx *tw = st->twiddles;\n      kf_twiddles_simd(kf_tw480_4, tw, 15, 8, 4);\n      kf_twiddles_simd(kf_tw480_3, tw, 5, 32, 3);\n      kf_twiddles_simd(kf_tw480_5, tw, 1, 96, 5);\n      kf_twiddles_simd(kf_tw240_4, tw, 30, 4, 4);\n      kf_twiddles_simd(kf_tw240_3, tw, 10, 16, 3);\n      kf_twiddles_simd(kf_tw240_5, tw, 2, 48, 5);\n      kf_twiddles_simd(kf_tw120_3, tw, 20, 8, 3);\n      kf_twiddles_simd(kf_tw120_5, tw, 4, 24, 5);\n      kf_twiddles_simd(kf_tw60_3, tw, 40, 4, 3);\n      kf_twiddles_simd(kf_tw60_5, tw, 8, 12, 5);\n      kf_twiddles_src = tw;\n      __atomic_store_n(&kf_twiddles_state, 2, __ATOMIC_RELEASE);\n      return 1;\n   }\n   return state == 2 && st->twiddles == kf_twiddles_src;\n}\n#endif\n\n/* The factors of 480 are 5, 3, 4, 2, 4. */\nstatic void opus_fft_480(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n#ifdef CELT_SIMD\n   if (kf_twiddles_simd_ready(st, shift))\n   {\n      kf_bfly4(fout, 120<<shift, st, 1, 120, 4);\n      kf_bfly2(fout, 4, 60);\n      kf_bfly4_simd(fout, 8, 15, 32, kf_tw480_4);\n      kf_bfly3_simd(fout, 32, 5, 96, kf_tw480_3, st->twiddles[160]);\n      kf_bfly5_simd(fout, 96, 1, 1, kf_tw480_5, st->twiddles[96], st->twiddles[192]);\n      return;\n   }\n#endif\n",
+			},
+			{
+				File: "celt/kiss_fft.c",
+				Old:  "static void opus_fft_240(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n",
+				New:  "static void opus_fft_240(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n#ifdef CELT_SIMD\n   if (kf_twiddles_simd_ready(st, shift))\n   {\n      kf_bfly4(fout, 60<<shift, st, 1, 60, 4);\n      kf_bfly4_simd(fout, 4, 15, 16, kf_tw240_4);\n      kf_bfly3_simd(fout, 16, 5, 48, kf_tw240_3, st->twiddles[160]);\n      kf_bfly5_simd(fout, 48, 1, 1, kf_tw240_5, st->twiddles[96], st->twiddles[192]);\n      return;\n   }\n#endif\n",
+			},
+			{
+				File: "celt/kiss_fft.c",
+				Old:  "static void opus_fft_120(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n",
+				New:  "static void opus_fft_120(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n#ifdef CELT_SIMD\n   if (kf_twiddles_simd_ready(st, shift))\n   {\n      kf_bfly4(fout, 30<<shift, st, 1, 30, 4);\n      kf_bfly2(fout, 4, 15);\n      kf_bfly3_simd(fout, 8, 5, 24, kf_tw120_3, st->twiddles[160]);\n      kf_bfly5_simd(fout, 24, 1, 1, kf_tw120_5, st->twiddles[96], st->twiddles[192]);\n      return;\n   }\n#endif\n",
+			},
+			{
+				File: "celt/kiss_fft.c",
+				Old:  "static void opus_fft_60(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n",
+				New:  "static void opus_fft_60(const kiss_fft_state *st, kiss_fft_cpx *fout)\n{\n   int shift = st->shift>0 ? st->shift : 0;\n#ifdef CELT_SIMD\n   if (kf_twiddles_simd_ready(st, shift))\n   {\n      kf_bfly4(fout, 15<<shift, st, 1, 15, 4);\n      kf_bfly3_simd(fout, 4, 5, 12, kf_tw60_3, st->twiddles[160]);\n      kf_bfly5_simd(fout, 12, 1, 1, kf_tw60_5, st->twiddles[96], st->twiddles[192]);\n      return;\n   }\n#endif\n",
+			},
+		},
 	}
 	if err := cgen.Generate(op); err != nil {
 		return err
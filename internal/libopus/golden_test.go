@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !opusfixed
+
+package libopus
+
+import (
+	"bufio"
+	"bytes"
+	"flag"
+	"fmt"
+	"hash/crc32"
+	"math"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+	"testing"
+	"unsafe"
+)
+
+var update = flag.Bool("update", false, "write the golden files in testdata instead of comparing with them")
+
+// goldenBlock is the number of the frames of a block of the golden files.
+const goldenBlock = 1024
+
+// goldenBlocks returns a line for each block of goldenBlock frames of the interleaved samples pcm: the CRC-32 of the
+// bits of the samples, and the RMS of each channel.
+func goldenBlocks(pcm []float32, channels int) []string {
+	var lines []string
+	for len(pcm) > 0 {
+		n := min(len(pcm), goldenBlock*channels)
+		b := pcm[:n]
+		pcm = pcm[n:]
+		crc := crc32.ChecksumIEEE(unsafe.Slice((*byte)(unsafe.Pointer(unsafe.SliceData(b))), 4*len(b)))
+		line := fmt.Sprintf("%08x", crc)
+		for c := range channels {
+			var sum float64
+			for i := c; i < len(b); i += channels {
+				sum += float64(b[i]) * float64(b[i])
+			}
+			line += fmt.Sprintf(" %.6g", math.Sqrt(sum/float64(len(b)/channels)))
+		}
+		lines = append(lines, line)
+	}
+	return lines
+}
+
+// testGolden compares the lines of goldenBlocks with the golden file name in testdata, or writes the file with
+// -update. A block matches if its CRC-32 is the same. Otherwise, e.g. with the float operations of another
+// architecture, the RMS of each channel must be the same within a tolerance of -80 dB of the full scale.
+func testGolden(t *testing.T, name string, lines []string) {
+	t.Helper()
+	path := filepath.Join("testdata", name)
+	if *update {
+		var b bytes.Buffer
+		for _, l := range lines {
+			b.WriteString(l + "\n")
+		}
+		if err := os.WriteFile(path, b.Bytes(), 0o644); err != nil {
+			t.Fatal(err)
+		}
+		return
+	}
+
+	f, err := os.Open(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer f.Close()
+	var golden []string
+	s := bufio.NewScanner(f)
+	for s.Scan() {
+		golden = append(golden, s.Text())
+	}
+	if err := s.Err(); err != nil {
+		t.Fatal(err)
+	}
+	if len(lines) != len(golden) {
+		t.Fatalf("%s: blocks: got %d, want %d", name, len(lines), len(golden))
+	}
+	var inexact int
+	for i, l := range lines {
+		if l[:8] == golden[i][:8] {
+			continue
+		}
+		inexact++
+		got := parseRMS(t, l)
+		want := parseRMS(t, golden[i])
+		if len(got) != len(want) {
+			t.Fatalf("%s: block %d: channels: got %d, want %d", name, i, len(got), len(want))
+		}
+		for c := range got {
+			if math.Abs(got[c]-want[c]) > 1e-4 {
+				t.Errorf("%s: block %d, channel %d: RMS: got %v, want %v", name, i, c, got[c], want[c])
+			}
+		}
+	}
+	if inexact > 0 {
+		t.Logf("%s: %d of %d blocks are not bit-exact", name, inexact, len(lines))
+	}
+}
+
+// parseRMS returns the RMS of the channels of a line of goldenBlocks.
+func parseRMS(t *testing.T, line string) []float64 {
+	t.Helper()
+	var rms []float64
+	for _, f := range strings.Fields(line)[1:] {
+		v, err := strconv.ParseFloat(f, 64)
+		if err != nil {
+			t.Fatal(err)
+		}
+		rms = append(rms, v)
+	}
+	return rms
+}
+
+func TestDecodeGolden(t *testing.T) {
+	for _, s := range []struct {
+		name     string
+		channels int
+		lost     int
+	}{
+		{name: "music", channels: 2},
+		{name: "speech", channels: 1},
+		// Every 7th packet is lost, so that the concealment is tested.
+		{name: "music", channels: 2, lost: 7},
+	} {
+		golden := s.name + ".golden"
+		if s.lost > 0 {
+			golden = fmt.Sprintf("%s_lost%d.golden", s.name, s.lost)
+		}
+		t.Run(golden, func(t *testing.T) {
+			packets := readPackets(t, s.name+".packets")
+			d, err := DecoderCreate(48000, s.channels)
+			if err != nil {
+				t.Fatal(err)
+			}
+			defer d.Destroy()
+
+			var out []float32
+			pcm := make([]float32, 5760*s.channels)
+			var n int
+			for i, p := range packets {
+				buf := pcm
+				if s.lost > 0 && i%s.lost == s.lost-1 {
+					// The lost packet is concealed for the duration of the previous packet.
+					p = nil
+					buf = pcm[:n*s.channels]
+				}
+				n = d.DecodeFloat(p, buf, 0)
+				if n < 0 {
+					t.Fatalf("packet %d: %v", i, Error(n))
+				}
+				out = append(out, pcm[:n*s.channels]...)
+			}
+			testGolden(t, golden, goldenBlocks(out, s.channels))
+		})
+	}
+}
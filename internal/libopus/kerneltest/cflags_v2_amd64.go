@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo && !opusfixed && amd64.v2 && !amd64.v3
+
+package kerneltest
+
+// #cgo CFLAGS: -march=x86-64-v2
+import "C"
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo && !opusfixed && arm64.v8.2
+
+package kerneltest
+
+// #cgo CFLAGS: -march=armv8.2-a
+import "C"
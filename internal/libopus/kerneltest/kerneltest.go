@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo && !opusfixed
+
+// Package kerneltest compiles the vectorized kernels of the libopus decoder and their scalar references side by
+// side, so that the tests can compare them and the benchmarks can time them over the inputs captured from the
+// decoder.
+//
+// The vectorized kernels are compiled from the same sources with the same macros and flags as the decoder. The
+// float build only, as the fixed-point build has no vectorized kernels.
+package kerneltest
+
+// #cgo CFLAGS: -DOPUS_BUILD -DHAVE_LRINT -DHAVE_LRINTF -DUSE_ALLOCA -O3 -I${SRCDIR}/..
+//
+// #include "kerneltest.h"
+import "C"
+
+import (
+	"fmt"
+	"unsafe"
+
+	// The kernels call the other functions and the tables of the decoder, e.g. silk_LPC_analysis_filter.
+	_ "github.com/hajimehoshi/webmplayer/internal/libopus"
+)
+
+// Variant is the build of a kernel.
+type Variant int
+
+const (
+	// Vectorized is the kernel as the decoder builds it.
+	Vectorized Variant = iota
+
+	// Scalar is the kernel without the vector extensions, the specialized sizes and the auto-vectorization.
+	Scalar
+)
+
+func (v Variant) String() string {
+	switch v {
+	case Vectorized:
+		return "vectorized"
+	case Scalar:
+		return "scalar"
+	}
+	return fmt.Sprintf("Variant(%d)", int(v))
+}
+
+// Overlap is the overlap of the windows of the static 48 kHz mode.
+const Overlap = 120
+
+// MDCTSize returns the numbers of the samples of the input and the output of MDCTBackward with shift and stride.
+func MDCTSize(shift, stride int) (in, out int) {
+	n2 := 1920 >> shift >> 1
+	return stride*(n2-1) + 1, Overlap/2 + n2
+}
+
+// MDCTBackward calls clt_mdct_backward_c of the static 48 kHz mode. out[:Overlap/2] is the overlap of the previous
+// frame.
+func MDCTBackward(v Variant, shift, stride int, in, out []float32) {
+	nin, nout := MDCTSize(shift, stride)
+	if len(in) < nin || len(out) < nout {
+		panic(fmt.Sprintf("kerneltest: the numbers of the samples of the IMDCT must be at least %d and %d: %d and %d", nin, nout, len(in), len(out)))
+	}
+	pin := (*C.float)(unsafe.Pointer(unsafe.SliceData(in)))
+	pout := (*C.float)(unsafe.Pointer(unsafe.SliceData(out)))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_mdct_backward(C.int(shift), C.int(stride), pin, pout)
+	case Scalar:
+		C.scalar_kt_mdct_backward(C.int(shift), C.int(stride), pin, pout)
+	}
+}
+
+// FFT calls the FFT of the IMDCT of the static 48 kHz mode with shift in place. data has the real and the imaginary
+// parts of 480>>shift complex numbers.
+func FFT(v Variant, shift int, data []float32) {
+	if len(data) < 2*(480>>shift) {
+		panic(fmt.Sprintf("kerneltest: the size of the FFT must be at least %d: %d", 2*(480>>shift), len(data)))
+	}
+	p := (*C.float)(unsafe.Pointer(unsafe.SliceData(data)))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_fft(C.int(shift), p)
+	case Scalar:
+		C.scalar_kt_fft(C.int(shift), p)
+	}
+}
+
+// PitchXcorr calls celt_pitch_xcorr, which is celt_pitch_xcorr_simd of celt_pitch_simd.h for Vectorized, with AVX if
+// the CPU supports it or NEON, and celt_pitch_xcorr_c for Scalar. The length is len(x), and the maximum pitch is
+// len(xcorr).
+func PitchXcorr(v Variant, x, y, xcorr []float32) {
+	if len(y) < len(x)+len(xcorr) {
+		panic(fmt.Sprintf("kerneltest: len(y) must be at least %d: %d", len(x)+len(xcorr), len(y)))
+	}
+	px := (*C.float)(unsafe.Pointer(unsafe.SliceData(x)))
+	py := (*C.float)(unsafe.Pointer(unsafe.SliceData(y)))
+	pxcorr := (*C.float)(unsafe.Pointer(unsafe.SliceData(xcorr)))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_pitch_xcorr(px, py, pxcorr, C.int(len(x)), C.int(len(xcorr)))
+	case Scalar:
+		C.scalar_kt_pitch_xcorr(px, py, pxcorr, C.int(len(x)), C.int(len(xcorr)))
+	}
+}
+
+// CombFilter calls comb_filter in place on x[start:start+n]. The filter reads max(t0, t1)+2 samples before start.
+func CombFilter(v Variant, x []float32, start int, t0, t1, n int, g0, g1 float32, tapset0, tapset1, overlap int) {
+	if start < max(t0, t1)+2 || len(x) < start+n {
+		panic(fmt.Sprintf("kerneltest: the comb filter of %d samples at %d is out of the %d samples", n, start, len(x)))
+	}
+	p := (*C.float)(unsafe.Pointer(&x[start]))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_comb_filter(p, C.int(t0), C.int(t1), C.int(n), C.float(g0), C.float(g1), C.int(tapset0), C.int(tapset1), C.int(overlap))
+	case Scalar:
+		C.scalar_kt_comb_filter(p, C.int(t0), C.int(t1), C.int(n), C.float(g0), C.float(g1), C.int(tapset0), C.int(tapset1), C.int(overlap))
+	}
+}
+
+// SILKFrame is the state and the parameters of a frame read by silk_decode_core, of the same layout as
+// kt_silk_frame. SLPCQ14Buf is updated by the decoding.
+type SILKFrame struct {
+	FrameLength, SubfrLength, NbSubfr, LPCOrder, LTPMemLength int32
+	SignalType, QuantOffsetType, NLSFInterpCoefQ2, Seed       int32
+	LagPrev, PrevSignalType, LossCnt                          int32
+	PrevGainQ16                                               int32
+	SLPCQ14Buf                                                [16]int32
+	OutBuf                                                    [480]int16
+	PredCoefQ12                                               [2][16]int16
+	LTPCoefQ14                                                [20]int16
+	PitchL                                                    [4]int32
+	GainsQ16                                                  [4]int32
+	LTPScaleQ14                                               int32
+	Pulses                                                    [320]int16
+}
+
+// The layouts of SILKFrame and kt_silk_frame must be the same.
+const (
+	_ = uint(unsafe.Sizeof(SILKFrame{}) - unsafe.Sizeof(C.kt_silk_frame{}))
+	_ = uint(unsafe.Sizeof(C.kt_silk_frame{}) - unsafe.Sizeof(SILKFrame{}))
+)
+
+// SILKDecodeCore calls silk_decode_core for f, and writes f.FrameLength samples to xq.
+func SILKDecodeCore(v Variant, f *SILKFrame, xq []int16) {
+	if len(xq) < int(f.FrameLength) || f.FrameLength > 320 || f.LTPMemLength > 320 {
+		panic(fmt.Sprintf("kerneltest: the SILK frame of %d samples doesn't fit", f.FrameLength))
+	}
+	pf := (*C.kt_silk_frame)(unsafe.Pointer(f))
+	pxq := (*C.int16_t)(unsafe.Pointer(unsafe.SliceData(xq)))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_silk_decode_core(pf, pxq)
+	case Scalar:
+		C.scalar_kt_silk_decode_core(pf, pxq)
+	}
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libopus. This declares the kernels of the CELT and SILK decoders compiled twice from the
+// patched libopus sources: vectorized_*, with the same macros and flags as the decoder, and scalar_*, without the
+// vector extensions, the specialized sizes and the auto-vectorization.
+
+#ifndef KERNELTEST_H
+#define KERNELTEST_H
+
+#include <stdint.h>
+
+/* The state and the parameters of a SILK subframe group read by silk_decode_core. sLPC_Q14_buf is updated. */
+typedef struct {
+   int frame_length, subfr_length, nb_subfr, LPC_order, ltp_mem_length;
+   int signalType, quantOffsetType, NLSFInterpCoef_Q2, Seed;
+   int lagPrev, prevSignalType, lossCnt;
+   int32_t prev_gain_Q16;
+   int32_t sLPC_Q14_buf[16];
+   int16_t outBuf[480];
+   int16_t PredCoef_Q12[2][16];
+   int16_t LTPCoef_Q14[20];
+   int32_t pitchL[4];
+   int32_t Gains_Q16[4];
+   int LTP_scale_Q14;
+   int16_t pulses[320];
+} kt_silk_frame;
+
+/* The IMDCTs, the FFTs and the comb filters are of the static 48 kHz mode with 960-sample frames. */
+#define KERNELTEST_DECLARE(v) \
+   void v##_kt_mdct_backward(int shift, int stride, const float *in, float *out); \
+   void v##_kt_fft(int shift, float *data); \
+   void v##_kt_pitch_xcorr(const float *x, const float *y, float *xcorr, int len, int max_pitch); \
+   void v##_kt_comb_filter(float *x, int T0, int T1, int N, float g0, float g1, int tapset0, int tapset1, \
+         int overlap); \
+   void v##_kt_silk_decode_core(kt_silk_frame *f, int16_t *xq);
+
+KERNELTEST_DECLARE(vectorized)
+KERNELTEST_DECLARE(scalar)
+
+#endif /* KERNELTEST_H */
@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo && !opusfixed
+
+package kerneltest
+
+import (
+	"encoding/binary"
+	"math"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// The files in testdata are the inputs of the kernels captured from the decoder, while decoding music.packets of
+// ../testdata with every 7th packet lost, so that the concealment calls celt_pitch_xcorr_c too, and speech.packets.
+// A few calls of each kernel are written at its entry, with the arrays that the kernel reads. The integers and the
+// floats are 32-bit little-endian, and an array is its length followed by its elements:
+//
+//   - mdct.bin: shift, stride, the input, and out[:Overlap/2].
+//   - fft.bin: shift, and the data, captured at the FFT of the IMDCT.
+//   - xcorr.bin: x, and y.
+//   - comb.bin: T0, T1, N, g0, g1, tapset0, tapset1, overlap, and x from max(T0, T1)+2 samples before the filtered
+//     samples. Only the calls in place with a nonzero gain.
+//   - silk.bin: frame_length, subfr_length, nb_subfr, LPC_order, ltp_mem_length, signalType, quantOffsetType,
+//     NLSFInterpCoef_Q2, Seed, lagPrev, prevSignalType, lossCnt, prev_gain_Q16, sLPC_Q14_buf, outBuf[:ltp_mem_length],
+//     PredCoef_Q12, LTPCoef_Q14, pitchL, Gains_Q16, LTP_scale_Q14, and the pulses, 16-bit for outBuf, PredCoef_Q12,
+//     LTPCoef_Q14 and the pulses.
+
+var variants = []Variant{Vectorized, Scalar}
+
+type reader struct {
+	tb   testing.TB
+	name string
+	b    []byte
+}
+
+func newReader(tb testing.TB, name string) *reader {
+	tb.Helper()
+	b, err := os.ReadFile(filepath.Join("testdata", name))
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return &reader{tb: tb, name: name, b: b}
+}
+
+func (r *reader) more() bool {
+	return len(r.b) > 0
+}
+
+func (r *reader) next(n int) []byte {
+	if len(r.b) < n {
+		r.tb.Fatalf("%s is truncated", r.name)
+	}
+	b := r.b[:n]
+	r.b = r.b[n:]
+	return b
+}
+
+func (r *reader) i32() int32 {
+	return int32(binary.LittleEndian.Uint32(r.next(4)))
+}
+
+func (r *reader) f32() float32 {
+	return math.Float32frombits(binary.LittleEndian.Uint32(r.next(4)))
+}
+
+func (r *reader) len() int {
+	n := r.i32()
+	if n < 0 {
+		r.tb.Fatalf("%s is broken", r.name)
+	}
+	return int(n)
+}
+
+func (r *reader) f32s() []float32 {
+	v := make([]float32, r.len())
+	for i := range v {
+		v[i] = r.f32()
+	}
+	return v
+}
+
+func (r *reader) i32s() []int32 {
+	v := make([]int32, r.len())
+	for i := range v {
+		v[i] = r.i32()
+	}
+	return v
+}
+
+func (r *reader) i16s() []int16 {
+	v := make([]int16, r.len())
+	for i := range v {
+		v[i] = int16(binary.LittleEndian.Uint16(r.next(2)))
+	}
+	return v
+}
+
+// same reports whether got is want within the error of 1e-5 of the peak of want, as the compiler can contract or
+// reassociate the float operations differently in the variants.
+func same(got, want []float32) bool {
+	if len(got) != len(want) {
+		return false
+	}
+	var peak float64
+	for _, v := range want {
+		peak = max(peak, math.Abs(float64(v)))
+	}
+	for i := range got {
+		if math.Abs(float64(got[i])-float64(want[i])) > 1e-5*peak {
+			return false
+		}
+	}
+	return true
+}
+
+type mdctInput struct {
+	shift, stride int
+	in, out       []float32
+}
+
+func readMDCT(tb testing.TB) []mdctInput {
+	r := newReader(tb, "mdct.bin")
+	var inputs []mdctInput
+	for r.more() {
+		c := mdctInput{shift: int(r.i32()), stride: int(r.i32()), in: r.f32s()}
+		prefix := r.f32s()
+		nin, nout := MDCTSize(c.shift, c.stride)
+		if len(c.in) != nin || len(prefix) != Overlap/2 {
+			tb.Fatalf("mdct.bin is broken")
+		}
+		c.out = make([]float32, nout)
+		copy(c.out, prefix)
+		inputs = append(inputs, c)
+	}
+	return inputs
+}
+
+func TestMDCTBackward(t *testing.T) {
+	for i, c := range readMDCT(t) {
+		want := append([]float32(nil), c.out...)
+		MDCTBackward(Scalar, c.shift, c.stride, c.in, want)
+		got := append([]float32(nil), c.out...)
+		MDCTBackward(Vectorized, c.shift, c.stride, c.in, got)
+		if !same(got, want) {
+			t.Errorf("input %d (shift: %d, stride: %d): the vectorized IMDCT differs from the scalar one", i, c.shift, c.stride)
+		}
+	}
+}
+
+func BenchmarkMDCTBackward(b *testing.B) {
+	inputs := readMDCT(b)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			out := make([]float32, len(inputs[0].out))
+			for i := range b.N {
+				c := inputs[i%len(inputs)]
+				copy(out, c.out)
+				MDCTBackward(v, c.shift, c.stride, c.in, out[:len(c.out)])
+			}
+		})
+	}
+}
+
+type fftInput struct {
+	shift int
+	data  []float32
+}
+
+func readFFT(tb testing.TB) []fftInput {
+	r := newReader(tb, "fft.bin")
+	var inputs []fftInput
+	for r.more() {
+		c := fftInput{shift: int(r.i32()), data: r.f32s()}
+		if len(c.data) != 2*(480>>c.shift) {
+			tb.Fatalf("fft.bin is broken")
+		}
+		inputs = append(inputs, c)
+	}
+	return inputs
+}
+
+func TestFFT(t *testing.T) {
+	for i, c := range readFFT(t) {
+		want := append([]float32(nil), c.data...)
+		FFT(Scalar, c.shift, want)
+		got := append([]float32(nil), c.data...)
+		FFT(Vectorized, c.shift, got)
+		if !same(got, want) {
+			t.Errorf("input %d (shift: %d): the vectorized FFT differs from the scalar one", i, c.shift)
+		}
+	}
+}
+
+func BenchmarkFFT(b *testing.B) {
+	inputs := readFFT(b)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			data := make([]float32, 960)
+			for i := range b.N {
+				c := inputs[i%len(inputs)]
+				copy(data, c.data)
+				FFT(v, c.shift, data[:len(c.data)])
+			}
+		})
+	}
+}
+
+type xcorrInput struct {
+	x, y     []float32
+	maxPitch int
+}
+
+func readXcorr(tb testing.TB) []xcorrInput {
+	r := newReader(tb, "xcorr.bin")
+	var inputs []xcorrInput
+	for r.more() {
+		n, maxPitch := int(r.i32()), int(r.i32())
+		c := xcorrInput{x: r.f32s(), y: r.f32s(), maxPitch: maxPitch}
+		if len(c.x) != n || len(c.y) != n+maxPitch {
+			tb.Fatalf("xcorr.bin is broken")
+		}
+		inputs = append(inputs, c)
+	}
+	return inputs
+}
+
+func TestPitchXcorr(t *testing.T) {
+	for i, c := range readXcorr(t) {
+		want := make([]float32, c.maxPitch)
+		PitchXcorr(Scalar, c.x, c.y, want)
+		got := make([]float32, c.maxPitch)
+		PitchXcorr(Vectorized, c.x, c.y, got)
+		if !same(got, want) {
+			t.Errorf("input %d (len: %d, max_pitch: %d): the vectorized correlation differs from the scalar one", i, len(c.x), c.maxPitch)
+		}
+	}
+}
+
+func BenchmarkPitchXcorr(b *testing.B) {
+	inputs := readXcorr(b)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			xcorr := make([]float32, 1024)
+			for i := range b.N {
+				c := inputs[i%len(inputs)]
+				PitchXcorr(v, c.x, c.y, xcorr[:c.maxPitch])
+			}
+		})
+	}
+}
+
+type combInput struct {
+	t0, t1, n        int
+	g0, g1           float32
+	tapset0, tapset1 int
+	overlap          int
+	x                []float32
+}
+
+func (c *combInput) start() int {
+	return max(c.t0, c.t1) + 2
+}
+
+func readComb(tb testing.TB) []combInput {
+	r := newReader(tb, "comb.bin")
+	var inputs []combInput
+	for r.more() {
+		c := combInput{
+			t0:      int(r.i32()),
+			t1:      int(r.i32()),
+			n:       int(r.i32()),
+			g0:      r.f32(),
+			g1:      r.f32(),
+			tapset0: int(r.i32()),
+			tapset1: int(r.i32()),
+			overlap: int(r.i32()),
+			x:       r.f32s(),
+		}
+		if len(c.x) != c.start()+c.n {
+			tb.Fatalf("comb.bin is broken")
+		}
+		inputs = append(inputs, c)
+	}
+	return inputs
+}
+
+func (c *combInput) filter(v Variant, x []float32) {
+	CombFilter(v, x, c.start(), c.t0, c.t1, c.n, c.g0, c.g1, c.tapset0, c.tapset1, c.overlap)
+}
+
+func TestCombFilter(t *testing.T) {
+	for i, c := range readComb(t) {
+		want := append([]float32(nil), c.x...)
+		c.filter(Scalar, want)
+		got := append([]float32(nil), c.x...)
+		c.filter(Vectorized, got)
+		if !same(got, want) {
+			t.Errorf("input %d (T0: %d, T1: %d, N: %d): the vectorized comb filter differs from the scalar one", i, c.t0, c.t1, c.n)
+		}
+	}
+}
+
+func BenchmarkCombFilter(b *testing.B) {
+	inputs := readComb(b)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			x := make([]float32, 2048)
+			for i := range b.N {
+				c := &inputs[i%len(inputs)]
+				copy(x, c.x)
+				c.filter(v, x[:len(c.x)])
+			}
+		})
+	}
+}
+
+func readSILK(tb testing.TB) []SILKFrame {
+	r := newReader(tb, "silk.bin")
+	var frames []SILKFrame
+	for r.more() {
+		var f SILKFrame
+		for _, p := range []*int32{
+			&f.FrameLength, &f.SubfrLength, &f.NbSubfr, &f.LPCOrder, &f.LTPMemLength,
+			&f.SignalType, &f.QuantOffsetType, &f.NLSFInterpCoefQ2, &f.Seed,
+			&f.LagPrev, &f.PrevSignalType, &f.LossCnt, &f.PrevGainQ16,
+		} {
+			*p = r.i32()
+		}
+		ok := copy(f.SLPCQ14Buf[:], r.i32s()) == len(f.SLPCQ14Buf)
+		ok = ok && copy(f.OutBuf[:], r.i16s()) == int(f.LTPMemLength)
+		pred := r.i16s()
+		ok = ok && len(pred) == 2*len(f.PredCoefQ12[0])
+		copy(f.PredCoefQ12[0][:], pred)
+		copy(f.PredCoefQ12[1][:], pred[min(len(pred), len(f.PredCoefQ12[0])):])
+		ok = ok && copy(f.LTPCoefQ14[:], r.i16s()) == len(f.LTPCoefQ14)
+		ok = ok && copy(f.PitchL[:], r.i32s()) == len(f.PitchL)
+		ok = ok && copy(f.GainsQ16[:], r.i32s()) == len(f.GainsQ16)
+		f.LTPScaleQ14 = r.i32()
+		ok = ok && copy(f.Pulses[:], r.i16s()) == int(f.FrameLength)
+		if !ok {
+			tb.Fatalf("silk.bin is broken")
+		}
+		frames = append(frames, f)
+	}
+	return frames
+}
+
+func TestSILKDecodeCore(t *testing.T) {
+	for i, f := range readSILK(t) {
+		want, wantf := make([]int16, f.FrameLength), f
+		SILKDecodeCore(Scalar, &wantf, want)
+		got, gotf := make([]int16, f.FrameLength), f
+		SILKDecodeCore(Vectorized, &gotf, got)
+		// The SILK decoder is in fixed point, so the variants must be bit-exact.
+		for j := range got {
+			if got[j] != want[j] {
+				t.Errorf("input %d: xq[%d]: got: %d, want: %d", i, j, got[j], want[j])
+				break
+			}
+		}
+		if gotf.SLPCQ14Buf != wantf.SLPCQ14Buf {
+			t.Errorf("input %d: sLPC_Q14_buf: got: %v, want: %v", i, gotf.SLPCQ14Buf, wantf.SLPCQ14Buf)
+		}
+	}
+}
+
+func BenchmarkSILKDecodeCore(b *testing.B) {
+	frames := readSILK(b)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			var f SILKFrame
+			xq := make([]int16, 320)
+			for i := range b.N {
+				f = frames[i%len(frames)]
+				SILKDecodeCore(v, &f, xq)
+			}
+		})
+	}
+}
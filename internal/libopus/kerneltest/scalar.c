@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo && !opusfixed
+
+// This file is not a part of libopus. This compiles the kernels as the scalar references of the vectorized ones:
+// celt_simd.h and silk_simd.h see neither SSE2 nor NEON, celt_specialize.h is skipped so that the IMDCT takes the
+// generic sizes and opus_fft_impl, and GCC doesn't auto-vectorize the loops. Clang has no pragma for the last, so
+// its references can still be auto-vectorized.
+
+#undef __SSE2__
+#undef __ARM_NEON
+#define CELT_SPECIALIZE_H
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("no-tree-vectorize")
+#endif
+
+#define KERNEL(name) scalar_##name
+#include "kernels.inc"
@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /* Copyright (c) 2008-2011 Octasic Inc.
                  2012-2017 Jean-Marc Valin */
 /*
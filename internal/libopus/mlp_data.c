@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /*This file is automatically generated from a Keras model*/
 
 #ifdef HAVE_CONFIG_H
@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libopus
+
+// #include "opus.h"
+// #include "opus_private.h"
+//
+// // opus_ms_stream_decode decodes the packet of a stream of a multistream packet as opus_multistream_decode_float
+// // does with the stream's decoder. The packets of the streams but the last are self-delimited.
+// static int opus_ms_stream_decode(OpusDecoder* st, const unsigned char* data, opus_int32 len, float* pcm, int frame_size, int channels, int decode_fec, int self_delimited) {
+//   opus_int32 packet_offset = 0;
+// #ifdef FIXED_POINT
+//   opus_int16 buf[5760*2];
+//   int n;
+//   frame_size = frame_size < 5760 ? frame_size : 5760;
+//   n = opus_decode_native(st, data, len, buf, frame_size, decode_fec, self_delimited, &packet_offset, 0, NULL, 0);
+//   if (n > 0) {
+//     for (int i = 0; i < n*channels; i++) {
+//       pcm[i] = (1.f/32768.f)*buf[i];
+//     }
+//   }
+//   return n;
+// #else
+//   (void)channels;
+//   return opus_decode_native(st, data, len, pcm, frame_size, decode_fec, self_delimited, &packet_offset, 0, NULL, 0);
+// #endif
+// }
+//
+// // opus_ms_stream_decode_float_batch decodes the packets of the stream s of count multistream packets of streams
+// // streams, as DEFINE_DECODE_FLOAT_BATCH does with the stream's decoder. A packet of the length 0 is concealed. The
+// // stream's decoder is void*, as the ones of DEFINE_DECODE_FLOAT_BATCH are.
+// static int opus_ms_stream_decode_float_batch(void* d, const unsigned char* data, const opus_int32* lens, int count, int s, int streams, float* pcm, int frame_size, int channels, int decode_fec, int* out) {
+//   OpusDecoder* st = d;
+//   int total = 0;
+//   int i;
+//   for (i = 0; i < count; i++) {
+//     if (i > 0 && total >= frame_size) break;
+//     const unsigned char* p = data;
+//     opus_int32 len = lens[i];
+//     int n = 0;
+//     // The packets of the streams before s are skipped.
+//     for (int j = 0; j < s && len > 0; j++) {
+//       unsigned char toc;
+//       opus_int16 size[48];
+//       opus_int32 packet_offset;
+//       n = opus_packet_parse_impl(p, len, 1, &toc, NULL, size, NULL, &packet_offset, NULL, NULL);
+//       if (n < 0) break;
+//       p += packet_offset;
+//       len -= packet_offset;
+//     }
+//     if (n >= 0 && lens[i] > 0 && len <= 0) n = OPUS_INVALID_PACKET;
+//     if (n >= 0) {
+//       n = opus_ms_stream_decode(st, p, len, pcm + total*channels, frame_size - total, channels, decode_fec, s != streams-1);
+//     }
+//     if (i > 0 && n == OPUS_BUFFER_TOO_SMALL) break;
+//     out[i] = n;
+//     data += lens[i];
+//     if (n > 0) total += n;
+//   }
+//   return i;
+// }
+import "C"
+
+import (
+	"runtime"
+	"slices"
+	"sync"
+	"unsafe"
+)
+
+// ParallelMSDecoder is a multistream decoder that decodes the streams of a packet in parallel, each with its own
+// Decoder on its own goroutine, and maps the decoded channels to the output as MSDecoder does. For 5.1, 7.1 or
+// ambisonics, this lowers the time to decode a packet at the cost of a thread for each stream while decoding.
+//
+// The output is the same as MSDecoder's. When a stream of a packet is broken, the other streams are still decoded,
+// while MSDecoder stops at the broken stream.
+type ParallelMSDecoder struct {
+	fs       int
+	channels int
+	mapping  []byte
+	coupled  int
+	streams  []*parallelStream
+	batch    packetBatch
+}
+
+// parallelStream is a stream of a ParallelMSDecoder.
+type parallelStream struct {
+	decoder *Decoder
+
+	// pcm is the decoded PCM of the stream, and out and n are the result of opus_ms_stream_decode_float_batch.
+	pcm []float32
+	out []C.int
+	n   int
+}
+
+// ParallelMSDecoderCreate creates a ParallelMSDecoder with the arguments of MSDecoderCreate.
+func ParallelMSDecoderCreate(Fs int, channels int, streams int, coupledStreams int, mapping []byte) (*ParallelMSDecoder, error) {
+	if channels < 1 || channels > 255 || streams < 1 || coupledStreams < 0 || coupledStreams > streams || streams+coupledStreams > 255 || len(mapping) != channels {
+		return nil, ErrBadArg
+	}
+	for _, m := range mapping {
+		if m != 255 && int(m) >= streams+coupledStreams {
+			return nil, ErrBadArg
+		}
+	}
+	d := &ParallelMSDecoder{
+		fs:       Fs,
+		channels: channels,
+		mapping:  slices.Clone(mapping),
+		coupled:  coupledStreams,
+	}
+	for s := range streams {
+		c := 1
+		if s < coupledStreams {
+			c = 2
+		}
+		dec, err := DecoderCreate(Fs, c)
+		if err != nil {
+			d.Destroy()
+			return nil, err
+		}
+		d.streams = append(d.streams, &parallelStream{decoder: dec})
+	}
+	runtime.SetFinalizer(d, (*ParallelMSDecoder).Destroy)
+	return d, nil
+}
+
+// DecodeFloat decodes data into the interleaved samples pcm, and returns the number of decoded samples per channel.
+func (d *ParallelMSDecoder) DecodeFloat(data []byte, pcm []float32, decodeFec int) int {
+	// As opus_multistream_decode_float, at most 120 milliseconds are decoded at once.
+	pcm = pcm[:min(len(pcm), d.fs/25*3*d.channels)]
+	counts := d.decode([][]byte{data}, pcm, decodeFec)
+	if len(counts) == 0 {
+		return int(ErrBufferTooSmall)
+	}
+	return counts[0]
+}
+
+// DecodeFloatBatch decodes the packets into the interleaved samples pcm one after another, as MSDecoder's
+// DecodeFloatBatch does. Each stream decodes its part of all the packets in one cgo call.
+func (d *ParallelMSDecoder) DecodeFloatBatch(packets [][]byte, pcm []float32) []int {
+	if len(packets) == 0 {
+		return nil
+	}
+	return d.decode(packets, pcm, 0)
+}
+
+func (d *ParallelMSDecoder) decode(packets [][]byte, pcm []float32, decodeFec int) []int {
+	defer runtime.KeepAlive(d)
+	d.batch.prepare(packets)
+	frameSize := len(pcm) / d.channels
+
+	// The last stream is decoded on this goroutine.
+	var wg sync.WaitGroup
+	for s := range len(d.streams) - 1 {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			d.decodeStream(s, len(packets), frameSize, decodeFec)
+		}()
+	}
+	d.decodeStream(len(d.streams)-1, len(packets), frameSize, decodeFec)
+	wg.Wait()
+
+	// A packet is decoded only if all its streams are decoded to the same number of the samples.
+	n := len(packets)
+	for _, st := range d.streams {
+		n = min(n, st.n)
+	}
+	offsets := make([]int, len(d.streams))
+	counts := d.batch.counts[:0]
+	var total int
+	for i := range n {
+		count := int(d.streams[0].out[i])
+		for _, st := range d.streams[1:] {
+			if c := int(st.out[i]); c != count {
+				if c < 0 {
+					count = c
+				} else if count > 0 {
+					count = int(ErrInvalidPacket)
+				}
+			}
+		}
+		if count > 0 {
+			d.mapChannels(pcm[total*d.channels:], offsets, count)
+			total += count
+		}
+		for s, st := range d.streams {
+			offsets[s] += max(int(st.out[i]), 0)
+		}
+		counts = append(counts, count)
+	}
+	d.batch.counts = counts
+	return counts
+}
+
+// decodeStream decodes the stream s of the packets in d.batch.
+func (d *ParallelMSDecoder) decodeStream(s int, count int, frameSize int, decodeFec int) {
+	st := d.streams[s]
+	channels := st.decoder.channels
+	st.pcm = slices.Grow(st.pcm[:0], frameSize*channels)[:frameSize*channels]
+	st.out = slices.Grow(st.out[:0], count)[:count]
+	n := C.opus_ms_stream_decode_float_batch(
+		unsafe.Pointer(st.decoder.decoder),
+		(*C.uchar)(unsafe.Pointer(unsafe.SliceData(d.batch.data))),
+		(*C.opus_int32)(unsafe.Pointer(unsafe.SliceData(d.batch.lens))),
+		C.int(count),
+		C.int(s),
+		C.int(len(d.streams)),
+		(*C.float)(unsafe.Pointer(unsafe.SliceData(st.pcm))),
+		C.int(frameSize),
+		C.int(channels),
+		C.int(decodeFec),
+		(*C.int)(unsafe.Pointer(unsafe.SliceData(st.out))))
+	st.n = int(n)
+}
+
+// mapChannels writes frames frames of the streams at offsets to the interleaved samples pcm by the channel mapping.
+// A decoded channel of a coupled stream is 2*s or 2*s+1, and of a mono stream is s plus the number of the coupled
+// streams. The channels mapped to 255 are silent.
+func (d *ParallelMSDecoder) mapChannels(pcm []float32, offsets []int, frames int) {
+	for c, m := range d.mapping {
+		if m == 255 {
+			for i := range frames {
+				pcm[i*d.channels+c] = 0
+			}
+			continue
+		}
+		s, sc := int(m)/2, int(m)%2
+		if int(m) >= 2*d.coupled {
+			s, sc = int(m)-d.coupled, 0
+		}
+		st := d.streams[s]
+		channels := st.decoder.channels
+		src := st.pcm[offsets[s]*channels+sc:]
+		for i := range frames {
+			pcm[i*d.channels+c] = src[i*channels]
+		}
+	}
+}
+
+// ResetState resets the decoder state as if the decoder were freshly created, without reallocating it.
+func (d *ParallelMSDecoder) ResetState() error {
+	for _, st := range d.streams {
+		if err := st.decoder.ResetState(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// SetGain sets the gain applied to the decoded output, in Q7.8 dB.
+func (d *ParallelMSDecoder) SetGain(gain int) error {
+	for _, st := range d.streams {
+		if err := st.decoder.SetGain(gain); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Destroy frees the decoders of the streams. Destroy is called when d is finalized, and can be called more than once.
+func (d *ParallelMSDecoder) Destroy() {
+	for _, st := range d.streams {
+		st.decoder.Destroy()
+	}
+	d.streams = nil
+	runtime.SetFinalizer(d, nil)
+}
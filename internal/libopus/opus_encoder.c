@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /* Copyright (c) 2010-2011 Xiph.Org Foundation, Skype Limited
    Written by Jean-Marc Valin and Koen Vos */
 /*
@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /* Copyright (c) 2011 Xiph.Org Foundation
    Written by Jean-Marc Valin */
 /*
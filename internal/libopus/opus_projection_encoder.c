@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /* Copyright (c) 2017 Google Inc.
    Written by Andrew Allen */
 /*
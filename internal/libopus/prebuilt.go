@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayerprebuilt
+
+package libopus
+
+// With the build tag webmplayerprebuilt, the C files are not compiled, and the objects in the prebuilt directory are
+// linked instead. The objects are built by 'go run gen.go -prebuilt GOOS/GOARCH,...' without any build tags, so the
+// other build tags of the C files, e.g. opusfixed, don't apply to them.
+
+import _ "github.com/hajimehoshi/webmplayer/internal/libopus/prebuilt"
@@ -0,0 +1,6 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// Package prebuilt has the objects of the C files of the parent package for each platform, named libopus_GOOS_GOARCH.syso.
+// The parent package links them with the build tag webmplayerprebuilt.
+package prebuilt
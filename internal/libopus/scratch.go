@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build opusscratch
+
+package libopus
+
+// With the build tag opusscratch, libopus allocates its temporaries from a scratch buffer of GLOBAL_STACK_SIZE bytes
+// instead of alloca. The buffer is allocated once per thread on its first use and reused for all the packets and
+// the decoders on the thread, so the memory doesn't grow with the number of the decoders and stays warm in the
+// cache.
+
+// #cgo CFLAGS: -DNONTHREADSAFE_PSEUDOSTACK
+import "C"
@@ -1,3 +1,5 @@
+//go:build webmplayer_encoder
+
 /***********************************************************************
 Copyright (c) 2006-2011, Skype Limited. All rights reserved.
 Redistribution and use in source and binary forms, with or without
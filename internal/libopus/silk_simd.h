@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libopus. This defines the vectorized kernels of the SILK decoder and its resampler used
+// from the patched libopus sources, as celt_simd.h does for the CELT decoder.
+//
+// The kernels use the GCC/Clang vector extensions, which are lowered to SSE2 on amd64 and to NEON on arm64.
+// Both are available on every CPU of the architectures, so no runtime detection is needed. SILK is fixed point in
+// both the float and the fixed-point builds, so the kernels are used by both.
+//
+// silk_SMULWB is computed with its 32-bit form in silk_macros.h, which is exactly the same as the 64-bit form. The
+// terms of a sum are the same as the original loop's, and the sum is the same in any order in the two's complement,
+// so the output is the same.
+//
+// silk_resampler_private_up2_HQ is not vectorized. Its only independent chains are of the even and the odd samples,
+// and two lanes were slower than the scalar loop.
+
+#ifndef SILK_SIMD_H
+#define SILK_SIMD_H
+
+#include "silk_SigProc_FIX.h"
+#include "silk_define.h"
+#include "silk_resampler_rom.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define SILK_SIMD
+#endif
+
+#ifdef SILK_SIMD
+
+typedef opus_int32 silk_v4si __attribute__((vector_size(16)));
+typedef opus_int32 silk_v4si_u __attribute__((vector_size(16), aligned(4)));
+
+static OPUS_INLINE silk_v4si silk_load4(const opus_int32 *p)
+{
+   return *(const silk_v4si_u *)p;
+}
+
+static OPUS_INLINE void silk_store4(opus_int32 *p, silk_v4si v)
+{
+   *(silk_v4si_u *)p = v;
+}
+
+#ifdef __SSE2__
+
+/* SSE2 has no multiplication of 32-bit lanes, so the products are of the 16-bit halves with pmulhw and pmaddwd. */
+
+#include <emmintrin.h>
+
+/* The coefficients of silk_SMULWB4: the 16-bit halves of each 32-bit lane are { b, 0 } in b0 and { 1, b } in b1. */
+typedef struct {
+   __m128i b0;
+   __m128i b1;
+} silk_SMULWB4_coefs;
+
+static OPUS_INLINE silk_SMULWB4_coefs silk_SMULWB4_init(silk_v4si b)
+{
+   silk_SMULWB4_coefs c;
+   c.b0 = _mm_and_si128((__m128i)b, _mm_set1_epi32(0xFFFF));
+   c.b1 = _mm_or_si128(_mm_slli_epi32((__m128i)b, 16), _mm_set1_epi32(1));
+   return c;
+}
+
+/* silk_SMULWB of each lane: (a >> 16) * b + (((a & 0xFFFF) * b) >> 16). The second term is the signed high half of
+   the product of the low halves, corrected for the low half being unsigned. */
+static OPUS_INLINE silk_v4si silk_SMULWB4(silk_v4si a, const silk_SMULWB4_coefs *c)
+{
+   __m128i s = (__m128i)a;
+   __m128i t = _mm_add_epi16(_mm_mulhi_epi16(s, c->b0), _mm_and_si128(_mm_srai_epi16(s, 15), c->b0));
+   __m128i u = _mm_or_si128(_mm_and_si128(s, _mm_set1_epi32((opus_int32)0xFFFF0000)), t);
+   return (silk_v4si)_mm_madd_epi16(u, c->b1);
+}
+
+#else
+
+typedef struct {
+   silk_v4si b;
+} silk_SMULWB4_coefs;
+
+static OPUS_INLINE silk_SMULWB4_coefs silk_SMULWB4_init(silk_v4si b)
+{
+   silk_SMULWB4_coefs c;
+   c.b = b;
+   return c;
+}
+
+/* silk_SMULWB of each lane, with the 32-bit form of silk_macros.h. */
+static OPUS_INLINE silk_v4si silk_SMULWB4(silk_v4si a, const silk_SMULWB4_coefs *c)
+{
+   return (a >> 16) * c->b + (((a & 0xFFFF) * c->b) >> 16);
+}
+
+#endif
+
+/* The coefficients of the short-term prediction of silk_decode_core for silk_LPC_pred_simd: A_Q12 in reverse order,
+   padded with zeros before to a multiple of 4. Returns the number of the vectors. */
+static OPUS_INLINE int silk_LPC_coefs_simd(silk_SMULWB4_coefs A_rev[ MAX_LPC_ORDER / 4 ], const opus_int16 *A_Q12,
+      int order)
+{
+   int i, j, n4 = (order + 3) / 4;
+   for (i = 0; i < n4; i++)
+   {
+      silk_v4si b;
+      for (j = 0; j < 4; j++)
+      {
+         int k = 4 * n4 - 1 - (4 * i + j);
+         b[ j ] = k < order ? A_Q12[ k ] : 0;
+      }
+      A_rev[ i ] = silk_SMULWB4_init(b);
+   }
+   return n4;
+}
+
+/* LPC_pred_Q10 of silk_decode_core: silk_SMLAWB of s[-1-j] and A_Q12[j] for each j, added to acc. */
+static OPUS_INLINE opus_int32 silk_LPC_pred_simd(const opus_int32 *s, const silk_SMULWB4_coefs *A_rev, int n4,
+      opus_int32 acc)
+{
+   int k;
+   silk_v4si sum;
+   s -= 4 * n4;
+   sum = silk_SMULWB4(silk_load4(s), &A_rev[ 0 ]);
+   for (k = 1; k < n4; k++)
+      sum += silk_SMULWB4(silk_load4(s + 4 * k), &A_rev[ k ]);
+   return acc + sum[ 0 ] + sum[ 1 ] + sum[ 2 ] + sum[ 3 ];
+}
+
+/* The coefficients of the long-term prediction of silk_decode_core for silk_LTP_pred4_simd. */
+static OPUS_INLINE void silk_LTP_coefs_simd(silk_SMULWB4_coefs B[ LTP_ORDER ], const opus_int16 *B_Q14)
+{
+   int j;
+   for (j = 0; j < LTP_ORDER; j++)
+      B[ j ] = silk_SMULWB4_init((silk_v4si){ B_Q14[ j ], B_Q14[ j ], B_Q14[ j ], B_Q14[ j ] });
+}
+
+/* The long-term prediction of silk_decode_core for 4 samples. pred must be at least 4 samples before sLTP_Q15, so
+   that the samples read are written before. */
+static OPUS_INLINE void silk_LTP_pred4_simd(opus_int32 *pres_Q14, const opus_int32 *pexc_Q14, opus_int32 *sLTP_Q15,
+      const opus_int32 *pred, const silk_SMULWB4_coefs *B)
+{
+   silk_v4si LTP_pred_Q13 = { 2, 2, 2, 2 };
+   silk_v4si res;
+   int j;
+   for (j = 0; j < LTP_ORDER; j++)
+      LTP_pred_Q13 += silk_SMULWB4(silk_load4(pred - j), &B[ j ]);
+   res = silk_load4(pexc_Q14) + (LTP_pred_Q13 << 1);
+   silk_store4(pres_Q14, res);
+   silk_store4(sLTP_Q15, res << 1);
+}
+
+typedef opus_int16 silk_v8hi __attribute__((vector_size(16)));
+typedef opus_int16 silk_v8hi_u __attribute__((vector_size(16), aligned(2)));
+
+/* The rows of the 8-tap interpolation filter of silk_resampler_private_IIR_FIR_INTERPOL, for
+   silk_resampler_FIR_12_simd: the row i is silk_resampler_frac_FIR_12[i] and silk_resampler_frac_FIR_12[11-i] in
+   reverse order. */
+static OPUS_INLINE void silk_resampler_FIR_12_rows_simd(silk_v8hi rows[ 12 ])
+{
+   int i, j;
+   for (i = 0; i < 12; i++)
+   {
+      for (j = 0; j < RESAMPLER_ORDER_FIR_12 / 2; j++)
+      {
+         rows[ i ][ j ] = silk_resampler_frac_FIR_12[ i ][ j ];
+         rows[ i ][ RESAMPLER_ORDER_FIR_12 - 1 - j ] = silk_resampler_frac_FIR_12[ 11 - i ][ j ];
+      }
+   }
+}
+
+/* An output sample of silk_resampler_private_IIR_FIR_INTERPOL: the 8 samples at buf filtered by row. */
+static OPUS_INLINE opus_int16 silk_resampler_FIR_12_simd(const opus_int16 *buf, const silk_v8hi *row)
+{
+   silk_v4si s;
+   opus_int32 res_Q15;
+#ifdef __SSE2__
+   s = (silk_v4si)_mm_madd_epi16(_mm_loadu_si128((const __m128i *)buf), (__m128i)*row);
+#else
+   silk_v8hi x = *(const silk_v8hi_u *)buf;
+   silk_v4si lo = { x[ 0 ], x[ 1 ], x[ 2 ], x[ 3 ] };
+   silk_v4si hi = { x[ 4 ], x[ 5 ], x[ 6 ], x[ 7 ] };
+   silk_v4si rlo = { (*row)[ 0 ], (*row)[ 1 ], (*row)[ 2 ], (*row)[ 3 ] };
+   silk_v4si rhi = { (*row)[ 4 ], (*row)[ 5 ], (*row)[ 6 ], (*row)[ 7 ] };
+   s = lo * rlo + hi * rhi;
+#endif
+   res_Q15 = s[ 0 ] + s[ 1 ] + s[ 2 ] + s[ 3 ];
+   return (opus_int16)silk_SAT16( silk_RSHIFT_ROUND( res_Q15, 15 ) );
+}
+
+#endif /* SILK_SIMD */
+
+#endif /* SILK_SIMD_H */
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !cgo
+
+package libopus
+
+// MapStereo maps the interleaved samples src of channels channels to the interleaved stereo samples dst, as the
+// MapStereo with cgo does.
+func MapStereo(dst []float32, src []float32, channels int, matrix []float32) int {
+	if matrix != nil {
+		if len(matrix) != 2*channels {
+			panic("libopus: the matrix size doesn't match with the channel count")
+		}
+	} else if channels != 1 && channels != 2 {
+		panic("libopus: a matrix is required for more than two channels")
+	}
+	n := min(len(dst)/2, len(src)/channels)
+	switch {
+	case matrix != nil:
+		// The frames are mixed forward, where a frame is written only after the frame is read.
+		for i := range n {
+			s := src[i*channels : (i+1)*channels]
+			var l, r float32
+			for c, v := range s {
+				l += v * matrix[2*c]
+				r += v * matrix[2*c+1]
+			}
+			dst[2*i] = l
+			dst[2*i+1] = r
+		}
+	case channels == 1:
+		// Mono is duplicated backward, where the output never overtakes the input.
+		for i := n - 1; i >= 0; i-- {
+			v := src[i]
+			dst[2*i] = v
+			dst[2*i+1] = v
+		}
+	default:
+		copy(dst[:2*n], src[:2*n])
+	}
+	return n
+}
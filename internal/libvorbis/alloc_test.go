@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libvorbis
+
+import (
+	"testing"
+)
+
+func TestSynthesisBatchAllocs(t *testing.T) {
+	const batch = 4
+	packets := readPackets(t, "stereo.packets")
+	audio := packets[3:]
+	dst := make([]float32, 2*batch*4096)
+	// The matrix swaps the channels, so that the downmix is run without changing the levels.
+	matrix := []float32{0, 1, 1, 0}
+	source := make([]float32, len(dst))
+
+	for _, m := range []struct {
+		name   string
+		matrix []float32
+		source []float32
+	}{
+		{name: "stereo"},
+		{name: "downmix", matrix: matrix, source: source},
+	} {
+		t.Run(m.name, func(t *testing.T) {
+			vi, vd, vb := synthesisInit(t, packets)
+			defer vi.Clear()
+			defer vd.Clear()
+			defer vb.Clear()
+
+			var skip int
+			var pcm [][]float32
+			var i int
+			if a := testing.AllocsPerRun(len(audio)/batch-1, func() {
+				if _, _, err := SynthesisBatch(vd, vb, audio[i*batch:(i+1)*batch], dst, m.matrix, m.source, &skip); err != nil {
+					t.Fatal(err)
+				}
+				i++
+				// The PCM that doesn't fit in dst is left in vd.
+				pcm = SynthesisPcmoutView(vd, pcm)
+				if len(pcm) > 0 {
+					if err := SynthesisRead(vd, len(pcm[0])); err != nil {
+						t.Fatal(err)
+					}
+				}
+			}); a > 0 {
+				t.Errorf("allocations per batch: got %v, want 0", a)
+			}
+		})
+	}
+}
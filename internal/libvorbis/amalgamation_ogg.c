@@ -0,0 +1,6 @@
+// Code generated by cgen. DO NOT EDIT.
+
+//go:build !webmplayerprebuilt
+
+#include "bitwise.inc"
+#include "framing.inc"
@@ -0,0 +1,20 @@
+// Code generated by cgen. DO NOT EDIT.
+
+//go:build !webmplayerprebuilt
+
+#include "bitrate.inc"
+#include "block.inc"
+#include "codebook.inc"
+#include "envelope.inc"
+#include "floor0.inc"
+#include "floor1.inc"
+#include "info.inc"
+#include "lookup.inc"
+#include "lpc.inc"
+#include "lsp.inc"
+#include "mdct.inc"
+#include "registry.inc"
+#include "res0.inc"
+#include "smallft.inc"
+#include "synthesis.inc"
+#include "window.inc"
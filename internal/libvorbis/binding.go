@@ -7,11 +7,216 @@ package libvorbis
 
 // #include <stdlib.h>
 // #include "vorbis_codec.h"
+//
+// // vorbis_synthesis_pcmout_stereo moves at most frames frames of the decoded PCM to dst as interleaved stereo samples.
+// // Mono is duplicated to both channels, and channels after the second are ignored.
+// static int vorbis_synthesis_pcmout_stereo(vorbis_dsp_state* v, float* dst, int frames) {
+//   float** pcm;
+//   int n = vorbis_synthesis_pcmout(v, &pcm);
+//   if (n > frames) {
+//     n = frames;
+//   }
+//   if (n <= 0) {
+//     return 0;
+//   }
+//   const float* l = pcm[0];
+//   const float* r = v->vi->channels == 1 ? pcm[0] : pcm[1];
+//   for (int i = 0; i < n; i++) {
+//     dst[2*i] = l[i];
+//     dst[2*i+1] = r[i];
+//   }
+//   vorbis_synthesis_read(v, n);
+//   return n;
+// }
+//
+// // vorbis_synthesis_pcmout_downmix is like vorbis_synthesis_pcmout_stereo, but mixes all the channels with matrix.
+// // matrix has the gains of the left and the right output for each input channel. If source is not NULL, the
+// // channels of the moved frames are also copied to source as interleaved samples before they are mixed.
+// static int vorbis_synthesis_pcmout_downmix(vorbis_dsp_state* v, float* dst, int frames, const float* matrix, float* source) {
+//   float** pcm;
+//   int n = vorbis_synthesis_pcmout(v, &pcm);
+//   if (n > frames) {
+//     n = frames;
+//   }
+//   if (n <= 0) {
+//     return 0;
+//   }
+//   for (int i = 0; i < n; i++) {
+//     dst[2*i] = 0;
+//     dst[2*i+1] = 0;
+//   }
+//   const int channels = v->vi->channels;
+//   for (int c = 0; c < channels; c++) {
+//     const float* src = pcm[c];
+//     const float l = matrix[2*c];
+//     const float r = matrix[2*c+1];
+//     for (int i = 0; i < n; i++) {
+//       dst[2*i] += src[i] * l;
+//       dst[2*i+1] += src[i] * r;
+//     }
+//     if (source) {
+//       for (int i = 0; i < n; i++) {
+//         source[i*channels+c] = src[i];
+//       }
+//     }
+//   }
+//   vorbis_synthesis_read(v, n);
+//   return n;
+// }
+//
+// // vorbis_synthesis_batch moves the decoded PCM to dst as vorbis_synthesis_pcmout_stereo does, or as
+// // vorbis_synthesis_pcmout_downmix does with source if matrix is not NULL, and decodes the next packet while dst has
+// // room.
+// // The count packets are concatenated in data, and lens has their sizes. skip is the number of the frames to
+// // discard before moving, and is updated. consumed and written are set to the number of the decoded packets and
+// // the number of the moved frames. vorbis_synthesis_batch returns the error of the last decoded packet, if any.
+// //
+// // While no block has been decoded since the restart, e.g. after a seek, a packet is only tracked by
+// // vorbis_synthesis_trackonly if the frames of it and the next packet are all skipped. The next packet is then
+// // decoded as the first one, which has no output, and the frames that the two would have made are counted against
+// // skip, so the output after skip is the same as decoding all the packets.
+// //
+// // With vorbis_synthesis_defer_channels, vorbis_synthesis_batch returns VORBIS_SYNTHESIS_DEFERRED after a packet
+// // whose channels are left to vorbis_synthesis_channels. The batch continues by calling vorbis_synthesis_batch again
+// // with the rest of the packets and resume, which puts the block in first.
+// #define VORBIS_SYNTHESIS_DEFERRED 1
+// static int vorbis_synthesis_batch(vorbis_dsp_state* v, vorbis_block* vb, const unsigned char* data, const long* lens, int count, float* dst, int frames, const float* matrix, float* source, int* skip, int* consumed, int* written, int resume) {
+//   int i = 0;
+//   *written = 0;
+//   if (resume) {
+//     int ret = vorbis_synthesis_blockin(v, vb);
+//     if (ret != 0) {
+//       *consumed = 0;
+//       return ret;
+//     }
+//   }
+//   for (;;) {
+//     while (*skip > 0) {
+//       float** pcm;
+//       int n = vorbis_synthesis_pcmout(v, &pcm);
+//       if (n <= 0) {
+//         break;
+//       }
+//       if (n > *skip) {
+//         n = *skip;
+//       }
+//       vorbis_synthesis_read(v, n);
+//       *skip -= n;
+//     }
+//     if (*skip == 0) {
+//       if (matrix) {
+//         float* s = source ? source + v->vi->channels * *written : NULL;
+//         *written += vorbis_synthesis_pcmout_downmix(v, dst + 2 * *written, frames - *written, matrix, s);
+//       } else {
+//         *written += vorbis_synthesis_pcmout_stereo(v, dst + 2 * *written, frames - *written);
+//       }
+//     }
+//     if (*written >= frames || i >= count) {
+//       break;
+//     }
+//     ogg_packet op = {0};
+//     op.packet = (unsigned char*)data;
+//     op.bytes = lens[i];
+//     data += lens[i];
+//     i++;
+//     if (v->pcm_returned == -1 && *skip > 0 && i < count) {
+//       ogg_packet next = {0};
+//       next.packet = (unsigned char*)data;
+//       next.bytes = lens[i];
+//       long n0 = vorbis_packet_blocksize(v->vi, &op);
+//       long n1 = vorbis_packet_blocksize(v->vi, &next);
+//       long n = (n0 / 4 + n1 / 4) >> vorbis_synthesis_halfrate_p(v->vi);
+//       if (n0 > 0 && n1 > 0 && n <= *skip) {
+//         int ret = vorbis_synthesis_trackonly(vb, &op);
+//         if (ret == 0) {
+//           ret = vorbis_synthesis_blockin(v, vb);
+//         }
+//         if (ret != 0) {
+//           *consumed = i;
+//           return ret;
+//         }
+//         *skip -= n;
+//         continue;
+//       }
+//     }
+//     int ret = vorbis_synthesis(vb, &op);
+//     if (ret == 0 && vorbis_synthesis_deferred_p(vb)) {
+//       *consumed = i;
+//       return VORBIS_SYNTHESIS_DEFERRED;
+//     }
+//     if (ret == 0) {
+//       ret = vorbis_synthesis_blockin(v, vb);
+//     }
+//     if (ret != 0) {
+//       *consumed = i;
+//       return ret;
+//     }
+//   }
+//   *consumed = i;
+//   return 0;
+// }
+//
+// // vorbis_block_reserve allocates the local store of vb for the temporaries of synthesizing a long block, so that
+// // libvorbis doesn't chain more storage while decoding. The PCM of a long block for each channel is the largest
+// // part, and the floor and residue work take as much again at most in the common setups. If the estimate is short,
+// // libvorbis still grows the store, and consolidates it at the next block.
+// static void vorbis_block_reserve(vorbis_block* vb) {
+//   vorbis_info* vi = vb->vd->vi;
+//   long bytes = 2 * vi->channels * (vorbis_info_blocksize(vi, 1) * (long)sizeof(float) + 64);
+//   if (vb->localstore || bytes <= 0) {
+//     return;
+//   }
+//   vb->localstore = malloc(bytes);
+//   if (vb->localstore) {
+//     vb->localalloc = bytes;
+//   }
+// }
+//
+// // vorbis_synthesis_headerin_xiph splits the three headers Xiph-laced in data, as the CodecPrivate of Matroska, and
+// // passes them to vorbis_synthesis_headerin. The offset of the setup header is stored in setup.
+// static int vorbis_synthesis_headerin_xiph(vorbis_info* vi, vorbis_comment* vc, unsigned char* data, long size, long* setup) {
+//   if (size < 1 || data[0] != 2) {
+//     return OV_EBADHEADER;
+//   }
+//   long lens[3] = {0, 0, 0};
+//   long offset = 1;
+//   for (int i = 0; i < 2; i++) {
+//     for (;;) {
+//       if (offset >= size) {
+//         return OV_EBADHEADER;
+//       }
+//       unsigned char b = data[offset++];
+//       lens[i] += b;
+//       if (b != 0xff) {
+//         break;
+//       }
+//     }
+//   }
+//   if (lens[0] + lens[1] >= size - offset) {
+//     return OV_EBADHEADER;
+//   }
+//   lens[2] = size - offset - lens[0] - lens[1];
+//   for (int i = 0; i < 3; i++) {
+//     ogg_packet op = {0};
+//     op.packet = data + offset;
+//     op.bytes = lens[i];
+//     op.b_o_s = i == 0;
+//     op.packetno = i;
+//     int ret = vorbis_synthesis_headerin(vi, vc, &op);
+//     if (ret != 0) {
+//       return ret;
+//     }
+//     *setup = offset;
+//     offset += lens[i];
+//   }
+//   return 0;
+// }
 import "C"
 
 import (
 	"fmt"
 	"runtime"
+	"sync"
 	"unsafe"
 )
 
@@ -76,30 +281,54 @@ type OggPacket struct {
 	PacketNo   int64
 }
 
-func (o *OggPacket) c() *C.ogg_packet {
-	cPacket := C.CBytes(o.Packet)
-	c := &C.ogg_packet{
-		packet:     (*C.uchar)(cPacket),
+// c returns a C packet that refers to o.Packet directly.
+// o.Packet is pinned by pinner, so the C packet is valid until pinner is unpinned.
+// libvorbis doesn't retain the packet data after the synthesis and header functions return.
+func (o *OggPacket) c(pinner *runtime.Pinner) *C.ogg_packet {
+	var p *C.uchar
+	if len(o.Packet) > 0 {
+		p = (*C.uchar)(unsafe.Pointer(unsafe.SliceData(o.Packet)))
+		pinner.Pin(p)
+	}
+	return &C.ogg_packet{
+		packet:     p,
 		bytes:      C.long(len(o.Packet)),
 		b_o_s:      C.long(btoi(o.BOS)),
 		e_o_s:      C.long(btoi(o.EOS)),
 		granulepos: C.ogg_int64_t(o.GranulePos),
 		packetno:   C.ogg_int64_t(o.PacketNo),
 	}
-	runtime.SetFinalizer(o, func(o *OggPacket) {
-		C.free(unsafe.Pointer(cPacket))
-	})
-	return c
 }
 
 type Block struct {
 	c *C.vorbis_block
+
+	// vd keeps the DspState alive until the Block is cleared.
+	vd *DspState
+}
+
+// Clear frees the Block. Clear is called when b is finalized, and can be called more than once.
+func (b *Block) Clear() {
+	if b.c == nil {
+		return
+	}
+	C.vorbis_block_clear(b.c)
+	C.free(unsafe.Pointer(b.c))
+	b.c = nil
+	b.vd = nil
+	runtime.SetFinalizer(b, nil)
 }
 
 type Comment struct {
 	c C.vorbis_comment
 }
 
+// Clear frees the comments. Clear is called when c is finalized, and can be called more than once.
+func (c *Comment) Clear() {
+	C.vorbis_comment_clear(&c.c)
+	runtime.SetFinalizer(c, nil)
+}
+
 func (c *Comment) UserComments() []string {
 	cUserComments := unsafe.Slice((**C.char)(unsafe.Pointer(c.c.user_comments)), c.c.comments)
 	commentLengths := unsafe.Slice((*C.int)(unsafe.Pointer(c.c.comment_lengths)), c.c.comments)
@@ -118,10 +347,50 @@ func (c *Comment) Vendor() string {
 
 type DspState struct {
 	c *C.vorbis_dsp_state
+
+	// vi keeps the Info alive until the DspState is cleared, as vorbis_dsp_clear refers to it.
+	vi *Info
+
+	// batchData and batchLens are the buffers for SynthesisBatch.
+	batchData []byte
+	batchLens []C.long
+
+	// out is where the C functions write their results through the pointers. A local variable whose pointer is
+	// passed to C is allocated on the heap, while out is a part of the DspState.
+	out struct {
+		pcm      **C.float
+		skip     C.int
+		consumed C.int
+		written  C.int
+	}
+}
+
+// Clear frees the DspState. Clear is called when d is finalized, and can be called more than once.
+// The Blocks of d must be cleared before d.
+func (d *DspState) Clear() {
+	if d.c == nil {
+		return
+	}
+	C.vorbis_dsp_clear(d.c)
+	C.free(unsafe.Pointer(d.c))
+	d.c = nil
+	d.vi = nil
+	runtime.SetFinalizer(d, nil)
 }
 
 type Info struct {
 	c C.vorbis_info
+
+	// books is the decoded codebooks that i shares with the other Infos of the same setup header.
+	books *sharedBooks
+}
+
+// Clear frees the codec setup of the Info. Clear is called when i is finalized, and can be called more than once.
+// The DspStates of i must be cleared before i.
+func (i *Info) Clear() {
+	i.releaseBooks()
+	C.vorbis_info_clear(&i.c)
+	runtime.SetFinalizer(i, nil)
 }
 
 func (i *Info) Channels() int {
@@ -132,19 +401,30 @@ func (i *Info) Rate() int {
 	return int(i.c.rate)
 }
 
+// BlockSize returns the size of the short block (zo = 0) or the long block (zo = 1).
+func (i *Info) BlockSize(zo int) int {
+	return int(C.vorbis_info_blocksize(&i.c, C.int(zo)))
+}
+
 func InfoInit() *Info {
 	var cInfo C.vorbis_info
 	C.vorbis_info_init(&cInfo)
-	return &Info{c: cInfo}
+	i := &Info{c: cInfo}
+	runtime.SetFinalizer(i, (*Info).Clear)
+	return i
 }
 
 func Synthesis(vb *Block, op *OggPacket) error {
-	cOp := op.c()
+	var pinner runtime.Pinner
+	defer pinner.Unpin()
+	cOp := op.c(&pinner)
 	defer runtime.KeepAlive(vb)
-	defer runtime.KeepAlive(op)
 	if ret := C.vorbis_synthesis(vb.c, cOp); ret != 0 {
 		return Error(ret)
 	}
+	if C.vorbis_synthesis_deferred_p(vb.c) != 0 {
+		vb.synthesizeChannels()
+	}
 	return nil
 }
 
@@ -158,23 +438,64 @@ func SynthesisBlockin(vd *DspState, vb *Block) error {
 }
 
 func SynthesisHeaderin(vi *Info, vc *Comment, op *OggPacket) error {
-	cOp := op.c()
+	var pinner runtime.Pinner
+	defer pinner.Unpin()
+	cOp := op.c(&pinner)
 	defer runtime.KeepAlive(vi)
 	defer runtime.KeepAlive(vc)
-	defer runtime.KeepAlive(op)
 	if ret := C.vorbis_synthesis_headerin(&vi.c, &vc.c, cOp); ret != 0 {
 		return Error(ret)
 	}
+	// The setup header has the codebooks. Many streams have the same setup header, e.g. the ones of the same encoder
+	// settings, so their Infos share the decoded codebooks.
+	if op.Packet[0] == 5 {
+		vi.shareBooks(op.Packet)
+	}
+	return nil
+}
+
+// SynthesisHeaderinXiph is like calling SynthesisHeaderin for each of the three headers Xiph-laced in data, e.g. the
+// CodecPrivate of a Matroska track, but in one cgo call.
+func SynthesisHeaderinXiph(vi *Info, vc *Comment, data []byte) error {
+	if len(data) == 0 {
+		return ErrBadHeader
+	}
+	var pinner runtime.Pinner
+	defer pinner.Unpin()
+	p := unsafe.SliceData(data)
+	pinner.Pin(p)
+	defer runtime.KeepAlive(vi)
+	defer runtime.KeepAlive(vc)
+	var setup C.long
+	if ret := C.vorbis_synthesis_headerin_xiph(&vi.c, &vc.c, (*C.uchar)(unsafe.Pointer(p)), C.long(len(data)), &setup); ret != 0 {
+		return Error(ret)
+	}
+	vi.shareBooks(data[setup:])
+	return nil
+}
+
+// SynthesisHalfrate makes vi decoded at the rate shifted right by shift, i.e. 1 for the half and 2 for the quarter
+// rate, by using only the lower part of the spectrum with a smaller inverse MDCT. shift 0 is the full rate.
+// SynthesisHalfrate must be called before SynthesisInit, and fails if the short blocks are too small for the rate.
+func SynthesisHalfrate(vi *Info, shift int) error {
+	defer runtime.KeepAlive(vi)
+	if ret := C.vorbis_synthesis_halfrate(&vi.c, C.int(shift)); ret != 0 {
+		return ErrInval
+	}
 	return nil
 }
 
+// SynthesisHalfrateP returns the shift of the rate set by SynthesisHalfrate.
+func SynthesisHalfrateP(vi *Info) int {
+	defer runtime.KeepAlive(vi)
+	return int(C.vorbis_synthesis_halfrate_p(&vi.c))
+}
+
 func SynthesisInit(vi *Info) (*DspState, error) {
 	cDspState := (*C.vorbis_dsp_state)(C.calloc(1, C.size_t(unsafe.Sizeof(C.vorbis_dsp_state{}))))
-	d := &DspState{c: cDspState}
-	runtime.SetFinalizer(d, func(d *DspState) {
-		// TODO: Call C.vorbis_dsp_clear(d.c)?
-		C.free(unsafe.Pointer(d.c))
-	})
+	d := &DspState{c: cDspState, vi: vi}
+	// vorbis_dsp_clear is safe for a state that failed to initialize, as the state is zero-cleared.
+	runtime.SetFinalizer(d, (*DspState).Clear)
 
 	defer runtime.KeepAlive(vi)
 	if ret := C.vorbis_synthesis_init(cDspState, &vi.c); ret != 0 {
@@ -184,12 +505,12 @@ func SynthesisInit(vi *Info) (*DspState, error) {
 }
 
 func SynthesisPcmout(vd *DspState) [][]float32 {
-	var cPCM **C.float
 	defer runtime.KeepAlive(vd)
-	n := C.vorbis_synthesis_pcmout(vd.c, &cPCM)
+	n := C.vorbis_synthesis_pcmout(vd.c, &vd.out.pcm)
 	if n == 0 {
 		return nil
 	}
+	cPCM := vd.out.pcm
 
 	cPCMPtrs := unsafe.Slice(cPCM, int(vd.c.vi.channels))
 	pcms := make([][]float32, len(cPCMPtrs))
@@ -200,6 +521,149 @@ func SynthesisPcmout(vd *DspState) [][]float32 {
 	return pcms
 }
 
+// SynthesisPcmoutView is like SynthesisPcmout, but returns the channels aliasing the PCM memory of vd without copying.
+// The channel slices are appended to pcm[:0], so pcm can be reused across calls.
+// The returned slices are valid until the next SynthesisRead or SynthesisBlockin call on vd.
+func SynthesisPcmoutView(vd *DspState, pcm [][]float32) [][]float32 {
+	defer runtime.KeepAlive(vd)
+	n := C.vorbis_synthesis_pcmout(vd.c, &vd.out.pcm)
+	pcm = pcm[:0]
+	if n == 0 {
+		return pcm
+	}
+
+	for _, cPCMPtr := range unsafe.Slice(vd.out.pcm, int(vd.c.vi.channels)) {
+		pcm = append(pcm, unsafe.Slice((*float32)(unsafe.Pointer(cPCMPtr)), int(n)))
+	}
+	return pcm
+}
+
+// SynthesisPcmoutStereo moves the decoded PCM to dst as interleaved stereo samples, and returns the number of moved frames.
+// Mono is duplicated to both channels. The moved frames are consumed as SynthesisRead does.
+func SynthesisPcmoutStereo(vd *DspState, dst []float32) int {
+	if len(dst) < 2 {
+		return 0
+	}
+	defer runtime.KeepAlive(vd)
+	return int(C.vorbis_synthesis_pcmout_stereo(vd.c, (*C.float)(unsafe.Pointer(unsafe.SliceData(dst))), C.int(len(dst)/2)))
+}
+
+// SynthesisPcmoutDownmix is like SynthesisPcmoutStereo, but mixes all the channels with matrix.
+// matrix has the gains of the left and the right output for each input channel.
+func SynthesisPcmoutDownmix(vd *DspState, dst []float32, matrix []float32) int {
+	if len(matrix) != 2*int(vd.c.vi.channels) {
+		panic("libvorbis: the matrix size doesn't match with the channel count")
+	}
+	if len(dst) < 2 {
+		return 0
+	}
+	defer runtime.KeepAlive(vd)
+	return int(C.vorbis_synthesis_pcmout_downmix(vd.c, (*C.float)(unsafe.Pointer(unsafe.SliceData(dst))), C.int(len(dst)/2), (*C.float)(unsafe.Pointer(unsafe.SliceData(matrix))), nil))
+}
+
+// SynthesisBatch moves the decoded PCM to dst as SynthesisPcmoutStereo does, or as SynthesisPcmoutDownmix does if
+// matrix is not nil, and decodes the next packet as Synthesis and SynthesisBlockin do while dst has room, in one cgo
+// call. *skip frames are discarded before moving, and *skip is updated.
+// If source is not nil, the channels of the moved frames are also written to source as interleaved samples before they
+// are mixed, e.g. to measure them. source must have room for as many frames as dst, and is used only with matrix.
+// SynthesisBatch returns the number of the moved frames and the number of the decoded packets. If decoding a packet
+// fails, SynthesisBatch stops after the packet and returns the error.
+func SynthesisBatch(vd *DspState, vb *Block, packets [][]byte, dst []float32, matrix []float32, source []float32, skip *int) (int, int, error) {
+	if matrix != nil && len(matrix) != 2*int(vd.c.vi.channels) {
+		panic("libvorbis: the matrix size doesn't match with the channel count")
+	}
+	if source != nil && len(source) < len(dst)/2*int(vd.c.vi.channels) {
+		panic("libvorbis: the source is shorter than the destination")
+	}
+	if len(dst) < 2 {
+		return 0, 0, nil
+	}
+	defer runtime.KeepAlive(vd)
+	defer runtime.KeepAlive(vb)
+
+	vd.batchData = vd.batchData[:0]
+	vd.batchLens = vd.batchLens[:0]
+	for _, p := range packets {
+		vd.batchData = append(vd.batchData, p...)
+		vd.batchLens = append(vd.batchLens, C.long(len(p)))
+	}
+	var cMatrix *C.float
+	if matrix != nil {
+		cMatrix = (*C.float)(unsafe.Pointer(unsafe.SliceData(matrix)))
+	}
+	channels := int(vd.c.vi.channels)
+	if matrix == nil {
+		source = nil
+	}
+	vd.out.skip = C.int(*skip)
+	var offset, consumed, written int
+	var resume C.int
+	for {
+		var cSource *C.float
+		if source != nil {
+			cSource = (*C.float)(unsafe.Pointer(unsafe.SliceData(source[channels*written:])))
+		}
+		ret := C.vorbis_synthesis_batch(vd.c, vb.c,
+			(*C.uchar)(unsafe.Pointer(unsafe.SliceData(vd.batchData[offset:]))),
+			(*C.long)(unsafe.Pointer(unsafe.SliceData(vd.batchLens[consumed:]))),
+			C.int(len(packets)-consumed),
+			(*C.float)(unsafe.Pointer(unsafe.SliceData(dst[2*written:]))),
+			C.int(len(dst)/2-written),
+			cMatrix,
+			cSource,
+			&vd.out.skip, &vd.out.consumed, &vd.out.written, resume)
+		for _, l := range vd.batchLens[consumed : consumed+int(vd.out.consumed)] {
+			offset += int(l)
+		}
+		consumed += int(vd.out.consumed)
+		written += int(vd.out.written)
+		if ret == C.VORBIS_SYNTHESIS_DEFERRED {
+			vb.synthesizeChannels()
+			resume = 1
+			continue
+		}
+		*skip = int(vd.out.skip)
+		if ret != 0 {
+			return written, consumed, Error(ret)
+		}
+		return written, consumed, nil
+	}
+}
+
+// SynthesisParallelChannels makes SynthesisBatch synthesize the channels of each packet in parallel, each part of the
+// channels on its own goroutine, up to GOMAXPROCS parts. The floors and the inverse MDCTs of the channels are
+// independent, so a packet of many channels, e.g. of 5.1, takes about as long as a packet of as many channels as a
+// part. The blocks with floor type 0, which is obsolete, are synthesized on one goroutine.
+func SynthesisParallelChannels(vd *DspState, parallel bool) {
+	defer runtime.KeepAlive(vd)
+	C.vorbis_synthesis_defer_channels(vd.c, C.int(btoi(parallel)))
+}
+
+// synthesizeChannels synthesizes the channels of the block left by vorbis_synthesis with
+// vorbis_synthesis_defer_channels. The last part is synthesized on this goroutine.
+func (vb *Block) synthesizeChannels() {
+	channels := int(vb.c.vd.vi.channels)
+	parts := min(channels, runtime.GOMAXPROCS(0))
+	var wg sync.WaitGroup
+	for i := range parts - 1 {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			C.vorbis_synthesis_channels(vb.c, C.int(channels*i/parts), C.int(channels*(i+1)/parts))
+		}()
+	}
+	C.vorbis_synthesis_channels(vb.c, C.int(channels*(parts-1)/parts), C.int(channels))
+	wg.Wait()
+}
+
+func SynthesisRestart(vd *DspState) error {
+	defer runtime.KeepAlive(vd)
+	if ret := C.vorbis_synthesis_restart(vd.c); ret != 0 {
+		return Error(ret)
+	}
+	return nil
+}
+
 func SynthesisRead(vd *DspState, samples int) error {
 	defer runtime.KeepAlive(vd)
 	if ret := C.vorbis_synthesis_read(vd.c, C.int(samples)); ret != 0 {
@@ -210,22 +674,30 @@ func SynthesisRead(vd *DspState, samples int) error {
 
 func BlockInit(vd *DspState) (*Block, error) {
 	cBlock := (*C.vorbis_block)(C.calloc(1, C.size_t(unsafe.Sizeof(C.vorbis_block{}))))
-	b := &Block{c: cBlock}
-	runtime.SetFinalizer(b, func(b *Block) {
-		// TODO: Call C.vorbis_block_clear(b.c)?
-		C.free(unsafe.Pointer(b.c))
-	})
+	b := &Block{c: cBlock, vd: vd}
+	runtime.SetFinalizer(b, (*Block).Clear)
 
+	defer runtime.KeepAlive(vd)
 	if ret := C.vorbis_block_init(vd.c, cBlock); ret != 0 {
 		return nil, Error(ret)
 	}
+	C.vorbis_block_reserve(cBlock)
 	return b, nil
 }
 
+// LocalStoreSize returns the size of the storage of the temporaries of synthesizing a block, which grows to the
+// largest size that a block has needed.
+func (b *Block) LocalStoreSize() int {
+	defer runtime.KeepAlive(b)
+	return int(b.c.localalloc + b.c.totaluse)
+}
+
 func CommentInit() *Comment {
 	var cComment C.vorbis_comment
 	C.vorbis_comment_init(&cComment)
-	return &Comment{c: cComment}
+	c := &Comment{c: cComment}
+	runtime.SetFinalizer(c, (*Comment).Clear)
+	return c
 }
 
 func btoi(b bool) int {
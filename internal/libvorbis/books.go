@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libvorbis
+
+// #include <stdlib.h>
+// #include "vorbis_codec.h"
+// #include "codec_internal.h"
+//
+// static void vorbis_books_free(codebook* books, int n) {
+//   for (int i = 0; i < n; i++) {
+//     vorbis_book_clear(books + i);
+//   }
+//   free(books);
+// }
+//
+// // vorbis_books_build decodes the codebooks of the setup of vi as vorbis_synthesis_init does, and returns them, or
+// // NULL if a codebook is invalid. vi is not modified.
+// static codebook* vorbis_books_build(vorbis_info* vi) {
+//   codec_setup_info* ci = vi->codec_setup;
+//   codebook* books = calloc(ci->books, sizeof(codebook));
+//   if (!books) {
+//     return NULL;
+//   }
+//   for (int i = 0; i < ci->books; i++) {
+//     if (!ci->book_param[i] || vorbis_book_init_decode(books + i, ci->book_param[i])) {
+//       vorbis_books_free(books, ci->books);
+//       return NULL;
+//     }
+//   }
+//   return books;
+// }
+//
+// // vorbis_books_attach makes vi use books as its decoded codebooks, and frees the static codebooks, which
+// // vorbis_synthesis_init would free after decoding them.
+// static void vorbis_books_attach(vorbis_info* vi, codebook* books) {
+//   codec_setup_info* ci = vi->codec_setup;
+//   ci->fullbooks = books;
+//   for (int i = 0; i < ci->books; i++) {
+//     vorbis_staticbook_destroy(ci->book_param[i]);
+//     ci->book_param[i] = NULL;
+//   }
+// }
+//
+// // vorbis_books_detach removes the decoded codebooks from vi so that vorbis_info_clear doesn't free them.
+// static void vorbis_books_detach(vorbis_info* vi) {
+//   codec_setup_info* ci = vi->codec_setup;
+//   if (ci) {
+//     ci->fullbooks = NULL;
+//   }
+// }
+//
+// static int vorbis_books_shared(vorbis_info* vi, codebook* books) {
+//   codec_setup_info* ci = vi->codec_setup;
+//   return ci && ci->fullbooks == books;
+// }
+//
+// static int vorbis_books_count(vorbis_info* vi) {
+//   codec_setup_info* ci = vi->codec_setup;
+//   return ci ? ci->books : 0;
+// }
+import "C"
+
+import (
+	"crypto/sha256"
+	"sync"
+)
+
+// sharedBooks is the decoded codebooks of a setup header, shared by the Infos of the same setup header.
+// The decoded codebooks are not modified while decoding.
+type sharedBooks struct {
+	key   [sha256.Size]byte
+	books *C.codebook
+	count C.int
+	refs  int
+}
+
+var (
+	booksMu sync.Mutex
+
+	// books is the decoded codebooks of the setup headers that the live Infos have, by the hashes of the headers.
+	books = map[[sha256.Size]byte]*sharedBooks{}
+)
+
+// shareBooks makes i use the decoded codebooks of the setup header, decoding them if no other Info has them.
+// If decoding fails, i is not modified, and SynthesisInit reports the error.
+func (i *Info) shareBooks(header []byte) {
+	key := sha256.Sum256(header)
+	count := C.vorbis_books_count(&i.c)
+
+	booksMu.Lock()
+	b, ok := books[key]
+	if ok {
+		b.refs++
+	}
+	booksMu.Unlock()
+
+	if !ok {
+		// Decode the codebooks without the lock, as this takes a while for large setups.
+		p := C.vorbis_books_build(&i.c)
+		if p == nil {
+			return
+		}
+		booksMu.Lock()
+		if b, ok = books[key]; ok {
+			// Another Info of the same setup header has decoded them first.
+			b.refs++
+		} else {
+			b = &sharedBooks{key: key, books: p, count: count, refs: 1}
+			books[key] = b
+		}
+		booksMu.Unlock()
+		if b.books != p {
+			C.vorbis_books_free(p, count)
+		}
+	}
+
+	if b.count != count {
+		// The hashes collide, which is unlikely. Don't share the codebooks then.
+		i.books = b
+		i.releaseBooks()
+		return
+	}
+	C.vorbis_books_attach(&i.c, b.books)
+	i.books = b
+}
+
+// releaseBooks removes the shared codebooks from i, and frees them if no other Info uses them.
+func (i *Info) releaseBooks() {
+	b := i.books
+	if b == nil {
+		return
+	}
+	if C.vorbis_books_shared(&i.c, b.books) != 0 {
+		C.vorbis_books_detach(&i.c)
+	}
+	i.books = nil
+
+	booksMu.Lock()
+	defer booksMu.Unlock()
+	b.refs--
+	if b.refs > 0 {
+		return
+	}
+	delete(books, b.key)
+	C.vorbis_books_free(b.books, b.count)
+}
@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build amd64.v3
+
+package libvorbis
+
+// With FMA, the C compiler contracts the multiplications and the additions, so the decoded PCM differs from the other
+// builds in the last bits.
+
+// #cgo CFLAGS: -march=x86-64-v3
+import "C"
@@ -81,6 +81,14 @@ typedef struct private_state {
   bitrate_manager_state bms;
 
   ogg_int64_t sample_count;
+
+  /* set by vorbis_synthesis_defer_channels, and the block whose floors and
+     MDCTs are left to vorbis_synthesis_channels with its mapping and floor
+     memos, or NULL */
+  int            defer_channels;
+  vorbis_block  *deferred;
+  void          *deferred_map;
+  void         **deferred_floormemo;
 } private_state;
 
 /* codec_setup_info contains all the setup information specific to the
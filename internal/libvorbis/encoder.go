@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder
+
+package libvorbis
+
+// #include <stdlib.h>
+// #include "vorbis_codec.h"
+// #include "vorbis_vorbisenc.h"
+//
+// // vorbis_encoder is the states of an encoder, allocated at once so that their addresses don't move.
+// typedef struct {
+//   vorbis_info vi;
+//   vorbis_comment vc;
+//   vorbis_dsp_state vd;
+//   vorbis_block vb;
+// } vorbis_encoder;
+//
+// static vorbis_encoder* vorbis_encoder_create(int channels, long rate, float quality, int* err) {
+//   vorbis_encoder* e = calloc(1, sizeof(vorbis_encoder));
+//   if (!e) {
+//     *err = OV_EFAULT;
+//     return NULL;
+//   }
+//   vorbis_info_init(&e->vi);
+//   *err = vorbis_encode_init_vbr(&e->vi, channels, rate, quality);
+//   if (*err) {
+//     vorbis_info_clear(&e->vi);
+//     free(e);
+//     return NULL;
+//   }
+//   vorbis_comment_init(&e->vc);
+//   vorbis_analysis_init(&e->vd, &e->vi);
+//   vorbis_block_init(&e->vd, &e->vb);
+//   return e;
+// }
+//
+// static void vorbis_encoder_destroy(vorbis_encoder* e) {
+//   vorbis_block_clear(&e->vb);
+//   vorbis_dsp_clear(&e->vd);
+//   vorbis_comment_clear(&e->vc);
+//   vorbis_info_clear(&e->vi);
+//   free(e);
+// }
+//
+// // vorbis_encoder_write copies frames frames of the interleaved samples pcm to the analysis buffer. If frames is 0,
+// // the input ends.
+// static int vorbis_encoder_write(vorbis_encoder* e, const float* pcm, int frames) {
+//   if (frames == 0) {
+//     return vorbis_analysis_wrote(&e->vd, 0);
+//   }
+//   const int channels = e->vi.channels;
+//   float** buf = vorbis_analysis_buffer(&e->vd, frames);
+//   for (int c = 0; c < channels; c++) {
+//     float* dst = buf[c];
+//     for (int i = 0; i < frames; i++) {
+//       dst[i] = pcm[i*channels+c];
+//     }
+//   }
+//   return vorbis_analysis_wrote(&e->vd, frames);
+// }
+//
+// // vorbis_encoder_packetout analyzes the blocks until a packet is ready, and returns 1 with the packet in op.
+// // vorbis_encoder_packetout returns 0 if more input is needed, or the negative error.
+// static int vorbis_encoder_packetout(vorbis_encoder* e, ogg_packet* op) {
+//   for (;;) {
+//     int ret = vorbis_bitrate_flushpacket(&e->vd, op);
+//     if (ret < 0) {
+//       return ret;
+//     }
+//     if (ret > 0) {
+//       return 1;
+//     }
+//     ret = vorbis_analysis_blockout(&e->vd, &e->vb);
+//     if (ret <= 0) {
+//       return ret;
+//     }
+//     if ((ret = vorbis_analysis(&e->vb, NULL)) < 0) {
+//       return ret;
+//     }
+//     if ((ret = vorbis_bitrate_addblock(&e->vb)) < 0) {
+//       return ret;
+//     }
+//   }
+// }
+import "C"
+
+import (
+	"runtime"
+	"unsafe"
+)
+
+// encoderWriteFrames is the number of the frames copied to the analysis buffer at once. The analysis buffer grows to
+// hold all the frames written before the blocks are taken out, so the input is written in pieces.
+const encoderWriteFrames = 4096
+
+// Encoder is a Vorbis encoder in the VBR mode.
+type Encoder struct {
+	e        *C.vorbis_encoder
+	channels int
+}
+
+// EncoderCreate creates an encoder. quality is from -0.1 to 1, as vorbis_encode_init_vbr takes it.
+func EncoderCreate(channels int, rate int, quality float32) (*Encoder, error) {
+	var err C.int
+	e := C.vorbis_encoder_create(C.int(channels), C.long(rate), C.float(quality), &err)
+	if e == nil {
+		return nil, Error(err)
+	}
+	enc := &Encoder{
+		e:        e,
+		channels: channels,
+	}
+	runtime.SetFinalizer(enc, (*Encoder).Destroy)
+	return enc, nil
+}
+
+// Headers returns the identification, the comment, and the setup headers.
+func (e *Encoder) Headers() ([3][]byte, error) {
+	defer runtime.KeepAlive(e)
+	var ops [3]C.ogg_packet
+	if ret := C.vorbis_analysis_headerout(&e.e.vd, &e.e.vc, &ops[0], &ops[1], &ops[2]); ret != 0 {
+		return [3][]byte{}, Error(ret)
+	}
+	var headers [3][]byte
+	for i, op := range ops {
+		headers[i] = C.GoBytes(unsafe.Pointer(op.packet), C.int(op.bytes))
+	}
+	return headers, nil
+}
+
+// Encode encodes the interleaved samples pcm, and calls f with each packet that is ready. If pcm is empty, the input
+// ends, and f is called with the rest of the packets. A partial frame at the end of pcm is dropped. The data of a packet
+// is not reused.
+func (e *Encoder) Encode(pcm []float32, f func(packet *OggPacket) error) error {
+	defer runtime.KeepAlive(e)
+	end := len(pcm) == 0
+	for {
+		n := min(len(pcm)/e.channels, encoderWriteFrames)
+		if n == 0 && !end {
+			return nil
+		}
+		if ret := C.vorbis_encoder_write(e.e, (*C.float)(unsafe.Pointer(unsafe.SliceData(pcm))), C.int(n)); ret != 0 {
+			return Error(ret)
+		}
+		pcm = pcm[n*e.channels:]
+
+		for {
+			var op C.ogg_packet
+			ret := C.vorbis_encoder_packetout(e.e, &op)
+			if ret < 0 {
+				return Error(ret)
+			}
+			if ret == 0 {
+				break
+			}
+			if err := f(&OggPacket{
+				Packet:     C.GoBytes(unsafe.Pointer(op.packet), C.int(op.bytes)),
+				EOS:        op.e_o_s != 0,
+				GranulePos: int64(op.granulepos),
+				PacketNo:   int64(op.packetno),
+			}); err != nil {
+				return err
+			}
+		}
+
+		if end {
+			return nil
+		}
+	}
+}
+
+// Destroy frees the encoder. Destroy is called when e is finalized, and can be called more than once.
+func (e *Encoder) Destroy() {
+	if e.e == nil {
+		return
+	}
+	C.vorbis_encoder_destroy(e.e)
+	e.e = nil
+	runtime.SetFinalizer(e, nil)
+}
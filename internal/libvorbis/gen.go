@@ -6,13 +6,18 @@
 package main
 
 import (
+	"flag"
 	"log/slog"
 	"os"
+	"strings"
 
 	"github.com/hajimehoshi/webmplayer/internal/cgen"
 )
 
+var flagPrebuilt = flag.String("prebuilt", "", "the comma-separated GOOS/GOARCH pairs to build the prebuilt objects for, instead of generating the C files")
+
 func main() {
+	flag.Parse()
 	if err := xmain(); err != nil {
 		slog.Error(err.Error())
 		os.Exit(1)
@@ -20,6 +25,15 @@ func main() {
 }
 
 func xmain() error {
+	if *flagPrebuilt != "" {
+		return cgen.BuildPrebuilt(&cgen.PrebuiltOptions{
+			Package:   ".",
+			OutputDir: "prebuilt",
+			Name:      "libvorbis",
+			Platforms: strings.Split(*flagPrebuilt, ","),
+		})
+	}
+
 	oggOp := &cgen.GenerateOptions{
 		ProjectName: "libogg",
 		TarGzURL:    "https://downloads.xiph.org/releases/ogg/libogg-1.3.5.tar.gz",
@@ -30,8 +44,45 @@ func xmain() error {
 		AllowedFiles: []string{
 			"README.md",
 		},
-		BlockedFiles: []string{},
-		BlockedDirs:  []string{},
+		BlockedFiles:    []string{},
+		BlockedDirs:     []string{},
+		BuildConstraint: "!webmplayerprebuilt",
+		PreservedFiles: []string{
+			"ogg_crc_simd.h",
+		},
+		Amalgamations: []cgen.Amalgamation{
+			{
+				Name:  "amalgamation_ogg.c",
+				Files: []string{"src/*.c"},
+			},
+		},
+		Patches: []cgen.Patch{
+			{
+				File: "src/bitwise.c",
+				Old:  "  if(bits<0 || bits>32) return -1;\n  m=mask[bits];\n  bits+=b->endbit;\n\n  if(b->endbyte >= b->storage-4){\n    /* not the main path */\n    if(b->endbyte > b->storage-((bits+7)>>3)) return -1;",
+				New:  "  if(bits<0 || bits>32) return -1;\n  m=mask[bits];\n\n#ifdef OGGPACK_LOAD64\n  if(b->storage-b->endbyte>=8)\n    return (long)((OGGPACK_LOAD64(b->ptr)>>b->endbit)&m);\n#endif\n\n  bits+=b->endbit;\n\n  if(b->endbyte >= b->storage-4){\n    /* not the main path */\n    if(b->endbyte > b->storage-((bits+7)>>3)) return -1;",
+			},
+			{
+				File: "src/bitwise.c",
+				Old:  "  if(bits<0 || bits>32) goto err;\n  m=mask[bits];\n  bits+=b->endbit;\n\n  if(b->endbyte >= b->storage-4){\n    /* not the main path */\n    if(b->endbyte > b->storage-((bits+7)>>3)) goto overflow;\n    /* special case to avoid reading b->ptr[0], which might be past the end of\n        the buffer; also skips some useless accounting */\n    else if(!bits)return(0L);\n  }\n\n  ret=b->ptr[0]>>b->endbit;\n  if(bits>8){\n    ret|=b->ptr[1]<<(8-b->endbit);\n    if(bits>16){\n      ret|=b->ptr[2]<<(16-b->endbit);\n      if(bits>24){\n        ret|=b->ptr[3]<<(24-b->endbit);\n        if(bits>32 && b->endbit){\n          ret|=b->ptr[4]<<(32-b->endbit);\n        }\n      }\n    }\n  }\n",
+				New:  "  if(bits<0 || bits>32) goto err;\n  m=mask[bits];\n\n#ifdef OGGPACK_LOAD64\n  if(b->storage-b->endbyte>=8){\n    ret=(long)((OGGPACK_LOAD64(b->ptr)>>b->endbit)&m);\n    bits+=b->endbit;\n    b->ptr+=bits/8;\n    b->endbyte+=bits/8;\n    b->endbit=bits&7;\n    return ret;\n  }\n#endif\n\n  bits+=b->endbit;\n\n  if(b->endbyte >= b->storage-4){\n    /* not the main path */\n    if(b->endbyte > b->storage-((bits+7)>>3)) goto overflow;\n    /* special case to avoid reading b->ptr[0], which might be past the end of\n        the buffer; also skips some useless accounting */\n    else if(!bits)return(0L);\n  }\n\n  ret=b->ptr[0]>>b->endbit;\n  if(bits>8){\n    ret|=b->ptr[1]<<(8-b->endbit);\n    if(bits>16){\n      ret|=b->ptr[2]<<(16-b->endbit);\n      if(bits>24){\n        ret|=b->ptr[3]<<(24-b->endbit);\n        if(bits>32 && b->endbit){\n          ret|=b->ptr[4]<<(32-b->endbit);\n        }\n      }\n    }\n  }\n",
+			},
+			{
+				File: "src/bitwise.c",
+				Old:  "#include <ogg_ogg.h>\n",
+				New:  "#include <ogg_ogg.h>\n\n/* Reads 8 bytes at once in the LSb-first order when at least 8 bytes are left. */\n#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__\nstatic inline unsigned long long oggpack_load64(const unsigned char *p){\n  unsigned long long v;\n  memcpy(&v,p,8);\n  return v;\n}\n#define OGGPACK_LOAD64(p) oggpack_load64(p)\n#endif\n",
+			},
+			{
+				File: "src/framing.c",
+				Old:  "#include \"crctable.h\"\n",
+				New:  "#include \"crctable.h\"\n#include \"ogg_crc_simd.h\"\n",
+			},
+			{
+				File: "src/framing.c",
+				Old:  "static ogg_uint32_t _os_update_crc(ogg_uint32_t crc, unsigned char *buffer, int size){\n",
+				New:  "static ogg_uint32_t _os_update_crc(ogg_uint32_t crc, unsigned char *buffer, int size){\n#ifdef OGG_CRC_CLMUL\n  if(size>=OGG_CRC_CLMUL_MIN && ogg_crc_clmul_available()){\n    unsigned char folded[16];\n    int n=ogg_crc_fold(crc,buffer,size,folded);\n    crc=_os_update_crc(0,folded,16);\n    buffer+=n;\n    size-=n;\n  }\n#endif\n\n",
+			},
+		},
 	}
 
 	vorbisOp := &cgen.GenerateOptions{
@@ -55,6 +106,215 @@ func xmain() error {
 			"test",
 			"vq",
 		},
+		BuildConstraint: "!webmplayerprebuilt",
+		PreservedFiles: []string{
+			"mdct_simd.h",
+			"vorbis_simd.h",
+		},
+		Amalgamations: []cgen.Amalgamation{
+			{
+				Name:  "amalgamation_vorbis.c",
+				Files: []string{"lib/*.c"},
+				ExcludedFiles: []string{
+					// These define FLOOR1_fromdB_LOOKUP as floor1.c does. The mapping is called via a function table.
+					"lib/mapping0.c",
+					"lib/psy.c",
+					// This defines bitreverse as codebook.c does.
+					"lib/sharedbook.c",
+				},
+			},
+		},
+		Tagged: []cgen.Tagged{
+			{
+				// The player only decodes. The encoder setup and the high-level file API are not referred by the
+				// synthesis path.
+				Tag:   "webmplayer_encoder",
+				Files: []string{"lib/analysis.c", "lib/vorbisenc.c", "lib/vorbisfile.c"},
+			},
+		},
+		Patches: []cgen.Patch{
+			{
+				File: "lib/sharedbook.c",
+				Old:  "      c->dec_firsttablen=ov_ilog(c->used_entries)-4; /* this is magic */\n      if(c->dec_firsttablen<5)c->dec_firsttablen=5;\n      if(c->dec_firsttablen>8)c->dec_firsttablen=8;\n",
+				New:  "      /* cover all the codewords with the direct lookup as far as the table is small enough */\n      c->dec_firsttablen=c->dec_maxlength;\n      if(c->dec_firsttablen<5)c->dec_firsttablen=5;\n      if(c->dec_firsttablen>10)c->dec_firsttablen=10;\n",
+			},
+			{
+				// mdct_backward is defined in mdct_simd.h, which falls back to the scalar version.
+				File: "lib/mdct.c",
+				Old:  "void mdct_backward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){",
+				New:  "void mdct_backward_c(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){",
+			},
+			{
+				File: "lib/mdct.c",
+				Old:  "void mdct_forward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){",
+				New:  "#include \"mdct_simd.h\"\n\nvoid mdct_forward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){",
+			},
+			{
+				File: "lib/block.c",
+				Old:  "#include \"misc.h\"\n",
+				New:  "#include \"misc.h\"\n#include \"vorbis_simd.h\"\n",
+			},
+			{
+				File: "lib/block.c",
+				Old:  "  int i,j;\n\n  if(!vb)return(OV_EINVAL);\n",
+				New:  "  int j;\n\n  if(!vb)return(OV_EINVAL);\n",
+			},
+			{
+				File: "lib/block.c",
+				Old:  "          for(i=0;i<n1;i++)\n            pcm[i]=pcm[i]*w[n1-i-1] + p[i]*w[i];",
+				New:  "          vorbis_overlap_add(pcm,p,w,n1);",
+			},
+			{
+				File: "lib/block.c",
+				Old:  "          for(i=0;i<n0;i++)\n            pcm[i]=pcm[i]*w[n0-i-1] +p[i]*w[i];",
+				New:  "          vorbis_overlap_add(pcm,p,w,n0);",
+			},
+			{
+				File: "lib/block.c",
+				Old:  "          vorbis_overlap_add(pcm,p,w,n0);\n          for(;i<n1/2+n0/2;i++)\n            pcm[i]=p[i];",
+				New:  "          vorbis_overlap_add(pcm,p,w,n0);\n          memcpy(pcm+n0,p+n0,(n1/2-n0/2)*sizeof(*pcm));",
+			},
+			{
+				File: "lib/block.c",
+				Old:  "        for(i=0;i<n;i++)\n          pcm[i]=p[i];",
+				New:  "        memcpy(pcm,p,n*sizeof(*pcm));",
+			},
+			{
+				File: "lib/window.c",
+				Old:  "#include \"window.h\"\n",
+				New:  "#include \"window.h\"\n#include \"vorbis_simd.h\"\n",
+			},
+			{
+				File: "lib/window.c",
+				Old:  "    int i,p;\n\n    for(i=0;i<leftbegin;i++)\n      d[i]=0.f;\n\n    for(p=0;i<leftend;i++,p++)\n      d[i]*=windowLW[p];\n\n    for(i=rightbegin,p=rn/2-1;i<rightend;i++,p--)\n      d[i]*=windowNW[p];\n\n    for(;i<n;i++)\n      d[i]=0.f;",
+				New:  "    memset(d,0,leftbegin*sizeof(*d));\n    vorbis_window_mul(d+leftbegin,windowLW,leftend-leftbegin);\n    vorbis_window_mul_rev(d+rightbegin,windowNW,rightend-rightbegin);\n    memset(d+rightend,0,(n-rightend)*sizeof(*d));",
+			},
+			{
+				File: "lib/window.c",
+				Old:  "#include <stdlib.h>\n",
+				New:  "#include <stdlib.h>\n#include <string.h>\n",
+			},
+			{
+				File: "lib/floor1.c",
+				Old:  "#include \"scales.h\"\n",
+				New:  "#include \"scales.h\"\n#include \"vorbis_simd.h\"\n",
+			},
+			{
+				File: "lib/floor1.c",
+				Old:  "static void render_line(int n, int x0,int x1,int y0,int y1,float *d){\n  int dy=y1-y0;\n  int adx=x1-x0;\n  int ady=abs(dy);\n  int base=dy/adx;\n  int sy=(dy<0?base-1:base+1);\n  int x=x0;\n  int y=y0;\n  int err=0;\n\n  ady-=abs(base*adx);\n\n  if(n>x1)n=x1;\n\n  if(x<n)\n    d[x]*=FLOOR1_fromdB_LOOKUP[y];\n\n  while(++x<n){\n    err=err+ady;\n    if(err>=adx){\n      err-=adx;\n      y+=sy;\n    }else{\n      y+=base;\n    }\n    d[x]*=FLOOR1_fromdB_LOOKUP[y];\n  }\n}",
+				New:  "static void render_line(int n, int x0,int x1,int y0,int y1,float *d){\n  vorbis_render_line(n,x0,x1,y0,y1,FLOOR1_fromdB_LOOKUP,d);\n}",
+			},
+			{
+				File: "lib/floor1.c",
+				Old:  "    for(j=hx;j<n;j++)out[j]*=FLOOR1_fromdB_LOOKUP[ly]; /* be certain */",
+				New:  "    if(hx<n)vorbis_scale(out+hx,FLOOR1_fromdB_LOOKUP[ly],n-hx); /* be certain */",
+			},
+			{
+				File: "lib/codebook.c",
+				Old:  "long vorbis_book_decodevv_add(codebook *book,float **a,long offset,int ch,\n                              oggpack_buffer *b,int n){\n",
+				New:  "/* The stereo case of vorbis_book_decodevv_add with an even dimension, where each entry has whole frames, e.g. the\n   residue 2 of stereo. The frames from i are decoded up to m as long as the entries fit, and the next frame is\n   returned. */\n#define DECODEVV_ADD_STEREO(frames)                               \\\n  while(i+(frames)<=m){                                           \\\n    long entry=decode_packed_entry_number(book,b);                \\\n    const float *t;                                               \\\n    int j;                                                        \\\n    if(entry==-1)return(-1);                                      \\\n    t=book->valuelist+entry*book->dim;                            \\\n    for(j=0;j<(frames);j++){                                      \\\n      a0[i+j]+=t[2*j];                                            \\\n      a1[i+j]+=t[2*j+1];                                          \\\n    }                                                             \\\n    i+=(frames);                                                  \\\n  }\n\nstatic long decodevv_add_stereo(codebook *book,float **a,long i,long m,\n                                oggpack_buffer *b){\n  float *a0=a[0];\n  float *a1=a[1];\n  switch(book->dim){\n  case 2:\n    DECODEVV_ADD_STEREO(1);\n    break;\n  case 4:\n    DECODEVV_ADD_STEREO(2);\n    break;\n  case 8:\n    DECODEVV_ADD_STEREO(4);\n    break;\n  default:\n    DECODEVV_ADD_STEREO(book->dim>>1);\n    break;\n  }\n  return(i);\n}\n\n#undef DECODEVV_ADD_STEREO\n\nlong vorbis_book_decodevv_add(codebook *book,float **a,long offset,int ch,\n                              oggpack_buffer *b,int n){\n",
+			},
+			{
+				File: "lib/codebook.c",
+				Old:  "    int m=(offset+n)/ch;\n    for(i=offset/ch;i<m;){",
+				New:  "    int m=(offset+n)/ch;\n    i=offset/ch;\n    if(ch==2 && (book->dim&1)==0){\n      i=decodevv_add_stereo(book,a,i,m,b);\n      if(i==-1)return(-1);\n    }\n    /* the rest of the frames with the generic loop, which starts at the first channel too */\n    for(;i<m;){",
+			},
+			{
+				File: "lib/synthesis.c",
+				Old:  "  /* right now, our MDCT can't handle < 64 sample windows. */\n  if(ci->blocksizes[0]<=64 && flag)return -1;\n  ci->halfrate_flag=(flag?1:0);",
+				New:  "  /* right now, our MDCT can't handle < 64 sample windows. flag is the\n     shift of the rate, so 2 decodes at the quarter rate. */\n  if(flag<0 || flag>2 || (ci->blocksizes[0]>>flag)<64)return -1;\n  ci->halfrate_flag=flag;",
+			},
+			{
+				File: "lib/floor1.c",
+				Old:  "  codec_setup_info   *ci=vb->vd->vi->codec_setup;\n  int                  n=ci->blocksizes[vb->W]/2;\n  int j;\n\n  if(memo){\n    /* render the lines */",
+				New:  "  codec_setup_info   *ci=vb->vd->vi->codec_setup;\n  /* the reduced rates use only the lower part of the spectrum */\n  int                  n=(ci->blocksizes[vb->W]/2)>>ci->halfrate_flag;\n  int j;\n\n  if(memo){\n    /* render the lines */",
+			},
+			{
+				File: "lib/mapping0.c",
+				Old:  "  /* channel coupling */\n  for(i=info->coupling_steps-1;i>=0;i--){\n    float *pcmM=vb->pcm[info->coupling_mag[i]];\n    float *pcmA=vb->pcm[info->coupling_ang[i]];\n\n    for(j=0;j<n/2;j++){",
+				New:  "  /* channel coupling; the reduced rates use only the lower part of the\n     spectrum */\n  for(i=info->coupling_steps-1;i>=0;i--){\n    float *pcmM=vb->pcm[info->coupling_mag[i]];\n    float *pcmA=vb->pcm[info->coupling_ang[i]];\n\n    for(j=0;j<(n/2)>>ci->halfrate_flag;j++){",
+			},
+			{
+				File: "lib/mdct.h",
+				Old:  "  DATA_TYPE scale;\n} mdct_lookup;",
+				New:  "  DATA_TYPE scale;\n\n  /* shared is 1 if trig and bitrev are shared by all the lookups of n. */\n  int       shared;\n} mdct_lookup;",
+			},
+			{
+				File: "lib/mdct.c",
+				Old:  "void mdct_init(mdct_lookup *lookup,int n){\n  int   *bitrev=_ogg_malloc(sizeof(*bitrev)*(n/4));\n  DATA_TYPE *T=_ogg_malloc(sizeof(*T)*(n+n/4));\n\n  int i;\n  int n2=n>>1;\n  int log2n=lookup->log2n=rint(log((float)n)/log(2.f));\n  lookup->n=n;\n  lookup->trig=T;\n  lookup->bitrev=bitrev;\n\n/* trig lookups... */\n",
+				New:  "/* The lookups of the blocksizes of Vorbis I, 64 to 8192, are built once\n   and shared by all the DSP states. The trig and bitreverse lookups of n\n   are in one allocation of mdct_tables_size(n) bytes. */\n#define MDCT_SHARED_MIN 6\n#define MDCT_SHARED_MAX 13\n\nstatic void *mdct_shared[MDCT_SHARED_MAX+1];\n\nstatic size_t mdct_tables_size(int n){\n  return sizeof(DATA_TYPE)*(n+n/4)+sizeof(int)*(n/4);\n}\n\nstatic void mdct_build(DATA_TYPE *T,int n,int log2n){\n  int *bitrev=(int *)(T+n+n/4);\n  int i;\n  int n2=n>>1;\n\n/* trig lookups... */\n",
+			},
+			{
+				File: "lib/mdct.c",
+				Old:  "      bitrev[i*2]=((~acc)&mask)-1;\n      bitrev[i*2+1]=acc;\n\n    }\n  }\n  lookup->scale=FLOAT_CONV(4.f/n);\n}",
+				New:  "      bitrev[i*2]=((~acc)&mask)-1;\n      bitrev[i*2+1]=acc;\n\n    }\n  }\n}\n\nvoid mdct_init(mdct_lookup *lookup,int n){\n  int log2n=lookup->log2n=rint(log((float)n)/log(2.f));\n  DATA_TYPE *T=NULL;\n  lookup->n=n;\n  lookup->scale=FLOAT_CONV(4.f/n);\n  lookup->shared=n==1<<log2n && log2n>=MDCT_SHARED_MIN && log2n<=MDCT_SHARED_MAX;\n\n  if(lookup->shared){\n    void *expected=NULL;\n    T=__atomic_load_n(&mdct_shared[log2n],__ATOMIC_ACQUIRE);\n    if(!T){\n      /* Another thread may build the same lookups at the same time; the\n         first one is kept. */\n      T=_ogg_malloc(mdct_tables_size(n));\n      mdct_build(T,n,log2n);\n      if(!__atomic_compare_exchange_n(&mdct_shared[log2n],&expected,T,0,\n                                      __ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)){\n        _ogg_free(T);\n        T=expected;\n      }\n    }\n  }else{\n    T=_ogg_malloc(mdct_tables_size(n));\n    mdct_build(T,n,log2n);\n  }\n  lookup->trig=T;\n  lookup->bitrev=(int *)(T+n+n/4);\n}",
+			},
+			{
+				File: "lib/mdct.c",
+				Old:  "    if(l->trig)_ogg_free(l->trig);\n    if(l->bitrev)_ogg_free(l->bitrev);\n    memset(l,0,sizeof(*l));",
+				New:  "    if(l->trig && !l->shared)_ogg_free(l->trig);\n    memset(l,0,sizeof(*l));",
+			},
+			{
+				File: "lib/codec_internal.h",
+				Old:  "  ogg_int64_t sample_count;\n} private_state;",
+				New:  "  ogg_int64_t sample_count;\n\n  /* set by vorbis_synthesis_defer_channels, and the block whose floors and\n     MDCTs are left to vorbis_synthesis_channels with its mapping and floor\n     memos, or NULL */\n  int            defer_channels;\n  vorbis_block  *deferred;\n  void          *deferred_map;\n  void         **deferred_floormemo;\n} private_state;",
+			},
+			{
+				File: "include/vorbis/codec.h",
+				Old:  "extern int      vorbis_synthesis_halfrate_p(vorbis_info *v);\n",
+				New:  "extern int      vorbis_synthesis_halfrate_p(vorbis_info *v);\nextern void     vorbis_synthesis_defer_channels(vorbis_dsp_state *v,int flag);\nextern int      vorbis_synthesis_deferred_p(vorbis_block *vb);\nextern void     vorbis_synthesis_channels(vorbis_block *vb,int first,int last);\n",
+			},
+			{
+				File: "lib/mapping0.c",
+				Old:  "static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){\n",
+				New:  "/* compute and apply spectral envelope, and transform the PCM data of the\n   channels from first to last */\nstatic void mapping0_inverse_channels(vorbis_block *vb,\n                                      vorbis_info_mapping0 *info,\n                                      void **floormemo,int first,int last){\n  vorbis_dsp_state     *vd=vb->vd;\n  vorbis_info          *vi=vd->vi;\n  codec_setup_info     *ci=vi->codec_setup;\n  private_state        *b=vd->backend_state;\n  int                   i;\n\n  for(i=first;i<last;i++){\n    float *pcm=vb->pcm[i];\n    int submap=info->chmuxlist[i];\n    _floor_P[ci->floor_type[info->floorsubmap[submap]]]->\n      inverse2(vb,b->flr[info->floorsubmap[submap]],\n               floormemo[i],pcm);\n  }\n\n  /* transform the PCM data; takes PCM vector, vb; modifies PCM vector */\n  /* only MDCT right now.... */\n  for(i=first;i<last;i++){\n    float *pcm=vb->pcm[i];\n    mdct_backward(b->transform[vb->W][0],pcm,pcm);\n  }\n}\n\nstatic int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){\n",
+			},
+			{
+				File: "lib/mapping0.c",
+				Old:  "  void **floormemo=alloca(sizeof(*floormemo)*vi->channels);\n\n  /* recover",
+				New:  "  void **floormemo=alloca(sizeof(*floormemo)*vi->channels);\n\n  b->deferred=NULL;\n\n  /* recover",
+			},
+			{
+				File: "lib/mapping0.c",
+				Old:  "  /* compute and apply spectral envelope */\n  for(i=0;i<vi->channels;i++){\n    float *pcm=vb->pcm[i];\n    int submap=info->chmuxlist[i];\n    _floor_P[ci->floor_type[info->floorsubmap[submap]]]->\n      inverse2(vb,b->flr[info->floorsubmap[submap]],\n               floormemo[i],pcm);\n  }\n\n  /* transform the PCM data; takes PCM vector, vb; modifies PCM vector */\n  /* only MDCT right now.... */\n  for(i=0;i<vi->channels;i++){\n    float *pcm=vb->pcm[i];\n    mdct_backward(b->transform[vb->W][0],pcm,pcm);\n  }\n\n  /* all done! */\n  return(0);\n}\n\n/* export hooks */",
+				New:  "  /* the floors and the MDCTs of the channels are independent, and are left\n     to vorbis_synthesis_channels with vorbis_synthesis_defer_channels.\n     floor0 builds its lookup on the first use, so a block with floor0 is\n     finished here. */\n  if(b->defer_channels){\n    for(i=0;i<info->submaps;i++)\n      if(ci->floor_type[info->floorsubmap[i]]!=1)break;\n    if(i==info->submaps){\n      b->deferred_floormemo=\n        _vorbis_block_alloc(vb,sizeof(*floormemo)*vi->channels);\n      memcpy(b->deferred_floormemo,floormemo,sizeof(*floormemo)*vi->channels);\n      b->deferred_map=info;\n      b->deferred=vb;\n      return(0);\n    }\n  }\n\n  mapping0_inverse_channels(vb,info,floormemo,0,vi->channels);\n\n  /* all done! */\n  return(0);\n}\n\n/* vorbis_synthesis_defer_channels makes vorbis_synthesis leave the floors\n   and the MDCTs of the channels to vorbis_synthesis_channels, which can run\n   for separate channels at the same time. vorbis_synthesis_deferred_p\n   reports whether the last vorbis_synthesis of vb left them, and\n   vorbis_synthesis_blockin must be called after all the channels are\n   done. */\nvoid vorbis_synthesis_defer_channels(vorbis_dsp_state *v,int flag){\n  private_state *b=v->backend_state;\n  b->defer_channels=flag;\n}\n\nint vorbis_synthesis_deferred_p(vorbis_block *vb){\n  private_state *b=vb->vd->backend_state;\n  return b->deferred==vb;\n}\n\nvoid vorbis_synthesis_channels(vorbis_block *vb,int first,int last){\n  private_state *b=vb->vd->backend_state;\n  if(b->deferred==vb)\n    mapping0_inverse_channels(vb,b->deferred_map,b->deferred_floormemo,\n                              first,last);\n}\n\n/* export hooks */",
+			},
+			{
+				File: "lib/lsp.c",
+				Old:  "#include \"scales.h\"\n",
+				New:  "#include \"scales.h\"\n#include \"vorbis_simd.h\"\n",
+			},
+			{
+				File: "lib/lsp.c",
+				Old:  "#endif\n#endif\n\n",
+				New:  "#endif\n#endif\n\n/* the cosines of the bark bins for vorbis_lsp_to_curve_cached, as\n   vorbis_lsp_to_curve computes them for each bin */\nvoid vorbis_lsp_curve_init(float *wcos,int ln){\n  int k;\n  float wdel=M_PI/ln;\n  for(k=0;k<ln;k++)wcos[k]=2.f*cos(wdel*k);\n}\n\n/* the same as vorbis_lsp_to_curve with the cosines of\n   vorbis_lsp_curve_init. The polynomial is evaluated for four bark bins\n   at once, with the same operations for each bin as the scalar loop. */\nvoid vorbis_lsp_to_curve_cached(float *curve,const int *map,int n,\n                                const float *wcos,float *lsp,int m,\n                                float amp,float ampoffset){\n  int i,j;\n  for(i=0;i<m;i++)lsp[i]=2.f*cos(lsp[i]);\n\n  i=0;\n#ifdef VORBIS_SIMD\n  while(i<n){\n    /* the runs of the next four bark bins, from start[c] to start[c+1] */\n    int start[5],c,x;\n    vorbis_v4sf w={0.f,0.f,0.f,0.f};\n    vorbis_v4sf p={.5f,.5f,.5f,.5f};\n    vorbis_v4sf q={.5f,.5f,.5f,.5f};\n    start[0]=i;\n    for(c=0;c<4 && i<n;c++){\n      int k=map[i];\n      w[c]=wcos[k];\n      while(map[++i]==k);\n      start[c+1]=i;\n    }\n    for(j=1;j<m;j+=2){\n      q *= w-lsp[j-1];\n      p *= w-lsp[j];\n    }\n    if(j==m){\n      /* odd order filter; slightly assymetric */\n      /* the last coefficient */\n      q*=w-lsp[j-1];\n      p*=p*(4.f-w*w);\n      q*=q;\n    }else{\n      /* even order filter; still symmetric */\n      p*=p*(2.f-w);\n      q*=q*(2.f+w);\n    }\n    for(j=0;j<c;j++){\n      float v=fromdB(amp/sqrt(p[j]+q[j])-ampoffset);\n      for(x=start[j];x<start[j+1];x++)curve[x]*=v;\n    }\n  }\n#else\n  while(i<n){\n    int k=map[i];\n    float p=.5f;\n    float q=.5f;\n    float w=wcos[k];\n    for(j=1;j<m;j+=2){\n      q *= w-lsp[j-1];\n      p *= w-lsp[j];\n    }\n    if(j==m){\n      q*=w-lsp[j-1];\n      p*=p*(4.f-w*w);\n      q*=q;\n    }else{\n      p*=p*(2.f-w);\n      q*=q*(2.f+w);\n    }\n\n    q=fromdB(amp/sqrt(p+q)-ampoffset);\n\n    curve[i]*=q;\n    while(map[++i]==k)curve[i]*=q;\n  }\n#endif\n}\n\n",
+			},
+			{
+				File: "lib/lsp.h",
+				Old:  "                                float amp,float ampoffset);\n\n",
+				New:  "                                float amp,float ampoffset);\n\nextern void vorbis_lsp_curve_init(float *wcos,int ln);\nextern void vorbis_lsp_to_curve_cached(float *curve,const int *map,int n,\n                                       const float *wcos,float *lsp,int m,\n                                       float amp,float ampoffset);\n\n",
+			},
+			{
+				File: "lib/floor0.c",
+				Old:  "  int  n[2];\n\n",
+				New:  "  int  n[2];\n\n  /* the cosines of the bark bins for vorbis_lsp_to_curve_cached */\n  float *wcos;\n\n",
+			},
+			{
+				File: "lib/floor0.c",
+				Old:  "      _ogg_free(look->linearmap);\n    }\n",
+				New:  "      _ogg_free(look->linearmap);\n    }\n    if(look->wcos)_ogg_free(look->wcos);\n",
+			},
+			{
+				File: "lib/floor0.c",
+				Old:  "  look->linearmap=_ogg_calloc(2,sizeof(*look->linearmap));\n",
+				New:  "  look->linearmap=_ogg_calloc(2,sizeof(*look->linearmap));\n  look->wcos=_ogg_malloc(look->ln*sizeof(*look->wcos));\n  vorbis_lsp_curve_init(look->wcos,look->ln);\n",
+			},
+			{
+				File: "lib/floor0.c",
+				Old:  "    /* take the coefficients back to a spectral envelope curve */\n    vorbis_lsp_to_curve(out,\n                        look->linearmap[vb->W],\n                        look->n[vb->W],\n                        look->ln,\n                        lsp,look->m,amp,(float)info->ampdB);\n",
+				New:  "    /* take the coefficients back to a spectral envelope curve */\n    vorbis_lsp_to_curve_cached(out,\n                               look->linearmap[vb->W],\n                               look->n[vb->W],\n                               look->wcos,\n                               lsp,look->m,amp,(float)info->ampdB);\n",
+			},
+		},
 	}
 
 	if err := cgen.Generate(oggOp, vorbisOp); err != nil {
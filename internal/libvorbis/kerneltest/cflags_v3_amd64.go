@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo && amd64.v3
+
+package kerneltest
+
+// With FMA, the C compiler contracts the multiplications and the additions of the vectorized and the scalar kernels
+// differently, so their outputs differ in the last bits.
+
+// #cgo CFLAGS: -march=x86-64-v3
+import "C"
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo
+
+// Package kerneltest compiles the vectorized kernels of the libvorbis decoder and their scalar references side by
+// side, so that the tests can compare them and the benchmarks can time them over the inputs captured from the
+// decoder.
+//
+// The vectorized kernels are compiled from the same sources with the same macros and flags as the decoder.
+package kerneltest
+
+// #cgo CFLAGS: -O3 -I${SRCDIR}/..
+//
+// #include <stdlib.h>
+// #include "kerneltest.h"
+import "C"
+
+import (
+	"fmt"
+	"unsafe"
+
+	// The kernels call the other functions of the decoder, e.g. oggpack_read, and the state is set up with them.
+	_ "github.com/hajimehoshi/webmplayer/internal/libvorbis"
+)
+
+// Variant is the build of a kernel.
+type Variant int
+
+const (
+	// Vectorized is the kernel as the decoder builds it.
+	Vectorized Variant = iota
+
+	// Scalar is the kernel without the vector extensions and the auto-vectorization. The codebook's is the one of
+	// upstream libvorbis.
+	Scalar
+)
+
+func (v Variant) String() string {
+	switch v {
+	case Vectorized:
+		return "vectorized"
+	case Scalar:
+		return "scalar"
+	}
+	return fmt.Sprintf("Variant(%d)", int(v))
+}
+
+// State is the decoder state of a stream's headers, of which the kernels use the lookups and the codebooks.
+type State struct {
+	c *C.kt_state
+}
+
+// NewState decodes the identification, the comment and the setup headers.
+func NewState(headers [3][]byte) (*State, error) {
+	var ps [3]*C.uchar
+	var sizes [3]C.long
+	for i, h := range headers {
+		ps[i] = (*C.uchar)(C.CBytes(h))
+		defer C.free(unsafe.Pointer(ps[i]))
+		sizes[i] = C.long(len(h))
+	}
+	c := C.kt_state_create(&ps[0], &sizes[0])
+	if c == nil {
+		return nil, fmt.Errorf("kerneltest: decoding the headers failed")
+	}
+	return &State{c: c}, nil
+}
+
+// Close frees the state.
+func (s *State) Close() {
+	C.kt_state_destroy(s.c)
+	s.c = nil
+}
+
+// Blocksize returns the size of the short blocks for w 0, and the one of the long blocks for w 1.
+func (s *State) Blocksize(w int) int {
+	return int(C.kt_blocksize(s.c, C.int(w&1)))
+}
+
+// MDCTBackward calls mdct_backward of the blocks of w. in has the half of the block size, and out has the block
+// size.
+func (s *State) MDCTBackward(v Variant, w int, in, out []float32) {
+	n := s.Blocksize(w)
+	if len(in) < n/2 || len(out) < n {
+		panic(fmt.Sprintf("kerneltest: the numbers of the samples of the IMDCT must be at least %d and %d: %d and %d", n/2, n, len(in), len(out)))
+	}
+	pin := (*C.float)(unsafe.Pointer(unsafe.SliceData(in)))
+	pout := (*C.float)(unsafe.Pointer(unsafe.SliceData(out)))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_mdct_backward(s.c, C.int(w&1), pin, pout)
+	case Scalar:
+		C.scalar_kt_mdct_backward(s.c, C.int(w&1), pin, pout)
+	}
+}
+
+// Floor1Inverse2 calls floor1_inverse2 of the floor for a block of w with memo, the fit values decoded by
+// floor1_inverse1, which has a value for each post of the floor. out has the half of the block size, and is
+// multiplied by the floor curve.
+func (s *State) Floor1Inverse2(v Variant, w int, floor int, memo []int32, out []float32) {
+	if t := C.kt_floor_type(s.c, C.int(floor)); t != 1 {
+		panic(fmt.Sprintf("kerneltest: the floor %d is not of the type 1", floor))
+	}
+	if n := s.Blocksize(w) / 2; len(out) < n {
+		panic(fmt.Sprintf("kerneltest: the number of the samples of the floor must be at least %d: %d", n, len(out)))
+	}
+	pmemo := (*C.int)(unsafe.Pointer(unsafe.SliceData(memo)))
+	pout := (*C.float)(unsafe.Pointer(unsafe.SliceData(out)))
+	switch v {
+	case Vectorized:
+		C.vectorized_kt_floor1_inverse2(s.c, C.int(w&1), C.int(floor), pmemo, pout)
+	case Scalar:
+		C.scalar_kt_floor1_inverse2(s.c, C.int(w&1), C.int(floor), pmemo, pout)
+	}
+}
+
+// BookDecodevvAdd calls vorbis_book_decodevv_add of the codebook book for n values from offset interleaved in ch
+// channels, reading data from the bit bit. a has the channels one after another, each of stride values.
+// BookDecodevvAdd reports whether the values are decoded.
+func (s *State) BookDecodevvAdd(v Variant, book int, a []float32, stride, ch int, offset, n int, data []byte, bit int) bool {
+	if book < 0 || book >= int(C.kt_books(s.c)) {
+		panic(fmt.Sprintf("kerneltest: the codebook %d is out of range", book))
+	}
+	if ch < 1 || ch > 8 || len(a) < ch*stride || stride < (offset+n+ch-1)/ch || len(data) == 0 {
+		panic(fmt.Sprintf("kerneltest: the %d values at %d don't fit in the %d channels of %d values", n, offset, ch, stride))
+	}
+	pa := (*C.float)(unsafe.Pointer(unsafe.SliceData(a)))
+	pdata := (*C.uchar)(unsafe.Pointer(unsafe.SliceData(data)))
+	var ret C.long
+	switch v {
+	case Vectorized:
+		ret = C.vectorized_kt_decodevv_add(s.c, C.int(book), pa, C.long(stride), C.int(ch), C.long(offset), C.int(n), pdata, C.long(len(data)), C.int(bit))
+	case Scalar:
+		ret = C.scalar_kt_decodevv_add(s.c, C.int(book), pa, C.long(stride), C.int(ch), C.long(offset), C.int(n), pdata, C.long(len(data)), C.int(bit))
+	}
+	return ret == 0
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libvorbis. This declares the kernels of the Vorbis decoder compiled twice from the
+// patched libvorbis sources: vectorized_*, with the same macros and flags as the decoder, and scalar_*, without the
+// vector extensions and the auto-vectorization.
+
+#ifndef KERNELTEST_H
+#define KERNELTEST_H
+
+/* kt_state is the decoder state of a stream's headers, of which the kernels use the lookups and the codebooks. */
+typedef struct kt_state kt_state;
+
+kt_state *kt_state_create(unsigned char *const *headers, const long *sizes);
+void kt_state_destroy(kt_state *s);
+int kt_blocksize(kt_state *s, int w);
+int kt_floor_type(kt_state *s, int floor);
+int kt_books(kt_state *s);
+
+#define KERNELTEST_DECLARE(v) \
+  void v##_kt_mdct_backward(kt_state *s, int w, float *in, float *out); \
+  int v##_kt_floor1_inverse2(kt_state *s, int w, int floor, int *memo, float *out); \
+  long v##_kt_decodevv_add(kt_state *s, int book, float *a, long stride, int ch, long offset, int n, \
+                           unsigned char *data, long size, int bit);
+
+KERNELTEST_DECLARE(vectorized)
+KERNELTEST_DECLARE(scalar)
+
+#endif /* KERNELTEST_H */
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo
+
+package kerneltest
+
+import (
+	"encoding/binary"
+	"math"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// The files in testdata are the inputs of the kernels captured from the decoder, while decoding stereo.packets of
+// ../testdata. A few calls of each kernel are written at its entry, with the arrays that the kernel reads. The
+// integers and the floats are 32-bit little-endian, and an array is its length followed by its elements:
+//
+//   - mdct.bin: the block size, and the input.
+//   - floor1.bin: W of the block, the index of the floor, the fit values, and the residue multiplied by the floor.
+//   - decodevv.bin: the index of the codebook, the offset, the channels and the number of the values, and the packet
+//     from the bit to read, captured at the call of res2_inverse. The packet is the bit in the first byte and the
+//     bytes from it.
+
+var variants = []Variant{Vectorized, Scalar}
+
+// newState decodes the headers of stereo.packets, whose packets are each preceded by its size as a 16-bit big-endian
+// integer.
+func newState(tb testing.TB) *State {
+	tb.Helper()
+	b, err := os.ReadFile(filepath.Join("..", "testdata", "stereo.packets"))
+	if err != nil {
+		tb.Fatal(err)
+	}
+	var headers [3][]byte
+	for i := range headers {
+		if len(b) < 2 || len(b) < 2+int(binary.BigEndian.Uint16(b)) {
+			tb.Fatal("stereo.packets is truncated")
+		}
+		n := int(binary.BigEndian.Uint16(b))
+		headers[i] = b[2 : 2+n]
+		b = b[2+n:]
+	}
+	s, err := NewState(headers)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	tb.Cleanup(s.Close)
+	return s
+}
+
+type reader struct {
+	tb   testing.TB
+	name string
+	b    []byte
+}
+
+func newReader(tb testing.TB, name string) *reader {
+	tb.Helper()
+	b, err := os.ReadFile(filepath.Join("testdata", name))
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return &reader{tb: tb, name: name, b: b}
+}
+
+func (r *reader) more() bool {
+	return len(r.b) > 0
+}
+
+func (r *reader) next(n int) []byte {
+	if n < 0 || len(r.b) < n {
+		r.tb.Fatalf("%s is truncated", r.name)
+	}
+	b := r.b[:n]
+	r.b = r.b[n:]
+	return b
+}
+
+func (r *reader) i32() int32 {
+	return int32(binary.LittleEndian.Uint32(r.next(4)))
+}
+
+func (r *reader) f32s() []float32 {
+	v := make([]float32, r.i32())
+	for i := range v {
+		v[i] = math.Float32frombits(binary.LittleEndian.Uint32(r.next(4)))
+	}
+	return v
+}
+
+func (r *reader) i32s() []int32 {
+	v := make([]int32, r.i32())
+	for i := range v {
+		v[i] = r.i32()
+	}
+	return v
+}
+
+func (r *reader) u8s() []byte {
+	return r.next(int(r.i32()))
+}
+
+// same reports whether got is want within the error of 1e-5 of the peak of want, as the compiler can contract or
+// reassociate the float operations differently in the variants.
+func same(got, want []float32) bool {
+	if len(got) != len(want) {
+		return false
+	}
+	var peak float64
+	for _, v := range want {
+		peak = max(peak, math.Abs(float64(v)))
+	}
+	for i := range got {
+		if math.Abs(float64(got[i])-float64(want[i])) > 1e-5*peak {
+			return false
+		}
+	}
+	return true
+}
+
+// equal reports whether got is want bit by bit.
+func equal(got, want []float32) bool {
+	if len(got) != len(want) {
+		return false
+	}
+	for i := range got {
+		if math.Float32bits(got[i]) != math.Float32bits(want[i]) {
+			return false
+		}
+	}
+	return true
+}
+
+type mdctInput struct {
+	w  int
+	in []float32
+}
+
+func readMDCT(tb testing.TB, s *State) []mdctInput {
+	r := newReader(tb, "mdct.bin")
+	var inputs []mdctInput
+	for r.more() {
+		n := int(r.i32())
+		c := mdctInput{in: r.f32s()}
+		if n == s.Blocksize(1) {
+			c.w = 1
+		} else if n != s.Blocksize(0) {
+			tb.Fatalf("mdct.bin is broken")
+		}
+		if len(c.in) != n/2 {
+			tb.Fatalf("mdct.bin is broken")
+		}
+		inputs = append(inputs, c)
+	}
+	return inputs
+}
+
+func TestMDCTBackward(t *testing.T) {
+	s := newState(t)
+	for i, c := range readMDCT(t, s) {
+		want := make([]float32, 2*len(c.in))
+		s.MDCTBackward(Scalar, c.w, c.in, want)
+		got := make([]float32, 2*len(c.in))
+		s.MDCTBackward(Vectorized, c.w, c.in, got)
+		if !same(got, want) {
+			t.Errorf("input %d (n: %d): the vectorized IMDCT differs from the scalar one", i, len(got))
+		}
+	}
+}
+
+func BenchmarkMDCTBackward(b *testing.B) {
+	s := newState(b)
+	inputs := readMDCT(b, s)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			out := make([]float32, s.Blocksize(1))
+			for i := range b.N {
+				c := inputs[i%len(inputs)]
+				s.MDCTBackward(v, c.w, c.in, out)
+			}
+		})
+	}
+}
+
+type floor1Input struct {
+	w, floor int
+	memo     []int32
+	out      []float32
+}
+
+func readFloor1(tb testing.TB, s *State) []floor1Input {
+	r := newReader(tb, "floor1.bin")
+	var inputs []floor1Input
+	for r.more() {
+		c := floor1Input{w: int(r.i32()), floor: int(r.i32()), memo: r.i32s(), out: r.f32s()}
+		if len(c.out) != s.Blocksize(c.w)/2 {
+			tb.Fatalf("floor1.bin is broken")
+		}
+		inputs = append(inputs, c)
+	}
+	return inputs
+}
+
+func TestFloor1Inverse2(t *testing.T) {
+	s := newState(t)
+	for i, c := range readFloor1(t, s) {
+		want := append([]float32(nil), c.out...)
+		s.Floor1Inverse2(Scalar, c.w, c.floor, c.memo, want)
+		got := append([]float32(nil), c.out...)
+		s.Floor1Inverse2(Vectorized, c.w, c.floor, c.memo, got)
+		// Each sample is multiplied by the same value of the lookup, so the variants must be bit-exact.
+		if !equal(got, want) {
+			t.Errorf("input %d (W: %d, floor: %d): the vectorized floor differs from the scalar one", i, c.w, c.floor)
+		}
+	}
+}
+
+func BenchmarkFloor1Inverse2(b *testing.B) {
+	s := newState(b)
+	inputs := readFloor1(b, s)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			out := make([]float32, s.Blocksize(1)/2)
+			for i := range b.N {
+				c := inputs[i%len(inputs)]
+				copy(out, c.out)
+				s.Floor1Inverse2(v, c.w, c.floor, c.memo, out[:len(c.out)])
+			}
+		})
+	}
+}
+
+type decodevvInput struct {
+	book, offset, ch, n, bit int
+	data                     []byte
+}
+
+func readDecodevv(tb testing.TB) []decodevvInput {
+	r := newReader(tb, "decodevv.bin")
+	var inputs []decodevvInput
+	for r.more() {
+		inputs = append(inputs, decodevvInput{
+			book:   int(r.i32()),
+			offset: int(r.i32()),
+			ch:     int(r.i32()),
+			n:      int(r.i32()),
+			bit:    int(r.i32()),
+			data:   r.u8s(),
+		})
+	}
+	return inputs
+}
+
+func TestBookDecodevvAdd(t *testing.T) {
+	s := newState(t)
+	stride := s.Blocksize(1) / 2
+	for i, c := range readDecodevv(t) {
+		want := make([]float32, c.ch*stride)
+		wantOK := s.BookDecodevvAdd(Scalar, c.book, want, stride, c.ch, c.offset, c.n, c.data, c.bit)
+		got := make([]float32, c.ch*stride)
+		gotOK := s.BookDecodevvAdd(Vectorized, c.book, got, stride, c.ch, c.offset, c.n, c.data, c.bit)
+		if gotOK != wantOK {
+			t.Errorf("input %d (book: %d): the vectorized decoding succeeds: %t, the scalar one succeeds: %t", i, c.book, gotOK, wantOK)
+			continue
+		}
+		// The values are added to zeros, so the variants must be bit-exact.
+		if !equal(got, want) {
+			t.Errorf("input %d (book: %d, offset: %d, n: %d): the vectorized decoding differs from the scalar one", i, c.book, c.offset, c.n)
+		}
+	}
+}
+
+func BenchmarkBookDecodevvAdd(b *testing.B) {
+	s := newState(b)
+	stride := s.Blocksize(1) / 2
+	inputs := readDecodevv(b)
+	for _, v := range variants {
+		b.Run(v.String(), func(b *testing.B) {
+			a := make([]float32, 2*stride)
+			for i := range b.N {
+				c := inputs[i%len(inputs)]
+				s.BookDecodevvAdd(v, c.book, a, stride, c.ch, c.offset, c.n, c.data, c.bit)
+			}
+		})
+	}
+}
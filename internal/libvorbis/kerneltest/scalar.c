@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo
+
+// This file is not a part of libvorbis. This compiles the kernels as the scalar references of the vectorized ones:
+// vorbis_simd.h sees neither SSE2 nor NEON, vorbis_book_decodevv_add is upstream's, and GCC doesn't auto-vectorize
+// the loops. Clang has no pragma for the last, so its references can still be auto-vectorized.
+
+#undef __SSE2__
+#undef __ARM_NEON
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("no-tree-vectorize")
+#endif
+
+#define KERNEL(name) scalar_##name
+#define KT_UPSTREAM_DECODEVV_ADD
+#include "kernels.inc"
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo
+
+// This file is not a part of libvorbis. This sets the decoder state up with the decoder's functions.
+
+#include <stdlib.h>
+#include <string.h>
+#include "codec_internal.h"
+#include "state.h"
+
+kt_state *kt_state_create(unsigned char *const *headers, const long *sizes){
+  kt_state *s=calloc(1,sizeof(*s));
+  int i;
+  if(!s)return NULL;
+  vorbis_info_init(&s->vi);
+  vorbis_comment_init(&s->vc);
+  for(i=0;i<3;i++){
+    ogg_packet op;
+    memset(&op,0,sizeof(op));
+    op.packet=headers[i];
+    op.bytes=sizes[i];
+    op.b_o_s=i==0;
+    op.packetno=i;
+    if(vorbis_synthesis_headerin(&s->vi,&s->vc,&op))goto err;
+  }
+  if(vorbis_synthesis_init(&s->vd,&s->vi))goto err;
+  if(vorbis_block_init(&s->vd,&s->vb)){
+    vorbis_dsp_clear(&s->vd);
+    goto err;
+  }
+  return s;
+ err:
+  vorbis_comment_clear(&s->vc);
+  vorbis_info_clear(&s->vi);
+  free(s);
+  return NULL;
+}
+
+void kt_state_destroy(kt_state *s){
+  vorbis_block_clear(&s->vb);
+  vorbis_dsp_clear(&s->vd);
+  vorbis_comment_clear(&s->vc);
+  vorbis_info_clear(&s->vi);
+  free(s);
+}
+
+int kt_blocksize(kt_state *s, int w){
+  codec_setup_info *ci=s->vi.codec_setup;
+  return ci->blocksizes[w];
+}
+
+int kt_floor_type(kt_state *s, int floor){
+  codec_setup_info *ci=s->vi.codec_setup;
+  if(floor<0 || floor>=ci->floors)return -1;
+  return ci->floor_type[floor];
+}
+
+int kt_books(kt_state *s){
+  codec_setup_info *ci=s->vi.codec_setup;
+  return ci->books;
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libvorbis.
+
+#ifndef KERNELTEST_STATE_H
+#define KERNELTEST_STATE_H
+
+#include "vorbis_codec.h"
+#include "kerneltest.h"
+
+struct kt_state {
+  vorbis_info vi;
+  vorbis_comment vc;
+  vorbis_dsp_state vd;
+  vorbis_block vb;
+};
+
+#endif /* KERNELTEST_STATE_H */
@@ -0,0 +1,9 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build cgo
+
+// This file is not a part of libvorbis. This compiles the kernels as the decoder does.
+
+#define KERNEL(name) vectorized_##name
+#include "kernels.inc"
@@ -24,4 +24,9 @@ extern void vorbis_lsp_to_curve(float *curve,int *map,int n,int ln,
                                 float *lsp,int m,
                                 float amp,float ampoffset);
 
+extern void vorbis_lsp_curve_init(float *wcos,int ln);
+extern void vorbis_lsp_to_curve_cached(float *curve,const int *map,int n,
+                                       const float *wcos,float *lsp,int m,
+                                       float amp,float ampoffset);
+
 #endif
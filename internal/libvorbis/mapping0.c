@@ -1,3 +1,5 @@
+//go:build !webmplayerprebuilt
+
 /********************************************************************
  *                                                                  *
  * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
@@ -695,6 +697,33 @@ static int mapping0_forward(vorbis_block *vb){
   return(0);
 }
 
+/* compute and apply spectral envelope, and transform the PCM data of the
+   channels from first to last */
+static void mapping0_inverse_channels(vorbis_block *vb,
+                                      vorbis_info_mapping0 *info,
+                                      void **floormemo,int first,int last){
+  vorbis_dsp_state     *vd=vb->vd;
+  vorbis_info          *vi=vd->vi;
+  codec_setup_info     *ci=vi->codec_setup;
+  private_state        *b=vd->backend_state;
+  int                   i;
+
+  for(i=first;i<last;i++){
+    float *pcm=vb->pcm[i];
+    int submap=info->chmuxlist[i];
+    _floor_P[ci->floor_type[info->floorsubmap[submap]]]->
+      inverse2(vb,b->flr[info->floorsubmap[submap]],
+               floormemo[i],pcm);
+  }
+
+  /* transform the PCM data; takes PCM vector, vb; modifies PCM vector */
+  /* only MDCT right now.... */
+  for(i=first;i<last;i++){
+    float *pcm=vb->pcm[i];
+    mdct_backward(b->transform[vb->W][0],pcm,pcm);
+  }
+}
+
 static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){
   vorbis_dsp_state     *vd=vb->vd;
   vorbis_info          *vi=vd->vi;
@@ -711,6 +740,8 @@ static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){
   int   *nonzero  =alloca(sizeof(*nonzero)*vi->channels);
   void **floormemo=alloca(sizeof(*floormemo)*vi->channels);
 
+  b->deferred=NULL;
+
   /* recover the spectral envelope; store it in the PCM vector for now */
   for(i=0;i<vi->channels;i++){
     int submap=info->chmuxlist[i];
@@ -750,12 +781,13 @@ static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){
               pcmbundle,zerobundle,ch_in_bundle);
   }
 
-  /* channel coupling */
+  /* channel coupling; the reduced rates use only the lower part of the
+     spectrum */
   for(i=info->coupling_steps-1;i>=0;i--){
     float *pcmM=vb->pcm[info->coupling_mag[i]];
     float *pcmA=vb->pcm[info->coupling_ang[i]];
 
-    for(j=0;j<n/2;j++){
+    for(j=0;j<(n/2)>>ci->halfrate_flag;j++){
       float mag=pcmM[j];
       float ang=pcmA[j];
 
@@ -778,26 +810,52 @@ static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){
     }
   }
 
-  /* compute and apply spectral envelope */
-  for(i=0;i<vi->channels;i++){
-    float *pcm=vb->pcm[i];
-    int submap=info->chmuxlist[i];
-    _floor_P[ci->floor_type[info->floorsubmap[submap]]]->
-      inverse2(vb,b->flr[info->floorsubmap[submap]],
-               floormemo[i],pcm);
+  /* the floors and the MDCTs of the channels are independent, and are left
+     to vorbis_synthesis_channels with vorbis_synthesis_defer_channels.
+     floor0 builds its lookup on the first use, so a block with floor0 is
+     finished here. */
+  if(b->defer_channels){
+    for(i=0;i<info->submaps;i++)
+      if(ci->floor_type[info->floorsubmap[i]]!=1)break;
+    if(i==info->submaps){
+      b->deferred_floormemo=
+        _vorbis_block_alloc(vb,sizeof(*floormemo)*vi->channels);
+      memcpy(b->deferred_floormemo,floormemo,sizeof(*floormemo)*vi->channels);
+      b->deferred_map=info;
+      b->deferred=vb;
+      return(0);
+    }
   }
 
-  /* transform the PCM data; takes PCM vector, vb; modifies PCM vector */
-  /* only MDCT right now.... */
-  for(i=0;i<vi->channels;i++){
-    float *pcm=vb->pcm[i];
-    mdct_backward(b->transform[vb->W][0],pcm,pcm);
-  }
+  mapping0_inverse_channels(vb,info,floormemo,0,vi->channels);
 
   /* all done! */
   return(0);
 }
 
+/* vorbis_synthesis_defer_channels makes vorbis_synthesis leave the floors
+   and the MDCTs of the channels to vorbis_synthesis_channels, which can run
+   for separate channels at the same time. vorbis_synthesis_deferred_p
+   reports whether the last vorbis_synthesis of vb left them, and
+   vorbis_synthesis_blockin must be called after all the channels are
+   done. */
+void vorbis_synthesis_defer_channels(vorbis_dsp_state *v,int flag){
+  private_state *b=v->backend_state;
+  b->defer_channels=flag;
+}
+
+int vorbis_synthesis_deferred_p(vorbis_block *vb){
+  private_state *b=vb->vd->backend_state;
+  return b->deferred==vb;
+}
+
+void vorbis_synthesis_channels(vorbis_block *vb,int first,int last){
+  private_state *b=vb->vd->backend_state;
+  if(b->deferred==vb)
+    mapping0_inverse_channels(vb,b->deferred_map,b->deferred_floormemo,
+                              first,last);
+}
+
 /* export hooks */
 const vorbis_func_mapping mapping0_exportbundle={
   &mapping0_pack,
@@ -60,6 +60,9 @@ typedef struct {
   int       *bitrev;
 
   DATA_TYPE scale;
+
+  /* shared is 1 if trig and bitrev are shared by all the lookups of n. */
+  int       shared;
 } mdct_lookup;
 
 extern void mdct_init(mdct_lookup *lookup,int n);
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libvorbis. This is included only from mdct.c, and defines mdct_backward.
+//
+// The stages follow mdct_backward_c in mdct.c, with four samples processed at once. See vorbis_simd.h.
+
+#include "vorbis_simd.h"
+
+#if !defined(MDCT_INTEGERIZED) && defined(VORBIS_SIMD)
+#define MDCT_SIMD
+#endif
+
+#ifdef MDCT_SIMD
+
+/* Loads {p0[0], p0[1], p1[0], p1[1]}. */
+STIN vorbis_v4sf mdct_load2x2(const float *p0, const float *p1){
+  return (vorbis_v4sf){p0[0], p0[1], p1[0], p1[1]};
+}
+
+/* Multiplies the complex pairs {re, im} of d by the conjugates of the pairs of t. */
+STIN vorbis_v4sf mdct_cmul_conj(vorbis_v4sf d, vorbis_v4sf t){
+  const vorbis_v4sf sign = {1, -1, 1, -1};
+  vorbis_v4sf tr = VORBIS_SHUFFLE(t, t, 0, 0, 2, 2);
+  vorbis_v4sf ti = VORBIS_SHUFFLE(t, t, 1, 1, 3, 3);
+  vorbis_v4sf ds = VORBIS_SHUFFLE(d, d, 1, 0, 3, 2);
+  return d * tr + ds * ti * sign;
+}
+
+/* The same as mdct_butterfly_generic. mdct_butterfly_first is the case of trigint = 4. */
+STIN void mdct_butterfly_generic_simd(const float *T, float *x, int points, int trigint){
+  float *x1 = x + points      - 8;
+  float *x2 = x + (points>>1) - 8;
+
+  do{
+    vorbis_v4sf a0 = vorbis_load4(x1);
+    vorbis_v4sf a1 = vorbis_load4(x1+4);
+    vorbis_v4sf b0 = vorbis_load4(x2);
+    vorbis_v4sf b1 = vorbis_load4(x2+4);
+
+    vorbis_store4(x1,   a0 + b0);
+    vorbis_store4(x1+4, a1 + b1);
+
+    /* x2[6..7] uses T[0..1], x2[4..5] uses T[trigint..], and so on. */
+    vorbis_store4(x2,   mdct_cmul_conj(a0 - b0, mdct_load2x2(T+trigint*3, T+trigint*2)));
+    vorbis_store4(x2+4, mdct_cmul_conj(a1 - b1, mdct_load2x2(T+trigint, T)));
+
+    T  += trigint*4;
+    x1 -= 8;
+    x2 -= 8;
+  }while(x2>=x);
+}
+
+STIN void mdct_butterflies_simd(mdct_lookup *init, float *x, int points){
+  float *T   = init->trig;
+  int stages = init->log2n-5;
+  int i,j;
+
+  if(--stages>0){
+    mdct_butterfly_generic_simd(T,x,points,4);
+  }
+
+  for(i=1;--stages>0;i++){
+    for(j=0;j<(1<<i);j++)
+      mdct_butterfly_generic_simd(T,x+(points>>i)*j,points>>i,4<<i);
+  }
+
+  for(j=0;j<points;j+=32)
+    mdct_butterfly_32(x+j);
+}
+
+STIN void mdct_bitreverse_simd(mdct_lookup *init, float *x){
+  const vorbis_v4sf sign = {1, -1, 1, -1};
+  int    n   = init->n;
+  int   *bit = init->bitrev;
+  float *w0  = x;
+  float *w1  = x = w0+(n>>1);
+  float *T   = init->trig+n;
+
+  do{
+    /* Two pairs of {x0, x1} at once. */
+    vorbis_v4sf a  = mdct_load2x2(x+bit[0], x+bit[2]);
+    vorbis_v4sf b  = mdct_load2x2(x+bit[1], x+bit[3]);
+    vorbis_v4sf s  = a + b;
+    vorbis_v4sf d  = a - b;
+    vorbis_v4sf t  = vorbis_load4(T);
+    vorbis_v4sf r1 = VORBIS_SHUFFLE(s, s, 0, 0, 2, 2);
+    vorbis_v4sf r0 = VORBIS_SHUFFLE(d, d, 1, 1, 3, 3);
+
+    /* {r2, r3} of the two pairs. */
+    vorbis_v4sf r  = r1 * t + r0 * VORBIS_SHUFFLE(t, t, 1, 0, 3, 2) * sign;
+    vorbis_v4sf h  = VORBIS_SHUFFLE(s, d, 1, 4, 3, 6) * .5f;
+    vorbis_v4sf q  = (h - r) * sign;
+
+    w1 -= 4;
+    vorbis_store4(w0, h + r);
+    vorbis_store4(w1, VORBIS_SHUFFLE(q, q, 2, 3, 0, 1));
+
+    T   += 4;
+    bit += 4;
+    w0  += 4;
+  }while(w0<w1);
+}
+
+STIN void mdct_backward_simd(mdct_lookup *init, float *in, float *out){
+  int n=init->n;
+  int n2=n>>1;
+  int n4=n>>2;
+
+  /* rotate */
+
+  float *iX = in+n2-7;
+  float *oX = out+n2+n4;
+  float *T  = init->trig+n4;
+
+  do{
+    /* iX[-1] is always in the range as iX >= in+1. */
+    vorbis_v4sf e = VORBIS_SHUFFLE(vorbis_load4(iX-1), vorbis_load4(iX+3), 1, 3, 5, 7);
+    vorbis_v4sf t = vorbis_load4(T);
+    const vorbis_v4sf sign = {-1, 1, -1, 1};
+    oX -= 4;
+    vorbis_store4(oX, VORBIS_SHUFFLE(e, e, 1, 0, 3, 2) * VORBIS_SHUFFLE(t, t, 3, 3, 1, 1) * sign -
+                      e * VORBIS_SHUFFLE(t, t, 2, 2, 0, 0));
+    iX -= 8;
+    T  += 4;
+  }while(iX>=in);
+
+  iX = in+n2-8;
+  oX = out+n2+n4;
+  T  = init->trig+n4;
+
+  do{
+    vorbis_v4sf e = VORBIS_SHUFFLE(vorbis_load4(iX), vorbis_load4(iX+4), 0, 2, 4, 6);
+    vorbis_v4sf t;
+    const vorbis_v4sf sign = {1, -1, 1, -1};
+    T -= 4;
+    t = vorbis_load4(T);
+    vorbis_store4(oX, VORBIS_SHUFFLE(e, e, 2, 2, 0, 0) * VORBIS_SHUFFLE(t, t, 3, 2, 1, 0) +
+                      VORBIS_SHUFFLE(e, e, 3, 3, 1, 1) * VORBIS_SHUFFLE(t, t, 2, 3, 0, 1) * sign);
+    iX -= 8;
+    oX += 4;
+  }while(iX>=in);
+
+  mdct_butterflies_simd(init,out+n2,n2);
+  mdct_bitreverse_simd(init,out);
+
+  /* rotate + window */
+
+  {
+    float *oX1=out+n2+n4;
+    float *oX2=out+n2+n4;
+    float *iX =out;
+    T         =init->trig+n2;
+
+    do{
+      vorbis_v4sf i0 = vorbis_load4(iX);
+      vorbis_v4sf i1 = vorbis_load4(iX+4);
+      vorbis_v4sf t0 = vorbis_load4(T);
+      vorbis_v4sf t1 = vorbis_load4(T+4);
+      vorbis_v4sf ie = VORBIS_SHUFFLE(i0, i1, 0, 2, 4, 6);
+      vorbis_v4sf io = VORBIS_SHUFFLE(i0, i1, 1, 3, 5, 7);
+      vorbis_v4sf te = VORBIS_SHUFFLE(t0, t1, 0, 2, 4, 6);
+      vorbis_v4sf to = VORBIS_SHUFFLE(t0, t1, 1, 3, 5, 7);
+      vorbis_v4sf p  = ie * to - io * te;
+
+      oX1-=4;
+      vorbis_store4(oX1, VORBIS_REVERSE(p));
+      vorbis_store4(oX2, -(ie * te + io * to));
+
+      oX2+=4;
+      iX +=8;
+      T  +=8;
+    }while(iX<oX1);
+
+    iX=out+n2+n4;
+    oX1=out+n4;
+    oX2=oX1;
+
+    do{
+      vorbis_v4sf v;
+      oX1-=4;
+      iX-=4;
+
+      v = vorbis_load4(iX);
+      vorbis_store4(oX1, v);
+      vorbis_store4(oX2, -VORBIS_REVERSE(v));
+
+      oX2+=4;
+    }while(oX2<iX);
+
+    iX=out+n2+n4;
+    oX1=out+n2+n4;
+    oX2=out+n2;
+    do{
+      vorbis_v4sf v = vorbis_load4(iX);
+      oX1-=4;
+      vorbis_store4(oX1, VORBIS_REVERSE(v));
+      iX+=4;
+    }while(oX1>oX2);
+  }
+}
+
+#endif /* MDCT_SIMD */
+
+void mdct_backward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){
+#ifdef MDCT_SIMD
+  mdct_backward_simd(init,in,out);
+#else
+  mdct_backward_c(init,in,out);
+#endif
+}
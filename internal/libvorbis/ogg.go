@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libvorbis
+
+// #include <stdlib.h>
+// #include "vorbis_codec.h"
+import "C"
+
+import (
+	"runtime"
+	"unsafe"
+)
+
+// SyncState finds the pages of an Ogg stream in the data written to its buffer, as ogg_sync_state of libogg.
+type SyncState struct {
+	c *C.ogg_sync_state
+}
+
+// Page is a page found by SyncState or made by StreamState. Header and Body refer to the buffer of the SyncState or
+// the StreamState.
+type Page struct {
+	Header []byte
+	Body   []byte
+}
+
+func SyncInit() *SyncState {
+	c := (*C.ogg_sync_state)(C.calloc(1, C.size_t(unsafe.Sizeof(C.ogg_sync_state{}))))
+	C.ogg_sync_init(c)
+	s := &SyncState{c: c}
+	runtime.SetFinalizer(s, (*SyncState).Clear)
+	return s
+}
+
+// Clear frees the SyncState. Clear is called when s is finalized, and can be called more than once.
+func (s *SyncState) Clear() {
+	if s.c == nil {
+		return
+	}
+	C.ogg_sync_clear(s.c)
+	C.free(unsafe.Pointer(s.c))
+	s.c = nil
+	runtime.SetFinalizer(s, nil)
+}
+
+// Reset discards the data in the buffer, e.g. for seeking.
+func (s *SyncState) Reset() {
+	defer runtime.KeepAlive(s)
+	C.ogg_sync_reset(s.c)
+}
+
+// Buffer returns the buffer of size bytes to read the next data into, so that the data is not copied into libogg.
+// The data read into the buffer must be reported by Wrote.
+// Buffer moves the data in the buffer, which invalidates the Pages found before.
+func (s *SyncState) Buffer(size int) []byte {
+	defer runtime.KeepAlive(s)
+	p := C.ogg_sync_buffer(s.c, C.long(size))
+	if p == nil {
+		return nil
+	}
+	return unsafe.Slice((*byte)(unsafe.Pointer(p)), size)
+}
+
+// Wrote reports that n bytes are read into the buffer returned by Buffer.
+func (s *SyncState) Wrote(n int) error {
+	defer runtime.KeepAlive(s)
+	if C.ogg_sync_wrote(s.c, C.long(n)) != 0 {
+		return ErrInval
+	}
+	return nil
+}
+
+// PageSeek finds the next page at the start of the data in the buffer, as ogg_sync_pageseek.
+// If a page is found, PageSeek returns the page and its size. The page is valid until Buffer or Reset is called.
+// PageSeek returns 0 if more data is needed, or the negative number of the bytes skipped if the data is not a page.
+func (s *SyncState) PageSeek() (Page, int) {
+	defer runtime.KeepAlive(s)
+	var og C.ogg_page
+	n := int(C.ogg_sync_pageseek(s.c, &og))
+	if n <= 0 {
+		return Page{}, n
+	}
+	return Page{
+		Header: unsafe.Slice((*byte)(unsafe.Pointer(og.header)), int(og.header_len)),
+		Body:   unsafe.Slice((*byte)(unsafe.Pointer(og.body)), int(og.body_len)),
+	}, n
+}
+
+// PacketBlocksize returns the block size of the audio packet of the stream of vi, as vorbis_packet_blocksize.
+// PacketBlocksize returns an error if the packet is not an audio packet.
+func PacketBlocksize(vi *Info, packet []byte) (int, error) {
+	var pinner runtime.Pinner
+	defer pinner.Unpin()
+	op := &OggPacket{Packet: packet}
+	defer runtime.KeepAlive(vi)
+	n := C.vorbis_packet_blocksize(&vi.c, op.c(&pinner))
+	if n < 0 {
+		return 0, Error(n)
+	}
+	return int(n), nil
+}
+
+// StreamState makes the pages of a logical Ogg stream from its packets, as ogg_stream_state of libogg does for
+// encoding.
+type StreamState struct {
+	c *C.ogg_stream_state
+}
+
+func StreamInit(serial int) (*StreamState, error) {
+	c := (*C.ogg_stream_state)(C.calloc(1, C.size_t(unsafe.Sizeof(C.ogg_stream_state{}))))
+	if C.ogg_stream_init(c, C.int(serial)) != 0 {
+		C.free(unsafe.Pointer(c))
+		return nil, ErrFault
+	}
+	s := &StreamState{c: c}
+	runtime.SetFinalizer(s, (*StreamState).Clear)
+	return s, nil
+}
+
+// Clear frees the StreamState. Clear is called when s is finalized, and can be called more than once.
+func (s *StreamState) Clear() {
+	if s.c == nil {
+		return
+	}
+	C.ogg_stream_clear(s.c)
+	C.free(unsafe.Pointer(s.c))
+	s.c = nil
+	runtime.SetFinalizer(s, nil)
+}
+
+// PacketIn adds the packet to the stream, as ogg_stream_packetin. The data of the packet is copied into libogg.
+func (s *StreamState) PacketIn(op *OggPacket) error {
+	var pinner runtime.Pinner
+	defer pinner.Unpin()
+	defer runtime.KeepAlive(s)
+	if C.ogg_stream_packetin(s.c, op.c(&pinner)) != 0 {
+		return ErrFault
+	}
+	return nil
+}
+
+// PageOut returns the next page if enough packets are added for it, as ogg_stream_pageout. The page is valid until
+// PacketIn, PageOut or Flush is called.
+func (s *StreamState) PageOut() (Page, bool) {
+	defer runtime.KeepAlive(s)
+	var og C.ogg_page
+	if C.ogg_stream_pageout(s.c, &og) == 0 {
+		return Page{}, false
+	}
+	return streamPage(&og), true
+}
+
+// Flush returns a page of the packets added but not in a page yet, as ogg_stream_flush, e.g. so that the headers end
+// their pages. The page is valid until PacketIn, PageOut or Flush is called.
+func (s *StreamState) Flush() (Page, bool) {
+	defer runtime.KeepAlive(s)
+	var og C.ogg_page
+	if C.ogg_stream_flush(s.c, &og) == 0 {
+		return Page{}, false
+	}
+	return streamPage(&og), true
+}
+
+func streamPage(og *C.ogg_page) Page {
+	return Page{
+		Header: unsafe.Slice((*byte)(unsafe.Pointer(og.header)), int(og.header_len)),
+		Body:   unsafe.Slice((*byte)(unsafe.Pointer(og.body)), int(og.body_len)),
+	}
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libogg. This defines the carry-less multiplication kernel of the page checksum used
+// from the patched framing.c.
+//
+// The Ogg CRC is not bit-reflected, so the CRC32 instructions of SSE4.2 and ARMv8, which are for the reflected
+// polynomials, don't apply. Instead, the kernel folds the data with PCLMULQDQ by 64 bytes at once, and leaves the
+// last 16 bytes to the table-driven code. PCLMULQDQ is not available on every amd64 CPU, so the kernel is selected
+// at runtime. The kernel has no state, so it is safe to call from any thread.
+
+#ifndef _OGG_CRC_SIMD_H_
+#define _OGG_CRC_SIMD_H_
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define OGG_CRC_CLMUL
+#endif
+
+#ifdef OGG_CRC_CLMUL
+
+#include <immintrin.h>
+
+/* The size from which the kernel is faster than the table-driven code. */
+#define OGG_CRC_CLMUL_MIN 64
+
+#define OGG_CRC_TARGET __attribute__((target("pclmul,ssse3")))
+
+static int ogg_crc_clmul_available(void){
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+/* Reverses the bytes so that the first byte is the most significant, as the CRC is not bit-reflected. */
+OGG_CRC_TARGET static inline __m128i ogg_crc_reverse(__m128i v){
+  return _mm_shuffle_epi8(v,_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15));
+}
+
+OGG_CRC_TARGET static inline __m128i ogg_crc_load(const unsigned char *p){
+  return ogg_crc_reverse(_mm_loadu_si128((const __m128i *)p));
+}
+
+/* Moves v by the distance of k, where the high and low halves of k are x^(N+64) and x^N mod the polynomial. */
+OGG_CRC_TARGET static inline __m128i ogg_crc_mul(__m128i v,__m128i k){
+  return _mm_xor_si128(_mm_clmulepi64_si128(v,k,0x11),_mm_clmulepi64_si128(v,k,0x00));
+}
+
+/* Folds at least 16 bytes of buffer with the initial crc into 16 bytes whose CRC from 0 is the CRC of the folded
+   bytes. Returns the number of the folded bytes, which is a multiple of 16. */
+OGG_CRC_TARGET static int ogg_crc_fold(ogg_uint32_t crc,const unsigned char *buffer,int size,
+                                       unsigned char folded[16]){
+  const __m128i k128=_mm_set_epi64x(0xc5b9cd4c,0xe8a45605);
+  const __m128i k512=_mm_set_epi64x(0x8833794c,0xe6228b11);
+  __m128i a=_mm_xor_si128(ogg_crc_load(buffer),_mm_set_epi32((int)crc,0,0,0));
+  int n=16;
+
+  if(size>=128){
+    __m128i b=ogg_crc_load(buffer+16);
+    __m128i c=ogg_crc_load(buffer+32);
+    __m128i d=ogg_crc_load(buffer+48);
+    for(n=64;n+64<=size;n+=64){
+      a=_mm_xor_si128(ogg_crc_mul(a,k512),ogg_crc_load(buffer+n));
+      b=_mm_xor_si128(ogg_crc_mul(b,k512),ogg_crc_load(buffer+n+16));
+      c=_mm_xor_si128(ogg_crc_mul(c,k512),ogg_crc_load(buffer+n+32));
+      d=_mm_xor_si128(ogg_crc_mul(d,k512),ogg_crc_load(buffer+n+48));
+    }
+    a=_mm_xor_si128(ogg_crc_mul(a,k128),b);
+    a=_mm_xor_si128(ogg_crc_mul(a,k128),c);
+    a=_mm_xor_si128(ogg_crc_mul(a,k128),d);
+  }
+  for(;n+16<=size;n+=16)
+    a=_mm_xor_si128(ogg_crc_mul(a,k128),ogg_crc_load(buffer+n));
+
+  _mm_storeu_si128((__m128i *)folded,ogg_crc_reverse(a));
+  return n;
+}
+
+#endif /* OGG_CRC_CLMUL */
+
+#endif /* _OGG_CRC_SIMD_H_ */
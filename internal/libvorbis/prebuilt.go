@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayerprebuilt
+
+package libvorbis
+
+// With the build tag webmplayerprebuilt, the C files are not compiled, and the objects in the prebuilt directory are
+// linked instead. The objects are built by 'go run gen.go -prebuilt GOOS/GOARCH,...'.
+
+import _ "github.com/hajimehoshi/webmplayer/internal/libvorbis/prebuilt"
@@ -1,3 +1,5 @@
+//go:build !webmplayerprebuilt
+
 /********************************************************************
  *                                                                  *
  * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
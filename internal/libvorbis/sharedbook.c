@@ -1,3 +1,5 @@
+//go:build !webmplayerprebuilt
+
 /********************************************************************
  *                                                                  *
  * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
@@ -400,9 +402,10 @@ int vorbis_book_init_decode(codebook *c,const static_codebook *s){
       c->dec_firsttable[0]=c->dec_firsttable[1]=1;
 
     }else{
-      c->dec_firsttablen=ov_ilog(c->used_entries)-4; /* this is magic */
+      /* cover all the codewords with the direct lookup as far as the table is small enough */
+      c->dec_firsttablen=c->dec_maxlength;
       if(c->dec_firsttablen<5)c->dec_firsttablen=5;
-      if(c->dec_firsttablen>8)c->dec_firsttablen=8;
+      if(c->dec_firsttablen>10)c->dec_firsttablen=10;
 
       tabn=1<<c->dec_firsttablen;
       c->dec_firsttable=_ogg_calloc(tabn,sizeof(*c->dec_firsttable));
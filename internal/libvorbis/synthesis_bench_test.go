@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package libvorbis
+
+import (
+	"encoding/binary"
+	"os"
+	"path/filepath"
+	"runtime"
+	"testing"
+)
+
+// readPackets reads the packets of a file in testdata. The files are the packets of the streams encoded by libvorbis,
+// each preceded by its size as a 16-bit big-endian integer. The first three packets are the headers.
+//
+//   - stereo.packets: 2 seconds of stereo music at 44.1 kHz with the quality 0.3.
+func readPackets(tb testing.TB, name string) [][]byte {
+	tb.Helper()
+	b, err := os.ReadFile(filepath.Join("testdata", name))
+	if err != nil {
+		tb.Fatal(err)
+	}
+	var packets [][]byte
+	for len(b) > 0 {
+		if len(b) < 2 || len(b) < 2+int(binary.BigEndian.Uint16(b)) {
+			tb.Fatalf("%s is truncated", name)
+		}
+		n := int(binary.BigEndian.Uint16(b))
+		packets = append(packets, b[2:2+n:2+n])
+		b = b[2+n:]
+	}
+	if len(packets) < 3 {
+		tb.Fatalf("%s has no headers", name)
+	}
+	return packets
+}
+
+// synthesisInit reads the headers of packets, and returns the states to decode the rest.
+func synthesisInit(tb testing.TB, packets [][]byte) (*Info, *DspState, *Block) {
+	tb.Helper()
+	vi := InfoInit()
+	vc := CommentInit()
+	defer vc.Clear()
+	for i, p := range packets[:3] {
+		if err := SynthesisHeaderin(vi, vc, &OggPacket{Packet: p, BOS: i == 0, PacketNo: int64(i)}); err != nil {
+			tb.Fatal(err)
+		}
+	}
+	vd, err := SynthesisInit(vi)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	vb, err := BlockInit(vd)
+	if err != nil {
+		tb.Fatal(err)
+	}
+	return vi, vd, vb
+}
+
+// measurePackets calls decode for b.N packets, and reports the decoded samples per channel per second, the time and
+// the allocations per packet. decode decodes the i-th packet, and returns the number of decoded samples per channel.
+func measurePackets(b *testing.B, decode func(i int) int) {
+	var m0, m1 runtime.MemStats
+	runtime.ReadMemStats(&m0)
+	var samples int
+	b.ResetTimer()
+	for i := range b.N {
+		samples += decode(i)
+	}
+	b.StopTimer()
+	runtime.ReadMemStats(&m1)
+
+	b.ReportMetric(float64(samples)/b.Elapsed().Seconds(), "samples/s")
+	b.ReportMetric(float64(b.Elapsed().Nanoseconds())/float64(b.N), "ns/packet")
+	b.ReportMetric(float64(m1.Mallocs-m0.Mallocs)/float64(b.N), "allocs/packet")
+}
+
+func BenchmarkSynthesis(b *testing.B) {
+	packets := readPackets(b, "stereo.packets")
+	vi, vd, vb := synthesisInit(b, packets)
+	defer vi.Clear()
+	defer vd.Clear()
+	defer vb.Clear()
+
+	audio := packets[3:]
+	measurePackets(b, func(i int) int {
+		// The stream restarts after the last packet.
+		if i > 0 && i%len(audio) == 0 {
+			if err := SynthesisRestart(vd); err != nil {
+				b.Fatal(err)
+			}
+		}
+		op := &OggPacket{Packet: audio[i%len(audio)], GranulePos: -1, PacketNo: int64(3 + i)}
+		if err := Synthesis(vb, op); err != nil {
+			b.Fatal(err)
+		}
+		if err := SynthesisBlockin(vd, vb); err != nil {
+			b.Fatal(err)
+		}
+		pcm := SynthesisPcmout(vd)
+		if len(pcm) == 0 {
+			return 0
+		}
+		if err := SynthesisRead(vd, len(pcm[0])); err != nil {
+			b.Fatal(err)
+		}
+		return len(pcm[0])
+	})
+}
@@ -215,6 +215,9 @@ extern long     vorbis_packet_blocksize(vorbis_info *vi,ogg_packet *op);
 
 extern int      vorbis_synthesis_halfrate(vorbis_info *v,int flag);
 extern int      vorbis_synthesis_halfrate_p(vorbis_info *v);
+extern void     vorbis_synthesis_defer_channels(vorbis_dsp_state *v,int flag);
+extern int      vorbis_synthesis_deferred_p(vorbis_block *vb);
+extern void     vorbis_synthesis_channels(vorbis_block *vb,int first,int last);
 
 /* Vorbis ERRORS and return codes ***********************************/
 
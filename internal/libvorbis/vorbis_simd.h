@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// This file is not a part of libvorbis. This defines the vectorized kernels used from the patched libvorbis sources.
+//
+// The kernels use the GCC/Clang vector extensions, which are lowered to SSE2 on amd64 and to NEON on arm64.
+// Both are available on every CPU of the architectures, so no runtime detection is needed.
+// Otherwise, the kernels are plain loops.
+
+#ifndef _V_VORBIS_SIMD_H_
+#define _V_VORBIS_SIMD_H_
+
+#include "os.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define VORBIS_SIMD
+#endif
+
+#ifdef VORBIS_SIMD
+
+typedef float vorbis_v4sf __attribute__((vector_size(16)));
+typedef int vorbis_v4si __attribute__((vector_size(16)));
+typedef float vorbis_v4sf_u __attribute__((vector_size(16), aligned(4)));
+
+#if defined(__clang__)
+#define VORBIS_SHUFFLE(a, b, i0, i1, i2, i3) __builtin_shufflevector((a), (b), i0, i1, i2, i3)
+#else
+#define VORBIS_SHUFFLE(a, b, i0, i1, i2, i3) __builtin_shuffle((a), (b), (vorbis_v4si){i0, i1, i2, i3})
+#endif
+
+#define VORBIS_REVERSE(a) VORBIS_SHUFFLE(a, a, 3, 2, 1, 0)
+
+STIN vorbis_v4sf vorbis_load4(const float *p){
+  return *(const vorbis_v4sf_u *)p;
+}
+
+STIN void vorbis_store4(float *p, vorbis_v4sf v){
+  *(vorbis_v4sf_u *)p = v;
+}
+
+#endif /* VORBIS_SIMD */
+
+/* pcm[i] = pcm[i]*w[n-i-1] + p[i]*w[i] */
+STIN void vorbis_overlap_add(float *pcm, const float *p, const float *w, long n){
+  long i=0;
+#ifdef VORBIS_SIMD
+  for(;i+4<=n;i+=4){
+    vorbis_v4sf wr = VORBIS_REVERSE(vorbis_load4(w+n-i-4));
+    vorbis_store4(pcm+i, vorbis_load4(pcm+i) * wr + vorbis_load4(p+i) * vorbis_load4(w+i));
+  }
+#endif
+  for(;i<n;i++)
+    pcm[i]=pcm[i]*w[n-i-1] + p[i]*w[i];
+}
+
+/* d[i] *= w[i] */
+STIN void vorbis_window_mul(float *d, const float *w, long n){
+  long i=0;
+#ifdef VORBIS_SIMD
+  for(;i+4<=n;i+=4)
+    vorbis_store4(d+i, vorbis_load4(d+i) * vorbis_load4(w+i));
+#endif
+  for(;i<n;i++)
+    d[i]*=w[i];
+}
+
+/* d[i] *= w[n-i-1] */
+STIN void vorbis_window_mul_rev(float *d, const float *w, long n){
+  long i=0;
+#ifdef VORBIS_SIMD
+  for(;i+4<=n;i+=4)
+    vorbis_store4(d+i, vorbis_load4(d+i) * VORBIS_REVERSE(vorbis_load4(w+n-i-4)));
+#endif
+  for(;i<n;i++)
+    d[i]*=w[n-i-1];
+}
+
+/* d[i] *= s */
+STIN void vorbis_scale(float *d, float s, long n){
+  long i=0;
+#ifdef VORBIS_SIMD
+  const vorbis_v4sf vs = {s, s, s, s};
+  for(;i+4<=n;i+=4)
+    vorbis_store4(d+i, vorbis_load4(d+i) * vs);
+#endif
+  for(;i<n;i++)
+    d[i]*=s;
+}
+
+/* d[x] *= lookup[y(x)] for x0 <= x < min(n, x1), where y(x) is the line from (x0, y0) to (x1, y1) stepped as the
+   Bresenham loop of render_line in floor1.c.
+
+   The vectorized loop keeps y and the error term of the four samples x..x+3 in lanes, and steps them by four
+   samples at once: four steps add the error of 4*ady, which carries 4*ady/adx times and one more time when the
+   remainder overflows. */
+STIN void vorbis_render_line(int n, int x0, int x1, int y0, int y1, const float *lookup, float *d){
+  int dy=y1-y0;
+  int adx=x1-x0;
+  int ady=abs(dy);
+  int base=dy/adx;
+  int sy=(dy<0?base-1:base+1);
+  int x=x0;
+  int y=y0;
+  int err=0;
+
+  ady-=abs(base*adx);
+
+  if(n>x1)n=x1;
+  if(x>=n)return;
+
+#ifdef VORBIS_SIMD
+  if(n-x>=8){
+    int s=(dy<0?-1:1);
+    int i;
+    vorbis_v4si vy, verr;
+    for(i=0;i<4;i++){
+      vy[i]=y;
+      verr[i]=err;
+      err+=ady;
+      if(err>=adx){
+        err-=adx;
+        y+=sy;
+      }else{
+        y+=base;
+      }
+    }
+    {
+      const vorbis_v4si vadx = {adx, adx, adx, adx};
+      const vorbis_v4si vs = {s, s, s, s};
+      const int q = 4*ady/adx;
+      const vorbis_v4si vr = {4*ady%adx, 4*ady%adx, 4*ady%adx, 4*ady%adx};
+      const vorbis_v4si vstep = {4*base+s*q, 4*base+s*q, 4*base+s*q, 4*base+s*q};
+      for(;x+4<=n;x+=4){
+        vorbis_v4sf f = {lookup[vy[0]], lookup[vy[1]], lookup[vy[2]], lookup[vy[3]]};
+        vorbis_v4si carry;
+        vorbis_store4(d+x, vorbis_load4(d+x) * f);
+        verr+=vr;
+        vy+=vstep;
+        /* carry is -1 in the lanes whose error overflows. */
+        carry=(verr>=vadx);
+        verr-=vadx&carry;
+        vy-=vs*carry;
+      }
+    }
+    y=vy[0];
+    err=verr[0];
+    if(x>=n)return;
+  }
+#endif
+
+  d[x]*=lookup[y];
+  while(++x<n){
+    err=err+ady;
+    if(err>=adx){
+      err-=adx;
+      y+=sy;
+    }else{
+      y+=base;
+    }
+    d[x]*=lookup[y];
+  }
+}
+
+#endif /* _V_VORBIS_SIMD_H_ */
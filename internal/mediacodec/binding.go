@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build android
+
+package mediacodec
+
+// #cgo LDFLAGS: -lmediandk
+//
+// #include <stdlib.h>
+// #include <string.h>
+// #include <media/NdkMediaCodec.h>
+// #include <media/NdkMediaFormat.h>
+//
+// // COLOR_FormatYUV420Planar of MediaCodecInfo.CodecCapabilities, which the decoders output in byte buffers.
+// #define MEDIACODEC_YUV420_PLANAR 19
+//
+// static AMediaCodec* mediacodec_create(const char* mime, int32_t width, int32_t height) {
+//   AMediaCodec* codec = AMediaCodec_createDecoderByType(mime);
+//   if (!codec) {
+//     return NULL;
+//   }
+//   AMediaFormat* format = AMediaFormat_new();
+//   AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, mime);
+//   AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, width);
+//   AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, height);
+//   AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_COLOR_FORMAT, MEDIACODEC_YUV420_PLANAR);
+//   // Without a surface, the frames are output to byte buffers.
+//   media_status_t s = AMediaCodec_configure(codec, format, NULL, NULL, 0);
+//   AMediaFormat_delete(format);
+//   if (s != AMEDIA_OK || AMediaCodec_start(codec) != AMEDIA_OK) {
+//     AMediaCodec_delete(codec);
+//     return NULL;
+//   }
+//   return codec;
+// }
+//
+// // mediacodec_queue copies data to an input buffer. It returns 1 if no input buffer is available in timeout_us.
+// static int mediacodec_queue(AMediaCodec* codec, const uint8_t* data, size_t size, uint64_t pts, int64_t timeout_us) {
+//   ssize_t i = AMediaCodec_dequeueInputBuffer(codec, timeout_us);
+//   if (i == AMEDIACODEC_INFO_TRY_AGAIN_LATER) {
+//     return 1;
+//   }
+//   if (i < 0) {
+//     return -1;
+//   }
+//   size_t capacity = 0;
+//   uint8_t* buf = AMediaCodec_getInputBuffer(codec, i, &capacity);
+//   if (!buf || capacity < size) {
+//     AMediaCodec_queueInputBuffer(codec, i, 0, 0, pts, 0);
+//     return -1;
+//   }
+//   memcpy(buf, data, size);
+//   return AMediaCodec_queueInputBuffer(codec, i, 0, size, pts, 0) == AMEDIA_OK ? 0 : -1;
+// }
+//
+// typedef struct {
+//   int32_t color_format;
+//   int32_t width;
+//   int32_t height;
+//   int32_t stride;
+//   int32_t slice_height;
+//   int32_t crop_left;
+//   int32_t crop_top;
+//   int32_t crop_right;
+//   int32_t crop_bottom;
+// } mediacodec_layout;
+//
+// static int32_t mediacodec_int32(AMediaFormat* format, const char* key, int32_t def) {
+//   int32_t v;
+//   return AMediaFormat_getInt32(format, key, &v) ? v : def;
+// }
+//
+// static void mediacodec_read_layout(AMediaCodec* codec, mediacodec_layout* l) {
+//   AMediaFormat* f = AMediaCodec_getOutputFormat(codec);
+//   l->color_format = mediacodec_int32(f, AMEDIAFORMAT_KEY_COLOR_FORMAT, MEDIACODEC_YUV420_PLANAR);
+//   l->width = mediacodec_int32(f, AMEDIAFORMAT_KEY_WIDTH, l->width);
+//   l->height = mediacodec_int32(f, AMEDIAFORMAT_KEY_HEIGHT, l->height);
+//   l->stride = mediacodec_int32(f, AMEDIAFORMAT_KEY_STRIDE, l->width);
+//   l->slice_height = mediacodec_int32(f, "slice-height", l->height);
+//   l->crop_left = mediacodec_int32(f, "crop-left", 0);
+//   l->crop_top = mediacodec_int32(f, "crop-top", 0);
+//   l->crop_right = mediacodec_int32(f, "crop-right", l->width - 1);
+//   l->crop_bottom = mediacodec_int32(f, "crop-bottom", l->height - 1);
+//   AMediaFormat_delete(f);
+// }
+//
+// // mediacodec_dequeue returns the index of the next output buffer, -1 if there is none in timeout_us, or -2 for an
+// // error. l is updated when the output format changes.
+// static ssize_t mediacodec_dequeue(AMediaCodec* codec, int64_t timeout_us, mediacodec_layout* l, AMediaCodecBufferInfo* info) {
+//   for (;;) {
+//     ssize_t i = AMediaCodec_dequeueOutputBuffer(codec, info, timeout_us);
+//     if (i >= 0) {
+//       return i;
+//     }
+//     switch (i) {
+//     case AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED:
+//       mediacodec_read_layout(codec, l);
+//       break;
+//     case AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED:
+//       break;
+//     case AMEDIACODEC_INFO_TRY_AGAIN_LATER:
+//       return -1;
+//     default:
+//       return -2;
+//     }
+//   }
+// }
+import "C"
+
+import (
+	"fmt"
+	"time"
+	"unsafe"
+)
+
+// The output color formats of MediaCodecInfo.CodecCapabilities that are read.
+const (
+	colorFormatYUV420Planar     = 19
+	colorFormatYUV420SemiPlanar = 21
+
+	// colorFormatQCOMSemiPlanar32m is NV12 with the strides aligned, which Qualcomm decoders output.
+	colorFormatQCOMSemiPlanar32m = 0x7fa30c04
+)
+
+// Decoder is a MediaCodec decoder outputting the frames to byte buffers.
+type Decoder struct {
+	c      *C.AMediaCodec
+	layout C.mediacodec_layout
+
+	// output is the index of the output buffer of the last picture, or -1.
+	output C.ssize_t
+
+	// pts is the timestamp of the next input.
+	pts uint64
+
+	// cb and cr are the chroma planes deinterleaved from a semi-planar output.
+	cb []byte
+	cr []byte
+}
+
+// NewDecoder creates a decoder of mime, e.g. "video/x-vnd.on2.vp9", for frames of width and height.
+func NewDecoder(mime string, width, height int) (*Decoder, error) {
+	cmime := C.CString(mime)
+	defer C.free(unsafe.Pointer(cmime))
+	c := C.mediacodec_create(cmime, C.int32_t(width), C.int32_t(height))
+	if c == nil {
+		return nil, fmt.Errorf("mediacodec: creating a decoder of %s at %dx%d failed", mime, width, height)
+	}
+	d := &Decoder{
+		c:      c,
+		output: -1,
+	}
+	d.layout.width = C.int32_t(width)
+	d.layout.height = C.int32_t(height)
+	C.mediacodec_read_layout(c, &d.layout)
+	return d, nil
+}
+
+// Decode queues data, waiting for an input buffer up to timeout. data is copied.
+func (d *Decoder) Decode(data []byte, timeout time.Duration) error {
+	d.releaseOutput()
+	if len(data) == 0 {
+		return nil
+	}
+	switch C.mediacodec_queue(d.c, (*C.uint8_t)(unsafe.Pointer(unsafe.SliceData(data))), C.size_t(len(data)), C.uint64_t(d.pts), C.int64_t(timeout.Microseconds())) {
+	case 0:
+	case 1:
+		return fmt.Errorf("mediacodec: no input buffer is available in %v", timeout)
+	default:
+		return fmt.Errorf("mediacodec: queueing an input buffer failed")
+	}
+	// The timestamps only have to increase, as the frames are output in the decoding order.
+	d.pts++
+	return nil
+}
+
+// Next returns the next decoded picture, waiting for it up to timeout, or false if there is none.
+// The picture is valid until the next call of Next, Decode, Flush or Close.
+func (d *Decoder) Next(timeout time.Duration) (Picture, bool, error) {
+	d.releaseOutput()
+	var info C.AMediaCodecBufferInfo
+	i := C.mediacodec_dequeue(d.c, C.int64_t(timeout.Microseconds()), &d.layout, &info)
+	switch {
+	case i == -1:
+		return Picture{}, false, nil
+	case i < 0:
+		return Picture{}, false, fmt.Errorf("mediacodec: dequeueing an output buffer failed")
+	}
+	d.output = i
+	var size C.size_t
+	buf := C.AMediaCodec_getOutputBuffer(d.c, C.size_t(i), &size)
+	if buf == nil || int(info.offset)+int(info.size) > int(size) {
+		return Picture{}, false, fmt.Errorf("mediacodec: invalid output buffer")
+	}
+	data := unsafe.Slice((*byte)(unsafe.Add(unsafe.Pointer(buf), info.offset)), info.size)
+	p, err := d.picture(data)
+	if err != nil {
+		return Picture{}, false, err
+	}
+	return p, true, nil
+}
+
+// picture returns the picture in the output buffer data with the current layout.
+func (d *Decoder) picture(data []byte) (Picture, error) {
+	l := &d.layout
+	left, top := int(l.crop_left), int(l.crop_top)
+	w, h := int(l.crop_right)-left+1, int(l.crop_bottom)-top+1
+	stride, sliceHeight := int(l.stride), int(l.slice_height)
+	if w <= 0 || h <= 0 || left < 0 || top < 0 || left+w > stride || top+h > sliceHeight {
+		return Picture{}, fmt.Errorf("mediacodec: invalid output layout: %dx%d at (%d, %d) in %dx%d", w, h, left, top, stride, sliceHeight)
+	}
+	// The crop rectangle starts at even coordinates for the chroma planes.
+	left &^= 1
+	top &^= 1
+	cw, ch := (w+1)/2, (h+1)/2
+	lumaSize := stride * sliceHeight
+	p := Picture{
+		Width:  w,
+		Height: h,
+	}
+	p.Planes[0] = data[top*stride+left:]
+	p.Strides[0] = stride
+
+	switch l.color_format {
+	case colorFormatYUV420Planar:
+		cstride := stride / 2
+		csize := cstride * ((sliceHeight + 1) / 2)
+		if len(data) < lumaSize+csize+cstride*(top/2+ch) {
+			return Picture{}, fmt.Errorf("mediacodec: the output buffer is too small: %d", len(data))
+		}
+		offset := top/2*cstride + left/2
+		p.Planes[1] = data[lumaSize+offset : lumaSize+csize]
+		p.Planes[2] = data[lumaSize+csize+offset:]
+		p.Strides[1] = cstride
+		p.Strides[2] = cstride
+	case colorFormatYUV420SemiPlanar, colorFormatQCOMSemiPlanar32m:
+		if len(data) < lumaSize+stride*(top/2+ch) {
+			return Picture{}, fmt.Errorf("mediacodec: the output buffer is too small: %d", len(data))
+		}
+		if len(d.cb) < cw*ch {
+			d.cb = make([]byte, cw*ch)
+			d.cr = make([]byte, cw*ch)
+		}
+		uv := data[lumaSize+top/2*stride+left:]
+		for y := 0; y < ch; y++ {
+			row := uv[y*stride : y*stride+2*cw]
+			cb := d.cb[y*cw : (y+1)*cw]
+			cr := d.cr[y*cw : (y+1)*cw]
+			for x := range cb {
+				cb[x] = row[2*x]
+				cr[x] = row[2*x+1]
+			}
+		}
+		p.Planes[1] = d.cb[:cw*ch]
+		p.Planes[2] = d.cr[:cw*ch]
+		p.Strides[1] = cw
+		p.Strides[2] = cw
+	default:
+		return Picture{}, fmt.Errorf("mediacodec: unsupported output color format: %#x", int(l.color_format))
+	}
+	return p, nil
+}
+
+// Flush discards the inputs and the outputs, e.g. for seeking.
+func (d *Decoder) Flush() {
+	d.releaseOutput()
+	C.AMediaCodec_flush(d.c)
+}
+
+func (d *Decoder) Close() {
+	d.releaseOutput()
+	C.AMediaCodec_stop(d.c)
+	C.AMediaCodec_delete(d.c)
+	d.c = nil
+}
+
+func (d *Decoder) releaseOutput() {
+	if d.output < 0 {
+		return
+	}
+	C.AMediaCodec_releaseOutputBuffer(d.c, C.size_t(d.output), false)
+	d.output = -1
+}
@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// Package mediacodec provides the VP8 and VP9 decoders of Android with the MediaCodec API of the NDK.
+//
+// The frames are output to byte buffers rather than surfaces, as Ebitengine can't draw a surface. On the other
+// platforms, NewDecoder returns an error.
+package mediacodec
+
+// Picture is a decoded 8-bit 4:2:0 picture.
+type Picture struct {
+	Width  int
+	Height int
+
+	// Planes are the Y, U and V planes, and Strides are their strides in bytes. The planes refer to the output buffer
+	// of the decoder.
+	Planes  [3][]byte
+	Strides [3]int
+}
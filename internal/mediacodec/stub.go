@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !android
+
+package mediacodec
+
+import (
+	"errors"
+	"time"
+)
+
+var errUnavailable = errors.New("mediacodec: MediaCodec is available only on Android")
+
+// Decoder is a MediaCodec decoder outputting the frames to byte buffers.
+type Decoder struct{}
+
+// NewDecoder returns an error, as MediaCodec is not available.
+func NewDecoder(mime string, width, height int) (*Decoder, error) {
+	return nil, errUnavailable
+}
+
+func (d *Decoder) Decode(data []byte, timeout time.Duration) error {
+	return errUnavailable
+}
+
+func (d *Decoder) Next(timeout time.Duration) (Picture, bool, error) {
+	return Picture{}, false, errUnavailable
+}
+
+func (d *Decoder) Flush() {
+}
+
+func (d *Decoder) Close() {
+}
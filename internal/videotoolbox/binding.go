@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build darwin
+
+package videotoolbox
+
+// #cgo LDFLAGS: -framework VideoToolbox -framework CoreMedia -framework CoreVideo -framework CoreFoundation
+//
+// #include <stdlib.h>
+// #include <TargetConditionals.h>
+// #include <VideoToolbox/VideoToolbox.h>
+//
+// typedef struct {
+//   VTDecompressionSessionRef session;
+//   CMVideoFormatDescriptionRef format;
+//
+//   // image is the last output of the session, retained.
+//   CVImageBufferRef image;
+//   OSStatus status;
+// } vt_decoder;
+//
+// static void vt_output(void* refcon, void* frame_refcon, OSStatus status, VTDecodeInfoFlags flags, CVImageBufferRef image, CMTime pts, CMTime duration) {
+//   vt_decoder* d = refcon;
+//   if (status != noErr) {
+//     d->status = status;
+//     return;
+//   }
+//   // A dropped frame has no image.
+//   if (!image) {
+//     return;
+//   }
+//   if (d->image) {
+//     CVBufferRelease(d->image);
+//   }
+//   d->image = CVBufferRetain(image);
+// }
+//
+// static CFDictionaryRef vt_dictionary(const void* key, const void* value) {
+//   return CFDictionaryCreate(NULL, &key, &value, 1, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+// }
+//
+// static OSStatus vt_create(vt_decoder* d, int32_t width, int32_t height, const uint8_t* vpcc, size_t vpcc_size, int full_range) {
+// #if TARGET_OS_OSX
+//   if (__builtin_available(macOS 11.0, *)) {
+//     VTRegisterSupplementalVideoDecoderIfAvailable(kCMVideoCodecType_VP9);
+//   } else {
+//     return kVTCouldNotFindVideoDecoderErr;
+//   }
+// #else
+//   return kVTCouldNotFindVideoDecoderErr;
+// #endif
+//
+//   CFDataRef config = CFDataCreate(NULL, vpcc, vpcc_size);
+//   CFDictionaryRef atoms = vt_dictionary(CFSTR("vpcC"), config);
+//   CFRelease(config);
+//   CFDictionaryRef extensions = vt_dictionary(kCMFormatDescriptionExtension_SampleDescriptionExtensionAtoms, atoms);
+//   CFRelease(atoms);
+//   OSStatus s = CMVideoFormatDescriptionCreate(NULL, kCMVideoCodecType_VP9, width, height, extensions, &d->format);
+//   CFRelease(extensions);
+//   if (s != noErr) {
+//     return s;
+//   }
+//
+//   // The software decoder of VideoToolbox is not faster than libvpx.
+//   CFDictionaryRef spec = vt_dictionary(kVTVideoDecoderSpecification_RequireHardwareAcceleratedVideoDecoder, kCFBooleanTrue);
+//   int32_t pixel_format = full_range ? kCVPixelFormatType_420YpCbCr8PlanarFullRange : kCVPixelFormatType_420YpCbCr8Planar;
+//   CFNumberRef number = CFNumberCreate(NULL, kCFNumberSInt32Type, &pixel_format);
+//   CFDictionaryRef attrs = vt_dictionary(kCVPixelBufferPixelFormatTypeKey, number);
+//   CFRelease(number);
+//   VTDecompressionOutputCallbackRecord callback = {vt_output, d};
+//   s = VTDecompressionSessionCreate(NULL, d->format, spec, attrs, &callback, &d->session);
+//   CFRelease(spec);
+//   CFRelease(attrs);
+//   if (s != noErr) {
+//     CFRelease(d->format);
+//     d->format = NULL;
+//   }
+//   return s;
+// }
+//
+// // vt_decode decodes data synchronously, so that the session doesn't refer to data after vt_decode returns.
+// static OSStatus vt_decode(vt_decoder* d, const uint8_t* data, size_t size) {
+//   CMBlockBufferRef block = NULL;
+//   OSStatus s = CMBlockBufferCreateWithMemoryBlock(NULL, (void*)data, size, kCFAllocatorNull, NULL, 0, size, 0, &block);
+//   if (s != noErr) {
+//     return s;
+//   }
+//   CMSampleBufferRef sample = NULL;
+//   s = CMSampleBufferCreateReady(NULL, block, d->format, 1, 0, NULL, 1, &size, &sample);
+//   CFRelease(block);
+//   if (s != noErr) {
+//     return s;
+//   }
+//   d->status = noErr;
+//   s = VTDecompressionSessionDecodeFrame(d->session, sample, 0, NULL, NULL);
+//   if (s == noErr) {
+//     s = VTDecompressionSessionWaitForAsynchronousFrames(d->session);
+//   }
+//   CFRelease(sample);
+//   if (s != noErr) {
+//     return s;
+//   }
+//   return d->status;
+// }
+//
+// static CVImageBufferRef vt_take(vt_decoder* d) {
+//   CVImageBufferRef image = d->image;
+//   d->image = NULL;
+//   return image;
+// }
+//
+// static void vt_destroy(vt_decoder* d) {
+//   if (d->session) {
+//     VTDecompressionSessionInvalidate(d->session);
+//     CFRelease(d->session);
+//   }
+//   if (d->format) {
+//     CFRelease(d->format);
+//   }
+//   if (d->image) {
+//     CVBufferRelease(d->image);
+//   }
+//   free(d);
+// }
+import "C"
+
+import (
+	"fmt"
+	"unsafe"
+)
+
+// Decoder is a VideoToolbox VP9 decoder.
+type Decoder struct {
+	// c is allocated by C, as the session keeps it as the reference of the callback.
+	c *C.vt_decoder
+
+	// locked is the pixel buffer of the last picture, locked for reading, or nil.
+	locked C.CVImageBufferRef
+}
+
+// NewDecoder creates a decoder of VP9 profile 0 frames of width and height. fullRange is the color range, which the
+// decoded pixel buffers keep.
+func NewDecoder(width, height int, fullRange bool) (*Decoder, error) {
+	// VP Codec Configuration Box of https://www.webmproject.org/vp9/mp4/
+	// The level and the colors are unspecified, as they don't change the decoded samples.
+	var fr byte
+	if fullRange {
+		fr = 1
+	}
+	vpcc := []byte{
+		1, 0, 0, 0, // version and flags
+		0,                // profile
+		0,                // level
+		8<<4 | 1<<1 | fr, // bitDepth, chromaSubsampling and videoFullRangeFlag
+		2, 2, 2,          // colourPrimaries, transferCharacteristics and matrixCoefficients
+		0, 0, // codecIntializationDataSize
+	}
+	c := (*C.vt_decoder)(C.calloc(1, C.size_t(unsafe.Sizeof(C.vt_decoder{}))))
+	if s := C.vt_create(c, C.int32_t(width), C.int32_t(height), (*C.uint8_t)(unsafe.Pointer(&vpcc[0])), C.size_t(len(vpcc)), C.int(fr)); s != C.noErr {
+		C.vt_destroy(c)
+		return nil, fmt.Errorf("videotoolbox: creating a VP9 decoder at %dx%d failed: %d", width, height, int(s))
+	}
+	return &Decoder{c: c}, nil
+}
+
+// Decode decodes data. data is not used after Decode returns.
+func (d *Decoder) Decode(data []byte) error {
+	d.unlock()
+	if len(data) == 0 {
+		return nil
+	}
+	if s := C.vt_decode(d.c, (*C.uint8_t)(unsafe.Pointer(unsafe.SliceData(data))), C.size_t(len(data))); s != C.noErr {
+		return fmt.Errorf("videotoolbox: decoding failed: %d", int(s))
+	}
+	return nil
+}
+
+// Next returns the picture decoded by the last Decode, or false if there is none.
+// The picture is valid until the next call of Next, Decode or Close.
+func (d *Decoder) Next() (Picture, bool, error) {
+	d.unlock()
+	img := C.vt_take(d.c)
+	if img == nil {
+		return Picture{}, false, nil
+	}
+	if s := C.CVPixelBufferLockBaseAddress(img, C.kCVPixelBufferLock_ReadOnly); s != C.kCVReturnSuccess {
+		C.CVBufferRelease(img)
+		return Picture{}, false, fmt.Errorf("videotoolbox: CVPixelBufferLockBaseAddress failed: %d", int(s))
+	}
+	d.locked = img
+	if n := C.CVPixelBufferGetPlaneCount(img); n != 3 {
+		return Picture{}, false, fmt.Errorf("videotoolbox: unexpected plane count: %d", int(n))
+	}
+	p := Picture{
+		Width:  int(C.CVPixelBufferGetWidth(img)),
+		Height: int(C.CVPixelBufferGetHeight(img)),
+	}
+	for i := range p.Planes {
+		stride := int(C.CVPixelBufferGetBytesPerRowOfPlane(img, C.size_t(i)))
+		h := int(C.CVPixelBufferGetHeightOfPlane(img, C.size_t(i)))
+		base := C.CVPixelBufferGetBaseAddressOfPlane(img, C.size_t(i))
+		if base == nil {
+			return Picture{}, false, fmt.Errorf("videotoolbox: the plane %d has no address", i)
+		}
+		p.Planes[i] = unsafe.Slice((*byte)(base), stride*h)
+		p.Strides[i] = stride
+	}
+	return p, true, nil
+}
+
+func (d *Decoder) Close() {
+	d.unlock()
+	C.vt_destroy(d.c)
+	d.c = nil
+}
+
+func (d *Decoder) unlock() {
+	if d.locked == nil {
+		return
+	}
+	C.CVPixelBufferUnlockBaseAddress(d.locked, C.kCVPixelBufferLock_ReadOnly)
+	C.CVBufferRelease(d.locked)
+	d.locked = nil
+}
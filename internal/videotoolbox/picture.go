@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// Package videotoolbox provides the hardware VP9 decoder of macOS with VideoToolbox.
+//
+// VideoToolbox decodes VP9 only on macOS 11 or later with a supplemental decoder, and the frames are read back from
+// the pixel buffers, as Ebitengine can't draw a pixel buffer. On iOS and the other platforms, NewDecoder returns an
+// error.
+package videotoolbox
+
+// Picture is a decoded 8-bit 4:2:0 picture.
+type Picture struct {
+	Width  int
+	Height int
+
+	// Planes are the Y, U and V planes, and Strides are their strides in bytes. The planes refer to the pixel buffer
+	// of the decoder.
+	Planes  [3][]byte
+	Strides [3]int
+}
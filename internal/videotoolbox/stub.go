@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !darwin
+
+package videotoolbox
+
+import (
+	"errors"
+)
+
+var errUnavailable = errors.New("videotoolbox: VideoToolbox is available only on macOS")
+
+// Decoder is a VideoToolbox VP9 decoder.
+type Decoder struct{}
+
+// NewDecoder returns an error, as VideoToolbox is not available.
+func NewDecoder(width, height int, fullRange bool) (*Decoder, error) {
+	return nil, errUnavailable
+}
+
+func (d *Decoder) Decode(data []byte) error {
+	return errUnavailable
+}
+
+func (d *Decoder) Next() (Picture, bool, error) {
+	return Picture{}, false, errUnavailable
+}
+
+func (d *Decoder) Close() {
+}
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+// Package vpxfb provides libvpx external frame buffers, so that the decoded images can be used without copying them
+// out of libvpx, and the raw planes of the decoded images.
+package vpxfb
+
+// #cgo pkg-config: vpx
+//
+// #include <stdint.h>
+// #include <stdlib.h>
+// #include <string.h>
+// #include <vpx/vpx_decoder.h>
+//
+// #ifdef _WIN32
+// #include <malloc.h>
+// #endif
+//
+// // vpxfb_buffer is a frame buffer. refs is 1 while libvpx uses the buffer, plus the references of the Go side.
+// typedef struct vpxfb_buffer {
+//   uint8_t* data;
+//   size_t size;
+//   int refs;
+// } vpxfb_buffer;
+//
+// typedef struct vpxfb_pool {
+//   vpxfb_buffer** buffers;
+//   int count;
+// } vpxfb_pool;
+//
+// static void vpxfb_free_data(uint8_t* data) {
+// #ifdef _WIN32
+//   _aligned_free(data);
+// #else
+//   free(data);
+// #endif
+// }
+//
+// // vpxfb_alloc_data allocates size bytes aligned to a page. The data is zeroed, as libvpx reads the borders of a
+// // new buffer before writing them.
+// static uint8_t* vpxfb_alloc_data(size_t size) {
+//   void* data = NULL;
+// #ifdef _WIN32
+//   data = _aligned_malloc(size, 4096);
+// #else
+//   if (posix_memalign(&data, 4096, size) != 0) {
+//     data = NULL;
+//   }
+// #endif
+//   if (data) {
+//     memset(data, 0, size);
+//   }
+//   return data;
+// }
+//
+// static int vpxfb_get(void* priv, size_t min_size, vpx_codec_frame_buffer_t* fb) {
+//   vpxfb_pool* pool = priv;
+//   vpxfb_buffer* b = NULL;
+//   for (int i = 0; i < pool->count; i++) {
+//     if (__atomic_load_n(&pool->buffers[i]->refs, __ATOMIC_ACQUIRE) == 0) {
+//       b = pool->buffers[i];
+//       break;
+//     }
+//   }
+//   if (!b) {
+//     vpxfb_buffer** buffers = realloc(pool->buffers, (pool->count + 1) * sizeof(vpxfb_buffer*));
+//     if (!buffers) {
+//       return -1;
+//     }
+//     pool->buffers = buffers;
+//     b = calloc(1, sizeof(vpxfb_buffer));
+//     if (!b) {
+//       return -1;
+//     }
+//     pool->buffers[pool->count++] = b;
+//   }
+//   if (b->size < min_size) {
+//     vpxfb_free_data(b->data);
+//     b->size = 0;
+//     b->data = vpxfb_alloc_data(min_size);
+//     if (!b->data) {
+//       return -1;
+//     }
+//     b->size = min_size;
+//   }
+//   b->refs = 1;
+//   fb->data = b->data;
+//   fb->size = b->size;
+//   fb->priv = b;
+//   return 0;
+// }
+//
+// static int vpxfb_release(void* priv, vpx_codec_frame_buffer_t* fb) {
+//   vpxfb_buffer* b = fb->priv;
+//   if (b) {
+//     __atomic_sub_fetch(&b->refs, 1, __ATOMIC_RELEASE);
+//   }
+//   return 0;
+// }
+//
+// static vpx_codec_err_t vpxfb_attach(vpx_codec_ctx_t* ctx, vpxfb_pool* pool) {
+//   return vpx_codec_set_frame_buffer_functions(ctx, vpxfb_get, vpxfb_release, pool);
+// }
+//
+// // vpxfb_acquire adds a reference to the buffer of img, and returns the buffer, or NULL if img is not in a buffer
+// // of a pool.
+// static vpxfb_buffer* vpxfb_acquire(const vpx_image_t* img) {
+//   vpxfb_buffer* b = img->fb_priv;
+//   if (b) {
+//     __atomic_add_fetch(&b->refs, 1, __ATOMIC_RELAXED);
+//   }
+//   return b;
+// }
+//
+// static void vpxfb_unref(vpxfb_buffer* b) {
+//   __atomic_sub_fetch(&b->refs, 1, __ATOMIC_RELEASE);
+// }
+//
+// static void vpxfb_free(vpxfb_pool* pool) {
+//   for (int i = 0; i < pool->count; i++) {
+//     vpxfb_free_data(pool->buffers[i]->data);
+//     free(pool->buffers[i]);
+//   }
+//   free(pool->buffers);
+//   free(pool);
+// }
+import "C"
+
+import (
+	"fmt"
+	"unsafe"
+)
+
+// Pool is the frame buffers of a libvpx decoder.
+type Pool struct {
+	p *C.vpxfb_pool
+}
+
+// Attach makes the libvpx decoder ctx decode into the buffers of a new Pool. ctx is a *vpx_codec_ctx_t, and must not
+// have decoded any frames yet.
+// Attach returns an error if the decoder doesn't support external frame buffers, e.g. VP8.
+//
+// The Pool must be freed after the decoder is destroyed.
+func Attach(ctx unsafe.Pointer) (*Pool, error) {
+	p := (*C.vpxfb_pool)(C.calloc(1, C.size_t(unsafe.Sizeof(C.vpxfb_pool{}))))
+	if p == nil {
+		return nil, fmt.Errorf("vpxfb: allocating a pool failed")
+	}
+	if err := C.vpxfb_attach((*C.vpx_codec_ctx_t)(ctx), p); err != C.VPX_CODEC_OK {
+		C.free(unsafe.Pointer(p))
+		return nil, fmt.Errorf("vpxfb: vpx_codec_set_frame_buffer_functions failed: %d", int(err))
+	}
+	return &Pool{p: p}, nil
+}
+
+// Free frees the buffers. Free must be called after the decoder is destroyed and all the Buffers are released.
+func (p *Pool) Free() {
+	C.vpxfb_free(p.p)
+	p.p = nil
+}
+
+// Buffer is a reference to a frame buffer.
+type Buffer struct {
+	b *C.vpxfb_buffer
+}
+
+// Acquire returns a reference to the buffer that the image img is decoded into. img is a *vpx_image_t returned by
+// the decoder. The buffer is not reused for other frames until the Buffer is released, even after libvpx releases
+// it, so the planes of img stay valid.
+// Acquire reports false if img is not in a buffer of a Pool.
+func Acquire(img unsafe.Pointer) (Buffer, bool) {
+	b := C.vpxfb_acquire((*C.vpx_image_t)(img))
+	return Buffer{b: b}, b != nil
+}
+
+// Release releases the reference. Release does nothing for the zero Buffer.
+func (b *Buffer) Release() {
+	if b.b == nil {
+		return
+	}
+	C.vpxfb_unref(b.b)
+	b.b = nil
+}
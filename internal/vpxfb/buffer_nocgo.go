@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !cgo
+
+package vpxfb
+
+import (
+	"unsafe"
+)
+
+// Buffer is a reference to a frame buffer. Without cgo, there are no frame buffers, and a Buffer is always zero.
+type Buffer struct{}
+
+// Acquire reports false, as img is never in a buffer of a Pool without cgo.
+func Acquire(img unsafe.Pointer) (Buffer, bool) {
+	return Buffer{}, false
+}
+
+// Release does nothing.
+func (b *Buffer) Release() {
+}
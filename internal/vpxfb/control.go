@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package vpxfb
+
+// #include <vpx/vp8dx.h>
+//
+// static vpx_codec_err_t vpxfb_set_skip_loop_filter(vpx_codec_ctx_t* ctx, int skip) {
+//   return vpx_codec_control(ctx, VP9_SET_SKIP_LOOP_FILTER, skip);
+// }
+//
+// static vpx_codec_err_t vpxfb_set_svc_spatial_layer(vpx_codec_ctx_t* ctx, int layer) {
+//   return vpx_codec_control(ctx, VP9_DECODE_SVC_SPATIAL_LAYER, layer);
+// }
+//
+// // libvpx defines VPX_CTRL_VP9D_SET_ROW_MT with the control VP9D_SET_ROW_MT, which is an enumerator and not a macro.
+// // libvpx older than 1.8 doesn't have the control.
+// #ifdef VPX_CTRL_VP9D_SET_ROW_MT
+// static const int vpxfb_has_row_mt = 1;
+//
+// static vpx_codec_err_t vpxfb_set_row_mt(vpx_codec_ctx_t* ctx, int enabled) {
+//   return vpx_codec_control(ctx, VP9D_SET_ROW_MT, enabled);
+// }
+// #else
+// static const int vpxfb_has_row_mt = 0;
+//
+// static vpx_codec_err_t vpxfb_set_row_mt(vpx_codec_ctx_t* ctx, int enabled) {
+//   return VPX_CODEC_INCAPABLE;
+// }
+// #endif
+//
+// static vpx_codec_err_t vpxfb_flush(vpx_codec_ctx_t* ctx) {
+//   vpx_codec_iter_t iter = NULL;
+//   vpx_codec_err_t err = vpx_codec_decode(ctx, NULL, 0, NULL, 0);
+//   if (err != VPX_CODEC_OK) {
+//     return err;
+//   }
+//   while (vpx_codec_get_frame(ctx, &iter) != NULL) {
+//   }
+//   return VPX_CODEC_OK;
+// }
+import "C"
+
+import (
+	"errors"
+	"fmt"
+	"unsafe"
+)
+
+// SetSkipLoopFilter makes the VP9 decoder ctx skip the loop filter, which is cheaper to decode with slight blocking
+// artifacts. ctx is a *vpx_codec_ctx_t.
+// SetSkipLoopFilter returns an error for VP8, which doesn't support skipping the loop filter.
+func SetSkipLoopFilter(ctx unsafe.Pointer, skip bool) error {
+	var s C.int
+	if skip {
+		s = 1
+	}
+	if err := C.vpxfb_set_skip_loop_filter((*C.vpx_codec_ctx_t)(ctx), s); err != C.VPX_CODEC_OK {
+		return fmt.Errorf("vpxfb: VP9_SET_SKIP_LOOP_FILTER failed: %d", int(err))
+	}
+	return nil
+}
+
+// SetSVCSpatialLayer makes the VP9 decoder ctx decode the spatial layers of an SVC superframe up to layer, where 0 is
+// the base layer. ctx is a *vpx_codec_ctx_t.
+func SetSVCSpatialLayer(ctx unsafe.Pointer, layer int) error {
+	if err := C.vpxfb_set_svc_spatial_layer((*C.vpx_codec_ctx_t)(ctx), C.int(layer)); err != C.VPX_CODEC_OK {
+		return fmt.Errorf("vpxfb: VP9_DECODE_SVC_SPATIAL_LAYER failed: %d", int(err))
+	}
+	return nil
+}
+
+// SetRowMT makes the VP9 decoder ctx decode the rows of the superblocks of a tile in parallel with its threads, so
+// that a frame with few tiles still uses the threads. ctx is a *vpx_codec_ctx_t.
+// SetRowMT returns an error for VP8, which doesn't support row-based multithreading, and an error wrapping
+// errors.ErrUnsupported with libvpx older than 1.8, which doesn't have the control.
+func SetRowMT(ctx unsafe.Pointer, enabled bool) error {
+	if C.vpxfb_has_row_mt == 0 {
+		return fmt.Errorf("vpxfb: VP9D_SET_ROW_MT is not supported by the libvpx: %w", errors.ErrUnsupported)
+	}
+	var e C.int
+	if enabled {
+		e = 1
+	}
+	if err := C.vpxfb_set_row_mt((*C.vpx_codec_ctx_t)(ctx), e); err != C.VPX_CODEC_OK {
+		return fmt.Errorf("vpxfb: VP9D_SET_ROW_MT failed: %d", int(err))
+	}
+	return nil
+}
+
+// Flush drops the frames pending in the decoder ctx, so that the decoder can decode from a keyframe of another
+// position without being recreated. The allocated buffers and the controls of ctx are kept. ctx is a *vpx_codec_ctx_t.
+func Flush(ctx unsafe.Pointer) error {
+	if err := C.vpxfb_flush((*C.vpx_codec_ctx_t)(ctx)); err != C.VPX_CODEC_OK {
+		return fmt.Errorf("vpxfb: flushing failed: %d", int(err))
+	}
+	return nil
+}
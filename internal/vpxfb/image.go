@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package vpxfb
+
+// #include <vpx/vpx_decoder.h>
+import "C"
+
+import (
+	"unsafe"
+)
+
+// ImageOf returns the planes of img, which is a *vpx_image_t returned by a decoder.
+func ImageOf(img unsafe.Pointer) Image {
+	i := (*C.vpx_image_t)(img)
+	r := Image{
+		Width:        int(i.d_w),
+		Height:       int(i.d_h),
+		BitDepth:     int(i.bit_depth),
+		HighBitDepth: i.fmt&C.VPX_IMG_FMT_HIGHBITDEPTH != 0,
+		XChromaShift: int(i.x_chroma_shift),
+		YChromaShift: int(i.y_chroma_shift),
+		ColorSpace:   ColorSpace(i.cs),
+		FullRange:    i._range == C.VPX_CR_FULL_RANGE,
+	}
+	if r.BitDepth == 0 {
+		r.BitDepth = 8
+	}
+	for p := 0; p < 3; p++ {
+		h := r.Height
+		if p > 0 {
+			h = (h + 1<<r.YChromaShift - 1) >> r.YChromaShift
+		}
+		r.Strides[p] = int(i.stride[p])
+		r.Planes[p] = unsafe.Slice((*byte)(unsafe.Pointer(i.planes[p])), r.Strides[p]*h)
+	}
+	return r
+}
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package vpxfb
+
+// ColorSpace is the matrix coefficients of an image, as vpx_color_space_t. The values are the ones of libvpx, so
+// that ColorSpace is defined without cgo too.
+type ColorSpace int
+
+const (
+	ColorSpaceUnknown  ColorSpace = 0
+	ColorSpaceBT601    ColorSpace = 1
+	ColorSpaceBT709    ColorSpace = 2
+	ColorSpaceSMPTE170 ColorSpace = 3
+	ColorSpaceSMPTE240 ColorSpace = 4
+	ColorSpaceBT2020   ColorSpace = 5
+	ColorSpaceSRGB     ColorSpace = 7
+)
+
+// Image is the planes of a decoded vpx_image_t, which the libvpx-go binding doesn't expose for high bit depths.
+type Image struct {
+	// Width and Height are the displayed size.
+	Width  int
+	Height int
+
+	// BitDepth is the bit depth of the samples. If HighBitDepth is true, each sample is a little-endian uint16 with
+	// BitDepth bits. Otherwise, each sample is a byte.
+	BitDepth     int
+	HighBitDepth bool
+
+	// XChromaShift and YChromaShift are the subsampling of the chroma planes, e.g. 1 and 1 for 4:2:0.
+	XChromaShift int
+	YChromaShift int
+
+	ColorSpace ColorSpace
+	FullRange  bool
+
+	// Planes are the Y, U and V planes, and Strides are their strides in bytes. The planes refer to the memory of
+	// the decoder.
+	Planes  [3][]byte
+	Strides [3]int
+}
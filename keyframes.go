@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"sort"
+	"sync"
+	"time"
+)
+
+// keyframeIndex is a seek table of video keyframes built from the packets the demuxer reads.
+// keyframeIndex is used for files without Cues, e.g. live recordings, so that a seek into the part already read lands
+// on the keyframe before the target.
+type keyframeIndex struct {
+	m sync.Mutex
+
+	// times is the sorted timecodes of the keyframes.
+	times []time.Duration
+
+	// end is the last timecode read. The index is complete up to end.
+	end     time.Duration
+	started bool
+
+	// seeked is true after a seek until the next packet.
+	// paused is true when the reader has skipped a part of the file, and the packets don't extend the index.
+	seeked bool
+	paused bool
+}
+
+// seek notifies that the reader has moved.
+func (k *keyframeIndex) seek() {
+	k.m.Lock()
+	defer k.m.Unlock()
+	k.seeked = true
+}
+
+// add records a video packet in the decoding order.
+func (k *keyframeIndex) add(timecode time.Duration, keyframe bool) {
+	k.m.Lock()
+	defer k.m.Unlock()
+
+	if k.seeked {
+		k.seeked = false
+		k.paused = k.started && timecode > k.end
+	}
+	if k.paused {
+		return
+	}
+	// After seeking backward, the packets are the ones already indexed.
+	if k.started && timecode <= k.end {
+		return
+	}
+	k.started = true
+	k.end = timecode
+	if keyframe {
+		k.times = append(k.times, timecode)
+	}
+}
+
+// before returns the last keyframe at or before t. before returns false if t is beyond the indexed part.
+func (k *keyframeIndex) before(t time.Duration) (time.Duration, bool) {
+	k.m.Lock()
+	defer k.m.Unlock()
+
+	if t > k.end {
+		return 0, false
+	}
+	i := sort.Search(len(k.times), func(i int) bool { return k.times[i] > t })
+	if i == 0 {
+		return 0, false
+	}
+	return k.times[i-1], true
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+)
+
+// liveWindowSize is the size of the latest bytes a liveReader keeps for seeking back.
+const liveWindowSize = 16 << 20
+
+// NewPlayerFromReader creates a Player from a non-seekable WebM stream, e.g. a live stream from a WebSocket or stdin.
+//
+// Only the latest bytes of the stream are kept, so the memory is bounded. The stream is read as the demuxer needs it,
+// and packets are decoded as soon as their blocks arrive.
+// Seek works only within the kept part, and the duration is unknown.
+func NewPlayerFromReader(options *PlayerOptions, r io.Reader) (*Player, error) {
+	return NewPlayerWithOptions(options, newLiveReader(r, liveWindowSize))
+}
+
+// liveReader is an io.ReadSeeker over an io.Reader with a sliding window of the latest bytes.
+// Seeking backward is possible within the window, and seeking forward reads and discards the bytes.
+type liveReader struct {
+	r io.Reader
+
+	// buf is the window, and start is the offset of buf[0] in the stream.
+	buf   []byte
+	start int64
+
+	pos    int64
+	window int
+	err    error
+}
+
+func newLiveReader(r io.Reader, window int) *liveReader {
+	return &liveReader{
+		r:      r,
+		window: window,
+	}
+}
+
+func (l *liveReader) Read(buf []byte) (int, error) {
+	if l.pos < l.start {
+		return 0, fmt.Errorf("webmplayer: position %d is out of the kept window", l.pos)
+	}
+	for l.pos >= l.start+int64(len(l.buf)) {
+		if l.err != nil {
+			return 0, l.err
+		}
+		l.fill(max(len(buf), 32*1024))
+	}
+	n := copy(buf, l.buf[l.pos-l.start:])
+	l.pos += int64(n)
+	return n, nil
+}
+
+// fill reads at most n bytes from the source into the window, and drops the oldest bytes over the window size.
+func (l *liveReader) fill(n int) {
+	m := len(l.buf)
+	if cap(l.buf)-m < n {
+		// Drop the oldest bytes at once so that dropping doesn't copy the window for every read.
+		if drop := m + n - l.window; drop > 0 {
+			drop = min(max(drop, l.window/4), m)
+			// Keep the bytes at the reading position.
+			drop = min(drop, int(max(l.pos-l.start, 0)))
+			m = copy(l.buf, l.buf[drop:])
+			l.buf = l.buf[:m]
+			l.start += int64(drop)
+		}
+		if cap(l.buf)-m < n {
+			buf := make([]byte, m, max(2*cap(l.buf), m+n))
+			copy(buf, l.buf)
+			l.buf = buf
+		}
+	}
+	k, err := l.r.Read(l.buf[m : m+n])
+	l.buf = l.buf[:m+k]
+	if err != nil {
+		l.err = err
+	}
+}
+
+func (l *liveReader) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += l.pos
+	case io.SeekEnd:
+		return 0, errors.New("webmplayer: the size of a live stream is unknown")
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	if offset < l.start {
+		return 0, fmt.Errorf("webmplayer: position %d is out of the kept window", offset)
+	}
+	l.pos = offset
+	return offset, nil
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"sync/atomic"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+// loopTrackNumber is the track number of the packet that a demuxer sends at the start of each pass of
+// PlayerOptions.Loop but the first. The packet has no data, and its Timecode is the start of the pass.
+const loopTrackNumber = ^uint(0)
+
+// demuxLoop is the state of PlayerOptions.Loop in a demuxer's goroutine. At the end of the input, the demuxer reads
+// it from the start again without a seek, and the timecodes of each pass continue from the previous pass's by the
+// duration of a pass.
+type demuxLoop struct {
+	// period is the duration of a pass, or 0 without Loop. period is set by the stream while the goroutine runs.
+	period atomic.Int64
+
+	// offset is the start of the pass being read, which is added to the timecodes. read is true when a packet of the
+	// pass has been read, so that an input without packets doesn't loop forever.
+	offset time.Duration
+	read   bool
+}
+
+// start enables Loop with the duration of a pass d, and returns d. A duration of 0 means that the input can't loop.
+func (l *demuxLoop) start(d time.Duration) time.Duration {
+	d = max(d, 0)
+	l.period.Store(int64(d))
+	return d
+}
+
+// next moves to the next pass at the end of the input, and reports whether the demuxer reads the input again.
+func (l *demuxLoop) next() bool {
+	period := time.Duration(l.period.Load())
+	if period == 0 || !l.read {
+		return false
+	}
+	l.offset += period
+	l.read = false
+	return true
+}
+
+// seek moves to the pass including t, and returns t in the pass.
+func (l *demuxLoop) seek(t time.Duration) time.Duration {
+	period := time.Duration(l.period.Load())
+	if period == 0 {
+		return t
+	}
+	l.offset = max(t, 0) / period * period
+	// A seek to the end of a pass continues to the next pass without reading a packet.
+	l.read = true
+	return t - l.offset
+}
+
+// packet adds the start of the pass to the timecode of pkt read from the input.
+func (l *demuxLoop) packet(pkt *webm.Packet) {
+	pkt.Timecode += l.offset
+	l.read = true
+}
+
+// mark returns the packet of the start of the pass.
+func (l *demuxLoop) mark() webm.Packet {
+	return webm.Packet{
+		Timecode:    l.offset,
+		TrackNumber: loopTrackNumber,
+	}
+}
+
+// passTime returns t in the pass of Loop including t, where a pass is period long. passTime returns t if period is 0.
+func passTime(t, period time.Duration) time.Duration {
+	if period <= 0 || t < 0 {
+		return t
+	}
+	return t % period
+}
@@ -0,0 +1,479 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"unsafe"
+)
+
+const (
+	// loudnessSidecarMagic is of the sidecar file of the loudness.
+	loudnessSidecarMagic = "WEBMLOUD"
+
+	// maxLoudnessGain is the largest gain to normalize the loudness by, +12 dB, as the gain above 1 can clip.
+	maxLoudnessGain = 4
+
+	// loudnessAbsoluteGate and loudnessRelativeGate are the gates of the blocks of ITU-R BS.1770-4 in LUFS and LU.
+	loudnessAbsoluteGate = -70
+	loudnessRelativeGate = -10
+)
+
+// LoudnessOptions represents options for MeasureLoudness.
+type LoudnessOptions struct {
+	// AudioTrack is the track number of the audio. If AudioTrack is 0, the first audio track is used.
+	AudioTrack uint
+
+	// Sidecar makes MeasureLoudnessFromFile keep the loudness in a file next to the input, whose name is the input's
+	// with ".loudness", and read it instead of decoding while the input's size and modification time are the same.
+	// A Player of NewPlayerFromFile with PlayerOptions.LoudnessTarget reads the same file.
+	Sidecar bool
+}
+
+// MeasureLoudness decodes the audio of r, and returns its integrated loudness in LUFS by ITU-R BS.1770-4, as EBU R128
+// specifies, e.g. for an indexer to measure a catalogue before the playback. r is read once from the start.
+//
+// More than two channels are measured before the downmix, weighted by their positions as BS.1770 specifies, without
+// LFE. The channels of an unknown layout, e.g. of ambisonics, are measured as the stereo output.
+//
+// MeasureLoudness fails if the audio is shorter than 400 milliseconds or silent.
+func MeasureLoudness(r io.ReadSeeker, options *LoudnessOptions) (float64, error) {
+	if options == nil {
+		options = &LoudnessOptions{}
+	}
+	s, err := newAudioOnlyStream(r, options.AudioTrack)
+	if err != nil {
+		return 0, err
+	}
+	defer s.close()
+	return measureLoudness(s.AudioStream())
+}
+
+// MeasureLoudnessFromFile runs MeasureLoudness with a local WebM file, which is opened as NewPlayerFromFile opens.
+func MeasureLoudnessFromFile(path string, options *LoudnessOptions) (float64, error) {
+	if options == nil {
+		options = &LoudnessOptions{}
+	}
+	r, err := openFile(path)
+	if err != nil {
+		return 0, err
+	}
+	s, err := newAudioOnlyStream(r, options.AudioTrack)
+	if err != nil {
+		return 0, err
+	}
+	defer s.close()
+
+	var key []byte
+	if options.Sidecar {
+		fi, err := os.Stat(path)
+		if err != nil {
+			return 0, err
+		}
+		// The key has the track number found, so that a Player playing the default track finds the same sidecar file.
+		key = loudnessSidecarKey(fi, s.AudioTrack().TrackNumber)
+		if l, ok := readLoudnessSidecar(path, key); ok {
+			return l, nil
+		}
+	}
+	l, err := measureLoudness(s.AudioStream())
+	if err != nil {
+		return 0, err
+	}
+	if options.Sidecar {
+		writeLoudnessSidecar(path, key, l)
+	}
+	return l, nil
+}
+
+func measureLoudness(a *audioStream) (float64, error) {
+	// The meter is fed by Read as during the playback.
+	m := a.newLoudnessMeter()
+	a.loudness = m
+	buf := make([]byte, 32768)
+	for {
+		_, err := a.Read(buf)
+		if errors.Is(err, errAudioNotReady) {
+			continue
+		}
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			return 0, fmt.Errorf("webmplayer: measuring the loudness failed: %w", err)
+		}
+	}
+	l, ok := m.integrated()
+	if !ok {
+		return 0, errors.New("webmplayer: the audio is too short or silent to measure the loudness")
+	}
+	return l, nil
+}
+
+// loudnessGain returns the gain to play the audio of the loudness at the target loudness.
+func loudnessGain(target, loudness float64) float64 {
+	return min(math.Pow(10, (target-loudness)/20), maxLoudnessGain)
+}
+
+func loudnessSidecarKey(fi os.FileInfo, track uint) []byte {
+	return sidecarKey(loudnessSidecarMagic, fi, uint64(track))
+}
+
+// readLoudnessSidecar returns the loudness of the sidecar file of the input at path if it is for key.
+func readLoudnessSidecar(path string, key []byte) (float64, bool) {
+	data, ok := readSidecar(path+".loudness", key)
+	if !ok || len(data) != 8 {
+		return 0, false
+	}
+	return math.Float64frombits(binary.LittleEndian.Uint64(data)), true
+}
+
+func writeLoudnessSidecar(path string, key []byte, loudness float64) {
+	writeSidecar(path+".loudness", key, binary.LittleEndian.AppendUint64(nil, math.Float64bits(loudness)))
+}
+
+// biquad is the coefficients of a biquad filter normalized by a0.
+type biquad struct {
+	b0, b1, b2 float64
+	a1, a2     float64
+}
+
+// kWeighting returns the two stages of the K-weighting filter of BS.1770 at rate: the high shelf modelling the head,
+// and the high-pass. The coefficients are derived from the analog prototypes, so that any rate is weighted the same
+// as the coefficients of the specification at 48 kHz.
+func kWeighting(rate int) [2]biquad {
+	var k [2]biquad
+
+	const (
+		shelfF0   = 1681.974450955533
+		shelfGain = 3.999843853973347
+		shelfQ    = 0.7071752369554196
+	)
+	K := math.Tan(math.Pi * shelfF0 / float64(rate))
+	vh := math.Pow(10, shelfGain/20)
+	vb := math.Pow(vh, 0.4996667741545416)
+	a0 := 1 + K/shelfQ + K*K
+	k[0] = biquad{
+		b0: (vh + vb*K/shelfQ + K*K) / a0,
+		b1: 2 * (K*K - vh) / a0,
+		b2: (vh - vb*K/shelfQ + K*K) / a0,
+		a1: 2 * (K*K - 1) / a0,
+		a2: (1 - K/shelfQ + K*K) / a0,
+	}
+
+	const (
+		highPassF0 = 38.13547087602444
+		highPassQ  = 0.5003270373238773
+	)
+	K = math.Tan(math.Pi * highPassF0 / float64(rate))
+	a0 = 1 + K/highPassQ + K*K
+	k[1] = biquad{
+		b0: 1,
+		b1: -2,
+		b2: 1,
+		a1: 2 * (K*K - 1) / a0,
+		a2: (1 - K/highPassQ + K*K) / a0,
+	}
+	return k
+}
+
+// surroundLoudnessWeights returns the weights of BS.1770 for the channels in the Vorbis order, or nil if the layout
+// of the channel count is unknown. The surround channels beside the listener, from 60 to 120 degrees, are weighted by
+// 1.41, the other channels by 1, and LFE is not measured.
+func surroundLoudnessWeights(channels int) []float64 {
+	const (
+		f = 1
+		s = 1.41
+	)
+	switch channels {
+	case 3:
+		// L, C, R
+		return []float64{f, f, f}
+	case 4:
+		// FL, FR, RL, RR
+		return []float64{f, f, s, s}
+	case 5:
+		// FL, C, FR, RL, RR
+		return []float64{f, f, f, s, s}
+	case 6:
+		// FL, C, FR, RL, RR, LFE
+		return []float64{f, f, f, s, s, 0}
+	case 7:
+		// FL, C, FR, SL, SR, RC, LFE
+		return []float64{f, f, f, s, s, f, 0}
+	case 8:
+		// FL, C, FR, SL, SR, RL, RR, LFE
+		return []float64{f, f, f, s, s, f, f, 0}
+	}
+	return nil
+}
+
+// loudnessMeter measures the integrated loudness of interleaved float32 PCM: the stereo output, or the decoded
+// channels before the downmix.
+//
+// The energies of the K-weighted samples are summed in 100 millisecond steps, and the gating blocks of 400
+// milliseconds overlapping by 75% are made of 4 steps at the end, so the PCM is filtered once without keeping it.
+type loudnessMeter struct {
+	k [2]biquad
+
+	// weights is the weight of each channel of a frame in the sum of the energies. A channel of weight 0 is not
+	// filtered.
+	weights []float64
+
+	// source is true if the decoder writes the decoded channels before the downmix, instead of the output.
+	source bool
+
+	// z is the states of the filter stages in transposed direct form II, 4 for each channel.
+	z []float64
+
+	// step is the number of the frames of a step, left is the number of the frames left in the current step, and
+	// sum is the weighted sum of the squares in the current step.
+	step int
+	left int
+	sum  float64
+
+	// steps is the mean squares of the finished steps, summed over the channels.
+	steps []float64
+
+	// done is called with the loudness when the stream measured reaches its end, if not nil.
+	done func(loudness float64)
+}
+
+func newLoudnessMeter(rate int, weights []float64, source bool) *loudnessMeter {
+	step := max(rate/10, 1)
+	return &loudnessMeter{
+		k:       kWeighting(rate),
+		weights: weights,
+		source:  source,
+		z:       make([]float64, 4*len(weights)),
+		step:    step,
+		left:    step,
+	}
+}
+
+// newLoudnessMeter returns a meter for a. The decoded channels are measured before the downmix if their layout is
+// known. Otherwise, the stereo output is measured, where mono is duplicated and counted once.
+func (a *audioStream) newLoudnessMeter() *loudnessMeter {
+	if a.loudnessWeights != nil && a.clip == nil {
+		return newLoudnessMeter(a.SamplingFrequency(), a.loudnessWeights, true)
+	}
+	if a.Channels() == 1 {
+		return newLoudnessMeter(a.SamplingFrequency(), []float64{1, 0}, false)
+	}
+	return newLoudnessMeter(a.SamplingFrequency(), []float64{1, 1}, false)
+}
+
+// write filters and sums samples, which has whole frames.
+func (m *loudnessMeter) write(samples []float32) {
+	channels := len(m.weights)
+	for len(samples) >= channels {
+		n := min(len(samples)/channels, m.left)
+		if channels == 2 {
+			m.writeStereo(samples[:2*n])
+		} else {
+			for c, w := range m.weights {
+				if w != 0 {
+					m.sum += w * m.filter(samples[c:], channels, n, m.z[4*c:4*c+4])
+				}
+			}
+		}
+		samples = samples[n*channels:]
+		m.left -= n
+		if m.left == 0 {
+			m.steps = append(m.steps, m.sum/float64(m.step))
+			m.left = m.step
+			m.sum = 0
+		}
+	}
+}
+
+// writeStereo filters and sums the stereo frames of samples in the current step.
+func (m *loudnessMeter) writeStereo(samples []float32) {
+	s, h := m.k[0], m.k[1]
+	// The two channels are filtered in the same iteration with the states in locals, so that their independent
+	// chains of the recursions overlap in the pipeline.
+	z := (*[8]float64)(m.z)
+	sl1, sl2, hl1, hl2 := z[0], z[1], z[2], z[3]
+	sr1, sr2, hr1, hr2 := z[4], z[5], z[6], z[7]
+	var el, er float64
+	for i := 0; i < len(samples); i += 2 {
+		xl := float64(samples[i])
+		xr := float64(samples[i+1])
+
+		yl := s.b0*xl + sl1
+		sl1 = s.b1*xl - s.a1*yl + sl2
+		sl2 = s.b2*xl - s.a2*yl
+		yr := s.b0*xr + sr1
+		sr1 = s.b1*xr - s.a1*yr + sr2
+		sr2 = s.b2*xr - s.a2*yr
+
+		zl := yl + hl1
+		hl1 = -2*yl - h.a1*zl + hl2
+		hl2 = yl - h.a2*zl
+		zr := yr + hr1
+		hr1 = -2*yr - h.a1*zr + hr2
+		hr2 = yr - h.a2*zr
+
+		el += zl * zl
+		er += zr * zr
+	}
+	*z = [8]float64{sl1, sl2, hl1, hl2, sr1, sr2, hr1, hr2}
+	m.sum += m.weights[0]*el + m.weights[1]*er
+}
+
+// filter filters n samples of a channel at the stride in samples with the states z, and returns the sum of the
+// squares.
+func (m *loudnessMeter) filter(samples []float32, stride int, n int, z []float64) float64 {
+	s, h := m.k[0], m.k[1]
+	s1, s2, h1, h2 := z[0], z[1], z[2], z[3]
+	var e float64
+	for i := 0; i < n*stride; i += stride {
+		x := float64(samples[i])
+		y := s.b0*x + s1
+		s1 = s.b1*x - s.a1*y + s2
+		s2 = s.b2*x - s.a2*y
+		o := y + h1
+		h1 = -2*y - h.a1*o + h2
+		h2 = y - h.a2*o
+		e += o * o
+	}
+	z[0], z[1], z[2], z[3] = s1, s2, h1, h2
+	return e
+}
+
+// meterLoudness measures the output in buf with a.loudness, and finishes the measurement at the end of the stream.
+// meterLoudness is called on the goroutine decoding a, which a.loudness belongs to.
+func (a *audioStream) meterLoudness(buf []byte, err error) {
+	m := a.loudness
+	if m == nil {
+		return
+	}
+	if !m.source && len(buf) > 0 {
+		m.write(unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/bytesPerFrame*2))
+	}
+	if err == io.EOF {
+		a.loudness = nil
+		if l, ok := m.integrated(); ok && m.done != nil {
+			m.done(l)
+		}
+	}
+}
+
+// meterSource measures the decoded channels pcm before the downmix, if a.loudness measures them. pcm must not have
+// the frames discarded from the output.
+func (a *audioStream) meterSource(pcm []float32) {
+	if m := a.loudness; m != nil && m.source {
+		m.write(pcm)
+	}
+}
+
+// sourceBuffer returns the buffer for the decoded channels of frames frames to give to meterSource, or nil if
+// a.loudness doesn't measure them.
+func (a *audioStream) sourceBuffer(buf *[]float32, frames int) []float32 {
+	if m := a.loudness; m == nil || !m.source {
+		return nil
+	}
+	n := frames * a.channels
+	if cap(*buf) < n {
+		*buf = make([]float32, n)
+	}
+	return (*buf)[:n]
+}
+
+// integrated returns the gated mean loudness of the blocks in LUFS. integrated returns false if no block passes the
+// absolute gate, e.g. if the audio is silent or shorter than a block. The last incomplete block is not counted.
+func (m *loudnessMeter) integrated() (float64, bool) {
+	block := func(i int) float64 {
+		return (m.steps[i] + m.steps[i+1] + m.steps[i+2] + m.steps[i+3]) / 4
+	}
+	gated := func(gate float64) (float64, int) {
+		var sum float64
+		var n int
+		for i := 0; i+4 <= len(m.steps); i++ {
+			if e := block(i); e > gate {
+				sum += e
+				n++
+			}
+		}
+		return sum, n
+	}
+
+	sum, n := gated(loudnessEnergy(loudnessAbsoluteGate))
+	if n == 0 {
+		return 0, false
+	}
+	relative := loudnessEnergy(energyLoudness(sum/float64(n)) + loudnessRelativeGate)
+	sum, n = gated(max(relative, loudnessEnergy(loudnessAbsoluteGate)))
+	if n == 0 {
+		return 0, false
+	}
+	return energyLoudness(sum / float64(n)), true
+}
+
+// loudnessEnergy and energyLoudness convert between a loudness in LUFS and the mean square of the K-weighted samples.
+func loudnessEnergy(loudness float64) float64 {
+	return math.Pow(10, (loudness+0.691)/10)
+}
+
+func energyLoudness(energy float64) float64 {
+	return -0.691 + 10*math.Log10(energy)
+}
+
+// initLoudness applies the gain of PlayerOptions.LoudnessTarget by the loudness known at the start, or starts to
+// measure the loudness during the playback. path is the input of the audio if the Player plays local files, whose
+// sidecar file keeps the loudness measured, or an empty string.
+func (p *Player) initLoudness(options *PlayerOptions, path string) {
+	if p.audioStream == nil || options.LoudnessTarget == 0 {
+		return
+	}
+
+	loudness := options.Loudness
+	var key []byte
+	if path != "" {
+		if fi, err := os.Stat(path); err == nil {
+			key = loudnessSidecarKey(fi, p.AudioTrack())
+			if l, ok := readLoudnessSidecar(path, key); ok && loudness == 0 {
+				loudness = l
+			}
+		}
+	}
+	if loudness != 0 {
+		p.loudness.Store(math.Float64bits(loudness))
+		p.normalization = loudnessGain(options.LoudnessTarget, loudness)
+		p.audioPlayer.fade(p.normalization, 0)
+		return
+	}
+
+	// The gain is not changed in the middle of the playback, but applies to the next Players.
+	a := p.audioStream
+	a.loudness = a.newLoudnessMeter()
+	a.loudness.done = func(loudness float64) {
+		p.loudness.Store(math.Float64bits(loudness))
+		if key != nil {
+			// done is called by the audio player's goroutine, which must not wait for the file.
+			go writeLoudnessSidecar(path, key, loudness)
+		}
+	}
+}
+
+// Loudness returns the integrated loudness of the audio in LUFS with PlayerOptions.LoudnessTarget: PlayerOptions.Loudness,
+// the loudness of the sidecar file, or the loudness measured during the playback. Loudness returns false until the
+// loudness is known.
+func (p *Player) Loudness() (float64, bool) {
+	bits := p.loudness.Load()
+	return math.Float64frombits(bits), bits != 0
+}
+
+// normalizationGain returns the gain of PlayerOptions.LoudnessTarget, which is applied with the volume.
+func (p *Player) normalizationGain() float64 {
+	if p.normalization == 0 {
+		return 1
+	}
+	return p.normalization
+}
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"io"
+	"io/fs"
+	"sync"
+	"unsafe"
+
+	"github.com/ebml-go/webm"
+)
+
+// maxMemoryIndexes is the number of the inputs in memory whose headers are kept for the next Players.
+const maxMemoryIndexes = 16
+
+// NewPlayerFromBytes creates a Player from WebM files in memory, e.g. []byte variables with //go:embed.
+// A video file and an audio file can be specified separately, like NewPlayerWithOptions.
+//
+// The packets refer to data instead of copies of it, so data must not be modified after this.
+// The headers are parsed once for the same data, and shared by its Players.
+func NewPlayerFromBytes(options *PlayerOptions, data ...[]byte) (*Player, error) {
+	streams := make([]io.ReadSeeker, 0, len(data))
+	for _, d := range data {
+		streams = append(streams, newMemoryReader(d))
+	}
+	return NewPlayerWithOptions(options, streams...)
+}
+
+// NewPlayerFromFS creates a Player from WebM files in fsys, e.g. embed.FS, like NewPlayerFromFile.
+// Each file is read into memory at once, and then is played as NewPlayerFromBytes plays.
+//
+// embed.FS copies a file to read it anyway. To play an embedded file without a copy, embed it into a []byte variable
+// and use NewPlayerFromBytes.
+func NewPlayerFromFS(options *PlayerOptions, fsys fs.FS, names ...string) (*Player, error) {
+	data := make([][]byte, 0, len(names))
+	for _, name := range names {
+		d, err := fs.ReadFile(fsys, name)
+		if err != nil {
+			return nil, err
+		}
+		data = append(data, d)
+	}
+	return NewPlayerFromBytes(options, data...)
+}
+
+// memoryReader is an io.ReadSeeker over an input in memory, whose blocks webmReader refers to without copying.
+type memoryReader struct {
+	*bytes.Reader
+	data []byte
+
+	// index is the headers of data if they are known, e.g. from a Bundle, and owner keeps the memory of data, e.g.
+	// the mapping of a Bundle, while the Players of data refer to it.
+	index *webmIndex
+	owner any
+}
+
+func newMemoryReader(data []byte) *memoryReader {
+	return &memoryReader{
+		Reader: bytes.NewReader(data),
+		data:   data,
+	}
+}
+
+// webmIndex is the headers of an input in memory, which the webmReaders of the same input share.
+type webmIndex struct {
+	meta         webm.WebM
+	colors       map[uint]trackColor
+	segment      int64
+	segmentEnd   int64
+	firstCluster int64
+}
+
+// memoryIndexKey identifies an input in memory by its data and the offset where it is parsed from.
+type memoryIndexKey struct {
+	data  *byte
+	size  int
+	start int64
+}
+
+// memoryIndexes is the headers of the latest inputs in memory, in the order they are stored.
+var memoryIndexes struct {
+	m     sync.Mutex
+	keys  []memoryIndexKey
+	index map[memoryIndexKey]*webmIndex
+}
+
+// lookupMemoryIndex returns the headers of m parsed from start, or nil if m is nil or not parsed yet.
+func lookupMemoryIndex(m *memoryReader, start int64) *webmIndex {
+	if m == nil || len(m.data) == 0 {
+		return nil
+	}
+	if m.index != nil && start == 0 {
+		return m.index
+	}
+	if m.owner != nil {
+		return nil
+	}
+	memoryIndexes.m.Lock()
+	defer memoryIndexes.m.Unlock()
+	return memoryIndexes.index[memoryIndexKey{data: unsafe.SliceData(m.data), size: len(m.data), start: start}]
+}
+
+// storeMemoryIndex keeps the headers of m parsed from start. The oldest headers are dropped beyond
+// maxMemoryIndexes, so that the data they keep alive is bounded.
+func storeMemoryIndex(m *memoryReader, start int64, idx *webmIndex) {
+	// The memory of a Bundle can be reused after it is unmapped, so it is not identified by its address.
+	if len(m.data) == 0 || m.owner != nil {
+		return
+	}
+	key := memoryIndexKey{data: unsafe.SliceData(m.data), size: len(m.data), start: start}
+	memoryIndexes.m.Lock()
+	defer memoryIndexes.m.Unlock()
+	if memoryIndexes.index == nil {
+		memoryIndexes.index = map[memoryIndexKey]*webmIndex{}
+	}
+	if _, ok := memoryIndexes.index[key]; ok {
+		return
+	}
+	if len(memoryIndexes.keys) == maxMemoryIndexes {
+		delete(memoryIndexes.index, memoryIndexes.keys[0])
+		memoryIndexes.keys = append(memoryIndexes.keys[:0], memoryIndexes.keys[1:]...)
+	}
+	memoryIndexes.keys = append(memoryIndexes.keys, key)
+	memoryIndexes.index[key] = idx
+}
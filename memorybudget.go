@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"sync/atomic"
+)
+
+// memoryClass is a kind of the memory of the Players accounted by the memory budget.
+type memoryClass int
+
+const (
+	memoryDemuxQueues memoryClass = iota
+	memoryVideoFrames
+	memoryTextures
+	memoryFrameCaches
+	memoryAudioBuffers
+	memoryAudioClips
+
+	memoryClassCount
+)
+
+// memoryBudget is the memory accounted for all the Players in the process.
+var memoryBudget struct {
+	// limit is the budget in bytes, or 0 without a budget.
+	limit atomic.Int64
+
+	usage [memoryClassCount]atomic.Int64
+	total atomic.Int64
+
+	// evicting is true while the caches are being evicted.
+	evicting atomic.Bool
+}
+
+// SetMemoryBudget sets the budget in bytes of the memory of all the Players in the process, e.g. for a device with
+// little memory. If bytes is 0 or less, there is no budget, which is the default.
+//
+// The budget is not a hard limit. While the memory accounted is over the budget, the caches are evicted, i.e. the
+// predecoded audio clips of PlayerOptions.AudioPredecode, the frames of PlayerOptions.VideoFrameCacheBytes and the
+// frames kept for stepping, and the read-ahead of the demuxers shrinks to a quarter of PlayerOptions.ReadAhead and
+// ReadAheadBytes. The memory of the decoders themselves, e.g. the reference frames of libvpx, is not accounted.
+func SetMemoryBudget(bytes int64) {
+	memoryBudget.limit.Store(max(bytes, 0))
+	if memoryPressure() {
+		evictMemory()
+	}
+}
+
+// MemoryUsage is the memory accounted for all the Players in the process, in bytes.
+type MemoryUsage struct {
+	// Budget is the budget by SetMemoryBudget, or 0.
+	Budget int64
+
+	// DemuxQueues is the packets read ahead of the decoders.
+	DemuxQueues int64
+
+	// VideoFrames is the decoded frames waiting for presentation, and Textures is the textures the frames are
+	// converted and drawn in.
+	VideoFrames int64
+	Textures    int64
+
+	// FrameCaches is the frames kept by PlayerOptions.VideoFrameCacheBytes and for stepping.
+	FrameCaches int64
+
+	// AudioBuffers is the decoded audio waiting for the audio player, e.g. by PlayerOptions.AudioDecodeAhead, and
+	// AudioClips is the audio predecoded by PlayerOptions.AudioPredecode.
+	AudioBuffers int64
+	AudioClips   int64
+}
+
+// Total returns the sum of the memory accounted.
+func (u *MemoryUsage) Total() int64 {
+	return u.DemuxQueues + u.VideoFrames + u.Textures + u.FrameCaches + u.AudioBuffers + u.AudioClips
+}
+
+// ReadMemoryUsage returns the memory accounted for all the Players in the process.
+func ReadMemoryUsage() MemoryUsage {
+	b := &memoryBudget
+	return MemoryUsage{
+		Budget:       b.limit.Load(),
+		DemuxQueues:  b.usage[memoryDemuxQueues].Load(),
+		VideoFrames:  b.usage[memoryVideoFrames].Load(),
+		Textures:     b.usage[memoryTextures].Load(),
+		FrameCaches:  b.usage[memoryFrameCaches].Load(),
+		AudioBuffers: b.usage[memoryAudioBuffers].Load(),
+		AudioClips:   b.usage[memoryAudioClips].Load(),
+	}
+}
+
+// trackMemory adds delta bytes to the memory of the class c. An allocation over the budget starts evicting the caches.
+func trackMemory(c memoryClass, delta int64) {
+	if delta == 0 {
+		return
+	}
+	b := &memoryBudget
+	b.usage[c].Add(delta)
+	b.total.Add(delta)
+	if delta > 0 && memoryPressure() {
+		evictMemory()
+	}
+}
+
+// memoryPressure reports whether the memory accounted is over the budget.
+func memoryPressure() bool {
+	limit := memoryBudget.limit.Load()
+	return limit > 0 && memoryBudget.total.Load() > limit
+}
+
+// evictMemory evicts the caches shared by the Players on another goroutine, as trackMemory can be called with the
+// locks of the caches. The caches of each Player are given up by the Player while memoryPressure reports true.
+func evictMemory() {
+	if !memoryBudget.evicting.CompareAndSwap(false, true) {
+		return
+	}
+	go func() {
+		defer memoryBudget.evicting.Store(false)
+		evictPCMClips()
+	}()
+}
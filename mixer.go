@@ -0,0 +1,478 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"io"
+	"sync"
+	"sync/atomic"
+	"time"
+	"unsafe"
+
+	"github.com/hajimehoshi/ebiten/v2/audio"
+)
+
+// mixerBufferSize is the buffer size of the audio player of the mixer.
+// A seek of an input is heard after the buffered audio, so the buffer is kept small.
+const mixerBufferSize = 50 * time.Millisecond
+
+// lowLatencyMixerBufferSize is the buffer size of the audio player of the mixer after a Player with
+// PlayerOptions.LowLatency is created.
+const lowLatencyMixerBufferSize = 20 * time.Millisecond
+
+var (
+	theMixerM sync.Mutex
+	theMixer  *mixer
+)
+
+// mixerTap is called with the stereo frames of each mix at the mixer's rate on the audio callback, with the mixer's
+// lock held. A tap must not block, and must not refer to frames after it returns.
+type mixerTap func(frames []float32, sampleRate int)
+
+// theMixerTap is the tap of the mix, or nil. The tap is set without the mixer's lock, and is loaded at each mix.
+var theMixerTap atomic.Pointer[mixerTap]
+
+// mixer mixes the audio of all the Players into one audio player of the shared audio context,
+// so that the audio device pulls all the Players in one callback.
+//
+// The mixer plays silence while an input is paused, so its position always advances.
+// The audio player of the mixer is paused while no inputs are playing, so an idle mixer doesn't pull the device.
+type mixer struct {
+	sampleRate int
+	player     *audio.Player
+
+	// outputInt16 is true if the audio player takes 16-bit samples, with PlayerOptions.AudioOutputInt16. The
+	// positions are in the bytes of the float32 frames in any case.
+	outputInt16 bool
+
+	// deviceM serializes playing and pausing the audio player. The mixer's lock must not be held while the audio
+	// player is played or paused, as the audio player calls Read with its own lock.
+	deviceM sync.Mutex
+
+	// bufferSize is the buffer size of the audio player, protected by deviceM.
+	bufferSize time.Duration
+
+	m      sync.Mutex
+	inputs []*mixerInput
+
+	// read is the number of bytes read by the audio player.
+	read int64
+
+	buf []float32
+
+	// out is the mix before it is quantized to the 16-bit samples when outputInt16 is true.
+	out []float32
+}
+
+// mixerBytesPerFrameInt16 is the size of a stereo 16-bit frame of the audio player with PlayerOptions.AudioOutputInt16.
+const mixerBytesPerFrameInt16 = 4
+
+// sharedMixer returns the mixer. If there is no mixer yet, sharedMixer creates it with outputInt16. If there is no
+// audio context yet, sharedMixer creates it with sampleRate.
+func sharedMixer(sampleRate int, outputInt16 bool) (*mixer, error) {
+	theMixerM.Lock()
+	defer theMixerM.Unlock()
+	if theMixer != nil {
+		return theMixer, nil
+	}
+
+	// Only one audio context can exist in a process. The inputs are resampled to the context's rate.
+	ctx := audio.CurrentContext()
+	if ctx == nil {
+		ctx = audio.NewContext(sampleRate)
+	}
+	m := &mixer{
+		sampleRate:  ctx.SampleRate(),
+		outputInt16: outputInt16,
+	}
+	var p *audio.Player
+	var err error
+	if outputInt16 {
+		p, err = ctx.NewPlayer(m)
+	} else {
+		p, err = ctx.NewPlayerF32(m)
+	}
+	if err != nil {
+		return nil, err
+	}
+	p.SetBufferSize(mixerBufferSize)
+	m.player = p
+	m.bufferSize = mixerBufferSize
+	theMixer = m
+	return m, nil
+}
+
+// contextSampleRate returns the rate of the audio context, or 0 if there is no audio context yet.
+func contextSampleRate() int {
+	if ctx := audio.CurrentContext(); ctx != nil {
+		return ctx.SampleRate()
+	}
+	return 0
+}
+
+// newInput adds src, a stereo float32 stream at the mixer's rate. The input is paused until Play is called.
+func (m *mixer) newInput(src io.ReadSeeker) *mixerInput {
+	i := &mixerInput{
+		mixer:  m,
+		src:    src,
+		gain:   1,
+		target: 1,
+	}
+	m.m.Lock()
+	defer m.m.Unlock()
+	m.inputs = append(m.inputs, i)
+	return i
+}
+
+func (m *mixer) Read(buf []byte) (int, error) {
+	m.m.Lock()
+	defer m.m.Unlock()
+
+	if m.outputInt16 {
+		buf = buf[:len(buf)/mixerBytesPerFrameInt16*mixerBytesPerFrameInt16]
+		n := len(buf) / 2
+		if len(m.out) < n {
+			m.out = make([]float32, n)
+		}
+		m.mix(m.out[:n])
+		quantizeInt16(unsafe.Slice((*int16)(unsafe.Pointer(unsafe.SliceData(buf))), n), m.out[:n])
+		return len(buf), nil
+	}
+
+	buf = buf[:len(buf)/bytesPerFrame*bytesPerFrame]
+	m.mix(unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4))
+	return len(buf), nil
+}
+
+// mix mixes the playing inputs into the stereo frames dst. mix must be called with m.m locked.
+func (m *mixer) mix(dst []float32) {
+	if len(m.buf) < len(dst) {
+		m.buf = make([]float32, len(dst))
+	}
+	clear(dst)
+	for _, i := range m.inputs {
+		if !i.playing || i.ended {
+			continue
+		}
+		src := m.buf[:len(dst)]
+		n, err := i.read(unsafe.Slice((*byte)(unsafe.Pointer(unsafe.SliceData(src))), 4*len(src)))
+		i.mix(dst, src[:n/4])
+		if errors.Is(err, errAudioNotReady) {
+			// The rest is silence, and the input's audio after it is heard later by the silence.
+			i.mark += int64(4*len(dst) - n)
+			continue
+		}
+		if err != nil {
+			// An input failing is treated as its end, so that the other inputs keep playing.
+			i.ended = true
+		}
+	}
+	if t := theMixerTap.Load(); t != nil {
+		(*t)(dst, m.sampleRate)
+	}
+	m.read += int64(4 * len(dst))
+}
+
+// updateDevice plays the audio player if any inputs are playing, or pauses it otherwise.
+func (m *mixer) updateDevice() {
+	m.deviceM.Lock()
+	defer m.deviceM.Unlock()
+
+	m.m.Lock()
+	var playing bool
+	for _, i := range m.inputs {
+		if i.playing {
+			playing = true
+			break
+		}
+	}
+	m.m.Unlock()
+
+	if playing == m.player.IsPlaying() {
+		return
+	}
+	if playing {
+		m.player.Play()
+	} else {
+		m.player.Pause()
+	}
+}
+
+// reduceBufferSize makes the buffer of the audio player d if it is larger. The buffer is shared by all the inputs,
+// so it is never made larger again.
+func (m *mixer) reduceBufferSize(d time.Duration) {
+	m.deviceM.Lock()
+	defer m.deviceM.Unlock()
+	if m.bufferSize <= d {
+		return
+	}
+	m.player.SetBufferSize(d)
+	m.bufferSize = d
+}
+
+// played returns the number of the bytes that have been played.
+// played must not be called with m.m locked, as the audio player calls Read with its lock.
+func (m *mixer) played() int64 {
+	return int64(m.player.Position()) * int64(m.sampleRate) / int64(time.Second) * bytesPerFrame
+}
+
+func (m *mixer) duration(bytes int64) time.Duration {
+	return time.Duration(bytes/bytesPerFrame) * time.Second / time.Duration(m.sampleRate)
+}
+
+// mixAdd adds src to dst. The loop is unrolled by 4 so that the additions are independent of each other.
+func mixAdd(dst, src []float32) {
+	dst = dst[:len(src)]
+	n := len(src) &^ 3
+	for i := 0; i < n; i += 4 {
+		d := dst[i : i+4 : i+4]
+		s := src[i : i+4 : i+4]
+		d[0] += s[0]
+		d[1] += s[1]
+		d[2] += s[2]
+		d[3] += s[3]
+	}
+	for i := n; i < len(src); i++ {
+		dst[i] += src[i]
+	}
+}
+
+// mixAddGain adds src multiplied by gain to dst.
+func mixAddGain(dst, src []float32, gain float32) {
+	dst = dst[:len(src)]
+	n := len(src) &^ 3
+	for i := 0; i < n; i += 4 {
+		d := dst[i : i+4 : i+4]
+		s := src[i : i+4 : i+4]
+		d[0] += s[0] * gain
+		d[1] += s[1] * gain
+		d[2] += s[2] * gain
+		d[3] += s[3] * gain
+	}
+	for i := n; i < len(src); i++ {
+		dst[i] += src[i] * gain
+	}
+}
+
+// mixAddRamp adds the stereo frames of src multiplied by a gain to dst. The gain starts at gain and changes by step
+// every frame. mixAddRamp returns the gain after the last frame.
+func mixAddRamp(dst, src []float32, gain, step float32) float32 {
+	dst = dst[:len(src)]
+	n := len(src) &^ 3
+	for i := 0; i < n; i += 4 {
+		d := dst[i : i+4 : i+4]
+		s := src[i : i+4 : i+4]
+		g1 := gain + step
+		d[0] += s[0] * gain
+		d[1] += s[1] * gain
+		d[2] += s[2] * g1
+		d[3] += s[3] * g1
+		gain = g1 + step
+	}
+	for i := n; i+1 < len(src); i += 2 {
+		dst[i] += src[i] * gain
+		dst[i+1] += src[i+1] * gain
+		gain += step
+	}
+	return gain
+}
+
+// quantizeInt16 clamps the samples of src to [-1, 1] and rounds them to the 16-bit samples dst. The loop is unrolled by
+// 4 as mixAdd.
+func quantizeInt16(dst []int16, src []float32) {
+	dst = dst[:len(src)]
+	n := len(src) &^ 3
+	for i := 0; i < n; i += 4 {
+		d := dst[i : i+4 : i+4]
+		s := src[i : i+4 : i+4]
+		d[0] = toInt16(s[0])
+		d[1] = toInt16(s[1])
+		d[2] = toInt16(s[2])
+		d[3] = toInt16(s[3])
+	}
+	for i := n; i < len(src); i++ {
+		dst[i] = toInt16(src[i])
+	}
+}
+
+// toInt16 rounds v in [-1, 1] to 16 bits. The sum is positive, so the conversion truncating it rounds it.
+func toInt16(v float32) int16 {
+	v = min(max(v, -1), 1)
+	return int16(int32(v*32767+32768.5) - 32768)
+}
+
+// mixerInput is an input of the mixer. mixerInput implements audioOutput.
+type mixerInput struct {
+	mixer *mixer
+	src   io.ReadSeeker
+
+	// The fields below are protected by the mixer's lock.
+
+	playing bool
+	ended   bool
+
+	// pos is the reading position of src in bytes.
+	pos int64
+
+	// base is the position heard at the mixer's read position mark.
+	// The audio read after mark is heard after the audio buffered in the audio player.
+	base int64
+	mark int64
+
+	// gain is the gain of the next frame. gain changes by step every frame for ramp frames, and then is target.
+	gain   float32
+	target float32
+	step   float32
+	ramp   int
+}
+
+// mix adds the frames of src to dst with the gain.
+func (i *mixerInput) mix(dst, src []float32) {
+	if i.ramp > 0 {
+		n := min(2*i.ramp, len(src)&^1)
+		i.gain = mixAddRamp(dst, src[:n], i.gain, i.step)
+		i.ramp -= n / 2
+		if i.ramp == 0 {
+			i.gain = i.target
+		}
+		dst, src = dst[n:], src[n:]
+	}
+	if i.gain == 1 {
+		mixAdd(dst, src)
+		return
+	}
+	if i.gain != 0 {
+		mixAddGain(dst, src, i.gain)
+	}
+}
+
+// fade changes the gain to volume linearly in d of the output. If d is 0, the gain changes at the next frame.
+func (i *mixerInput) fade(volume float64, d time.Duration) {
+	m := i.mixer
+	m.m.Lock()
+	defer m.m.Unlock()
+	i.target = float32(max(volume, 0))
+	i.ramp = int(d * time.Duration(m.sampleRate) / time.Second)
+	if i.ramp <= 0 {
+		i.ramp = 0
+		i.gain = i.target
+		return
+	}
+	i.step = (i.target - i.gain) / float32(i.ramp)
+}
+
+// volume returns the gain that the input has or is fading to.
+func (i *mixerInput) volume() float64 {
+	m := i.mixer
+	m.m.Lock()
+	defer m.m.Unlock()
+	return float64(i.target)
+}
+
+// read reads src until buf is full or src ends.
+func (i *mixerInput) read(buf []byte) (int, error) {
+	var n int
+	for n < len(buf) {
+		m, err := i.src.Read(buf[n:])
+		n += m
+		if err != nil {
+			i.pos += int64(n)
+			return n, err
+		}
+		if m == 0 {
+			break
+		}
+	}
+	i.pos += int64(n)
+	return n, nil
+}
+
+// position returns the position being heard in bytes. played is the result of mixer.played.
+func (i *mixerInput) position(played int64) int64 {
+	if !i.playing {
+		return i.base
+	}
+	return min(i.base+max(played-i.mark, 0), i.pos)
+}
+
+func (i *mixerInput) Play() {
+	m := i.mixer
+	m.m.Lock()
+	if i.playing && !i.ended {
+		m.m.Unlock()
+		return
+	}
+	// The audio read ahead before a pause is skipped, which is at most the buffer size.
+	i.base = i.pos
+	i.mark = m.read
+	i.playing = true
+	i.ended = false
+	m.m.Unlock()
+
+	m.updateDevice()
+}
+
+func (i *mixerInput) Pause() {
+	m := i.mixer
+	played := m.played()
+	m.m.Lock()
+	if !i.playing {
+		m.m.Unlock()
+		return
+	}
+	i.base = i.position(played)
+	i.playing = false
+	m.m.Unlock()
+
+	m.updateDevice()
+}
+
+// finished reports whether src has ended and all of its audio has been played.
+func (i *mixerInput) finished() bool {
+	m := i.mixer
+	played := m.played()
+	m.m.Lock()
+	defer m.m.Unlock()
+	return i.ended && i.position(played) >= i.pos
+}
+
+func (i *mixerInput) Position() time.Duration {
+	m := i.mixer
+	played := m.played()
+	m.m.Lock()
+	defer m.m.Unlock()
+	return m.duration(i.position(played))
+}
+
+func (i *mixerInput) SetPosition(t time.Duration) error {
+	m := i.mixer
+	m.m.Lock()
+	defer m.m.Unlock()
+	offset := int64(t) * int64(m.sampleRate) / int64(time.Second) * bytesPerFrame
+	if _, err := i.src.Seek(offset, io.SeekStart); err != nil {
+		return err
+	}
+	i.pos = offset
+	i.base = offset
+	i.mark = m.read
+	i.ended = false
+	return nil
+}
+
+// Close removes the input from the mixer. src is not read after Close returns.
+func (i *mixerInput) Close() error {
+	m := i.mixer
+	m.m.Lock()
+	for j, i2 := range m.inputs {
+		if i2 == i {
+			m.inputs = append(m.inputs[:j], m.inputs[j+1:]...)
+			break
+		}
+	}
+	m.m.Unlock()
+
+	m.updateDevice()
+	return nil
+}
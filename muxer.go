@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"net"
+	"sync"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+const (
+	// muxerTimecodeScale is the timecode scale of the files written by Muxer.
+	muxerTimecodeScale = time.Millisecond
+
+	// maxMuxerClusterDuration and maxMuxerClusterSize bound a Cluster of Muxer without video keyframes, as a Cluster
+	// is in memory until it ends.
+	maxMuxerClusterDuration = 5 * time.Second
+	maxMuxerClusterSize     = 8 << 20
+
+	// clusterWriterQueue is the number of the buffers queued to a clusterWriter before the writes block.
+	clusterWriterQueue = 4
+
+	// clusterWriterChunk is the size of the buffers of a clusterWriter, where a buffer can have a part of a Cluster
+	// whose size is known before.
+	clusterWriterChunk = 1 << 20
+)
+
+// clusterWriter writes buffers to w on a goroutine, so that writing a Cluster overlaps building the next one.
+// The buffers queued at a time are written together with net.Buffers, which is a single writev for a network
+// connection.
+type clusterWriter struct {
+	w     io.Writer
+	queue chan *[]byte
+	done  chan struct{}
+	pool  sync.Pool
+
+	// vec is the buffers being written.
+	vec [][]byte
+
+	m   sync.Mutex
+	err error
+}
+
+func newClusterWriter(w io.Writer) *clusterWriter {
+	c := &clusterWriter{
+		w:     w,
+		queue: make(chan *[]byte, clusterWriterQueue),
+		done:  make(chan struct{}),
+	}
+	go c.loop()
+	return c
+}
+
+// buffer returns an empty buffer, which is given back to write.
+func (c *clusterWriter) buffer() *[]byte {
+	if b, ok := c.pool.Get().(*[]byte); ok {
+		*b = (*b)[:0]
+		return b
+	}
+	b := make([]byte, 0, clusterWriterChunk)
+	return &b
+}
+
+// write queues b to be written. b must not be used after write. write returns the error of an earlier write, if any.
+func (c *clusterWriter) write(b *[]byte) error {
+	if err := c.error(); err != nil {
+		c.pool.Put(b)
+		return err
+	}
+	c.queue <- b
+	return nil
+}
+
+// close waits for the queued buffers to be written, and returns the first error of the writes.
+func (c *clusterWriter) close() error {
+	close(c.queue)
+	<-c.done
+	return c.error()
+}
+
+func (c *clusterWriter) error() error {
+	c.m.Lock()
+	defer c.m.Unlock()
+	return c.err
+}
+
+func (c *clusterWriter) loop() {
+	defer close(c.done)
+	var bufs []*[]byte
+	for b := range c.queue {
+		bufs = append(bufs[:0], b)
+	gather:
+		for {
+			select {
+			case b, ok := <-c.queue:
+				if !ok {
+					break gather
+				}
+				bufs = append(bufs, b)
+			default:
+				break gather
+			}
+		}
+
+		// After an error, the buffers are only given back.
+		if c.error() == nil {
+			c.vec = c.vec[:0]
+			for _, b := range bufs {
+				c.vec = append(c.vec, *b)
+			}
+			v := net.Buffers(c.vec)
+			if _, err := v.WriteTo(c.w); err != nil {
+				c.m.Lock()
+				c.err = err
+				c.m.Unlock()
+			}
+		}
+		for _, b := range bufs {
+			c.pool.Put(b)
+		}
+	}
+}
+
+// muxerCue is a CuePoint of Muxer.
+type muxerCue struct {
+	timecode time.Duration
+
+	// pos is the position of the Cluster from the start of the Segment data.
+	pos uint64
+}
+
+// Muxer writes a WebM file packet by packet, e.g. to remux the packets of another file.
+//
+// A Cluster is built in memory, and written on another goroutine when the next Cluster starts, so that a Cluster is
+// a write. A Cluster starts at each keyframe of the first video track, or after 5 seconds or 8 MiB without one, and
+// the Cues of the Clusters starting at the keyframes are written at the end.
+//
+// If the writer is an io.WriteSeeker, Close writes the SeekHead to the Void element reserved before the Info, the
+// Duration, and the Segment size, so that the file is seekable without a second pass. Otherwise, the file is a
+// Segment of an unknown size, as a live stream is.
+type Muxer struct {
+	w *clusterWriter
+
+	// seeker is the writer if it is seekable, and origin is the position in seeker where the file starts.
+	seeker io.WriteSeeker
+	origin int64
+
+	// video is the track number of the first video track, or 0, and cueTrack is the track the Cues refer to.
+	video    uint
+	cueTrack uint
+
+	// dataStart is the position of the Segment data in the file, and durationPos is the position of the Duration
+	// value from the start of the Segment data.
+	dataStart   int64
+	durationPos int64
+
+	// infoPos and tracksPos are the positions of the Info and the Tracks from the start of the Segment data, and pos
+	// is the position of the next Cluster.
+	infoPos   uint64
+	tracksPos uint64
+	pos       uint64
+
+	// cluster is the Cluster being built, starting with the space of its header, or nil.
+	cluster         *[]byte
+	clusterTimecode time.Duration
+
+	cues []muxerCue
+	last time.Duration
+
+	closed bool
+	err    error
+}
+
+// NewMuxer creates a Muxer writing a WebM file of the tracks to w. The tracks are as Player.Meta returns them.
+// The Colour elements of the video tracks are not written.
+func NewMuxer(w io.Writer, tracks []webm.TrackEntry) (*Muxer, error) {
+	if len(tracks) == 0 {
+		return nil, errors.New("webmplayer: no tracks to mux")
+	}
+	m := &Muxer{
+		cueTrack: tracks[0].TrackNumber,
+	}
+	for i := range tracks {
+		if tracks[i].IsVideo() {
+			m.video = tracks[i].TrackNumber
+			m.cueTrack = m.video
+			break
+		}
+	}
+	// A pipe is an io.WriteSeeker that fails to seek.
+	if s, ok := w.(io.WriteSeeker); ok {
+		if origin, err := s.Seek(0, io.SeekCurrent); err == nil {
+			m.seeker = s
+			m.origin = origin
+		}
+	}
+
+	h := webmHeader()
+	h = appendEBMLFixedHeader(h, 0x18538067, ebmlUnknownSize)
+	m.dataStart = int64(len(h))
+
+	// The SeekHead is written to the Void at Close.
+	sh := len(muxerSeekHead(0, 0, 0))
+	h = appendEBMLFixedHeader(h, 0xec, uint64(sh-9))
+	h = append(h, make([]byte, sh-9)...)
+
+	m.infoPos = uint64(sh)
+	var info []byte
+	info = appendEBMLUint(info, 0x2ad7b1, uint64(muxerTimecodeScale))
+	durationPos := -1
+	if m.seeker != nil {
+		// The value of the Duration starts after its 2-byte ID and 1-byte size.
+		durationPos = len(info) + 3
+		info = appendEBMLFloat(info, 0x4489, 0)
+	}
+	info = appendEBMLString(info, 0x4d80, "webmplayer") // MuxingApp
+	info = appendEBMLString(info, 0x5741, "webmplayer") // WritingApp
+	if durationPos >= 0 {
+		m.durationPos = int64(m.infoPos) + int64(len(appendEBMLHeader(nil, 0x1549a966, uint64(len(info))))) + int64(durationPos)
+	}
+	info = appendEBMLMaster(nil, 0x1549a966, info)
+	h = append(h, info...)
+
+	m.tracksPos = m.infoPos + uint64(len(info))
+	ts := webmTracks(tracks, nil)
+	h = append(h, ts...)
+	m.pos = m.tracksPos + uint64(len(ts))
+
+	m.w = newClusterWriter(w)
+	b := m.w.buffer()
+	*b = append(*b, h...)
+	if err := m.w.write(b); err != nil {
+		return nil, err
+	}
+	return m, nil
+}
+
+// muxerSeekHead returns the SeekHead of the Info, the Tracks and the Cues at the positions. The size of the SeekHead
+// doesn't depend on the positions.
+func muxerSeekHead(info, tracks, cues uint64) []byte {
+	var sh []byte
+	for _, e := range []struct {
+		id  uint64
+		pos uint64
+	}{
+		{0x1549a966, info},
+		{0x1654ae6b, tracks},
+		{0x1c53bb6b, cues},
+	} {
+		var s []byte
+		// SeekID is the 4-byte ID of the element.
+		s = appendEBMLBytes(s, 0x53ab, appendEBMLHeader(nil, e.id, 0)[:4])
+		s = appendEBMLFixedUint(s, 0x53ac, e.pos)
+		sh = appendEBMLMaster(sh, 0x4dbb, s)
+	}
+	return appendEBMLMaster(nil, 0x114d9b74, sh)
+}
+
+// WritePacket writes the data of pkt as a SimpleBlock. The packets are written in the order of their timecodes.
+// WritePacket doesn't refer to pkt.Data after it returns.
+func (m *Muxer) WritePacket(pkt *webm.Packet) error {
+	if m.closed {
+		return errors.New("webmplayer: the muxer is closed")
+	}
+	if m.err != nil {
+		return m.err
+	}
+	if pkt.Timecode < 0 {
+		return fmt.Errorf("webmplayer: negative timecode: %v", pkt.Timecode)
+	}
+
+	keyframe := pkt.TrackNumber == m.video && pkt.Keyframe
+	rel := (pkt.Timecode - m.clusterTimecode) / muxerTimecodeScale
+	if m.cluster == nil || keyframe || pkt.Timecode-m.clusterTimecode >= maxMuxerClusterDuration || len(*m.cluster) >= maxMuxerClusterSize || rel > math.MaxInt16 || rel < math.MinInt16 {
+		if err := m.flush(); err != nil {
+			return err
+		}
+		m.startCluster(pkt.Timecode, keyframe || m.video == 0)
+		rel = 0
+	}
+	*m.cluster = appendSimpleBlock(*m.cluster, pkt.TrackNumber, int16(rel), simpleBlockFlags(pkt.Keyframe, pkt.Invisible, pkt.Discardable), pkt.Data)
+	m.last = max(m.last, pkt.Timecode)
+	return nil
+}
+
+func (m *Muxer) startCluster(timecode time.Duration, cue bool) {
+	if cue {
+		m.cues = append(m.cues, muxerCue{
+			timecode: timecode,
+			pos:      m.pos,
+		})
+	}
+	m.cluster = m.w.buffer()
+	// The space of the header is filled at flush.
+	*m.cluster = appendEBMLFixedHeader(*m.cluster, 0x1f43b675, 0)
+	*m.cluster = appendEBMLUint(*m.cluster, 0xe7, uint64(timecode/muxerTimecodeScale))
+	m.clusterTimecode = timecode
+}
+
+// flush queues the Cluster being built.
+func (m *Muxer) flush() error {
+	if m.cluster == nil {
+		return nil
+	}
+	b := m.cluster
+	m.cluster = nil
+	n := len(appendEBMLFixedHeader(nil, 0x1f43b675, 0))
+	appendEBMLFixedHeader((*b)[:0], 0x1f43b675, uint64(len(*b)-n))
+	m.pos += uint64(len(*b))
+	if err := m.w.write(b); err != nil {
+		m.err = err
+		return err
+	}
+	return nil
+}
+
+// Close writes the rest of the file, and waits for the writes to finish. Close doesn't close the writer.
+func (m *Muxer) Close() error {
+	if m.closed {
+		return m.err
+	}
+	m.closed = true
+	if err := m.close(); err != nil && m.err == nil {
+		m.err = err
+	}
+	return m.err
+}
+
+func (m *Muxer) close() error {
+	err := m.flush()
+	cuesPos := m.pos
+	if err == nil {
+		var cs []byte
+		for _, c := range m.cues {
+			var p []byte
+			p = appendEBMLUint(p, 0xf7, uint64(m.cueTrack))
+			p = appendEBMLUint(p, 0xf1, c.pos)
+			var cp []byte
+			cp = appendEBMLUint(cp, 0xb3, uint64(c.timecode/muxerTimecodeScale))
+			cp = appendEBMLMaster(cp, 0xb7, p)
+			cs = appendEBMLMaster(cs, 0xbb, cp)
+		}
+		b := m.w.buffer()
+		*b = appendEBMLMaster(*b, 0x1c53bb6b, cs)
+		m.pos += uint64(len(*b))
+		err = m.w.write(b)
+	}
+	if werr := m.w.close(); err == nil {
+		err = werr
+	}
+	if err != nil || m.seeker == nil {
+		return err
+	}
+
+	// Fill the space reserved at the start.
+	patch := func(pos int64, data []byte) error {
+		if _, err := m.seeker.Seek(m.origin+pos, io.SeekStart); err != nil {
+			return err
+		}
+		_, err := m.seeker.Write(data)
+		return err
+	}
+	if err := patch(m.dataStart-8, appendEBMLFixedHeader(nil, 0x18538067, m.pos)[4:]); err != nil {
+		return err
+	}
+	if err := patch(m.dataStart, muxerSeekHead(m.infoPos, m.tracksPos, cuesPos)); err != nil {
+		return err
+	}
+	d := appendEBMLFloat(nil, 0x4489, float64(m.last)/float64(muxerTimecodeScale))
+	if err := patch(m.dataStart+m.durationPos, d[3:]); err != nil {
+		return err
+	}
+	_, err = m.seeker.Seek(m.origin+m.dataStart+int64(m.pos), io.SeekStart)
+	return err
+}
@@ -0,0 +1,587 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !js
+
+package webmplayer
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"sync"
+	"time"
+
+	"github.com/ebml-go/webm"
+
+	"github.com/hajimehoshi/webmplayer/internal/libvorbis"
+)
+
+const (
+	// oggReadSize is the size of a read into the page buffer.
+	oggReadSize = 8 << 10
+
+	// oggSeekLinear is the size of the range where seeking scans the pages instead of bisecting more.
+	oggSeekLinear = 64 << 10
+
+	// oggTrackNumber is the track number of the audio of an Ogg stream.
+	oggTrackNumber = 1
+)
+
+// oggPage is a page of an Ogg stream, which refers to the page buffer.
+type oggPage struct {
+	libvorbis.Page
+
+	// offset is the position of the page in the input.
+	offset int64
+}
+
+func (p *oggPage) continued() bool {
+	return p.Header[5]&0x01 != 0
+}
+
+func (p *oggPage) bos() bool {
+	return p.Header[5]&0x02 != 0
+}
+
+func (p *oggPage) eos() bool {
+	return p.Header[5]&0x04 != 0
+}
+
+// granule returns the granule position of the page, which is the end of the last packet finished in the page, or -1
+// if no packet is finished in the page.
+func (p *oggPage) granule() int64 {
+	return int64(binary.LittleEndian.Uint64(p.Header[6:14]))
+}
+
+func (p *oggPage) serial() uint32 {
+	return binary.LittleEndian.Uint32(p.Header[14:18])
+}
+
+// oggDemuxer reads the Opus or Vorbis stream of an Ogg input, e.g. a .ogg or .opus file, as the packets of a WebM
+// audio track. libogg finds the pages in its buffer, which the input is read into directly, and the packets are
+// split out of the pages there, so that a packet is copied only once, into its own slice.
+// The timecodes of the packets are made from the granule positions of the pages, and a seek bisects the input by the
+// granule positions.
+//
+// Only the first Opus or Vorbis stream is read, and the other multiplexed streams are skipped. A chained stream
+// ends at the end of the first link.
+type oggDemuxer struct {
+	r      io.ReadSeeker
+	sync   *libvorbis.SyncState
+	meta   webm.WebM
+	serial uint32
+
+	// rate is the rate of the granule positions, and preSkip is the granule position of the time 0.
+	rate    int
+	preSkip int64
+
+	// duration is the time of the last granule position, or 0 if it is unknown.
+	duration time.Duration
+
+	// vorbis is the setup of a Vorbis stream to know the durations of the packets. vorbis is nil for Opus.
+	vorbis *libvorbis.Info
+
+	// dataOffset is the offset of the first page after the headers, and size is the size of the input, or -1 if it
+	// is unknown.
+	dataOffset int64
+	size       int64
+
+	// pos is the offset of the data at the start of the page buffer.
+	pos int64
+
+	// partial is the beginning of the packet continued to the next page. partial is nil if there is none, or if the
+	// beginning is unknown after a seek.
+	partial []byte
+
+	// pending is the packets of the last page, which are sent in order.
+	pending []webm.Packet
+	ends    []int64
+
+	// next is the granule position of the end of the last packet, or -1 if it is unknown.
+	next int64
+
+	// prevBlock is the block size of the last Vorbis packet, or 0 if it is unknown.
+	prevBlock int
+
+	eos bool
+
+	loop demuxLoop
+
+	ch       chan demuxPacket
+	seeks    chan time.Duration
+	done     chan struct{}
+	shutdown sync.Once
+}
+
+// newOggDemuxer reads the headers of the Ogg input r from its current position, and starts the goroutine sending the
+// packets.
+func newOggDemuxer(r io.ReadSeeker) (*oggDemuxer, error) {
+	start, err := r.Seek(0, io.SeekCurrent)
+	if err != nil {
+		return nil, err
+	}
+	// The size of a live stream is unknown. The stream has no duration then, and seeking scans the pages.
+	size, err := r.Seek(0, io.SeekEnd)
+	if err != nil {
+		size = -1
+	}
+	d := &oggDemuxer{
+		r:     r,
+		sync:  libvorbis.SyncInit(),
+		size:  size,
+		ch:    make(chan demuxPacket),
+		seeks: make(chan time.Duration),
+		done:  make(chan struct{}),
+	}
+	if err := d.init(start); err != nil {
+		d.free()
+		return nil, err
+	}
+	go d.run()
+	return d, nil
+}
+
+func (d *oggDemuxer) init(start int64) error {
+	if err := d.reset(start); err != nil {
+		return err
+	}
+	track, err := d.readHeaders()
+	if err != nil {
+		return err
+	}
+
+	d.meta.TimecodeScale = uint(time.Millisecond)
+	d.meta.TrackEntry = []webm.TrackEntry{track}
+	if d.size >= 0 {
+		if g, err := d.lastGranule(); err == nil && g > d.preSkip {
+			d.duration = d.granuleTime(g)
+			d.meta.Duration = float32(d.duration / time.Millisecond)
+		}
+	}
+	return d.reset(d.dataOffset)
+}
+
+// readHeaders finds the first Opus or Vorbis stream, and returns its track made from the headers.
+func (d *oggDemuxer) readHeaders() (webm.TrackEntry, error) {
+	track := webm.TrackEntry{
+		TrackNumber: oggTrackNumber,
+		TrackType:   2,
+	}
+	var headers [][]byte
+	want := 0
+	for want == 0 || len(headers) < want {
+		p, err := d.nextPage()
+		if err != nil {
+			if errors.Is(err, io.EOF) {
+				return track, errors.New("webmplayer: no Opus or Vorbis stream in the Ogg stream")
+			}
+			return track, err
+		}
+		if want != 0 {
+			if p.serial() == d.serial {
+				d.split(&p, func(data []byte) {
+					headers = append(headers, data)
+				})
+			}
+			continue
+		}
+		// The first pages of the streams come first, and each has only the first header of the stream.
+		if !p.bos() {
+			return track, errors.New("webmplayer: no Opus or Vorbis stream in the Ogg stream")
+		}
+		var first []byte
+		d.split(&p, func(data []byte) {
+			if first == nil {
+				first = data
+			}
+		})
+		d.partial = nil
+		switch {
+		case bytes.HasPrefix(first, []byte("OpusHead")):
+			track.CodecID = string(audioCodecOpus)
+			want = 2
+		case bytes.HasPrefix(first, []byte("\x01vorbis")):
+			track.CodecID = string(audioCodecVorbis)
+			want = 3
+		default:
+			continue
+		}
+		d.serial = p.serial()
+		headers = append(headers, first)
+	}
+	// The audio packets start at a new page after the headers.
+	d.dataOffset = d.pos
+
+	switch audioCodec(track.CodecID) {
+	case audioCodecOpus:
+		// CodecPrivate of Opus in WebM is the identification header.
+		head, err := parseOpusHead(headers[0])
+		if err != nil {
+			return track, err
+		}
+		track.CodecPrivate = headers[0]
+		track.Channels = uint(head.channels)
+		track.SamplingFrequency = opusSamplingFrequency
+		d.rate = opusSamplingFrequency
+		d.preSkip = int64(head.preSkip)
+	case audioCodecVorbis:
+		// CodecPrivate of Vorbis in WebM is the three headers in the Xiph lacing.
+		private := []byte{2}
+		for _, h := range headers[:2] {
+			n := len(h)
+			for ; n >= 0xff; n -= 0xff {
+				private = append(private, 0xff)
+			}
+			private = append(private, byte(n))
+		}
+		for _, h := range headers {
+			private = append(private, h...)
+		}
+		info, comment, err := readVorbisCodecPrivate(private)
+		if err != nil {
+			return track, err
+		}
+		comment.Clear()
+		d.vorbis = info
+		track.CodecPrivate = private
+		track.Channels = uint(info.Channels())
+		track.SamplingFrequency = float64(info.Rate())
+		d.rate = info.Rate()
+	}
+	if d.rate <= 0 {
+		return track, fmt.Errorf("webmplayer: invalid sample rate: %d", d.rate)
+	}
+	return track, nil
+}
+
+// lastGranule returns the granule position of the last page of the stream.
+func (d *oggDemuxer) lastGranule() (int64, error) {
+	for back := int64(oggSeekLinear); ; back *= 2 {
+		off := max(d.size-back, d.dataOffset)
+		if err := d.reset(off); err != nil {
+			return 0, err
+		}
+		last := int64(-1)
+		for {
+			p, err := d.nextPage()
+			if err != nil {
+				break
+			}
+			if p.serial() == d.serial && p.granule() >= 0 {
+				last = p.granule()
+			}
+		}
+		if last >= 0 || off == d.dataOffset {
+			return last, nil
+		}
+	}
+}
+
+// granuleTime returns the time of the granule position g.
+func (d *oggDemuxer) granuleTime(g int64) time.Duration {
+	return time.Duration(g-d.preSkip) * time.Second / time.Duration(d.rate)
+}
+
+// packets implements demuxer.
+func (d *oggDemuxer) packets() <-chan demuxPacket {
+	return d.ch
+}
+
+// setLoop implements demuxer. The duration of a pass is exact by the granule positions.
+func (d *oggDemuxer) setLoop() time.Duration {
+	return d.loop.start(d.duration)
+}
+
+// skipData implements demuxer. An Ogg input has no video to skip.
+func (d *oggDemuxer) skipData(track uint) {
+}
+
+// skipAudio implements demuxer. An Ogg input has only the audio, so the Player refuses it with NoAudio.
+func (d *oggDemuxer) skipAudio() {
+}
+
+// Seek implements demuxer.
+func (d *oggDemuxer) Seek(t time.Duration) {
+	select {
+	case d.seeks <- t:
+	case <-d.done:
+	}
+}
+
+// Shutdown implements demuxer.
+func (d *oggDemuxer) Shutdown() {
+	d.shutdown.Do(func() {
+		close(d.done)
+	})
+}
+
+func (d *oggDemuxer) free() {
+	d.sync.Clear()
+	if d.vorbis != nil {
+		d.vorbis.Clear()
+	}
+}
+
+// run sends the packets until Shutdown is called. As webmReader does, run sends a packet with Rebase first after a
+// seek, and a packet with webm.BadTC at the end, and then waits for a seek, or reads from the first page again with
+// Loop.
+func (d *oggDemuxer) run() {
+	defer close(d.ch)
+	defer d.free()
+
+	var rebase bool
+	for {
+		pkt, err := d.nextPacket()
+		if err != nil && d.loop.next() {
+			// The state is lost anyway at the end, so an error here is reported as the end of the next pass.
+			_ = d.reset(d.dataOffset)
+			pkt, err = d.loop.mark(), nil
+		}
+		if err != nil {
+			pkt = webm.Packet{Timecode: webm.BadTC}
+		}
+		pkt.Rebase = rebase
+		select {
+		case d.ch <- demuxPacket{Packet: pkt}:
+			rebase = false
+			if err == nil {
+				continue
+			}
+			select {
+			case t := <-d.seeks:
+				d.seek(t)
+				rebase = true
+			case <-d.done:
+				return
+			}
+		case t := <-d.seeks:
+			d.seek(t)
+			rebase = true
+		case <-d.done:
+			return
+		}
+	}
+}
+
+// reset moves the reading position to the offset off, and forgets the state of the packets.
+func (d *oggDemuxer) reset(off int64) error {
+	d.sync.Reset()
+	d.pos = off
+	d.partial = nil
+	d.pending = d.pending[:0]
+	d.next = -1
+	d.prevBlock = 0
+	d.eos = false
+	_, err := d.r.Seek(off, io.SeekStart)
+	return err
+}
+
+// nextPage returns the next page in the input.
+func (d *oggDemuxer) nextPage() (oggPage, error) {
+	for {
+		page, n := d.sync.PageSeek()
+		off := d.pos
+		d.pos += int64(max(n, -n))
+		if n > 0 {
+			return oggPage{Page: page, offset: off}, nil
+		}
+		if n < 0 {
+			// Not a page, e.g. after seeking to the middle of a page.
+			continue
+		}
+		buf := d.sync.Buffer(oggReadSize)
+		if buf == nil {
+			return oggPage{}, errors.New("webmplayer: allocating the Ogg page buffer failed")
+		}
+		m, err := d.r.Read(buf)
+		if err2 := d.sync.Wrote(m); err2 != nil {
+			return oggPage{}, err2
+		}
+		if m == 0 && err != nil {
+			return oggPage{}, err
+		}
+	}
+}
+
+// split calls f with the packets finished in the page p, in order. A packet continued from the previous page is
+// joined with partial, or is dropped if its beginning is unknown.
+func (d *oggDemuxer) split(p *oggPage, f func(data []byte)) {
+	if !p.continued() {
+		d.partial = nil
+	}
+	var start, size int
+	continued := p.continued()
+	for _, l := range p.Header[27 : 27+int(p.Header[26])] {
+		size += int(l)
+		if l == 0xff {
+			continue
+		}
+		data := p.Body[start : start+size]
+		start += size
+		size = 0
+		if continued {
+			continued = false
+			if d.partial == nil {
+				continue
+			}
+			data = append(d.partial, data...)
+			d.partial = nil
+		} else {
+			data = bytes.Clone(data)
+		}
+		f(data)
+	}
+	if l := len(p.Header); l > 27 && p.Header[l-1] == 0xff {
+		// The last packet continues to the next page.
+		data := p.Body[start : start+size]
+		switch {
+		case !continued:
+			d.partial = append([]byte{}, data...)
+		case d.partial != nil:
+			d.partial = append(d.partial, data...)
+		}
+	}
+}
+
+// nextPacket returns the next packet of the stream, or io.EOF at the end of the stream.
+func (d *oggDemuxer) nextPacket() (webm.Packet, error) {
+	for len(d.pending) == 0 {
+		if d.eos {
+			return webm.Packet{}, io.EOF
+		}
+		p, err := d.nextPage()
+		if err != nil {
+			return webm.Packet{}, err
+		}
+		if p.serial() != d.serial {
+			continue
+		}
+		d.readPage(&p)
+		if p.eos() {
+			d.eos = true
+		}
+	}
+	pkt := d.pending[0]
+	d.pending[0] = webm.Packet{}
+	d.pending = d.pending[1:]
+	d.loop.packet(&pkt)
+	return pkt, nil
+}
+
+// readPage adds the packets finished in the page p to pending with their timecodes.
+func (d *oggDemuxer) readPage(p *oggPage) {
+	d.pending = d.pending[:0]
+	d.ends = d.ends[:0]
+	var end int64
+	d.split(p, func(data []byte) {
+		d.pending = append(d.pending, webm.Packet{
+			Data:        data,
+			TrackNumber: oggTrackNumber,
+			Keyframe:    true,
+		})
+		end += d.packetFrames(data)
+		d.ends = append(d.ends, end)
+	})
+	if len(d.pending) == 0 {
+		return
+	}
+
+	// The granule position is the end of the last packet. The last page can end before its last packet, so its
+	// packets follow the previous page's instead. The first packets of the stream can start before 0 by the
+	// estimated durations, and start at 0 then.
+	base := max(d.next, 0)
+	if g := p.granule(); g >= 0 && (!p.eos() || d.next < 0) {
+		base = g - end
+	}
+	start := base
+	for i := range d.pending {
+		d.pending[i].Timecode = d.granuleTime(max(start, 0) + d.preSkip)
+		start = base + d.ends[i]
+	}
+	d.next = start
+}
+
+// packetFrames returns the number of the frames of the packet at the rate of the granule positions.
+func (d *oggDemuxer) packetFrames(data []byte) int64 {
+	if d.vorbis == nil {
+		return int64(opusPacketFrames(data))
+	}
+	n, err := libvorbis.PacketBlocksize(d.vorbis, data)
+	if err != nil {
+		return 0
+	}
+	// A Vorbis packet makes the frames between the centers of the previous block and its block. After a seek, the
+	// previous block is unknown, and the packet is decoded only as the overlap anyway.
+	prev := d.prevBlock
+	if prev == 0 {
+		prev = n
+	}
+	d.prevBlock = n
+	return int64(prev/4 + n/4)
+}
+
+// seek moves to the last page that ends before t, so that the packets after the page start before t.
+// The pages are bisected by their granule positions, and then scanned.
+func (d *oggDemuxer) seek(t time.Duration) {
+	t = d.loop.seek(t)
+	target := int64(t*time.Duration(d.rate)/time.Second) + d.preSkip
+	if d.vorbis == nil {
+		// Opus needs the pre-roll to converge after a seek.
+		// https://datatracker.ietf.org/doc/html/rfc7845#section-4.6
+		target -= int64(opusPreRoll * time.Duration(d.rate) / time.Second)
+	}
+
+	best := d.dataOffset
+	lo, hi := d.dataOffset, max(d.size, d.dataOffset)
+	for hi-lo > oggSeekLinear {
+		mid := lo + (hi-lo)/2
+		off, g, ok := d.granuleAfter(mid, hi)
+		if !ok {
+			hi = mid
+			continue
+		}
+		if g <= target {
+			best, lo = off, off+1
+		} else {
+			hi = mid
+		}
+	}
+
+	if err := d.reset(best); err == nil {
+		for {
+			p, err := d.nextPage()
+			if err != nil {
+				break
+			}
+			if p.serial() != d.serial || p.granule() < 0 {
+				continue
+			}
+			if p.granule() > target {
+				break
+			}
+			best = p.offset
+		}
+	}
+	// The state is lost anyway by the seek, so an error here is reported as the end when reading.
+	_ = d.reset(best)
+}
+
+// granuleAfter returns the offset and the granule position of the first page of the stream with a granule position
+// at or after off and before end.
+func (d *oggDemuxer) granuleAfter(off, end int64) (int64, int64, bool) {
+	if err := d.reset(off); err != nil {
+		return 0, 0, false
+	}
+	for {
+		p, err := d.nextPage()
+		if err != nil || p.offset >= end {
+			return 0, 0, false
+		}
+		if p.serial() == d.serial && p.granule() >= 0 {
+			return p.offset, p.granule(), true
+		}
+	}
+}
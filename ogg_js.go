@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"io"
+
+	"github.com/ebml-go/webm"
+)
+
+// oggDemuxer is not available on js, as the Ogg pages are parsed by libogg.
+type oggDemuxer struct {
+	demuxer
+	meta webm.WebM
+}
+
+func newOggDemuxer(r io.ReadSeeker) (*oggDemuxer, error) {
+	return nil, errors.New("webmplayer: Ogg inputs are not supported on js")
+}
+
+func writeOggAudio(w io.Writer, track *webm.TrackEntry, next func() ([]byte, error)) error {
+	return errors.New("webmplayer: writing Ogg streams is not supported on js")
+}
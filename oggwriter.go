@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !js
+
+package webmplayer
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+
+	"github.com/ebml-go/webm"
+
+	"github.com/hajimehoshi/webmplayer/internal/libopus"
+	"github.com/hajimehoshi/webmplayer/internal/libvorbis"
+)
+
+// oggWriteSize is the size of the buffer that the pages are written to w in.
+const oggWriteSize = 64 << 10
+
+// oggWriter writes a logical Ogg stream of packets, whose pages are made by libogg.
+type oggWriter struct {
+	w        *bufio.Writer
+	stream   *libvorbis.StreamState
+	packetNo int64
+}
+
+func newOggWriter(w io.Writer, serial int) (*oggWriter, error) {
+	s, err := libvorbis.StreamInit(serial)
+	if err != nil {
+		return nil, fmt.Errorf("webmplayer: libvorbis.StreamInit failed: %w", err)
+	}
+	return &oggWriter{
+		w:      bufio.NewWriterSize(w, oggWriteSize),
+		stream: s,
+	}, nil
+}
+
+// write adds a packet ending at granule. With flush, the packets added so far end their pages, e.g. for the headers,
+// which Ogg Opus and Ogg Vorbis require on their own pages.
+func (o *oggWriter) write(data []byte, granule int64, eos bool, flush bool) error {
+	if err := o.stream.PacketIn(&libvorbis.OggPacket{
+		Packet:     data,
+		BOS:        o.packetNo == 0,
+		EOS:        eos,
+		GranulePos: granule,
+		PacketNo:   o.packetNo,
+	}); err != nil {
+		return fmt.Errorf("webmplayer: libvorbis.StreamState.PacketIn failed: %w", err)
+	}
+	o.packetNo++
+	for {
+		var p libvorbis.Page
+		var ok bool
+		if flush || eos {
+			p, ok = o.stream.Flush()
+		} else {
+			p, ok = o.stream.PageOut()
+		}
+		if !ok {
+			return nil
+		}
+		if _, err := o.w.Write(p.Header); err != nil {
+			return err
+		}
+		if _, err := o.w.Write(p.Body); err != nil {
+			return err
+		}
+	}
+}
+
+// close writes the pages buffered, and frees the stream.
+func (o *oggWriter) close() error {
+	o.stream.Clear()
+	return o.w.Flush()
+}
+
+// writeOggAudio writes the Opus or Vorbis track to w as an Ogg stream with the packets returned by next, which returns
+// io.EOF at the end. The granule positions are counted from the durations of the packets.
+func writeOggAudio(w io.Writer, track *webm.TrackEntry, next func() ([]byte, error)) error {
+	var headers [][]byte
+	var granule int64
+	var frames func(data []byte) int64
+	repacketize := func(data []byte) []byte { return data }
+	switch audioCodec(track.CodecID) {
+	case audioCodecOpus:
+		// CodecPrivate of Opus in WebM is OpusHead. The granule position of a page is the number of the samples
+		// decoded by its end including the pre-skip, so the granule positions start at 0.
+		// https://datatracker.ietf.org/doc/html/rfc7845#section-4
+		head, err := parseOpusHead(track.CodecPrivate)
+		if err != nil {
+			return err
+		}
+		headers = [][]byte{track.CodecPrivate, opusTags()}
+		frames = func(data []byte) int64 {
+			return int64(opusPacketFrames(data))
+		}
+		// The padding of the packets is removed by the repacketizer of libopus. The packet is copied, as the data
+		// might be a view of the input, and an invalid packet is written as it is.
+		var buf []byte
+		repacketize = func(data []byte) []byte {
+			buf = append(buf[:0], data...)
+			p, err := libopus.PacketUnpad(buf, head.streamCount)
+			if err != nil {
+				return data
+			}
+			return p
+		}
+	case audioCodecVorbis:
+		info, comment, err := readVorbisCodecPrivate(track.CodecPrivate)
+		if err != nil {
+			return err
+		}
+		comment.Clear()
+		defer info.Clear()
+		headers, err = splitXiphLacing(track.CodecPrivate)
+		if err != nil {
+			return err
+		}
+		// As oggDemuxer.packetFrames, a packet makes the frames between the centers of the previous block and its
+		// block, and the first packet makes none.
+		var prev int
+		frames = func(data []byte) int64 {
+			n, err := libvorbis.PacketBlocksize(info, data)
+			if err != nil {
+				return 0
+			}
+			f := int64(prev/4 + n/4)
+			if prev == 0 {
+				f = 0
+			}
+			prev = n
+			return f
+		}
+	default:
+		return fmt.Errorf("webmplayer: the codec %s can't be written to Ogg", track.CodecID)
+	}
+
+	o, err := newOggWriter(w, int(track.TrackNumber))
+	if err != nil {
+		return err
+	}
+	// The first header is alone in the first page, and the audio starts at a new page after the other headers.
+	for i, h := range headers {
+		if err := o.write(h, 0, false, i == 0 || i == len(headers)-1); err != nil {
+			o.close()
+			return err
+		}
+	}
+
+	// A packet is written when the next one is read, so that the last packet ends the stream.
+	var last []byte
+	for {
+		data, err := next()
+		if err != nil && !errors.Is(err, io.EOF) {
+			o.close()
+			return err
+		}
+		eos := err != nil
+		if last != nil || eos {
+			if last != nil {
+				granule += frames(last)
+			}
+			if err := o.write(repacketize(last), granule, eos, false); err != nil {
+				o.close()
+				return err
+			}
+		}
+		if eos {
+			return o.close()
+		}
+		last = data
+	}
+}
+
+// opusTags returns the comment header of Ogg Opus without comments.
+// https://datatracker.ietf.org/doc/html/rfc7845#section-5.2
+func opusTags() []byte {
+	const vendor = "webmplayer"
+	b := []byte("OpusTags")
+	b = binary.LittleEndian.AppendUint32(b, uint32(len(vendor)))
+	b = append(b, vendor...)
+	b = binary.LittleEndian.AppendUint32(b, 0)
+	return b
+}
+
+// splitXiphLacing returns the packets in the Xiph lacing, e.g. the headers in CodecPrivate of Vorbis.
+// https://www.matroska.org/technical/notes.html#xiph-lacing
+func splitXiphLacing(data []byte) ([][]byte, error) {
+	if len(data) == 0 {
+		return nil, errors.New("webmplayer: too short Xiph lacing")
+	}
+	count := int(data[0]) + 1
+	data = data[1:]
+	sizes := make([]int, count-1)
+	for i := range sizes {
+		for {
+			if len(data) == 0 {
+				return nil, errors.New("webmplayer: invalid Xiph lacing")
+			}
+			b := data[0]
+			data = data[1:]
+			sizes[i] += int(b)
+			if b != 0xff {
+				break
+			}
+		}
+	}
+	packets := make([][]byte, 0, count)
+	for _, s := range sizes {
+		if s > len(data) {
+			return nil, errors.New("webmplayer: invalid Xiph lacing")
+		}
+		packets = append(packets, data[:s])
+		data = data[s:]
+	}
+	return append(packets, data), nil
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !js
+
+package webmplayer
+
+import (
+	"fmt"
+	"sync"
+
+	"github.com/hajimehoshi/webmplayer/internal/libopus"
+)
+
+// opusReducedRates is the rates below 48 kHz that libopus decodes at.
+var opusReducedRates = []int{8000, 12000, 16000, 24000}
+
+// opusDecoderPools is the slabs of the mono and stereo decoders by the rates and the channel counts, so that the
+// states of many streams are contiguous and the streams starting and ending don't allocate.
+var (
+	opusDecoderPools  = map[[2]int]*libopus.DecoderPool{}
+	opusDecoderPoolsM sync.Mutex
+)
+
+func newPooledOpusDecoder(samplingFrequency, channels int) (*libopus.Decoder, error) {
+	opusDecoderPoolsM.Lock()
+	key := [2]int{samplingFrequency, channels}
+	p, ok := opusDecoderPools[key]
+	if !ok {
+		var err error
+		p, err = libopus.NewDecoderPool(samplingFrequency, channels)
+		if err != nil {
+			opusDecoderPoolsM.Unlock()
+			return nil, err
+		}
+		opusDecoderPools[key] = p
+	}
+	opusDecoderPoolsM.Unlock()
+	return p.Get()
+}
+
+// newOpusDecoder creates a libopus decoder of the stream of head at the rate samplingFrequency. With parallel, the
+// streams of a multistream packet are decoded in parallel, except with the mapping family 3, whose demixing matrix is
+// applied by libopus.
+func newOpusDecoder(head *opusHead, samplingFrequency int, parallel bool) (opusDecoder, error) {
+	switch {
+	case head.mappingFamily == 0 && head.channels <= 2:
+		d, err := newPooledOpusDecoder(samplingFrequency, head.channels)
+		if err != nil {
+			return nil, fmt.Errorf("webmplayer: libopus.DecoderPool.Get failed: %w", err)
+		}
+		return d, nil
+	case head.mappingFamily == 3:
+		d, err := libopus.ProjectionDecoderCreate(samplingFrequency, head.channels, head.streamCount, head.coupledCount, head.demixingMatrix)
+		if err != nil {
+			return nil, fmt.Errorf("webmplayer: libopus.ProjectionDecoderCreate failed: %w", err)
+		}
+		return d, nil
+	case parallel:
+		d, err := libopus.ParallelMSDecoderCreate(samplingFrequency, head.channels, head.streamCount, head.coupledCount, head.channelMapping)
+		if err != nil {
+			return nil, fmt.Errorf("webmplayer: libopus.ParallelMSDecoderCreate failed: %w", err)
+		}
+		return d, nil
+	default:
+		d, err := libopus.MSDecoderCreate(samplingFrequency, head.channels, head.streamCount, head.coupledCount, head.channelMapping)
+		if err != nil {
+			return nil, fmt.Errorf("webmplayer: libopus.MSDecoderCreate failed: %w", err)
+		}
+		return d, nil
+	}
+}
+
+// prewarmOpus decodes a lost frame with a new decoder, which runs the CELT and SILK decoders without a packet.
+func prewarmOpus() error {
+	const channels = 2
+	d, err := libopus.DecoderCreate(48000, channels)
+	if err != nil {
+		return fmt.Errorf("webmplayer: libopus.DecoderCreate failed: %w", err)
+	}
+	defer d.Destroy()
+	pcm := make([]float32, 960*channels)
+	if n := d.DecodeFloat(nil, pcm, 0); n < 0 {
+		return fmt.Errorf("webmplayer: opus_decode_float failed: %w", libopus.Error(n))
+	}
+	return nil
+}
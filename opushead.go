@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+)
+
+// opusHead is the identification header of Opus.
+// https://datatracker.ietf.org/doc/html/rfc7845#section-5.1
+type opusHead struct {
+	channels        int
+	preSkip         int
+	inputSampleRate int
+
+	// outputGain is the gain to be applied to the output in Q7.8 dB.
+	outputGain int
+
+	mappingFamily  int
+	streamCount    int
+	coupledCount   int
+	channelMapping []byte
+
+	// demixingMatrix is the matrix for the mapping family 3 (ambisonics with projection) instead of channelMapping.
+	// https://datatracker.ietf.org/doc/html/rfc8486#section-3.1
+	demixingMatrix []byte
+}
+
+func parseOpusHead(data []byte) (*opusHead, error) {
+	if len(data) < 19 || !bytes.Equal(data[:8], []byte("OpusHead")) {
+		return nil, errors.New("webmplayer: invalid OpusHead")
+	}
+	if v := data[8]; v>>4 != 0 {
+		return nil, fmt.Errorf("webmplayer: unsupported OpusHead version: %d", v)
+	}
+	h := &opusHead{
+		channels:        int(data[9]),
+		preSkip:         int(binary.LittleEndian.Uint16(data[10:12])),
+		inputSampleRate: int(binary.LittleEndian.Uint32(data[12:16])),
+		outputGain:      int(int16(binary.LittleEndian.Uint16(data[16:18]))),
+		mappingFamily:   int(data[18]),
+	}
+	if h.channels == 0 {
+		return nil, errors.New("webmplayer: invalid OpusHead channel count: 0")
+	}
+
+	if h.mappingFamily == 0 {
+		if h.channels > 2 {
+			return nil, fmt.Errorf("webmplayer: invalid OpusHead channel count for mapping family 0: %d", h.channels)
+		}
+		h.streamCount = 1
+		h.coupledCount = h.channels - 1
+		h.channelMapping = []byte{0, 1}[:h.channels]
+		return h, nil
+	}
+
+	if len(data) < 21 {
+		return nil, errors.New("webmplayer: OpusHead is too short")
+	}
+	h.streamCount = int(data[19])
+	h.coupledCount = int(data[20])
+	if h.streamCount == 0 || h.coupledCount > h.streamCount {
+		return nil, fmt.Errorf("webmplayer: invalid OpusHead stream counts: %d, %d", h.streamCount, h.coupledCount)
+	}
+
+	if h.mappingFamily == 3 {
+		// The matrix has 16-bit coefficients for each pair of an output channel and a decoded channel.
+		size := 2 * h.channels * (h.streamCount + h.coupledCount)
+		if len(data) < 21+size {
+			return nil, errors.New("webmplayer: OpusHead is too short")
+		}
+		h.demixingMatrix = data[21 : 21+size]
+		return h, nil
+	}
+
+	if len(data) < 21+h.channels {
+		return nil, errors.New("webmplayer: OpusHead is too short")
+	}
+	h.channelMapping = data[21 : 21+h.channels]
+	return h, nil
+}
+
+// opusPacketFrames returns the number of the frames of an Opus packet at 48 kHz from its TOC byte, or 0 if the packet
+// is broken. For a multistream packet, this is of the first stream, which is the same for all the streams.
+// https://datatracker.ietf.org/doc/html/rfc6716#section-3.1
+func opusPacketFrames(data []byte) int {
+	if len(data) == 0 {
+		return 0
+	}
+	toc := data[0]
+	var size int
+	switch config := toc >> 3; {
+	case config < 12:
+		// SILK-only: 10, 20, 40 or 60 ms.
+		size = [...]int{480, 960, 1920, 2880}[config&3]
+	case config < 16:
+		// Hybrid: 10 or 20 ms.
+		size = [...]int{480, 960}[config&1]
+	default:
+		// CELT-only: 2.5, 5, 10 or 20 ms.
+		size = [...]int{120, 240, 480, 960}[config&3]
+	}
+	switch toc & 3 {
+	case 0:
+		return size
+	case 1, 2:
+		return 2 * size
+	default:
+		if len(data) < 2 {
+			return 0
+		}
+		return int(data[1]&0x3f) * size
+	}
+}
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/ebml-go/webm"
+)
+
+// maxPCMClips is the number of the audio tracks decoded by PlayerOptions.AudioPredecode that are kept for the next
+// Players.
+const maxPCMClips = 16
+
+// errPCMClipTooLong is returned when a track turns out to be longer than PlayerOptions.AudioPredecode while decoding
+// it, e.g. by a wrong duration. The track is decoded as it is played then.
+var errPCMClipTooLong = errors.New("webmplayer: the audio track is too long to predecode")
+
+// pcmClip is the whole output of an audio track, the interleaved stereo float32 samples that audioStream outputs.
+// pcmClip is immutable, and shared by the Players of the same input.
+type pcmClip struct {
+	data              []byte
+	samplingFrequency int
+}
+
+// pcmClipKey identifies an audio track of an input in memory, and the options that change its output.
+type pcmClipKey struct {
+	data  *byte
+	size  int
+	start int64
+
+	// owner is the owner of the memory, e.g. a Bundle, which is not identified by its address only.
+	owner any
+
+	track       uint
+	rateDivisor int
+	downmix     string
+}
+
+// pcmClipEntry is a track decoded once for all the Players asking for it at the same time.
+type pcmClipEntry struct {
+	once sync.Once
+	clip *pcmClip
+	err  error
+
+	// accounted is true while the clip is accounted in the memory budget, from when it is decoded until it is
+	// evicted. accounted is protected by the lock of pcmClips.
+	accounted bool
+}
+
+// pcmClips is the latest decoded tracks, in the order they are stored.
+var pcmClips struct {
+	m       sync.Mutex
+	keys    []pcmClipKey
+	entries map[pcmClipKey]*pcmClipEntry
+}
+
+// loadPCMClip returns the track of key, decoding it by decode if it is not decoded yet.
+func loadPCMClip(key pcmClipKey, decode func() (*pcmClip, error)) (*pcmClip, error) {
+	pcmClips.m.Lock()
+	if pcmClips.entries == nil {
+		pcmClips.entries = map[pcmClipKey]*pcmClipEntry{}
+	}
+	e, ok := pcmClips.entries[key]
+	if !ok {
+		e = &pcmClipEntry{}
+		if len(pcmClips.keys) == maxPCMClips {
+			evictOldestPCMClip()
+		}
+		pcmClips.keys = append(pcmClips.keys, key)
+		pcmClips.entries[key] = e
+	}
+	pcmClips.m.Unlock()
+
+	e.once.Do(func() {
+		e.clip, e.err = decode()
+		if e.clip == nil {
+			return
+		}
+		pcmClips.m.Lock()
+		defer pcmClips.m.Unlock()
+		if pcmClips.entries[key] == e {
+			e.accounted = true
+			trackMemory(memoryAudioClips, int64(len(e.clip.data)))
+		}
+	})
+	return e.clip, e.err
+}
+
+// evictOldestPCMClip removes the oldest track from pcmClips. The lock of pcmClips must be held.
+func evictOldestPCMClip() {
+	key := pcmClips.keys[0]
+	if e := pcmClips.entries[key]; e.accounted {
+		e.accounted = false
+		trackMemory(memoryAudioClips, -int64(len(e.clip.data)))
+	}
+	delete(pcmClips.entries, key)
+	pcmClips.keys = append(pcmClips.keys[:0], pcmClips.keys[1:]...)
+}
+
+// evictPCMClips removes the oldest tracks from pcmClips while the memory is over the budget. The Players playing the
+// tracks keep them.
+func evictPCMClips() {
+	pcmClips.m.Lock()
+	defer pcmClips.m.Unlock()
+	for len(pcmClips.keys) > 0 && memoryPressure() {
+		evictOldestPCMClip()
+	}
+}
+
+// pcmClipKey returns the key of the audio track of the stream, or false if the track is not predecoded.
+func (s *stream) pcmClipKey(track *webm.TrackEntry) (pcmClipKey, bool) {
+	limit := s.options.AudioPredecode
+	if limit <= 0 || s.memory == nil || len(s.memory.data) == 0 {
+		return pcmClipKey{}, false
+	}
+	if d := s.meta.GetDuration(); d <= 0 || d > limit {
+		return pcmClipKey{}, false
+	}
+	key := pcmClipKey{
+		data:        unsafe.SliceData(s.memory.data),
+		size:        len(s.memory.data),
+		start:       s.memoryStart,
+		owner:       s.memory.owner,
+		track:       track.TrackNumber,
+		rateDivisor: s.options.AudioRateDivisor,
+	}
+	if s.options.AudioDownmix[0] != nil || s.options.AudioDownmix[1] != nil {
+		key.downmix = fmt.Sprint(s.options.AudioDownmix)
+	}
+	return key, true
+}
+
+// predecodeAudio decodes the whole audio track from the start by another demuxer of the input in memory, so that the
+// stream's demuxer and the seek state are not involved.
+func (s *stream) predecodeAudio(track *webm.TrackEntry) (*pcmClip, error) {
+	r, err := s.reopen()
+	if err != nil {
+		return nil, err
+	}
+	queue := newDemuxQueue(math.MaxInt64, math.MaxInt)
+	// The packets left by a failure are not accounted anymore.
+	defer queue.flush()
+	q := queue.newTrack()
+	limit := s.options.AudioPredecode
+	for pkt := range r.packets() {
+		if pkt.Timecode == webm.BadTC {
+			break
+		}
+		if pkt.Timecode > limit {
+			r.Shutdown()
+			return nil, errPCMClipTooLong
+		}
+		if pkt.TrackNumber == track.TrackNumber {
+			q.push(packet{Packet: pkt.Packet})
+		}
+	}
+	r.Shutdown()
+	queue.close()
+
+	// The decoder reads the packets as it does at the start of a stream, and reports to a stream of its own.
+	options := *s.options
+	options.AudioPrebuffer = 0
+	options.AudioDecodeAhead = 0
+	options.LowLatency = false
+	options.AudioPredecode = 0
+	tmp := &stream{
+		options: &options,
+		ctx:     s.ctx,
+		labels:  s.labels,
+	}
+	a, err := newAudioDecoder(audioCodec(track.CodecID), track.CodecPrivate, int(track.Channels), int(track.SamplingFrequency), int(track.BitDepth), q, tmp, &options)
+	if err != nil {
+		return nil, err
+	}
+	defer a.close()
+
+	maxSize := int(limit*time.Duration(a.samplingFrequency)/time.Second)*bytesPerFrame + bytesPerFrame*a.samplingFrequency
+	buf := make([]byte, 16384)
+	var data []byte
+	for {
+		n, err := a.read(buf)
+		data = append(data, buf[:n]...)
+		if err == io.EOF {
+			break
+		}
+		if err != nil {
+			return nil, err
+		}
+		if len(data) > maxSize {
+			return nil, errPCMClipTooLong
+		}
+	}
+	return &pcmClip{
+		data:              data,
+		samplingFrequency: a.samplingFrequency,
+	}, nil
+}
+
+// reopen returns a new demuxer reading the input in memory from the start.
+func (s *stream) reopen() (demuxer, error) {
+	m := &memoryReader{
+		Reader: bytes.NewReader(s.memory.data),
+		data:   s.memory.data,
+		index:  s.memory.index,
+		owner:  s.memory.owner,
+	}
+	if _, err := m.Seek(s.memoryStart, io.SeekStart); err != nil {
+		return nil, err
+	}
+	if isOgg(m) {
+		return newOggDemuxer(m)
+	}
+	var meta webm.WebM
+	w, _, err := parseWebM(m, &meta)
+	if err != nil {
+		return nil, err
+	}
+	return w, nil
+}
+
+// readClip copies the predecoded output at the position to buf. With Loop, the output continues from the start at the
+// end.
+func (a *audioStream) readClip(buf []byte) (int, error) {
+	data := a.clip.data
+	if len(data) == 0 {
+		return 0, io.EOF
+	}
+	buf = buf[:len(buf)/bytesPerFrame*bytesPerFrame]
+	pos := a.pos
+	var n int
+	for n < len(buf) {
+		off := pos
+		if a.stream.loop > 0 {
+			off %= int64(len(data))
+		}
+		if off >= int64(len(data)) {
+			if n > 0 {
+				return n, nil
+			}
+			return 0, io.EOF
+		}
+		m := copy(buf[n:], data[off:])
+		n += m
+		pos += int64(m)
+	}
+	return n, nil
+}
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"fmt"
+	"math"
+	"runtime/trace"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer/internal/flac"
+	"github.com/hajimehoshi/webmplayer/internal/libopus"
+)
+
+// wavChannelOrders is the Vorbis channel index of each channel in the WAVE order, which PCM and FLAC use, for each
+// channel count. The channels are reordered so that the downmix matrices are in the Vorbis order.
+var wavChannelOrders = [...][]int{
+	3: {0, 2, 1},                // L, R, C
+	5: {0, 2, 1, 3, 4},          // FL, FR, C, RL, RR
+	6: {0, 2, 1, 5, 3, 4},       // FL, FR, C, LFE, RL, RR
+	7: {0, 2, 1, 6, 5, 3, 4},    // FL, FR, C, LFE, RC, SL, SR
+	8: {0, 2, 1, 7, 5, 6, 3, 4}, // FL, FR, C, LFE, RL, RR, SL, SR
+}
+
+// pcmBuffer returns the buffer to write frames frames of the interleaved samples of a into. For stereo without a
+// downmix, the buffer is dst itself. Otherwise, the buffer is scratch, and mapPCM maps it to dst.
+func (a *audioStream) pcmBuffer(scratch *[]float32, dst []float32, frames int) []float32 {
+	if a.channels == 2 && a.downmix == nil {
+		return dst[:2*frames]
+	}
+	n := frames * a.channels
+	if cap(*scratch) < n {
+		*scratch = make([]float32, n)
+	}
+	return (*scratch)[:n]
+}
+
+// mapPCM maps the samples pcm in the WAVE order returned by pcmBuffer to dst as stereo.
+func (a *audioStream) mapPCM(dst []float32, pcm []float32) {
+	if a.channels == 2 && a.downmix == nil {
+		return
+	}
+	if a.channels < len(wavChannelOrders) {
+		if order := wavChannelOrders[a.channels]; order != nil {
+			var frame [8]float32
+			for i := 0; i < len(pcm); i += a.channels {
+				for c, v := range pcm[i : i+a.channels] {
+					frame[order[c]] = v
+				}
+				copy(pcm[i:i+a.channels], frame[:a.channels])
+			}
+		}
+	}
+	a.meterSource(pcm)
+	libopus.MapStereo(dst, pcm, a.channels, a.downmix)
+}
+
+// pcmDecoder is an audioDecoder of A_PCM. The samples of a packet are converted to float32 and written straight to the
+// destination, so the packets are not decoded.
+type pcmDecoder struct {
+	// bytes is the size of a sample, and float is true for IEEE floats. bigEndian is true for A_PCM/INT/BIG.
+	bytes     int
+	float     bool
+	bigEndian bool
+
+	// offset is the position in the first pending packet.
+	offset int
+
+	scratch []float32
+}
+
+func newPCMDecoder(a *audioStream, codec audioCodec, bitDepth int, options *PlayerOptions) (*pcmDecoder, error) {
+	p := &pcmDecoder{
+		bytes:     bitDepth / 8,
+		float:     codec == audioCodecPCMFloat,
+		bigEndian: codec == audioCodecPCMBigEndian,
+	}
+	switch {
+	case bitDepth%8 != 0:
+		return nil, fmt.Errorf("webmplayer: unsupported PCM bit depth: %d", bitDepth)
+	case p.float && p.bytes != 4 && p.bytes != 8:
+		return nil, fmt.Errorf("webmplayer: unsupported PCM float bit depth: %d", bitDepth)
+	case !p.float && (p.bytes < 1 || p.bytes > 4):
+		return nil, fmt.Errorf("webmplayer: unsupported PCM integer bit depth: %d", bitDepth)
+	}
+	if err := a.initPCMDownmix(options); err != nil {
+		return nil, err
+	}
+	return p, nil
+}
+
+// initPCMDownmix sets the downmix matrix of a for more than two channels.
+func (a *audioStream) initPCMDownmix(options *PlayerOptions) error {
+	if a.channels <= 0 || a.channels > 8 {
+		return fmt.Errorf("webmplayer: unsupported channel count: %d", a.channels)
+	}
+	if a.channels <= 2 {
+		return nil
+	}
+	var err error
+	a.downmix, err = downmixMatrix(options.AudioDownmix, a.channels)
+	if err != nil {
+		return err
+	}
+	a.loudnessWeights = surroundLoudnessWeights(a.channels)
+	return nil
+}
+
+func (p *pcmDecoder) read(a *audioStream, dst []float32) (int, error) {
+	start := time.Now()
+	frameSize := p.bytes * a.channels
+	var n int
+	for len(a.packets) > 0 && len(dst)-n >= 2 {
+		data := a.packets[0].Data[p.offset:]
+		frames := len(data) / frameSize
+		if a.skip > 0 {
+			s := min(a.skip, frames)
+			a.skip -= s
+			frames -= s
+			p.offset += s * frameSize
+			data = data[s*frameSize:]
+		}
+		k := min(frames, (len(dst)-n)/2)
+		if k > 0 {
+			pcm := a.pcmBuffer(&p.scratch, dst[n:], k)
+			p.convert(pcm, data[:k*frameSize])
+			a.mapPCM(dst[n:], pcm)
+			n += 2 * k
+			p.offset += k * frameSize
+		}
+		if len(a.packets[0].Data)-p.offset < frameSize {
+			p.offset = 0
+			a.consumePackets(1, time.Since(start))
+			start = time.Now()
+		}
+	}
+	return n, nil
+}
+
+// convert converts the samples in data to pcm.
+func (p *pcmDecoder) convert(pcm []float32, data []byte) {
+	switch {
+	case p.float && p.bytes == 4:
+		for i := range pcm {
+			pcm[i] = math.Float32frombits(binary.LittleEndian.Uint32(data[4*i:]))
+		}
+	case p.float:
+		for i := range pcm {
+			pcm[i] = float32(math.Float64frombits(binary.LittleEndian.Uint64(data[8*i:])))
+		}
+	case p.bytes == 1:
+		// 8-bit samples are unsigned as WAVE.
+		for i := range pcm {
+			pcm[i] = float32(int(data[i])-0x80) / 0x80
+		}
+	case p.bytes == 2 && !p.bigEndian:
+		for i := range pcm {
+			pcm[i] = float32(int16(binary.LittleEndian.Uint16(data[2*i:]))) / (1 << 15)
+		}
+	case p.bytes == 2:
+		for i := range pcm {
+			pcm[i] = float32(int16(binary.BigEndian.Uint16(data[2*i:]))) / (1 << 15)
+		}
+	case p.bytes == 3 && !p.bigEndian:
+		for i := range pcm {
+			b := data[3*i : 3*i+3]
+			pcm[i] = float32(int32(uint32(b[0])<<8|uint32(b[1])<<16|uint32(b[2])<<24)>>8) / (1 << 23)
+		}
+	case p.bytes == 3:
+		for i := range pcm {
+			b := data[3*i : 3*i+3]
+			pcm[i] = float32(int32(uint32(b[2])<<8|uint32(b[1])<<16|uint32(b[0])<<24)>>8) / (1 << 23)
+		}
+	case !p.bigEndian:
+		for i := range pcm {
+			pcm[i] = float32(int32(binary.LittleEndian.Uint32(data[4*i:]))) / (1 << 31)
+		}
+	default:
+		for i := range pcm {
+			pcm[i] = float32(int32(binary.BigEndian.Uint32(data[4*i:]))) / (1 << 31)
+		}
+	}
+}
+
+func (p *pcmDecoder) reset() error {
+	p.offset = 0
+	return nil
+}
+
+func (p *pcmDecoder) close(pool *PlayerPool) {
+}
+
+// flacDecoder is an audioDecoder of FLAC. A block has one or more frames, which are decoded one by one and written
+// to the destination as it has room.
+type flacDecoder struct {
+	decoder *flac.Decoder
+
+	// frame is the last decoded frame, and pos is the number of its samples already written.
+	frame flac.Frame
+	pos   int
+
+	// offset is the position of the next frame in the first pending packet.
+	offset int
+
+	scratch []float32
+}
+
+func newFLACDecoder(a *audioStream, codecPrivate []byte, options *PlayerOptions) (*flacDecoder, error) {
+	info, err := flac.ParseStreamInfo(codecPrivate)
+	if err != nil {
+		return nil, err
+	}
+	if info.Channels != a.channels {
+		return nil, fmt.Errorf("webmplayer: channel count doesn't match: %d vs %d", info.Channels, a.channels)
+	}
+	a.samplingFrequency = info.SampleRate
+	if err := a.initPCMDownmix(options); err != nil {
+		return nil, err
+	}
+	return &flacDecoder{
+		decoder: flac.NewDecoder(info),
+	}, nil
+}
+
+// remaining returns the number of the samples of the frame not written yet in each channel.
+func (f *flacDecoder) remaining() int {
+	if len(f.frame.Samples) == 0 {
+		return 0
+	}
+	return len(f.frame.Samples[0]) - f.pos
+}
+
+func (f *flacDecoder) read(a *audioStream, dst []float32) (int, error) {
+	var n int
+	for len(dst)-n >= 2 {
+		if f.remaining() == 0 {
+			if len(a.packets) == 0 {
+				break
+			}
+			if err := f.decodeFrame(a); err != nil {
+				return n, err
+			}
+			continue
+		}
+		k := f.remaining()
+		if a.skip > 0 {
+			s := min(a.skip, k)
+			a.skip -= s
+			f.pos += s
+			continue
+		}
+		k = min(k, (len(dst)-n)/2)
+		pcm := a.pcmBuffer(&f.scratch, dst[n:], k)
+		scale := 1 / float32(int64(1)<<(f.frame.BitsPerSample-1))
+		for c, samples := range f.frame.Samples {
+			samples = samples[f.pos : f.pos+k]
+			for i, v := range samples {
+				pcm[i*a.channels+c] = float32(v) * scale
+			}
+		}
+		a.mapPCM(dst[n:], pcm)
+		n += 2 * k
+		f.pos += k
+	}
+	return n, nil
+}
+
+// decodeFrame decodes the next frame of the first pending packet. A broken frame drops the rest of the packet.
+func (f *flacDecoder) decodeFrame(a *audioStream) error {
+	start := time.Now()
+	r := trace.StartRegion(a.stream.ctx, "audio.decode")
+	data := a.packets[0].Data
+	frame, size, err := f.decoder.DecodeFrame(data[f.offset:])
+	r.End()
+	f.frame, f.pos = flac.Frame{}, 0
+	if err == nil && len(frame.Samples) != a.channels {
+		err = fmt.Errorf("webmplayer: FLAC frame has %d channels instead of %d", len(frame.Samples), a.channels)
+	}
+	if err == nil {
+		f.frame = frame
+		f.offset += size
+	}
+	if err != nil || f.offset >= len(data) {
+		f.offset = 0
+		a.consumePackets(1, time.Since(start))
+	}
+	return nil
+}
+
+func (f *flacDecoder) reset() error {
+	f.frame, f.pos, f.offset = flac.Frame{}, 0, 0
+	return nil
+}
+
+func (f *flacDecoder) close(pool *PlayerPool) {
+}
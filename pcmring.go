@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+// pcmRing is a fixed-capacity ring buffer of interleaved float32 samples.
+// The capacity is decided from the maximum frame size of the codec, so that steady-state decoding doesn't allocate.
+// The buffer is accounted in the memory budget until free.
+type pcmRing struct {
+	buf  []float32
+	head int
+	n    int
+}
+
+func newPCMRing(capacity int) *pcmRing {
+	trackMemory(memoryAudioBuffers, 4*int64(capacity))
+	return &pcmRing{
+		buf: make([]float32, capacity),
+	}
+}
+
+// Len returns the number of samples in the ring.
+func (r *pcmRing) Len() int {
+	return r.n
+}
+
+func (r *pcmRing) Reset() {
+	r.head = 0
+	r.n = 0
+}
+
+// Read moves samples from the ring to dst, and returns the number of moved samples.
+func (r *pcmRing) Read(dst []float32) int {
+	n := min(len(dst), r.n)
+	c := copy(dst[:n], r.buf[r.head:])
+	copy(dst[c:n], r.buf)
+	r.head = (r.head + n) % len(r.buf)
+	r.n -= n
+	return n
+}
+
+// Discard removes at most n samples from the ring, and returns the number of removed samples.
+func (r *pcmRing) Discard(n int) int {
+	n = min(n, r.n)
+	r.head = (r.head + n) % len(r.buf)
+	r.n -= n
+	return n
+}
+
+// Write appends samples to the ring.
+func (r *pcmRing) Write(samples []float32) {
+	r.reserve(len(samples))
+	tail := (r.head + r.n) % len(r.buf)
+	c := copy(r.buf[tail:], samples)
+	copy(r.buf, samples[c:])
+	r.n += len(samples)
+}
+
+// Space returns the contiguous free space after the samples in the ring, to decode into directly.
+// The samples written to the space are appended by Commit.
+func (r *pcmRing) Space() []float32 {
+	if r.n == 0 {
+		r.head = 0
+	}
+	tail := r.head + r.n
+	if tail >= len(r.buf) {
+		return r.buf[tail-len(r.buf) : r.head]
+	}
+	return r.buf[tail:]
+}
+
+// Commit appends the first n samples of the space returned by Space.
+func (r *pcmRing) Commit(n int) {
+	r.n += n
+}
+
+// reserve grows the ring if n more samples don't fit.
+// This happens only when a packet is larger than the expected maximum.
+func (r *pcmRing) reserve(n int) {
+	if r.n+n <= len(r.buf) {
+		return
+	}
+	m := r.n
+	buf := make([]float32, max(2*len(r.buf), m+n))
+	trackMemory(memoryAudioBuffers, 4*int64(len(buf)-len(r.buf)))
+	r.Read(buf[:m])
+	r.buf = buf
+	r.head = 0
+	r.n = m
+}
+
+// free drops the buffer. The ring must not be used after free.
+func (r *pcmRing) free() {
+	trackMemory(memoryAudioBuffers, -4*int64(len(r.buf)))
+	r.buf = nil
+	r.head = 0
+	r.n = 0
+}
@@ -6,50 +6,538 @@ package webmplayer
 import (
 	"fmt"
 	"io"
+	"math"
+	"runtime"
+	"slices"
+	"sync"
+	"sync/atomic"
 	"time"
 
-	"github.com/ebml-go/webm"
 	"github.com/hajimehoshi/ebiten/v2"
-	"github.com/hajimehoshi/ebiten/v2/audio"
 )
 
 type Player struct {
 	width  int
 	height int
 
+	videoSource *stream
+	audioSource *stream
+
 	videoStream *videoStream
 	audioStream *audioStream
-	audioPlayer *audio.Player
+	audioPlayer audioOutput
+	clock       Clock
+
+	// stretcher changes the speed of the audio by rate.
+	stretcher *timeStretcher
+	rate      float64
+
+	paused bool
+	closed bool
+
+	// stepDecoding is true while the video is decoded for StepForward, StepBackward or PlayBackward in a pause.
+	stepDecoding bool
+
+	// hidden is true if the Player is hidden by SetVisible. hiddenAfter is PlayerOptions.HiddenAfter, and drawn is
+	// when Draw was called last.
+	hidden      bool
+	hiddenAfter time.Duration
+	drawn       time.Time
+
+	// background is true while only the audio plays by SetBackground.
+	background bool
+
+	// scrubbing is true between Scrub and EndScrub, and scrubResume is true if the Player was playing before
+	// scrubbing. scrubTarget is the last position of Scrub, and scrubKeyframe is the keyframe shown for it.
+	// scrubSettling is true while the video is decoded in a pause until the frame after scrubbing is shown.
+	scrubbing     bool
+	scrubResume   bool
+	scrubTarget   time.Duration
+	scrubKeyframe time.Duration
+	scrubSettling bool
+
+	// views is the number of the open PlayerViews, and released is true if Close is called while views are open.
+	// tick is the number of the ticks the Player has been updated in, and updated is the last tick updated by Update.
+	views    int
+	released bool
+	tick     uint64
+	updated  uint64
+
+	// updatedPos is the position of the clock at the latest update, and updatedAt is when it was read.
+	updatedPos time.Duration
+	updatedAt  time.Time
+
+	// finished is true when the playback has reached the end. done is closed when finished becomes true, or nil
+	// if Done has not been called.
+	finished bool
+	done     chan struct{}
+
+	// stopAtEnd is PlayerOptions.StopAtEnd, and stopped is true when the Player has stopped at the end.
+	stopAtEnd bool
+	stopped   bool
+
+	// onStall is PlayerOptions.OnStall if PlayerOptions.FlightRecorder is set, and stallDumped is when it was last
+	// called.
+	onStall     func(stall *Stall)
+	stallDumped time.Time
+
+	avSync avSync
 
 	videoDuration time.Duration
 	videoCodecID  string
 	audioDuration time.Duration
 	audioCodecID  string
+
+	// renditions is the video renditions for NewPlayerWithRenditions, in the descending order of the bitrates.
+	// rendition is the index of the rendition being played, and pending is the index of the rendition to be switched
+	// to, or -1.
+	renditions []*rendition
+	rendition  int
+	pending    int
+
+	// abrCheck is the position to choose a rendition next, and abrHold is the position until which the Player doesn't
+	// switch to a heavier rendition. abrSkipped is the number of the skipped frames at the last check.
+	abrCheck   time.Duration
+	abrHold    time.Duration
+	abrSkipped int
+
+	// created is when the Player started to be created. newPlayerTime and audioOutputTime are the time to create the
+	// Player and its audio output.
+	created         time.Time
+	newPlayerTime   time.Duration
+	audioOutputTime time.Duration
+
+	// loudness is the bits of the integrated loudness of the audio, or 0 if unknown, and normalization is the gain of
+	// PlayerOptions.LoudnessTarget, or 0 if not normalized.
+	loudness      atomic.Uint64
+	normalization float64
 }
 
+// PlayerOptions represents options for a Player.
+type PlayerOptions struct {
+	// VideoCatchUpThreshold is how far the video can lag behind the playback position before the decoder skips
+	// frames without decoding them until the next keyframe.
+	// Frames that are not referred by other frames are skipped whenever they are late.
+	//
+	// If VideoCatchUpThreshold is 0, 500 milliseconds is used.
+	// If VideoCatchUpThreshold is negative, the decoder never waits for the next keyframe.
+	VideoCatchUpThreshold time.Duration
+
+	// VideoResyncOnError makes the video decoder skip a packet that fails to decode, e.g. a corrupt block of a lossy
+	// live input, instead of failing Update. The decoder is restarted, and the packets are skipped until the next
+	// keyframe, while the audio keeps playing. PlayerStats.VideoResyncs counts the packets.
+	VideoResyncOnError bool
+
+	// VideoFrameQueueSize is the maximum number of decoded video frames waiting for presentation.
+	// A larger queue lets the decoder get further ahead and absorb decoding hiccups, at the cost of memory.
+	//
+	// If VideoFrameQueueSize is 0, 4 is used.
+	VideoFrameQueueSize int
+
+	// VideoDecoderThreads is the number of threads the decoder uses to decode video.
+	// VP9 decodes tiles and the rows of the tiles in parallel, VP8 decodes token partitions in parallel, and AV1
+	// decodes tiles and applies the loop filters in parallel.
+	//
+	// If VideoDecoderThreads is 0, half of the CPUs up to 8 threads is used.
+	VideoDecoderThreads int
+
+	// VideoTargetWidth and VideoTargetHeight are the size the video is drawn at, e.g. for a preview tile.
+	// The decoded frames are downscaled by the largest integer factor that keeps them at least the target size, before
+	// they are converted and uploaded, so that the CPU time and the upload bandwidth follow the drawn size rather than
+	// the source size. Draw still draws the video at VideoSize, so PlayerDrawOptions.GeoM doesn't change.
+	//
+	// If VideoTargetWidth or VideoTargetHeight is 0, that dimension doesn't limit the factor. If both are 0, the frames
+	// are not downscaled.
+	VideoTargetWidth  int
+	VideoTargetHeight int
+
+	// VideoSelectSpatialLayer makes the decoder of a VP9 stream with several spatial layers (SVC) decode only the
+	// layers up to the smallest one that is at least VideoTargetWidth and VideoTargetHeight, e.g. for small tiles,
+	// so that the decoding cost follows the drawn size as well. The layer is chosen at each keyframe from the frame
+	// sizes of its superframe. A stream without spatial layers is decoded as usual.
+	//
+	// Without VideoTargetWidth and VideoTargetHeight, VideoSelectSpatialLayer does nothing.
+	VideoSelectSpatialLayer bool
+
+	// VideoHashFrames makes the decoder hash the pixels of each decoded frame, so that a frame with the same pixels as
+	// the frame on screen is not uploaded, e.g. for screencasts and slides encoded as still frames.
+	// Without VideoHashFrames, only the frames that libvpx repeats from its frame buffers are detected.
+	VideoHashFrames bool
+
+	// VideoFrameCacheBytes is the memory budget to keep the decoded frames of a short clip, e.g. a background loop or
+	// an animated UI element. When a pass from the start to the end is decoded without skipping a frame, its frames
+	// are kept as decoded, and the next passes after seeking are replayed from them without decoding. If the frames
+	// exceed the budget, they are freed and the clip is decoded as usual.
+	//
+	// If VideoFrameCacheBytes is 0, the frames are not cached.
+	VideoFrameCacheBytes int64
+
+	// VideoStepCacheBytes is the memory budget to keep the presented frames while playing, so that StepBackward and
+	// PlayBackward show the recent frames without decoding them again.
+	//
+	// If VideoStepCacheBytes is 0, the frames are kept only while stepping, up to 64 MiB.
+	VideoStepCacheBytes int64
+
+	// VideoAdaptQuality makes the video decoder lower its quality step by step while it can't keep up with the
+	// playback, e.g. on an overloaded host, and raise it again when there is enough headroom. The steps are skipping
+	// the loop filter of VP9, skipping the frames not referred by other frames, and converting and uploading the
+	// frames at the half size as VideoTargetWidth and VideoTargetHeight do.
+	//
+	// Without VideoAdaptQuality, the frames are skipped only when they are late.
+	VideoAdaptQuality bool
+
+	// HardwareVideoDecoding makes the Player decode the video with the hardware decoder of the platform if there is
+	// one: MediaCodec on Android for VP8 and VP9, and VideoToolbox on macOS 11 or later for VP9. The decoded pictures
+	// are read back to the CPU and uploaded as the ones of libvpx, as Ebitengine can't draw the surfaces of the
+	// platform. A stream the hardware decoder can't decode, e.g. of 10 bits, falls back to libvpx, which starts at
+	// the next keyframe if the hardware decoder fails in the middle of the stream.
+	//
+	// HardwareVideoDecoding is ignored on the other platforms and with NewVideoDecoder.
+	HardwareVideoDecoding bool
+
+	// NewVideoDecoder creates the video decoder for the codec ID of the track, e.g. "V_VP9", instead of the built-in
+	// decoders, e.g. to use the hardware decoder of the platform. threads is VideoDecoderThreads or its default.
+	// If NewVideoDecoder returns nil without an error, the built-in decoder is used.
+	// The decoders are not kept in Pool.
+	//
+	// If NewVideoDecoder is nil, the built-in decoders are used.
+	NewVideoDecoder func(codecID string, threads int) (VideoDecoder, error)
+
+	// OnVideoFrame receives the decoded video frames instead of Draw, e.g. for inference rather than display.
+	// OnVideoFrame is called from Update with each frame at its presentation time, as Draw would draw it. The frames
+	// are neither converted to RGB nor uploaded to textures, and Draw draws nothing.
+	// The frame is valid until Frame.Release is called, and OnVideoFrame can keep it after returning.
+	// VideoTargetWidth and VideoTargetHeight don't apply to the frames.
+	//
+	// If OnVideoFrame is nil, the frames are drawn by Draw.
+	OnVideoFrame func(frame *Frame)
+
+	// AudioDownmix is the matrix to mix audio with more than two channels down to stereo.
+	// AudioDownmix[0] and AudioDownmix[1] are the gains of each input channel for the left and the right output.
+	// The input channels are in the Vorbis channel order, e.g. FL, C, FR, RL, RR and LFE for 5.1.
+	//
+	// If AudioDownmix is empty, a standard downmix for the channel count is used.
+	AudioDownmix [2][]float32
+
+	// AudioPrebuffer is the duration of the audio packets to be queued before the audio starts, at the start and after
+	// seeking. The audio and the video wait until then, so that the start doesn't glitch under load.
+	// AudioPrebuffer longer than ReadAhead is limited to ReadAhead.
+	//
+	// If AudioPrebuffer is 0, the audio starts with the first packet.
+	AudioPrebuffer time.Duration
+
+	// Prepare makes NewPlayer return a paused Player that warms up without playing, e.g. for a clip on hover. The
+	// input is read, the first frame is decoded and drawn by Update, and the audio is decoded ahead with
+	// AudioDecodeAhead or queued for AudioPrebuffer, and then the Player idles without CPU time until Resume. Prepared
+	// reports when the Player is warm, and then Resume starts the playback immediately.
+	Prepare bool
+
+	// NoAudio makes the Player play the video without the audio, e.g. for a muted preview. No audio decoder or audio
+	// output is created, the blocks of the audio tracks are dropped by the demuxer without their data being read, and
+	// the video is paced by the wall clock. A separate audio input is not played.
+	NoAudio bool
+
+	// AudioDecodeAhead is the duration of the audio decoded ahead of the audio player by a goroutine of the Player.
+	// The audio player then only copies the decoded audio, so that a slow packet or a late demuxer doesn't take the
+	// time of the audio device's buffer.
+	//
+	// If AudioDecodeAhead is 0, the audio is decoded when the audio player reads it.
+	AudioDecodeAhead time.Duration
+
+	// AudioPredecode is the longest audio track decoded entirely at once, e.g. for a jingle or a sound effect played
+	// often. The audio track of an input in memory, by NewPlayerFromBytes, NewPlayerFromFS or Bundle.NewPlayer, that
+	// is not longer than AudioPredecode is decoded once when the Player is created. The Players of the same input
+	// share the decoded samples, and only copy them at their own positions. The samples of the latest inputs are kept
+	// for the next Players.
+	//
+	// If AudioPredecode is 0, the input is not in memory, or its duration is unknown, the audio is decoded as it is
+	// played.
+	AudioPredecode time.Duration
+
+	// LowLatency makes a seek or a skip heard sooner, e.g. for an interactive cutscene, at the risk of glitches under
+	// load. The audio is decoded ahead into a short ring as with AudioDecodeAhead, so that the audio output never
+	// waits for the decoder, and the buffer of the shared audio output is made smaller. The smaller buffer is kept for
+	// all the Players until the process ends. PlayerStats.AudioOutputLatency and PlayerStats.AudioDecodedAhead report
+	// the latency.
+	//
+	// With LowLatency, AudioDecodeAhead is 40 milliseconds unless it is set.
+	LowLatency bool
+
+	// AudioOutputInt16 makes the shared audio output take 16-bit samples instead of 32-bit floats, which halves the
+	// size of the samples moved to the audio device, e.g. on a device with little memory bandwidth. The Players are
+	// still mixed as floats, and the mix is clamped and rounded to 16 bits. As the sample rate of the audio context,
+	// the format is decided by the first Player or Playlist, and is kept until the process ends.
+	AudioOutputInt16 bool
+
+	// AudioLowWatermark is how far the audio read by the audio player must be ahead of the playback position. While
+	// the audio is less ahead, the video decoder skips the frames that are not referred by other frames, so that the
+	// audio decoder gets the CPU before the audio underruns.
+	//
+	// If AudioLowWatermark is 0, 10 milliseconds is used.
+	// If AudioLowWatermark is negative, the video decoder doesn't yield to the audio.
+	AudioLowWatermark time.Duration
+
+	// AudioRateDivisor divides the sample rate that Vorbis audio is decoded at, 2 or 4, e.g. for background music on
+	// slow devices. The decoder uses only the lower part of the spectrum with a smaller inverse MDCT, which cuts the
+	// decoding cost and keeps the frequencies under the reduced Nyquist frequency. The audio is output at the reduced
+	// rate, and is resampled if the audio context has another rate. If the short blocks of the stream are too small
+	// for the rate, the lowest rate they allow is used. The other codecs are decoded at the full rate.
+	//
+	// If AudioRateDivisor is 0 or 1, Vorbis audio is decoded at the full rate.
+	AudioRateDivisor int
+
+	// AudioParallelStreams makes the Opus decoder decode the streams of each packet of a multistream track in
+	// parallel, e.g. the 4 or 5 streams of 5.1 or 7.1 or the streams of ambisonics, and then map their channels to the
+	// output. This lowers the time to decode each packet at the cost of a goroutine and a thread for each stream while
+	// decoding. The decode calls of the streams count as one for DecodeScheduler. The ambisonics with the mapping
+	// family 3 and the tracks of one stream are decoded as usual.
+	//
+	// AudioParallelStreams is ignored on js.
+	AudioParallelStreams bool
+
+	// AudioParallelChannels makes the Vorbis decoder synthesize the channels of each packet of a track of 6 or more
+	// channels in parallel, up to GOMAXPROCS goroutines. The floors and the inverse MDCTs of the channels, the most
+	// of the time to decode a packet, are independent after the channel coupling. The output is the same.
+	AudioParallelChannels bool
+
+	// AudioResampleQuality is the quality of the sample rate conversion, which is used when the audio context
+	// already exists with a different sample rate from the audio track.
+	//
+	// If AudioResampleQuality is 0, ResampleQualityMedium is used.
+	AudioResampleQuality ResampleQuality
+
+	// ReadAhead is how far the demuxer reads packets ahead of the decoder for each track.
+	// While another track has no packets, the demuxer reads further, up to ReadAheadBytes.
+	//
+	// If ReadAhead is 0, 2 seconds is used.
+	ReadAhead time.Duration
+
+	// ReadAheadBytes is the maximum size of the packets waiting for decoding for each track.
+	//
+	// If ReadAheadBytes is 0, 16 MiB is used.
+	ReadAheadBytes int
+
+	// VideoTrack and AudioTrack are the track numbers to play.
+	// With separate video and audio inputs, a track number applies to the input that has the kind of tracks.
+	//
+	// If VideoTrack or AudioTrack is 0, the first video or audio track is used.
+	VideoTrack uint
+	AudioTrack uint
+
+	// SubtitleTrack is the track number of the subtitle track for AppendSubtitles, a WebVTT or UTF-8 text track.
+	//
+	// If SubtitleTrack is 0, the first subtitle track is used.
+	SubtitleTrack uint
+
+	// Clock is the master clock that the video follows. The audio speed is adjusted slightly to follow Clock at the
+	// playback rate 1, and the audio plays at its own pace at other rates.
+	// Seek moves the decoders, and the position of Clock is expected to follow.
+	//
+	// If Clock is nil, the audio position is used if there is audio. Otherwise, a monotonic clock from the creation of
+	// the Player is used.
+	Clock Clock
+
+	// DecodeBudget makes the video decoder run only within Update, for up to DecodeBudget each time, e.g. for a game
+	// loop that must not be shared with free-running decoding, or for a replay expecting the same decoding at each
+	// tick. A decode call can't be interrupted, so a call started near the end of the budget finishes after Update
+	// returns, and the decoding resumes at the next Update. Update returns earlier when the decoder has nothing to do.
+	// VideoFramesReady and AudioReadAhead report whether the video and the audio are ready.
+	//
+	// The demuxer still reads ahead on its own goroutine, bounded by ReadAhead, and the audio is decoded as the audio
+	// output pulls it, which doesn't follow the game loop.
+	//
+	// If DecodeBudget is 0, the video decoder runs on its own.
+	DecodeBudget time.Duration
+
+	// DecodeScheduler is the scheduler of the decode calls shared by Players.
+	//
+	// If DecodeScheduler is nil, the decode calls of the Player are not limited.
+	DecodeScheduler *DecodeScheduler
+
+	// DecodeCPUs is the CPUs that the decoders of the Player run on, e.g. the CPUs of a NUMA node, so that the
+	// decoders don't migrate between the sockets and lose their caches.
+	// The video decoder's goroutine is locked to an OS thread running on the CPUs, and the decoder's threads run on
+	// them too. The audio decoder runs on the CPUs during each decode call. The decoders taken from Pool keep the
+	// CPUs of their threads.
+	// DecodeCPUs is a hint, and is ignored on the platforms other than Linux.
+	//
+	// If DecodeCPUs is empty, the decoders run on any CPU.
+	DecodeCPUs []int
+
+	// Pool is the pool of decoders to reuse. Close of the Player returns the decoders to Pool.
+	//
+	// If Pool is nil, the decoders are created for the Player and freed by Close.
+	Pool *PlayerPool
+
+	// FastStart makes the Player start sooner. The video decoder and the audio decoder are initialized concurrently,
+	// and the first video frame is drawn as soon as it is decoded, without waiting for the audio to start or the clock
+	// to reach the frame. The time of each step of starting is reported by PlayerStats.Startup.
+	//
+	// Without FastStart, the decoders are initialized one by one, and the first frame is drawn at its timecode.
+	FastStart bool
+
+	// StopAtEnd makes the Player release its decoders and goroutines when the playback reaches the end, as Close does.
+	// Draw keeps drawing the last frame. A stopped Player can't be sought.
+	//
+	// Without StopAtEnd, the Player stops only the audio at the end, and can be sought to play again.
+	StopAtEnd bool
+
+	// Loop makes the Player play the inputs again from the start at the end without reopening them, e.g. for a
+	// background loop. The demuxer reads from the first cluster again, which a NewPrefetchReader source prefetches
+	// before the end, and the audio of each pass follows the previous pass's sample by sample, with the pre-skip of
+	// Opus dropped as at the start. Each input loops by its duration, and an input without a duration plays once.
+	//
+	// With Loop, the Player doesn't reach the end, and Position keeps increasing across the passes. Seek to a position
+	// beyond the duration plays the pass including the position.
+	Loop bool
+
+	// VideoAtlas is the texture that the video frames are drawn into, shared with other Players so that DrawPlayers
+	// draws them by one draw call. A frame that doesn't fit in the atlas is drawn into its own texture.
+	//
+	// If VideoAtlas is nil, each Player has its own texture.
+	VideoAtlas *VideoAtlas
+
+	// HiddenAfter makes the Player hidden as SetVisible(false) does while Draw is not called for the duration, e.g.
+	// for a tile scrolled off a list or a window in the background.
+	//
+	// If HiddenAfter is 0, the Player is hidden only by SetVisible.
+	HiddenAfter time.Duration
+
+	// Label is the value of the pprof label webmplayer.player of the goroutines of the Player, which distinguishes the
+	// Players in a CPU profile. The goroutines also have the labels webmplayer.input and webmplayer.stage, and the
+	// stages are traced as runtime/trace regions in the task webmplayer.stream of each input.
+	Label string
+
+	// LoudnessTarget normalizes the loudness of the audio to the integrated loudness in LUFS, e.g. -23 for EBU R128 or
+	// -14 for streaming services, by a gain applied with the volume. The gain is at most +12 dB.
+	//
+	// The loudness is Loudness if known. Otherwise, the audio is measured during the playback, and Player.Loudness
+	// returns the loudness when the playback reaches the end without a seek, which can be given as Loudness later.
+	// The audio is measured as MeasureLoudness measures it, except that the stereo output is measured with
+	// AudioPredecode.
+	// A Player of NewPlayerFromFile keeps the loudness measured in the sidecar file as MeasureLoudnessFromFile with
+	// LoudnessOptions.Sidecar, and the next Player applies it from the start.
+	//
+	// If LoudnessTarget is 0, the loudness is not normalized.
+	LoudnessTarget float64
+
+	// IndexSidecar makes a Player of NewPlayerFromFile keep the headers and the Cues of a WebM input in a file next to
+	// the input, whose name is the input's with ".index", and read them from the file instead of parsing the input
+	// while the input's size and modification time are the same. The file is written when it is missing or stale.
+	IndexSidecar bool
+
+	// CgoStats makes the decoders count their calls into C, with the sizes of the data and the time, in
+	// PlayerStats.Cgo. The counts of all the Players are also published as the expvar webmplayer.cgo.
+	// Without CgoStats, the calls are not timed.
+	CgoStats bool
+
+	// FlightRecorder is the number of the recent events of the pipeline kept for each input, e.g. the packets
+	// demuxed, the decoding and the audio read, for Player.FlightRecord and OnStall. The events are recorded without
+	// locks into a fixed-size ring.
+	//
+	// If FlightRecorder is 0, no events are recorded.
+	FlightRecorder int
+
+	// StallThreshold is how late a video frame can be presented or dropped before OnStall is called.
+	//
+	// If StallThreshold is 0, 100 milliseconds is used.
+	StallThreshold time.Duration
+
+	// OnStall is called from Update with the events of FlightRecorder after a stall: a video frame later than
+	// StallThreshold, or the audio played as silence. A stall within a second after the last one is not reported.
+	OnStall func(stall *Stall)
+
+	// Loudness is the integrated loudness of the audio in LUFS, e.g. by MeasureLoudness in an indexer, or 0 if
+	// unknown. Loudness is used with LoudnessTarget.
+	Loudness float64
+}
+
+// TrackInfo represents a track in the input.
+type TrackInfo struct {
+	Number   uint
+	Name     string
+	Language string
+	CodecID  string
+}
+
+const (
+	defaultVideoCatchUpThreshold = 500 * time.Millisecond
+	defaultVideoFrameQueueSize   = 4
+	defaultAudioLowWatermark     = 10 * time.Millisecond
+	lowLatencyAudioDecodeAhead   = 40 * time.Millisecond
+	defaultReadAhead             = 2 * time.Second
+	defaultReadAheadBytes        = 16 << 20
+)
+
+func defaultVideoDecoderThreads() int {
+	return min(max(runtime.NumCPU()/2, 1), 8)
+}
+
+// NewPlayer creates a Player of the WebM inputs streams. An input can also be an Ogg stream of Opus or Vorbis audio,
+// e.g. a .ogg or .opus file.
 func NewPlayer(streams ...io.ReadSeeker) (*Player, error) {
-	stream1, stream2, err := discoverStreams(streams...)
+	return NewPlayerWithOptions(nil, streams...)
+}
+
+func NewPlayerWithOptions(options *PlayerOptions, streams ...io.ReadSeeker) (*Player, error) {
+	return newPlayer(options, newAudioPlayer, nil, streams...)
+}
+
+// audioOutput is where a Player plays its audio. audioOutput is implemented by *mixerInput and *playlistOutput.
+type audioOutput interface {
+	Play()
+	Pause()
+	Position() time.Duration
+	SetPosition(t time.Duration) error
+	Close() error
+
+	// fade changes the volume linearly in d of the playback, and volume returns the volume being faded to.
+	fade(volume float64, d time.Duration)
+	volume() float64
+
+	// finished reports whether all the audio of the stream has been played.
+	finished() bool
+}
+
+// audioOutputFunc creates the audio output that plays audioStream at the playback rate.
+type audioOutputFunc func(audioStream *audioStream, rate float64) (audioOutput, *timeStretcher, error)
+
+// newPlayer creates a Player of streams. paths is the local files of streams if opened by NewPlayerFromFile, or nil.
+func newPlayer(options *PlayerOptions, newOutput audioOutputFunc, paths []string, streams ...io.ReadSeeker) (*Player, error) {
+	if options == nil {
+		options = &PlayerOptions{}
+	}
+	start := time.Now()
+
+	stream1, stream2, err := discoverStreams(options, streams...)
 	if err != nil {
 		return nil, err
 	}
 	if stream1 == nil {
 		return nil, fmt.Errorf("webmplayer: nothing to play")
 	}
+	if options.NoAudio {
+		if stream2 != nil {
+			stream2.close()
+			stream2 = nil
+		}
+		if stream1.VideoTrack() == nil {
+			stream1.close()
+			return nil, fmt.Errorf("webmplayer: nothing to play without the audio")
+		}
+	}
 
 	videoStream := stream1.VideoStream()
 	videoMeta := stream1.Meta()
-	videoTrack := videoMeta.FindFirstVideoTrack()
+	videoTrack := stream1.VideoTrack()
 
-	var audioStream *audioStream
-	var audioMeta *webm.WebM
+	audioSource := stream1
 	if stream2 != nil {
-		audioStream = stream2.AudioStream()
-		audioMeta = stream2.Meta()
-	} else {
-		audioStream = stream1.AudioStream()
-		audioMeta = stream1.Meta()
+		audioSource = stream2
 	}
-	audioTrack := audioMeta.FindFirstAudioTrack()
+	audioStream := audioSource.AudioStream()
+	audioMeta := audioSource.Meta()
+	audioTrack := audioSource.AudioTrack()
 
 	var w, h int
 	var videoCodecID string
@@ -66,26 +554,103 @@ func NewPlayer(streams ...io.ReadSeeker) (*Player, error) {
 	v := &Player{
 		width:         w,
 		height:        h,
+		videoSource:   stream1,
+		audioSource:   audioSource,
 		videoStream:   videoStream,
 		audioStream:   audioStream,
 		videoDuration: videoMeta.GetDuration(),
 		videoCodecID:  videoCodecID,
 		audioDuration: audioMeta.GetDuration(),
 		audioCodecID:  audioCodecID,
+		created:       start,
 	}
 
 	if audioStream != nil {
-		ctx := audio.NewContext(audioStream.SamplingFrequency())
-		p, err := ctx.NewPlayerF32(audioStream)
+		outputStart := time.Now()
+		p, stretcher, err := newOutput(audioStream, 1)
 		if err != nil {
+			stream1.close()
+			if stream2 != nil {
+				stream2.close()
+			}
 			return nil, err
 		}
-		p.Play()
+		v.audioOutputTime = time.Since(outputStart)
 		v.audioPlayer = p
+		v.stretcher = stretcher
+		var path string
+		if paths != nil {
+			// The inputs of NewPlayerFromFile are comparable.
+			if i := slices.Index(streams, audioSource.input); i >= 0 {
+				path = paths[i]
+			}
+		}
+		v.initLoudness(options, path)
+		if !options.Prepare {
+			p.Play()
+		}
 	}
+	v.initClock(options)
+	if options.Prepare {
+		v.prepare()
+	}
+	v.newPlayerTime = time.Since(start)
 	return v, nil
 }
 
+func (p *Player) initClock(options *PlayerOptions) {
+	p.rate = 1
+	p.stopAtEnd = options.StopAtEnd
+	if options.FlightRecorder > 0 {
+		p.onStall = options.OnStall
+	}
+	p.hiddenAfter = options.HiddenAfter
+	p.drawn = time.Now()
+	p.avSync.reset()
+	switch {
+	case options.Clock != nil:
+		p.clock = options.Clock
+	case p.audioPlayer != nil:
+		p.clock = newAudioClock(p.audioPosition)
+	default:
+		p.clock = newWallClock()
+	}
+}
+
+// audioPosition returns the position of the audio being played, in the time of the input.
+func (p *Player) audioPosition() time.Duration {
+	return p.stretcher.mediaPosition(p.audioPlayer.Position(), p.audioStream.SamplingFrequency())
+}
+
+// Position returns the current playback position by the master clock.
+func (p *Player) Position() time.Duration {
+	return p.clock.Position()
+}
+
+// newAudioPlayer returns an input of the shared mixer that plays audioStream.
+func newAudioPlayer(audioStream *audioStream, playbackRate float64) (audioOutput, *timeStretcher, error) {
+	m, err := sharedMixer(audioStream.SamplingFrequency(), audioStream.stream.options.AudioOutputInt16)
+	if err != nil {
+		return nil, nil, err
+	}
+	if audioStream.stream.options.LowLatency {
+		m.reduceBufferSize(lowLatencyMixerBufferSize)
+	}
+	src, stretcher := newAudioSource(audioStream, m.sampleRate, playbackRate)
+	return m.newInput(src), stretcher, nil
+}
+
+// newAudioSource returns the stereo float32 stream of audioStream at sampleRate, changed in speed by playbackRate.
+func newAudioSource(audioStream *audioStream, sampleRate int, playbackRate float64) (io.ReadSeeker, *timeStretcher) {
+	rate := audioStream.SamplingFrequency()
+	stretcher := newTimeStretcher(audioStream, rate, playbackRate)
+	var src io.ReadSeeker = stretcher
+	if sampleRate != rate {
+		src = newResampler(stretcher, rate, sampleRate, audioStream.resampleQuality)
+	}
+	return src, stretcher
+}
+
 func (p *Player) VideoSize() (int, int) {
 	return p.width, p.height
 }
@@ -120,10 +685,433 @@ func (p *Player) AudioCodecID() string {
 	return p.audioCodecID
 }
 
+// AudioTracks returns the audio tracks that can be switched to by SetAudioTrack.
+func (p *Player) AudioTracks() []TrackInfo {
+	if p.audioStream == nil {
+		return nil
+	}
+	var tracks []TrackInfo
+	for _, t := range p.audioSource.Meta().TrackEntry {
+		if !t.IsAudio() {
+			continue
+		}
+		tracks = append(tracks, TrackInfo{
+			Number:   t.TrackNumber,
+			Name:     t.Name,
+			Language: t.Language,
+			CodecID:  t.CodecID,
+		})
+	}
+	return tracks
+}
+
+// AudioTrack returns the number of the audio track being played, or 0 if there is no audio.
+func (p *Player) AudioTrack() uint {
+	if p.audioStream == nil {
+		return 0
+	}
+	return p.audioSource.AudioTrack().TrackNumber
+}
+
+// SetAudioTrack switches the audio track to the track of the number n at the current position.
+// The packets of the other audio tracks are kept for a while, so switching doesn't seek the input.
+func (p *Player) SetAudioTrack(n uint) error {
+	if p.closed {
+		return fmt.Errorf("webmplayer: the player is closed")
+	}
+	if p.stopped {
+		return fmt.Errorf("webmplayer: the player has stopped at the end")
+	}
+	if p.audioPlayer == nil {
+		return fmt.Errorf("webmplayer: no audio")
+	}
+	if _, ok := p.audioPlayer.(*playlistOutput); ok {
+		return fmt.Errorf("webmplayer: switching audio tracks is not supported in a playlist")
+	}
+	if n == p.AudioTrack() {
+		return nil
+	}
+
+	pos := p.audioPosition()
+	audioStream, commit, err := p.audioSource.switchAudioTrack(n, pos)
+	if err != nil {
+		return err
+	}
+	player, stretcher, err := newAudioPlayer(audioStream, p.rate)
+	if err != nil {
+		audioStream.close()
+		return err
+	}
+	// The decoder already starts at pos, so this doesn't seek the input.
+	if err := player.SetPosition(pos); err != nil {
+		_ = player.Close()
+		audioStream.close()
+		return err
+	}
+	commit()
+	player.fade(p.audioPlayer.volume(), 0)
+
+	if err := p.audioPlayer.Close(); err != nil {
+		return err
+	}
+	// The previous decoder is no longer read.
+	p.audioStream.close()
+	if !p.paused {
+		player.Play()
+	}
+	p.audioPlayer = player
+	p.audioStream = audioStream
+	p.stretcher = stretcher
+	p.audioCodecID = p.audioSource.AudioTrack().CodecID
+	p.avSync.reset()
+	return nil
+}
+
+// AppendSubtitles appends the cues of the subtitle track shown at the current position to dst, e.g. to draw them
+// after Draw. The cues are indexed as the input is read, so the cues ahead of the read position are not found yet.
+func (p *Player) AppendSubtitles(dst []SubtitleCue) []SubtitleCue {
+	for _, s := range []*stream{p.videoSource, p.audioSource} {
+		if s == nil || s.subtitles == nil {
+			continue
+		}
+		// With Loop, the cues are of a pass.
+		return s.subtitles.appendAt(dst, passTime(p.Position(), s.loop))
+	}
+	return dst
+}
+
+// SetPlaybackRate sets the speed of the playback. rate must be between 0.5 and 4.
+// The audio is time-stretched without changing the pitch, and the video frames that can't be in time are skipped.
+//
+// With PlayerOptions.Clock, the video follows the clock, and only the audio follows rate.
+func (p *Player) SetPlaybackRate(rate float64) error {
+	if rate < 0.5 || rate > 4 {
+		return fmt.Errorf("webmplayer: playback rate out of range: %v", rate)
+	}
+	p.rate = rate
+	p.avSync.reset()
+	if p.stretcher != nil {
+		p.stretcher.setRate(rate)
+	}
+	// A paused clock stays stopped until Resume.
+	if c, ok := p.clock.(clockSetter); ok && !p.paused {
+		c.setRate(rate)
+	}
+	return nil
+}
+
+// PlaybackRate returns the speed of the playback.
+func (p *Player) PlaybackRate() float64 {
+	return p.rate
+}
+
+// SetVolume sets the volume of the audio, where 1 is the original volume. SetVolume does nothing without audio.
+func (p *Player) SetVolume(volume float64) {
+	p.FadeVolume(volume, 0)
+}
+
+// FadeVolume changes the volume of the audio linearly to volume over d of the playback. The volume is applied to every
+// sample by the mixer, so a fade doesn't need to be updated every frame, and fades of Players started together stay
+// in sync, e.g. for a crossfade. A paused Player continues the fade when it is resumed.
+// FadeVolume does nothing without audio.
+func (p *Player) FadeVolume(volume float64, d time.Duration) {
+	if p.audioPlayer != nil {
+		p.audioPlayer.fade(volume*p.normalizationGain(), d)
+	}
+}
+
+// Volume returns the volume of the audio, or the volume being faded to. Volume returns 1 without audio.
+func (p *Player) Volume() float64 {
+	if p.audioPlayer == nil {
+		return 1
+	}
+	return p.audioPlayer.volume() / p.normalizationGain()
+}
+
+// Pause pauses the playback.
+// While paused, reading the input and decoding the video stop until Resume, so a paused Player uses no CPU time.
+// A position sought while paused is decoded after Resume.
+func (p *Player) Pause() {
+	if p.paused {
+		return
+	}
+	p.paused = true
+	if p.audioPlayer != nil {
+		p.audioPlayer.Pause()
+	}
+	for _, s := range p.streams() {
+		s.pause(true)
+	}
+	if c, ok := p.clock.(clockSetter); ok {
+		c.setRate(0)
+	}
+}
+
+// Resume resumes the playback paused by Pause.
+func (p *Player) Resume() {
+	if !p.paused {
+		return
+	}
+	if p.scrubbing {
+		_ = p.Seek(p.scrubTarget)
+	} else if p.videoStream != nil && p.videoStream.step.active {
+		// Play from the frame stepped to.
+		_ = p.Seek(p.videoStream.shownTimecode)
+	}
+	p.paused = false
+	for _, s := range p.streams() {
+		// A separate video input stays paused in the background.
+		s.pause(p.background && s == p.videoSource && s != p.audioSource)
+	}
+	if c, ok := p.clock.(clockSetter); ok {
+		c.setRate(p.rate)
+	}
+	if p.audioPlayer != nil {
+		p.audioPlayer.Play()
+	}
+	p.avSync.reset()
+}
+
+// IsPaused reports whether the playback is paused by Pause.
+func (p *Player) IsPaused() bool {
+	return p.paused
+}
+
+// prepare pauses the Player created with PlayerOptions.Prepare. Unlike Pause, the input is read and decoded until
+// the queues are full.
+func (p *Player) prepare() {
+	p.paused = true
+	if c, ok := p.clock.(clockSetter); ok {
+		c.setRate(0)
+	}
+	if p.audioStream != nil {
+		p.audioStream.prepare()
+	}
+}
+
+// Prepared reports whether the Player created with PlayerOptions.Prepare is ready to start: the first frame has
+// been drawn by Update, and the audio is buffered as Prepare describes. Update must be called for the first frame.
+func (p *Player) Prepared() bool {
+	if p.videoStream != nil && !p.videoStream.ready() {
+		return false
+	}
+	return p.audioStream == nil || p.audioStream.prepared()
+}
+
+// Close stops the playback, and releases the decoders, the images and the goroutines of the Player.
+// The decoders and the images are freed before Close returns. The inputs are not closed.
+// The Player must not be used after Close.
+//
+// If views of the Player are open, the Player keeps playing for them, and is released when the last view is closed.
+func (p *Player) Close() error {
+	if p.closed || p.released {
+		return nil
+	}
+	if p.views > 0 {
+		p.released = true
+		return nil
+	}
+	return p.close()
+}
+
+func (p *Player) close() error {
+	p.closed = true
+	if p.stopped {
+		if p.videoStream != nil && p.videoStream.last != nil {
+			p.videoStream.last.Deallocate()
+		}
+		return nil
+	}
+	var err error
+	if p.audioPlayer != nil {
+		// The audio player must not read the audio stream after the decoder is freed.
+		err = p.audioPlayer.Close()
+	}
+	for _, s := range p.streams() {
+		s.close()
+	}
+	return err
+}
+
+// streams returns the distinct streams of the Player, including all the renditions.
+func (p *Player) streams() []*stream {
+	var ss []*stream
+	add := func(s *stream) {
+		if s == nil {
+			return
+		}
+		for _, s2 := range ss {
+			if s2 == s {
+				return
+			}
+		}
+		ss = append(ss, s)
+	}
+	add(p.videoSource)
+	add(p.audioSource)
+	for _, r := range p.renditions {
+		add(r.stream)
+	}
+	return ss
+}
+
+// VideoFramesReady returns the number of the decoded video frames waiting to be presented, e.g. to see whether
+// PlayerOptions.DecodeBudget keeps the video ahead of the position.
+func (p *Player) VideoFramesReady() int {
+	if p.videoStream == nil {
+		return 0
+	}
+	return p.videoStream.frames.ready(p.videoSource.seek.Gen())
+}
+
+// AudioReadAhead returns how much audio the audio output has read ahead of the position. The audio output plays
+// silence when it catches up with the audio decoded. AudioReadAhead returns 0 without audio.
+func (p *Player) AudioReadAhead() time.Duration {
+	if p.audioStream == nil {
+		return 0
+	}
+	pulled := p.audioSource.audioPulled.Load()
+	if pulled == math.MaxInt64 {
+		// The audio has ended, and all of it has been read.
+		return 0
+	}
+	return max(time.Duration(pulled)-p.Position(), 0)
+}
+
+// SkippedVideoFrames returns the number of video frames that were skipped without being decoded
+// because the video was late.
+func (p *Player) SkippedVideoFrames() int {
+	if p.videoStream == nil {
+		return 0
+	}
+	return p.videoStream.SkippedFrames()
+}
+
 func (p *Player) Update() error {
-	if err := p.videoStream.Update(p.audioPlayer.Position()); err != nil {
+	return p.updateBy(&p.updated)
+}
+
+func (p *Player) update() error {
+	if p.closed || p.stopped {
+		return nil
+	}
+	p.updateVisibility()
+	if p.videoStream != nil && p.videoStream.step.active {
+		return p.updateStep()
+	}
+	pos := p.clock.Position()
+	p.updatedPos, p.updatedAt = pos, time.Now()
+	if p.videoStream != nil {
+		if len(p.renditions) > 0 {
+			if err := p.updateRendition(pos); err != nil {
+				return err
+			}
+		}
+		if err := p.videoStream.Update(pos); err != nil {
+			return err
+		}
+		p.updateScrub()
+	}
+	if err := p.updateAVSync(pos); err != nil {
 		return err
 	}
+	p.dumpStall()
+	if !p.finished && (p.audioPlayer == nil || p.audioPlayer.finished()) && (p.videoStream == nil || p.videoStream.finished()) {
+		if err := p.finish(); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// finish is called when the playback reaches the end.
+func (p *Player) finish() error {
+	p.finished = true
+	if p.done != nil {
+		close(p.done)
+	}
+	if p.audioPlayer != nil {
+		// Stop pulling the silence so that the audio device can be idle.
+		// A Playlist plays the next item after the item, so the item doesn't pause the Playlist.
+		if _, ok := p.audioPlayer.(*playlistOutput); !ok {
+			p.audioPlayer.Pause()
+		}
+	}
+	if !p.stopAtEnd {
+		return nil
+	}
+
+	p.stopped = true
+	var err error
+	if p.audioPlayer != nil {
+		err = p.audioPlayer.Close()
+	}
+	if p.videoStream != nil {
+		p.videoStream.keepFrame()
+	}
+	for _, s := range p.streams() {
+		s.close()
+	}
+	return err
+}
+
+// IsFinished reports whether the playback has reached the end of the audio and the video.
+// IsFinished is updated by Update. IsFinished becomes false again by Seek.
+func (p *Player) IsFinished() bool {
+	return p.finished
+}
+
+// Done returns a channel that is closed when the playback reaches the end, as detected by Update.
+// After Seek, Done returns a new channel for the next end.
+func (p *Player) Done() <-chan struct{} {
+	if p.done == nil {
+		p.done = make(chan struct{})
+		if p.finished {
+			close(p.done)
+		}
+	}
+	return p.done
+}
+
+// Seek moves the playback position to t.
+// The decoders restart at the keyframe cluster before t found by the Cues, and decode forward to t.
+func (p *Player) Seek(t time.Duration) error {
+	if p.closed {
+		return fmt.Errorf("webmplayer: the player is closed")
+	}
+	if p.stopped {
+		return fmt.Errorf("webmplayer: the player has stopped at the end")
+	}
+	if t < 0 {
+		return fmt.Errorf("webmplayer: negative position: %v", t)
+	}
+	// Stepping and scrubbing seek the video by themselves, which the audio player doesn't know.
+	stepped := p.videoStream != nil && p.videoStream.step.active
+	p.stopStep()
+	scrubbed := p.stopScrub()
+	if p.audioPlayer != nil {
+		// SetPosition flushes the audio player's buffer and seeks the audio stream.
+		if err := p.audioPlayer.SetPosition(t); err != nil {
+			return err
+		}
+		// The audio player stops at the end of the stream.
+		if !p.paused {
+			p.audioPlayer.Play()
+		}
+	}
+	if p.videoStream != nil && (p.audioPlayer == nil || p.videoSource != p.audioSource || stepped || scrubbed) {
+		p.videoSource.Seek(t)
+	}
+	if c, ok := p.clock.(clockSetter); ok {
+		c.set(t)
+	}
+	p.avSync.reset()
+	if p.finished {
+		p.finished = false
+		p.done = nil
+	}
+	// Cancel the switch of the rendition in progress.
+	p.pending = -1
 	return nil
 }
 
@@ -131,17 +1119,80 @@ type PlayerDrawOptions struct {
 	GeoM       ebiten.GeoM
 	ColorScale ebiten.ColorScale
 	Blend      ebiten.Blend
+
+	// Shader is the Kage source of an effect fused into the conversion of the frame to RGB, so that the effect costs
+	// no pass of its own. Shader declares the function
+	//
+	//	func Effect(color vec4, pos vec2) vec4
+	//
+	// which returns the color of the pixel at pos in the frame whose converted color is color, and can declare the
+	// uniform variables and the functions it uses. Shader has neither the package clause nor the directives, and must
+	// not declare the names of the conversion: Fragment, planeAt, alphaAt, ChromaOrigin, CrOffset, AlphaOrigin and the
+	// capitalized constants.
+	//
+	// The fused pass draws the pixels of the frame as they are without filtering. Shader is ignored, and the frame is
+	// drawn without the effect, if the frame is not drawn as YCbCr, e.g. for RGBA frames and OnVideoFrame.
+	// A compile error of Shader is returned by Update.
+	Shader []byte
+
+	// Uniforms is the uniform variables of Shader.
+	Uniforms map[string]any
 }
 
 func (p *Player) Draw(screen *ebiten.Image, options *PlayerDrawOptions) {
-	if p.videoStream == nil {
+	if p.videoStream == nil || p.closed {
 		return
 	}
-	p.videoStream.Draw(func(image *ebiten.Image) {
+	if p.hiddenAfter > 0 {
+		p.drawn = time.Now()
+	}
+	p.presentOnDraw()
+	p.draw(screen, options)
+}
+
+// presentOnDraw presents the frame due when the frame drawn now is on screen. The time is predicted from the position
+// of the latest update, the time since then, and the interval of the display refreshes until the drawn frame is
+// shown, so that the frames follow the refreshes rather than the ticks, e.g. for 24 FPS videos on 60 Hz displays.
+func (p *Player) presentOnDraw() {
+	v := p.videoStream
+	if p.paused || p.stopped || p.scrubbing || p.updatedAt.IsZero() || v.step.active || v.onFrame != nil {
+		return
+	}
+	lead := time.Since(p.updatedAt) + displayInterval()
+	lead = time.Duration(float64(lead) * p.rate)
+	// A frame is not presented earlier than a late frame would be presented.
+	v.present(p.updatedPos, min(lead, v.lateThreshold()))
+}
+
+// displayInterval returns the predicted interval of the display refreshes.
+func displayInterval() time.Duration {
+	fps := ebiten.ActualFPS()
+	if fps <= 0 {
+		fps = float64(ebiten.TPS())
+	}
+	if fps <= 0 {
+		fps = 60
+	}
+	return time.Duration(float64(time.Second) / fps)
+}
+
+// draw draws the current frame to screen.
+func (p *Player) draw(screen *ebiten.Image, options *PlayerDrawOptions) {
+	v := p.videoStream
+	if options != nil && len(options.Shader) > 0 && v.planar.ok {
+		var geoM ebiten.GeoM
+		p.scaleFrame(&geoM, v.planar.w, v.planar.h)
+		geoM.Concat(options.GeoM)
+		if v.drawEffect(screen, &geoM, options) {
+			return
+		}
+	}
+	v.Draw(func(image *ebiten.Image) {
 		op := &ebiten.DrawImageOptions{}
 		op.Filter = ebiten.FilterLinear
+		p.scaleFrame(&op.GeoM, image.Bounds().Dx(), image.Bounds().Dy())
 		if options != nil {
-			op.GeoM = options.GeoM
+			op.GeoM.Concat(options.GeoM)
 			op.ColorScale = options.ColorScale
 			op.Blend = options.Blend
 		}
@@ -149,27 +1200,67 @@ func (p *Player) Draw(screen *ebiten.Image, options *PlayerDrawOptions) {
 	})
 }
 
+// scaleFrame scales geoM from a frame of w x h to the video size. A rendition of NewPlayerWithRenditions or a
+// downscaled frame might be smaller than the video size.
+func (p *Player) scaleFrame(geoM *ebiten.GeoM, w, h int) {
+	if w > 0 && h > 0 && (w != p.width || h != p.height) {
+		geoM.Scale(float64(p.width)/float64(w), float64(p.height)/float64(h))
+	}
+}
+
+// newStreams parses the inputs concurrently.
+func newStreams(options *PlayerOptions, streams []io.ReadSeeker) ([]*stream, []error) {
+	parsed := make([]*stream, len(streams))
+	errs := make([]error, len(streams))
+	var wg sync.WaitGroup
+	for i, r := range streams {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			parsed[i], errs[i] = newStream(r, options, true)
+		}()
+	}
+	wg.Wait()
+	return parsed, errs
+}
+
 // discoverStreams returns both Video and Audio streams if in separate inputs,
 // otherwise only the first stream would be returned (Video / Audio / Video + Audio).
-func discoverStreams(streams ...io.ReadSeeker) (*stream, *stream, error) {
+func discoverStreams(options *PlayerOptions, streams ...io.ReadSeeker) (*stream, *stream, error) {
 	if len(streams) == 0 {
 		return nil, nil, fmt.Errorf("webmplayer: no streams found")
 	}
 
-	if len(streams) == 1 {
-		stream, err := newStream(streams[0])
-		if err != nil {
-			return nil, nil, err
+	// At most one video input and one audio input are used.
+	if len(streams) > 2 {
+		streams = streams[:2]
+	}
+
+	// Probe the inputs concurrently and pick the tracks after all the probes finish,
+	// so that the startup waits only for the slowest input.
+	parsed, errs := newStreams(options, streams)
+	stream1, stream2, err := pickStreams(parsed, errs)
+	// The parsed streams that are not used are closed, so that their goroutines and decoders don't leak.
+	for _, s := range parsed {
+		if s != nil && s != stream1 && s != stream2 {
+			s.close()
 		}
-		return stream, nil, nil
+	}
+	return stream1, stream2, err
+}
+
+// pickStreams picks the video and the audio streams of discoverStreams from the parsed inputs.
+func pickStreams(parsed []*stream, errs []error) (*stream, *stream, error) {
+	if errs[0] != nil {
+		return nil, nil, errs[0]
+	}
+	stream1 := parsed[0]
+	if len(parsed) == 1 {
+		return stream1, nil, nil
 	}
 
 	var stream1Video bool
 	var stream1Audio bool
-	stream1, err := newStream(streams[0])
-	if err != nil {
-		return nil, nil, err
-	}
 	stream1Video = stream1.Meta().FindFirstVideoTrack() != nil
 	stream1Audio = stream1.Meta().FindFirstAudioTrack() != nil
 	if stream1Video && stream1Audio {
@@ -177,12 +1268,13 @@ func discoverStreams(streams ...io.ReadSeeker) (*stream, *stream, error) {
 		return stream1, nil, nil
 	}
 
+	// The second input matters only when the first one lacks a track.
+	if errs[1] != nil {
+		return nil, nil, errs[1]
+	}
+	stream2 := parsed[1]
 	var stream2Video bool
 	var stream2Audio bool
-	stream2, err := newStream(streams[1])
-	if err != nil {
-		return nil, nil, err
-	}
 	stream2Video = stream2.Meta().FindFirstVideoTrack() != nil
 	stream2Audio = stream2.Meta().FindFirstAudioTrack() != nil
 
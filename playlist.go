@@ -0,0 +1,587 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/hajimehoshi/ebiten/v2"
+)
+
+// playlistSampleRate is the sample rate of the audio context that a Playlist creates if there is no context yet.
+const playlistSampleRate = 48000
+
+// Playlist plays WebM inputs one after another without a gap.
+//
+// While an item plays, the next item is opened, and its packets are read and its first video frames are decoded in
+// advance. The audio of the items is played as one continuous stream, so the next item starts at the sample right
+// after the last sample of the previous item, and the video switches to the next item at the same position.
+//
+// The Players of the items share their decoders with PlayerOptions.Pool. If the options have no pool, the Playlist
+// uses its own pool.
+type Playlist struct {
+	options PlayerOptions
+	ownPool bool
+
+	// player is the input of the shared mixer that plays source.
+	source *playlistSource
+	player audioOutput
+
+	// items is the inputs not opened yet, and taken is the number of the items taken from items.
+	items [][]io.ReadSeeker
+	taken int
+
+	current *playlistItem
+	next    *playlistItem
+
+	// opened receives the item being opened while opening is true.
+	opening bool
+	opened  chan playlistResult
+
+	rate   float64
+	paused bool
+}
+
+type playlistItem struct {
+	player *Player
+	entry  *playlistEntry
+
+	// index is the index of the item in the appended items.
+	index int
+
+	// output is the audio output of the item, or nil if the item has no audio.
+	output *playlistOutput
+}
+
+type playlistResult struct {
+	item *playlistItem
+	err  error
+}
+
+// NewPlaylist creates an empty Playlist. Append adds items to the Playlist.
+//
+// The options are used for all the items.
+func NewPlaylist(options *PlayerOptions) (*Playlist, error) {
+	l := &Playlist{
+		opened: make(chan playlistResult, 1),
+		rate:   1,
+	}
+	if options != nil {
+		l.options = *options
+	}
+	if l.options.Pool == nil {
+		l.options.Pool = NewPlayerPool()
+		l.ownPool = true
+	}
+
+	m, err := sharedMixer(playlistSampleRate, l.options.AudioOutputInt16)
+	if err != nil {
+		return nil, err
+	}
+	l.source = &playlistSource{
+		sampleRate: m.sampleRate,
+	}
+	l.player = m.newInput(l.source)
+	return l, nil
+}
+
+// Append adds an item to the end of the Playlist.
+// An item is one or two inputs, as NewPlayerWithOptions takes.
+func (l *Playlist) Append(streams ...io.ReadSeeker) {
+	l.items = append(l.items, streams)
+}
+
+// Current returns the Player of the item being played, or nil if no item is being played.
+// The Player must not be closed. It is closed when the next item starts.
+func (l *Playlist) Current() *Player {
+	if l.current == nil {
+		return nil
+	}
+	return l.current.player
+}
+
+// Index returns the index of the item being played in the appended items, or -1 if no item is being played.
+func (l *Playlist) Index() int {
+	if l.current == nil {
+		return -1
+	}
+	return l.current.index
+}
+
+// Update updates the item being played, and switches to the next item at the end of the item.
+// If an item fails to be opened, Update returns the error, and the item is skipped.
+func (l *Playlist) Update() error {
+	if l.opening {
+		select {
+		case r := <-l.opened:
+			l.opening = false
+			l.source.setWaiting(false)
+			if r.err != nil {
+				return r.err
+			}
+			l.add(r.item)
+		default:
+		}
+	}
+
+	if !l.opening && l.next == nil && len(l.items) > 0 {
+		streams := l.items[0]
+		l.items[0] = nil
+		l.items = l.items[1:]
+		index := l.taken
+		l.taken++
+		l.opening = true
+		// Play silence if the current item ends before the next item is ready, instead of ending the audio.
+		l.source.setWaiting(true)
+		go func() {
+			item, err := l.open(streams, index)
+			l.opened <- playlistResult{item: item, err: err}
+		}()
+	}
+
+	if l.next != nil {
+		if start, ok := l.source.startOf(l.next.entry); ok && l.player.Position() >= start {
+			next := l.next
+			l.next = nil
+			if err := l.activate(next); err != nil {
+				return err
+			}
+		}
+	}
+
+	if l.current == nil {
+		return nil
+	}
+	return l.current.player.Update()
+}
+
+// open opens an item. open is called on another goroutine than the game's.
+func (l *Playlist) open(streams []io.ReadSeeker, index int) (*playlistItem, error) {
+	item := &playlistItem{
+		entry: &playlistEntry{start: -1, end: -1},
+		index: index,
+	}
+	p, err := newPlayer(&l.options, func(audioStream *audioStream, rate float64) (audioOutput, *timeStretcher, error) {
+		src, stretcher := newAudioSource(audioStream, l.source.sampleRate, rate)
+		item.entry.src = src
+		item.output = &playlistOutput{
+			l:     l,
+			entry: item.entry,
+		}
+		return item.output, stretcher, nil
+	}, nil, streams...)
+	if err != nil {
+		return nil, err
+	}
+	if p.audioStream == nil {
+		// The item is silent for its duration in the audio stream, which the video follows.
+		d := p.VideoDuration()
+		if d <= 0 {
+			_ = p.Close()
+			return nil, fmt.Errorf("webmplayer: a playlist item without audio must have its duration")
+		}
+		item.entry.src = &silence{
+			size: int64(d) * int64(l.source.sampleRate) / int64(time.Second) * bytesPerFrame,
+		}
+		p.clock = &playlistClock{
+			l:     l,
+			entry: item.entry,
+		}
+	}
+	item.player = p
+	return item, nil
+}
+
+// add adds the opened item after the current item.
+func (l *Playlist) add(item *playlistItem) {
+	// l.rate is always valid.
+	_ = item.player.SetPlaybackRate(l.rate)
+	l.source.add(item.entry)
+	if l.current == nil {
+		_ = l.activate(item)
+	} else {
+		l.next = item
+	}
+	// The audio player stops when the audio stream ends, e.g. if the item is appended after the end.
+	if !l.paused {
+		l.player.Play()
+	}
+}
+
+// activate makes item the current item, and closes the previous item.
+func (l *Playlist) activate(item *playlistItem) error {
+	prev := l.current
+	l.current = item
+	if item.output != nil {
+		item.output.active.Store(true)
+	}
+	if l.paused {
+		item.player.Pause()
+	}
+	if prev != nil {
+		return prev.player.Close()
+	}
+	return nil
+}
+
+// Draw draws the video of the current item.
+func (l *Playlist) Draw(screen *ebiten.Image, options *PlayerDrawOptions) {
+	if l.current == nil {
+		return
+	}
+	l.current.player.Draw(screen, options)
+}
+
+// Pause pauses the playback.
+func (l *Playlist) Pause() {
+	if l.paused {
+		return
+	}
+	l.paused = true
+	l.player.Pause()
+	if l.current != nil {
+		l.current.player.Pause()
+	}
+}
+
+// Resume resumes the playback paused by Pause.
+func (l *Playlist) Resume() {
+	if !l.paused {
+		return
+	}
+	l.paused = false
+	if l.current != nil {
+		l.current.player.Resume()
+	}
+	l.player.Play()
+}
+
+// SetPlaybackRate sets the speed of the playback for all the items. rate must be between 0.5 and 4.
+func (l *Playlist) SetPlaybackRate(rate float64) error {
+	for _, item := range []*playlistItem{l.current, l.next} {
+		if item == nil {
+			continue
+		}
+		if err := item.player.SetPlaybackRate(rate); err != nil {
+			return err
+		}
+	}
+	l.rate = rate
+	return nil
+}
+
+// SetVolume sets the volume of the audio of all the items, where 1 is the original volume.
+func (l *Playlist) SetVolume(volume float64) {
+	l.FadeVolume(volume, 0)
+}
+
+// FadeVolume changes the volume of the audio of all the items linearly to volume over d of the playback, as
+// Player.FadeVolume does. A fade continues across the items.
+func (l *Playlist) FadeVolume(volume float64, d time.Duration) {
+	l.player.fade(volume, d)
+}
+
+// Close stops the playback, and closes the Players of the items.
+// The decoders are freed unless PlayerOptions.Pool is given.
+func (l *Playlist) Close() error {
+	err := l.player.Close()
+	if l.opening {
+		if r := <-l.opened; r.item != nil {
+			l.next = r.item
+		}
+		l.opening = false
+	}
+	for _, item := range []*playlistItem{l.current, l.next} {
+		if item == nil {
+			continue
+		}
+		if err2 := item.player.Close(); err == nil {
+			err = err2
+		}
+	}
+	l.current = nil
+	l.next = nil
+	if l.ownPool {
+		l.options.Pool.Close()
+	}
+	return err
+}
+
+// entryPosition returns the position in the entry e by the audio player.
+func (l *Playlist) entryPosition(e *playlistEntry) time.Duration {
+	start, ok := l.source.startOf(e)
+	if !ok {
+		return 0
+	}
+	return max(l.player.Position()-start, 0)
+}
+
+// seekEntry moves the audio player to t in the entry e.
+func (l *Playlist) seekEntry(e *playlistEntry, t time.Duration) error {
+	start, ok := l.source.startOf(e)
+	if !ok {
+		return fmt.Errorf("webmplayer: the playlist item has not started")
+	}
+	return l.player.SetPosition(start + t)
+}
+
+// playlistOutput is the audio output of a Player in a Playlist, which is a part of the Playlist's audio stream.
+type playlistOutput struct {
+	l     *Playlist
+	entry *playlistEntry
+
+	// active is true when the item is the current item. Only the current item controls the audio player.
+	active atomic.Bool
+}
+
+func (o *playlistOutput) Play() {
+	if o.active.Load() {
+		o.l.player.Play()
+	}
+}
+
+func (o *playlistOutput) Pause() {
+	if o.active.Load() {
+		o.l.player.Pause()
+	}
+}
+
+func (o *playlistOutput) Position() time.Duration {
+	return o.l.entryPosition(o.entry)
+}
+
+func (o *playlistOutput) SetPosition(t time.Duration) error {
+	return o.l.seekEntry(o.entry, t)
+}
+
+// finished reports whether all the audio of the entry has been played.
+func (o *playlistOutput) finished() bool {
+	end, ok := o.l.source.endOf(o.entry)
+	return ok && o.l.player.Position() >= end
+}
+
+// fade changes the volume of the Playlist if the item is the current item.
+func (o *playlistOutput) fade(volume float64, d time.Duration) {
+	if o.active.Load() {
+		o.l.player.fade(volume, d)
+	}
+}
+
+func (o *playlistOutput) volume() float64 {
+	return o.l.player.volume()
+}
+
+// Close removes the entry from the audio stream. The entry is not read after Close returns.
+func (o *playlistOutput) Close() error {
+	o.l.source.remove(o.entry)
+	return nil
+}
+
+// playlistClock is the clock of an item without audio, which follows the silence of the item in the audio stream.
+type playlistClock struct {
+	l     *Playlist
+	entry *playlistEntry
+}
+
+func (c *playlistClock) Position() time.Duration {
+	return c.l.entryPosition(c.entry)
+}
+
+func (c *playlistClock) set(t time.Duration) {
+	_ = c.l.seekEntry(c.entry, t)
+}
+
+// setRate does nothing, as the clock follows the audio player, which the Playlist controls.
+func (c *playlistClock) setRate(rate float64) {
+}
+
+// playlistSource is the continuous audio stream of a Playlist, which concatenates the audio of the items.
+type playlistSource struct {
+	sampleRate int
+
+	m       sync.Mutex
+	entries []*playlistEntry
+
+	// cur is the index of the entry being read, and pos is the position in bytes of the whole stream.
+	cur int
+	pos int64
+
+	// waiting is true when the next entry is being opened. Then the source plays silence after the last entry.
+	waiting bool
+}
+
+// playlistEntry is the audio of an item in a playlistSource.
+type playlistEntry struct {
+	src io.ReadSeeker
+
+	// start is the position of the entry in the whole stream in bytes, or -1 before the entry is reached.
+	// end is the position after the last sample of the entry in bytes, or -1 before the entry ends.
+	start int64
+	end   int64
+}
+
+func (s *playlistSource) Read(buf []byte) (int, error) {
+	s.m.Lock()
+	defer s.m.Unlock()
+
+	buf = buf[:len(buf)/bytesPerFrame*bytesPerFrame]
+	for {
+		if s.cur >= len(s.entries) {
+			if !s.waiting {
+				return 0, io.EOF
+			}
+			n := min(len(buf), 4096)
+			clear(buf[:n])
+			s.pos += int64(n)
+			return n, nil
+		}
+		e := s.entries[s.cur]
+		if e.start < 0 {
+			e.start = s.pos
+		}
+		n, err := e.src.Read(buf)
+		s.pos += int64(n)
+		if err == io.EOF {
+			// The next entry starts at the next read, right after the last sample of this entry.
+			e.end = s.pos
+			s.cur++
+			if n > 0 {
+				return n, nil
+			}
+			continue
+		}
+		return n, err
+	}
+}
+
+// Seek implements io.Seeker. Seek moves the position to an entry that has been reached.
+func (s *playlistSource) Seek(offset int64, whence int) (int64, error) {
+	s.m.Lock()
+	defer s.m.Unlock()
+
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += s.pos
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	offset = offset / bytesPerFrame * bytesPerFrame
+
+	last := min(s.cur, len(s.entries)-1)
+	i := -1
+	for j := 0; j <= last; j++ {
+		if e := s.entries[j]; e.start >= 0 && e.start <= offset {
+			i = j
+		}
+	}
+	if i < 0 {
+		return 0, fmt.Errorf("webmplayer: position %d is out of the playlist items", offset)
+	}
+	// The entries after i start from their beginnings when they are reached again.
+	for _, e := range s.entries[i+1 : last+1] {
+		if e.start < 0 {
+			continue
+		}
+		if _, err := e.src.Seek(0, io.SeekStart); err != nil {
+			return 0, err
+		}
+		e.start = -1
+		e.end = -1
+	}
+	e := s.entries[i]
+	if _, err := e.src.Seek(offset-e.start, io.SeekStart); err != nil {
+		return 0, err
+	}
+	e.end = -1
+	s.cur = i
+	s.pos = offset
+	return offset, nil
+}
+
+func (s *playlistSource) add(e *playlistEntry) {
+	s.m.Lock()
+	defer s.m.Unlock()
+	s.entries = append(s.entries, e)
+}
+
+func (s *playlistSource) remove(e *playlistEntry) {
+	s.m.Lock()
+	defer s.m.Unlock()
+	for i, e2 := range s.entries {
+		if e2 != e {
+			continue
+		}
+		s.entries = append(s.entries[:i], s.entries[i+1:]...)
+		if i < s.cur {
+			s.cur--
+		}
+		return
+	}
+}
+
+func (s *playlistSource) setWaiting(waiting bool) {
+	s.m.Lock()
+	defer s.m.Unlock()
+	s.waiting = waiting
+}
+
+// startOf returns the position where the entry e starts, or false if e has not been reached.
+func (s *playlistSource) startOf(e *playlistEntry) (time.Duration, bool) {
+	s.m.Lock()
+	defer s.m.Unlock()
+	if e.start < 0 {
+		return 0, false
+	}
+	return time.Duration(e.start/bytesPerFrame) * time.Second / time.Duration(s.sampleRate), true
+}
+
+// endOf returns the position where the entry e ends, or false if e has not ended.
+func (s *playlistSource) endOf(e *playlistEntry) (time.Duration, bool) {
+	s.m.Lock()
+	defer s.m.Unlock()
+	if e.end < 0 {
+		return 0, false
+	}
+	return time.Duration(e.end/bytesPerFrame) * time.Second / time.Duration(s.sampleRate), true
+}
+
+// silence is a silent stereo float32 stream of size bytes.
+type silence struct {
+	size int64
+	pos  int64
+}
+
+func (s *silence) Read(buf []byte) (int, error) {
+	n := int(min(int64(len(buf)/bytesPerFrame*bytesPerFrame), s.size-s.pos))
+	if n <= 0 {
+		return 0, io.EOF
+	}
+	clear(buf[:n])
+	s.pos += int64(n)
+	return n, nil
+}
+
+func (s *silence) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += s.pos
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	s.pos = offset
+	return offset, nil
+}
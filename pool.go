@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"sync"
+
+	"github.com/hajimehoshi/ebiten/v2"
+)
+
+// maxPooledDecoders is the maximum number of idle decoders of the same parameters kept in a PlayerPool.
+const maxPooledDecoders = 4
+
+// PlayerPool keeps the decoders of closed Players so that new Players with the same codec parameters reuse them,
+// e.g. for a playlist of short clips.
+//
+// Set PlayerOptions.Pool to use a PlayerPool. Close of the Player returns its decoders to the pool instead of
+// freeing them. A video decoder is reused with its frame buffers and textures for the same codec and thread count.
+// A Vorbis decoder is reused for the same headers, without parsing the codebooks again.
+// An Opus decoder is reused for the same channel layout and decoded rate.
+//
+// A PlayerPool is safe for concurrent use.
+type PlayerPool struct {
+	mu     sync.Mutex
+	videos map[videoDecoderKey][]*pooledVideo
+	vorbis map[string][]*pooledVorbis
+	opus   map[string][]opusDecoder
+	closed bool
+}
+
+type videoDecoderKey struct {
+	codec   videoCodec
+	threads int
+
+	// hardware reports whether the decoder is a hardwareDecoder.
+	hardware bool
+}
+
+// pooledVideo is the state of a videoStream that doesn't depend on the input.
+type pooledVideo struct {
+	decoder   videoDecoder
+	frames    []videoFrame
+	offscreen *ebiten.Image
+	planes    *ebiten.Image
+	planesPix []byte
+}
+
+// NewPlayerPool creates an empty PlayerPool.
+func NewPlayerPool() *PlayerPool {
+	return &PlayerPool{
+		videos: map[videoDecoderKey][]*pooledVideo{},
+		vorbis: map[string][]*pooledVorbis{},
+		opus:   map[string][]opusDecoder{},
+	}
+}
+
+// Close frees the idle decoders. The decoders returned to the pool after Close are freed immediately.
+func (p *PlayerPool) Close() {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	p.closed = true
+	for _, vs := range p.videos {
+		for _, v := range vs {
+			v.free()
+		}
+	}
+	for _, vs := range p.vorbis {
+		for _, v := range vs {
+			v.free()
+		}
+	}
+	for _, ds := range p.opus {
+		for _, d := range ds {
+			d.Destroy()
+		}
+	}
+	clear(p.videos)
+	clear(p.vorbis)
+	clear(p.opus)
+}
+
+// takeVideo returns an idle video decoder for key, or nil if there is none. p can be nil.
+func (p *PlayerPool) takeVideo(key videoDecoderKey) *pooledVideo {
+	if p == nil {
+		return nil
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return take(p.videos, key)
+}
+
+// putVideo returns v to the pool. putVideo frees v if p is nil, closed or full.
+func (p *PlayerPool) putVideo(key videoDecoderKey, v *pooledVideo) {
+	if p == nil {
+		v.free()
+		return
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed || len(p.videos[key]) >= maxPooledDecoders {
+		v.free()
+		return
+	}
+	p.videos[key] = append(p.videos[key], v)
+}
+
+// takeVorbis returns an idle Vorbis decoder for the codec private data, or nil if there is none. p can be nil.
+func (p *PlayerPool) takeVorbis(codecPrivate string) *pooledVorbis {
+	if p == nil {
+		return nil
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return take(p.vorbis, codecPrivate)
+}
+
+// putVorbis returns v to the pool. putVorbis frees v if p is nil, closed or full, or if v can't be restarted.
+func (p *PlayerPool) putVorbis(codecPrivate string, v *pooledVorbis) {
+	if p == nil || v.restart() != nil {
+		v.free()
+		return
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed || len(p.vorbis[codecPrivate]) >= maxPooledDecoders {
+		v.free()
+		return
+	}
+	p.vorbis[codecPrivate] = append(p.vorbis[codecPrivate], v)
+}
+
+// takeOpus returns an idle Opus decoder for key made by opusDecoderKey, or nil if there is none. p can be nil.
+func (p *PlayerPool) takeOpus(key string) opusDecoder {
+	if p == nil {
+		return nil
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	return take(p.opus, key)
+}
+
+// putOpus returns d to the pool. putOpus frees d if p is nil, closed or full, or if d can't be reset.
+func (p *PlayerPool) putOpus(key string, d opusDecoder) {
+	if p == nil || d.ResetState() != nil {
+		d.Destroy()
+		return
+	}
+	p.mu.Lock()
+	defer p.mu.Unlock()
+	if p.closed || len(p.opus[key]) >= maxPooledDecoders {
+		d.Destroy()
+		return
+	}
+	p.opus[key] = append(p.opus[key], d)
+}
+
+// take removes the last value for key from m, or returns the zero value if there is none.
+func take[K comparable, V any](m map[K][]V, key K) V {
+	vs := m[key]
+	var zero V
+	if len(vs) == 0 {
+		return zero
+	}
+	v := vs[len(vs)-1]
+	vs[len(vs)-1] = zero
+	m[key] = vs[:len(vs)-1]
+	return v
+}
+
+// opusDecoderKey returns the key of the decoders that can decode the stream of head at the rate samplingFrequency, with
+// the streams decoded in parallel or not.
+func opusDecoderKey(head *opusHead, samplingFrequency int, parallel bool) string {
+	return fmt.Sprintf("%d:%d:%d:%d:%d:%x:%x:%t", samplingFrequency, head.mappingFamily, head.channels, head.streamCount, head.coupledCount, head.channelMapping, head.demixingMatrix, parallel)
+}
+
+func (v *pooledVideo) free() {
+	v.decoder.destroy()
+	for _, img := range []*ebiten.Image{v.offscreen, v.planes} {
+		if img != nil {
+			deallocateVideoImage(img)
+		}
+	}
+}
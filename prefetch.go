@@ -0,0 +1,457 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"sync"
+)
+
+const (
+	// prefetchBlockSize is the size of a range read. Reads are aligned to prefetchBlockSize.
+	prefetchBlockSize = 256 * 1024
+
+	// prefetchCacheBlocks is the maximum number of blocks cached by a reader of NewPrefetchReader.
+	prefetchCacheBlocks = 64
+
+	// sharedPrefetchCacheBlocks is the default maximum number of blocks of the shared cache, 64 MiB.
+	sharedPrefetchCacheBlocks = 256
+
+	// prefetchAheadBlocks is the number of blocks read ahead of the reading position.
+	prefetchAheadBlocks = 8
+
+	// prefetchConcurrency is the maximum number of concurrent range reads.
+	prefetchConcurrency = 4
+)
+
+// prefetchBuffers is the pool of the data of the evicted blocks, so that reading a stream doesn't allocate a block for
+// every prefetchBlockSize bytes.
+var prefetchBuffers = sync.Pool{
+	New: func() any {
+		b := make([]byte, prefetchBlockSize)
+		return &b
+	},
+}
+
+// sharedPrefetchCache is the block cache of the readers of NewSharedPrefetchReader in the process.
+var sharedPrefetchCache = newPrefetchCache(sharedPrefetchCacheBlocks)
+
+// NewPrefetchReader returns an io.ReadSeeker to be passed to NewPlayer, which reads r with concurrent range reads
+// ahead of the reading position and caches them in a fixed-size block cache.
+// NewPrefetchReader is useful when each read of r is a round trip, e.g. HTTP range requests or object storage.
+//
+// When the Player seeks, the blocks of the target cluster are fetched from the Cues before the demuxer asks for them.
+//
+// r must be safe for concurrent ReadAt calls. size is the size of the whole stream.
+func NewPrefetchReader(r io.ReaderAt, size int64) io.ReadSeeker {
+	return newPrefetchReader(r, size, newPrefetchCache(prefetchCacheBlocks), "")
+}
+
+// NewSharedPrefetchReader is like NewPrefetchReader, but caches the blocks in a cache shared by the process, so that
+// the readers of the same stream, e.g. the Players of synced tiles, read each block of it only once. A block being
+// read for a reader is not read again for another reader, which waits for the same read instead.
+//
+// key identifies the content of the stream, e.g. its URL and its ETag. The readers with the same key must read the
+// same bytes of the same size.
+func NewSharedPrefetchReader(r io.ReaderAt, size int64, key string) io.ReadSeeker {
+	return newPrefetchReader(r, size, sharedPrefetchCache, key)
+}
+
+// SetSharedPrefetchCacheSize sets the maximum size in bytes of the cache of NewSharedPrefetchReader. The size is
+// rounded up to the block size of 256 KiB. The default is 64 MiB.
+func SetSharedPrefetchCacheSize(size int64) {
+	sharedPrefetchCache.setCapacity(int((size + prefetchBlockSize - 1) / prefetchBlockSize))
+}
+
+func newPrefetchReader(r io.ReaderAt, size int64, cache *prefetchCache, key string) *prefetchReader {
+	return &prefetchReader{
+		r:     r,
+		size:  size,
+		cache: cache,
+		key:   key,
+		sem:   make(chan struct{}, prefetchConcurrency),
+		ahead: -1,
+	}
+}
+
+type prefetchReader struct {
+	r    io.ReaderAt
+	size int64
+
+	// pos is the reading position, and ahead is the block that the last read-ahead started from.
+	// pos and ahead are used only by Read and Seek.
+	pos   int64
+	ahead int64
+
+	// cache is the cache of the blocks, and key is the key of the stream in it.
+	cache *prefetchCache
+	key   string
+
+	sem chan struct{}
+}
+
+// prefetchCache is an LRU cache of the blocks of the streams of one or more readers.
+type prefetchCache struct {
+	mu       sync.Mutex
+	blocks   map[prefetchKey]*prefetchBlock
+	clock    uint64
+	capacity int
+}
+
+// prefetchKey is the key of a block: the stream's key and the block's index in the stream.
+type prefetchKey struct {
+	stream string
+	idx    int64
+}
+
+type prefetchBlock struct {
+	data []byte
+	err  error
+	done chan struct{}
+
+	// used is the clock when the block was last requested, for the LRU eviction.
+	used uint64
+
+	// refs is the number of the reads copying from data, and removed is true when the block is no longer in the
+	// cache. data is returned to prefetchBuffers when both allow. refs and removed are protected by the mutex of the
+	// cache.
+	refs    int
+	removed bool
+	buf     *[]byte
+}
+
+func newPrefetchCache(capacity int) *prefetchCache {
+	return &prefetchCache{
+		blocks:   map[prefetchKey]*prefetchBlock{},
+		capacity: capacity,
+	}
+}
+
+func (c *prefetchCache) setCapacity(capacity int) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	c.capacity = max(capacity, 1)
+	for len(c.blocks) > c.capacity {
+		if !c.evict() {
+			break
+		}
+	}
+}
+
+func (p *prefetchReader) Read(buf []byte) (int, error) {
+	if idx := p.pos / prefetchBlockSize; idx != p.ahead && p.pos < p.size {
+		p.prefetch(idx)
+		p.ahead = idx
+	}
+	n, err := p.readBlock(buf, p.pos)
+	p.pos += int64(n)
+	return n, err
+}
+
+// readBlock reads from the block at off. readBlock doesn't read over the end of the block.
+func (p *prefetchReader) readBlock(buf []byte, off int64) (int, error) {
+	if off >= p.size {
+		return 0, io.EOF
+	}
+	if len(buf) == 0 {
+		return 0, nil
+	}
+	idx := off / prefetchBlockSize
+	b := p.block(idx, true)
+	defer p.cache.unref(b)
+	<-b.done
+	if b.err != nil {
+		p.cache.drop(prefetchKey{p.key, idx}, b)
+		return 0, b.err
+	}
+	o := int(off - idx*prefetchBlockSize)
+	if o >= len(b.data) {
+		return 0, io.ErrUnexpectedEOF
+	}
+	return copy(buf, b.data[o:]), nil
+}
+
+func (p *prefetchReader) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += p.pos
+	case io.SeekEnd:
+		offset += p.size
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	p.pos = offset
+	return offset, nil
+}
+
+// prefetchAt starts fetching the blocks from the offset, e.g. the position of the cluster to be read next.
+func (p *prefetchReader) prefetchAt(offset int64) {
+	if offset < 0 || offset >= p.size {
+		return
+	}
+	p.prefetch(offset / prefetchBlockSize)
+}
+
+// prefetch starts fetching the blocks from idx to idx+prefetchAheadBlocks.
+func (p *prefetchReader) prefetch(idx int64) {
+	last := min(idx+prefetchAheadBlocks, (p.size-1)/prefetchBlockSize)
+	for i := idx; i <= last; i++ {
+		p.block(i, false)
+	}
+}
+
+// block returns the block at idx, and starts fetching it with p if the block is neither cached nor being fetched.
+// If ref is true, the block's data is kept until unref is called, even after the block is evicted.
+func (p *prefetchReader) block(idx int64, ref bool) *prefetchBlock {
+	c := p.cache
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	key := prefetchKey{p.key, idx}
+	c.clock++
+	if b, ok := c.blocks[key]; ok {
+		b.used = c.clock
+		if ref {
+			b.refs++
+		}
+		return b
+	}
+
+	if len(c.blocks) >= c.capacity {
+		c.evict()
+	}
+	b := &prefetchBlock{
+		done: make(chan struct{}),
+		used: c.clock,
+		buf:  prefetchBuffers.Get().(*[]byte),
+	}
+	if ref {
+		b.refs++
+	}
+	c.blocks[key] = b
+
+	go func() {
+		defer close(b.done)
+		p.sem <- struct{}{}
+		defer func() {
+			<-p.sem
+		}()
+
+		off := idx * prefetchBlockSize
+		data := (*b.buf)[:min(prefetchBlockSize, p.size-off)]
+		n, err := p.r.ReadAt(data, off)
+		if err == io.EOF && n > 0 {
+			err = nil
+		}
+		b.data = data[:n]
+		b.err = err
+	}()
+	return b
+}
+
+// evict removes the least recently used block that has been fetched, and reports whether a block is removed.
+// If all the blocks are being fetched, the cache grows temporarily. c.mu must be locked.
+func (c *prefetchCache) evict() bool {
+	var victim prefetchKey
+	var found bool
+	var used uint64
+	for key, b := range c.blocks {
+		select {
+		case <-b.done:
+		default:
+			continue
+		}
+		if !found || b.used < used {
+			victim = key
+			used = b.used
+			found = true
+		}
+	}
+	if found {
+		c.remove(victim)
+	}
+	return found
+}
+
+// remove removes the block of key from the cache. c.mu must be locked.
+func (c *prefetchCache) remove(key prefetchKey) {
+	b := c.blocks[key]
+	delete(c.blocks, key)
+	b.removed = true
+	b.recycle()
+}
+
+// unref releases the reference of block.
+func (c *prefetchCache) unref(b *prefetchBlock) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	b.refs--
+	b.recycle()
+}
+
+// recycle returns the data of b to the pool if b is neither cached nor read. The cache's mutex must be locked.
+func (b *prefetchBlock) recycle() {
+	if !b.removed || b.refs > 0 || b.buf == nil {
+		return
+	}
+	prefetchBuffers.Put(b.buf)
+	b.buf = nil
+	b.data = nil
+}
+
+// drop removes the failed block b so that the next read fetches it again.
+func (c *prefetchCache) drop(key prefetchKey, b *prefetchBlock) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.blocks[key] == b {
+		c.remove(key)
+	}
+}
+
+// segmentDataOffset returns the offset of the Segment's data, which the Cues' cluster positions are relative to.
+func (p *prefetchReader) segmentDataOffset() (int64, error) {
+	var off int64
+	// EBML header, and then Segment.
+	for _, want := range []uint64{0x1a45dfa3, 0x18538067} {
+		id, size, n, err := p.readElementHeader(off)
+		if err != nil {
+			return 0, err
+		}
+		if id != want {
+			return 0, fmt.Errorf("webmplayer: unexpected EBML element: %x", id)
+		}
+		off += int64(n)
+		if id == 0x1a45dfa3 {
+			off += int64(size)
+		}
+	}
+	return off, nil
+}
+
+// prefetchCues starts fetching the Cues found by the SeekHead, so that the Cues at the end of the stream arrive
+// while the header is being parsed.
+func (p *prefetchReader) prefetchCues() {
+	segment, err := p.segmentDataOffset()
+	if err != nil {
+		return
+	}
+	// The SeekHead is usually the first element of the Segment, maybe after a Void element.
+	off := segment
+	for range 4 {
+		id, size, n, err := p.readElementHeader(off)
+		if err != nil {
+			return
+		}
+		off += int64(n)
+		if id != 0x114d9b74 {
+			off += int64(size)
+			continue
+		}
+		end := off + int64(size)
+		for off < end {
+			// Seek
+			_, size, n, err := p.readElementHeader(off)
+			if err != nil {
+				return
+			}
+			off += int64(n)
+			if pos, ok := p.seekPosition(off, off+int64(size), 0x1c53bb6b); ok {
+				p.prefetchAt(segment + pos)
+				return
+			}
+			off += int64(size)
+		}
+		return
+	}
+}
+
+// seekPosition returns SeekPosition of the Seek element between off and end if its SeekID is id.
+func (p *prefetchReader) seekPosition(off, end int64, id uint64) (int64, bool) {
+	var seekID uint64
+	var pos int64 = -1
+	for off < end {
+		eid, size, n, err := p.readElementHeader(off)
+		if err != nil || size > 8 {
+			return 0, false
+		}
+		off += int64(n)
+		var buf [8]byte
+		if _, err := p.readAt(buf[:size], off); err != nil {
+			return 0, false
+		}
+		var v uint64
+		for _, b := range buf[:size] {
+			v = v<<8 | uint64(b)
+		}
+		switch eid {
+		case 0x53ab:
+			seekID = v
+		case 0x53ac:
+			pos = int64(v)
+		}
+		off += int64(size)
+	}
+	return pos, seekID == id && pos >= 0
+}
+
+// readElementHeader reads the ID and the data size of an EBML element at off.
+func (p *prefetchReader) readElementHeader(off int64) (id uint64, size uint64, n int, err error) {
+	id, n0, err := p.readVint(off, false)
+	if err != nil {
+		return 0, 0, 0, err
+	}
+	size, n1, err := p.readVint(off+int64(n0), true)
+	if err != nil {
+		return 0, 0, 0, err
+	}
+	return id, size, n0 + n1, nil
+}
+
+// readVint reads an EBML variable-length integer at off. If mask is true, the length marker is removed from the value.
+func (p *prefetchReader) readVint(off int64, mask bool) (uint64, int, error) {
+	var buf [8]byte
+	if _, err := p.readAt(buf[:1], off); err != nil {
+		return 0, 0, err
+	}
+	n := 1
+	for n <= 8 && buf[0]&(0x80>>(n-1)) == 0 {
+		n++
+	}
+	if n > 8 {
+		return 0, 0, errors.New("webmplayer: invalid EBML integer")
+	}
+	if _, err := p.readAt(buf[1:n], off+1); err != nil {
+		return 0, 0, err
+	}
+	v := uint64(buf[0])
+	if mask {
+		v &= 0xff >> n
+	}
+	for _, b := range buf[1:n] {
+		v = v<<8 | uint64(b)
+	}
+	return v, n, nil
+}
+
+// readAt reads from the cache without moving the reading position.
+func (p *prefetchReader) readAt(buf []byte, off int64) (int, error) {
+	var n int
+	for n < len(buf) {
+		m, err := p.readBlock(buf[n:], off+int64(n))
+		n += m
+		if err == io.EOF {
+			return n, io.ErrUnexpectedEOF
+		}
+		if err != nil {
+			return n, err
+		}
+	}
+	return n, nil
+}
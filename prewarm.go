@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+)
+
+// Prewarm runs the one-time initialization of the built-in decoders of the codecs, e.g. at the start of the
+// application, so that the first Player doesn't wait for it. codecIDs are the codec IDs of the tracks, e.g. "V_VP9"
+// and "A_OPUS". If codecIDs is empty, all the built-in codecs are prewarmed.
+//
+// Prewarm creates and frees a decoder of each codec, which runs the CPU detection and the static initialization of
+// the library, and faults in its code and tables. A Vorbis decoder depends on the headers of the stream, and
+// Prewarm does nothing for "A_VORBIS".
+//
+// Prewarm is safe for concurrent use.
+func Prewarm(codecIDs ...string) error {
+	return prewarm(nil, codecIDs)
+}
+
+// Prewarm is like the function Prewarm, but keeps the video decoders in p instead of freeing them, so that the
+// first Players of the codecs start with the decoders and their threads already created.
+// The video decoders are kept for the default VideoDecoderThreads.
+func (p *PlayerPool) Prewarm(codecIDs ...string) error {
+	return prewarm(p, codecIDs)
+}
+
+func prewarm(pool *PlayerPool, codecIDs []string) error {
+	if len(codecIDs) == 0 {
+		codecIDs = []string{string(videoCodecVP8), string(videoCodecVP9), string(videoCodecAV1), string(audioCodecOpus), string(audioCodecVorbis)}
+	}
+	for _, id := range codecIDs {
+		switch id {
+		case string(videoCodecVP8), string(videoCodecVP9), string(videoCodecAV1):
+			key := videoDecoderKey{codec: videoCodec(id), threads: defaultVideoDecoderThreads()}
+			d, err := newVideoDecoder(key.codec, key.threads)
+			if err != nil {
+				return err
+			}
+			pool.putVideo(key, &pooledVideo{decoder: d})
+		case string(audioCodecOpus):
+			if err := prewarmOpus(); err != nil {
+				return err
+			}
+		case string(audioCodecVorbis):
+		default:
+			return fmt.Errorf("webmplayer: unsupported codec: %s", id)
+		}
+	}
+	return nil
+}
@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build webmplayer_encoder && !js
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"errors"
+	"io"
+	"slices"
+	"sync"
+	"time"
+	"unsafe"
+
+	"github.com/ebml-go/webm"
+
+	"github.com/hajimehoshi/webmplayer/internal/libopus"
+)
+
+const (
+	defaultRecorderBitrate       = 96000
+	defaultRecorderComplexity    = 1
+	defaultRecorderBatchDuration = 200 * time.Millisecond
+)
+
+const (
+	// recorderSampleRate is the rate of the recorded Opus audio. The mix is resampled to it if the audio context has
+	// another rate, as Opus doesn't encode 44.1 kHz.
+	recorderSampleRate = 48000
+
+	// recorderFrameSize is the samples per channel of a packet, which is 20 ms.
+	recorderFrameSize = 960
+
+	// recorderMaxPacket is the maximum size of an Opus packet of a frame of 20 ms.
+	recorderMaxPacket = 1276
+)
+
+// RecorderOptions is the options of a Recorder.
+type RecorderOptions struct {
+	// Bitrate is the bitrate of the Opus audio in bits per second.
+	//
+	// If Bitrate is 0, 96 kbit/s is used.
+	Bitrate int
+
+	// Complexity is the complexity of the Opus encoder from 1 to 10. A higher complexity sounds better and takes more
+	// CPU.
+	//
+	// If Complexity is 0, 1 is used, with which recording takes less than 1% of one core even when the mix is resampled
+	// from 44.1 kHz.
+	Complexity int
+
+	// BatchDuration is the duration of the mix that is encoded at once on the background goroutine. A longer batch
+	// wakes the goroutine less often, and the recording lags behind the output by it.
+	//
+	// If BatchDuration is 0, 200 milliseconds is used.
+	BatchDuration time.Duration
+}
+
+// Recorder records the audio output of the Players to a WebM file of Opus audio, e.g. to capture gameplay.
+//
+// Recorder records the mix of all the Players, which webmplayer plays with one audio player of the Ebitengine audio
+// context. The other audio players of the context are not recorded. While no Players are playing, the mix is paused
+// and nothing is recorded, so the recording doesn't have the silence.
+//
+// The mix is copied on the audio callback, and is resampled, encoded, and muxed on a background goroutine in batches
+// of RecorderOptions.BatchDuration.
+//
+// Recorder is available with the build tag webmplayer_encoder.
+type Recorder struct {
+	tap   mixerTap
+	muxer *Muxer
+	enc   *libopus.Encoder
+
+	m sync.Mutex
+
+	// pending is the mix copied by the tap, and rate is its sample rate.
+	pending []float32
+	rate    int
+
+	// batch is the duration of the mix that wakes the goroutine.
+	batch time.Duration
+
+	wake chan struct{}
+	stop chan struct{}
+	done chan struct{}
+
+	// The fields below are used only by the goroutine.
+
+	// src is the source of the resampler, and resampler is nil if the mix is already at recorderSampleRate.
+	src       *recorderSource
+	resampler *resampler
+
+	// pcm is the mix at recorderSampleRate that is not encoded yet.
+	pcm  []float32
+	buf  []byte
+	data []byte
+
+	// packets is the number of the muxed packets.
+	packets int64
+
+	err error
+}
+
+// NewRecorder creates a Recorder recording to w, and starts recording. Only one Recorder can record at a time.
+// The file is completed at Close. If w is an io.WriteSeeker, the file is seekable as Muxer makes it.
+func NewRecorder(w io.Writer, options *RecorderOptions) (*Recorder, error) {
+	if options == nil {
+		options = &RecorderOptions{}
+	}
+	bitrate := options.Bitrate
+	if bitrate == 0 {
+		bitrate = defaultRecorderBitrate
+	}
+	complexity := options.Complexity
+	if complexity == 0 {
+		complexity = defaultRecorderComplexity
+	}
+	batch := options.BatchDuration
+	if batch == 0 {
+		batch = defaultRecorderBatchDuration
+	}
+
+	r := &Recorder{
+		batch: batch,
+		wake:  make(chan struct{}, 1),
+		stop:  make(chan struct{}),
+		done:  make(chan struct{}),
+	}
+	r.tap = r.write
+	// The tap is set first, so that w is not written if another Recorder is recording. The tap only buffers the mix
+	// until the goroutine starts.
+	if !theMixerTap.CompareAndSwap(nil, &r.tap) {
+		return nil, errors.New("webmplayer: another Recorder is recording")
+	}
+	if err := r.init(w, bitrate, complexity); err != nil {
+		theMixerTap.Store(nil)
+		if r.enc != nil {
+			r.enc.Destroy()
+		}
+		return nil, err
+	}
+	go r.loop()
+	return r, nil
+}
+
+// init creates the encoder and the muxer, and writes the header of the file.
+func (r *Recorder) init(w io.Writer, bitrate, complexity int) error {
+	enc, err := libopus.EncoderCreate(recorderSampleRate, 2, libopus.ApplicationAudio)
+	if err != nil {
+		return err
+	}
+	r.enc = enc
+	if err := enc.SetBitrate(bitrate); err != nil {
+		return err
+	}
+	if err := enc.SetComplexity(complexity); err != nil {
+		return err
+	}
+	preSkip, err := enc.Lookahead()
+	if err != nil {
+		return err
+	}
+
+	// OpusHead of the channel mapping family 0.
+	// https://datatracker.ietf.org/doc/html/rfc7845#section-5.1
+	head := make([]byte, 19)
+	copy(head, "OpusHead")
+	head[8] = 1
+	head[9] = 2
+	binary.LittleEndian.PutUint16(head[10:12], uint16(preSkip))
+	binary.LittleEndian.PutUint32(head[12:16], recorderSampleRate)
+
+	track := webm.TrackEntry{
+		TrackNumber:  1,
+		TrackUID:     1,
+		TrackType:    2,
+		CodecID:      "A_OPUS",
+		CodecPrivate: head,
+		CodecDelay:   uint(time.Duration(preSkip) * time.Second / recorderSampleRate),
+		SeekPreRoll:  uint(80 * time.Millisecond),
+	}
+	track.SamplingFrequency = recorderSampleRate
+	track.Channels = 2
+	muxer, err := NewMuxer(w, []webm.TrackEntry{track})
+	if err != nil {
+		return err
+	}
+	r.muxer = muxer
+	return nil
+}
+
+// write is the tap of the mix. write copies the frames, and wakes the goroutine without blocking when a batch is
+// pending.
+func (r *Recorder) write(frames []float32, sampleRate int) {
+	r.m.Lock()
+	defer r.m.Unlock()
+	r.pending = append(r.pending, frames...)
+	r.rate = sampleRate
+	if time.Duration(len(r.pending)/2)*time.Second < r.batch*time.Duration(sampleRate) {
+		return
+	}
+	select {
+	case r.wake <- struct{}{}:
+	default:
+	}
+}
+
+func (r *Recorder) loop() {
+	defer close(r.done)
+	var frames []float32
+	for {
+		var stopped bool
+		select {
+		case <-r.wake:
+		case <-r.stop:
+			stopped = true
+		}
+
+		// The buffers are swapped, so that the tap appends to the buffer of the previous batch without allocating.
+		r.m.Lock()
+		frames, r.pending = r.pending, frames[:0]
+		rate := r.rate
+		r.m.Unlock()
+
+		if r.err == nil {
+			r.err = r.encode(frames, rate, stopped)
+		}
+		if stopped {
+			if err := r.muxer.Close(); err != nil && r.err == nil {
+				r.err = err
+			}
+			r.enc.Destroy()
+			return
+		}
+	}
+}
+
+// encode resamples the frames at rate, and encodes and muxes the whole packets of them in one batch. At the end, the
+// rest is padded with silence to a packet.
+func (r *Recorder) encode(frames []float32, rate int, end bool) error {
+	if rate != 0 && rate != recorderSampleRate && r.resampler == nil {
+		r.src = &recorderSource{}
+		// The low quality is enough for the encoder, and costs a third of the medium quality.
+		r.resampler = newResampler(r.src, rate, recorderSampleRate, ResampleQualityLow)
+	}
+	if r.resampler == nil {
+		r.pcm = append(r.pcm, frames...)
+	} else {
+		r.src.frames = append(r.src.frames, frames...)
+		r.src.end = end
+		for {
+			if len(r.buf) == 0 {
+				r.buf = make([]byte, 4096)
+			}
+			n, err := r.resampler.Read(r.buf)
+			r.pcm = append(r.pcm, unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(r.buf))), n/4)...)
+			if errors.Is(err, errAudioNotReady) || err == io.EOF {
+				break
+			}
+			if err != nil {
+				return err
+			}
+		}
+	}
+	if end && len(r.pcm)%(2*recorderFrameSize) != 0 {
+		r.pcm = append(r.pcm, make([]float32, 2*recorderFrameSize-len(r.pcm)%(2*recorderFrameSize))...)
+	}
+
+	count := len(r.pcm) / (2 * recorderFrameSize)
+	if count == 0 {
+		return nil
+	}
+	r.data = slices.Grow(r.data[:0], count*recorderMaxPacket)[:count*recorderMaxPacket]
+	lens := r.enc.EncodeFloatBatch(r.pcm, recorderFrameSize, r.data, recorderMaxPacket)
+	for i, n := range lens {
+		if n < 0 {
+			return libopus.Error(n)
+		}
+		if err := r.muxer.WritePacket(&webm.Packet{
+			Data:        r.data[i*recorderMaxPacket : i*recorderMaxPacket+n],
+			Timecode:    time.Duration(r.packets) * recorderFrameSize * time.Second / recorderSampleRate,
+			TrackNumber: 1,
+			Keyframe:    true,
+		}); err != nil {
+			return err
+		}
+		r.packets++
+	}
+	r.pcm = r.pcm[:copy(r.pcm, r.pcm[count*2*recorderFrameSize:])]
+	return nil
+}
+
+// Close stops recording, encodes the rest of the mix, and completes the file. Close doesn't close the writer.
+// Close returns the first error of recording, and can be called more than once.
+func (r *Recorder) Close() error {
+	if theMixerTap.CompareAndSwap(&r.tap, nil) {
+		// A mix already calling the tap is encoded if it appends before the goroutine takes the pending mix for the
+		// last time, and is dropped otherwise.
+		close(r.stop)
+	}
+	<-r.done
+	return r.err
+}
+
+// recorderSource is the mix pending for the resampler. recorderSource returns errAudioNotReady when it is empty, until
+// the end.
+type recorderSource struct {
+	frames []float32
+	end    bool
+}
+
+func (s *recorderSource) Read(buf []byte) (int, error) {
+	if len(s.frames) == 0 {
+		if s.end {
+			return 0, io.EOF
+		}
+		return 0, errAudioNotReady
+	}
+	n := copy(unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4), s.frames)
+	s.frames = s.frames[:copy(s.frames, s.frames[n:])]
+	return 4 * n, nil
+}
+
+func (s *recorderSource) Seek(offset int64, whence int) (int64, error) {
+	return 0, errors.New("webmplayer: the recorder's mix is not seekable")
+}
@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"sync"
+	"unsafe"
+)
+
+// ResampleQuality is the quality of the sample rate conversion when the audio context's rate differs from the stream.
+type ResampleQuality int
+
+const (
+	// ResampleQualityMedium is a 32-tap filter. This is the default.
+	ResampleQualityMedium ResampleQuality = iota
+
+	// ResampleQualityLow is an 8-tap filter, for slow CPUs.
+	ResampleQualityLow
+
+	// ResampleQualityHigh is a 64-tap filter with a sharper cutoff.
+	ResampleQualityHigh
+)
+
+// maxResamplePhases is the maximum number of the filter phases. When the ratio of the rates needs more phases,
+// the fraction of a source position is rounded to the nearest phase.
+const maxResamplePhases = 256
+
+// resampleFilter is a windowed-sinc lowpass filter decomposed into phases.
+type resampleFilter struct {
+	// taps is the number of the source frames for an output frame.
+	taps int
+
+	// phases is the number of the phases. coefs has phases+1 rows of taps, and the last row is the next frame of the
+	// first row, which the rounding can reach.
+	phases int
+	coefs  []float32
+}
+
+type resampleFilterKey struct {
+	from    int
+	to      int
+	quality ResampleQuality
+}
+
+var (
+	resampleFiltersM sync.Mutex
+	resampleFilters  = map[resampleFilterKey]*resampleFilter{}
+)
+
+// resampleFilterFor returns the filter for the rates. The filters are shared by the streams of the same rates.
+func resampleFilterFor(from, to int, quality ResampleQuality) *resampleFilter {
+	key := resampleFilterKey{from: from, to: to, quality: quality}
+	resampleFiltersM.Lock()
+	defer resampleFiltersM.Unlock()
+	if f, ok := resampleFilters[key]; ok {
+		return f
+	}
+
+	var taps int
+	var beta, rolloff float64
+	switch quality {
+	case ResampleQualityLow:
+		taps, beta, rolloff = 8, 5, 0.85
+	case ResampleQualityHigh:
+		taps, beta, rolloff = 64, 9, 0.95
+	default:
+		taps, beta, rolloff = 32, 7, 0.9
+	}
+
+	phases := to / gcd(from, to)
+	if phases > maxResamplePhases {
+		phases = maxResamplePhases
+	}
+
+	// cutoff is relative to the Nyquist frequency of the source. Downsampling lowers the cutoff to the output's.
+	cutoff := min(1, float64(to)/float64(from)) * rolloff
+	half := float64(taps / 2)
+	f := &resampleFilter{
+		taps:   taps,
+		phases: phases,
+		coefs:  make([]float32, (phases+1)*taps),
+	}
+	for p := 0; p <= phases; p++ {
+		row := f.coefs[p*taps : (p+1)*taps]
+		t := float64(p) / float64(phases)
+		var sum float64
+		for k := range row {
+			// d is the distance from the source frame to the output position.
+			d := half - 1 - float64(k) + t
+			x := d / half
+			var c float64
+			if x > -1 && x < 1 {
+				c = cutoff * sinc(cutoff*d) * besselI0(beta*math.Sqrt(1-x*x)) / besselI0(beta)
+			}
+			row[k] = float32(c)
+			sum += c
+		}
+		// Keep the gain at DC exactly 1 for every phase.
+		for k := range row {
+			row[k] = float32(float64(row[k]) / sum)
+		}
+	}
+	resampleFilters[key] = f
+	return f
+}
+
+func gcd(a, b int) int {
+	for b != 0 {
+		a, b = b, a%b
+	}
+	return a
+}
+
+func sinc(x float64) float64 {
+	if x == 0 {
+		return 1
+	}
+	return math.Sin(math.Pi*x) / (math.Pi * x)
+}
+
+// besselI0 is the modified Bessel function of the first kind of order 0 for the Kaiser window.
+func besselI0(x float64) float64 {
+	sum, term := 1.0, 1.0
+	for k := 1; term > sum*1e-12; k++ {
+		term *= (x / 2) * (x / 2) / float64(k*k)
+		sum += term
+	}
+	return sum
+}
+
+// convolveStereo returns the inner products of the interleaved stereo frames and coefs.
+// The loop is unrolled by 2 frames with separate accumulators so that the multiplications are independent of
+// each other.
+func convolveStereo(frames, coefs []float32) (float32, float32) {
+	frames = frames[:2*len(coefs)]
+	var l0, r0, l1, r1 float32
+	n := len(coefs) &^ 1
+	for k := 0; k < n; k += 2 {
+		f := frames[2*k : 2*k+4 : 2*k+4]
+		c := coefs[k : k+2 : k+2]
+		l0 += f[0] * c[0]
+		r0 += f[1] * c[0]
+		l1 += f[2] * c[1]
+		r1 += f[3] * c[1]
+	}
+	for k := n; k < len(coefs); k++ {
+		l0 += frames[2*k] * coefs[k]
+		r0 += frames[2*k+1] * coefs[k]
+	}
+	return l0 + l1, r0 + r1
+}
+
+// resampler converts the sample rate of a stereo float32 stream with a polyphase windowed-sinc filter.
+// resampler is used only when the audio context already exists with a different sample rate from the stream.
+type resampler struct {
+	src    io.ReadSeeker
+	from   int64
+	to     int64
+	filter *resampleFilter
+
+	// pos is the current position in output frames.
+	pos int64
+
+	// frames is the buffered source samples, and start is the position of frames[0] in source frames.
+	// The frames before the beginning and after the end of the source are silent.
+	frames []float32
+	start  int64
+
+	// end is the number of the source frames after the source ends, or -1 before that.
+	end int64
+
+	buf []byte
+}
+
+func newResampler(src io.ReadSeeker, from, to int, quality ResampleQuality) *resampler {
+	r := &resampler{
+		src:    src,
+		from:   int64(from),
+		to:     int64(to),
+		filter: resampleFilterFor(from, to, quality),
+		buf:    make([]byte, 4096),
+	}
+	r.restart(0)
+	return r
+}
+
+// restart clears the buffer for the output starting at the source frame i, whose source position is already set.
+func (r *resampler) restart(i int64) {
+	r.start = i - int64(r.filter.taps/2) + 1
+	r.frames = r.frames[:0]
+	if r.start < 0 {
+		r.frames = append(r.frames, make([]float32, -2*r.start)...)
+	}
+	r.end = -1
+}
+
+func (r *resampler) Read(buf []byte) (int, error) {
+	dst := unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4)
+	f := r.filter
+	var n int
+	for ; n+2 <= len(dst); n += 2 {
+		x := r.pos * r.from
+		i := x / r.to
+		if err := r.fill(i); err != nil {
+			if errors.Is(err, errAudioNotReady) && n > 0 {
+				break
+			}
+			return 0, err
+		}
+		if r.end >= 0 && i >= r.end {
+			break
+		}
+		p := int((x%r.to*int64(f.phases) + r.to/2) / r.to)
+		j := 2 * int(i-int64(f.taps/2)+1-r.start)
+		dst[n], dst[n+1] = convolveStereo(r.frames[j:], f.coefs[p*f.taps:(p+1)*f.taps])
+		r.pos++
+	}
+	if n == 0 && r.end >= 0 {
+		return 0, io.EOF
+	}
+	return 4 * n, nil
+}
+
+// fill buffers the source frames around i for the filter, and discards the frames before them.
+// fill returns after the taps frames the filter reads for i are buffered, or after the source ends.
+func (r *resampler) fill(i int64) error {
+	first := i - int64(r.filter.taps/2) + 1
+	if d := 2 * int(first-r.start); d > 0 {
+		d = min(d, len(r.frames))
+		r.frames = r.frames[:copy(r.frames, r.frames[d:])]
+		r.start += int64(d / 2)
+	}
+	// A read can return fewer frames than needed, so read until all of them are buffered.
+	need := 2 * (int(first-r.start) + r.filter.taps)
+	for r.end < 0 && len(r.frames) < need {
+		// The source returns whole frames, so the read bytes are always a multiple of bytesPerFrame.
+		n, err := r.src.Read(r.buf[:len(r.buf)/bytesPerFrame*bytesPerFrame])
+		r.frames = append(r.frames, unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(r.buf))), n/4)...)
+		if err == io.EOF {
+			r.end = r.start + int64(len(r.frames)/2)
+			// Pad the end with silence for the filter.
+			r.frames = append(r.frames, make([]float32, 2*r.filter.taps)...)
+			break
+		}
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Seek implements io.Seeker. offset is in bytes of the output.
+func (r *resampler) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	case io.SeekCurrent:
+		offset += r.pos * bytesPerFrame
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	pos := offset / bytesPerFrame
+	if pos == r.pos {
+		return offset, nil
+	}
+	i := pos * r.from / r.to
+	start := max(i-int64(r.filter.taps/2)+1, 0)
+	if _, err := r.src.Seek(start*bytesPerFrame, io.SeekStart); err != nil {
+		return 0, err
+	}
+	r.pos = pos
+	r.restart(i)
+	return pos * bytesPerFrame, nil
+}
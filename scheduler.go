@@ -0,0 +1,182 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"container/heap"
+	"runtime"
+	"sync"
+	"time"
+)
+
+// DecodeScheduler limits the number of the decode calls of Players running at the same time, e.g. for a grid of many
+// videos. Each decode call is a cgo call that occupies an OS thread, and without the limit, the Players' decoders
+// run more threads than the CPUs.
+//
+// A decoder waiting for a slot gets it in the order of the presentation deadlines of the packets, so the frames
+// that are due soon are decoded first. The audio goes before all the video, as an audio underrun is worse than a
+// dropped video frame, and one of the slots is reserved for the audio so that it doesn't wait for a long video
+// decode call.
+//
+// Set PlayerOptions.DecodeScheduler to share a DecodeScheduler. The threads of the decoders themselves, e.g. by
+// PlayerOptions.VideoDecoderThreads, are not counted, so set VideoDecoderThreads to 1 for many small videos.
+//
+// A DecodeScheduler is safe for concurrent use.
+type DecodeScheduler struct {
+	mu   sync.Mutex
+	free int
+
+	// reserved is the number of the slots that only the audio can take.
+	reserved int
+
+	waiters decodeWaiters
+}
+
+// NewDecodeScheduler creates a DecodeScheduler that runs up to workers decode calls at the same time. If workers
+// is more than 1, the video decode calls run up to workers-1 at the same time.
+// If workers is 0 or less, GOMAXPROCS is used.
+func NewDecodeScheduler(workers int) *DecodeScheduler {
+	if workers <= 0 {
+		workers = runtime.GOMAXPROCS(0)
+	}
+	s := &DecodeScheduler{
+		free: workers,
+	}
+	if workers > 1 {
+		s.reserved = 1
+	}
+	return s
+}
+
+type decodeWaiter struct {
+	audio    bool
+	deadline time.Time
+	ready    chan struct{}
+}
+
+// decodeWaiters is a min-heap of the waiters, the audio first and then by the deadlines.
+type decodeWaiters []*decodeWaiter
+
+func (w decodeWaiters) Len() int { return len(w) }
+
+func (w decodeWaiters) Less(i, j int) bool {
+	if w[i].audio != w[j].audio {
+		return w[i].audio
+	}
+	return w[i].deadline.Before(w[j].deadline)
+}
+
+func (w decodeWaiters) Swap(i, j int) { w[i], w[j] = w[j], w[i] }
+func (w *decodeWaiters) Push(x any)   { *w = append(*w, x.(*decodeWaiter)) }
+
+func (w *decodeWaiters) Pop() any {
+	old := *w
+	x := old[len(old)-1]
+	old[len(old)-1] = nil
+	*w = old[:len(old)-1]
+	return x
+}
+
+// acquire waits for a slot for a decode call of the audio or the video whose result is due at deadline, and returns
+// the time waited. release must be called after the decode call. s can be nil, and then acquire returns immediately.
+func (s *DecodeScheduler) acquire(audio bool, deadline time.Time) time.Duration {
+	if s == nil {
+		return 0
+	}
+	s.mu.Lock()
+	// A free slot means that no waiter can take it.
+	if s.free > s.limit(audio) {
+		s.free--
+		s.mu.Unlock()
+		return 0
+	}
+	start := time.Now()
+	w := &decodeWaiter{
+		audio:    audio,
+		deadline: deadline,
+		ready:    make(chan struct{}),
+	}
+	heap.Push(&s.waiters, w)
+	s.mu.Unlock()
+	<-w.ready
+	return time.Since(start)
+}
+
+// release passes the slot to the first waiter, if it can take it.
+func (s *DecodeScheduler) release() {
+	if s == nil {
+		return
+	}
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if len(s.waiters) > 0 && s.free >= s.limit(s.waiters[0].audio) {
+		close(heap.Pop(&s.waiters).(*decodeWaiter).ready)
+		return
+	}
+	s.free++
+}
+
+// limit returns the number of the free slots that a decode call of the audio or the video can't take.
+func (s *DecodeScheduler) limit(audio bool) int {
+	if audio {
+		return 0
+	}
+	return s.reserved
+}
+
+// decodeCPUs returns the mask of PlayerOptions.DecodeCPUs, or nil if the decoders run on any CPU.
+func decodeCPUs(options *PlayerOptions) (*cpuMask, error) {
+	if len(options.DecodeCPUs) == 0 {
+		return nil, nil
+	}
+	return newCPUMask(options.DecodeCPUs)
+}
+
+// pinThread locks the current goroutine to its OS thread, and makes the thread run on the CPUs of m. The thread is
+// never unlocked, so that the thread exits with the goroutine instead of running other goroutines with the affinity.
+// The affinity is a hint, and pinThread does nothing if m is nil or the affinity can't be set.
+func pinThread(m *cpuMask) {
+	if m == nil {
+		return
+	}
+	runtime.LockOSThread()
+	_ = setThreadAffinity(m)
+}
+
+// runOnCPUs calls f on an OS thread running on the CPUs of m, e.g. to create a decoder whose threads inherit the
+// affinity. runOnCPUs calls f on the current goroutine if m is nil.
+func runOnCPUs(m *cpuMask, f func()) {
+	if m == nil {
+		f()
+		return
+	}
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		pinThread(m)
+		f()
+	}()
+	<-done
+}
+
+// withCPUs calls f with the current OS thread running on the CPUs of m, and then restores the affinity of the thread,
+// e.g. for a decode call on a goroutine shared by Players. withCPUs just calls f if m is nil.
+func withCPUs(m *cpuMask, f func()) {
+	if m == nil {
+		f()
+		return
+	}
+	runtime.LockOSThread()
+	defer runtime.UnlockOSThread()
+	old, err := threadAffinity()
+	if err != nil || setThreadAffinity(m) != nil {
+		f()
+		return
+	}
+	f()
+	if setThreadAffinity(old) != nil {
+		// Don't let the thread run other goroutines with the affinity. The thread exits with the goroutine.
+		runtime.LockOSThread()
+	}
+}
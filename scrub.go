@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"time"
+)
+
+// Scrub moves the Player to t while the user drags a seek bar. Scrub can be called as often as the pointer moves.
+//
+// While scrubbing, the Player is paused, and shows the keyframe at or before t, which is decoded without the frames
+// after it. A scrub within the GOP already shown doesn't seek, and the seeks not served yet are coalesced to the latest
+// one, whose decoding cancels the decoding toward an older one.
+//
+// EndScrub ends scrubbing at the last t.
+func (p *Player) Scrub(t time.Duration) error {
+	if p.closed {
+		return fmt.Errorf("webmplayer: the player is closed")
+	}
+	if p.stopped {
+		return fmt.Errorf("webmplayer: the player has stopped at the end")
+	}
+	if t < 0 {
+		return fmt.Errorf("webmplayer: negative position: %v", t)
+	}
+	p.stopStep()
+	if !p.scrubbing {
+		p.scrubbing = true
+		p.scrubResume = !p.paused
+		p.scrubKeyframe = -1
+		p.Pause()
+		// The video is decoded while paused to show the keyframes.
+		if p.videoStream != nil {
+			p.videoSource.pause(false)
+		}
+	}
+	p.scrubTarget = t
+	if c, ok := p.clock.(clockSetter); ok {
+		c.set(t)
+	}
+	if p.videoStream == nil {
+		return nil
+	}
+	k := p.videoSource.keyframeBefore(t)
+	if k == p.scrubKeyframe {
+		return nil
+	}
+	p.scrubKeyframe = k
+	p.videoSource.scrub(k)
+	p.videoStream.settle = true
+	return nil
+}
+
+// EndScrub ends scrubbing by Scrub. EndScrub seeks to the last position of Scrub with the frame accuracy, shows the
+// frame there, and resumes the playback if the Player was playing before scrubbing.
+//
+// EndScrub does nothing if the Player is not scrubbing.
+func (p *Player) EndScrub() error {
+	if !p.scrubbing {
+		return nil
+	}
+	resume := p.scrubResume
+	if err := p.Seek(p.scrubTarget); err != nil {
+		return err
+	}
+	if resume {
+		p.Resume()
+	}
+	return nil
+}
+
+// IsScrubbing reports whether the Player is scrubbing by Scrub.
+func (p *Player) IsScrubbing() bool {
+	return p.scrubbing
+}
+
+// stopScrub ends scrubbing for a seek, and reports whether the Player was scrubbing. The video keeps being decoded
+// until the frame of the seek is shown.
+func (p *Player) stopScrub() bool {
+	if !p.scrubbing {
+		return false
+	}
+	p.scrubbing = false
+	if p.videoStream != nil {
+		p.videoStream.settle = true
+		p.scrubSettling = true
+	}
+	return true
+}
+
+// updateScrub pauses the video again when the frame after scrubbing is shown in a pause.
+func (p *Player) updateScrub() {
+	if !p.scrubSettling || !p.videoStream.ready() {
+		return
+	}
+	p.scrubSettling = false
+	if p.paused {
+		p.videoSource.pause(true)
+	}
+}
@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"encoding/binary"
+	"os"
+)
+
+// sidecarKey returns the header of a sidecar file of the input fi, which the sidecar file is valid for: magic, the size
+// and the modification time of the input, and params, e.g. the options the analysis depends on.
+func sidecarKey(magic string, fi os.FileInfo, params ...uint64) []byte {
+	b := []byte(magic)
+	b = binary.LittleEndian.AppendUint64(b, uint64(fi.Size()))
+	b = binary.LittleEndian.AppendUint64(b, uint64(fi.ModTime().UnixNano()))
+	for _, p := range params {
+		b = binary.LittleEndian.AppendUint64(b, p)
+	}
+	return b
+}
+
+// readSidecar returns the data after the key of the sidecar file at path if it is for key.
+func readSidecar(path string, key []byte) ([]byte, bool) {
+	data, err := os.ReadFile(path)
+	if err != nil || !bytes.HasPrefix(data, key) {
+		return nil, false
+	}
+	return data[len(key):], true
+}
+
+// writeSidecar writes the sidecar file at path. The sidecar file is not written if it fails to be created, as it is
+// only a cache.
+func writeSidecar(path string, key []byte, data []byte) {
+	_ = os.WriteFile(path, append(key[:len(key):len(key)], data...), 0o644)
+}
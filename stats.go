@@ -0,0 +1,381 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"io"
+	"math"
+	"sync/atomic"
+	"time"
+)
+
+// HistogramBounds is the upper bounds of the buckets of a Histogram.
+var HistogramBounds = [...]time.Duration{
+	50 * time.Microsecond,
+	100 * time.Microsecond,
+	250 * time.Microsecond,
+	500 * time.Microsecond,
+	time.Millisecond,
+	2500 * time.Microsecond,
+	5 * time.Millisecond,
+	10 * time.Millisecond,
+	25 * time.Millisecond,
+	50 * time.Millisecond,
+	100 * time.Millisecond,
+}
+
+// Histogram is a histogram of durations.
+type Histogram struct {
+	// Count is the number of the samples, and Sum is the total of the samples.
+	Count uint64
+	Sum   time.Duration
+
+	// Buckets[i] is the number of the samples greater than HistogramBounds[i-1] and at most HistogramBounds[i].
+	// The last bucket is the number of the samples greater than the last bound.
+	// The buckets are not cumulative.
+	Buckets [len(HistogramBounds) + 1]uint64
+}
+
+// Mean returns the mean of the samples, or 0 if there are no samples.
+func (h *Histogram) Mean() time.Duration {
+	if h.Count == 0 {
+		return 0
+	}
+	return h.Sum / time.Duration(h.Count)
+}
+
+// Quantile returns the upper bound of the bucket of the q-quantile of the samples, or 0 if there are no samples.
+// If the q-quantile is in the last bucket, the last bound of HistogramBounds is returned, which is less than the
+// quantile.
+func (h *Histogram) Quantile(q float64) time.Duration {
+	if h.Count == 0 {
+		return 0
+	}
+	rank := max(uint64(math.Ceil(q*float64(h.Count))), 1)
+	var n uint64
+	for i, c := range h.Buckets[:len(HistogramBounds)] {
+		n += c
+		if n >= rank {
+			return HistogramBounds[i]
+		}
+	}
+	return HistogramBounds[len(HistogramBounds)-1]
+}
+
+func (h *Histogram) add(other *Histogram) {
+	h.Count += other.Count
+	h.Sum += other.Sum
+	for i := range h.Buckets {
+		h.Buckets[i] += other.Buckets[i]
+	}
+}
+
+// histogram is a Histogram updated concurrently.
+type histogram struct {
+	count   atomic.Uint64
+	sum     atomic.Int64
+	buckets [len(HistogramBounds) + 1]atomic.Uint64
+}
+
+func (h *histogram) observe(d time.Duration) {
+	i := 0
+	for i < len(HistogramBounds) && d > HistogramBounds[i] {
+		i++
+	}
+	h.buckets[i].Add(1)
+	h.sum.Add(int64(d))
+	h.count.Add(1)
+}
+
+func (h *histogram) snapshot() Histogram {
+	var s Histogram
+	s.Count = h.count.Load()
+	s.Sum = time.Duration(h.sum.Load())
+	for i := range h.buckets {
+		s.Buckets[i] = h.buckets[i].Load()
+	}
+	return s
+}
+
+// QueueStats is the state of the packet queue of a track.
+type QueueStats struct {
+	TrackNumber uint
+
+	// Packets and Bytes are the number and the size of the packets waiting for the decoder.
+	// Duration is the time span of the packets.
+	Packets  int
+	Bytes    int
+	Duration time.Duration
+}
+
+// PlayerStats is the statistics of the stages of a Player's pipeline.
+// The counters and the histograms are cumulative from the creation of the Player, so that they can be exported as
+// Prometheus counters and histograms.
+type PlayerStats struct {
+	// ReadTime is the time of each read of the inputs by the demuxer.
+	ReadTime Histogram
+
+	// Queues is the packet queues of the tracks being played, and the alternate audio tracks kept for switching.
+	Queues []QueueStats
+
+	// VideoDecodeTime is the time of libvpx to decode each video packet.
+	VideoDecodeTime Histogram
+
+	// VideoUploadTime is the time to write each presented frame to the textures. The YCbCr to RGB conversion is done
+	// by the GPU at drawing, so this is mostly the CPU time to queue WritePixels.
+	VideoUploadTime Histogram
+
+	// VideoPresentLatency is the time from decoding each presented frame to presenting it, including the wait in the
+	// frame queue until its time comes.
+	// VideoPresentLateness is how far the position is past the timecode of each frame when it is presented. Frames are
+	// presented by Update, so this is up to an Update interval when the decoder keeps up.
+	VideoPresentLatency  Histogram
+	VideoPresentLateness Histogram
+
+	// AudioDecodeTime is the time to decode each audio packet.
+	AudioDecodeTime Histogram
+
+	// DecodeWaitTime is the time of each video or audio decode call waiting for a slot of
+	// PlayerOptions.DecodeScheduler. Decode calls that don't wait are not counted.
+	DecodeWaitTime Histogram
+
+	// SkippedVideoFrames is the number of the video frames skipped without being decoded, as SkippedVideoFrames
+	// reports. LateVideoFrames is the number of the frames decoded but too late to be presented.
+	// DroppedVideoFrames is the number of the frames ready but replaced by a later frame before being presented.
+	SkippedVideoFrames int
+	LateVideoFrames    int
+	DroppedVideoFrames int
+
+	// VideoResyncs is the number of the video packets that failed to decode with PlayerOptions.VideoResyncOnError,
+	// after each of which the decoder restarted at the next keyframe.
+	VideoResyncs int
+
+	// RepeatedVideoFrames is the number of the presented frames not uploaded, as they have the same pixels as the frame
+	// on screen. See PlayerOptions.VideoHashFrames.
+	RepeatedVideoFrames int
+
+	// CachedVideoFrames is the number of the frames replayed from the cache instead of decoding them. See
+	// PlayerOptions.VideoFrameCacheBytes.
+	CachedVideoFrames int
+
+	// AudioUnderruns is the number of the times the audio was played as silence because no packet was decoded in
+	// time. Pre-buffering by PlayerOptions.AudioPrebuffer is not counted.
+	AudioUnderruns int
+
+	// AudioDecoderArena is the size in bytes of the storage of the Vorbis decoder for the temporaries of each block,
+	// which is the largest size that a block has needed. The storage is allocated for long blocks at the start, and
+	// grows if a block needs more. AudioDecoderArena is 0 for the other codecs.
+	AudioDecoderArena int
+
+	// AudioConcealed is the playback time of the audio concealed by the Opus decoder for the packets lost in the
+	// input, detected by the gaps of the timecodes.
+	AudioConcealed time.Duration
+
+	// AudioOutputLatency is how far the audio read by the audio output is ahead of the audio being heard, which is
+	// mostly the buffer of the audio output. AudioDecodedAhead is about the audio decoded but not read yet by
+	// PlayerOptions.AudioDecodeAhead. A seek or a skip is heard after their sum.
+	// These are the current values, not cumulative.
+	AudioOutputLatency time.Duration
+	AudioDecodedAhead  time.Duration
+
+	// Startup is the time of the steps of starting the Player.
+	Startup StartupStats
+
+	// Cgo is the calls into the C decoders with PlayerOptions.CgoStats.
+	Cgo CgoStats
+}
+
+// StartupStats is the time of the steps of starting a Player. The inputs are started concurrently, so the time of a
+// step is the longest of the inputs.
+type StartupStats struct {
+	// Parse is the time to parse the headers of the input up to the first cluster, e.g. by parseWebM.
+	Parse time.Duration
+
+	// VideoDecoderInit is the time to create and initialize the video decoder, e.g. by vpx_codec_dec_init.
+	// AudioDecoderInit is the time to create the audio decoder, including setting up the Vorbis headers and their
+	// codebooks.
+	// With PlayerOptions.FastStart, the two run concurrently.
+	VideoDecoderInit time.Duration
+	AudioDecoderInit time.Duration
+
+	// AudioOutputInit is the time to create the audio output, including the audio context for the first Player.
+	AudioOutputInit time.Duration
+
+	// NewPlayer is the time to create the Player.
+	NewPlayer time.Duration
+
+	// FirstFrameDecoded is the time from the start of creating the Player to decoding the first video frame.
+	// FirstFramePresented is the time to the Update drawing the first frame, including converting and uploading it.
+	// FirstAudio is the time to the first audio samples read by the audio output.
+	// These are 0 until then.
+	FirstFrameDecoded   time.Duration
+	FirstFramePresented time.Duration
+	FirstAudio          time.Duration
+}
+
+// streamStats is the statistics of a stream, shared by the demuxer and the decoders of the stream.
+type streamStats struct {
+	read        histogram
+	videoDecode histogram
+	videoUpload histogram
+	audioDecode histogram
+	decodeWait  histogram
+
+	presentLatency  histogram
+	presentLateness histogram
+
+	lateFrames     atomic.Int64
+	videoResyncs   atomic.Int64
+	repeatedFrames atomic.Int64
+	cachedFrames   atomic.Int64
+	audioUnderruns atomic.Int64
+	audioConcealed atomic.Int64
+	audioArena     atomic.Int64
+
+	// cgo is the counters of the C calls with PlayerOptions.CgoStats, or nil.
+	cgo *cgoCounters
+
+	// flight is the recent events of the pipeline with PlayerOptions.FlightRecorder, or nil.
+	flight *flightRecorder
+
+	// created is when the stream started to be created. The durations are the steps of creating the stream.
+	created   time.Time
+	parse     time.Duration
+	videoInit time.Duration
+	audioInit time.Duration
+
+	// firstDecoded, firstPresented and firstAudio are the time from created to the first video frame decoded and
+	// presented, and to the first audio samples read. They are 0 until then.
+	firstDecoded   atomic.Int64
+	firstPresented atomic.Int64
+	firstAudio     atomic.Int64
+}
+
+// mark records the time from the creation of the stream in v, if v is not recorded yet.
+func (s *streamStats) mark(v *atomic.Int64) {
+	if v.Load() != 0 {
+		return
+	}
+	v.CompareAndSwap(0, int64(max(time.Since(s.created), 1)))
+}
+
+// timedReader measures the time of each read of r.
+type timedReader struct {
+	r     io.ReadSeeker
+	stats *streamStats
+}
+
+func (t *timedReader) Read(buf []byte) (int, error) {
+	start := time.Now()
+	n, err := t.r.Read(buf)
+	t.stats.read.observe(time.Since(start))
+	return n, err
+}
+
+func (t *timedReader) Seek(offset int64, whence int) (int64, error) {
+	return t.r.Seek(offset, whence)
+}
+
+// Stats returns the statistics of the pipeline. The statistics of all the inputs and renditions are summed up.
+func (p *Player) Stats() *PlayerStats {
+	s := &PlayerStats{}
+	for _, st := range p.streams() {
+		stats := &st.stats
+		for _, h := range []struct {
+			dst *Histogram
+			src *histogram
+		}{
+			{&s.ReadTime, &stats.read},
+			{&s.VideoDecodeTime, &stats.videoDecode},
+			{&s.VideoUploadTime, &stats.videoUpload},
+			{&s.VideoPresentLatency, &stats.presentLatency},
+			{&s.VideoPresentLateness, &stats.presentLateness},
+			{&s.AudioDecodeTime, &stats.audioDecode},
+			{&s.DecodeWaitTime, &stats.decodeWait},
+		} {
+			snapshot := h.src.snapshot()
+			h.dst.add(&snapshot)
+		}
+		if st.videoStream != nil {
+			s.SkippedVideoFrames += st.videoStream.SkippedFrames()
+			s.DroppedVideoFrames += int(st.videoStream.frames.dropped.Load())
+		}
+		s.LateVideoFrames += int(stats.lateFrames.Load())
+		s.VideoResyncs += int(stats.videoResyncs.Load())
+		s.RepeatedVideoFrames += int(stats.repeatedFrames.Load())
+		s.CachedVideoFrames += int(stats.cachedFrames.Load())
+		s.AudioUnderruns += int(stats.audioUnderruns.Load())
+		s.AudioConcealed += time.Duration(stats.audioConcealed.Load())
+		s.AudioDecoderArena += int(stats.audioArena.Load())
+		s.Queues = append(s.Queues, st.queueStats()...)
+		cgo := stats.cgo.snapshot()
+		s.Cgo.add(&cgo)
+	}
+	s.Startup = p.startupStats()
+	if a := p.audioStream; a != nil && p.audioPlayer != nil {
+		if pulled := a.stream.audioPulled.Load(); pulled != math.MaxInt64 {
+			s.AudioOutputLatency = max(time.Duration(pulled)-p.audioPosition(), 0)
+		}
+		if a.ahead != nil {
+			s.AudioDecodedAhead = a.ahead.buffered(a.samplingFrequency)
+		}
+	}
+	return s
+}
+
+// startupStats returns the time of the steps of starting p.
+func (p *Player) startupStats() StartupStats {
+	s := StartupStats{
+		AudioOutputInit: p.audioOutputTime,
+		NewPlayer:       p.newPlayerTime,
+	}
+	// since returns the time from the creation of p to an event of st.
+	since := func(st *stream, v *atomic.Int64) time.Duration {
+		d := v.Load()
+		if d == 0 {
+			return 0
+		}
+		return st.stats.created.Sub(p.created) + time.Duration(d)
+	}
+	for _, st := range []*stream{p.videoSource, p.audioSource} {
+		if st == nil {
+			continue
+		}
+		s.Parse = max(s.Parse, st.stats.parse)
+		s.VideoDecoderInit = max(s.VideoDecoderInit, st.stats.videoInit)
+		s.AudioDecoderInit = max(s.AudioDecoderInit, st.stats.audioInit)
+	}
+	if st := p.videoSource; st != nil {
+		s.FirstFrameDecoded = since(st, &st.stats.firstDecoded)
+		s.FirstFramePresented = since(st, &st.stats.firstPresented)
+	}
+	if st := p.audioSource; st != nil {
+		s.FirstAudio = since(st, &st.stats.firstAudio)
+	}
+	return s
+}
+
+// queueStats returns the states of the packet queues of the tracks.
+func (s *stream) queueStats() []QueueStats {
+	var qs []QueueStats
+	add := func(track uint, q *packetQueue) {
+		packets, bytes, duration := q.depth()
+		qs = append(qs, QueueStats{
+			TrackNumber: track,
+			Packets:     packets,
+			Bytes:       bytes,
+			Duration:    duration,
+		})
+	}
+	if s.videoTrack != nil {
+		add(s.videoTrack.TrackNumber, s.videoStream.src)
+	}
+	for i := range s.meta.TrackEntry {
+		t := &s.meta.TrackEntry[i]
+		if q, ok := s.audioQueues[t.TrackNumber]; ok {
+			add(t.TrackNumber, q)
+		}
+	}
+	return qs
+}
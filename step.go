@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"time"
+)
+
+// defaultVideoStepCacheBytes is the budget of the frames kept while stepping without PlayerOptions.VideoStepCacheBytes.
+const defaultVideoStepCacheBytes = 64 << 20
+
+// stepRefillAhead is the number of the kept frames before the frame on screen below which PlayBackward starts decoding
+// the previous GOP, so that the frames are ready before they are due.
+const stepRefillAhead = 8
+
+// stepCache is the frames around the playhead in the time order, copied in their YCbCr planes, or RGBA for the
+// subsamplings that are not drawn as YCbCr. The frames are accounted in the memory budget, and the budget of the cache
+// is a quarter while the memory is over it.
+type stepCache struct {
+	budget int64
+	size   int64
+	frames []videoFrame
+}
+
+// append adds a copy of f after the kept frames. The oldest frames are dropped beyond the budget, and the planes of the
+// last one dropped are reused.
+func (c *stepCache) append(f *videoFrame) {
+	defer c.track(c.size)
+	var dst videoFrame
+	size := f.size()
+	budget := c.limit()
+	for len(c.frames) > 0 && c.size+size > budget {
+		c.size -= c.frames[0].size()
+		dst = c.frames[0]
+		c.frames[0] = videoFrame{}
+		c.frames = c.frames[1:]
+	}
+	dst.copyFrom(f)
+	dst.content = f.content
+	c.frames = append(c.frames, dst)
+	c.size += size
+}
+
+// prepend adds the frames, which are owned by c after this, before the kept frames. The latest frames are dropped
+// beyond the budget.
+func (c *stepCache) prepend(frames []videoFrame) {
+	defer c.track(c.size)
+	for i := range frames {
+		c.size += frames[i].size()
+	}
+	c.frames = append(frames, c.frames...)
+	budget := c.limit()
+	for len(c.frames) > 1 && c.size > budget {
+		last := len(c.frames) - 1
+		c.size -= c.frames[last].size()
+		c.frames[last] = videoFrame{}
+		c.frames = c.frames[:last]
+	}
+}
+
+func (c *stepCache) reset() {
+	trackMemory(memoryFrameCaches, -c.size)
+	c.frames = nil
+	c.size = 0
+}
+
+// limit returns the budget of the cache under the memory budget.
+func (c *stepCache) limit() int64 {
+	if memoryPressure() {
+		return c.budget / 4
+	}
+	return c.budget
+}
+
+// track accounts the change of the size from old in the memory budget.
+func (c *stepCache) track(old int64) {
+	trackMemory(memoryFrameCaches, c.size-old)
+}
+
+// stepOp is an operation of frameStepper waiting for the decoder.
+type stepOp int
+
+const (
+	stepNone stepOp = iota
+
+	// stepNext waits for the frame after the kept frames.
+	stepNext
+
+	// stepRefill waits for the frames before the kept frames, decoded from the previous keyframe.
+	stepRefill
+)
+
+// frameStepper is the state of StepForward, StepBackward and PlayBackward. While stepping, the frame on screen is a
+// kept frame, and the frame queue is read only to keep more frames.
+type frameStepper struct {
+	cache stepCache
+
+	// gen is the seek generation of the frames kept while playing.
+	gen uint64
+
+	// active is true while stepping, and index is the index of the kept frame on screen, or -1 if the frame on screen
+	// is not kept.
+	active bool
+	index  int
+
+	op stepOp
+
+	// refillEnd is the timecode of the frame that the frames being refilled are before, and refilled is the frames
+	// decoded so far. refillStep is true if the refill is for StepBackward, which steps back after it.
+	refillEnd    time.Duration
+	refilled     []videoFrame
+	refilledSize int64
+	refillStep   bool
+
+	// atStart is true when the first kept frame is the first frame of the stream.
+	atStart bool
+
+	// reverse is true while playing backward from reverseFrom since reverseStart.
+	reverse      bool
+	reverseStart time.Time
+	reverseFrom  time.Duration
+}
+
+// record keeps a copy of the frame f presented while playing.
+func (s *frameStepper) record(f *videoFrame) {
+	if f.gen != s.gen {
+		s.cache.reset()
+		s.gen = f.gen
+		s.atStart = false
+	}
+	s.cache.append(f)
+}
+
+// startStep starts stepping from the frame on screen.
+func (v *videoStream) startStep() {
+	s := &v.step
+	if s.active {
+		return
+	}
+	s.active = true
+	v.stepping.Store(true)
+	s.index = -1
+	s.op = stepNone
+	if n := len(s.cache.frames); n > 0 && s.gen == v.shownGen && s.cache.frames[n-1].timecode == v.shownTimecode {
+		s.index = n - 1
+	} else {
+		s.cache.reset()
+		s.atStart = false
+	}
+	v.pos.Store(int64(v.shownTimecode))
+}
+
+// stopStep stops stepping. The frames are dropped unless they are kept while playing.
+func (v *videoStream) stopStep() {
+	s := &v.step
+	s.active = false
+	v.stepping.Store(false)
+	s.op = stepNone
+	s.reverse = false
+	s.refilled = nil
+	if !v.stepRecording {
+		s.cache.reset()
+	}
+}
+
+// show uploads the kept frame at index.
+func (v *videoStream) show(index int) {
+	s := &v.step
+	s.index = index
+	f := &s.cache.frames[index]
+	v.upload(f)
+	v.shownTimecode = f.timecode
+	v.pos.Store(int64(f.timecode))
+}
+
+func (v *videoStream) stepForward() {
+	v.startStep()
+	s := &v.step
+	s.reverse = false
+	if s.op == stepRefill {
+		s.refillStep = false
+		return
+	}
+	if s.index+1 < len(s.cache.frames) {
+		v.show(s.index + 1)
+		return
+	}
+	s.op = stepNext
+}
+
+// stepBackward steps back to the previous frame. seek seeks the stream to the keyframe before a timecode to refill the
+// frames, and returns the timecode of the keyframe.
+func (v *videoStream) stepBackward(seek func(end time.Duration) time.Duration) {
+	v.startStep()
+	s := &v.step
+	s.reverse = false
+	switch s.op {
+	case stepRefill:
+		s.refillStep = true
+		return
+	case stepNext:
+		s.op = stepNone
+	}
+	if s.index > 0 {
+		v.show(s.index - 1)
+		return
+	}
+	v.refill(true, seek)
+}
+
+func (v *videoStream) playBackward(seek func(end time.Duration) time.Duration) {
+	v.startStep()
+	s := &v.step
+	if s.op == stepNext {
+		s.op = stepNone
+	}
+	s.reverse = true
+	s.reverseStart = time.Now()
+	s.reverseFrom = v.shownTimecode
+}
+
+// refill starts decoding the frames before the first kept frame, or before the frame on screen if it is not kept.
+func (v *videoStream) refill(step bool, seek func(end time.Duration) time.Duration) {
+	s := &v.step
+	if s.atStart || !v.shown {
+		return
+	}
+	end := v.shownTimecode
+	if s.index >= 0 {
+		end = s.cache.frames[0].timecode
+	}
+	s.op = stepRefill
+	s.refillEnd = end
+	s.refillStep = step
+	s.refilled = nil
+	s.refilledSize = 0
+	// The decoder doesn't skip the frames before the position as late ones.
+	v.pos.Store(int64(seek(end)))
+}
+
+// updateStep is Update while stepping. rate is the speed of PlayBackward. updateStep reports whether the stepper
+// waits for the decoder, which must run then even while the Player is paused.
+func (v *videoStream) updateStep(rate float64, seek func(end time.Duration) time.Duration) (bool, error) {
+	if err := v.err.Load(); err != nil {
+		return false, *err
+	}
+	// The frames to step to are decoded within the ticks as well.
+	v.ticks.tick()
+	s := &v.step
+	gen := v.seek.Gen()
+	ended := func() bool {
+		return v.endGen.Load() == gen+1 && v.frames.empty()
+	}
+
+	switch s.op {
+	case stepNext:
+		last := v.shownTimecode
+		if n := len(s.cache.frames); n > 0 {
+			last = s.cache.frames[n-1].timecode
+		}
+		for f := v.frames.next(gen); f != nil; f = v.frames.next(gen) {
+			// After a refill, the decoder decodes the kept frames again.
+			if f.timecode <= last {
+				v.frames.release()
+				continue
+			}
+			s.cache.append(f)
+			v.frames.release()
+			s.op = stepNone
+			v.show(len(s.cache.frames) - 1)
+			break
+		}
+		if s.op == stepNext && ended() {
+			s.op = stepNone
+		}
+
+	case stepRefill:
+		// A GOP longer than the budget keeps its latest frames, and the first kept frame, which the decoder has passed.
+		budget := s.cache.budget
+		if len(s.cache.frames) > 0 {
+			budget -= s.cache.frames[0].size()
+		}
+		done := false
+		for f := v.frames.next(gen); f != nil; f = v.frames.next(gen) {
+			if f.timecode < s.refillEnd {
+				s.refilled = append(s.refilled, videoFrame{})
+				c := &s.refilled[len(s.refilled)-1]
+				c.copyFrom(f)
+				c.content = f.content
+				s.refilledSize += c.size()
+				v.frames.release()
+				for len(s.refilled) > 1 && s.refilledSize > budget {
+					s.refilledSize -= s.refilled[0].size()
+					s.refilled[0] = videoFrame{}
+					s.refilled = s.refilled[1:]
+				}
+				continue
+			}
+			if len(s.cache.frames) == 0 {
+				s.cache.append(f)
+			}
+			v.frames.release()
+			done = true
+			break
+		}
+		if done || ended() {
+			v.finishRefill()
+		}
+	}
+
+	if s.reverse {
+		target := s.reverseFrom - time.Duration(float64(time.Since(s.reverseStart))*rate)
+		i := s.index
+		for i > 0 && s.cache.frames[i].timecode > target {
+			i--
+		}
+		if i != s.index && i >= 0 {
+			v.show(i)
+		}
+		if s.op == stepNone && s.index < stepRefillAhead {
+			v.refill(false, seek)
+			// Playing backward ends at the first frame.
+			if s.op == stepNone && s.index <= 0 {
+				s.reverse = false
+			}
+		}
+	}
+	return s.op != stepNone, nil
+}
+
+// finishRefill adds the refilled frames before the kept frames.
+func (v *videoStream) finishRefill() {
+	s := &v.step
+	n := len(s.refilled)
+	s.cache.prepend(s.refilled)
+	s.refilled = nil
+	s.op = stepNone
+	s.atStart = n == 0
+	if len(s.cache.frames) == 0 {
+		s.index = -1
+		return
+	}
+	i := max(s.index, 0) + n
+	if s.refillStep && n > 0 {
+		i--
+	}
+	v.show(min(i, len(s.cache.frames)-1))
+}
+
+// StepForward pauses the Player, and shows the next video frame. The frames stepped back over are shown from the
+// frames kept in memory, and the others are decoded.
+//
+// StepForward, StepBackward and PlayBackward need the Player's own clock, and don't work with PlayerOptions.Clock or
+// PlayerOptions.OnVideoFrame. Resume plays from the frame on screen.
+func (p *Player) StepForward() error {
+	if err := p.canStep(); err != nil {
+		return err
+	}
+	p.Pause()
+	p.videoStream.stepForward()
+	return nil
+}
+
+// StepBackward pauses the Player, and shows the previous video frame.
+//
+// The presented frames are kept in memory up to PlayerOptions.VideoStepCacheBytes while playing, so stepping back
+// over them doesn't decode. Before the kept frames, the GOP before them is decoded again from its keyframe, and kept.
+func (p *Player) StepBackward() error {
+	if err := p.canStep(); err != nil {
+		return err
+	}
+	p.Pause()
+	p.videoStream.stepBackward(p.seekKeyframe)
+	return nil
+}
+
+// PlayBackward plays the video backward at the playback rate without audio, from the frame on screen until the first
+// frame. The frames are shown from the kept frames, and the GOP before them is decoded in the background before they
+// run out. Resume or Seek stops playing backward.
+func (p *Player) PlayBackward() error {
+	if err := p.canStep(); err != nil {
+		return err
+	}
+	p.Pause()
+	p.videoStream.playBackward(p.seekKeyframe)
+	return nil
+}
+
+func (p *Player) canStep() error {
+	if p.closed {
+		return fmt.Errorf("webmplayer: the player is closed")
+	}
+	if p.stopped {
+		return fmt.Errorf("webmplayer: the player has stopped at the end")
+	}
+	if p.videoStream == nil {
+		return errors.New("webmplayer: no video")
+	}
+	if p.scrubbing {
+		return errors.New("webmplayer: the player is scrubbing")
+	}
+	if p.videoStream.onFrame != nil {
+		return errors.New("webmplayer: stepping is not available with OnVideoFrame")
+	}
+	if _, ok := p.clock.(clockSetter); !ok {
+		return errors.New("webmplayer: stepping is not available with Clock")
+	}
+	return nil
+}
+
+// seekKeyframe seeks the video to the keyframe before end, and returns the timecode of the keyframe.
+func (p *Player) seekKeyframe(end time.Duration) time.Duration {
+	t := p.videoSource.keyframeBefore(end - 1)
+	p.videoSource.Seek(t)
+	return t
+}
+
+// updateStep is Update while stepping. The video is decoded only while the stepper waits for frames.
+func (p *Player) updateStep() error {
+	decoding, err := p.videoStream.updateStep(p.rate, p.seekKeyframe)
+	if err != nil {
+		return err
+	}
+	if decoding != p.stepDecoding {
+		p.stepDecoding = decoding
+		p.videoSource.pause(!decoding)
+	}
+	if c, ok := p.clock.(clockSetter); ok {
+		c.set(p.videoStream.shownTimecode)
+	}
+	return nil
+}
+
+// stopStep stops stepping, and pauses the video again if it is being decoded for stepping.
+func (p *Player) stopStep() {
+	if p.videoStream == nil || !p.videoStream.step.active {
+		return
+	}
+	p.videoStream.stopStep()
+	if p.stepDecoding {
+		p.stepDecoding = false
+		p.videoSource.pause(true)
+	}
+}
@@ -4,7 +4,16 @@
 package webmplayer
 
 import (
+	"context"
+	"errors"
+	"fmt"
 	"io"
+	"math"
+	"runtime/trace"
+	"sort"
+	"sync"
+	"sync/atomic"
+	"time"
 
 	"github.com/ebml-go/webm"
 )
@@ -13,66 +22,683 @@ type stream struct {
 	meta        webm.WebM
 	videoStream *videoStream
 	audioStream *audioStream
+	options     *PlayerOptions
 
-	reader *webm.Reader
+	// videoTrack and audioTrack are the tracks being played.
+	videoTrack *webm.TrackEntry
+	audioTrack *webm.TrackEntry
+
+	// subtitles is the cues of the subtitle track to show, or nil.
+	subtitles *subtitleIndex
+
+	// audioQueues is the packet queues of all the audio tracks by the track numbers.
+	// The queues of the audio tracks not being played are lookahead queues.
+	audioQueues map[uint]*packetQueue
+
+	reader demuxer
+
+	// input is the input the stream is created from.
+	input io.ReadSeeker
+
+	// memory is the input if it is in memory, and memoryStart is the offset of the stream in it.
+	memory      *memoryReader
+	memoryStart int64
+
+	// loop is the duration of a pass with PlayerOptions.Loop, or 0 if the stream doesn't loop. loopStart is the offset
+	// of the first Cluster, which is prefetched before the end of each pass.
+	loop      time.Duration
+	loopStart int64
+
+	// prefetch is the source if the source is made by NewPrefetchReader or NewSharedPrefetchReader.
+	// cues is the cluster positions in the source by time, which is used to prefetch clusters at seeking.
+	prefetch *prefetchReader
+	cues     []cue
+
+	// keyframes is the seek table for a video without Cues. keyframes is nil if the video has Cues.
+	keyframes *keyframeIndex
+
+	queue *demuxQueue
+	seek  seekState
+	seeks chan seekRequest
+
+	// served is the seek generation that the reader is asked last. rebased receives when the reader has sent the
+	// packet with Rebase of the seek, and is closed when the reader stops.
+	served  atomic.Uint64
+	rebased chan struct{}
+
+	// shutdown shuts the reader down once, either at the end of the packets or at closing.
+	shutdown sync.Once
+
+	stats streamStats
+
+	// audioPulled is the position of the audio read by the audio player, which is ahead of the playback position by
+	// the audio player's buffer. audioPulled is math.MaxInt64 without audio or after the end of the audio.
+	audioPulled atomic.Int64
+
+	// ctx is the context of the trace task of the stream, and labels is the pprof labels of the stream.
+	ctx    context.Context
+	task   *trace.Task
+	labels []string
 }
 
-func newStream(r io.ReadSeeker) (*stream, error) {
-	s := &stream{}
-	reader, err := webm.Parse(r, &s.meta)
+// demuxer is the source of the packets of a stream: webmReader, or oggDemuxer for an audio-only Ogg input.
+type demuxer interface {
+	// packets returns the channel of the packets, which is closed after Shutdown.
+	packets() <-chan demuxPacket
+
+	Seek(t time.Duration)
+	Shutdown()
+
+	// setLoop makes the demuxer read the input again at the end, with the timecodes continuing, and returns the
+	// duration of a pass. setLoop returns 0 if the duration of the input is unknown, and the input doesn't loop then.
+	setLoop() time.Duration
+
+	// skipData makes the demuxer send the packets of the track without their data, which is not read if possible.
+	// track 0 sends all the data.
+	skipData(track uint)
+
+	// skipAudio makes the demuxer drop the packets of all the audio tracks, whose data is not read if possible.
+	skipAudio()
+}
+
+// demuxPacket is a packet sent by a demuxer. alpha is the alpha channel of a VP8 or VP9 frame, which is the
+// BlockAdditional of BlockAddID 1 of its block, or nil.
+type demuxPacket struct {
+	webm.Packet
+	alpha []byte
+}
+
+// isOgg reports whether r starts with an Ogg page. r is moved back to its current position.
+func isOgg(r io.ReadSeeker) bool {
+	start, err := r.Seek(0, io.SeekCurrent)
 	if err != nil {
-		return nil, err
+		return false
 	}
-	s.reader = reader
+	var magic [4]byte
+	_, err = io.ReadFull(r, magic[:])
+	if _, err := r.Seek(start, io.SeekStart); err != nil {
+		return false
+	}
+	return err == nil && string(magic[:]) == "OggS"
+}
 
-	vTrack := s.meta.FindFirstVideoTrack()
-	aTrack := s.meta.FindFirstAudioTrack()
+// packet is a packet routed to a decoder.
+type packet struct {
+	webm.Packet
 
-	var vPackets chan webm.Packet
-	var aPackets chan webm.Packet
+	// alpha is the alpha channel of a video frame. See demuxPacket.
+	alpha []byte
 
-	if vTrack != nil {
-		vPackets = make(chan webm.Packet, 32)
-		s.videoStream, err = newVideoStream(videoCodec(vTrack.CodecID), vPackets)
+	// gen is the seek generation of the packet.
+	// When gen changes, the decoder resets its state and starts decoding from the seek target.
+	gen uint64
+
+	// eos is true for the mark of the end of the stream, which every track receives.
+	eos bool
+
+	// loop is true for the mark of the start of a pass with PlayerOptions.Loop, which every track receives. Its
+	// Timecode is the start of the pass.
+	loop bool
+}
+
+// seekState is shared by a stream and its decoders.
+type seekState struct {
+	// gen is the number of seeks requested.
+	gen atomic.Uint64
+
+	// target is the position of the latest seek.
+	target atomic.Int64
+
+	// scrub is true if the latest seek is for scrubbing, which presents only the first frame at target.
+	scrub atomic.Bool
+}
+
+// seekRequest is a seek to t of the seek generation gen.
+type seekRequest struct {
+	t   time.Duration
+	gen uint64
+}
+
+func (s *seekState) Gen() uint64 {
+	return s.gen.Load()
+}
+
+func (s *seekState) Target() time.Duration {
+	return time.Duration(s.target.Load())
+}
+
+// newStream parses r and creates the decoders of the tracks to play. Without video, the video tracks are not decoded
+// and their data is not read, e.g. for AudioEngine.
+func newStream(r io.ReadSeeker, options *PlayerOptions, video bool) (*stream, error) {
+	s := &stream{
+		seeks:   make(chan seekRequest, 16),
+		rebased: make(chan struct{}, 1),
+		options: options,
+		input:   r,
+	}
+	s.audioPulled.Store(math.MaxInt64)
+	s.stats.created = time.Now()
+	if options.CgoStats {
+		s.stats.cgo = newCgoCounters()
+	}
+	s.stats.flight = newFlightRecorder(options.FlightRecorder, options.StallThreshold)
+	s.initTrace(options)
+
+	if m, ok := r.(*memoryReader); ok {
+		start, err := m.Seek(0, io.SeekCurrent)
 		if err != nil {
 			return nil, err
 		}
+		s.memory = m
+		s.memoryStart = start
 	}
 
-	if aTrack != nil {
-		aPackets = make(chan webm.Packet, 32)
-		s.audioStream, err = newAudioDecoder(audioCodec(aTrack.CodecID), aTrack.CodecPrivate, int(aTrack.Channels), int(aTrack.SamplingFrequency), aPackets)
+	var colors map[uint]trackColor
+	var err error
+	if isOgg(r) {
+		// The reader's goroutine started by newOggDemuxer has the labels of reading.
+		var d *oggDemuxer
+		s.run("read", func(ctx context.Context) {
+			d, err = newOggDemuxer(&timedReader{r: r, stats: &s.stats})
+		})
 		if err != nil {
 			return nil, err
 		}
+		s.meta = d.meta
+		s.reader = d
+	} else {
+		if p, ok := prefetchSource(r); ok {
+			s.run("prefetch", func(ctx context.Context) {
+				go p.prefetchCues()
+			})
+		}
+		// An input in memory is not wrapped, so that webmReader refers to its blocks.
+		src := io.ReadSeeker(&timedReader{r: r, stats: &s.stats})
+		if s.memory != nil {
+			src = s.memory
+		}
+		// A file with PlayerOptions.IndexSidecar has the headers in its sidecar file unless the file is stale.
+		f, _ := r.(*indexedFile)
+		var idx *webmIndex
+		if f != nil {
+			idx = f.index
+		}
+		var reader *webmReader
+		// The reader's goroutine started by parseWebM has the labels of reading.
+		s.run("read", func(ctx context.Context) {
+			reader, colors, err = parseWebMWithIndex(src, &s.meta, idx)
+		})
+		if err != nil {
+			return nil, err
+		}
+		s.reader = reader
+		if f != nil {
+			f.storeIndex(reader.index(&s.meta, colors))
+		}
+
+		if p, ok := prefetchSource(r); ok {
+			s.prefetch = p
+			s.cues = reader.cues
+		}
+		s.loopStart = reader.firstCluster
+	}
+	s.stats.parse = time.Since(s.stats.created)
+	if options.Loop {
+		s.loop = s.reader.setLoop()
+	}
+
+	var vTrack *webm.TrackEntry
+	if video {
+		vTrack, err = findTrack(&s.meta, options.VideoTrack, (*webm.TrackEntry).IsVideo)
+		if err != nil {
+			return nil, err
+		}
+	} else if t := s.meta.FindFirstVideoTrack(); t != nil {
+		s.reader.skipData(t.TrackNumber)
+	}
+	var aTrack *webm.TrackEntry
+	if options.NoAudio {
+		s.reader.skipAudio()
+	} else {
+		aTrack, err = findTrack(&s.meta, options.AudioTrack, (*webm.TrackEntry).IsAudio)
+		if err != nil {
+			return nil, err
+		}
+	}
+	s.videoTrack = vTrack
+	s.audioTrack = aTrack
+
+	// The subtitle tracks are indexed by the reader, and are not routed to any queue.
+	if reader, ok := s.reader.(*webmReader); ok {
+		t, err := findTrack(&s.meta, options.SubtitleTrack, isSubtitleTrack)
+		if err != nil {
+			return nil, err
+		}
+		if t != nil {
+			s.subtitles = reader.subtitleIndex(t.TrackNumber)
+		}
+	}
+
+	readAhead := options.ReadAhead
+	if readAhead <= 0 {
+		readAhead = defaultReadAhead
+	}
+	readAheadBytes := options.ReadAheadBytes
+	if readAheadBytes <= 0 {
+		readAheadBytes = defaultReadAheadBytes
+	}
+	s.queue = newDemuxQueue(readAhead, readAheadBytes)
+
+	var vPackets *packetQueue
+
+	if vTrack != nil {
+		vPackets = s.queue.newTrack()
+		vPackets.parks = true
+	}
+
+	if aTrack != nil {
+		s.audioQueues = map[uint]*packetQueue{}
+		for i := range s.meta.TrackEntry {
+			t := &s.meta.TrackEntry[i]
+			if !t.IsAudio() {
+				continue
+			}
+			q := s.queue.newTrack()
+			if t != aTrack {
+				q.setLookahead(true)
+			}
+			s.audioQueues[t.TrackNumber] = q
+		}
+	}
+
+	initVideo := func() error {
+		start := time.Now()
+		var err error
+		// The decoder's goroutine has the labels of the video.
+		s.run("video", func(ctx context.Context) {
+			s.videoStream, err = newVideoStream(ctx, vTrack, colors[vTrack.TrackNumber], vPackets, &s.seek, &s.stats, &s.audioPulled, s.loop, options)
+		})
+		s.stats.videoInit = time.Since(start)
+		return err
+	}
+	initAudio := func() error {
+		start := time.Now()
+		var err error
+		s.audioStream, err = s.newAudioDecoder(aTrack)
+		s.stats.audioInit = time.Since(start)
+		if err == nil && s.audioStream.clip != nil {
+			s.audioQueues[aTrack.TrackNumber].setLookahead(true)
+		}
+		return err
+	}
+
+	// The decoders don't depend on each other. With FastStart, the audio decoder is initialized while libvpx is.
+	var videoErr, audioErr error
+	if vTrack != nil && aTrack != nil && options.FastStart {
+		var wg sync.WaitGroup
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			audioErr = initAudio()
+		}()
+		videoErr = initVideo()
+		wg.Wait()
+	} else {
+		if vTrack != nil {
+			videoErr = initVideo()
+		}
+		if videoErr == nil && aTrack != nil {
+			audioErr = initAudio()
+		}
+	}
+	if videoErr != nil || audioErr != nil {
+		// The video decoder's goroutine waits for packets until the queue is closed.
+		s.queue.close()
+		if videoErr == nil && s.videoStream != nil {
+			s.videoStream.close()
+		}
+		if audioErr == nil && s.audioStream != nil {
+			s.audioStream.close()
+		}
+		return nil, errors.Join(videoErr, audioErr)
+	}
+
+	if vTrack != nil && len(s.meta.CuePoint) == 0 {
+		s.keyframes = &keyframeIndex{}
 	}
 
-	go func() {
-		for pkt := range s.reader.Chan {
-			switch {
-			case vTrack == nil:
-				// Audio only.
-				aPackets <- pkt
-			case aTrack == nil:
-				// Video Only.
-				vPackets <- pkt
-			default:
-				switch pkt.TrackNumber {
-				case vTrack.TrackNumber:
-					vPackets <- pkt
-				case aTrack.TrackNumber:
-					aPackets <- pkt
+	go s.run("demux", func(ctx context.Context) {
+		// push pushes pkt to q. push blocks while the decoder of q is behind.
+		push := func(q *packetQueue, pkt packet) {
+			r := trace.StartRegion(ctx, "demux.push")
+			q.push(pkt)
+			r.End()
+			if !pkt.eos && !pkt.loop {
+				s.stats.flight.record(FlightPacketDemuxed, pkt.TrackNumber, pkt.Timecode, int64(len(pkt.Data)))
+			}
+		}
+
+		// done is the seek generation that the reader has finished.
+		// The reader sends a packet with Rebase after each seek.
+		var done uint64
+		// prefetched is true when the start of the next pass of Loop has been prefetched.
+		var prefetched bool
+		for wpkt := range s.reader.packets() {
+			if s.keyframes != nil {
+				if wpkt.Rebase {
+					s.keyframes.seek()
+				}
+				// The passes of Loop are the same, and the first pass is indexed.
+				if len(wpkt.Data) > 0 && wpkt.TrackNumber == vTrack.TrackNumber {
+					s.keyframes.add(passTime(wpkt.Timecode, s.loop), wpkt.Keyframe)
+				}
+			}
+			if s.loop > 0 && s.prefetch != nil && !prefetched && wpkt.Timecode != webm.BadTC && passTime(wpkt.Timecode, s.loop) >= s.loop-readAhead {
+				s.prefetch.prefetchAt(s.loopStart)
+				prefetched = true
+			}
+			// Drop packets read before the latest seek.
+			if gen := s.seek.Gen(); done < gen {
+				if wpkt.Rebase {
+					done = s.served.Load()
+					s.rebased <- struct{}{}
+				}
+				if done < gen {
+					continue
+				}
+			}
+			pkt := packet{
+				Packet: wpkt.Packet,
+				alpha:  wpkt.alpha,
+				gen:    done,
+			}
+			// The reader sends BadTC at the end, and then waits for a seek.
+			// With Loop, the reader sends the mark of the next pass instead, and continues.
+			if wpkt.Timecode == webm.BadTC || wpkt.TrackNumber == loopTrackNumber {
+				if wpkt.Timecode == webm.BadTC {
+					pkt.eos = true
+				} else {
+					pkt.loop = true
+					prefetched = false
+				}
+				if vPackets != nil {
+					push(vPackets, pkt)
+				}
+				for _, q := range s.audioQueues {
+					push(q, pkt)
+				}
+				continue
+			}
+			if vTrack != nil && pkt.TrackNumber == vTrack.TrackNumber {
+				push(vPackets, pkt)
+			} else if q, ok := s.audioQueues[pkt.TrackNumber]; ok {
+				push(q, pkt)
+			}
+		}
+		s.queue.close()
+		close(s.rebased)
+		s.shutdown.Do(s.reader.Shutdown)
+	})
+
+	// The demuxer's Seek can block until the reader sends its current packet.
+	// Seek on another goroutine so that the caller doesn't wait for the decoders to consume packets.
+	//
+	// A reader taking a seek before sending the packet with Rebase of the previous one sends one packet with Rebase
+	// for both. The next seek is sent after the packet with Rebase, so that the packets are of the generation served,
+	// and the seeks requested meanwhile are coalesced to the latest one, e.g. while scrubbing.
+	go s.run("seek", func(ctx context.Context) {
+		defer s.shutdown.Do(s.reader.Shutdown)
+		var req seekRequest
+		var pending, waiting bool
+		for {
+			if pending && !waiting {
+				s.served.Store(req.gen)
+				r := trace.StartRegion(ctx, "seek")
+				s.reader.Seek(req.t)
+				r.End()
+				pending = false
+				waiting = true
+			}
+			var rebased <-chan struct{}
+			if waiting {
+				rebased = s.rebased
+			}
+			select {
+			case next, ok := <-s.seeks:
+				if !ok {
+					// The reader goroutine above keeps draining the reader until the reader closes its channel.
+					return
+				}
+				if !pending || next.gen > req.gen {
+					req = next
 				}
+				pending = true
+			case <-rebased:
+				waiting = false
 			}
 		}
-		close(vPackets)
-		close(aPackets)
-		s.reader.Shutdown()
-	}()
+	})
+
+	return s, nil
+}
 
+// newAudioOnlyStream creates a stream of the audio track of r without decoding the video tracks, e.g. for analyzing
+// the audio. The track is as PlayerOptions.AudioTrack.
+func newAudioOnlyStream(r io.ReadSeeker, track uint) (*stream, error) {
+	s, err := newStream(r, &PlayerOptions{AudioTrack: track}, false)
+	if err != nil {
+		return nil, err
+	}
+	if s.AudioStream() == nil {
+		s.close()
+		return nil, errors.New("webmplayer: no audio tracks")
+	}
 	return s, nil
 }
 
+// Seek moves the reading position to the nearest keyframe cluster before t by the Cues.
+// The decoders discard the packets already routed, reset their states, and decode forward to t.
+func (s *stream) Seek(t time.Duration) {
+	s.seekTo(t, false)
+}
+
+// scrub seeks to t as Seek does, but the video decoder presents only the first frame at t, and doesn't skip it as late.
+func (s *stream) scrub(t time.Duration) {
+	s.seekTo(t, true)
+}
+
+func (s *stream) seekTo(t time.Duration, scrub bool) {
+	s.seek.target.Store(int64(t))
+	s.seek.scrub.Store(scrub)
+	gen := s.seek.gen.Add(1)
+	// All the queued packets are before the seek. Discard them so that the reader doesn't wait for the decoders.
+	s.queue.flush()
+	// With Loop, the Cues and the keyframes are of a pass.
+	local := passTime(t, s.loop)
+	if s.prefetch != nil {
+		if i := sort.Search(len(s.cues), func(i int) bool { return s.cues[i].time > local }); i > 0 {
+			s.prefetch.prefetchAt(s.cues[i-1].offset)
+		}
+	}
+	// Without Cues, the reader can't find the keyframe before t by itself.
+	// Seek to the keyframe if the part is already read. The decoders still decode forward to t.
+	if s.keyframes != nil {
+		if k, ok := s.keyframes.before(local); ok {
+			t += k - local
+		}
+	}
+	s.seeks <- seekRequest{t: t, gen: gen}
+}
+
+// keyframeBefore returns the time of the last keyframe at or before t known by the Cues or the keyframes already read,
+// or the start of the pass including t.
+func (s *stream) keyframeBefore(t time.Duration) time.Duration {
+	local := passTime(t, s.loop)
+	base := t - local
+	if s.keyframes != nil {
+		if k, ok := s.keyframes.before(local); ok {
+			return base + k
+		}
+		return base
+	}
+	scale := time.Duration(s.meta.TimecodeScale)
+	if scale == 0 {
+		scale = time.Millisecond
+	}
+	var k time.Duration
+	for _, c := range s.meta.CuePoint {
+		if ct := time.Duration(c.CueTime) * scale; ct <= local && ct > k {
+			k = ct
+		}
+	}
+	return base + k
+}
+
+// prefetchSource returns the prefetching reader if r is made by NewPrefetchReader or NewSharedPrefetchReader.
+func prefetchSource(r io.ReadSeeker) (*prefetchReader, bool) {
+	if m, ok := r.(*measuredReader); ok {
+		r = m.r
+	}
+	p, ok := r.(*prefetchReader)
+	return p, ok
+}
+
+// findTrack returns the track of the number n that satisfies kind.
+// If n is 0, findTrack returns the first track that satisfies kind, or nil if there is no such track.
+// findTrack returns an error only if the stream has tracks of the kind, but not the track n.
+func findTrack(meta *webm.WebM, n uint, kind func(*webm.TrackEntry) bool) (*webm.TrackEntry, error) {
+	var first *webm.TrackEntry
+	for i := range meta.TrackEntry {
+		t := &meta.TrackEntry[i]
+		if !kind(t) {
+			continue
+		}
+		if n == 0 || t.TrackNumber == n {
+			return t, nil
+		}
+		if first == nil {
+			first = t
+		}
+	}
+	if first != nil {
+		return nil, fmt.Errorf("webmplayer: track %d not found", n)
+	}
+	return nil, nil
+}
+
+func (s *stream) newAudioDecoder(track *webm.TrackEntry) (*audioStream, error) {
+	if key, ok := s.pcmClipKey(track); ok {
+		// A track that fails to be predecoded is decoded as usual, which reports the error if any.
+		if clip, err := loadPCMClip(key, func() (*pcmClip, error) { return s.predecodeAudio(track) }); err == nil {
+			return &audioStream{
+				codec:             audioCodec(track.CodecID),
+				channels:          int(track.Channels),
+				samplingFrequency: clip.samplingFrequency,
+				src:               s.audioQueues[track.TrackNumber],
+				stream:            s,
+				clip:              clip,
+			}, nil
+		}
+	}
+	return newAudioDecoder(audioCodec(track.CodecID), track.CodecPrivate, int(track.Channels), int(track.SamplingFrequency), int(track.BitDepth), s.audioQueues[track.TrackNumber], s, s.options)
+}
+
+// switchAudioTrack returns a new decoder for the audio track n, which starts at pos without seeking the stream.
+// The packets of the track from pos are in its lookahead queue.
+// The switch is done when the returned function is called. The function must be called before the decoder is used.
+func (s *stream) switchAudioTrack(n uint, pos time.Duration) (*audioStream, func(), error) {
+	track, err := findTrack(&s.meta, n, (*webm.TrackEntry).IsAudio)
+	if err != nil {
+		return nil, nil, err
+	}
+	if track == nil {
+		return nil, nil, fmt.Errorf("webmplayer: no audio tracks")
+	}
+	a, err := s.newAudioDecoder(track)
+	if err != nil {
+		return nil, nil, err
+	}
+	a.startAt(pos)
+	return a, func() {
+		s.audioQueues[s.audioTrack.TrackNumber].setLookahead(true)
+		// No decoder consumes the packets of a predecoded track.
+		s.audioQueues[track.TrackNumber].setLookahead(a.clip != nil)
+		s.audioTrack = track
+		s.audioStream = a
+	}, nil
+}
+
+// close stops the goroutines of the stream and frees the decoders.
+// The audio player reading the audio stream must be closed before close.
+func (s *stream) close() {
+	// The packets already queued are not decoded.
+	s.queue.flush()
+	s.queue.close()
+	close(s.seeks)
+	if s.videoStream != nil {
+		s.videoStream.close()
+	}
+	if s.audioStream != nil {
+		s.audioStream.close()
+	}
+	s.task.End()
+}
+
+// pause pauses or resumes reading the input and decoding the video.
+func (s *stream) pause(paused bool) {
+	s.queue.pause(paused)
+}
+
+// setBackground makes the reader skip the data of the video, and the video queue not hold the reader back, so that
+// only the audio of the stream is read and decoded.
+func (s *stream) setBackground(background bool) {
+	if s.videoStream == nil {
+		return
+	}
+	var track uint
+	if background {
+		track = s.videoTrack.TrackNumber
+	}
+	s.reader.skipData(track)
+	s.videoStream.src.setLookahead(background)
+}
+
+func (s *stream) VideoTrack() *webm.TrackEntry {
+	return s.videoTrack
+}
+
+func (s *stream) AudioTrack() *webm.TrackEntry {
+	return s.audioTrack
+}
+
+// cue is a compact Cue point: the start time of a cluster and the cluster's offset in the source.
+type cue struct {
+	time   time.Duration
+	offset int64
+}
+
+// newCues returns the Cue points in the time order. segmentOffset is the offset of the Segment's data in the source.
+func newCues(meta *webm.WebM, segmentOffset int64) []cue {
+	scale := time.Duration(meta.TimecodeScale)
+	if scale == 0 {
+		scale = time.Millisecond
+	}
+	cues := make([]cue, 0, len(meta.CuePoint))
+	for _, c := range meta.CuePoint {
+		if len(c.CueTrackPositions) == 0 {
+			continue
+		}
+		cues = append(cues, cue{
+			time:   time.Duration(c.CueTime) * scale,
+			offset: segmentOffset + int64(c.CueTrackPositions[0].CueClusterPosition),
+		})
+	}
+	sort.Slice(cues, func(i, j int) bool {
+		return cues[i].time < cues[j].time
+	})
+	return cues
+}
+
 func (s *stream) Meta() *webm.WebM {
 	return &s.meta
 }
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"sort"
+	"sync"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+// SubtitleCue is a cue of a subtitle track.
+type SubtitleCue struct {
+	// Start and End are the time range the cue is shown in. End is Start plus the BlockDuration of the block. If the
+	// block has no duration, End is the start of the next cue read, or -1 if no cue is read after it yet.
+	Start time.Duration
+	End   time.Duration
+
+	// Text is the payload of the cue, e.g. the cue text of WebVTT with its tags.
+	Text string
+}
+
+// isSubtitleTrack reports whether t is a text track that the Player can show: WebVTT as Matroska and WebM define it,
+// or plain UTF-8 text.
+func isSubtitleTrack(t *webm.TrackEntry) bool {
+	switch t.CodecID {
+	case "S_TEXT/WEBVTT", "S_TEXT/UTF8", "D_WEBVTT/SUBTITLES", "D_WEBVTT/CAPTIONS", "D_WEBVTT/DESCRIPTIONS":
+		return true
+	}
+	return false
+}
+
+// subtitleIndex is the cues of a subtitle track by time. The demuxer adds the cues of the blocks as it reads them,
+// without sending them as packets, so the text tracks never wait in the demux queue with the audio and the video.
+// The cues read are kept across seeks, and a cue read again is not added twice.
+type subtitleIndex struct {
+	// webVTT is true for the WebM mapping of WebVTT, whose block starts with the identifier and the settings lines.
+	webVTT bool
+
+	m sync.Mutex
+
+	// cues is in the order of the start times, and longest is the longest duration of the cues with the durations.
+	cues    []SubtitleCue
+	longest time.Duration
+}
+
+func newSubtitleIndex(t *webm.TrackEntry) *subtitleIndex {
+	return &subtitleIndex{
+		webVTT: t.CodecID != "S_TEXT/WEBVTT" && t.CodecID != "S_TEXT/UTF8",
+	}
+}
+
+// add adds the cue of the block data at start, duration long. duration is negative if the block has no duration.
+func (x *subtitleIndex) add(data []byte, start, duration time.Duration) {
+	if x.webVTT {
+		// The identifier and the settings lines are not shown.
+		for range 2 {
+			if i := bytes.IndexByte(data, '\n'); i >= 0 {
+				data = data[i+1:]
+			} else {
+				data = nil
+			}
+		}
+	}
+	text := string(bytes.TrimRight(data, "\r\n"))
+
+	x.m.Lock()
+	defer x.m.Unlock()
+	i := sort.Search(len(x.cues), func(i int) bool { return x.cues[i].Start > start })
+	for j := i - 1; j >= 0 && x.cues[j].Start == start; j-- {
+		if x.cues[j].Text == text {
+			return
+		}
+	}
+	c := SubtitleCue{
+		Start: start,
+		End:   -1,
+		Text:  text,
+	}
+	if duration >= 0 {
+		c.End = start + duration
+		x.longest = max(x.longest, duration)
+	}
+	x.cues = append(x.cues, SubtitleCue{})
+	copy(x.cues[i+1:], x.cues[i:])
+	x.cues[i] = c
+}
+
+// appendAt appends the cues shown at t to dst in the order of the start times. The cues are found by a binary search,
+// and only the cues starting within the longest duration before t are checked.
+func (x *subtitleIndex) appendAt(dst []SubtitleCue, t time.Duration) []SubtitleCue {
+	x.m.Lock()
+	defer x.m.Unlock()
+	end := sort.Search(len(x.cues), func(i int) bool { return x.cues[i].Start > t })
+	start := end
+	for start > 0 && (x.cues[start-1].Start >= t-x.longest || x.cues[start-1].End < 0 && start == end) {
+		start--
+	}
+	for i := start; i < end; i++ {
+		c := x.cues[i]
+		if c.End < 0 {
+			// A cue without the duration is shown until the next cue.
+			if i != end-1 {
+				continue
+			}
+			if end < len(x.cues) {
+				c.End = x.cues[end].Start
+			}
+		} else if c.End <= t {
+			continue
+		}
+		dst = append(dst, c)
+	}
+	return dst
+}
@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"image"
+	"image/draw"
+	"io"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+const defaultThumbnailCount = 10
+
+// ThumbnailOptions represents options for Thumbnails.
+type ThumbnailOptions struct {
+	// Count is the number of the thumbnails, which are taken at evenly spaced times from the start.
+	//
+	// If Count is 0, 10 is used.
+	Count int
+
+	// Width and Height are the size of the thumbnails. A keyframe is downscaled by the largest integer factor that
+	// keeps it at least the size, as PlayerOptions.VideoTargetWidth and PlayerOptions.VideoTargetHeight do.
+	//
+	// If Width and Height are 0, the thumbnails have the size of the video.
+	Width  int
+	Height int
+
+	// VideoTrack is the track number of the video. If VideoTrack is 0, the first video track is used.
+	VideoTrack uint
+
+	// VideoDecoderThreads is the number of threads the video decoder uses. If VideoDecoderThreads is 0, 1 is used.
+	VideoDecoderThreads int
+}
+
+// Thumbnail is a thumbnail made by Thumbnails.
+type Thumbnail struct {
+	// Time is the timecode of the keyframe of the thumbnail.
+	Time time.Duration
+
+	// Image is the keyframe. Image is an *image.YCbCr or an *image.RGBA.
+	Image image.Image
+}
+
+// Thumbnails makes thumbnails of the video in r at evenly spaced times, e.g. for a scrub bar.
+// Each thumbnail is the last keyframe at or before its time. Only the keyframes are decoded, so Thumbnails runs
+// much faster than the playback.
+//
+// If the input has Cues, Thumbnails seeks to each time and reads only the clusters of the thumbnails. Otherwise,
+// Thumbnails reads the whole input once.
+// The same keyframe can be the thumbnail of multiple times, if the keyframes are sparse. A time without a keyframe
+// to show is skipped, so the thumbnails can be fewer than ThumbnailOptions.Count.
+func Thumbnails(r io.ReadSeeker, options *ThumbnailOptions) ([]Thumbnail, error) {
+	if options == nil {
+		options = &ThumbnailOptions{}
+	}
+	count := options.Count
+	if count <= 0 {
+		count = defaultThumbnailCount
+	}
+	threads := max(options.VideoDecoderThreads, 1)
+
+	var meta webm.WebM
+	reader, _, err := parseWebM(r, &meta)
+	if err != nil {
+		return nil, err
+	}
+	defer closeReader(reader)
+
+	track, err := findTrack(&meta, options.VideoTrack, (*webm.TrackEntry).IsVideo)
+	if err != nil {
+		return nil, err
+	}
+	if track == nil {
+		return nil, fmt.Errorf("webmplayer: no video track")
+	}
+	duration := meta.GetDuration()
+	if duration <= 0 {
+		return nil, fmt.Errorf("webmplayer: the duration of the video is unknown")
+	}
+
+	codec := videoCodec(track.CodecID)
+	decoder, err := newVideoDecoder(codec, threads)
+	if err != nil {
+		return nil, err
+	}
+	defer decoder.destroy()
+	if err := decoder.start(track.CodecPrivate); err != nil {
+		return nil, err
+	}
+
+	t := &thumbnailer{
+		reader:  reader,
+		track:   track.TrackNumber,
+		codec:   codec,
+		decoder: decoder,
+		width:   options.Width,
+		height:  options.Height,
+	}
+	times := make([]time.Duration, count)
+	for i := range times {
+		times[i] = duration * time.Duration(i) / time.Duration(count)
+	}
+	if len(meta.CuePoint) > 0 {
+		err = t.seekEach(times)
+	} else {
+		err = t.scan(times)
+	}
+	if err != nil {
+		return nil, err
+	}
+	return t.thumbnails, nil
+}
+
+// ThumbnailsFromFile runs Thumbnails with a local WebM file, which is opened as NewPlayerFromFile opens.
+func ThumbnailsFromFile(path string, options *ThumbnailOptions) ([]Thumbnail, error) {
+	r, err := openFile(path)
+	if err != nil {
+		return nil, err
+	}
+	return Thumbnails(r, options)
+}
+
+// ThumbnailSheet draws the thumbnails in order into a sprite sheet with columns columns.
+// Each cell has the size of the largest thumbnail, and thumbnails[i] is at the top-left of the cell (i%columns,
+// i/columns).
+func ThumbnailSheet(thumbnails []Thumbnail, columns int) *image.RGBA {
+	columns = max(columns, 1)
+	var cell image.Point
+	for _, t := range thumbnails {
+		cell.X = max(cell.X, t.Image.Bounds().Dx())
+		cell.Y = max(cell.Y, t.Image.Bounds().Dy())
+	}
+	rows := (len(thumbnails) + columns - 1) / columns
+	sheet := image.NewRGBA(image.Rect(0, 0, cell.X*min(columns, len(thumbnails)), cell.Y*rows))
+	for i, t := range thumbnails {
+		b := t.Image.Bounds()
+		p := image.Pt(i%columns*cell.X, i/columns*cell.Y)
+		draw.Draw(sheet, image.Rectangle{Min: p, Max: p.Add(b.Size())}, t.Image, b.Min, draw.Src)
+	}
+	return sheet
+}
+
+// thumbnailer decodes the keyframes of Thumbnails.
+type thumbnailer struct {
+	reader  *webmReader
+	track   uint
+	codec   videoCodec
+	decoder videoDecoder
+
+	width  int
+	height int
+
+	thumbnails []Thumbnail
+}
+
+// keyframe reports whether pkt is a keyframe of the video.
+func (t *thumbnailer) keyframe(pkt *webm.Packet) bool {
+	if pkt.TrackNumber != t.track || len(pkt.Data) == 0 {
+		return false
+	}
+	return pkt.Keyframe || parseVPXFrame(t.codec, pkt.Data).keyframe
+}
+
+// add decodes the keyframe pkt and adds it as a thumbnail. add reports false if the keyframe has no frame to show.
+func (t *thumbnailer) add(pkt *webm.Packet) (bool, error) {
+	// The keyframe was decoded for the previous time.
+	if n := len(t.thumbnails); n > 0 && t.thumbnails[n-1].Time == pkt.Timecode {
+		t.thumbnails = append(t.thumbnails, t.thumbnails[n-1])
+		return true, nil
+	}
+
+	// A keyframe resets the decoder state, so the keyframes can be decoded in any order.
+	if err := t.decoder.decode(pkt.Data); err != nil {
+		return false, err
+	}
+	var f videoFrame
+	var decoded bool
+	for {
+		p, ok, err := t.decoder.next()
+		if err != nil {
+			return false, err
+		}
+		if !ok {
+			break
+		}
+		f.setImage(&p, t.width, t.height)
+		decoded = true
+	}
+	if !decoded {
+		return false, nil
+	}
+	thumb := Thumbnail{
+		Time:  pkt.Timecode,
+		Image: f.image(),
+	}
+	t.thumbnails = append(t.thumbnails, thumb)
+	return true, nil
+}
+
+// seekEach seeks to the cluster of each time by the Cues, and decodes the first keyframe there.
+func (t *thumbnailer) seekEach(times []time.Duration) error {
+	for _, tc := range times {
+		pkt, ok := seekReader(t.reader, tc)
+		for ok && pkt.Timecode != webm.BadTC {
+			if t.keyframe(&pkt.Packet) {
+				added, err := t.add(&pkt.Packet)
+				if err != nil {
+					return err
+				}
+				if added {
+					break
+				}
+			}
+			pkt, ok = <-t.reader.Chan
+		}
+	}
+	return nil
+}
+
+// scan reads the whole input, and decodes the last keyframe before each time.
+func (t *thumbnailer) scan(times []time.Duration) error {
+	var last demuxPacket
+	var hasLast bool
+	i := 0
+	for pkt := range t.reader.Chan {
+		if pkt.Timecode == webm.BadTC {
+			break
+		}
+		if !t.keyframe(&pkt.Packet) {
+			continue
+		}
+		for i < len(times) && pkt.Timecode > times[i] {
+			// The first keyframe is used for the times before it.
+			k := &pkt
+			if hasLast {
+				k = &last
+			}
+			if _, err := t.add(&k.Packet); err != nil {
+				return err
+			}
+			i++
+		}
+		if i == len(times) {
+			return nil
+		}
+		last = pkt
+		hasLast = true
+	}
+	for ; i < len(times) && hasLast; i++ {
+		if _, err := t.add(&last.Packet); err != nil {
+			return err
+		}
+	}
+	return nil
+}
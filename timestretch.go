@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"sync"
+	"time"
+	"unsafe"
+)
+
+const (
+	// stretchSegment is the length of a WSOLA segment. Segments overlap by halves.
+	stretchSegment = 40 * time.Millisecond
+
+	// stretchSearch is the range to search the best-matching input segment in each direction.
+	stretchSearch = 10 * time.Millisecond
+)
+
+// timeStretcher changes the speed of a stereo float32 stream without changing the pitch, by WSOLA
+// (waveform-similarity overlap-add).
+//
+// For each output segment, the input segment around the position advanced by the rate is chosen so that its
+// waveform matches the natural continuation of the previous segment best. The segments are windowed by Hann windows
+// and overlap-added.
+//
+// At the rate 1, the input passes through untouched.
+type timeStretcher struct {
+	src io.ReadSeeker
+
+	// n is the segment length and hs is the output hop in frames. search is the search range in frames.
+	n      int
+	hs     int
+	search int
+	window []float32
+
+	m     sync.Mutex
+	rate  float64
+	marks []stretchMark
+
+	// The fields below are used only by Read and Seek.
+
+	// applied is the rate being applied.
+	applied float64
+
+	// active is true while WSOLA is running.
+	active bool
+
+	// in is the buffered input, and inStart is the frame of in[0].
+	in      []float32
+	inStart int64
+	eof     bool
+
+	// passPos is the frame to be read next while passing through.
+	passPos int64
+
+	// ideal is the input frame for the next segment by the rate, and prev is the start frame of the previous segment.
+	ideal float64
+	prev  int64
+
+	// over is the second half of the previous windowed segment, and out[outHead:] is the output not returned yet.
+	over    []float32
+	out     []float32
+	outHead int
+
+	// outFrame is the output frame, counted from the position of the latest seek.
+	outFrame int64
+}
+
+// stretchMark maps an output frame to an input frame after a change of the rate.
+type stretchMark struct {
+	out  int64
+	in   float64
+	rate float64
+}
+
+func newTimeStretcher(src io.ReadSeeker, sampleRate int, rate float64) *timeStretcher {
+	n := int(int64(sampleRate)*int64(stretchSegment)/int64(time.Second)) &^ 1
+	t := &timeStretcher{
+		src:     src,
+		n:       n,
+		hs:      n / 2,
+		search:  int(int64(sampleRate) * int64(stretchSearch) / int64(time.Second)),
+		window:  make([]float32, n),
+		rate:    rate,
+		applied: 1,
+		over:    make([]float32, n),
+		marks:   []stretchMark{{rate: 1}},
+	}
+	for i := range t.window {
+		t.window[i] = float32(0.5 - 0.5*math.Cos(2*math.Pi*float64(i)/float64(n)))
+	}
+	return t
+}
+
+// setRate sets the playback rate. setRate can be called from any goroutine.
+func (t *timeStretcher) setRate(rate float64) {
+	t.m.Lock()
+	defer t.m.Unlock()
+	t.rate = rate
+}
+
+// mediaPosition converts the output position to the position of the input.
+func (t *timeStretcher) mediaPosition(pos time.Duration, sampleRate int) time.Duration {
+	t.m.Lock()
+	defer t.m.Unlock()
+	out := int64(pos) * int64(sampleRate) / int64(time.Second)
+	m := t.marks[0]
+	for _, mk := range t.marks[1:] {
+		if mk.out > out {
+			break
+		}
+		m = mk
+	}
+	in := m.in + float64(out-m.out)*m.rate
+	return time.Duration(in * float64(time.Second) / float64(sampleRate))
+}
+
+// mark records the mapping from the current output frame to the input frame in at the rate.
+func (t *timeStretcher) mark(in float64, rate float64) {
+	t.m.Lock()
+	defer t.m.Unlock()
+	// The old marks are not needed after the output is played. 16 marks are more than enough for the audio buffer.
+	if len(t.marks) >= 16 {
+		t.marks = t.marks[:copy(t.marks, t.marks[1:])]
+	}
+	t.marks = append(t.marks, stretchMark{
+		out:  t.outFrame,
+		in:   in,
+		rate: rate,
+	})
+}
+
+func (t *timeStretcher) Read(buf []byte) (int, error) {
+	t.m.Lock()
+	rate := t.rate
+	t.m.Unlock()
+
+	if rate != t.applied {
+		if err := t.apply(rate); err != nil {
+			return 0, err
+		}
+	}
+
+	if t.outHead == len(t.out) {
+		t.out = t.out[:0]
+		t.outHead = 0
+	}
+	if !t.active && len(t.out) == 0 {
+		return t.pass(buf)
+	}
+
+	dst := unsafe.Slice((*float32)(unsafe.Pointer(unsafe.SliceData(buf))), len(buf)/4)
+	for t.active && len(t.out) == 0 {
+		ok, err := t.step()
+		if err != nil {
+			return 0, err
+		}
+		if !ok {
+			break
+		}
+	}
+	if len(t.out) == 0 {
+		return 0, io.EOF
+	}
+	n := copy(dst[:len(dst)&^1], t.out[t.outHead:])
+	t.outHead += n
+	return 4 * n, nil
+}
+
+// pass reads the input as it is.
+func (t *timeStretcher) pass(buf []byte) (int, error) {
+	buf = buf[:len(buf)/bytesPerFrame*bytesPerFrame]
+	// Return the input already buffered for WSOLA first.
+	if end := t.inStart + int64(len(t.in)/2); t.passPos < end {
+		src := unsafe.Slice((*byte)(unsafe.Pointer(unsafe.SliceData(t.in))), 4*len(t.in))
+		n := copy(buf, src[(t.passPos-t.inStart)*bytesPerFrame:])
+		t.passPos += int64(n / bytesPerFrame)
+		t.outFrame += int64(n / bytesPerFrame)
+		return n, nil
+	}
+	if t.eof {
+		return 0, io.EOF
+	}
+	t.in = t.in[:0]
+	n, err := t.src.Read(buf)
+	t.passPos += int64(n / bytesPerFrame)
+	t.inStart = t.passPos
+	t.outFrame += int64(n / bytesPerFrame)
+	return n, err
+}
+
+// apply changes the rate being applied at the current output frame.
+func (t *timeStretcher) apply(rate float64) error {
+	switch {
+	case !t.active && rate != 1:
+		// Start WSOLA as if the previous segment ended at passPos, so that the output continues seamlessly.
+		if err := t.fill(t.passPos + int64(t.hs)); err != nil {
+			return err
+		}
+		t.prev = t.passPos - int64(t.hs)
+		t.ideal = float64(t.passPos)
+		for i := 0; i < t.hs; i++ {
+			w := t.window[t.hs+i]
+			l, r := t.at(t.passPos + int64(i))
+			t.over[2*i] = w * l
+			t.over[2*i+1] = w * r
+		}
+		t.active = true
+		t.mark(t.ideal, rate)
+	case t.active && rate == 1:
+		// Finish the overlap with the fade-in of the natural continuation, and pass through after it.
+		start := t.prev + int64(t.hs)
+		if err := t.fill(start + int64(t.hs)); err != nil {
+			return err
+		}
+		for i := 0; i < t.hs; i++ {
+			w := t.window[i]
+			l, r := t.at(start + int64(i))
+			t.out = append(t.out, t.over[2*i]+w*l, t.over[2*i+1]+w*r)
+		}
+		t.outFrame += int64(t.hs)
+		t.passPos = start + int64(t.hs)
+		t.active = false
+		t.mark(float64(t.passPos), 1)
+	default:
+		t.mark(t.ideal, rate)
+	}
+	t.applied = rate
+	return nil
+}
+
+// step produces the output of a segment. step returns false at the end of the input.
+func (t *timeStretcher) step() (bool, error) {
+	ideal := int64(math.Round(t.ideal))
+	if err := t.fill(ideal + int64(t.search+t.n)); err != nil {
+		return false, err
+	}
+	if t.eof && ideal >= t.inStart+int64(len(t.in)/2) {
+		return false, nil
+	}
+
+	start := ideal + int64(t.bestOffset(ideal))
+	start = max(start, t.inStart)
+
+	hs := t.hs
+	for i := 0; i < hs; i++ {
+		w := t.window[i]
+		l, r := t.at(start + int64(i))
+		t.out = append(t.out, t.over[2*i]+w*l, t.over[2*i+1]+w*r)
+	}
+	for i := 0; i < hs; i++ {
+		w := t.window[hs+i]
+		l, r := t.at(start + int64(hs+i))
+		t.over[2*i] = w * l
+		t.over[2*i+1] = w * r
+	}
+	t.outFrame += int64(hs)
+	t.prev = start
+	t.ideal += float64(hs) * t.applied
+
+	// Drop the input that is no longer needed.
+	keep := min(int64(math.Round(t.ideal))-int64(t.search), t.prev+int64(hs))
+	if drop := keep - t.inStart; drop > 0 && int(drop) >= len(t.in)/4 {
+		drop = min(drop, int64(len(t.in)/2))
+		t.in = t.in[:copy(t.in, t.in[2*drop:])]
+		t.inStart += drop
+	}
+	return true, nil
+}
+
+// bestOffset returns the offset from ideal within the search range, where the input matches the natural continuation
+// of the previous segment best.
+//
+// The search is coarse-to-fine on the mono mix: every 4th offset with every 2nd frame first, and then every offset
+// around the best one.
+func (t *timeStretcher) bestOffset(ideal int64) int {
+	natural := t.prev + int64(t.hs)
+	if natural == ideal {
+		return 0
+	}
+	best, bestScore := 0, math.Inf(-1)
+	for d := -t.search; d <= t.search; d += 4 {
+		if s := t.similarity(natural, ideal+int64(d), 2); s > bestScore {
+			best, bestScore = d, s
+		}
+	}
+	coarse := best
+	for d := max(coarse-3, -t.search); d <= min(coarse+3, t.search); d++ {
+		if d == coarse {
+			continue
+		}
+		if s := t.similarity(natural, ideal+int64(d), 1); s > bestScore {
+			best, bestScore = d, s
+		}
+	}
+	return best
+}
+
+// similarity returns the normalized cross-correlation between the half segments at a and b, with the stride.
+func (t *timeStretcher) similarity(a, b int64, stride int) float64 {
+	if b < t.inStart || a < t.inStart {
+		return math.Inf(-1)
+	}
+	end := t.inStart + int64(len(t.in)/2)
+	n := min(int64(t.hs), end-a, end-b)
+	if n <= 0 {
+		return math.Inf(-1)
+	}
+	x := t.in[2*(a-t.inStart) : 2*(a-t.inStart+n)]
+	y := t.in[2*(b-t.inStart) : 2*(b-t.inStart+n)]
+	// Four frames at once, so that the loop has independent accumulators.
+	var c0, c1, c2, c3, e0, e1, e2, e3 float32
+	step := 2 * stride
+	i := 0
+	for ; i+4*step <= len(x); i += 4 * step {
+		x0, y0 := x[i]+x[i+1], y[i]+y[i+1]
+		x1, y1 := x[i+step]+x[i+step+1], y[i+step]+y[i+step+1]
+		x2, y2 := x[i+2*step]+x[i+2*step+1], y[i+2*step]+y[i+2*step+1]
+		x3, y3 := x[i+3*step]+x[i+3*step+1], y[i+3*step]+y[i+3*step+1]
+		c0 += x0 * y0
+		c1 += x1 * y1
+		c2 += x2 * y2
+		c3 += x3 * y3
+		e0 += y0 * y0
+		e1 += y1 * y1
+		e2 += y2 * y2
+		e3 += y3 * y3
+	}
+	for ; i+1 < len(x); i += step {
+		x0, y0 := x[i]+x[i+1], y[i]+y[i+1]
+		c0 += x0 * y0
+		e0 += y0 * y0
+	}
+	c := float64(c0 + c1 + c2 + c3)
+	e := float64(e0 + e1 + e2 + e3)
+	return c / math.Sqrt(e+1e-9)
+}
+
+// at returns the input frame f. The frames after the end of the input are silent.
+func (t *timeStretcher) at(f int64) (float32, float32) {
+	i := 2 * (f - t.inStart)
+	if i < 0 || i+1 >= int64(len(t.in)) {
+		return 0, 0
+	}
+	return t.in[i], t.in[i+1]
+}
+
+// fill reads the input until the frame end is buffered or the input ends.
+func (t *timeStretcher) fill(end int64) error {
+	var buf [4096]byte
+	for !t.eof && t.inStart+int64(len(t.in)/2) < end {
+		n, err := t.src.Read(buf[:])
+		t.in = append(t.in, unsafe.Slice((*float32)(unsafe.Pointer(&buf[0])), n/4)...)
+		if err == io.EOF {
+			t.eof = true
+			break
+		}
+		if err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// Seek implements io.Seeker. offset is in bytes of the input, as the output position at a seek is the input position.
+func (t *timeStretcher) Seek(offset int64, whence int) (int64, error) {
+	switch whence {
+	case io.SeekStart:
+	default:
+		return 0, fmt.Errorf("webmplayer: unsupported whence: %d", whence)
+	}
+	if offset < 0 {
+		return 0, errors.New("webmplayer: negative position")
+	}
+	n, err := t.src.Seek(offset, io.SeekStart)
+	if err != nil {
+		return 0, err
+	}
+	f := n / bytesPerFrame
+	t.in = t.in[:0]
+	t.inStart = f
+	t.passPos = f
+	t.eof = false
+	t.out = t.out[:0]
+	t.outHead = 0
+	t.active = false
+	t.applied = 1
+	t.outFrame = f
+
+	t.m.Lock()
+	t.marks = append(t.marks[:0], stretchMark{out: f, in: float64(f), rate: 1})
+	t.m.Unlock()
+	return n, nil
+}
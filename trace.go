@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"context"
+	"runtime/pprof"
+	"runtime/trace"
+	"strconv"
+	"sync/atomic"
+)
+
+// streamSerial is the serial number of the streams for the labels.
+var streamSerial atomic.Int64
+
+// initTrace starts the trace task of s, and makes the pprof labels of s.
+//
+// The goroutines of a stream have the pprof labels webmplayer.input, the serial number of the input,
+// webmplayer.player, PlayerOptions.Label if any, and webmplayer.stage, the stage of the pipeline, so that CPU
+// profiles can be split by the inputs and the stages with -tagfocus.
+func (s *stream) initTrace(options *PlayerOptions) {
+	s.labels = []string{"webmplayer.input", strconv.FormatInt(streamSerial.Add(1), 10)}
+	if options.Label != "" {
+		s.labels = append(s.labels, "webmplayer.player", options.Label)
+	}
+	s.ctx, s.task = trace.NewTask(context.Background(), "webmplayer.stream")
+}
+
+// run calls f with the pprof labels of s and the stage. The goroutines started by f inherit the labels.
+// ctx is the context of the trace task of s for trace regions.
+func (s *stream) run(stage string, f func(ctx context.Context)) {
+	args := make([]string, 0, len(s.labels)+2)
+	args = append(args, s.labels...)
+	args = append(args, "webmplayer.stage", stage)
+	pprof.Do(s.ctx, pprof.Labels(args...), f)
+}
@@ -0,0 +1,333 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+const (
+	// trimReadAhead is how far past the end time the blocks are read, as the blocks of the tracks are interleaved
+	// roughly in the time order.
+	trimReadAhead = time.Second
+
+	// maxTrimClusterDuration is the longest Cluster without a keyframe, within the 16-bit relative timecodes of the
+	// blocks at the usual timecode scale.
+	maxTrimClusterDuration = 30 * time.Second
+)
+
+// TrimOptions is the options of Trim.
+type TrimOptions struct {
+	// Start and End are the range to copy. The copy starts at the last video keyframe at or before Start, so that the
+	// copy can be decoded without the blocks before it, and has the blocks before End.
+	//
+	// If End is 0, the copy ends at the end of the input.
+	Start time.Duration
+	End   time.Duration
+}
+
+// Trim copies the blocks of the WebM input r between two times to a new WebM file written to w, without decoding or
+// encoding them. The timecodes are shifted so that the copy starts at 0.
+//
+// A Cluster is written for each video keyframe, and the Cues of the copy point to them. The input is read twice:
+// first to lay out the Clusters and the Cues, which are written before the Clusters, and then to copy the blocks, so
+// that w doesn't have to be seekable. The blocks are written in chunks on another goroutine while the next blocks are
+// read.
+//
+// The laced frames are written in their own blocks, and the BlockGroup elements other than the block, e.g.
+// BlockDuration and DiscardPadding, are not kept.
+func Trim(w io.Writer, r io.ReadSeeker, options *TrimOptions) error {
+	if options == nil {
+		options = &TrimOptions{}
+	}
+	end := options.End
+	if end <= 0 {
+		end = math.MaxInt64 - trimReadAhead
+	}
+	if end <= options.Start {
+		return fmt.Errorf("webmplayer: the end %v is not after the start %v", end, options.Start)
+	}
+
+	var meta webm.WebM
+	reader, colors, err := parseWebM(r, &meta)
+	if err != nil {
+		return err
+	}
+	defer closeReader(reader)
+
+	t := &trimmer{
+		reader: reader,
+		meta:   &meta,
+		scale:  time.Duration(meta.TimecodeScale),
+		codecs: map[uint]videoCodec{},
+	}
+	for _, tr := range meta.TrackEntry {
+		if tr.IsVideo() {
+			t.codecs[tr.TrackNumber] = videoCodec(tr.CodecID)
+		}
+	}
+	if v := meta.FindFirstVideoTrack(); v != nil {
+		t.video = v.TrackNumber
+	}
+	if err := t.scan(options.Start, end); err != nil {
+		return err
+	}
+	t.layout()
+
+	// The duration is up to End or the end of the input, or the last block if neither is known.
+	duration := t.last
+	if d := meta.GetDuration(); d > 0 {
+		duration = d
+	}
+	if options.End > 0 {
+		duration = min(duration, options.End)
+	}
+	if _, err := w.Write(t.headers(colors, duration-t.start)); err != nil {
+		return err
+	}
+	return t.copy(w, options.Start)
+}
+
+// TrimFromFile runs Trim with a local WebM file, which is opened as NewPlayerFromFile opens.
+func TrimFromFile(w io.Writer, path string, options *TrimOptions) error {
+	r, err := openFile(path)
+	if err != nil {
+		return err
+	}
+	return Trim(w, r, options)
+}
+
+// trimBlock is a block read by the first pass of Trim.
+type trimBlock struct {
+	track    uint
+	timecode time.Duration
+	size     int
+	flags    byte
+
+	// kept reports whether the block is copied, and cluster reports whether the block starts a Cluster.
+	kept    bool
+	cluster bool
+}
+
+// trimCluster is a Cluster of the copy.
+type trimCluster struct {
+	timecode time.Duration
+	size     uint64
+
+	// cue reports whether the Cluster starts with a video keyframe.
+	cue bool
+}
+
+// trimmer is the state of Trim.
+type trimmer struct {
+	reader *webmReader
+	meta   *webm.WebM
+	scale  time.Duration
+
+	// video is the track number of the video track cut at the keyframes, or 0, and codecs is the codecs of the video
+	// tracks.
+	video  uint
+	codecs map[uint]videoCodec
+
+	// blocks is the blocks read from the seek to the start, and clusters is the layout of the copy.
+	blocks   []trimBlock
+	clusters []trimCluster
+
+	// start is the timecode the copy starts at, and last is the last timecode copied.
+	start time.Duration
+	last  time.Duration
+}
+
+// scan reads the blocks from the cluster before start until after end, and decides the blocks to copy.
+func (t *trimmer) scan(start, end time.Duration) error {
+	t.start = -1
+	pkt, ok := seekReader(t.reader, start)
+	for ok && pkt.Timecode != webm.BadTC && pkt.Timecode < end+trimReadAhead {
+		b := trimBlock{
+			track:    pkt.TrackNumber,
+			timecode: pkt.Timecode,
+			size:     len(pkt.Data),
+			flags:    t.flags(&pkt.Packet),
+		}
+		if b.timecode < end {
+			// The copy starts at the last video keyframe at or before start, or the first one after it.
+			if b.track == t.video && b.flags&0x80 != 0 && (b.timecode <= start || t.start < 0) {
+				t.start = b.timecode
+			}
+			if t.video == 0 && t.start < 0 && b.timecode >= start {
+				t.start = b.timecode
+			}
+		}
+		t.blocks = append(t.blocks, b)
+		pkt, ok = <-t.reader.Chan
+	}
+	if t.start < 0 {
+		return errors.New("webmplayer: no blocks to copy in the range")
+	}
+
+	// The video blocks before the first keyframe copied refer to the frames not copied.
+	started := t.video == 0
+	for i := range t.blocks {
+		b := &t.blocks[i]
+		if b.timecode < t.start || b.timecode >= end {
+			continue
+		}
+		if b.track == t.video && b.timecode == t.start && b.flags&0x80 != 0 {
+			started = true
+		}
+		if !started {
+			continue
+		}
+		b.kept = true
+		t.last = max(t.last, b.timecode)
+	}
+	return nil
+}
+
+// flags returns the flags of the SimpleBlock of pkt. The video keyframes in BlockGroups are found by the bitstream.
+func (t *trimmer) flags(pkt *webm.Packet) byte {
+	codec, video := t.codecs[pkt.TrackNumber]
+	keyframe := !video || pkt.Keyframe || len(pkt.Data) > 0 && parseVPXFrame(codec, pkt.Data).keyframe
+	return simpleBlockFlags(keyframe, pkt.Invisible, pkt.Discardable)
+}
+
+// layout splits the blocks to copy into Clusters.
+func (t *trimmer) layout() {
+	var c *trimCluster
+	for i := range t.blocks {
+		b := &t.blocks[i]
+		if !b.kept {
+			continue
+		}
+		tc := b.timecode - t.start
+		keyframe := b.track == t.video && b.flags&0x80 != 0
+		// The relative timecodes of the blocks are 16-bit.
+		if c == nil || keyframe || tc-c.timecode >= maxTrimClusterDuration || (tc-c.timecode)/t.scale > math.MaxInt16 || (tc-c.timecode)/t.scale < math.MinInt16 {
+			t.clusters = append(t.clusters, trimCluster{
+				timecode: tc,
+				cue:      keyframe || t.video == 0,
+			})
+			c = &t.clusters[len(t.clusters)-1]
+			c.size = uint64(len(appendEBMLUint(nil, 0xe7, uint64(tc/t.scale))))
+			b.cluster = true
+		}
+		c.size += simpleBlockSize(b.track, b.size)
+	}
+}
+
+// headers returns the EBML header, and the Segment up to the first Cluster: the SeekHead, the Info, the Tracks and
+// the Cues.
+func (t *trimmer) headers(colors map[uint]trackColor, duration time.Duration) []byte {
+	var info []byte
+	info = appendEBMLUint(info, 0x2ad7b1, uint64(t.scale))
+	info = appendEBMLFloat(info, 0x4489, float64(duration)/float64(t.scale))
+	info = appendEBMLString(info, 0x4d80, "webmplayer") // MuxingApp
+	info = appendEBMLString(info, 0x5741, "webmplayer") // WritingApp
+	info = appendEBMLMaster(nil, 0x1549a966, info)
+
+	tracks := webmTracks(t.meta.TrackEntry, colors)
+
+	cueTrack := t.video
+	if cueTrack == 0 && len(t.meta.TrackEntry) > 0 {
+		cueTrack = t.meta.TrackEntry[0].TrackNumber
+	}
+	// The positions are written in 8 bytes, so that the size of the Cues doesn't depend on them.
+	cues := func(first uint64) []byte {
+		var cs []byte
+		pos := first
+		for _, c := range t.clusters {
+			if c.cue {
+				var p []byte
+				p = appendEBMLUint(p, 0xf7, uint64(cueTrack))
+				p = appendEBMLFixedUint(p, 0xf1, pos)
+				var cp []byte
+				cp = appendEBMLUint(cp, 0xb3, uint64(c.timecode/t.scale))
+				cp = appendEBMLMaster(cp, 0xb7, p)
+				cs = appendEBMLMaster(cs, 0xbb, cp)
+			}
+			pos += uint64(len(appendEBMLHeader(nil, 0x1f43b675, c.size))) + c.size
+		}
+		return appendEBMLMaster(nil, 0x1c53bb6b, cs)
+	}
+
+	shSize := uint64(len(muxerSeekHead(0, 0, 0)))
+	infoPos := shSize
+	tracksPos := infoPos + uint64(len(info))
+	cuesPos := tracksPos + uint64(len(tracks))
+	cuesSize := uint64(len(cues(0)))
+	firstCluster := cuesPos + cuesSize
+
+	var segment []byte
+	segment = append(segment, muxerSeekHead(infoPos, tracksPos, cuesPos)...)
+	segment = append(segment, info...)
+	segment = append(segment, tracks...)
+	segment = append(segment, cues(firstCluster)...)
+
+	size := uint64(len(segment))
+	for _, c := range t.clusters {
+		size += uint64(len(appendEBMLHeader(nil, 0x1f43b675, c.size))) + c.size
+	}
+	h := webmHeader()
+	h = appendEBMLHeader(h, 0x18538067, size)
+	return append(h, segment...)
+}
+
+// copy reads the blocks again from the cluster before start, and writes the Clusters laid out by layout.
+func (t *trimmer) copy(w io.Writer, start time.Duration) error {
+	cw := newClusterWriter(w)
+	err := t.copyBlocks(cw, start)
+	if cerr := cw.close(); err == nil {
+		err = cerr
+	}
+	return err
+}
+
+func (t *trimmer) copyBlocks(cw *clusterWriter, start time.Duration) error {
+	// The sizes of the Clusters are known, so a buffer can end in the middle of a Cluster.
+	buf := cw.buffer()
+	clusters := t.clusters
+	var cluster time.Duration
+	pkt, ok := seekReader(t.reader, start)
+
+	// The seek can land on a later Cluster than the first pass, as the reader learns the Clusters while reading, but
+	// not after the first block copied.
+	i := 0
+	for i < len(t.blocks) && !t.blocks[i].kept && (t.blocks[i].track != pkt.TrackNumber || t.blocks[i].timecode != pkt.Timecode) {
+		i++
+	}
+	for ; i < len(t.blocks); i++ {
+		b := &t.blocks[i]
+		if !ok || pkt.Timecode == webm.BadTC || pkt.TrackNumber != b.track || pkt.Timecode != b.timecode || len(pkt.Data) != b.size {
+			cw.pool.Put(buf)
+			return errors.New("webmplayer: the input changed while trimming")
+		}
+		if b.kept {
+			if b.cluster {
+				c := clusters[0]
+				clusters = clusters[1:]
+				cluster = c.timecode
+				*buf = appendEBMLHeader(*buf, 0x1f43b675, c.size)
+				*buf = appendEBMLUint(*buf, 0xe7, uint64(cluster/t.scale))
+			}
+			rel := int16((b.timecode - t.start - cluster) / t.scale)
+			*buf = appendSimpleBlock(*buf, b.track, rel, b.flags, pkt.Data)
+			if len(*buf) >= clusterWriterChunk {
+				if err := cw.write(buf); err != nil {
+					return err
+				}
+				buf = cw.buffer()
+			}
+		}
+		if i < len(t.blocks)-1 {
+			pkt, ok = <-t.reader.Chan
+		}
+	}
+	return cw.write(buf)
+}
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/hajimehoshi/webmplayer/internal/dav1d"
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// videoDecoder is a decoder of a video codec.
+type videoDecoder interface {
+	// start prepares the decoder for a stream with the CodecPrivate data of the track. A decoder can decode another
+	// stream of the same codec after start.
+	start(codecPrivate []byte) error
+
+	// decode decodes a packet. data is not used after decode returns.
+	decode(data []byte) error
+
+	// next returns the next picture decoded from the packets, or false if there is none.
+	// The picture is valid until the next call of next or decode.
+	next() (videoPicture, bool, error)
+
+	// setSkipLoopFilter makes the decoder skip the loop filter to decode faster, if the decoder supports it.
+	// start turns it off.
+	setSkipLoopFilter(skip bool)
+
+	// setSpatialLayer makes the decoder decode the spatial layers of a VP9 SVC stream up to layer, or all the layers
+	// if layer is negative, if the decoder supports it. start turns it off.
+	setSpatialLayer(layer int)
+
+	destroy()
+}
+
+// videoPicture is a picture decoded by a videoDecoder.
+type videoPicture struct {
+	vpxfb.Image
+
+	// pooled is the *vpx_image_t of the picture if it is in a buffer of a vpxfb.Pool, or nil.
+	pooled unsafe.Pointer
+}
+
+// newVideoDecoder creates a decoder of codec with threads threads.
+func newVideoDecoder(codec videoCodec, threads int) (videoDecoder, error) {
+	switch codec {
+	case videoCodecVP8, videoCodecVP9:
+		return newVPXDecoder(codec, threads)
+	case videoCodecAV1:
+		d, err := dav1d.NewDecoder(threads)
+		if err != nil {
+			return nil, err
+		}
+		return &av1Decoder{d: d}, nil
+	}
+	return nil, fmt.Errorf("webmplayer: unsupported video codec: %s", codec)
+}
+
+// alphaDecoder decodes the alpha channel of a VP8 or VP9 track with AlphaMode, which is another stream of the codec
+// in the BlockAdditionals of the blocks, on its own goroutine in parallel with the decoder of the frames. The Y planes
+// of its pictures are the A planes of the frames. A nil alphaDecoder decodes nothing.
+type alphaDecoder struct {
+	d videoDecoder
+
+	// in sends the packets to the goroutine, which sends their results to out. busy is true while the result of the
+	// packet sent last is not received.
+	in   chan []byte
+	out  chan alphaResult
+	busy bool
+}
+
+type alphaResult struct {
+	picture videoPicture
+	ok      bool
+	err     error
+}
+
+// newAlphaDecoder creates an alphaDecoder of codec, and starts its goroutine.
+func newAlphaDecoder(codec videoCodec) (*alphaDecoder, error) {
+	// The A plane is a single plane, which a thread decodes while the frame is decoded.
+	d, err := newVideoDecoder(codec, 1)
+	if err != nil {
+		return nil, err
+	}
+	if err := d.start(nil); err != nil {
+		d.destroy()
+		return nil, err
+	}
+	a := &alphaDecoder{
+		d:   d,
+		in:  make(chan []byte),
+		out: make(chan alphaResult),
+	}
+	go a.run()
+	return a, nil
+}
+
+func (a *alphaDecoder) run() {
+	for data := range a.in {
+		var r alphaResult
+		// A packet of VP8 or VP9 has at most one shown frame.
+		if r.err = a.d.decode(data); r.err == nil {
+			r.picture, r.ok, r.err = a.d.next()
+		}
+		a.out <- r
+	}
+}
+
+// decode starts decoding the alpha channel data of a packet. The result of the packet before is dropped if it is not
+// received by picture.
+func (a *alphaDecoder) decode(data []byte) {
+	if a == nil || len(data) == 0 {
+		return
+	}
+	a.picture()
+	a.in <- data
+	a.busy = true
+}
+
+// picture waits for the picture of the packet given to decode, or returns false if there is none. The picture is
+// valid until the next call of decode, start or destroy.
+func (a *alphaDecoder) picture() (videoPicture, bool, error) {
+	if a == nil || !a.busy {
+		return videoPicture{}, false, nil
+	}
+	a.busy = false
+	r := <-a.out
+	return r.picture, r.ok, r.err
+}
+
+// start resets the decoder, which decodes from the next keyframe.
+func (a *alphaDecoder) start() error {
+	if a == nil {
+		return nil
+	}
+	a.picture()
+	return a.d.start(nil)
+}
+
+func (a *alphaDecoder) destroy() {
+	if a == nil {
+		return
+	}
+	a.picture()
+	close(a.in)
+	a.d.destroy()
+}
+
+// av1Decoder is a libdav1d decoder.
+type av1Decoder struct {
+	d *dav1d.Decoder
+
+	// gray is the neutral chroma plane for monochrome pictures, of grayDepth bits.
+	gray      []byte
+	grayDepth int
+}
+
+func (a *av1Decoder) start(codecPrivate []byte) error {
+	a.d.Flush()
+	// CodecPrivate is an AV1CodecConfigurationRecord, whose configOBUs after the 4-byte header have the sequence
+	// header. The keyframes don't necessarily repeat it.
+	if len(codecPrivate) <= 4 {
+		return nil
+	}
+	if err := a.d.Decode(codecPrivate[4:]); err != nil {
+		return err
+	}
+	for {
+		_, ok, err := a.d.Next()
+		if err != nil {
+			return err
+		}
+		if !ok {
+			return nil
+		}
+	}
+}
+
+func (a *av1Decoder) decode(data []byte) error {
+	return a.d.Decode(data)
+}
+
+func (a *av1Decoder) next() (videoPicture, bool, error) {
+	pic, ok, err := a.d.Next()
+	if err != nil || !ok {
+		return videoPicture{}, false, err
+	}
+	p := videoPicture{
+		Image: vpxfb.Image{
+			Width:        pic.Width,
+			Height:       pic.Height,
+			BitDepth:     pic.BitDepth,
+			HighBitDepth: pic.BitDepth > 8,
+			ColorSpace:   matrixColorSpace(uint64(pic.MatrixCoefficients)),
+			FullRange:    pic.FullRange,
+			Planes:       pic.Planes,
+			Strides:      pic.Strides,
+		},
+	}
+	p.XChromaShift, p.YChromaShift = pic.Layout.ChromaShifts()
+	if pic.Layout == dav1d.LayoutI400 {
+		cw, ch := (pic.Width+1)/2, (pic.Height+1)/2
+		plane, stride := a.grayPlane(cw, ch, pic.BitDepth)
+		p.Planes[1], p.Planes[2] = plane, plane
+		p.Strides[1], p.Strides[2] = stride, stride
+	}
+	return p, true, nil
+}
+
+// grayPlane returns a chroma plane of w x h samples of depth bits at the center, and its stride.
+func (a *av1Decoder) grayPlane(w, h, depth int) ([]byte, int) {
+	bps := 1
+	if depth > 8 {
+		bps = 2
+	}
+	if len(a.gray) != bps*w*h || a.grayDepth != depth {
+		a.gray = make([]byte, bps*w*h)
+		a.grayDepth = depth
+		if bps == 1 {
+			for i := range a.gray {
+				a.gray[i] = 0x80
+			}
+		} else {
+			v := 1 << (depth - 1)
+			for i := 0; i < len(a.gray); i += 2 {
+				a.gray[i] = byte(v)
+				a.gray[i+1] = byte(v >> 8)
+			}
+		}
+	}
+	return a.gray, bps * w
+}
+
+// setSkipLoopFilter does nothing, as libdav1d's loop filters are chosen at opening the decoder.
+func (a *av1Decoder) setSkipLoopFilter(skip bool) {
+}
+
+func (a *av1Decoder) setSpatialLayer(layer int) {
+}
+
+func (a *av1Decoder) destroy() {
+	a.d.Close()
+}
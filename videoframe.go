@@ -0,0 +1,648 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"hash/crc32"
+	"image"
+	"image/draw"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// videoFrame is a decoded frame owned by the player.
+// libvpx reuses its frame buffers for the next decoding, so the planes are copied into a videoFrame, unless the frame
+// holds the buffer of a vpxfb.Pool.
+type videoFrame struct {
+	timecode time.Duration
+	gen      uint64
+
+	// decoded is the time the frame was decoded.
+	decoded time.Time
+
+	// content identifies the pixels of the frame. Consecutive frames with the same content have the same pixels.
+	content uint64
+
+	isYCbCr bool
+	ycbcr   image.YCbCr
+	rgba    image.RGBA
+
+	// depth is the bit depth of the samples of ycbcr if they are little-endian 16-bit samples, or 0 for 8-bit samples.
+	// Only frames for drawing have 16-bit samples.
+	depth int
+
+	// colorSpace and fullRange are the matrix and the range of ycbcr.
+	colorSpace vpxfb.ColorSpace
+	fullRange  bool
+
+	// alpha is the 8-bit A plane of ycbcr with the stride alphaStride for a track with AlphaMode, or empty if the frame
+	// is opaque. The A plane of an RGBA frame is in rgba, premultiplied.
+	alpha       []byte
+	alphaStride int
+
+	// fb is the libvpx frame buffer that the planes of ycbcr refer to, or the zero value if the planes are owned by
+	// the frame.
+	fb vpxfb.Buffer
+
+	// shared is true if the planes of ycbcr or rgba are of a videoFrameCache, which are not owned by the frame.
+	shared bool
+
+	// scratchYCbCr and scratchRGBA are the buffers to convert images in high bit depths.
+	scratchYCbCr image.YCbCr
+	scratchRGBA  image.RGBA
+}
+
+// setDrawnImage sets the picture p to be drawn by the YUV shader, downscaled to at least w x h by scaleFactor. Unlike
+// setImage, 4:2:0 pictures in high bit depths keep their 16-bit samples, as the shader reads them.
+// If p is in a buffer of a vpxfb.Pool, f refers to the planes of 4:2:0 pictures without copying them. The buffer stays
+// valid until f releases it.
+func (f *videoFrame) setDrawnImage(p *videoPicture, w, h int) {
+	info := &p.Image
+	if info.XChromaShift != 1 || info.YChromaShift != 1 || scaleFactor(image.Rect(0, 0, info.Width, info.Height), w, h) != 1 {
+		f.setImage(p, w, h)
+		return
+	}
+	if p.pooled != nil {
+		if b, ok := vpxfb.Acquire(p.pooled); ok {
+			f.releaseBuffer()
+			f.fb = b
+			f.setPlanes(info, info.Planes[0], info.Planes[1], info.Planes[2])
+			return
+		}
+	}
+	if !info.HighBitDepth {
+		f.setImage(p, w, h)
+		return
+	}
+	f.releaseBuffer()
+	ch := (info.Height + 1) / 2
+	f.setPlanes(info,
+		copyPlane(f.ycbcr.Y, info.Planes[0], info.Strides[0]*info.Height),
+		copyPlane(f.ycbcr.Cb, info.Planes[1], info.Strides[1]*ch),
+		copyPlane(f.ycbcr.Cr, info.Planes[2], info.Strides[2]*ch))
+}
+
+// setPlanes sets the 4:2:0 planes of info to f as they are.
+func (f *videoFrame) setPlanes(info *vpxfb.Image, y, cb, cr []byte) {
+	f.isYCbCr = true
+	f.depth = 0
+	if info.HighBitDepth {
+		f.depth = info.BitDepth
+	}
+	f.setColor(info)
+	f.ycbcr = image.YCbCr{
+		Y:              y,
+		Cb:             cb,
+		Cr:             cr,
+		YStride:        info.Strides[0],
+		CStride:        info.Strides[1],
+		SubsampleRatio: image.YCbCrSubsampleRatio420,
+		Rect:           image.Rect(0, 0, info.Width, info.Height),
+	}
+}
+
+func (f *videoFrame) setColor(info *vpxfb.Image) {
+	f.colorSpace = info.ColorSpace
+	f.fullRange = info.FullRange
+}
+
+// releaseBuffer releases the libvpx frame buffer or the cached planes that f refers to, if any. The planes are
+// dropped with it, so that they are not written later as owned ones.
+func (f *videoFrame) releaseBuffer() {
+	if f.shared {
+		f.shared = false
+		f.ycbcr.Y, f.ycbcr.Cb, f.ycbcr.Cr = nil, nil, nil
+		f.rgba.Pix = nil
+		f.alpha = nil
+		return
+	}
+	if f.fb == (vpxfb.Buffer{}) {
+		return
+	}
+	f.fb.Release()
+	f.ycbcr.Y, f.ycbcr.Cb, f.ycbcr.Cr = nil, nil, nil
+}
+
+// setImage copies the picture p, downscaled to at least w x h by scaleFactor.
+// 4:2:0 pictures are kept as YCbCr to be converted by the GPU, and the other subsamplings are converted to RGBA.
+// High bit depths are reduced to 8 bits.
+func (f *videoFrame) setImage(p *videoPicture, w, h int) {
+	yuv := f.ycbcrOf(p)
+	if yuv.SubsampleRatio == image.YCbCrSubsampleRatio420 {
+		f.setYCbCr(&yuv, scaleFactor(yuv.Rect, w, h))
+		return
+	}
+	rgba := ycbcrToRGBA(&f.scratchRGBA, &yuv)
+	f.setRGBA(rgba, scaleFactor(rgba.Rect, w, h))
+}
+
+// setRawImage copies the picture p without downscaling, for PlayerOptions.OnVideoFrame.
+// Unlike setImage, pictures of any subsampling are kept as YCbCr. High bit depths are reduced to 8 bits.
+func (f *videoFrame) setRawImage(p *videoPicture) {
+	yuv := f.ycbcrOf(p)
+	f.setYCbCr(&yuv, 1)
+}
+
+// ycbcrOf returns p as an image.YCbCr. The color space of p is set to f.
+// A picture in a high bit depth is reduced to 8 bits into the scratch buffer of f. Otherwise, the image refers to the
+// planes of p.
+func (f *videoFrame) ycbcrOf(p *videoPicture) image.YCbCr {
+	info := &p.Image
+	f.setColor(info)
+	ratio := subsampleRatio(info.XChromaShift, info.YChromaShift)
+	w, h := info.Width, info.Height
+	if !info.HighBitDepth {
+		return image.YCbCr{
+			Y:              info.Planes[0],
+			Cb:             info.Planes[1],
+			Cr:             info.Planes[2],
+			YStride:        info.Strides[0],
+			CStride:        info.Strides[1],
+			SubsampleRatio: ratio,
+			Rect:           image.Rect(0, 0, w, h),
+		}
+	}
+	cw, ch := (w+1<<info.XChromaShift-1)>>info.XChromaShift, (h+1<<info.YChromaShift-1)>>info.YChromaShift
+	y := &f.scratchYCbCr
+	y.Y = reduceBitDepth(y.Y, info.Planes[0], info.Strides[0], w, h, info.BitDepth)
+	y.Cb = reduceBitDepth(y.Cb, info.Planes[1], info.Strides[1], cw, ch, info.BitDepth)
+	y.Cr = reduceBitDepth(y.Cr, info.Planes[2], info.Strides[2], cw, ch, info.BitDepth)
+	y.YStride = w
+	y.CStride = cw
+	y.SubsampleRatio = ratio
+	y.Rect = image.Rect(0, 0, w, h)
+	return *y
+}
+
+// subsampleRatio returns the subsampling of the chroma shifts. The decoders subsample the chroma planes by at most 2,
+// so the other shifts are not used.
+func subsampleRatio(xShift, yShift int) image.YCbCrSubsampleRatio {
+	switch {
+	case xShift == 1 && yShift == 0:
+		return image.YCbCrSubsampleRatio422
+	case xShift == 0 && yShift == 1:
+		return image.YCbCrSubsampleRatio440
+	case xShift == 0 && yShift == 0:
+		return image.YCbCrSubsampleRatio444
+	}
+	return image.YCbCrSubsampleRatio420
+}
+
+// reduceBitDepth writes the w x h little-endian 16-bit samples of depth bits in src to dst as 8-bit samples without
+// padding.
+func reduceBitDepth(dst, src []byte, stride, w, h, depth int) []byte {
+	if cap(dst) < w*h {
+		dst = make([]byte, w*h)
+	}
+	dst = dst[:w*h]
+	shift := depth - 8
+	for y := 0; y < h; y++ {
+		row := src[y*stride : y*stride+2*w]
+		out := dst[y*w : (y+1)*w]
+		for x := range out {
+			out[x] = byte(min((int(row[2*x])|int(row[2*x+1])<<8)>>shift, 255))
+		}
+	}
+	return dst
+}
+
+// ycbcrToRGBA converts src to RGBA into dst.
+func ycbcrToRGBA(dst *image.RGBA, src *image.YCbCr) *image.RGBA {
+	n := 4 * src.Rect.Dx() * src.Rect.Dy()
+	if cap(dst.Pix) < n {
+		dst.Pix = make([]byte, n)
+	}
+	dst.Pix = dst.Pix[:n]
+	dst.Stride = 4 * src.Rect.Dx()
+	dst.Rect = src.Rect
+	draw.Draw(dst, dst.Rect, src, src.Rect.Min, draw.Src)
+	return dst
+}
+
+// copyFrom copies the frame src to f.
+func (f *videoFrame) copyFrom(src *videoFrame) {
+	f.releaseBuffer()
+	f.timecode = src.timecode
+	f.isYCbCr = src.isYCbCr
+	f.depth = src.depth
+	f.colorSpace = src.colorSpace
+	f.fullRange = src.fullRange
+	f.alpha = copyPlane(f.alpha, src.alpha, len(src.alpha))
+	f.alphaStride = src.alphaStride
+	if src.isYCbCr {
+		y, cb, cr := f.ycbcr.Y, f.ycbcr.Cb, f.ycbcr.Cr
+		f.ycbcr = src.ycbcr
+		f.ycbcr.Y = copyPlane(y, src.ycbcr.Y, len(src.ycbcr.Y))
+		f.ycbcr.Cb = copyPlane(cb, src.ycbcr.Cb, len(src.ycbcr.Cb))
+		f.ycbcr.Cr = copyPlane(cr, src.ycbcr.Cr, len(src.ycbcr.Cr))
+		return
+	}
+	pix := f.rgba.Pix
+	f.rgba = src.rgba
+	f.rgba.Pix = copyPlane(pix, src.rgba.Pix, len(src.rgba.Pix))
+}
+
+// size returns the bytes of the planes of f.
+func (f *videoFrame) size() int64 {
+	if f.isYCbCr {
+		return int64(len(f.ycbcr.Y) + len(f.ycbcr.Cb) + len(f.ycbcr.Cr) + len(f.alpha))
+	}
+	return int64(len(f.rgba.Pix))
+}
+
+// image returns the frame as an image.Image. The image shares the planes of f.
+func (f *videoFrame) image() image.Image {
+	if f.isYCbCr {
+		return &f.ycbcr
+	}
+	return &f.rgba
+}
+
+// setYCbCr copies src downscaled by the factor k. src must be 4:2:0 if k is not 1.
+func (f *videoFrame) setYCbCr(src *image.YCbCr, k int) {
+	f.releaseBuffer()
+	w, h := src.Rect.Dx(), src.Rect.Dy()
+	ch := h
+	if src.SubsampleRatio == image.YCbCrSubsampleRatio420 || src.SubsampleRatio == image.YCbCrSubsampleRatio440 {
+		ch = (h + 1) / 2
+	}
+	f.isYCbCr = true
+	f.depth = 0
+	y := src.Y[src.YOffset(src.Rect.Min.X, src.Rect.Min.Y):]
+	cb := src.Cb[src.COffset(src.Rect.Min.X, src.Rect.Min.Y):]
+	cr := src.Cr[src.COffset(src.Rect.Min.X, src.Rect.Min.Y):]
+	f.ycbcr.SubsampleRatio = src.SubsampleRatio
+	if k == 1 {
+		f.ycbcr.Y = copyPlane(f.ycbcr.Y, y, src.YStride*h)
+		f.ycbcr.Cb = copyPlane(f.ycbcr.Cb, cb, src.CStride*ch)
+		f.ycbcr.Cr = copyPlane(f.ycbcr.Cr, cr, src.CStride*ch)
+		f.ycbcr.YStride = src.YStride
+		f.ycbcr.CStride = src.CStride
+		f.ycbcr.Rect = image.Rect(0, 0, w, h)
+		return
+	}
+	// The chroma planes are downscaled by the same factor, so that they stay half of the luma plane.
+	dw, dh := w/k, h/k
+	dcw, dch := (dw+1)/2, (dh+1)/2
+	cw := (w + 1) / 2
+	f.ycbcr.Y = downscalePlane(f.ycbcr.Y, y, src.YStride, w, h, dw, dh, k, 1)
+	f.ycbcr.Cb = downscalePlane(f.ycbcr.Cb, cb, src.CStride, cw, ch, dcw, dch, k, 1)
+	f.ycbcr.Cr = downscalePlane(f.ycbcr.Cr, cr, src.CStride, cw, ch, dcw, dch, k, 1)
+	f.ycbcr.YStride = dw
+	f.ycbcr.CStride = dcw
+	f.ycbcr.Rect = image.Rect(0, 0, dw, dh)
+}
+
+// checksum returns the CRC-32 of the visible pixels of f updated from crc.
+func (f *videoFrame) checksum(crc uint32) uint32 {
+	update := func(pix []byte, stride, w, h int) {
+		for y := 0; y < h; y++ {
+			crc = crc32.Update(crc, crc32.IEEETable, pix[y*stride:y*stride+w])
+		}
+	}
+	if f.isYCbCr {
+		w, h := f.ycbcr.Rect.Dx(), f.ycbcr.Rect.Dy()
+		cw, ch := (w+1)/2, (h+1)/2
+		bps := 1
+		if f.depth > 0 {
+			bps = 2
+		}
+		update(f.ycbcr.Y, f.ycbcr.YStride, bps*w, h)
+		update(f.ycbcr.Cb, f.ycbcr.CStride, bps*cw, ch)
+		update(f.ycbcr.Cr, f.ycbcr.CStride, bps*cw, ch)
+		if len(f.alpha) > 0 {
+			update(f.alpha, f.alphaStride, w, h)
+		}
+		return crc
+	}
+	update(f.rgba.Pix, f.rgba.Stride, 4*f.rgba.Rect.Dx(), f.rgba.Rect.Dy())
+	return crc
+}
+
+// setRGBA copies src downscaled by the factor k.
+func (f *videoFrame) setRGBA(src *image.RGBA, k int) {
+	f.releaseBuffer()
+	f.isYCbCr = false
+	f.depth = 0
+	if k == 1 {
+		f.rgba.Pix = copyPlane(f.rgba.Pix, src.Pix, len(src.Pix))
+		f.rgba.Stride = src.Stride
+		f.rgba.Rect = src.Rect
+		return
+	}
+	w, h := src.Rect.Dx(), src.Rect.Dy()
+	dw, dh := w/k, h/k
+	f.rgba.Pix = downscalePlane(f.rgba.Pix, src.Pix[src.PixOffset(src.Rect.Min.X, src.Rect.Min.Y):], src.Stride, w, h, dw, dh, k, 4)
+	f.rgba.Stride = 4 * dw
+	f.rgba.Rect = image.Rect(0, 0, dw, dh)
+}
+
+// setAlpha sets the Y plane of the picture p of the alpha channel as the A plane of f, downscaled by the factor k as
+// the frame was. p must be of the size of the frame before the downscaling. f is opaque if p is nil or of another
+// size.
+func (f *videoFrame) setAlpha(p *videoPicture, k int) {
+	f.alpha = f.alpha[:0]
+	if p == nil {
+		return
+	}
+	info := &p.Image
+	w, h := info.Width, info.Height
+	dw, dh := w/k, h/k
+	bounds := f.rgba.Rect
+	if f.isYCbCr {
+		bounds = f.ycbcr.Rect
+	}
+	if bounds.Dx() != dw || bounds.Dy() != dh {
+		return
+	}
+	src, stride := info.Planes[0], info.Strides[0]
+	if info.HighBitDepth {
+		src = reduceBitDepth(f.scratchYCbCr.Y, src, stride, w, h, info.BitDepth)
+		f.scratchYCbCr.Y = src
+		stride = w
+	}
+	if k == 1 {
+		f.alpha = copyPlane(f.alpha, src, stride*h)
+		f.alphaStride = stride
+	} else {
+		f.alpha = downscalePlane(f.alpha, src, stride, w, h, dw, dh, k, 1)
+		f.alphaStride = dw
+	}
+	if f.isYCbCr {
+		return
+	}
+	// The RGBA frames are drawn as they are, so the A plane is premultiplied into them.
+	for y := 0; y < dh; y++ {
+		row := f.rgba.Pix[y*f.rgba.Stride : y*f.rgba.Stride+4*dw]
+		for x, a := range f.alpha[y*f.alphaStride : y*f.alphaStride+dw] {
+			c := row[4*x : 4*x+4]
+			c[0] = byte((uint32(c[0])*uint32(a) + 127) / 255)
+			c[1] = byte((uint32(c[1])*uint32(a) + 127) / 255)
+			c[2] = byte((uint32(c[2])*uint32(a) + 127) / 255)
+			c[3] = a
+		}
+	}
+	f.alpha = f.alpha[:0]
+}
+
+// downscalePlane writes the w x h samples of src averaged over k x k boxes to dst as dw x dh samples without padding.
+// Each sample has n components. The boxes at the right and the bottom edges are clipped to src.
+func downscalePlane(dst, src []byte, stride, w, h, dw, dh, k, n int) []byte {
+	size := dw * dh * n
+	if cap(dst) < size {
+		dst = make([]byte, size)
+	}
+	dst = dst[:size]
+	for dy := 0; dy < dh; dy++ {
+		y0, y1 := min(dy*k, h-1), min((dy+1)*k, h)
+		out := dst[dy*dw*n : (dy+1)*dw*n]
+		for dx := 0; dx < dw; dx++ {
+			x0, x1 := min(dx*k, w-1), min((dx+1)*k, w)
+			count := uint32((y1 - y0) * (x1 - x0))
+			for c := 0; c < n; c++ {
+				var sum uint32
+				for y := y0; y < y1; y++ {
+					row := src[y*stride:]
+					for x := x0; x < x1; x++ {
+						sum += uint32(row[x*n+c])
+					}
+				}
+				out[dx*n+c] = byte((sum + count/2) / count)
+			}
+		}
+	}
+	return dst
+}
+
+func copyPlane(dst, src []byte, n int) []byte {
+	if cap(dst) < n {
+		dst = make([]byte, n)
+	}
+	dst = dst[:n]
+	copy(dst, src)
+	return dst
+}
+
+// Frame is a decoded video frame passed to PlayerOptions.OnVideoFrame.
+// The buffers of a Frame come from a pool of the Player. Release returns them, so that the next frames don't
+// allocate.
+type Frame struct {
+	// Timecode is the presentation time of the frame.
+	Timecode time.Duration
+
+	// YCbCr is the Y, Cb and Cr planes of the frame as the decoder decoded them, with their strides and the chroma
+	// subsampling of the stream. Samples in a high bit depth are reduced to 8 bits. YCbCr is nil if the frame is in
+	// RGBA.
+	YCbCr *image.YCbCr
+
+	// RGBA is the frame converted from a format that image.YCbCr can't represent. RGBA is nil if the frame is in
+	// YCbCr.
+	RGBA *image.RGBA
+
+	frame videoFrame
+	pool  *sync.Pool
+}
+
+// Release returns the buffers of f to the pool. f and its planes must not be used after Release.
+// A Frame that is not released is garbage-collected, but the next frame allocates new buffers.
+func (f *Frame) Release() {
+	if f.pool == nil {
+		return
+	}
+	pool := f.pool
+	f.pool = nil
+	f.YCbCr = nil
+	f.RGBA = nil
+	pool.Put(f)
+}
+
+// newFrame returns a Frame from pool with a copy of src.
+func newFrame(pool *sync.Pool, src *videoFrame) *Frame {
+	f, _ := pool.Get().(*Frame)
+	if f == nil {
+		f = &Frame{}
+	}
+	f.frame.copyFrom(src)
+	f.Timecode = src.timecode
+	if f.frame.isYCbCr {
+		f.YCbCr = &f.frame.ycbcr
+	} else {
+		f.RGBA = &f.frame.rgba
+	}
+	f.pool = pool
+	return f
+}
+
+// frameQueue is a bounded ring of decoded frames in presentation order.
+// The decoder fills frames as fast as it can, and the player takes the frame for the current position.
+//
+// frameQueue is lock-free for one producer (the decoder) and one consumer (the player).
+// The frames are owned by the ring's slots, so no frames are allocated or copied at the handoff.
+// The consumer never waits. The producer waits only when the ring is full.
+type frameQueue struct {
+	frames []videoFrame
+
+	// head is the index of the oldest frame that the consumer has not released.
+	head atomic.Uint64
+
+	// tail is the index of the next frame to be published by the producer.
+	tail atomic.Uint64
+
+	// space is notified when the consumer releases slots.
+	space chan struct{}
+
+	// done is closed when the queue is closed.
+	done chan struct{}
+
+	// dropped is the number of the frames released by front without being presented.
+	dropped atomic.Int64
+
+	// sizes is the bytes of the planes of the frames accounted in the memory budget when they were published last.
+	// sizes is used only by the producer.
+	sizes []int64
+}
+
+// newFrameQueue creates a frameQueue of size frames. frames is reused if its length is size.
+func newFrameQueue(size int, frames []videoFrame) *frameQueue {
+	if len(frames) != size {
+		frames = make([]videoFrame, size)
+	}
+	return &frameQueue{
+		frames: frames,
+		sizes:  make([]int64, size),
+		space:  make(chan struct{}, 1),
+		done:   make(chan struct{}),
+	}
+}
+
+// back returns the frame to be filled by the producer. back blocks while the ring is full.
+// back returns nil when the queue is closed.
+func (q *frameQueue) back() *videoFrame {
+	t := q.tail.Load()
+	for t-q.head.Load() == uint64(len(q.frames)) {
+		select {
+		case <-q.space:
+		case <-q.done:
+			return nil
+		}
+	}
+	return &q.frames[t%uint64(len(q.frames))]
+}
+
+// publish makes the frame returned by back visible to the consumer.
+func (q *frameQueue) publish() {
+	t := q.tail.Load()
+	i := t % uint64(len(q.frames))
+	if size := q.frames[i].size(); size != q.sizes[i] {
+		trackMemory(memoryVideoFrames, size-q.sizes[i])
+		q.sizes[i] = size
+	}
+	q.tail.Add(1)
+}
+
+// front returns the latest frame of the seek generation gen to be presented at pos, or nil if there is no such frame.
+// Older frames and frames of older generations are released.
+// The consumer must call release after using the returned frame.
+func (q *frameQueue) front(pos time.Duration, gen uint64) *videoFrame {
+	n := uint64(len(q.frames))
+	h0, t := q.head.Load(), q.tail.Load()
+	h := h0
+	for h < t && q.frames[h%n].gen != gen {
+		h++
+	}
+	if h == t || q.frames[h%n].timecode > pos {
+		if h != h0 {
+			q.head.Store(h)
+			q.notify()
+		}
+		return nil
+	}
+	for h+1 < t && q.frames[(h+1)%n].gen == gen && q.frames[(h+1)%n].timecode <= pos {
+		h++
+		q.dropped.Add(1)
+	}
+	q.head.Store(h)
+	return &q.frames[h%n]
+}
+
+// next returns the oldest frame of the seek generation gen, regardless of its timecode, or nil if there is no such frame.
+// The frames of older generations are released. The consumer must call release after using the returned frame.
+func (q *frameQueue) next(gen uint64) *videoFrame {
+	n := uint64(len(q.frames))
+	h0, t := q.head.Load(), q.tail.Load()
+	h := h0
+	for h < t && q.frames[h%n].gen != gen {
+		h++
+	}
+	if h != h0 {
+		q.head.Store(h)
+		q.notify()
+	}
+	if h == t {
+		return nil
+	}
+	return &q.frames[h%n]
+}
+
+// first returns the timecode of the oldest frame of the seek generation gen, or false if there is no such frame.
+func (q *frameQueue) first(gen uint64) (time.Duration, bool) {
+	n := uint64(len(q.frames))
+	for h, t := q.head.Load(), q.tail.Load(); h < t; h++ {
+		if f := &q.frames[h%n]; f.gen == gen {
+			return f.timecode, true
+		}
+	}
+	return 0, false
+}
+
+// full reports whether back would block.
+func (q *frameQueue) full() bool {
+	return q.tail.Load()-q.head.Load() == uint64(len(q.frames))
+}
+
+// ready returns the number of the published frames of the seek generation gen.
+func (q *frameQueue) ready(gen uint64) int {
+	n := uint64(len(q.frames))
+	var count int
+	for h, t := q.head.Load(), q.tail.Load(); h < t; h++ {
+		if q.frames[h%n].gen == gen {
+			count++
+		}
+	}
+	return count
+}
+
+// empty reports whether all the published frames have been released.
+func (q *frameQueue) empty() bool {
+	return q.head.Load() == q.tail.Load()
+}
+
+// release releases the frame returned by front.
+func (q *frameQueue) release() {
+	q.head.Add(1)
+	q.notify()
+}
+
+// close makes the producer stop waiting. close must be called once.
+func (q *frameQueue) close() {
+	close(q.done)
+}
+
+// untrack removes the frames from the memory budget. untrack must be called after the producer stops.
+func (q *frameQueue) untrack() {
+	for i, size := range q.sizes {
+		trackMemory(memoryVideoFrames, -size)
+		q.sizes[i] = 0
+	}
+}
+
+func (q *frameQueue) notify() {
+	select {
+	case q.space <- struct{}{}:
+	default:
+	}
+}
@@ -4,54 +4,277 @@
 package webmplayer
 
 import (
+	"bytes"
+	"context"
+	_ "embed"
+	"encoding/binary"
 	"fmt"
+	"hash/maphash"
+	"image"
+	"math"
+	"runtime/trace"
+	"strconv"
+	"strings"
 	"sync"
 	"sync/atomic"
 	"time"
 
 	"github.com/ebml-go/webm"
 	"github.com/hajimehoshi/ebiten/v2"
-	"github.com/xlab/libvpx-go/vpx"
+
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
 )
 
 type videoStream struct {
-	src   <-chan webm.Packet
-	ctx   *vpx.CodecCtx
-	iface *vpx.CodecIface
+	codec   videoCodec
+	src     *packetQueue
+	decoder videoDecoder
+
+	// alpha is the decoder of the alpha channel of a track with AlphaMode, or nil.
+	alpha *alphaDecoder
+
+	seek  *seekState
+	stats *streamStats
+
+	// traceCtx is the context of the trace task of the stream.
+	traceCtx context.Context
+
+	catchUpThreshold time.Duration
+	skipped          atomic.Int64
+
+	// ticks runs the decode steps within Player.Update with PlayerOptions.DecodeBudget, or is nil.
+	ticks *decodeTicks
+
+	// resyncOnError is PlayerOptions.VideoResyncOnError, and codecPrivate is the CodecPrivate data of the track to
+	// restart the decoder with.
+	resyncOnError bool
+	codecPrivate  []byte
+
+	// trackNumber is the number of the track, for the events of PlayerOptions.FlightRecorder.
+	trackNumber uint
 
+	// audioPulled is stream.audioPulled, and audioLowWatermark is PlayerOptions.AudioLowWatermark.
+	audioPulled       *atomic.Int64
+	audioLowWatermark time.Duration
+
+	// color is the Colour element of the track, which takes precedence over the color space of the bitstream.
+	color trackColor
+
+	// targetWidth and targetHeight are PlayerOptions.VideoTargetWidth and PlayerOptions.VideoTargetHeight.
+	targetWidth  int
+	targetHeight int
+
+	// selectSpatialLayer is PlayerOptions.VideoSelectSpatialLayer.
+	selectSpatialLayer bool
+
+	// hashFrames is PlayerOptions.VideoHashFrames, and hashSeed is the seed of the hashes.
+	hashFrames bool
+	hashSeed   maphash.Seed
+
+	frames *frameQueue
+
+	// onFrame is PlayerOptions.OnVideoFrame, and framePool is the pool of the Frames passed to onFrame.
+	onFrame   func(frame *Frame)
+	framePool sync.Pool
+
+	// offscreen and planes are grow-only, and only their top-left regions are used, so that resolution switches
+	// don't reallocate textures. frame is the region of offscreen that has the current frame in RGB.
 	offscreen *ebiten.Image
+	frame     *ebiten.Image
+
+	// planes is an atlas of the Y, Cb and Cr planes of the current frame, converted to RGB by yuvShader.
+	planes    *ebiten.Image
+	planesPix []byte
+
+	// planar is the layout of planes if the current frame is drawn as YCbCr. converted is true when planes has been
+	// converted into frame, which is deferred to the first draw of frame, so that a frame drawn only by an effect of
+	// PlayerDrawOptions.Shader is converted only once.
+	planar    yuvLayout
+	converted bool
+
+	// uploaded is the content of the frame in planes and frame. uploaded is used only by Update.
+	uploaded uint64
 
 	pos atomic.Int64
 
+	// shownGen is the seek generation of the frame drawn last, and shown is true if any frame has been drawn.
+	// shownGen and shown are used only by Update.
+	shownGen uint64
+	shown    bool
+
+	// shownTimecode is the timecode of the frame drawn last, presentLead is the lead of its present, and fresh is true
+	// if the frame is not reported by presented yet. They are used only on the game's goroutine.
+	shownTimecode time.Duration
+	presentLead   time.Duration
+	fresh         bool
+
+	// decodeTime and frameInterval are the moving averages of the time to decode a frame and of the duration of a
+	// frame, in nanoseconds.
+	decodeTime    atomic.Int64
+	frameInterval atomic.Int64
+
+	// decodeTotal is the total time to decode the packets in nanoseconds.
+	decodeTotal atomic.Int64
+
 	err atomic.Pointer[error]
 
-	m sync.Mutex
+	// endGen is the seek generation plus 1 in which the decoder has reached the end of the stream, or 0.
+	endGen atomic.Uint64
+
+	// last is the copy of the frame on screen kept by keepFrame after the images are released.
+	last *ebiten.Image
+
+	// done is closed when loop exits.
+	done chan struct{}
+
+	// scheduler is PlayerOptions.DecodeScheduler, which can be nil.
+	scheduler *DecodeScheduler
+
+	// cpus is the CPUs of PlayerOptions.DecodeCPUs that the decoder runs on, or nil.
+	cpus *cpuMask
+
+	// adaptQuality is PlayerOptions.VideoAdaptQuality. quality is the videoQuality level that governor sets for the
+	// decoder.
+	adaptQuality bool
+	quality      atomic.Int32
+	governor     qualityGovernor
+
+	// fastStart is PlayerOptions.FastStart.
+	fastStart bool
+
+	// settle is true when the first frame after the latest seek is presented as soon as it is decoded, as with
+	// fastStart, after scrubbing. settle is used only by Update.
+	settle bool
+
+	// atlas is PlayerOptions.VideoAtlas, and region is the region of the atlas that the frames are drawn into, or
+	// empty if the frames are drawn into offscreen.
+	atlas  *VideoAtlas
+	region image.Rectangle
+
+	// cache is the cache of the decoded frames by PlayerOptions.VideoFrameCacheBytes, or nil.
+	cache *videoFrameCache
+
+	// step is the state of stepping through the frames, and stepRecording is true if the presented frames are kept
+	// for stepping back while playing, by PlayerOptions.VideoStepCacheBytes. step is used only by Update.
+	step          frameStepper
+	stepRecording bool
+
+	// stepping is true while stepping, when the audio is paused and doesn't limit the video decoder.
+	stepping atomic.Bool
+
+	// hidden is true while the Player is not visible, when the decoder decodes only the keyframes.
+	hidden atomic.Bool
+
+	// pool is the pool that the decoder state is returned to at closing. pool can be nil.
+	pool    *PlayerPool
+	poolKey videoDecoderKey
 }
 
 type videoCodec string
 
 const (
-	videoCodecVP8  videoCodec = "V_VP8"
-	videoCodecVP9  videoCodec = "V_VP9"
-	videoCodecVP10 videoCodec = "V_VP10"
+	videoCodecVP8 videoCodec = "V_VP8"
+	videoCodecVP9 videoCodec = "V_VP9"
+	videoCodecAV1 videoCodec = "V_AV1"
 )
 
-func newVideoStream(codec videoCodec, src <-chan webm.Packet) (*videoStream, error) {
+func newVideoStream(ctx context.Context, track *webm.TrackEntry, color trackColor, src *packetQueue, seek *seekState, stats *streamStats, audioPulled *atomic.Int64, loop time.Duration, options *PlayerOptions) (*videoStream, error) {
+	codec := videoCodec(track.CodecID)
 	v := &videoStream{
-		src: src,
-		ctx: vpx.NewCodecCtx(),
-	}
-	switch codec {
-	case videoCodecVP8:
-		v.iface = vpx.DecoderIfaceVP8()
-	case videoCodecVP9:
-		v.iface = vpx.DecoderIfaceVP9()
-	default:
-		return nil, fmt.Errorf("webmplayer: unsupported VPX codec: %s", codec)
-	}
-	if err := vpx.Error(vpx.CodecDecInitVer(v.ctx, v.iface, nil, 0, vpx.DecoderABIVersion)); err != nil {
+		codec:              codec,
+		color:              color,
+		src:                src,
+		seek:               seek,
+		stats:              stats,
+		traceCtx:           ctx,
+		catchUpThreshold:   options.VideoCatchUpThreshold,
+		resyncOnError:      options.VideoResyncOnError,
+		codecPrivate:       track.CodecPrivate,
+		trackNumber:        track.TrackNumber,
+		audioPulled:        audioPulled,
+		audioLowWatermark:  options.AudioLowWatermark,
+		targetWidth:        options.VideoTargetWidth,
+		targetHeight:       options.VideoTargetHeight,
+		selectSpatialLayer: options.VideoSelectSpatialLayer && (options.VideoTargetWidth > 0 || options.VideoTargetHeight > 0),
+		onFrame:            options.OnVideoFrame,
+		hashFrames:         options.VideoHashFrames,
+		hashSeed:           maphash.MakeSeed(),
+		done:               make(chan struct{}),
+		scheduler:          options.DecodeScheduler,
+		adaptQuality:       options.VideoAdaptQuality,
+		fastStart:          options.FastStart,
+		atlas:              options.VideoAtlas,
+		cache:              newVideoFrameCache(options.VideoFrameCacheBytes, loop),
+		pool:               options.Pool,
+	}
+	if v.catchUpThreshold == 0 {
+		v.catchUpThreshold = defaultVideoCatchUpThreshold
+	}
+	if v.audioLowWatermark == 0 {
+		v.audioLowWatermark = defaultAudioLowWatermark
+	}
+	v.step.cache.budget = options.VideoStepCacheBytes
+	v.stepRecording = options.VideoStepCacheBytes > 0
+	if v.step.cache.budget <= 0 {
+		v.step.cache.budget = defaultVideoStepCacheBytes
+	}
+	queueSize := options.VideoFrameQueueSize
+	if queueSize <= 0 {
+		queueSize = defaultVideoFrameQueueSize
+	}
+	threads := options.VideoDecoderThreads
+	if threads <= 0 {
+		threads = defaultVideoDecoderThreads()
+	}
+	v.poolKey = videoDecoderKey{codec: codec, threads: threads, hardware: options.HardwareVideoDecoding && hasHardwareVideoDecoder(codec)}
+	cpus, err := decodeCPUs(options)
+	if err != nil {
+		return nil, err
+	}
+	v.cpus = cpus
+
+	// The decoders of NewVideoDecoder are not shared through the pool, as they depend on the options.
+	if options.NewVideoDecoder != nil {
+		v.pool = nil
+	}
+	var frames []videoFrame
+	if e := v.pool.takeVideo(v.poolKey); e != nil {
+		v.decoder = e.decoder
+		frames = e.frames
+		v.offscreen = e.offscreen
+		v.planes = e.planes
+		v.planesPix = e.planesPix
+	} else {
+		// The threads of the decoder inherit the affinity of the thread creating them.
+		var d videoDecoder
+		runOnCPUs(v.cpus, func() {
+			d, err = newPlayerVideoDecoder(options, codec, threads)
+		})
+		if err != nil {
+			return nil, err
+		}
+		v.decoder = d
+	}
+	// A pooled decoder counts for the stream taking it.
+	if d, ok := v.decoder.(cgoCounted); ok {
+		d.setCgoCounters(stats.cgo)
+	}
+	if err := v.decoder.start(track.CodecPrivate); err != nil {
+		v.decoder.destroy()
 		return nil, err
 	}
+	if color.alpha && (codec == videoCodecVP8 || codec == videoCodecVP9) {
+		a, err := newAlphaDecoder(codec)
+		if err != nil {
+			v.decoder.destroy()
+			return nil, err
+		}
+		v.alpha = a
+	}
+	v.frames = newFrameQueue(queueSize, frames)
+	if options.DecodeBudget > 0 {
+		v.ticks = newDecodeTicks(options.DecodeBudget, v.frames.done)
+	}
 	go v.loop()
 	return v, nil
 }
@@ -61,50 +284,860 @@ func (v *videoStream) Update(position time.Duration) error {
 		return *err
 	}
 	v.pos.Store(int64(position))
+	if v.adaptQuality {
+		v.updateQuality(time.Now())
+	}
+
+	// The frames decoded in the tick can be presented now.
+	v.ticks.tick()
+	v.present(position, 0)
 	return nil
 }
 
+// present presents the frame due at position plus lead, the time until the frame drawn now is on screen.
+func (v *videoStream) present(position, lead time.Duration) {
+	pos := position + lead
+	// With FastStart, the first frame is presented as soon as it is decoded.
+	if (v.fastStart && !v.shown) || v.settle {
+		if t, ok := v.frames.first(v.seek.Gen()); ok {
+			pos = max(pos, t)
+		}
+	}
+	if f := v.frames.front(pos, v.seek.Gen()); f != nil {
+		start := time.Now()
+		if v.onFrame != nil {
+			// Nothing is drawn, so the frame is not uploaded.
+			v.onFrame(newFrame(&v.framePool, f))
+		} else if v.frame != nil && f.content == v.uploaded {
+			// The frame on screen has the same pixels.
+			v.stats.repeatedFrames.Add(1)
+		} else {
+			v.upload(f)
+		}
+		if v.stepRecording {
+			v.step.record(f)
+		}
+		v.stats.presentLatency.observe(start.Sub(f.decoded))
+		v.stats.presentLateness.observe(pos - f.timecode)
+		v.stats.flight.late(FlightFramePresented, v.trackNumber, f.timecode, pos-f.timecode)
+		v.stats.mark(&v.stats.firstPresented)
+		v.shownGen = f.gen
+		v.shown = true
+		v.settle = false
+		v.shownTimecode = f.timecode
+		v.presentLead = lead
+		v.fresh = true
+		v.frames.release()
+	}
+}
+
+// upload uploads the frame f to the texture drawn by Draw.
+func (v *videoStream) upload(f *videoFrame) {
+	start := time.Now()
+	r := trace.StartRegion(v.traceCtx, "video.upload")
+	if f.isYCbCr {
+		v.drawYCbCr(f)
+	} else {
+		v.ensureOffscreen(f.rgba.Rect)
+		v.frame.WritePixels(f.rgba.Pix)
+		v.planar = yuvLayout{}
+		v.converted = true
+	}
+	r.End()
+	v.uploaded = f.content
+	v.stats.videoUpload.observe(time.Since(start))
+}
+
+// ready reports whether a frame after the latest seek has been drawn.
+func (v *videoStream) ready() bool {
+	return v.shown && v.shownGen == v.seek.Gen()
+}
+
+// presented returns the timecode of the frame presented last as of the position it was presented at, or false if no
+// new frame has been presented since the last call.
+func (v *videoStream) presented() (time.Duration, bool) {
+	fresh := v.fresh
+	v.fresh = false
+	return v.shownTimecode - v.presentLead, fresh
+}
+
+// lateThreshold returns how far a frame can be behind the position before it is too late to be presented.
+// A frame is on screen until the next frame, so a frame is late when it is behind by a frame interval.
+func (v *videoStream) lateThreshold() time.Duration {
+	interval := time.Duration(v.frameInterval.Load())
+	return min(max(interval, time.Second/60), 100*time.Millisecond)
+}
+
+// decodeLoad returns the ratio of the time to decode a frame to the duration of a frame.
+// If decodeLoad is close to 1 or more, the decoder can't keep up with the playback.
+func (v *videoStream) decodeLoad() float64 {
+	interval := v.frameInterval.Load()
+	if interval == 0 {
+		return 0
+	}
+	return float64(v.decodeTime.Load()) / float64(interval)
+}
+
+func (v *videoStream) SkippedFrames() int {
+	return int(v.skipped.Load())
+}
+
+// finished reports whether the decoder has reached the end of the stream and all the frames have been presented.
+func (v *videoStream) finished() bool {
+	return v.endGen.Load() == v.seek.Gen()+1 && v.frames.empty()
+}
+
 func (v *videoStream) Draw(f func(*ebiten.Image)) {
-	v.m.Lock()
-	defer v.m.Unlock()
-	if v.offscreen == nil {
+	if v.frame == nil {
+		if v.last != nil {
+			f(v.last)
+		}
 		return
 	}
-	f(v.offscreen)
+	v.convert()
+	f(v.frame)
+}
+
+// keepFrame copies the frame on screen so that Draw keeps drawing it after close.
+func (v *videoStream) keepFrame() {
+	if v.frame == nil {
+		return
+	}
+	v.convert()
+	b := v.frame.Bounds()
+	v.last = ebiten.NewImage(b.Dx(), b.Dy())
+	v.last.DrawImage(v.frame, nil)
 }
 
 func (v *videoStream) loop() {
+	defer close(v.done)
+	pinThread(v.cpus)
+
+	// catchingUp is true while the packets are skipped until the next keyframe.
+	var catchingUp bool
+
+	// gen is the seek generation of the decoder state, and target is the seek target of gen.
+	var gen uint64
+	var target time.Duration
+
+	// scrub is true if gen is a seek for scrubbing, and scrubbed is true when its frame has been published.
+	var scrub, scrubbed bool
+
+	// hidden is true while only the keyframes are decoded for a hidden Player.
+	var hidden bool
+
+	// last is the timecode of the last decoded packet, and spent is the time to decode the packets of last.
+	last := time.Duration(-1)
+	var spent time.Duration
+
+	// content is the content of the last published frame, and lastBuffer and lastHash identify its pixels.
+	// lastBuffer is the frame buffer that the frame refers to, which is not written while the frame's slot holds it, so
+	// a frame in the same buffer, e.g. a VP9 frame with show_existing_frame, has the same pixels.
+	var content uint64
+	var lastBuffer vpxfb.Buffer
+	var lastHash uint64
+
+	// quality is the quality level applied to the decoder.
+	var quality videoQuality
+
+	// spatialLayer is the highest spatial layer applied to the decoder, or -1 for all the layers.
+	spatialLayer := -1
+
+	// replaying is true if the frames of gen are replayed from the cache. The first pass can be recorded.
+	replaying := v.cache.start(gen, v.seek.Target())
+
+	// decoded is true if a packet has been given to the decoder since it was started.
+	var decoded bool
+
 loop:
-	for pkt := range v.src {
-		dataSize := uint32(len(pkt.Data))
-		if err := vpx.Error(vpx.CodecDecode(v.ctx, string(pkt.Data), dataSize, nil, 0)); err != nil {
-			v.err.Store(&err)
+	for {
+		if v.ticks != nil && v.src.empty() {
+			v.ticks.idle()
+		}
+		r := trace.StartRegion(v.traceCtx, "video.wait")
+		pkt, ok := v.src.pop()
+		r.End()
+		if !ok {
 			return
 		}
+		if pkt.gen != v.seek.Gen() {
+			continue
+		}
+		if pkt.gen != gen {
+			// The first packet after a seek. The reader is at a cluster with a keyframe.
+			gen = pkt.gen
+			target = v.seek.Target()
+			scrub = v.seek.scrub.Load()
+			scrubbed = false
+			catchingUp = true
+			last = -1
+			replaying = v.cache.start(gen, target)
+			// The decoder is reset in place, keeping its buffers, so that no frame of the previous position is left.
+			if decoded {
+				if err := v.decoder.start(v.codecPrivate); err != nil {
+					v.err.Store(&err)
+					return
+				}
+				if err := v.alpha.start(); err != nil {
+					v.err.Store(&err)
+					return
+				}
+				quality, spatialLayer = videoQualityFull, -1
+				decoded = false
+			}
+			if scrub && !replaying {
+				// The frames after the scrubbed frame are not published.
+				v.cache.skip()
+			}
+		}
+		if pkt.eos {
+			// All the frames of gen have been published.
+			v.cache.end(gen)
+			v.endGen.Store(gen + 1)
+			continue
+		}
+		if pkt.loop {
+			// The next pass of Loop follows without a seek, and can be replayed as a pass after a seek.
+			v.cache.end(gen)
+			replaying = v.cache.start(gen, pkt.Timecode)
+			continue
+		}
+
+		// libvpx rejects an empty packet with a non-nil pointer.
+		if len(pkt.Data) == 0 {
+			continue
+		}
+
+		if replaying {
+			if !v.replayFrames(pkt.Timecode, gen, target, &content) {
+				return
+			}
+			continue loop
+		}
+		if scrubbed {
+			continue
+		}
+
+		if q := videoQuality(v.quality.Load()); q != quality {
+			v.decoder.setSkipLoopFilter(q >= videoQualitySkipLoopFilter)
+			quality = q
+		}
+
 		pos := time.Duration(v.pos.Load())
-		if pos-time.Second/60 > pkt.Timecode {
+		info := parseVPXFrame(v.codec, pkt.Data)
+		if v.selectSpatialLayer && info.keyframe && v.codec == videoCodecVP9 {
+			if l := vp9SpatialLayer(pkt.Data, v.targetWidth, v.targetHeight); l != spatialLayer {
+				v.decoder.setSpatialLayer(l)
+				spatialLayer = l
+			}
+		}
+		if h := v.hidden.Load(); h != hidden {
+			hidden = h
+			// The frames after the keyframes decoded while hidden refer to the frames not decoded.
+			if !hidden {
+				catchingUp = true
+			}
+		}
+		// The keyframes keep the position and the frame on screen roughly up to date at a fraction of the cost, and
+		// pace the reader with the frame queue so that the audio keeps playing.
+		if hidden && !info.keyframe {
+			v.cache.skip()
+			continue loop
+		}
+		// Frames before the seek target must be decoded to reach the target.
+		if !catchingUp && !scrub && v.catchUpThreshold > 0 && pkt.Timecode >= target && pos-pkt.Timecode > v.catchUpThreshold {
+			catchingUp = true
+		}
+		if catchingUp && info.keyframe {
+			catchingUp = false
+		}
+		if catchingUp || (!info.reference && (quality >= videoQualityDropNonReference || (!scrub && pos-v.lateThreshold() > pkt.Timecode) || v.audioLow(pos))) {
+			v.skipped.Add(1)
+			v.cache.skip()
 			continue loop
 		}
 
-		var iter vpx.CodecIter
-		for img := vpx.CodecGetFrame(v.ctx, &iter); img != nil; img = vpx.CodecGetFrame(v.ctx, &iter) {
-			img.Deref()
-			if pos < pkt.Timecode {
-				time.Sleep(pkt.Timecode - pos)
+		v.acquireDecode(pkt.Timecode - pos)
+		// A newer seek cancels decoding toward the target, e.g. while scrubbing.
+		if v.seek.Gen() != gen {
+			v.scheduler.release()
+			continue loop
+		}
+		start := time.Now()
+		v.stats.flight.record(FlightVideoDecodeStart, pkt.TrackNumber, pkt.Timecode, 0)
+		r = trace.StartRegion(v.traceCtx, "video.decode")
+		v.alpha.decode(pkt.alpha)
+		err := v.decoder.decode(pkt.Data)
+		alpha, hasAlpha, alphaErr := v.alpha.picture()
+		r.End()
+		v.stats.flight.record(FlightVideoDecodeEnd, pkt.TrackNumber, pkt.Timecode, int64(time.Since(start)))
+		v.scheduler.release()
+		decoded = true
+		// An error of the alpha channel makes the frames opaque until its next keyframe.
+		if alphaErr != nil {
+			_ = v.alpha.start()
+		}
+		if err != nil {
+			if !v.resync() {
+				v.err.Store(&err)
+				return
 			}
-			// TODO: Use img.ImageYCbCr and a shader.
-			img := img.ImageRGBA()
+			// start turns the skipping of the loop filter and the spatial layer off.
+			quality, spatialLayer = videoQualityFull, -1
+			catchingUp = true
+			v.cache.skip()
+			continue loop
+		}
+		if pkt.Timecode != last {
+			if last >= 0 && pkt.Timecode > last {
+				updateAverage(&v.decodeTime, spent)
+				updateAverage(&v.frameInterval, pkt.Timecode-last)
+			}
+			last = pkt.Timecode
+			spent = 0
+		}
+		d := time.Since(start)
+		spent += d
+		v.decodeTotal.Add(int64(d))
+		v.stats.videoDecode.observe(d)
+		pos = time.Duration(v.pos.Load())
+		if pkt.Timecode < target {
+			continue loop
+		}
+		if !scrub && pos-v.lateThreshold() > pkt.Timecode {
+			v.stats.lateFrames.Add(1)
+			v.stats.flight.late(FlightFrameLate, pkt.TrackNumber, pkt.Timecode, pos-pkt.Timecode)
+			v.cache.skip()
+			continue loop
+		}
+		// The frames drawn at a lower quality are not cached.
+		if quality != videoQualityFull {
+			v.cache.skip()
+		}
 
-			v.m.Lock()
-			if v.offscreen != nil && v.offscreen.Bounds() != img.Bounds() {
-				v.offscreen.Deallocate()
-				v.offscreen = nil
+		for {
+			// dav1d decodes the frames in next as well as in decode.
+			v.acquireDecode(pkt.Timecode - pos)
+			p, ok, err := v.decoder.next()
+			v.scheduler.release()
+			if err != nil {
+				if !v.resync() {
+					v.err.Store(&err)
+					return
+				}
+				quality, spatialLayer = videoQualityFull, -1
+				catchingUp = true
+				v.cache.skip()
+				continue loop
+			}
+			if !ok {
+				break
+			}
+			if v.ticks != nil && v.frames.full() {
+				v.ticks.idle()
+			}
+			r := trace.StartRegion(v.traceCtx, "video.wait")
+			f := v.frames.back()
+			r.End()
+			if f == nil {
+				return
+			}
+			f.timecode = pkt.Timecode
+			f.gen = gen
+			f.decoded = time.Now()
+			k := 1
+			if v.onFrame != nil {
+				f.setRawImage(&p)
+			} else {
+				// A frame buffer is not reused while a frame refers to it, so the frame can refer to it until the slot
+				// is filled again.
+				w, h := v.drawnSize(&p, quality)
+				f.setDrawnImage(&p, w, h)
+				k = scaleFactor(image.Rect(0, 0, p.Width, p.Height), w, h)
 			}
-			if v.offscreen == nil {
-				v.offscreen = ebiten.NewImage(img.Bounds().Dx(), img.Bounds().Dy())
+			// The picture of the alpha channel is of the first frame of the packet.
+			var a *videoPicture
+			if hasAlpha && alphaErr == nil {
+				a = &alpha
+				hasAlpha = false
 			}
-			v.offscreen.WritePixels(img.Pix)
-			v.m.Unlock()
+			f.setAlpha(a, k)
+			if f.fb == (vpxfb.Buffer{}) || f.fb != lastBuffer || len(f.alpha) > 0 {
+				var hash uint64
+				if v.hashFrames {
+					hash = hashImage(v.hashSeed, &p.Image) ^ maphash.Bytes(v.hashSeed, f.alpha)
+				}
+				if !v.hashFrames || content == 0 || hash != lastHash {
+					content++
+				}
+				lastHash = hash
+			}
+			lastBuffer = f.fb
+			f.content = content
+			v.cache.record(f, gen)
+			v.frames.publish()
+			v.stats.mark(&v.stats.firstDecoded)
+			scrubbed = scrub
+		}
+	}
+}
+
+// resync restarts the decoder after a packet fails to decode with PlayerOptions.VideoResyncOnError, so that the
+// decoding resumes at the next keyframe. resync reports false if the error is to stop the decoding.
+func (v *videoStream) resync() bool {
+	if !v.resyncOnError {
+		return false
+	}
+	v.stats.videoResyncs.Add(1)
+	return v.decoder.start(v.codecPrivate) == nil && v.alpha.start() == nil
+}
+
+// replayFrames publishes the cached frames up to timecode instead of decoding the packet of timecode.
+// content is the content of the last published frame. replayFrames reports false if the frame queue is closed.
+func (v *videoStream) replayFrames(timecode time.Duration, gen uint64, target time.Duration, content *uint64) bool {
+	frames, offset := v.cache.replay(timecode)
+	for i := range frames {
+		c := &frames[i]
+		tc := c.frame.timecode + offset
+		if tc < target {
+			continue
+		}
+		if pos := time.Duration(v.pos.Load()); pos-v.lateThreshold() > tc {
+			v.stats.lateFrames.Add(1)
+			v.stats.flight.late(FlightFrameLate, v.trackNumber, tc, pos-tc)
+			continue
+		}
+		if v.ticks != nil && v.frames.full() {
+			v.ticks.idle()
+		}
+		r := trace.StartRegion(v.traceCtx, "video.wait")
+		f := v.frames.back()
+		r.End()
+		if f == nil {
+			return false
+		}
+		f.setCached(&c.frame)
+		f.timecode = tc
+		f.gen = gen
+		f.decoded = time.Now()
+		// Consecutive frames with the same content in the recorded pass have the same pixels.
+		if *content == 0 || c.content != v.cache.content {
+			*content++
+		}
+		v.cache.content = c.content
+		f.content = *content
+		v.frames.publish()
+		v.stats.cachedFrames.Add(1)
+		v.stats.mark(&v.stats.firstDecoded)
+	}
+	return true
+}
+
+// audioLow reports whether the audio read by the audio player is less than the watermark ahead of the position pos,
+// so that the video should leave the CPU to the audio decoder.
+func (v *videoStream) audioLow(pos time.Duration) bool {
+	return v.audioLowWatermark > 0 && !v.stepping.Load() && time.Duration(v.audioPulled.Load())-pos < v.audioLowWatermark
+}
+
+// acquireDecode waits for a slot of the scheduler for a decode call whose frame is due after due.
+// With PlayerOptions.DecodeBudget, acquireDecode waits for a tick first.
+func (v *videoStream) acquireDecode(due time.Duration) {
+	v.ticks.step()
+	if d := v.scheduler.acquire(false, time.Now().Add(due)); d > 0 {
+		v.stats.decodeWait.observe(d)
+	}
+}
+
+// hashImage returns the hash of the visible pixels of img.
+func hashImage(seed maphash.Seed, img *vpxfb.Image) uint64 {
+	var h maphash.Hash
+	h.SetSeed(seed)
+	var size [4]byte
+	binary.LittleEndian.PutUint16(size[:2], uint16(img.Width))
+	binary.LittleEndian.PutUint16(size[2:], uint16(img.Height))
+	h.Write(size[:])
+	bps := 1
+	if img.HighBitDepth {
+		bps = 2
+	}
+	for p, pix := range img.Planes {
+		w, rows := img.Width, img.Height
+		if p > 0 {
+			w = (w + 1<<img.XChromaShift - 1) >> img.XChromaShift
+			rows = (rows + 1<<img.YChromaShift - 1) >> img.YChromaShift
+		}
+		stride := img.Strides[p]
+		for y := 0; y < rows; y++ {
+			h.Write(pix[y*stride : y*stride+bps*w])
+		}
+	}
+	return h.Sum64()
+}
+
+// scaleFactor returns the largest integer factor to downscale an image of bounds by, keeping it at least w x h.
+// A dimension of 0 doesn't limit the factor.
+func scaleFactor(bounds image.Rectangle, w, h int) int {
+	if w <= 0 && h <= 0 {
+		return 1
+	}
+	k := math.MaxInt
+	if w > 0 {
+		k = bounds.Dx() / w
+	}
+	if h > 0 {
+		k = min(k, bounds.Dy()/h)
+	}
+	// Neither dimension is downscaled to nothing.
+	return max(min(k, bounds.Dx(), bounds.Dy()), 1)
+}
+
+// close stops the decoder, and frees the decoder state and the images or returns them to the pool.
+// The packet queue must be closed before close so that the decoder doesn't wait for packets.
+func (v *videoStream) close() {
+	v.frames.close()
+	<-v.done
+	v.alpha.destroy()
+	v.alpha = nil
+	v.frames.untrack()
+	if v.cache != nil {
+		v.cache.reset()
+	}
+	v.step.cache.reset()
+	for i := range v.frames.frames {
+		v.frames.frames[i].releaseBuffer()
+	}
+	v.pool.putVideo(v.poolKey, &pooledVideo{
+		decoder:   v.decoder,
+		frames:    v.frames.frames,
+		offscreen: v.offscreen,
+		planes:    v.planes,
+		planesPix: v.planesPix,
+	})
+	v.releaseRegion()
+	v.decoder, v.offscreen, v.frame, v.planes, v.planesPix = nil, nil, nil, nil, nil
+}
+
+// newVideoImage returns a new unmanaged image of w x h for the frames.
+//
+// The images are accounted in the memory budget until deallocateVideoImage.
+func newVideoImage(w, h int) *ebiten.Image {
+	trackMemory(memoryTextures, 4*int64(w)*int64(h))
+	return ebiten.NewImageWithOptions(image.Rect(0, 0, w, h), &ebiten.NewImageOptions{
+		Unmanaged: true,
+	})
+}
+
+// deallocateVideoImage deallocates an image of newVideoImage.
+func deallocateVideoImage(img *ebiten.Image) {
+	b := img.Bounds()
+	trackMemory(memoryTextures, -4*int64(b.Dx())*int64(b.Dy()))
+	img.Deallocate()
+}
+
+// releaseRegion returns the region of the atlas to the atlas.
+func (v *videoStream) releaseRegion() {
+	if v.region.Empty() {
+		return
+	}
+	v.atlas.release(v.region)
+	v.region = image.Rectangle{}
+}
+
+// updateAverage updates the exponential moving average avg by d. avg is updated only by one goroutine.
+func updateAverage(avg *atomic.Int64, d time.Duration) {
+	a := avg.Load()
+	if a == 0 {
+		avg.Store(int64(d))
+		return
+	}
+	avg.Store(a + (int64(d)-a)/16)
+}
+
+func (v *videoStream) ensureOffscreen(bounds image.Rectangle) {
+	if v.atlas != nil {
+		if !v.region.Empty() && v.region.Size() == bounds.Size() {
+			return
+		}
+		v.releaseRegion()
+		// A frame that doesn't fit in the atlas is drawn into its own offscreen.
+		if r, ok := v.atlas.alloc(bounds.Dx(), bounds.Dy()); ok {
+			v.region = r
+			v.frame = v.atlas.image.SubImage(r).(*ebiten.Image)
+			return
+		}
+	}
+	offscreen := growImage(v.offscreen, bounds.Dx(), bounds.Dy())
+	if offscreen == v.offscreen && v.frame != nil && v.frame.Bounds().Size() == bounds.Size() {
+		return
+	}
+	v.offscreen = offscreen
+	v.frame = offscreen.SubImage(image.Rectangle{Max: bounds.Size()}).(*ebiten.Image)
+}
+
+// growImage returns img if img is at least w x h. Otherwise growImage returns a new larger image.
+//
+// The images are rewritten entirely for every frame, so they are unmanaged: they are never on Ebitengine's internal
+// atlases to be moved or tracked pixel by pixel.
+func growImage(img *ebiten.Image, w, h int) *ebiten.Image {
+	if img != nil {
+		b := img.Bounds()
+		if b.Dx() >= w && b.Dy() >= h {
+			return img
+		}
+		w = max(w, b.Dx())
+		h = max(h, b.Dy())
+		deallocateVideoImage(img)
+	}
+	return newVideoImage(w, h)
+}
+
+//go:embed yuv.kage
+var yuvShaderSrc []byte
+
+// yuvDefaultEffect is the Effect of yuv.kage without PlayerDrawOptions.Shader.
+const yuvDefaultEffect = `
+func Effect(color vec4, pos vec2) vec4 {
+	return color
+}
+`
+
+// yuvShaderKey is the parameters that yuvShader specializes a shader for.
+type yuvShaderKey struct {
+	colorSpace vpxfb.ColorSpace
+	fullRange  bool
+	depth      int
+
+	// alpha is true if the planes have the A plane.
+	alpha bool
+
+	// effect is the source of PlayerDrawOptions.Shader fused into the conversion, or empty.
+	effect string
+}
+
+var (
+	yuvShadersM sync.Mutex
+	yuvShaders  = map[yuvShaderKey]*ebiten.Shader{}
+)
+
+// yuvShader returns the shader converting the planes of key to RGB. Each key has its own shader with the matrix,
+// the range and the sample layout as constants, so that the shader has no branches for them.
+func yuvShader(key yuvShaderKey) (*ebiten.Shader, error) {
+	yuvShadersM.Lock()
+	defer yuvShadersM.Unlock()
+	if s, ok := yuvShaders[key]; ok {
+		return s, nil
+	}
+	effect := key.effect
+	if effect == "" {
+		effect = yuvDefaultEffect
+	}
+	src := bytes.Replace(yuvShaderSrc, []byte("package main\n"), []byte("package main\n\n"+yuvConstants(key)+effect+"\n"), 1)
+	s, err := ebiten.NewShader(src)
+	if err != nil {
+		if key.effect != "" {
+			return nil, fmt.Errorf("webmplayer: compiling PlayerDrawOptions.Shader failed: %w", err)
+		}
+		return nil, err
+	}
+	yuvShaders[key] = s
+	return s, nil
+}
+
+// yuvLayout is the layout of the planes of a frame in videoStream.planes.
+type yuvLayout struct {
+	key  yuvShaderKey
+	w, h int
+
+	// cbw is the width of the Cb plane in texels, which is the offset of the Cr plane.
+	cbw int
+	ok  bool
+
+	// alphaY is the row of the A plane, if any.
+	alphaY int
+}
+
+// vertices returns the vertices of the rectangle of the frame transformed by geoM, with the premultiplied color c.
+func (l *yuvLayout) vertices(geoM *ebiten.GeoM, c ebiten.ColorScale) []ebiten.Vertex {
+	w, h := float32(l.w), float32(l.h)
+	vs := make([]ebiten.Vertex, 0, 4)
+	for _, s := range [4][2]float32{{0, 0}, {w, 0}, {0, h}, {w, h}} {
+		x, y := geoM.Apply(float64(s[0]), float64(s[1]))
+		vs = append(vs, ebiten.Vertex{
+			DstX:   float32(x),
+			DstY:   float32(y),
+			SrcX:   s[0],
+			SrcY:   s[1],
+			ColorR: c.R(),
+			ColorG: c.G(),
+			ColorB: c.B(),
+			ColorA: c.A(),
+		})
+	}
+	return vs
+}
+
+// uniforms returns the uniforms of yuv.kage for the layout, added to the uniforms of the effect.
+func (l *yuvLayout) uniforms(effect map[string]any) map[string]any {
+	u := make(map[string]any, len(effect)+3)
+	for k, v := range effect {
+		u[k] = v
+	}
+	u["ChromaOrigin"] = []float32{0, float32(l.h)}
+	u["CrOffset"] = float32(l.cbw)
+	u["AlphaOrigin"] = []float32{0, float32(l.alphaY)}
+	return u
+}
+
+var yuvIndices = []uint16{0, 1, 2, 1, 2, 3}
+
+// drawYCbCr uploads the planes of f to the atlas, which are converted to RGB into the offscreen with yuvShader by
+// convert. The upload costs 1.5 bytes per pixel instead of 4 bytes per pixel for RGBA, or 3 bytes per pixel for
+// 16-bit samples, which are uploaded as they are. The A plane costs 1 byte per pixel more.
+func (v *videoStream) drawYCbCr(f *videoFrame) {
+	cs, fullRange := v.color.apply(f.colorSpace, f.fullRange)
+
+	img := &f.ycbcr
+	w, h := img.Rect.Dx(), img.Rect.Dy()
+	cw, ch := (w+1)/2, (h+1)/2
+	bps := 1
+	if f.depth > 0 {
+		bps = 2
+	}
+
+	// Each texel of the atlas holds four bytes. Cb and Cr are placed side by side below Y, and A below them.
+	// The regions cover the strides so that the planes can be uploaded as they are.
+	yw := (img.YStride + 3) / 4
+	cbw := (img.CStride + 3) / 4
+	alpha := len(f.alpha) > 0
+	aw, ah := max(yw, 2*cbw), h+ch
+	if alpha {
+		aw, ah = max(aw, (f.alphaStride+3)/4), ah+h
+	}
+	v.planes = growImage(v.planes, aw, ah)
+
+	v.writePlane(image.Rect(0, 0, yw, h), img.Y[img.YOffset(img.Rect.Min.X, img.Rect.Min.Y):], img.YStride, bps*w)
+	v.writePlane(image.Rect(0, h, cbw, h+ch), img.Cb[img.COffset(img.Rect.Min.X, img.Rect.Min.Y):], img.CStride, bps*cw)
+	v.writePlane(image.Rect(cbw, h, 2*cbw, h+ch), img.Cr[img.COffset(img.Rect.Min.X, img.Rect.Min.Y):], img.CStride, bps*cw)
+	if alpha {
+		v.writePlane(image.Rect(0, h+ch, (f.alphaStride+3)/4, ah), f.alpha, f.alphaStride, w)
+	}
+
+	v.ensureOffscreen(img.Rect)
+	v.planar = yuvLayout{
+		key:    yuvShaderKey{colorSpace: cs, fullRange: fullRange, depth: f.depth, alpha: alpha},
+		w:      w,
+		h:      h,
+		cbw:    cbw,
+		ok:     true,
+		alphaY: h + ch,
+	}
+	v.converted = false
+}
+
+// convert converts the planes of the current frame into frame, unless it is converted.
+func (v *videoStream) convert() {
+	if v.converted || !v.planar.ok {
+		return
+	}
+	v.converted = true
+	shader, err := yuvShader(v.planar.key)
+	if err != nil {
+		v.err.Store(&err)
+		return
+	}
+	// The frame can be a region of an atlas, whose coordinates are the atlas's.
+	var geoM ebiten.GeoM
+	geoM.Translate(float64(v.frame.Bounds().Min.X), float64(v.frame.Bounds().Min.Y))
+	op := &ebiten.DrawTrianglesShaderOptions{}
+	op.Blend = ebiten.BlendCopy
+	op.Images[0] = v.planes
+	op.Uniforms = v.planar.uniforms(nil)
+	v.frame.DrawTrianglesShader(v.planar.vertices(&geoM, ebiten.ColorScale{}), yuvIndices, shader, op)
+}
+
+// drawEffect draws the current frame to screen by the conversion fused with the effect of options, and reports
+// whether it is drawn. The frame is not drawn if it is not drawn as YCbCr.
+func (v *videoStream) drawEffect(screen *ebiten.Image, geoM *ebiten.GeoM, options *PlayerDrawOptions) bool {
+	if v.frame == nil || !v.planar.ok {
+		return false
+	}
+	key := v.planar.key
+	key.effect = string(options.Shader)
+	shader, err := yuvShader(key)
+	if err != nil {
+		v.err.Store(&err)
+		return true
+	}
+	op := &ebiten.DrawTrianglesShaderOptions{}
+	op.Blend = options.Blend
+	op.Images[0] = v.planes
+	op.Uniforms = v.planar.uniforms(options.Uniforms)
+	screen.DrawTrianglesShader(v.planar.vertices(geoM, options.ColorScale), yuvIndices, shader, op)
+	return true
+}
+
+// yuvConstants returns the declarations of the constants of yuv.kage for key.
+func yuvConstants(key yuvShaderKey) string {
+	// kr and kb are the luma coefficients of R and B.
+	kr, kb := 0.299, 0.114
+	switch key.colorSpace {
+	case vpxfb.ColorSpaceBT709:
+		kr, kb = 0.2126, 0.0722
+	case vpxfb.ColorSpaceSMPTE240:
+		kr, kb = 0.212, 0.087
+	case vpxfb.ColorSpaceBT2020:
+		kr, kb = 0.2627, 0.0593
+	}
+	kg := 1 - kr - kb
+
+	// The chroma scale is folded into the matrix.
+	lumaScale, lumaOffset, chromaScale := 255.0/219, 16.0/255, 255.0/224
+	if key.fullRange {
+		lumaScale, lumaOffset, chromaScale = 1, 0, 1
+	}
+	samples, sampleScale := 4, 1.0
+	if key.depth > 8 {
+		samples, sampleScale = 2, 1/float64(int(1)<<(key.depth-8))
+	}
+	alpha := 0.0
+	if key.alpha {
+		alpha = 1
+	}
+	var b strings.Builder
+	for _, c := range []struct {
+		name  string
+		value float64
+	}{
+		{"SamplesPerTexel", float64(samples)},
+		{"SampleScale", sampleScale},
+		{"HasAlpha", alpha},
+		{"LumaScale", lumaScale},
+		{"LumaOffset", lumaOffset},
+		{"MatrixRCr", 2 * (1 - kr) * chromaScale},
+		{"MatrixGCb", 2 * kb * (1 - kb) / kg * chromaScale},
+		{"MatrixGCr", 2 * kr * (1 - kr) / kg * chromaScale},
+		{"MatrixBCb", 2 * (1 - kb) * chromaScale},
+	} {
+		fmt.Fprintf(&b, "const %s = %s\n", c.name, strconv.FormatFloat(c.value, 'f', -1, 64))
+	}
+	return b.String()
+}
+
+// writePlane writes rows of width bytes to the region r of the atlas.
+// If the rows are already laid out as the region's texels, they are uploaded without being copied.
+func (v *videoStream) writePlane(r image.Rectangle, plane []byte, stride int, width int) {
+	n := 4 * r.Dx() * r.Dy()
+	var pix []byte
+	if stride == 4*r.Dx() && len(plane) >= n {
+		pix = plane[:n]
+	} else {
+		if cap(v.planesPix) < n {
+			v.planesPix = make([]byte, n)
+		}
+		pix = v.planesPix[:n]
+		for j := 0; j < r.Dy(); j++ {
+			copy(pix[4*r.Dx()*j:4*r.Dx()*j+width], plane[stride*j:])
 		}
 	}
+	v.planes.SubImage(r).(*ebiten.Image).WritePixels(pix)
 }
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"fmt"
+
+	"github.com/hajimehoshi/ebiten/v2"
+)
+
+// PlayerView is another handle of a Player, e.g. for each tile of a video wall showing the same clip in sync.
+// The views of a Player share its decoders and the texture of its frames: a frame is decoded and uploaded once, and
+// each view draws it with its own PlayerDrawOptions.
+//
+// The Player and its views can each call Update every tick, and the Player is updated once a tick however many of
+// them do. The Player is released when it and all its views are closed, so the views keep playing after the Player is
+// closed. The playback is controlled by the Player until it is closed.
+type PlayerView struct {
+	player *Player
+
+	// updated is the last tick of the Player updated by the view's Update.
+	updated uint64
+	closed  bool
+}
+
+// NewView returns a new view of p.
+func (p *Player) NewView() (*PlayerView, error) {
+	if p.closed || p.released {
+		return nil, fmt.Errorf("webmplayer: the player is closed")
+	}
+	p.views++
+	return &PlayerView{
+		player:  p,
+		updated: p.tick,
+	}, nil
+}
+
+// Update updates the Player of v, unless the Player or another view has updated it in this tick.
+func (v *PlayerView) Update() error {
+	if v.closed {
+		return nil
+	}
+	return v.player.updateBy(&v.updated)
+}
+
+// Draw draws the current frame of the Player as Player.Draw does.
+func (v *PlayerView) Draw(screen *ebiten.Image, options *PlayerDrawOptions) {
+	if v.closed {
+		return
+	}
+	v.player.Draw(screen, options)
+}
+
+// Close closes v. If the Player has been closed, the last view releases the Player as Player.Close does.
+func (v *PlayerView) Close() error {
+	if v.closed {
+		return nil
+	}
+	v.closed = true
+	p := v.player
+	p.views--
+	if p.views == 0 && p.released {
+		return p.close()
+	}
+	return nil
+}
+
+// updateBy updates p for a handle whose last updated tick is updated. A handle updating p again starts the next
+// tick, and the other handles don't update p until their next ticks.
+func (p *Player) updateBy(updated *uint64) error {
+	if *updated < p.tick {
+		*updated = p.tick
+		return nil
+	}
+	p.tick++
+	*updated = p.tick
+	return p.update()
+}
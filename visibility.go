@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"time"
+)
+
+// SetVisible sets whether the video of the Player is visible, e.g. false for a tile scrolled off a list or a hidden
+// tab. The Player is visible by default.
+//
+// While hidden, the video decoder decodes only the keyframes to follow the position, without decoding, converting and
+// uploading the other frames. When the Player becomes visible, the video resyncs at the next keyframe. The audio keeps
+// playing; Pause or SetVolume stops it if it is not wanted.
+func (p *Player) SetVisible(visible bool) {
+	p.hidden = !visible
+	if visible {
+		p.drawn = time.Now()
+	}
+}
+
+// IsVisible reports whether the video of the Player is visible by SetVisible and PlayerOptions.HiddenAfter.
+func (p *Player) IsVisible() bool {
+	if p.hidden {
+		return false
+	}
+	return p.hiddenAfter <= 0 || time.Since(p.drawn) < p.hiddenAfter
+}
+
+// updateVisibility lets the video decoder know whether the Player is visible. Stepping and scrubbing decode the frames
+// to be shown anyway.
+func (p *Player) updateVisibility() {
+	if p.videoStream == nil {
+		return
+	}
+	hidden := (p.background || !p.IsVisible()) && !p.videoStream.step.active && !p.scrubbing && !p.scrubSettling
+	p.videoStream.hidden.Store(hidden)
+}
+
+// SetBackground sets whether the Player plays in the background, e.g. while the window is minimized. In the
+// background, only the audio plays: the video is neither decoded nor uploaded, and the reader skips the data of the
+// video blocks without reading it.
+//
+// When the Player returns to the foreground, the video resumes at the next keyframe at the audio position. A video
+// input separate from the audio input is paused in the background, and resumes from the keyframe before the
+// position.
+func (p *Player) SetBackground(background bool) {
+	if p.closed || p.stopped || p.videoStream == nil || background == p.background {
+		return
+	}
+	p.stopStep()
+	p.background = background
+	if p.videoSource == p.audioSource {
+		p.videoSource.setBackground(background)
+	} else {
+		p.videoSource.pause(background || p.paused)
+		if !background {
+			p.videoSource.Seek(p.clock.Position())
+		}
+	}
+	p.updateVisibility()
+}
+
+// IsBackground reports whether the Player plays in the background by SetBackground.
+func (p *Player) IsBackground() bool {
+	return p.background
+}
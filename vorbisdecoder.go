@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !js
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"runtime/trace"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer/internal/libvorbis"
+)
+
+// vorbisDecoder is an audioDecoder of Vorbis. The decoded PCM is kept in libvorbis, and interleaved into the
+// destination directly.
+type vorbisDecoder struct {
+	// info must be kept as dsp has a reference to it.
+	info  *libvorbis.Info
+	dsp   *libvorbis.DspState
+	block *libvorbis.Block
+
+	// poolKey is the shift of the decoded rate and the codec private data.
+	poolKey string
+
+	// source is the buffer of the decoded channels to measure the loudness before the downmix.
+	source []float32
+}
+
+func newVorbisDecoder(a *audioStream, codecPrivate []byte, options *PlayerOptions) (*vorbisDecoder, error) {
+	var shift int
+	switch options.AudioRateDivisor {
+	case 0, 1:
+	case 2:
+		shift = 1
+	case 4:
+		shift = 2
+	default:
+		return nil, fmt.Errorf("webmplayer: AudioRateDivisor must be 1, 2 or 4: %d", options.AudioRateDivisor)
+	}
+	v := &vorbisDecoder{
+		poolKey: fmt.Sprintf("%d:%s", shift, codecPrivate),
+	}
+	if p := a.pool.takeVorbis(v.poolKey); p != nil {
+		// The same headers make the same decoder, so the headers are not parsed again.
+		v.info, v.dsp, v.block = p.info, p.dsp, p.block
+	} else {
+		info, comment, err := readVorbisCodecPrivate(codecPrivate)
+		if err != nil {
+			return nil, err
+		}
+		comment.Clear()
+		v.info = info
+	}
+	info := v.info
+
+	if info.Channels() != a.channels {
+		return nil, fmt.Errorf("webmplayer: channel count doesn't match: %d vs %d", info.Channels(), a.channels)
+	}
+	if info.Rate() != a.samplingFrequency {
+		samplingFrequency := a.samplingFrequency
+		a.samplingFrequency = info.Rate()
+		return nil, fmt.Errorf("webmplayer: sample rate doesn't match: %d vs %d", info.Rate(), samplingFrequency)
+	}
+
+	if v.dsp == nil {
+		// The short blocks can be too small for the reduced rate. Use the lowest rate they allow then.
+		for ; shift > 0; shift-- {
+			if libvorbis.SynthesisHalfrate(info, shift) == nil {
+				break
+			}
+		}
+		dsp, err := libvorbis.SynthesisInit(info)
+		if err != nil {
+			return nil, fmt.Errorf("webmplayer: libvorbis.SynthesisInit failed: %w", err)
+		}
+		v.dsp = dsp
+
+		block, err := libvorbis.BlockInit(v.dsp)
+		if err != nil {
+			return nil, fmt.Errorf("webmplayer: libvorbis.BlockInit failed: %w", err)
+		}
+		v.block = block
+	}
+	a.samplingFrequency = info.Rate() >> libvorbis.SynthesisHalfrateP(info)
+	libvorbis.SynthesisParallelChannels(v.dsp, options.AudioParallelChannels && a.channels >= 6)
+
+	if a.channels > 2 {
+		var err error
+		a.downmix, err = downmixMatrix(options.AudioDownmix, a.channels)
+		if err != nil {
+			return nil, err
+		}
+		a.loudnessWeights = surroundLoudnessWeights(a.channels)
+	}
+	return v, nil
+}
+
+func (v *vorbisDecoder) read(a *audioStream, dst []float32) (int, error) {
+	cgo := a.stream.stats.cgo
+	if len(a.packets) == 0 {
+		cgoStart := cgo.start()
+		source := a.sourceBuffer(&v.source, len(dst)/2)
+		n, _, err := libvorbis.SynthesisBatch(v.dsp, v.block, nil, dst, a.downmix, source, &a.skip)
+		cgo.end(cgoVorbisSynthesis, cgoStart, 0, 0, bytesPerFrame*n)
+		if source != nil {
+			a.meterSource(source[:n*a.channels])
+		}
+		return 2 * n, err
+	}
+	for len(a.packets) > 0 {
+		start := time.Now()
+		r := trace.StartRegion(a.stream.ctx, "audio.decode")
+		batch := a.batchData()
+		source := a.sourceBuffer(&v.source, len(dst)/2)
+		n, consumed, err := libvorbis.SynthesisBatch(v.dsp, v.block, batch, dst, a.downmix, source, &a.skip)
+		r.End()
+		cgo.end(cgoVorbisSynthesis, start, consumed, packetBytes(batch[:consumed]), bytesPerFrame*n)
+		if source != nil {
+			a.meterSource(source[:n*a.channels])
+		}
+		a.consumePackets(consumed, time.Since(start))
+		a.stream.stats.audioArena.Store(int64(v.block.LocalStoreSize()))
+		if err != nil {
+			return 2 * n, fmt.Errorf("webmplayer: libvorbis.SynthesisBatch failed: %w", err)
+		}
+		if n > 0 || consumed == 0 {
+			return 2 * n, nil
+		}
+	}
+	return 0, nil
+}
+
+func (v *vorbisDecoder) reset() error {
+	if err := libvorbis.SynthesisRestart(v.dsp); err != nil {
+		return fmt.Errorf("webmplayer: libvorbis.SynthesisRestart failed: %w", err)
+	}
+	return nil
+}
+
+func (v *vorbisDecoder) close(pool *PlayerPool) {
+	if v.block != nil {
+		pool.putVorbis(v.poolKey, &pooledVorbis{
+			info:  v.info,
+			dsp:   v.dsp,
+			block: v.block,
+		})
+	}
+	v.block, v.dsp, v.info = nil, nil, nil
+}
+
+func readVorbisCodecPrivate(codecPrivate []byte) (*libvorbis.Info, *libvorbis.Comment, error) {
+	if len(codecPrivate) < 1 {
+		return nil, nil, errors.New("webmplayer: codec private data is too short")
+	}
+
+	// https://www.matroska.org/technical/codec_specs.html
+	// > Byte 1: number of distinct packets #p minus one inside the CodecPrivate block. This MUST be “2” for current (as of 2016-07-08) Vorbis headers.
+	if codecPrivate[0] != 0x02 {
+		return nil, nil, fmt.Errorf("webmplayer: wrong codec private data for Vorbis: %d", codecPrivate[0])
+	}
+
+	// The Xiph lacing of the headers is split in libvorbis, so that all the headers are parsed in one cgo call.
+	info := libvorbis.InfoInit()
+	comment := libvorbis.CommentInit()
+	if err := libvorbis.SynthesisHeaderinXiph(info, comment, codecPrivate); err != nil {
+		return nil, nil, fmt.Errorf("webmplayer: libvorbis.SynthesisHeaderinXiph failed: %w", err)
+	}
+
+	return info, comment, nil
+}
+
+// pooledVorbis is an idle Vorbis decoder in a PlayerPool.
+type pooledVorbis struct {
+	info  *libvorbis.Info
+	dsp   *libvorbis.DspState
+	block *libvorbis.Block
+}
+
+// restart resets the decoder state for the next stream of the same headers.
+func (v *pooledVorbis) restart() error {
+	return libvorbis.SynthesisRestart(v.dsp)
+}
+
+func (v *pooledVorbis) free() {
+	// A block refers to the DSP state, and the DSP state refers to the info.
+	v.block.Clear()
+	v.dsp.Clear()
+	v.info.Clear()
+}
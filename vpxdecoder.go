@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+//go:build !js
+
+package webmplayer
+
+import (
+	"fmt"
+	"unsafe"
+
+	"github.com/xlab/libvpx-go/vpx"
+
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// vpxDecoder is a libvpx decoder.
+type vpxDecoder struct {
+	ctx *vpx.CodecCtx
+
+	// fb is the frame buffers that ctx decodes into, or nil if the codec doesn't support external frame buffers.
+	fb *vpxfb.Pool
+
+	iter vpx.CodecIter
+
+	// vp9 is true for VP9, and skipLoopFilter is true while the loop filter is skipped.
+	vp9            bool
+	skipLoopFilter bool
+
+	// spatialLayer is the highest spatial layer decoded, or -1 for all the layers.
+	spatialLayer int
+
+	// cgo is the counters of the calls with PlayerOptions.CgoStats, or nil.
+	cgo *cgoCounters
+}
+
+// newVPXDecoder creates a libvpx decoder of codec.
+func newVPXDecoder(codec videoCodec, threads int) (*vpxDecoder, error) {
+	var iface *vpx.CodecIface
+	switch codec {
+	case videoCodecVP8:
+		iface = vpx.DecoderIfaceVP8()
+	case videoCodecVP9:
+		iface = vpx.DecoderIfaceVP9()
+	default:
+		return nil, fmt.Errorf("webmplayer: unsupported VPX codec: %s", codec)
+	}
+	ctx := vpx.NewCodecCtx()
+	cfg := &vpx.CodecDecCfg{
+		Threads: uint32(threads),
+	}
+	if err := vpx.Error(vpx.CodecDecInitVer(ctx, iface, cfg, 0, vpx.DecoderABIVersion)); err != nil {
+		vpx.CodecDestroy(ctx)
+		return nil, err
+	}
+	d := &vpxDecoder{
+		ctx:          ctx,
+		vp9:          codec == videoCodecVP9,
+		spatialLayer: -1,
+	}
+	// The tiles are decoded in parallel by cfg. With row-MT, the rows within a tile are too, e.g. for 4K VP9 with
+	// fewer tiles than the threads. Without row-MT in libvpx, only the tiles are parallel.
+	if d.vp9 && threads > 1 {
+		_ = vpxfb.SetRowMT(unsafe.Pointer(ctx.Ref()), true)
+	}
+	// VP8 doesn't support external frame buffers, and the frames are copied.
+	if fb, err := vpxfb.Attach(unsafe.Pointer(ctx.Ref())); err == nil {
+		d.fb = fb
+	}
+	return d, nil
+}
+
+// start resets the decoder in place instead of recreating it, which would reallocate the frame buffers and restart
+// the threads. A keyframe resets the rest of the decoder state.
+func (d *vpxDecoder) start(codecPrivate []byte) error {
+	var iter vpx.CodecIter
+	d.iter = iter
+	if err := vpxfb.Flush(unsafe.Pointer(d.ctx.Ref())); err != nil {
+		return fmt.Errorf("webmplayer: %w", err)
+	}
+	d.setSkipLoopFilter(false)
+	d.setSpatialLayer(-1)
+	return nil
+}
+
+// decode passes data to libvpx without copying it.
+// The string aliases data only during the call, and libvpx doesn't keep the pointer after vpx_codec_decode returns.
+func (d *vpxDecoder) decode(data []byte) error {
+	var iter vpx.CodecIter
+	d.iter = iter
+	s := unsafe.String(unsafe.SliceData(data), len(data))
+	start := d.cgo.start()
+	err := vpx.Error(vpx.CodecDecode(d.ctx, s, uint32(len(data)), nil, 0))
+	d.cgo.end(cgoVPXDecode, start, 1, len(data), 0)
+	return err
+}
+
+func (d *vpxDecoder) next() (videoPicture, bool, error) {
+	start := d.cgo.start()
+	img := vpx.CodecGetFrame(d.ctx, &d.iter)
+	if img == nil {
+		d.cgo.end(cgoVPXGetFrame, start, 0, 0, 0)
+		return videoPicture{}, false, nil
+	}
+	p := videoPicture{
+		Image: vpxfb.ImageOf(unsafe.Pointer(img.Ref())),
+	}
+	if d.cgo != nil {
+		d.cgo.end(cgoVPXGetFrame, start, 0, 0, len(p.Planes[0])+len(p.Planes[1])+len(p.Planes[2]))
+	}
+	if d.fb != nil {
+		p.pooled = unsafe.Pointer(img.Ref())
+	}
+	return p, true, nil
+}
+
+func (d *vpxDecoder) setCgoCounters(c *cgoCounters) {
+	d.cgo = c
+}
+
+// setSkipLoopFilter skips the loop filter of VP9. VP8 always applies the loop filter.
+func (d *vpxDecoder) setSkipLoopFilter(skip bool) {
+	if !d.vp9 || skip == d.skipLoopFilter {
+		return
+	}
+	if vpxfb.SetSkipLoopFilter(unsafe.Pointer(d.ctx.Ref()), skip) == nil {
+		d.skipLoopFilter = skip
+	}
+}
+
+// setSpatialLayer limits the spatial layers of VP9. libvpx counts the frames of a superframe as the layers, so the
+// limit must be set only for a stream with spatial layers.
+func (d *vpxDecoder) setSpatialLayer(layer int) {
+	if !d.vp9 || layer == d.spatialLayer {
+		return
+	}
+	// A superframe has up to 8 frames, so the highest layer decodes all of them.
+	l := layer
+	if l < 0 {
+		l = 7
+	}
+	if vpxfb.SetSVCSpatialLayer(unsafe.Pointer(d.ctx.Ref()), l) == nil {
+		d.spatialLayer = layer
+	}
+}
+
+func (d *vpxDecoder) destroy() {
+	vpx.CodecDestroy(d.ctx)
+	// libvpx releases the frame buffers at destroying.
+	if d.fb != nil {
+		d.fb.Free()
+	}
+}
@@ -0,0 +1,383 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// vpxFrameInfo is the information read from the uncompressed header of a VP8/VP9/AV1 frame.
+type vpxFrameInfo struct {
+	// keyframe reports whether the frame can be decoded without any other frames.
+	keyframe bool
+
+	// reference reports whether the frame might be referred by later frames.
+	// Frames that are not references can be skipped without breaking the decoding of later frames.
+	reference bool
+}
+
+func parseVPXFrame(codec videoCodec, data []byte) vpxFrameInfo {
+	switch codec {
+	case videoCodecVP8:
+		return parseVP8Frame(data)
+	case videoCodecVP9:
+		return parseVP9Frame(data)
+	case videoCodecAV1:
+		return parseAV1Frame(data)
+	}
+	return vpxFrameInfo{reference: true}
+}
+
+func parseVP8Frame(data []byte) vpxFrameInfo {
+	// https://datatracker.ietf.org/doc/html/rfc6386#section-9.1
+	if len(data) < 3 {
+		return vpxFrameInfo{reference: true}
+	}
+	// The reference flags are in the compressed header, so all the frames are treated as references.
+	return vpxFrameInfo{
+		keyframe:  data[0]&1 == 0,
+		reference: true,
+	}
+}
+
+func parseVP9Frame(data []byte) vpxFrameInfo {
+	// https://storage.googleapis.com/downloads.webmproject.org/docs/vp9/vp9-bitstream-specification-v0.7-20170222-draft.pdf
+	// 6.2 Uncompressed header syntax
+	if len(data) == 0 {
+		return vpxFrameInfo{reference: true}
+	}
+
+	// A superframe usually starts with a hidden alternate reference frame.
+	// Check only the first frame as keyframe.
+	superframe := data[len(data)-1]&0xe0 == 0xc0
+
+	r := bitReader{data: data}
+	if r.read(2) != 2 {
+		// Invalid frame marker.
+		return vpxFrameInfo{reference: true}
+	}
+	profile := r.read(1) | r.read(1)<<1
+	if profile == 3 {
+		r.read(1)
+	}
+	if r.read(1) == 1 {
+		// show_existing_frame doesn't update any references.
+		return vpxFrameInfo{}
+	}
+	frameType := r.read(1)
+	showFrame := r.read(1)
+	errorResilientMode := r.read(1)
+	if frameType == 0 {
+		return vpxFrameInfo{
+			keyframe:  true,
+			reference: true,
+		}
+	}
+	if superframe {
+		return vpxFrameInfo{reference: true}
+	}
+	var intraOnly uint32
+	if showFrame == 0 {
+		intraOnly = r.read(1)
+	}
+	if errorResilientMode == 0 {
+		r.read(2)
+	}
+	if intraOnly == 1 {
+		return vpxFrameInfo{reference: true}
+	}
+	refreshFrameFlags := r.read(8)
+	if r.overrun {
+		return vpxFrameInfo{reference: true}
+	}
+	return vpxFrameInfo{
+		reference: refreshFrameFlags != 0,
+	}
+}
+
+// vpxShowsFrame reports whether the packet data of codec outputs a frame, so that decode waits for it. A hidden
+// alternate reference frame outputs nothing.
+func vpxShowsFrame(codec videoCodec, data []byte) bool {
+	switch codec {
+	case videoCodecVP8:
+		// https://datatracker.ietf.org/doc/html/rfc6386#section-9.1
+		return len(data) < 3 || data[0]&0x10 != 0
+	case videoCodecVP9:
+		for _, f := range vp9Frames(data) {
+			if vp9ShowsFrame(f) {
+				return true
+			}
+		}
+		return false
+	}
+	return true
+}
+
+// vp9Frames returns the frames of the superframe data, or data itself if it is not a superframe.
+// https://storage.googleapis.com/downloads.webmproject.org/docs/vp9/vp9-bitstream-specification-v0.7-20170222-draft.pdf
+// Annex B Superframes
+func vp9Frames(data []byte) [][]byte {
+	if len(data) == 0 {
+		return nil
+	}
+	marker := data[len(data)-1]
+	if marker&0xe0 != 0xc0 {
+		return [][]byte{data}
+	}
+	n := int(marker&7) + 1
+	sizeLen := int(marker>>3&3) + 1
+	index := 2 + sizeLen*n
+	if len(data) < index || data[len(data)-index] != marker {
+		return [][]byte{data}
+	}
+	sizes := data[len(data)-index+1:]
+	frames := make([][]byte, 0, n)
+	var offset int
+	for i := 0; i < n; i++ {
+		var size int
+		for b := 0; b < sizeLen; b++ {
+			size |= int(sizes[i*sizeLen+b]) << (8 * b)
+		}
+		if offset+size > len(data)-index {
+			break
+		}
+		frames = append(frames, data[offset:offset+size])
+		offset += size
+	}
+	return frames
+}
+
+// vp9ShowsFrame reports whether the VP9 frame data is shown. A broken header is treated as shown.
+func vp9ShowsFrame(data []byte) bool {
+	// 6.2 Uncompressed header syntax
+	r := bitReader{data: data}
+	if r.read(2) != 2 {
+		return true
+	}
+	profile := r.read(1) | r.read(1)<<1
+	if profile == 3 {
+		r.read(1)
+	}
+	if r.read(1) == 1 {
+		// show_existing_frame
+		return true
+	}
+	r.read(1)
+	return r.read(1) == 1 || r.overrun
+}
+
+// vpxKeyframe is the stream format read from the uncompressed header of a VP8/VP9 keyframe, which a hardware
+// decoder needs before decoding.
+type vpxKeyframe struct {
+	width  int
+	height int
+
+	// profile is the VP9 profile, or 0 for VP8.
+	profile  int
+	bitDepth int
+
+	// xChromaShift and yChromaShift are the subsampling of the chroma planes.
+	xChromaShift int
+	yChromaShift int
+
+	colorSpace vpxfb.ColorSpace
+	fullRange  bool
+}
+
+// parseVPXKeyframe returns the stream format of the packet data of codec, or false if data is not a keyframe.
+func parseVPXKeyframe(codec videoCodec, data []byte) (vpxKeyframe, bool) {
+	switch codec {
+	case videoCodecVP8:
+		// https://datatracker.ietf.org/doc/html/rfc6386#section-9.1
+		if len(data) < 10 || data[0]&1 != 0 || data[3] != 0x9d || data[4] != 0x01 || data[5] != 0x2a {
+			return vpxKeyframe{}, false
+		}
+		// The color space and the clamping type are in the compressed header, so the defaults are used.
+		return vpxKeyframe{
+			width:        int(data[6]) | int(data[7]&0x3f)<<8,
+			height:       int(data[8]) | int(data[9]&0x3f)<<8,
+			bitDepth:     8,
+			xChromaShift: 1,
+			yChromaShift: 1,
+			colorSpace:   vpxfb.ColorSpaceBT601,
+		}, true
+	case videoCodecVP9:
+		for _, f := range vp9Frames(data) {
+			if k, ok := parseVP9Keyframe(f); ok {
+				return k, true
+			}
+		}
+	}
+	return vpxKeyframe{}, false
+}
+
+func parseVP9Keyframe(data []byte) (vpxKeyframe, bool) {
+	// 6.2 Uncompressed header syntax
+	r := bitReader{data: data}
+	if r.read(2) != 2 {
+		return vpxKeyframe{}, false
+	}
+	k := vpxKeyframe{
+		profile: int(r.read(1) | r.read(1)<<1),
+	}
+	if k.profile == 3 {
+		r.read(1)
+	}
+	// show_existing_frame and frame_type
+	if r.read(1) == 1 || r.read(1) != 0 {
+		return vpxKeyframe{}, false
+	}
+	// show_frame and error_resilient_mode
+	r.read(2)
+	if r.read(24) != 0x498342 {
+		return vpxKeyframe{}, false
+	}
+
+	readVP9ColorConfig(&r, &k)
+
+	// 6.2.3 Frame size syntax
+	k.width = int(r.read(16)) + 1
+	k.height = int(r.read(16)) + 1
+	if r.overrun {
+		return vpxKeyframe{}, false
+	}
+	return k, true
+}
+
+// readVP9ColorConfig reads the color config of a VP9 frame to k, whose profile is set.
+func readVP9ColorConfig(r *bitReader, k *vpxKeyframe) {
+	// 6.2.2 Color config syntax
+	k.bitDepth = 8
+	if k.profile >= 2 {
+		k.bitDepth = 10
+		if r.read(1) == 1 {
+			k.bitDepth = 12
+		}
+	}
+	k.colorSpace = vpxfb.ColorSpace(r.read(3))
+	k.xChromaShift, k.yChromaShift = 1, 1
+	if k.colorSpace != vpxfb.ColorSpaceSRGB {
+		k.fullRange = r.read(1) == 1
+		if k.profile == 1 || k.profile == 3 {
+			k.xChromaShift, k.yChromaShift = int(r.read(1)), int(r.read(1))
+			r.read(1)
+		}
+	} else {
+		k.fullRange = true
+		k.xChromaShift, k.yChromaShift = 0, 0
+		if k.profile == 1 || k.profile == 3 {
+			r.read(1)
+		}
+	}
+}
+
+// vp9FrameSize returns the size of a VP9 frame, or false if the frame has the size of a reference frame.
+func vp9FrameSize(data []byte) (int, int, bool) {
+	r := bitReader{data: data}
+	if r.read(2) != 2 {
+		return 0, 0, false
+	}
+	k := vpxKeyframe{
+		profile: int(r.read(1) | r.read(1)<<1),
+	}
+	if k.profile == 3 {
+		r.read(1)
+	}
+	if r.read(1) == 1 {
+		// show_existing_frame
+		return 0, 0, false
+	}
+	if r.read(1) == 0 {
+		k, ok := parseVP9Keyframe(data)
+		return k.width, k.height, ok
+	}
+	showFrame := r.read(1)
+	errorResilientMode := r.read(1)
+	var intraOnly uint32
+	if showFrame == 0 {
+		intraOnly = r.read(1)
+	}
+	if errorResilientMode == 0 {
+		// reset_frame_context
+		r.read(2)
+	}
+	if intraOnly == 1 {
+		if r.read(24) != 0x498342 {
+			return 0, 0, false
+		}
+		// The color config of profile 0 is implicit in an intra-only frame.
+		if k.profile > 0 {
+			readVP9ColorConfig(&r, &k)
+		}
+		// refresh_frame_flags
+		r.read(8)
+	} else {
+		// refresh_frame_flags, and ref_frame_idx and ref_frame_sign_bias of 3 references
+		r.read(8 + 3*4)
+		// 6.2.6 Frame size with refs syntax
+		for range 3 {
+			if r.read(1) == 1 {
+				return 0, 0, false
+			}
+		}
+	}
+	w, h := int(r.read(16))+1, int(r.read(16))+1
+	if r.overrun {
+		return 0, 0, false
+	}
+	return w, h, true
+}
+
+// vp9SpatialLayer returns the lowest spatial layer of the SVC keyframe superframe data that is at least width x
+// height, or -1 if data doesn't have several spatial layers or the highest layer is needed. A layer without an
+// explicit size is assumed to be twice the size of the layer below, as the usual SVC configurations are.
+// If width or height is 0, that dimension doesn't limit the layer.
+func vp9SpatialLayer(data []byte, width, height int) int {
+	frames := vp9Frames(data)
+	if len(frames) < 2 {
+		return -1
+	}
+	ws := make([]int, len(frames))
+	hs := make([]int, len(frames))
+	for i, f := range frames {
+		w, h, ok := vp9FrameSize(f)
+		if !ok {
+			if i == 0 {
+				return -1
+			}
+			w, h = 2*ws[i-1], 2*hs[i-1]
+		}
+		// A frame that is not larger than the one below is not a spatial layer, e.g. an alternate reference frame.
+		if i > 0 && w <= ws[i-1] && h <= hs[i-1] {
+			return -1
+		}
+		ws[i], hs[i] = w, h
+	}
+	for i := range len(frames) - 1 {
+		if ws[i] >= width && hs[i] >= height {
+			return i
+		}
+	}
+	return -1
+}
+
+// bitReader reads bits in MSB-first order.
+type bitReader struct {
+	data    []byte
+	pos     int
+	overrun bool
+}
+
+func (b *bitReader) read(n int) uint32 {
+	var v uint32
+	for range n {
+		if b.pos/8 >= len(b.data) {
+			b.overrun = true
+			return 0
+		}
+		v = v<<1 | uint32(b.data[b.pos/8]>>(7-b.pos%8))&1
+		b.pos++
+	}
+	return v
+}
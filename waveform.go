@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"math"
+	"os"
+	"runtime"
+	"sync"
+	"time"
+	"unsafe"
+)
+
+const (
+	defaultWaveformBucket = 10 * time.Millisecond
+
+	// minWaveformSegment is the shortest segment decoded in parallel, as each segment seeks and decodes from the
+	// cluster before it.
+	minWaveformSegment = 30 * time.Second
+
+	// waveformMagic and waveformVersion are of the encoded Waveform, and waveformSidecarMagic is of the sidecar file.
+	waveformMagic        = "WEBMWAVE"
+	waveformVersion      = 1
+	waveformSidecarMagic = "WEBMWSCR"
+)
+
+// WaveformOptions represents options for DecodeWaveform.
+type WaveformOptions struct {
+	// BucketDuration is the duration of a bucket of the waveform.
+	//
+	// If BucketDuration is 0, 10 milliseconds is used.
+	BucketDuration time.Duration
+
+	// AudioTrack is the track number of the audio. If AudioTrack is 0, the first audio track is used.
+	AudioTrack uint
+
+	// Parallelism is the number of the segments decoded at the same time by DecodeWaveformFromBytes and
+	// DecodeWaveformFromFile, if the input has Cues to seek to the segments by.
+	//
+	// If Parallelism is 0, runtime.GOMAXPROCS(0) is used.
+	Parallelism int
+
+	// Sidecar makes DecodeWaveformFromFile keep the waveform in a file next to the input, whose name is the input's
+	// with ".waveform", and read it instead of decoding while the input's size and modification time are the same.
+	// The sidecar file is not written if it fails to be created.
+	Sidecar bool
+}
+
+// Waveform is the minimums, the maximums and the root mean squares of the samples in the buckets of an audio track,
+// e.g. for drawing the audio in an editor. The samples are the means of the left and the right channels of the audio
+// as Player plays it. The bucket i starts at i*BucketDuration.
+type Waveform struct {
+	BucketDuration time.Duration
+
+	Min []float32
+	Max []float32
+	RMS []float32
+}
+
+// DecodeWaveform decodes the audio of r, and reduces it to a Waveform on the fly, so that the PCM of only a buffer is
+// in memory. r is read once from the start.
+func DecodeWaveform(r io.ReadSeeker, options *WaveformOptions) (*Waveform, error) {
+	return decodeWaveform(r, nil, options)
+}
+
+// DecodeWaveformFromBytes runs DecodeWaveform with a WebM file in memory. If data has Cues, the segments of the audio
+// are decoded in parallel.
+func DecodeWaveformFromBytes(data []byte, options *WaveformOptions) (*Waveform, error) {
+	open := func() (io.ReadSeeker, error) {
+		return bytes.NewReader(data), nil
+	}
+	return decodeWaveform(bytes.NewReader(data), open, options)
+}
+
+// DecodeWaveformFromFile runs DecodeWaveform with a local WebM file, which is opened as NewPlayerFromFile opens. If
+// the file has Cues, the segments of the audio are decoded in parallel, each with the file opened again.
+func DecodeWaveformFromFile(path string, options *WaveformOptions) (*Waveform, error) {
+	if options == nil {
+		options = &WaveformOptions{}
+	}
+	var key []byte
+	if options.Sidecar {
+		fi, err := os.Stat(path)
+		if err != nil {
+			return nil, err
+		}
+		key = waveformSidecarKey(fi, options)
+		if data, ok := readSidecar(path+".waveform", key); ok {
+			var w Waveform
+			if err := w.UnmarshalBinary(data); err == nil {
+				return &w, nil
+			}
+		}
+	}
+
+	r, err := openFile(path)
+	if err != nil {
+		return nil, err
+	}
+	open := func() (io.ReadSeeker, error) {
+		return openFile(path)
+	}
+	w, err := decodeWaveform(r, open, options)
+	if err != nil {
+		return nil, err
+	}
+	if options.Sidecar {
+		data, _ := w.MarshalBinary()
+		writeSidecar(path+".waveform", key, data)
+	}
+	return w, nil
+}
+
+// decodeWaveform decodes the waveform of r. If open is not nil, open opens the input again to decode a segment.
+func decodeWaveform(r io.ReadSeeker, open func() (io.ReadSeeker, error), options *WaveformOptions) (*Waveform, error) {
+	if options == nil {
+		options = &WaveformOptions{}
+	}
+	bucket := options.BucketDuration
+	if bucket <= 0 {
+		bucket = defaultWaveformBucket
+	}
+	parallelism := options.Parallelism
+	if parallelism <= 0 {
+		parallelism = runtime.GOMAXPROCS(0)
+	}
+
+	first, err := newWaveformSegment(r, options.AudioTrack, bucket)
+	if err != nil {
+		return nil, err
+	}
+	// The segments start at the buckets evenly spaced by the duration, where a seek lands on the cluster before.
+	starts := []int{0}
+	if d := first.stream.meta.GetDuration(); open != nil && len(first.stream.meta.CuePoint) > 0 && d > 0 {
+		n := min(parallelism, int(d/minWaveformSegment))
+		for i := 1; i < n; i++ {
+			starts = append(starts, int(d*time.Duration(i)/time.Duration(n)/bucket))
+		}
+	}
+
+	segments := make([]*waveformSegment, len(starts))
+	segments[0] = first
+	errs := make([]error, len(starts))
+	var wg sync.WaitGroup
+	for i := range starts {
+		end := -1
+		if i < len(starts)-1 {
+			end = starts[i+1]
+		}
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			s := segments[i]
+			if s == nil {
+				sr, err := open()
+				if err != nil {
+					errs[i] = err
+					return
+				}
+				s, err = newWaveformSegment(sr, options.AudioTrack, bucket)
+				if err != nil {
+					errs[i] = err
+					return
+				}
+				segments[i] = s
+			}
+			defer s.stream.close()
+			errs[i] = s.decode(starts[i], end)
+		}()
+	}
+	wg.Wait()
+	if err := errors.Join(errs...); err != nil {
+		return nil, err
+	}
+
+	w := &Waveform{
+		BucketDuration: bucket,
+	}
+	for i, s := range segments {
+		// A segment ending early leaves silent buckets until the next segment.
+		if n := starts[i] - len(w.Min); n > 0 {
+			w.Min = append(w.Min, make([]float32, n)...)
+			w.Max = append(w.Max, make([]float32, n)...)
+			w.RMS = append(w.RMS, make([]float32, n)...)
+		}
+		w.Min = append(w.Min, s.min...)
+		w.Max = append(w.Max, s.max...)
+		w.RMS = append(w.RMS, s.rms...)
+	}
+	return w, nil
+}
+
+// waveformSegment reduces the audio of a stream from a bucket to another.
+type waveformSegment struct {
+	stream *stream
+	audio  *audioStream
+	rate   int64
+	bucket time.Duration
+
+	min []float32
+	max []float32
+	rms []float32
+}
+
+func newWaveformSegment(r io.ReadSeeker, track uint, bucket time.Duration) (*waveformSegment, error) {
+	s, err := newAudioOnlyStream(r, track)
+	if err != nil {
+		return nil, err
+	}
+	a := s.AudioStream()
+	return &waveformSegment{
+		stream: s,
+		audio:  a,
+		rate:   int64(a.SamplingFrequency()),
+		bucket: bucket,
+	}, nil
+}
+
+// bucketStart returns the first frame of the bucket i.
+func (w *waveformSegment) bucketStart(i int) int64 {
+	return (int64(i)*int64(w.bucket)*w.rate + int64(time.Second) - 1) / int64(time.Second)
+}
+
+// decode reduces the audio from the bucket start until the bucket end, or until the end of the audio if end is
+// negative.
+func (w *waveformSegment) decode(start, end int) error {
+	frame := w.bucketStart(start)
+	if frame > 0 {
+		if _, err := w.audio.Seek(frame*bytesPerFrame, io.SeekStart); err != nil {
+			return err
+		}
+	}
+
+	idx := start
+	next := w.bucketStart(idx + 1)
+	lo, hi := float32(math.Inf(1)), float32(math.Inf(-1))
+	var sum float64
+	var n int64
+	flush := func() {
+		if n > 0 {
+			w.min = append(w.min, lo)
+			w.max = append(w.max, hi)
+			w.rms = append(w.rms, float32(math.Sqrt(sum/float64(n))))
+		} else {
+			w.min = append(w.min, 0)
+			w.max = append(w.max, 0)
+			w.rms = append(w.rms, 0)
+		}
+		lo, hi = float32(math.Inf(1)), float32(math.Inf(-1))
+		sum = 0
+		n = 0
+		idx++
+		next = w.bucketStart(idx + 1)
+	}
+
+	buf := make([]float32, 8192)
+	for end < 0 || idx < end {
+		m, err := w.audio.Read(unsafe.Slice((*byte)(unsafe.Pointer(unsafe.SliceData(buf))), 4*len(buf)))
+		src := buf[:m/bytesPerFrame*2]
+		for i := 0; i+1 < len(src); i += 2 {
+			if frame >= next {
+				flush()
+				if end >= 0 && idx >= end {
+					break
+				}
+			}
+			v := (src[i] + src[i+1]) / 2
+			lo = min(lo, v)
+			hi = max(hi, v)
+			sum += float64(v) * float64(v)
+			n++
+			frame++
+		}
+		if errors.Is(err, errAudioNotReady) {
+			continue
+		}
+		if err == io.EOF {
+			if n > 0 {
+				flush()
+			}
+			return nil
+		}
+		if err != nil {
+			return fmt.Errorf("webmplayer: decoding the waveform failed: %w", err)
+		}
+	}
+	return nil
+}
+
+// MarshalBinary encodes w in little endian: the magic "WEBMWAVE", the version, the bucket duration, the bucket count,
+// and the minimums, the maximums and the root mean squares as float32s.
+func (w *Waveform) MarshalBinary() ([]byte, error) {
+	if len(w.Max) != len(w.Min) || len(w.RMS) != len(w.Min) {
+		return nil, errors.New("webmplayer: the bucket counts of the waveform don't match")
+	}
+	b := make([]byte, 0, len(waveformMagic)+4+8+4+12*len(w.Min))
+	b = append(b, waveformMagic...)
+	b = binary.LittleEndian.AppendUint32(b, waveformVersion)
+	b = binary.LittleEndian.AppendUint64(b, uint64(w.BucketDuration))
+	b = binary.LittleEndian.AppendUint32(b, uint32(len(w.Min)))
+	for _, vs := range [][]float32{w.Min, w.Max, w.RMS} {
+		for _, v := range vs {
+			b = binary.LittleEndian.AppendUint32(b, math.Float32bits(v))
+		}
+	}
+	return b, nil
+}
+
+// UnmarshalBinary decodes data encoded by MarshalBinary.
+func (w *Waveform) UnmarshalBinary(data []byte) error {
+	const header = len(waveformMagic) + 4 + 8 + 4
+	if len(data) < header || string(data[:len(waveformMagic)]) != waveformMagic {
+		return errors.New("webmplayer: not a waveform")
+	}
+	data = data[len(waveformMagic):]
+	if v := binary.LittleEndian.Uint32(data); v != waveformVersion {
+		return fmt.Errorf("webmplayer: unsupported waveform version: %d", v)
+	}
+	bucket := time.Duration(binary.LittleEndian.Uint64(data[4:]))
+	n := int(binary.LittleEndian.Uint32(data[12:]))
+	data = data[16:]
+	if len(data) != 12*n {
+		return errors.New("webmplayer: the waveform is truncated")
+	}
+	vs := make([]float32, 3*n)
+	for i := range vs {
+		vs[i] = math.Float32frombits(binary.LittleEndian.Uint32(data[4*i:]))
+	}
+	w.BucketDuration = bucket
+	w.Min = vs[:n:n]
+	w.Max = vs[n : 2*n : 2*n]
+	w.RMS = vs[2*n:]
+	return nil
+}
+
+// waveformSidecarKey returns the key of the sidecar file of the input fi.
+func waveformSidecarKey(fi os.FileInfo, options *WaveformOptions) []byte {
+	bucket := options.BucketDuration
+	if bucket <= 0 {
+		bucket = defaultWaveformBucket
+	}
+	return sidecarKey(waveformSidecarMagic, fi, uint64(bucket), uint64(options.AudioTrack))
+}
@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"errors"
+	"fmt"
+	"strings"
+	"sync"
+	"syscall/js"
+	"time"
+
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// On js, the codecs are decoded by WebCodecs of the browser instead of the C libraries, which need cgo.
+// The decoders are driven synchronously from the decoding goroutines, which wait for the outputs called back on the
+// event loop.
+
+// webCodecsOutputTimeout is how long decode waits for the output of a packet. A frame that the decoder drops without
+// an error doesn't stall the decoding longer than this.
+const webCodecsOutputTimeout = time.Second
+
+// webCodecsCallbacks is the output and error callbacks of a WebCodecs decoder.
+type webCodecsCallbacks struct {
+	output js.Func
+	error  js.Func
+
+	m       sync.Mutex
+	outputs []js.Value
+	err     error
+
+	// notify is signaled when an output or an error is called back.
+	notify chan struct{}
+}
+
+func newWebCodecsCallbacks() *webCodecsCallbacks {
+	c := &webCodecsCallbacks{
+		notify: make(chan struct{}, 1),
+	}
+	c.output = js.FuncOf(func(this js.Value, args []js.Value) any {
+		c.m.Lock()
+		c.outputs = append(c.outputs, args[0])
+		c.m.Unlock()
+		c.signal()
+		return nil
+	})
+	c.error = js.FuncOf(func(this js.Value, args []js.Value) any {
+		c.m.Lock()
+		c.err = jsError(args)
+		c.m.Unlock()
+		c.signal()
+		return nil
+	})
+	return c
+}
+
+func (c *webCodecsCallbacks) signal() {
+	select {
+	case c.notify <- struct{}{}:
+	default:
+	}
+}
+
+// init returns the options of a decoder's constructor with the callbacks.
+func (c *webCodecsCallbacks) init() map[string]any {
+	return map[string]any{
+		"output": c.output,
+		"error":  c.error,
+	}
+}
+
+// wait waits until there are n outputs or an error, or for timeout, and returns the error.
+func (c *webCodecsCallbacks) wait(n int, timeout time.Duration) error {
+	t := time.NewTimer(timeout)
+	defer t.Stop()
+	for {
+		c.m.Lock()
+		done, err := len(c.outputs) >= n || c.err != nil, c.err
+		c.m.Unlock()
+		if done {
+			return err
+		}
+		select {
+		case <-c.notify:
+		case <-t.C:
+			return nil
+		}
+	}
+}
+
+// take removes the first output, or returns false if there is none.
+func (c *webCodecsCallbacks) take() (js.Value, bool) {
+	c.m.Lock()
+	defer c.m.Unlock()
+	if len(c.outputs) == 0 {
+		return js.Value{}, false
+	}
+	v := c.outputs[0]
+	c.outputs[0] = js.Value{}
+	c.outputs = c.outputs[1:]
+	return v, true
+}
+
+// failed returns the error of the decoder, or nil.
+func (c *webCodecsCallbacks) failed() error {
+	c.m.Lock()
+	defer c.m.Unlock()
+	return c.err
+}
+
+// discard closes the outputs not taken.
+func (c *webCodecsCallbacks) discard() {
+	for {
+		v, ok := c.take()
+		if !ok {
+			return
+		}
+		v.Call("close")
+	}
+}
+
+// release discards the outputs, and releases the callbacks. The decoder must be closed.
+func (c *webCodecsCallbacks) release() {
+	c.discard()
+	c.output.Release()
+	c.error.Release()
+}
+
+// jsAwait waits for the promise p to settle, and returns its value.
+func jsAwait(p js.Value) (js.Value, error) {
+	done := make(chan struct{})
+	var v js.Value
+	var err error
+	onFulfilled := js.FuncOf(func(this js.Value, args []js.Value) any {
+		if len(args) > 0 {
+			v = args[0]
+		}
+		close(done)
+		return nil
+	})
+	defer onFulfilled.Release()
+	onRejected := js.FuncOf(func(this js.Value, args []js.Value) any {
+		err = jsError(args)
+		close(done)
+		return nil
+	})
+	defer onRejected.Release()
+	p.Call("then", onFulfilled, onRejected)
+	<-done
+	return v, err
+}
+
+// jsTry calls f, and returns the JavaScript exception thrown in f as an error.
+func jsTry(f func()) (err error) {
+	defer func() {
+		r := recover()
+		if r == nil {
+			return
+		}
+		e, ok := r.(js.Error)
+		if !ok {
+			panic(r)
+		}
+		err = fmt.Errorf("webmplayer: %s", e.Error())
+	}()
+	f()
+	return nil
+}
+
+// jsError returns the error of the arguments of an error callback.
+func jsError(args []js.Value) error {
+	if len(args) == 0 {
+		return errors.New("webmplayer: unknown JavaScript error")
+	}
+	return fmt.Errorf("webmplayer: %s", args[0].Call("toString").String())
+}
+
+// jsBytes returns a Uint8Array of data in buf, which grows to fit data.
+func jsBytes(buf *js.Value, data []byte) js.Value {
+	if buf.IsUndefined() || buf.Length() < len(data) {
+		*buf = js.Global().Get("Uint8Array").New(max(len(data), 1024))
+	}
+	v := buf.Call("subarray", 0, len(data))
+	js.CopyBytesToJS(v, data)
+	return v
+}
+
+// webCodecsVideoCodecs is the codec strings of WebCodecs. The VP9 string is for the profile 0, which the browsers
+// accept for the streams of the other profiles too.
+var webCodecsVideoCodecs = map[videoCodec]string{
+	videoCodecVP8: "vp8",
+	videoCodecVP9: "vp09.00.10.08",
+}
+
+// webCodecsVideoDecoder is a videoDecoder with the VideoDecoder of WebCodecs. The decoded VideoFrames are copied to
+// the memory of Go, as Ebitengine draws only its own textures.
+type webCodecsVideoDecoder struct {
+	codec     videoCodec
+	decoder   js.Value
+	callbacks *webCodecsCallbacks
+	timestamp int
+
+	// chunk and frame are the buffers of the packets and the planes on the JavaScript side, and planes and chroma are
+	// the planes of the picture returned by next. chroma is the chroma planes deinterleaved from NV12.
+	chunk  js.Value
+	frame  js.Value
+	planes []byte
+	chroma []byte
+}
+
+// newVPXDecoder creates a decoder of VP8 or VP9. On js, the decoder is VideoDecoder of WebCodecs, which decodes
+// with the threads of the browser.
+func newVPXDecoder(codec videoCodec, threads int) (*webCodecsVideoDecoder, error) {
+	if _, ok := webCodecsVideoCodecs[codec]; !ok {
+		return nil, fmt.Errorf("webmplayer: unsupported VPX codec: %s", codec)
+	}
+	if js.Global().Get("VideoDecoder").IsUndefined() {
+		return nil, errors.New("webmplayer: WebCodecs VideoDecoder is not supported by the browser")
+	}
+	d := &webCodecsVideoDecoder{
+		codec: codec,
+	}
+	d.create()
+	return d, nil
+}
+
+func (d *webCodecsVideoDecoder) create() {
+	d.callbacks = newWebCodecsCallbacks()
+	d.decoder = js.Global().Get("VideoDecoder").New(d.callbacks.init())
+}
+
+func (d *webCodecsVideoDecoder) start(codecPrivate []byte) error {
+	// An error closes the decoder, and another decoder is made for the next stream.
+	if d.decoder.Get("state").String() == "closed" {
+		d.callbacks.release()
+		d.create()
+	}
+	d.callbacks.discard()
+	return jsTry(func() {
+		if d.decoder.Get("state").String() == "configured" {
+			d.decoder.Call("reset")
+		}
+		d.decoder.Call("configure", map[string]any{
+			"codec":              webCodecsVideoCodecs[d.codec],
+			"optimizeForLatency": true,
+		})
+	})
+}
+
+// decode decodes data, and waits for its frame if data shows a frame.
+func (d *webCodecsVideoDecoder) decode(data []byte) error {
+	if err := d.callbacks.failed(); err != nil {
+		return err
+	}
+	typ := "delta"
+	if parseVPXFrame(d.codec, data).keyframe {
+		typ = "key"
+	}
+	chunk := js.Global().Get("EncodedVideoChunk").New(map[string]any{
+		"type":      typ,
+		"timestamp": d.timestamp,
+		"data":      jsBytes(&d.chunk, data),
+	})
+	d.timestamp++
+	if err := jsTry(func() {
+		d.decoder.Call("decode", chunk)
+	}); err != nil {
+		return err
+	}
+	if !vpxShowsFrame(d.codec, data) {
+		return nil
+	}
+	return d.callbacks.wait(1, webCodecsOutputTimeout)
+}
+
+func (d *webCodecsVideoDecoder) next() (videoPicture, bool, error) {
+	frame, ok := d.callbacks.take()
+	if !ok {
+		return videoPicture{}, false, d.callbacks.failed()
+	}
+	defer frame.Call("close")
+	img, err := d.copyFrame(frame)
+	if err != nil {
+		return videoPicture{}, false, err
+	}
+	return videoPicture{Image: img}, true, nil
+}
+
+// copyFrame copies the planes of the VideoFrame frame to the memory of Go.
+func (d *webCodecsVideoDecoder) copyFrame(frame js.Value) (vpxfb.Image, error) {
+	format := frame.Get("format")
+	if format.IsNull() {
+		return vpxfb.Image{}, errors.New("webmplayer: the VideoFrame has no readable format")
+	}
+	f := format.String()
+	rect := frame.Get("visibleRect")
+	img := vpxfb.Image{
+		Width:    rect.Get("width").Int(),
+		Height:   rect.Get("height").Int(),
+		BitDepth: 8,
+	}
+	switch {
+	case strings.HasPrefix(f, "I420"):
+		img.XChromaShift, img.YChromaShift = 1, 1
+	case strings.HasPrefix(f, "I422"):
+		img.XChromaShift = 1
+	case strings.HasPrefix(f, "I444"):
+	case f == "NV12":
+		img.XChromaShift, img.YChromaShift = 1, 1
+	default:
+		return vpxfb.Image{}, fmt.Errorf("webmplayer: unsupported VideoFrame format: %s", f)
+	}
+	switch {
+	case strings.HasSuffix(f, "P10"):
+		img.BitDepth, img.HighBitDepth = 10, true
+	case strings.HasSuffix(f, "P12"):
+		img.BitDepth, img.HighBitDepth = 12, true
+	}
+	if cs := frame.Get("colorSpace"); !cs.IsUndefined() && !cs.IsNull() {
+		img.ColorSpace = webCodecsColorSpace(cs.Get("matrix"))
+		img.FullRange = cs.Get("fullRange").Truthy()
+	}
+
+	size := frame.Call("allocationSize").Int()
+	if d.frame.IsUndefined() || d.frame.Length() < size {
+		d.frame = js.Global().Get("Uint8Array").New(size)
+	}
+	buf := d.frame.Call("subarray", 0, size)
+	layout, err := jsAwait(frame.Call("copyTo", buf))
+	if err != nil {
+		return vpxfb.Image{}, err
+	}
+	if cap(d.planes) < size {
+		d.planes = make([]byte, size)
+	}
+	d.planes = d.planes[:size]
+	js.CopyBytesToGo(d.planes, buf)
+
+	ch := (img.Height + 1<<img.YChromaShift - 1) >> img.YChromaShift
+	plane := func(i, rows int) ([]byte, int) {
+		l := layout.Index(i)
+		offset, stride := l.Get("offset").Int(), l.Get("stride").Int()
+		return d.planes[offset:min(offset+stride*rows, size)], stride
+	}
+	img.Planes[0], img.Strides[0] = plane(0, img.Height)
+	if f != "NV12" {
+		img.Planes[1], img.Strides[1] = plane(1, ch)
+		img.Planes[2], img.Strides[2] = plane(2, ch)
+		return img, nil
+	}
+
+	// The interleaved chroma of NV12 is split into the Cb and Cr planes.
+	uv, stride := plane(1, ch)
+	cw := (img.Width + 1) / 2
+	if cap(d.chroma) < 2*cw*ch {
+		d.chroma = make([]byte, 2*cw*ch)
+	}
+	cb, cr := d.chroma[:cw*ch], d.chroma[cw*ch:2*cw*ch]
+	for y := 0; y < ch; y++ {
+		row := uv[y*stride:]
+		for x := 0; x < cw; x++ {
+			cb[y*cw+x] = row[2*x]
+			cr[y*cw+x] = row[2*x+1]
+		}
+	}
+	img.Planes[1], img.Strides[1] = cb, cw
+	img.Planes[2], img.Strides[2] = cr, cw
+	return img, nil
+}
+
+// webCodecsColorSpace returns the ColorSpace of the matrix of a VideoColorSpace.
+func webCodecsColorSpace(matrix js.Value) vpxfb.ColorSpace {
+	if matrix.Type() != js.TypeString {
+		return vpxfb.ColorSpaceUnknown
+	}
+	switch matrix.String() {
+	case "bt709":
+		return vpxfb.ColorSpaceBT709
+	case "bt470bg":
+		return vpxfb.ColorSpaceBT601
+	case "smpte170m":
+		return vpxfb.ColorSpaceSMPTE170
+	case "bt2020-ncl":
+		return vpxfb.ColorSpaceBT2020
+	case "rgb":
+		return vpxfb.ColorSpaceSRGB
+	}
+	return vpxfb.ColorSpaceUnknown
+}
+
+// setSkipLoopFilter does nothing, as WebCodecs has no control of the loop filter.
+func (d *webCodecsVideoDecoder) setSkipLoopFilter(skip bool) {
+}
+
+// setSpatialLayer does nothing, as WebCodecs decodes all the spatial layers.
+func (d *webCodecsVideoDecoder) setSpatialLayer(layer int) {
+}
+
+func (d *webCodecsVideoDecoder) destroy() {
+	if d.decoder.Get("state").String() != "closed" {
+		d.decoder.Call("close")
+	}
+	d.callbacks.release()
+}
@@ -0,0 +1,403 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"math"
+	"runtime/trace"
+	"syscall/js"
+	"time"
+	"unsafe"
+
+	"github.com/hajimehoshi/webmplayer/internal/libopus"
+)
+
+// opusReducedRates is empty, as WebCodecs decodes Opus at 48 kHz.
+var opusReducedRates []int
+
+// webCodecsAudioDecoder is the AudioDecoder of WebCodecs for an audio codec. The packets are decoded in batches,
+// each of which ends with a flush, so that all the outputs of the batch are called back before decode returns.
+type webCodecsAudioDecoder struct {
+	config    map[string]any
+	decoder   js.Value
+	callbacks *webCodecsCallbacks
+
+	// chunk and data are the buffers of the packets and the samples on the JavaScript side, and pcm is the samples of
+	// an output in the memory of Go.
+	chunk js.Value
+	data  js.Value
+	pcm   []float32
+}
+
+// webCodecsAudioTimestamp is the interval of the timestamps of the packets in a batch, by which an AudioData is
+// matched with its packet.
+const webCodecsAudioTimestamp = int(time.Second / time.Microsecond)
+
+func newWebCodecsAudioDecoder(config map[string]any) (*webCodecsAudioDecoder, error) {
+	if js.Global().Get("AudioDecoder").IsUndefined() {
+		return nil, errors.New("webmplayer: WebCodecs AudioDecoder is not supported by the browser")
+	}
+	d := &webCodecsAudioDecoder{
+		config: config,
+	}
+	if err := d.create(); err != nil {
+		d.close()
+		return nil, err
+	}
+	return d, nil
+}
+
+func (d *webCodecsAudioDecoder) create() error {
+	d.callbacks = newWebCodecsCallbacks()
+	d.decoder = js.Global().Get("AudioDecoder").New(d.callbacks.init())
+	return jsTry(func() {
+		d.decoder.Call("configure", d.config)
+	})
+}
+
+// decode decodes packets, and calls f with the interleaved samples of each output and the index of its packet.
+// The samples are valid until f returns.
+func (d *webCodecsAudioDecoder) decode(packets [][]byte, f func(i int, pcm []float32)) error {
+	if len(packets) == 0 {
+		return nil
+	}
+	// An error closes the decoder, e.g. at a broken packet, and the next batch is decoded by another decoder.
+	if d.decoder.Get("state").String() == "closed" {
+		d.callbacks.release()
+		if err := d.create(); err != nil {
+			return err
+		}
+	}
+	err := jsTry(func() {
+		for i, p := range packets {
+			d.decoder.Call("decode", js.Global().Get("EncodedAudioChunk").New(map[string]any{
+				"type":      "key",
+				"timestamp": i * webCodecsAudioTimestamp,
+				"data":      jsBytes(&d.chunk, p),
+			}))
+		}
+	})
+	if err == nil {
+		_, err = jsAwait(d.decoder.Call("flush"))
+	}
+	for {
+		o, ok := d.callbacks.take()
+		if !ok {
+			break
+		}
+		i := (o.Get("timestamp").Int() + webCodecsAudioTimestamp/2) / webCodecsAudioTimestamp
+		f(min(max(i, 0), len(packets)-1), d.copy(o))
+		o.Call("close")
+	}
+	return err
+}
+
+// copy copies the samples of the AudioData o to the memory of Go as interleaved float32.
+func (d *webCodecsAudioDecoder) copy(o js.Value) []float32 {
+	options := map[string]any{
+		"planeIndex": 0,
+		"format":     "f32",
+	}
+	size := o.Call("allocationSize", options).Int()
+	if d.data.IsUndefined() || d.data.Length() < size {
+		d.data = js.Global().Get("Uint8Array").New(size)
+	}
+	buf := d.data.Call("subarray", 0, size)
+	o.Call("copyTo", buf, options)
+	if cap(d.pcm) < size/4 {
+		d.pcm = make([]float32, size/4)
+	}
+	pcm := d.pcm[:size/4]
+	js.CopyBytesToGo(unsafe.Slice((*byte)(unsafe.Pointer(unsafe.SliceData(pcm))), 4*len(pcm)), buf)
+	return pcm
+}
+
+// reset discards the decoder state for a seek.
+func (d *webCodecsAudioDecoder) reset() error {
+	if d.decoder.Get("state").String() == "closed" {
+		d.callbacks.release()
+		return d.create()
+	}
+	d.callbacks.discard()
+	return jsTry(func() {
+		d.decoder.Call("reset")
+		d.decoder.Call("configure", d.config)
+	})
+}
+
+func (d *webCodecsAudioDecoder) close() {
+	if d.decoder.Get("state").String() != "closed" {
+		d.decoder.Call("close")
+	}
+	d.callbacks.release()
+}
+
+// webCodecsOpusDecoder is an opusDecoder with WebCodecs.
+type webCodecsOpusDecoder struct {
+	d        *webCodecsAudioDecoder
+	channels int
+
+	// gain is the output gain as a scale, and counts is the buffer of the results of DecodeFloatBatch.
+	gain   float32
+	counts []int
+}
+
+// newOpusDecoder creates an Opus decoder of WebCodecs of the stream of head at the rate samplingFrequency, which is
+// 48 kHz. parallel is ignored, as WebCodecs decodes the streams by itself.
+func newOpusDecoder(head *opusHead, samplingFrequency int, parallel bool) (opusDecoder, error) {
+	if head.mappingFamily == 3 {
+		return nil, errors.New("webmplayer: the Opus mapping family 3 is not supported on js")
+	}
+	config := map[string]any{
+		"codec":            "opus",
+		"sampleRate":       samplingFrequency,
+		"numberOfChannels": head.channels,
+	}
+	// The channel mapping is passed by OpusHead. The pre-skip and the gain are applied by the Player, and they are 0
+	// in the header.
+	if head.mappingFamily != 0 {
+		h := make([]byte, 21+len(head.channelMapping))
+		copy(h, "OpusHead")
+		h[8] = 1
+		h[9] = byte(head.channels)
+		binary.LittleEndian.PutUint32(h[12:16], uint32(head.inputSampleRate))
+		h[18] = byte(head.mappingFamily)
+		h[19] = byte(head.streamCount)
+		h[20] = byte(head.coupledCount)
+		copy(h[21:], head.channelMapping)
+		description := js.Global().Get("Uint8Array").New(len(h))
+		js.CopyBytesToJS(description, h)
+		config["description"] = description
+	}
+	d, err := newWebCodecsAudioDecoder(config)
+	if err != nil {
+		return nil, err
+	}
+	return &webCodecsOpusDecoder{
+		d:        d,
+		channels: head.channels,
+		gain:     1,
+	}, nil
+}
+
+// DecodeFloat decodes a packet as libopus does. WebCodecs can't conceal a lost packet, so the lost frames are
+// silence.
+func (o *webCodecsOpusDecoder) DecodeFloat(data []byte, pcm []float32, decodeFec int) int {
+	if decodeFec != 0 || data == nil {
+		clear(pcm)
+		return len(pcm) / o.channels
+	}
+	counts := o.DecodeFloatBatch([][]byte{data}, pcm)
+	if len(counts) == 0 {
+		return -1
+	}
+	return counts[0]
+}
+
+// DecodeFloatBatch decodes the packets into pcm as libopus does, and returns the numbers of the frames of the
+// decoded packets, or -1 for the broken packets. The batch stops before the packets that don't fit in pcm.
+func (o *webCodecsOpusDecoder) DecodeFloatBatch(packets [][]byte, pcm []float32) []int {
+	var n, frames int
+	for _, p := range packets {
+		f := opusPacketFrames(p)
+		if (frames+f)*o.channels > len(pcm) {
+			break
+		}
+		frames += f
+		n++
+	}
+	o.counts = o.counts[:0]
+	for range packets[:n] {
+		o.counts = append(o.counts, -1)
+	}
+	var pos int
+	// An error leaves the packets without outputs as broken.
+	_ = o.d.decode(packets[:n], func(i int, s []float32) {
+		m := min(len(s), len(pcm)-pos) / o.channels * o.channels
+		dst := pcm[pos : pos+m]
+		copy(dst, s)
+		if o.gain != 1 {
+			for j := range dst {
+				dst[j] *= o.gain
+			}
+		}
+		pos += m
+		o.counts[i] = max(o.counts[i], 0) + m/o.channels
+	})
+	return o.counts
+}
+
+func (o *webCodecsOpusDecoder) ResetState() error {
+	return o.d.reset()
+}
+
+// SetGain sets the output gain in Q7.8 dB.
+func (o *webCodecsOpusDecoder) SetGain(gain int) error {
+	o.gain = float32(math.Pow(10, float64(gain)/(20*256)))
+	return nil
+}
+
+func (o *webCodecsOpusDecoder) Destroy() {
+	o.d.close()
+}
+
+// prewarmOpus does nothing, as the Opus decoder is in the browser.
+func prewarmOpus() error {
+	return nil
+}
+
+// vorbisBatchSize is the maximum number of the packets decoded in a batch, and vorbisMaxFrames is the maximum number
+// of the frames of a packet, half of the longest block.
+const (
+	vorbisBatchSize = 8
+	vorbisMaxFrames = 4096
+)
+
+// vorbisDecoder is an audioDecoder of Vorbis with WebCodecs. The PCM is decoded into the ring of the audioStream.
+type vorbisDecoder struct {
+	d *webCodecsAudioDecoder
+
+	// stereo is the buffer of an output mapped to stereo.
+	stereo []float32
+
+	// poolKey is the codec private data.
+	poolKey string
+}
+
+// pooledVorbis is an idle Vorbis decoder in a PlayerPool.
+type pooledVorbis struct {
+	d *webCodecsAudioDecoder
+}
+
+func newVorbisDecoder(a *audioStream, codecPrivate []byte, options *PlayerOptions) (*vorbisDecoder, error) {
+	switch options.AudioRateDivisor {
+	case 0, 1:
+	default:
+		return nil, fmt.Errorf("webmplayer: AudioRateDivisor is not supported on js: %d", options.AudioRateDivisor)
+	}
+	channels, rate, err := readVorbisIdentification(codecPrivate)
+	if err != nil {
+		return nil, err
+	}
+	if channels != a.channels {
+		return nil, fmt.Errorf("webmplayer: channel count doesn't match: %d vs %d", channels, a.channels)
+	}
+	if rate != a.samplingFrequency {
+		samplingFrequency := a.samplingFrequency
+		a.samplingFrequency = rate
+		return nil, fmt.Errorf("webmplayer: sample rate doesn't match: %d vs %d", rate, samplingFrequency)
+	}
+
+	v := &vorbisDecoder{
+		poolKey: string(codecPrivate),
+	}
+	if p := a.pool.takeVorbis(v.poolKey); p != nil {
+		v.d = p.d
+	} else {
+		// The description of Vorbis is the Xiph-laced headers, as the codec private data.
+		description := js.Global().Get("Uint8Array").New(len(codecPrivate))
+		js.CopyBytesToJS(description, codecPrivate)
+		d, err := newWebCodecsAudioDecoder(map[string]any{
+			"codec":            "vorbis",
+			"sampleRate":       rate,
+			"numberOfChannels": channels,
+			"description":      description,
+		})
+		if err != nil {
+			return nil, err
+		}
+		v.d = d
+	}
+	if a.channels > 2 {
+		a.downmix, err = downmixMatrix(options.AudioDownmix, a.channels)
+		if err != nil {
+			v.d.close()
+			return nil, err
+		}
+	}
+	a.frames = newPCMRing(2 * vorbisBatchSize * vorbisMaxFrames)
+	return v, nil
+}
+
+func (v *vorbisDecoder) read(a *audioStream, dst []float32) (int, error) {
+	for {
+		if a.skip > 0 {
+			a.skip -= a.frames.Discard(2*a.skip) / 2
+		}
+		if a.frames.Len() > 0 {
+			return a.frames.Read(dst), nil
+		}
+		if len(a.packets) == 0 {
+			return 0, nil
+		}
+		n := min(len(a.packets), vorbisBatchSize)
+		start := time.Now()
+		r := trace.StartRegion(a.stream.ctx, "audio.decode")
+		err := v.d.decode(a.batchData()[:n], func(_ int, pcm []float32) {
+			frames := len(pcm) / a.channels
+			if cap(v.stereo) < 2*frames {
+				v.stereo = make([]float32, 2*frames)
+			}
+			m := libopus.MapStereo(v.stereo[:2*frames], pcm, a.channels, a.downmix)
+			a.frames.Write(v.stereo[:2*m])
+		})
+		r.End()
+		a.consumePackets(n, time.Since(start))
+		if err != nil {
+			return 0, fmt.Errorf("webmplayer: decoding Vorbis failed: %w", err)
+		}
+	}
+}
+
+func (v *vorbisDecoder) reset() error {
+	return v.d.reset()
+}
+
+func (v *vorbisDecoder) close(pool *PlayerPool) {
+	if v.d != nil {
+		pool.putVorbis(v.poolKey, &pooledVorbis{d: v.d})
+	}
+	v.d = nil
+}
+
+// restart resets the decoder state for the next stream of the same headers.
+func (v *pooledVorbis) restart() error {
+	return v.d.reset()
+}
+
+func (v *pooledVorbis) free() {
+	v.d.close()
+}
+
+// readVorbisIdentification returns the channel count and the rate in the identification header of the codec private
+// data.
+func readVorbisIdentification(codecPrivate []byte) (int, int, error) {
+	if len(codecPrivate) < 1 {
+		return 0, 0, errors.New("webmplayer: codec private data is too short")
+	}
+	// https://www.matroska.org/technical/codec_specs.html
+	if codecPrivate[0] != 0x02 {
+		return 0, 0, fmt.Errorf("webmplayer: wrong codec private data for Vorbis: %d", codecPrivate[0])
+	}
+	// The Xiph lacing has the sizes of the first two headers, and the identification header follows them.
+	i := 1
+	for range 2 {
+		for i < len(codecPrivate) && codecPrivate[i] == 0xff {
+			i++
+		}
+		i++
+	}
+	// https://xiph.org/vorbis/doc/Vorbis_I_spec.html#x1-630004.2.2
+	if i+16 > len(codecPrivate) {
+		return 0, 0, errors.New("webmplayer: codec private data is too short")
+	}
+	h := codecPrivate[i:]
+	if h[0] != 1 || string(h[1:7]) != "vorbis" {
+		return 0, 0, errors.New("webmplayer: invalid Vorbis identification header")
+	}
+	return int(h[11]), int(binary.LittleEndian.Uint32(h[12:16])), nil
+}
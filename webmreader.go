@@ -0,0 +1,1285 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"bytes"
+	"encoding/binary"
+	"errors"
+	"io"
+	"math"
+	"sort"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"github.com/ebml-go/webm"
+)
+
+const (
+	// ebmlReadSize is the size of a read into the buffer of ebmlReader.
+	ebmlReadSize = 64 << 10
+
+	// maxEBMLElementSize is the maximum size of an element read into memory, e.g. a block or CodecPrivate, so that a
+	// broken size doesn't allocate too much.
+	maxEBMLElementSize = 64 << 20
+
+	// webmSlabSize is the size of the buffers that the blocks are read into. A block larger than a quarter of it has
+	// its own buffer.
+	webmSlabSize = 256 << 10
+)
+
+// unknownSize is the data size of an element whose size is unknown, e.g. the Segment of a live stream.
+const unknownSize = 1<<56 - 1
+
+// ebmlReader reads EBML elements from an input with its own buffer, and knows the offset of the data being read.
+type ebmlReader struct {
+	r io.ReadSeeker
+
+	// buf is the data read from the input, and head is the position of the next byte to be read in buf.
+	// off is the offset of buf[0] in the input.
+	buf  []byte
+	head int
+	off  int64
+
+	// memory is true if buf is the whole input in memory, which is never modified.
+	memory bool
+
+	// clusters is true if the Clusters are read whole into the buffer by bufferCluster, and cluster is the pooled
+	// storage of buf then. next is the read of the next element in the background, which uses the input until it is
+	// joined, and moved is true if the input is not at the end of buf after a read not taken.
+	clusters bool
+	cluster  *[]byte
+	next     *clusterRead
+	moved    bool
+}
+
+// offset returns the offset of the next byte to be read.
+func (e *ebmlReader) offset() int64 {
+	return e.off + int64(e.head)
+}
+
+// fill reads more data after the data not read yet in the buffer.
+func (e *ebmlReader) fill() error {
+	if e.memory {
+		return io.EOF
+	}
+	if e.head == len(e.buf) && e.takeNext() {
+		return nil
+	}
+	if err := e.own(); err != nil {
+		return err
+	}
+	// The buffer of a header read in the background can be small.
+	if cap(e.buf) < ebmlReadSize {
+		e.buf = append(make([]byte, 0, ebmlReadSize), e.buf...)
+	}
+	if e.head > 0 {
+		n := copy(e.buf[:cap(e.buf)], e.buf[e.head:])
+		e.off += int64(e.head)
+		e.buf = e.buf[:n]
+		e.head = 0
+	}
+	n, err := e.r.Read(e.buf[len(e.buf):cap(e.buf)])
+	e.buf = e.buf[:len(e.buf)+n]
+	if n > 0 {
+		return nil
+	}
+	if err == nil {
+		err = io.ErrNoProgress
+	}
+	return err
+}
+
+func (e *ebmlReader) readByte() (byte, error) {
+	if e.head == len(e.buf) {
+		if err := e.fill(); err != nil {
+			return 0, err
+		}
+	}
+	b := e.buf[e.head]
+	e.head++
+	return b, nil
+}
+
+// read reads len(dst) bytes. A large read goes into dst directly without the buffer.
+func (e *ebmlReader) read(dst []byte) error {
+	for len(dst) > 0 {
+		if e.head == len(e.buf) && len(dst) >= ebmlReadSize && !e.memory && e.next == nil {
+			if err := e.own(); err != nil {
+				return err
+			}
+			off := e.offset()
+			n, err := io.ReadFull(e.r, dst)
+			e.off = off + int64(n)
+			e.buf = e.buf[:0]
+			e.head = 0
+			if err == io.EOF {
+				err = io.ErrUnexpectedEOF
+			}
+			return err
+		}
+		if e.head == len(e.buf) {
+			if err := e.fill(); err != nil {
+				if err == io.EOF {
+					err = io.ErrUnexpectedEOF
+				}
+				return err
+			}
+		}
+		n := copy(dst, e.buf[e.head:])
+		e.head += n
+		dst = dst[n:]
+	}
+	return nil
+}
+
+// skip skips size bytes, in the buffer or by seeking the input.
+func (e *ebmlReader) skip(size uint64) error {
+	if size == unknownSize {
+		return errors.New("webmplayer: an EBML element of unknown size can't be skipped")
+	}
+	if size <= uint64(len(e.buf)-e.head) {
+		e.head += int(size)
+		return nil
+	}
+	return e.seek(e.offset() + int64(size))
+}
+
+// seek moves to the offset off. The buffer is kept if off is in it.
+func (e *ebmlReader) seek(off int64) error {
+	if off >= e.off && off <= e.off+int64(len(e.buf)) {
+		e.head = int(off - e.off)
+		return nil
+	}
+	if e.memory {
+		return io.ErrUnexpectedEOF
+	}
+	e.join()
+	if _, err := e.r.Seek(off, io.SeekStart); err != nil {
+		return err
+	}
+	e.moved = false
+	e.off = off
+	e.buf = e.buf[:0]
+	e.head = 0
+	return nil
+}
+
+// view returns the next n bytes without copying them, or false if the input is not in memory.
+func (e *ebmlReader) view(n int) ([]byte, bool, error) {
+	if !e.memory {
+		return nil, false, nil
+	}
+	if n > len(e.buf)-e.head {
+		return nil, true, io.ErrUnexpectedEOF
+	}
+	b := e.buf[e.head : e.head+n : e.head+n]
+	e.head += n
+	return b, true, nil
+}
+
+// size returns the size of the input, or false if it is unknown, e.g. for a live stream.
+func (e *ebmlReader) size() (int64, bool) {
+	if e.memory {
+		return int64(len(e.buf)), true
+	}
+	e.join()
+	end, err := e.r.Seek(0, io.SeekEnd)
+	if err != nil {
+		return 0, false
+	}
+	// The input is moved back to the end of the buffer, so that the buffer is still valid.
+	if _, err := e.r.Seek(e.off+int64(len(e.buf)), io.SeekStart); err != nil {
+		return 0, false
+	}
+	e.moved = false
+	return end, true
+}
+
+// header reads the ID and the data size of an element, and returns them with the size of the header.
+func (e *ebmlReader) header() (id uint64, size uint64, n int, err error) {
+	id, n0, err := e.vint(false)
+	if err != nil {
+		return 0, 0, 0, err
+	}
+	size, n1, err := e.vint(true)
+	if err != nil {
+		return 0, 0, 0, err
+	}
+	if size == 1<<(7*n1)-1 {
+		size = unknownSize
+	}
+	return id, size, n0 + n1, nil
+}
+
+// vint reads an EBML variable-length integer. If mask is true, the length marker is removed from the value.
+func (e *ebmlReader) vint(mask bool) (uint64, int, error) {
+	b, err := e.readByte()
+	if err != nil {
+		return 0, 0, err
+	}
+	n := vintLength(b)
+	if n > 8 {
+		return 0, 0, errors.New("webmplayer: invalid EBML integer")
+	}
+	v := uint64(b)
+	if mask {
+		v &= 0xff >> n
+	}
+	for range n - 1 {
+		b, err := e.readByte()
+		if err != nil {
+			return 0, 0, err
+		}
+		v = v<<8 | uint64(b)
+	}
+	return v, n, nil
+}
+
+// vintLength returns the length of an EBML variable-length integer starting with b, or 9 if b is invalid.
+func vintLength(b byte) int {
+	n := 1
+	for n <= 8 && b&(0x80>>(n-1)) == 0 {
+		n++
+	}
+	return n
+}
+
+// parseVint parses the EBML variable-length integer at the start of data, without the length marker.
+func parseVint(data []byte) (uint64, int, error) {
+	if len(data) == 0 {
+		return 0, 0, io.ErrUnexpectedEOF
+	}
+	n := vintLength(data[0])
+	if n > 8 {
+		return 0, 0, errors.New("webmplayer: invalid EBML integer")
+	}
+	if n > len(data) {
+		return 0, 0, io.ErrUnexpectedEOF
+	}
+	v := uint64(data[0]) & (0xff >> n)
+	for _, b := range data[1:n] {
+		v = v<<8 | uint64(b)
+	}
+	return v, n, nil
+}
+
+func (e *ebmlReader) readUint(size uint64) (uint64, error) {
+	if size > 8 {
+		return 0, errors.New("webmplayer: invalid EBML unsigned integer")
+	}
+	var v uint64
+	for range size {
+		b, err := e.readByte()
+		if err != nil {
+			return 0, err
+		}
+		v = v<<8 | uint64(b)
+	}
+	return v, nil
+}
+
+func (e *ebmlReader) readFloat(size uint64) (float64, error) {
+	switch size {
+	case 0:
+		return 0, nil
+	case 4, 8:
+	default:
+		return 0, errors.New("webmplayer: invalid EBML float")
+	}
+	v, err := e.readUint(size)
+	if err != nil {
+		return 0, err
+	}
+	if size == 4 {
+		return float64(math.Float32frombits(uint32(v))), nil
+	}
+	return math.Float64frombits(v), nil
+}
+
+// readBytes reads the data of an element into a new slice.
+func (e *ebmlReader) readBytes(size uint64) ([]byte, error) {
+	if size > maxEBMLElementSize {
+		return nil, errors.New("webmplayer: too large EBML element")
+	}
+	b := make([]byte, size)
+	if err := e.read(b); err != nil {
+		return nil, err
+	}
+	return b, nil
+}
+
+// readString reads a string element, which can be padded with zeros.
+func (e *ebmlReader) readString(size uint64) (string, error) {
+	b, err := e.readBytes(size)
+	if err != nil {
+		return "", err
+	}
+	return strings.TrimRight(string(b), "\x00"), nil
+}
+
+// children calls f with the child elements of an element of size bytes. f reads the element's data and reports
+// true, or reports false to skip it.
+func (e *ebmlReader) children(size uint64, f func(id, size uint64) (bool, error)) error {
+	if size == unknownSize {
+		return errors.New("webmplayer: unexpected EBML element of unknown size")
+	}
+	for size > 0 {
+		id, csize, n, err := e.header()
+		if err != nil {
+			return err
+		}
+		if uint64(n) > size || csize > size-uint64(n) {
+			return errors.New("webmplayer: invalid EBML element size")
+		}
+		size -= uint64(n) + csize
+		read, err := f(id, csize)
+		if err != nil {
+			return err
+		}
+		if !read {
+			if err := e.skip(csize); err != nil {
+				return err
+			}
+		}
+	}
+	return nil
+}
+
+// webmReader demuxes a WebM input, which is read with its own EBML reader specialized for the elements the player
+// uses. The blocks are read into shared buffers, and the packets refer to them, so that the allocations grow with the
+// bytes read rather than with the number of the blocks.
+//
+// webmReader sends the packets of all the tracks to Chan, a packet with Rebase first after a seek, and a packet with
+// webm.BadTC at the end, and then waits for a seek. With Loop, webmReader reads from the first Cluster again at the
+// end instead.
+type webmReader struct {
+	Chan chan demuxPacket
+
+	e ebmlReader
+
+	// segment is the offset of the Segment's data, which the Cues' cluster positions are relative to, and segmentEnd
+	// is the end of the Segment, or math.MaxInt64 if the size is unknown.
+	segment    int64
+	segmentEnd int64
+
+	// firstCluster is the offset of the first Cluster.
+	firstCluster int64
+
+	// scale is the unit of the timecodes, and duration is the duration of the Segment, or 0 if it is unknown.
+	scale    time.Duration
+	duration time.Duration
+
+	// cues is the Cue points, and clusters is the clusters read so far, both in the time order, to find the cluster
+	// to seek to.
+	cues     []cue
+	clusters []cue
+
+	// cluster is the offset of the Cluster being read, and clusterTimecode is its Timecode.
+	cluster         int64
+	clusterTimecode int64
+
+	// opusTracks is the track numbers of the Opus tracks, whose laced frames have their own timecodes.
+	opusTracks map[uint]bool
+
+	// subtitles is the cues of the subtitle tracks by the track numbers. The blocks of the subtitle tracks are added
+	// to them instead of being sent.
+	subtitles map[uint]*subtitleIndex
+
+	// slab is the rest of the buffer that the blocks are read into.
+	slab []byte
+
+	// pending is the frames of the last block, which are sent in order. sizes is the sizes of the laced frames.
+	pending []demuxPacket
+	sizes   []int
+
+	loop demuxLoop
+
+	// skipped is the track number whose blocks are sent without their data, or 0. The data of the blocks is skipped
+	// without being read.
+	skipped atomic.Uint64
+
+	// audioTracks is the track numbers of the audio tracks, whose blocks are dropped without their data being read
+	// after skipAudio.
+	audioTracks  map[uint]bool
+	audioSkipped atomic.Bool
+
+	seeks    chan time.Duration
+	done     chan struct{}
+	shutdown sync.Once
+}
+
+// parseWebM reads the headers of the WebM input r from its current position into meta, and starts the goroutine
+// sending the packets from the first Cluster. parseWebM also returns the Colour elements of the video tracks by the
+// track numbers, which webm.WebM doesn't have.
+func parseWebM(r io.ReadSeeker, meta *webm.WebM) (*webmReader, map[uint]trackColor, error) {
+	return parseWebMWithIndex(r, meta, nil)
+}
+
+// parseWebMWithIndex is parseWebM with the headers idx of r from the start, e.g. from a sidecar file, which are not
+// parsed then. If idx is nil, the headers are parsed unless they are known for an input in memory.
+func parseWebMWithIndex(r io.ReadSeeker, meta *webm.WebM, idx *webmIndex) (*webmReader, map[uint]trackColor, error) {
+	start, err := r.Seek(0, io.SeekCurrent)
+	if err != nil {
+		return nil, nil, err
+	}
+	w := newWebMReader(r, start)
+	m, _ := r.(*memoryReader)
+
+	var colors map[uint]trackColor
+	if idx == nil || start != 0 {
+		idx = lookupMemoryIndex(m, start)
+	}
+	if idx != nil {
+		*meta = idx.meta
+		colors = idx.colors
+		w.segment = idx.segment
+		w.segmentEnd = idx.segmentEnd
+		w.firstCluster = idx.firstCluster
+		if err := w.e.seek(idx.firstCluster); err != nil {
+			return nil, nil, err
+		}
+	} else {
+		colors, err = w.readHeaders(meta)
+		if err != nil {
+			return nil, nil, err
+		}
+		if m != nil {
+			storeMemoryIndex(m, start, w.index(meta, colors))
+		}
+	}
+	w.init(meta)
+	go w.run()
+	return w, colors, nil
+}
+
+func newWebMReader(r io.ReadSeeker, start int64) *webmReader {
+	w := &webmReader{
+		Chan:       make(chan demuxPacket),
+		e:          ebmlReader{r: r, off: start, clusters: !isLiveInput(r)},
+		segmentEnd: math.MaxInt64,
+		seeks:      make(chan time.Duration),
+		done:       make(chan struct{}),
+	}
+	if m, ok := r.(*memoryReader); ok {
+		w.e.buf = m.data
+		w.e.head = int(start)
+		w.e.off = 0
+		w.e.memory = true
+	}
+	return w
+}
+
+// isLiveInput reports whether r is a live stream, whose Clusters are parsed as their bytes arrive rather than read
+// whole.
+func isLiveInput(r io.ReadSeeker) bool {
+	if t, ok := r.(*timedReader); ok {
+		r = t.r
+	}
+	_, ok := r.(*liveReader)
+	return ok
+}
+
+// readWebMIndex reads the headers of the WebM data without starting to read the packets.
+func readWebMIndex(data []byte) (*webmIndex, error) {
+	w := newWebMReader(&memoryReader{Reader: bytes.NewReader(data), data: data}, 0)
+	var meta webm.WebM
+	colors, err := w.readHeaders(&meta)
+	if err != nil {
+		return nil, err
+	}
+	return w.index(&meta, colors), nil
+}
+
+// index returns the headers read by readHeaders.
+func (w *webmReader) index(meta *webm.WebM, colors map[uint]trackColor) *webmIndex {
+	return &webmIndex{
+		meta:         *meta,
+		colors:       colors,
+		segment:      w.segment,
+		segmentEnd:   w.segmentEnd,
+		firstCluster: w.firstCluster,
+	}
+}
+
+// readHeaders reads the elements of the Segment before the first Cluster, and the Cues after the Clusters if the
+// SeekHead has them.
+func (w *webmReader) readHeaders(meta *webm.WebM) (map[uint]trackColor, error) {
+	e := &w.e
+	id, size, _, err := e.header()
+	if err != nil {
+		return nil, err
+	}
+	if id != 0x1a45dfa3 {
+		return nil, errors.New("webmplayer: not an EBML stream")
+	}
+	if err := e.children(size, func(id, size uint64) (bool, error) {
+		if id != 0x4282 {
+			return false, nil
+		}
+		// DocType
+		meta.DocType, err = e.readString(size)
+		return true, err
+	}); err != nil {
+		return nil, err
+	}
+
+	id, size, _, err = e.header()
+	if err != nil {
+		return nil, err
+	}
+	if id != 0x18538067 {
+		return nil, errors.New("webmplayer: no Segment")
+	}
+	w.segment = e.offset()
+	if size != unknownSize {
+		w.segmentEnd = w.segment + int64(size)
+	}
+
+	colors := map[uint]trackColor{}
+	cuesPos := int64(-1)
+	var cuesRead bool
+	for {
+		off := e.offset()
+		if off >= w.segmentEnd {
+			w.firstCluster = off
+			break
+		}
+		id, size, _, err := e.header()
+		if errors.Is(err, io.EOF) {
+			// No Clusters.
+			w.firstCluster = off
+			break
+		}
+		if err != nil {
+			return nil, err
+		}
+		if id == 0x1f43b675 {
+			// Cluster
+			w.firstCluster = off
+			break
+		}
+		switch id {
+		case 0x114d9b74:
+			// SeekHead
+			err = e.children(size, func(id, size uint64) (bool, error) {
+				if id != 0x4dbb {
+					return false, nil
+				}
+				var seekID, pos uint64
+				err := e.children(size, func(id, size uint64) (bool, error) {
+					var err error
+					switch id {
+					case 0x53ab:
+						// SeekID, which is the ID with its length marker.
+						seekID, err = e.readUint(size)
+					case 0x53ac:
+						pos, err = e.readUint(size)
+					default:
+						return false, nil
+					}
+					return true, err
+				})
+				if seekID == 0x1c53bb6b {
+					cuesPos = int64(pos)
+				}
+				return true, err
+			})
+		case 0x1549a966:
+			err = w.readInfo(size, meta)
+		case 0x1654ae6b:
+			err = w.readTracks(size, meta, colors)
+		case 0x1c53bb6b:
+			err = w.readCues(size, meta)
+			cuesRead = true
+		default:
+			err = e.skip(size)
+		}
+		if err != nil {
+			return nil, err
+		}
+	}
+
+	// The Cues are usually after the Clusters. They are read only if the size of the input is known, so that a live
+	// stream is not read to its end.
+	if !cuesRead && cuesPos >= 0 {
+		if end, ok := e.size(); ok && w.segment+cuesPos < end {
+			if err := e.seek(w.segment + cuesPos); err == nil {
+				if id, size, _, err := e.header(); err == nil && id == 0x1c53bb6b {
+					// Broken Cues are not fatal, as seeking can read the clusters forward.
+					if err := w.readCues(size, meta); err != nil {
+						meta.CuePoint = nil
+					}
+				}
+			}
+		}
+	}
+	if err := e.seek(w.firstCluster); err != nil {
+		return nil, err
+	}
+
+	if meta.TimecodeScale == 0 {
+		meta.TimecodeScale = uint(time.Millisecond)
+	}
+	return colors, nil
+}
+
+// init sets the states of w derived from the headers.
+func (w *webmReader) init(meta *webm.WebM) {
+	w.scale = time.Duration(meta.TimecodeScale)
+	w.duration = meta.GetDuration()
+	w.cues = newCues(meta, w.segment)
+	for _, t := range meta.TrackEntry {
+		if t.IsAudio() {
+			if w.audioTracks == nil {
+				w.audioTracks = map[uint]bool{}
+			}
+			w.audioTracks[t.TrackNumber] = true
+		}
+		if t.CodecID == string(audioCodecOpus) {
+			if w.opusTracks == nil {
+				w.opusTracks = map[uint]bool{}
+			}
+			w.opusTracks[t.TrackNumber] = true
+		}
+		if isSubtitleTrack(&t) {
+			if w.subtitles == nil {
+				w.subtitles = map[uint]*subtitleIndex{}
+			}
+			w.subtitles[t.TrackNumber] = newSubtitleIndex(&t)
+		}
+	}
+}
+
+func (w *webmReader) readInfo(size uint64, meta *webm.WebM) error {
+	e := &w.e
+	return e.children(size, func(id, size uint64) (bool, error) {
+		switch id {
+		case 0x2ad7b1:
+			// TimecodeScale
+			v, err := e.readUint(size)
+			meta.TimecodeScale = uint(v)
+			return true, err
+		case 0x4489:
+			// Duration
+			v, err := e.readFloat(size)
+			meta.Duration = float32(v)
+			return true, err
+		}
+		return false, nil
+	})
+}
+
+func (w *webmReader) readTracks(size uint64, meta *webm.WebM, colors map[uint]trackColor) error {
+	e := &w.e
+	return e.children(size, func(id, size uint64) (bool, error) {
+		if id != 0xae {
+			return false, nil
+		}
+		// TrackEntry, with the default values of Matroska.
+		t := webm.TrackEntry{
+			Language: "eng",
+		}
+		t.Channels = 1
+		t.SamplingFrequency = 8000
+		var color trackColor
+		var hasColor bool
+		err := e.children(size, func(id, size uint64) (bool, error) {
+			var err error
+			var v uint64
+			switch id {
+			case 0xd7:
+				v, err = e.readUint(size)
+				t.TrackNumber = uint(v)
+			case 0x73c5:
+				t.TrackUID, err = e.readUint(size)
+			case 0x83:
+				v, err = e.readUint(size)
+				t.TrackType = uint(v)
+			case 0x536e:
+				t.Name, err = e.readString(size)
+			case 0x22b59c:
+				t.Language, err = e.readString(size)
+			case 0x86:
+				t.CodecID, err = e.readString(size)
+			case 0x63a2:
+				t.CodecPrivate, err = e.readBytes(size)
+			case 0x258688:
+				t.CodecName, err = e.readString(size)
+			case 0x56aa:
+				v, err = e.readUint(size)
+				t.CodecDelay = uint(v)
+			case 0x56bb:
+				v, err = e.readUint(size)
+				t.SeekPreRoll = uint(v)
+			case 0xe0:
+				// Video
+				err = e.children(size, func(id, size uint64) (bool, error) {
+					var err error
+					var v uint64
+					switch id {
+					case 0xb0:
+						v, err = e.readUint(size)
+						t.PixelWidth = uint(v)
+					case 0xba:
+						v, err = e.readUint(size)
+						t.PixelHeight = uint(v)
+					case 0x54b0:
+						v, err = e.readUint(size)
+						t.DisplayWidth = uint(v)
+					case 0x54ba:
+						v, err = e.readUint(size)
+						t.DisplayHeight = uint(v)
+					case 0x55b0:
+						hasColor = true
+						err = w.readColour(size, &color)
+					case 0x53c0:
+						// AlphaMode
+						hasColor = true
+						v, err = e.readUint(size)
+						color.alpha = v == 1
+					default:
+						return false, nil
+					}
+					return true, err
+				})
+			case 0xe1:
+				// Audio
+				err = e.children(size, func(id, size uint64) (bool, error) {
+					var err error
+					var v uint64
+					switch id {
+					case 0xb5:
+						t.SamplingFrequency, err = e.readFloat(size)
+					case 0x78b5:
+						t.OutputSamplingFrequency, err = e.readFloat(size)
+					case 0x9f:
+						v, err = e.readUint(size)
+						t.Channels = uint(v)
+					case 0x6264:
+						v, err = e.readUint(size)
+						t.BitDepth = uint(v)
+					default:
+						return false, nil
+					}
+					return true, err
+				})
+			default:
+				return false, nil
+			}
+			return true, err
+		})
+		if err != nil {
+			return true, err
+		}
+		// The display size is the pixel size by default.
+		if t.DisplayWidth == 0 {
+			t.DisplayWidth = t.PixelWidth
+		}
+		if t.DisplayHeight == 0 {
+			t.DisplayHeight = t.PixelHeight
+		}
+		if hasColor {
+			colors[t.TrackNumber] = color
+		}
+		meta.TrackEntry = append(meta.TrackEntry, t)
+		return true, nil
+	})
+}
+
+// readColour reads the Colour element of a video track.
+func (w *webmReader) readColour(size uint64, color *trackColor) error {
+	e := &w.e
+	return e.children(size, func(id, size uint64) (bool, error) {
+		switch id {
+		case 0x55b1:
+			// MatrixCoefficients, as ISO/IEC 23091-4.
+			v, err := e.readUint(size)
+			color.colorSpace = matrixColorSpace(v)
+			return true, err
+		case 0x55b9:
+			// Range: 1 is broadcast, and 2 is full.
+			v, err := e.readUint(size)
+			if v == 1 || v == 2 {
+				color.hasRange = true
+				color.fullRange = v == 2
+			}
+			return true, err
+		}
+		return false, nil
+	})
+}
+
+func (w *webmReader) readCues(size uint64, meta *webm.WebM) error {
+	e := &w.e
+	return e.children(size, func(id, size uint64) (bool, error) {
+		if id != 0xbb {
+			return false, nil
+		}
+		// CuePoint
+		var c webm.CuePoint
+		err := e.children(size, func(id, size uint64) (bool, error) {
+			switch id {
+			case 0xb3:
+				var err error
+				c.CueTime, err = e.readUint(size)
+				return true, err
+			case 0xb7:
+				var p webm.CueTrackPositions
+				err := e.children(size, func(id, size uint64) (bool, error) {
+					var err error
+					var v uint64
+					switch id {
+					case 0xf7:
+						v, err = e.readUint(size)
+						p.CueTrack = uint(v)
+					case 0xf1:
+						p.CueClusterPosition, err = e.readUint(size)
+					case 0x5378:
+						v, err = e.readUint(size)
+						p.CueBlockNumber = uint(v)
+					default:
+						return false, nil
+					}
+					return true, err
+				})
+				c.CueTrackPositions = append(c.CueTrackPositions, p)
+				return true, err
+			}
+			return false, nil
+		})
+		meta.CuePoint = append(meta.CuePoint, c)
+		return true, err
+	})
+}
+
+// Seek moves to the cluster before t. The next packet sent has Rebase.
+func (w *webmReader) Seek(t time.Duration) {
+	select {
+	case w.seeks <- t:
+	case <-w.done:
+	}
+}
+
+// Shutdown stops the goroutine, which closes Chan after the packet being sent is received.
+func (w *webmReader) Shutdown() {
+	w.shutdown.Do(func() {
+		close(w.done)
+	})
+}
+
+// packets implements demuxer.
+func (w *webmReader) packets() <-chan demuxPacket {
+	return w.Chan
+}
+
+// setLoop implements demuxer.
+func (w *webmReader) setLoop() time.Duration {
+	return w.loop.start(w.duration)
+}
+
+// skipData implements demuxer.
+func (w *webmReader) skipData(track uint) {
+	w.skipped.Store(uint64(track))
+}
+
+// skipAudio implements demuxer.
+func (w *webmReader) skipAudio() {
+	w.audioSkipped.Store(true)
+}
+
+// dropped reports whether the blocks of the track are dropped by skipAudio.
+func (w *webmReader) dropped(track uint) bool {
+	return w.audioSkipped.Load() && w.audioTracks[track]
+}
+
+// run sends the packets until Shutdown is called.
+func (w *webmReader) run() {
+	defer close(w.Chan)
+	// The input is not read after Shutdown.
+	defer w.e.join()
+
+	var rebase bool
+	for {
+		pkt, err := w.nextPacket()
+		if err != nil && w.loop.next() {
+			clear(w.pending)
+			w.pending = w.pending[:0]
+			// The state is lost anyway at the end, so an error here is reported as the end of the next pass.
+			_ = w.e.seek(w.firstCluster)
+			pkt, err = demuxPacket{Packet: w.loop.mark()}, nil
+		}
+		if err != nil {
+			pkt = demuxPacket{Packet: webm.Packet{Timecode: webm.BadTC}}
+		}
+		pkt.Rebase = rebase
+		select {
+		case w.Chan <- pkt:
+			rebase = false
+			if err == nil {
+				continue
+			}
+			select {
+			case t := <-w.seeks:
+				w.seek(t)
+				rebase = true
+			case <-w.done:
+				return
+			}
+		case t := <-w.seeks:
+			w.seek(t)
+			rebase = true
+		case <-w.done:
+			return
+		}
+	}
+}
+
+// seek moves to the last cluster starting at or before t by the Cues and the clusters read so far.
+func (w *webmReader) seek(t time.Duration) {
+	t = w.loop.seek(t)
+	off := w.firstCluster
+	var start time.Duration
+	for _, cues := range [][]cue{w.cues, w.clusters} {
+		if i := sort.Search(len(cues), func(i int) bool { return cues[i].time > t }); i > 0 && cues[i-1].time >= start {
+			start = cues[i-1].time
+			off = cues[i-1].offset
+		}
+	}
+	clear(w.pending)
+	w.pending = w.pending[:0]
+	// The state is lost anyway by the seek, so an error here is reported as the end when reading.
+	_ = w.e.seek(off)
+}
+
+// nextPacket returns the next frame of the blocks, or io.EOF at the end of the Segment.
+//
+// The elements are read flat: the children of a Cluster are read as they come, and the other elements are skipped,
+// so that a Cluster of unknown size ends at the next element that is not its child.
+func (w *webmReader) nextPacket() (demuxPacket, error) {
+	e := &w.e
+	for len(w.pending) == 0 {
+		off := e.offset()
+		if off >= w.segmentEnd {
+			return demuxPacket{}, io.EOF
+		}
+		id, size, _, err := e.header()
+		if err != nil {
+			return demuxPacket{}, err
+		}
+		switch id {
+		case 0x1f43b675:
+			// Cluster
+			w.cluster = off
+			w.clusterTimecode = 0
+			if err := e.bufferCluster(size); err != nil {
+				return demuxPacket{}, err
+			}
+		case 0xe7:
+			// Timecode of the Cluster
+			v, err := e.readUint(size)
+			if err != nil {
+				return demuxPacket{}, err
+			}
+			w.clusterTimecode = int64(v)
+			// The clusters are indexed in the order of the offsets, which is the time order.
+			if n := len(w.clusters); n == 0 || w.clusters[n-1].offset < w.cluster {
+				w.clusters = append(w.clusters, cue{
+					time:   time.Duration(v) * w.scale,
+					offset: w.cluster,
+				})
+			}
+		case 0xa3:
+			// SimpleBlock
+			start := len(w.pending)
+			if err := w.readBlock(size, true); err != nil {
+				return demuxPacket{}, err
+			}
+			w.indexSubtitles(start, -1)
+		case 0xa0:
+			// BlockGroup, which is a keyframe without ReferenceBlock.
+			start := len(w.pending)
+			keyframe := true
+			duration := time.Duration(-1)
+			var alpha []byte
+			if err := e.children(size, func(id, size uint64) (bool, error) {
+				switch id {
+				case 0xa1:
+					return true, w.readBlock(size, false)
+				case 0xfb:
+					keyframe = false
+				case 0x9b:
+					// BlockDuration
+					v, err := e.readUint(size)
+					if err != nil {
+						return false, err
+					}
+					duration = time.Duration(v) * w.scale
+					return true, nil
+				case 0x75a1:
+					// BlockAdditions. The data is not read for a block sent without its data.
+					if start < len(w.pending) && w.pending[start].Data == nil {
+						return false, nil
+					}
+					a, err := w.readBlockAdditions(size)
+					if err != nil {
+						return false, err
+					}
+					alpha = a
+					return true, nil
+				}
+				return false, nil
+			}); err != nil {
+				return demuxPacket{}, err
+			}
+			for i := start; i < len(w.pending); i++ {
+				w.pending[i].Keyframe = keyframe
+				if w.pending[i].Data != nil {
+					w.pending[i].alpha = alpha
+				}
+			}
+			w.indexSubtitles(start, duration)
+		default:
+			if err := e.skip(size); err != nil {
+				return demuxPacket{}, err
+			}
+		}
+	}
+	pkt := w.pending[0]
+	w.pending[0] = demuxPacket{}
+	w.pending = w.pending[1:]
+	w.loop.packet(&pkt.Packet)
+	return pkt, nil
+}
+
+// readBlockAdditions reads a BlockAdditions of size bytes, and returns the BlockAdditional of BlockAddID 1, which is
+// the alpha channel of a VP8 or VP9 frame, or nil.
+// https://www.webmproject.org/docs/container/#BlockAdditions
+func (w *webmReader) readBlockAdditions(size uint64) ([]byte, error) {
+	e := &w.e
+	var alpha []byte
+	err := e.children(size, func(id, size uint64) (bool, error) {
+		if id != 0xa6 {
+			return false, nil
+		}
+		// BlockMore
+		addID := uint64(1)
+		var data []byte
+		if err := e.children(size, func(id, size uint64) (bool, error) {
+			switch id {
+			case 0xee:
+				// BlockAddID
+				v, err := e.readUint(size)
+				if err != nil {
+					return false, err
+				}
+				addID = v
+				return true, nil
+			case 0xa5:
+				// BlockAdditional
+				if size > maxEBMLElementSize {
+					return false, errors.New("webmplayer: too large BlockAdditional")
+				}
+				b, ok, err := e.view(int(size))
+				if err != nil {
+					return false, err
+				}
+				if !ok {
+					b = w.alloc(int(size))
+					if err := e.read(b); err != nil {
+						return false, err
+					}
+				}
+				data = b
+				return true, nil
+			}
+			return false, nil
+		}); err != nil {
+			return false, err
+		}
+		if addID == 1 && len(data) > 0 {
+			alpha = data
+		}
+		return true, nil
+	})
+	return alpha, err
+}
+
+// indexSubtitles moves the frames of the subtitle tracks in pending from start to their indices. duration is the
+// duration of the block, or negative if it is unknown.
+func (w *webmReader) indexSubtitles(start int, duration time.Duration) {
+	if w.subtitles == nil {
+		return
+	}
+	n := start
+	for _, pkt := range w.pending[start:] {
+		if x, ok := w.subtitles[pkt.TrackNumber]; ok {
+			x.add(pkt.Data, pkt.Timecode, duration)
+			continue
+		}
+		w.pending[n] = pkt
+		n++
+	}
+	clear(w.pending[n:])
+	w.pending = w.pending[:n]
+}
+
+// subtitleIndex returns the cues of the subtitle track, or nil if track is not a subtitle track.
+func (w *webmReader) subtitleIndex(track uint) *subtitleIndex {
+	return w.subtitles[track]
+}
+
+// alloc returns n bytes of the shared buffer. The buffer is never reused, and is freed when all the packets referring
+// to it are.
+func (w *webmReader) alloc(n int) []byte {
+	if n > webmSlabSize/4 {
+		return make([]byte, n)
+	}
+	if n > len(w.slab) {
+		w.slab = make([]byte, webmSlabSize)
+	}
+	b := w.slab[:n:n]
+	w.slab = w.slab[n:]
+	return b
+}
+
+// readBlock reads a SimpleBlock or a Block of size bytes, and adds its frames to pending.
+// https://www.matroska.org/technical/basics.html#block-structure
+func (w *webmReader) readBlock(size uint64, simple bool) error {
+	if size > maxEBMLElementSize {
+		return errors.New("webmplayer: too large block")
+	}
+	skipped := uint(w.skipped.Load())
+	// A block in memory is referred to as it is.
+	data, ok, err := w.e.view(int(size))
+	if err != nil {
+		return err
+	}
+	if !ok {
+		// The header is at most a track number of 8 bytes, the timecode and the flags.
+		var header [11]byte
+		h := header[:min(int(size), len(header))]
+		if err := w.e.read(h); err != nil {
+			return err
+		}
+		if track, n, err := parseVint(h); err == nil && (uint(track) == skipped || w.dropped(uint(track))) && len(h) >= n+3 {
+			if err := w.e.skip(size - uint64(len(h))); err != nil {
+				return err
+			}
+			data = h
+		} else {
+			data = w.alloc(int(size))
+			copy(data, h)
+			if err := w.e.read(data[len(h):]); err != nil {
+				return err
+			}
+		}
+	}
+	track, n, err := parseVint(data)
+	if err != nil {
+		return err
+	}
+	if len(data) < n+3 {
+		return errors.New("webmplayer: too short block")
+	}
+	timecode := w.clusterTimecode + int64(int16(binary.BigEndian.Uint16(data[n:])))
+	flags := data[n+2]
+	data = data[n+3:]
+
+	pkt := webm.Packet{
+		Timecode:    time.Duration(timecode) * w.scale,
+		TrackNumber: uint(track),
+		Invisible:   flags&0x08 != 0,
+	}
+	if simple {
+		pkt.Keyframe = flags&0x80 != 0
+		pkt.Discardable = flags&0x01 != 0
+	}
+	if w.dropped(pkt.TrackNumber) {
+		return nil
+	}
+	if pkt.TrackNumber == skipped {
+		w.pending = append(w.pending, demuxPacket{Packet: pkt})
+		return nil
+	}
+
+	lacing := flags >> 1 & 0x03
+	if lacing == 0 {
+		pkt.Data = data
+		w.pending = append(w.pending, demuxPacket{Packet: pkt})
+		return nil
+	}
+
+	// The laced frames are sub-slices of the block. They have the timecode of the block, except Opus frames, whose
+	// timecodes follow the durations of the frames before them, as the Opus decoder finds gaps by the timecodes.
+	if len(data) == 0 {
+		return errors.New("webmplayer: too short laced block")
+	}
+	count := int(data[0]) + 1
+	data = data[1:]
+	w.sizes = w.sizes[:0]
+	switch lacing {
+	case 1:
+		// Xiph lacing
+		for range count - 1 {
+			var s int
+			for {
+				if len(data) == 0 {
+					return errors.New("webmplayer: invalid Xiph lacing")
+				}
+				b := data[0]
+				data = data[1:]
+				s += int(b)
+				if b != 0xff {
+					break
+				}
+			}
+			w.sizes = append(w.sizes, s)
+		}
+	case 2:
+		// Fixed-size lacing
+		if len(data)%count != 0 {
+			return errors.New("webmplayer: invalid fixed-size lacing")
+		}
+		for range count - 1 {
+			w.sizes = append(w.sizes, len(data)/count)
+		}
+	case 3:
+		// EBML lacing: the first size, and then the signed differences from the previous sizes.
+		var s int64
+		for i := range count - 1 {
+			v, n, err := parseVint(data)
+			if err != nil {
+				return err
+			}
+			data = data[n:]
+			if i == 0 {
+				s = int64(v)
+			} else {
+				s += int64(v) - (1<<(7*n-1) - 1)
+			}
+			if s < 0 {
+				return errors.New("webmplayer: invalid EBML lacing")
+			}
+			w.sizes = append(w.sizes, int(s))
+		}
+	}
+	opus := w.opusTracks[pkt.TrackNumber]
+	for _, s := range w.sizes {
+		if s > len(data) {
+			return errors.New("webmplayer: invalid lacing")
+		}
+		pkt.Data = data[:s:s]
+		w.pending = append(w.pending, demuxPacket{Packet: pkt})
+		data = data[s:]
+		if opus {
+			pkt.Timecode += time.Duration(opusPacketFrames(pkt.Data)) * time.Second / opusSamplingFrequency
+		}
+	}
+	pkt.Data = data
+	w.pending = append(w.pending, demuxPacket{Packet: pkt})
+	return nil
+}
@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: Apache-2.0
+// SPDX-FileCopyrightText: 2024 Hajime Hoshi
+
+package webmplayer
+
+import (
+	"encoding/binary"
+	"math"
+	"math/bits"
+
+	"github.com/ebml-go/webm"
+
+	"github.com/hajimehoshi/webmplayer/internal/vpxfb"
+)
+
+// The EBML elements are appended to byte slices. An ID is written with its length marker as it is, e.g. 0x1a45dfa3.
+
+// appendEBMLHeader appends the header of the element id with the data size.
+func appendEBMLHeader(b []byte, id uint64, size uint64) []byte {
+	n := (bits.Len64(id) + 7) / 8
+	for i := n - 1; i >= 0; i-- {
+		b = append(b, byte(id>>(8*i)))
+	}
+	return appendEBMLSize(b, size)
+}
+
+// appendEBMLSize appends size as the shortest vint. The values of all ones are reserved for the unknown size.
+func appendEBMLSize(b []byte, size uint64) []byte {
+	n := 1
+	for n < 8 && size >= 1<<(7*n)-1 {
+		n++
+	}
+	v := size | 1<<(7*n)
+	for i := n - 1; i >= 0; i-- {
+		b = append(b, byte(v>>(8*i)))
+	}
+	return b
+}
+
+// ebmlUnknownSize is the 8-byte size of an element whose size is unknown, e.g. a Segment being written.
+const ebmlUnknownSize = 1<<56 - 1
+
+// appendEBMLFixedHeader appends the header of the element id with the data size in 8 bytes, so that the size can be
+// written after the data.
+func appendEBMLFixedHeader(b []byte, id uint64, size uint64) []byte {
+	b = appendEBMLHeader(b, id, 0)
+	b = b[:len(b)-1]
+	return binary.BigEndian.AppendUint64(b, size|1<<56)
+}
+
+func appendEBMLMaster(b []byte, id uint64, data []byte) []byte {
+	b = appendEBMLHeader(b, id, uint64(len(data)))
+	return append(b, data...)
+}
+
+func appendEBMLUint(b []byte, id uint64, v uint64) []byte {
+	n := max((bits.Len64(v)+7)/8, 1)
+	b = appendEBMLHeader(b, id, uint64(n))
+	for i := n - 1; i >= 0; i-- {
+		b = append(b, byte(v>>(8*i)))
+	}
+	return b
+}
+
+// appendEBMLFixedUint appends v in 8 bytes, so that the size of the element doesn't depend on v, e.g. for the
+// positions of the elements written after it.
+func appendEBMLFixedUint(b []byte, id uint64, v uint64) []byte {
+	b = appendEBMLHeader(b, id, 8)
+	return binary.BigEndian.AppendUint64(b, v)
+}
+
+func appendEBMLFloat(b []byte, id uint64, v float64) []byte {
+	b = appendEBMLHeader(b, id, 8)
+	return binary.BigEndian.AppendUint64(b, math.Float64bits(v))
+}
+
+func appendEBMLString(b []byte, id uint64, s string) []byte {
+	b = appendEBMLHeader(b, id, uint64(len(s)))
+	return append(b, s...)
+}
+
+func appendEBMLBytes(b []byte, id uint64, data []byte) []byte {
+	return appendEBMLMaster(b, id, data)
+}
+
+// simpleBlockFlags returns the flags of a SimpleBlock.
+func simpleBlockFlags(keyframe, invisible, discardable bool) byte {
+	var f byte
+	if keyframe {
+		f |= 0x80
+	}
+	if invisible {
+		f |= 0x08
+	}
+	if discardable {
+		f |= 0x01
+	}
+	return f
+}
+
+// simpleBlockSize returns the size of the SimpleBlock element of the track with size bytes of data.
+func simpleBlockSize(track uint, size int) uint64 {
+	n := uint64(len(appendEBMLSize(nil, uint64(track)))) + 3 + uint64(size)
+	return uint64(len(appendEBMLHeader(nil, 0xa3, n))) + n
+}
+
+// appendSimpleBlock appends a SimpleBlock of the track. rel is the timecode relative to the Cluster.
+func appendSimpleBlock(b []byte, track uint, rel int16, flags byte, data []byte) []byte {
+	b = appendEBMLHeader(b, 0xa3, uint64(len(appendEBMLSize(nil, uint64(track))))+3+uint64(len(data)))
+	b = appendEBMLSize(b, uint64(track))
+	b = append(b, byte(uint16(rel)>>8), byte(rel), flags)
+	return append(b, data...)
+}
+
+// webmHeader returns the EBML header of a WebM file.
+func webmHeader() []byte {
+	var h []byte
+	h = appendEBMLUint(h, 0x4286, 1) // EBMLVersion
+	h = appendEBMLUint(h, 0x42f7, 1) // EBMLReadVersion
+	h = appendEBMLUint(h, 0x42f2, 4) // EBMLMaxIDLength
+	h = appendEBMLUint(h, 0x42f3, 8) // EBMLMaxSizeLength
+	h = appendEBMLString(h, 0x4282, "webm")
+	h = appendEBMLUint(h, 0x4287, 4) // DocTypeVersion
+	h = appendEBMLUint(h, 0x4285, 2) // DocTypeReadVersion
+	return appendEBMLMaster(nil, 0x1a45dfa3, h)
+}
+
+// webmTracks returns the Tracks element of the tracks as webmReader reads them. colors is the Colour elements by the
+// track numbers.
+func webmTracks(tracks []webm.TrackEntry, colors map[uint]trackColor) []byte {
+	var ts []byte
+	for i := range tracks {
+		t := &tracks[i]
+		var e []byte
+		e = appendEBMLUint(e, 0xd7, uint64(t.TrackNumber))
+		e = appendEBMLUint(e, 0x73c5, t.TrackUID)
+		e = appendEBMLUint(e, 0x83, uint64(t.TrackType))
+		// The frames are written in their own blocks.
+		e = appendEBMLUint(e, 0x9c, 0) // FlagLacing
+		if t.Name != "" {
+			e = appendEBMLString(e, 0x536e, t.Name)
+		}
+		if t.Language != "" {
+			e = appendEBMLString(e, 0x22b59c, t.Language)
+		}
+		e = appendEBMLString(e, 0x86, t.CodecID)
+		if len(t.CodecPrivate) > 0 {
+			e = appendEBMLBytes(e, 0x63a2, t.CodecPrivate)
+		}
+		if t.CodecName != "" {
+			e = appendEBMLString(e, 0x258688, t.CodecName)
+		}
+		if t.CodecDelay > 0 {
+			e = appendEBMLUint(e, 0x56aa, uint64(t.CodecDelay))
+		}
+		if t.SeekPreRoll > 0 {
+			e = appendEBMLUint(e, 0x56bb, uint64(t.SeekPreRoll))
+		}
+		switch {
+		case t.IsVideo():
+			var v []byte
+			v = appendEBMLUint(v, 0xb0, uint64(t.PixelWidth))
+			v = appendEBMLUint(v, 0xba, uint64(t.PixelHeight))
+			if t.DisplayWidth != t.PixelWidth || t.DisplayHeight != t.PixelHeight {
+				v = appendEBMLUint(v, 0x54b0, uint64(t.DisplayWidth))
+				v = appendEBMLUint(v, 0x54ba, uint64(t.DisplayHeight))
+			}
+			// AlphaMode is not written, as the BlockAdditions are not.
+			if c, ok := colors[t.TrackNumber]; ok && c.hasColour() {
+				v = appendEBMLMaster(v, 0x55b0, webmColour(c))
+			}
+			e = appendEBMLMaster(e, 0xe0, v)
+		case t.IsAudio():
+			var a []byte
+			a = appendEBMLFloat(a, 0xb5, t.SamplingFrequency)
+			if t.OutputSamplingFrequency > 0 {
+				a = appendEBMLFloat(a, 0x78b5, t.OutputSamplingFrequency)
+			}
+			a = appendEBMLUint(a, 0x9f, uint64(t.Channels))
+			if t.BitDepth > 0 {
+				a = appendEBMLUint(a, 0x6264, uint64(t.BitDepth))
+			}
+			e = appendEBMLMaster(e, 0xe1, a)
+		}
+		ts = appendEBMLMaster(ts, 0xae, e)
+	}
+	return appendEBMLMaster(nil, 0x1654ae6b, ts)
+}
+
+// webmColour returns the data of the Colour element of c. Only the matrix and the range are kept by webmReader.
+func webmColour(c trackColor) []byte {
+	var b []byte
+	var matrix uint64
+	switch c.colorSpace {
+	case vpxfb.ColorSpaceBT709:
+		matrix = 1
+	case vpxfb.ColorSpaceBT601:
+		matrix = 6
+	case vpxfb.ColorSpaceSMPTE240:
+		matrix = 7
+	case vpxfb.ColorSpaceBT2020:
+		matrix = 9
+	}
+	if matrix != 0 {
+		b = appendEBMLUint(b, 0x55b1, matrix)
+	}
+	if c.hasRange {
+		r := uint64(1)
+		if c.fullRange {
+			r = 2
+		}
+		b = appendEBMLUint(b, 0x55b9, r)
+	}
+	return b
+}